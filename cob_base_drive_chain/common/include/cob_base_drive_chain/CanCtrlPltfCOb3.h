@@ -21,15 +21,22 @@
 //-----------------------------------------------
 
 // general includes
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
 
 // Headers provided by other cob-packages
 #include <cob_canopen_motor/CanDriveItf.h>
 #include <cob_canopen_motor/CanDriveHarmonica.h>
+#include <cob_canopen_motor/CanDriveHarmonicaSim.h>
 #include <cob_generic_can/CanItf.h>
+#include <cob_generic_can/CanVirtual.h>
 
 // Headers provided by cob-packages which should be avoided/removed
 #include <cob_utilities/IniFile.h>
 #include <cob_utilities/Mutex.h>
+#include <cob_utilities/TimeStamp.h>
 
 // remove (not supported)
 //#include "stdafx.h"
@@ -93,6 +100,7 @@ public:
 
 	/**
 	 * Signs an error of the platform.
+	 * With event error detection only the states evaluated from EMCY and heartbeat of the drives are read.
 	 * @return true if there is an error.
 	 */
 	bool isPltfError();
@@ -108,8 +116,17 @@ public:
 	 */
 	bool startWatchdog(bool bStarted);
 
+	/**
+	 * Switches the motion type (CanDriveItf::MOTIONTYPE_...) of all motors and starts them again.
+	 * The commands are queued to all motors in parallel, as in initPltf().
+	 * @return false if a motor could not be started
+	 */
+	bool setTypeMotion(int iType);
+
 	/**
 	 * Triggers evaluation of the can-buffer.
+	 * With several CAN buses the messages are evaluated by the receive threads of the buses
+	 * as they arrive, then only the unknown identifiers are reported.
 	 */
 	int evalCanBuffer();
 
@@ -126,7 +143,8 @@ public:
 
 	/**
 	 * Sends torques to the can node.
-	 * Status is requested, too.
+	 * Status is requested, too. In SYNC PDO mode the measured currents are received by TPDO3
+	 * after the next sendSync(), as the positions and velocities.
 	 * @param iCanIdent choose a can node
 	 * @param dTorqueNM motor-torque in Newtonmeter
 	 */
@@ -140,6 +158,41 @@ public:
 	 */
 	void requestDriveStatus();
 
+	/**
+	 * Sends one SYNC frame for all drives after the setpoints of a cycle have been sent.
+	 * Only in SYNC PDO mode, the drives send their own SYNC otherwise.
+	 */
+	void sendSync();
+
+	/**
+	 * Returns true if the drives answer every SYNC by PDOs (key "SyncPDOMode" of Platform.ini).
+	 */
+	bool isSyncPDOMode() const { return m_Param.iSyncPDOMode != 0; }
+
+	/**
+	 * Returns the traffic counters of the CAN interface, summed up over all CAN buses.
+	 * @return false if the CAN interface is not opened yet
+	 */
+	bool getCanStatistics(CanStatistics::Snapshot* pSnapshot);
+
+	/**
+	 * Returns the number of CAN buses the motors are spread across.
+	 */
+	int getNumCanBuses() { return (int)m_vpCanCtrl.size(); }
+
+	/**
+	 * Returns the contention counters of the lock serializing the CAN access.
+	 */
+	void getLockStatistics(Mutex::Statistics* pStatistics);
+
+	/**
+	 * Fetches the telemetry samples a motor streamed since the last call.
+	 * The stream is enabled by Config/TelemetryPeriodMS in Platform.ini.
+	 * @param iCanIdent index of the motor
+	 * @return number of samples copied to pSamples
+	 */
+	int getTelemetry(int iCanIdent, CanDriveItf::TelemetrySample* pSamples, int iMaxSamples);
+
 	/**
 	 * Requests position and velocity of the drive.
 	 * (This is not implemented for CanDriveHarmonica.
@@ -185,6 +238,48 @@ public:
 	 */
 	void getMotorTorque(int iCanIdent, double* pdTorqueNm);
 
+	/**
+	 * Measured state of one motor, see getMotorStates().
+	 */
+	struct MotorStateType
+	{
+		double dAngGearRad;
+		double dVelGearRadS;
+		double dTorqueNm;
+		int iStatus;
+		int iTempCel;
+		// change of dAngGearRad since the previous telemetry snapshot, 0 for getMotorStates()
+		double dDeltaAngGearRad;
+	};
+
+	/**
+	 * Gets position, velocity, torque and status of all motors in a single lock,
+	 * so all values belong to the same evaluation of the CAN buffer.
+	 * @param pvStates states indexed by the CAN node enumeration, resized to the number of motors
+	 */
+	void getMotorStates(std::vector<MotorStateType>* pvStates);
+
+	/**
+	 * States of all motors as published by the last evalCanBuffer(), see getTelemetrySnapshot().
+	 */
+	struct TelemetrySnapshotType
+	{
+		// number of the evalCanBuffer() call which published the snapshot, 0 if none was published yet
+		unsigned int uiCycle;
+		// time of that call
+		TimeStamp Stamp;
+		// indexed by the CAN node enumeration
+		std::vector<MotorStateType> vStates;
+	};
+
+	/**
+	 * Gets the states of all motors after the last evaluation of the CAN buffer, without taking the lock
+	 * of the CAN access. So the readers never wait for the receive path and do not delay it.
+	 * Retries while evalCanBuffer() publishes a new snapshot.
+	 * @param pSnapshot vStates is resized to the number of motors, the allocation is kept for the next call
+	 */
+	void getTelemetrySnapshot(TelemetrySnapshotType* pSnapshot) const;
+
 
 
 	//--------------------------------- Commands specific for a certain motor controller
@@ -195,6 +290,7 @@ public:
 	 * @param iFlag To keep the interface slight, use iParam to command the recorder:
 	 * 0: Configure the Recorder to record the sources Main Speed(1), Main position(2), Active current(10), Speed command(16). With iParam = iRecordingGap you specify every which time quantum (4*90usec) a new data point (of 1024 points in total) is recorded;
 	 * 1: Query Upload of recorded source (1=Main Speed, 2=Main position, 10=Active Current, 16=Speed command) with iParam and log data to file sParam = file prefix. Filename is extended with _MotorNumber_RecordedSource.log
+	 * 3: Select the logfile format of all motors with iParam (0 = text, 1 = binary appended to _MotorNumber_RecordedSource.bin)
 	 * 99: Abort and clear current SDO readout process
 	 * 100: Request status of readout. Gives back 0 if all transmissions have finished and no CAN polling is needed anymore.
 	 * @return -1: Unknown flag set; 0: Success; 1: Recorder hasn't been configured yet; 2: data collection still in progress
@@ -202,6 +298,12 @@ public:
 	*/
 	int ElmoRecordings(int iFlag, int iParam, std::string sString);
 
+	/**
+	 * Sets the function called for each motor when its read-out requested by ElmoRecordings(1, ...) has ended.
+	 * The read-outs of all motors run at the same time, so the calls come from the CAN receive path or the processing threads of the motors.
+	 */
+	void setElmoRecorderCallback(const ElmoRecorder::ReadoutCallback& callback);
+
 	//--------------------------------- Commands for other nodes
 
 
@@ -224,6 +326,54 @@ protected:
 	 */
 	void sendNetStartCanOpen();
 
+	/**
+	 * Builds the lookup table from CAN identifier to motor used by evalCanBuffer().
+	 */
+	void buildCanIdTable();
+
+	/**
+	 * Opens the CAN interface of a bus, bus 0 is configured like a single bus platform.
+	 * @param iTypeCan interface type of [TypeCan] Can
+	 * @param iBus index of the bus
+	 * @return NULL if the type does not support additional buses
+	 */
+	CanItf* createCanItf(int iTypeCan, int iBus);
+
+	/**
+	 * Publishes the states of all motors as the next telemetry snapshot, called with m_Mutex held.
+	 */
+	void publishTelemetrySnapshot(const TimeStamp& Stamp);
+
+	/**
+	 * Passes received messages to their motor, called with m_Mutex held.
+	 */
+	void dispatchMsgs(CanMsg* pMsgs, int iNumMsgs);
+
+	/**
+	 * Receive thread of one bus, only used with more than one bus.
+	 */
+	void rxThread(int iBus);
+	void startRxThreads();
+	void stopRxThreads();
+
+	/**
+	 * Sends all steps of a stepwise init sequence (e.g. CanDriveItf::sendInitStep) to the given motors in lockstep.
+	 * After each step it waits once for the longest delay any motor requested.
+	 */
+	void sendStepsToMotors(const std::vector<CanDriveItf*>& vpMotor, int (CanDriveItf::*pfnSendStep)(int));
+
+	/**
+	 * Evaluates the CAN buffer until all given motors have their requested answer or the timeout expired.
+	 * @param pvbAnswered is filled with the answer state of each motor
+	 */
+	void waitForInitAnswers(const std::vector<CanDriveItf*>& vpMotor, std::vector<bool>* pvbAnswered);
+
+	/**
+	 * Evaluates the CAN buffer until the given motors have no unconfirmed SDOs left.
+	 * The motors work off their queues at the same time, see CanDriveItf::processSDOQueue().
+	 */
+	void waitForSDOQueues(const std::vector<CanDriveItf*>& vpMotor);
+
 
 	//--------------------------------- Types
 
@@ -260,6 +410,19 @@ protected:
 		int iHasRadarBoard;
 
 		double dCanTimeout;
+
+		// drives answer a single SYNC with all PDOs (Platform.ini: Config/SyncPDOMode)
+		int iSyncPDOMode;
+		// period of the drive telemetry stream in ms, 0 = off (Platform.ini: Config/TelemetryPeriodMS)
+		int iTelemetryPeriodMS;
+		// drive errors are reported by EMCY and heartbeat (Platform.ini: Config/EventErrorDetection)
+		int iEventErrorDetection;
+		// producer heartbeat period of the drives in ms (Platform.ini: Config/HeartbeatPeriodMS)
+		int iHeartbeatPeriodMS;
+		// velocity estimator of the motors, see VelEstimator::Mode (Platform.ini: Config/VelEstimator)
+		int iVelEstimator;
+		// acceleration noise of the Kalman estimator in rad/s^2/sqrt(Hz) (Platform.ini: Config/VelEstimatorAccNoise)
+		double dVelEstimatorAccNoise;
 	};
 
 	/**
@@ -399,12 +562,38 @@ protected:
 
 	//--------------------------------- Variables
 	CanMsg m_CanMsgRec;
+	// receive buffer which evalCanBuffer() drains the CAN queue into
+	std::vector<CanMsg> m_vCanMsgRecBuf;
+	// motor responsible for a CAN identifier, built in initPltf()
+	std::vector<CanDriveItf*> m_vpCanIdToMotor;
+	// messages with unknown identifier, reported at most once per second
+	int m_iUnknownCanIdCnt;
+	int m_iLastUnknownCanId;
+	TimeStamp m_UnknownCanIdReportTime;
 	Mutex m_Mutex;
+	// telemetry snapshot, single writer (evalCanBuffer() with m_Mutex held) seqlock:
+	// the counter is odd while the snapshot is written, readers retry if it is odd or has changed
+	boost::atomic<unsigned int> m_uiSnapshotSeq;
+	TelemetrySnapshotType m_Snapshot;
 	bool m_bWatchdogErr;
+	// motion type set by setTypeMotion(), resetPltf() stops the motors accordingly
+	int m_iTypeMotion;
 
 	//--------------------------------- Components
-	// Can-Interface
+	// Can-Interface of bus 0
 	CanItf* m_pCanCtrl;
+	// all CAN buses, the first one is m_pCanCtrl
+	std::vector<CanItf*> m_vpCanCtrl;
+	// device of each bus, kept as some interfaces only store the pointer
+	std::vector<std::string> m_vsCanDevice;
+	// buses of the virtual CAN interface besides the default one, NULL for bus 0
+	std::vector<CanVirtualBus*> m_vpVirtualBus;
+	// bus of each motor
+	std::vector<int> m_viMotorBus;
+	// one receive thread per bus, if there is more than one bus
+	boost::thread_group m_RxThreads;
+	boost::atomic<bool> m_bRxThreadsRunning;
+	static const int c_iRxTimeoutUs = 100000;
 	IniFile m_IniFile;
 
 	int m_iNumMotors;
@@ -425,6 +614,10 @@ protected:
 	// this has to be adapted in c++ file to your hardware
 	std::vector<int> m_viMotorID;
 
+	// simulated drives and their bus nodes, only used with the virtual CAN bus (CAN type 3)
+	std::vector<CanDriveHarmonicaSim*> m_vpMotorSim;
+	std::vector<CanItf*> m_vpMotorSimCanItf;
+
 	// other
 
 
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#ifndef SETPOINTINTERPOLATOR_INCLUDEDEF_H
+#define SETPOINTINTERPOLATOR_INCLUDEDEF_H
+
+//-----------------------------------------------
+#include <vector>
+//-----------------------------------------------
+
+/**
+ * Generates velocity setpoints at the CAN cycle rate from sparse joint commands.
+ * Between two commands the trend of the last commands is extrapolated for a limited time,
+ * the setpoints follow with limited acceleration and jerk. Without new commands the joints
+ * are ramped down to zero.
+ */
+class SetpointInterpolator
+{
+public:
+	/**
+	 * Limits of one joint.
+	 */
+	struct JointLimitsType
+	{
+		double dMaxVelRadS;
+		double dMaxAccRadS2;
+		double dMaxJerkRadS3;
+	};
+
+	SetpointInterpolator();
+
+	/**
+	 * Sets the number of joints and the limits, resets all setpoints to zero.
+	 * @param vLimits limits of each joint
+	 * @param dExtrapolationS time the command trend is extrapolated after a command, 0 for hold
+	 * @param dTimeoutS commands older than this are replaced by zero velocity
+	 */
+	void init(const std::vector<JointLimitsType>& vLimits, double dExtrapolationS, double dTimeoutS);
+
+	/**
+	 * Resets all setpoints to zero and forgets the commands.
+	 */
+	void reset();
+
+	/**
+	 * Passes a new command.
+	 * @param vdVelRadS commanded velocities, one per joint
+	 * @param dTimeS time of the command in s, same clock as for update()
+	 */
+	void setCmd(const std::vector<double>& vdVelRadS, double dTimeS);
+
+	/**
+	 * Advances the setpoints to the given time.
+	 * @param dTimeS current time in s
+	 * @param pvdVelRadS setpoints, resized to the number of joints
+	 */
+	void update(double dTimeS, std::vector<double>* pvdVelRadS);
+
+private:
+	// longest step that is integrated, longer gaps are treated as restart
+	static const double c_dMaxStepS;
+
+	std::vector<JointLimitsType> m_vLimits;
+	double m_dExtrapolationS;
+	double m_dTimeoutS;
+
+	// last two commands and the trend between them
+	std::vector<double> m_vdCmdVel;
+	std::vector<double> m_vdCmdAcc;
+	double m_dCmdTimeS;
+	bool m_bCmdValid;
+
+	// state of the setpoint generator
+	std::vector<double> m_vdVel;
+	std::vector<double> m_vdAcc;
+	double m_dTimeS;
+	bool m_bTimeValid;
+};
+
+//-----------------------------------------------
+#endif
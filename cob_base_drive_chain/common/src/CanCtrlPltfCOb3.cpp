@@ -23,13 +23,19 @@
 #include <cob_generic_can/CanESD.h>
 #include <cob_generic_can/CanPeakSys.h>
 #include <cob_generic_can/CanPeakSysUSB.h>
+#include <cob_generic_can/CanVirtual.h>
+#include <cob_generic_can/SocketCan.h>
 #include <cob_base_drive_chain/CanCtrlPltfCOb3.h>
+#include <cob_utilities/StrUtil.h>
+#include <cob_utilities/Trace.h>
 
 #include <unistd.h>
 
 //-----------------------------------------------
 
 CanCtrlPltfCOb3::CanCtrlPltfCOb3(std::string iniDirectory)
+	// shared between the real-time CAN thread and the ROS callbacks, the critical sections are short
+	: m_Mutex(Mutex::PROTOCOL_INHERIT, 100)
 {
 	sIniDirectory = iniDirectory;
 	IniFile iniFile;
@@ -46,6 +52,7 @@ CanCtrlPltfCOb3::CanCtrlPltfCOb3(std::string iniDirectory)
 
 	// ------------- first of all set used CanItf
 	m_pCanCtrl = NULL;
+	m_bRxThreadsRunning = false;
 
 	// ------------- init hardware-specific vectors and set default values
 	m_vpMotor.resize(m_iNumMotors);
@@ -56,6 +63,22 @@ CanCtrlPltfCOb3::CanCtrlPltfCOb3(std::string iniDirectory)
 	}
 
 	m_viMotorID.resize(m_iNumMotors);
+	m_viMotorBus.assign(m_iNumMotors, 0);
+
+	// room for a few PDOs per motor, evalCanBuffer() loops until the queue is empty anyway
+	m_vCanMsgRecBuf.resize(8 * m_iNumMotors);
+
+	// 11-bit identifiers
+	m_vpCanIdToMotor.assign(2048, NULL);
+	m_iUnknownCanIdCnt = 0;
+	m_iLastUnknownCanId = 0;
+	m_UnknownCanIdReportTime.SetNow();
+
+	// all motors are in the snapshot from the start, so publishing it does not allocate
+	MotorStateType defaultState = { 0, 0, 0, 0, 0, 0 };
+	m_uiSnapshotSeq = 0;
+	m_Snapshot.uiCycle = 0;
+	m_Snapshot.vStates.assign(m_iNumMotors, defaultState);
 
 //	m_viMotorID.resize(8);
 	if(m_iNumMotors >= 1)
@@ -75,8 +98,16 @@ CanCtrlPltfCOb3::CanCtrlPltfCOb3(std::string iniDirectory)
 	if(m_iNumMotors == 8)
 		m_viMotorID[7] = CANNODE_WHEEL4STEERMOTOR;
 
+	m_iTypeMotion = CanDriveItf::MOTIONTYPE_VELCTRL;
+
 	// ------------- parameters
 	m_Param.dCanTimeout = 7;
+	m_Param.iSyncPDOMode = 0;
+	m_Param.iEventErrorDetection = 0;
+	m_Param.iHeartbeatPeriodMS = 100;
+	m_Param.iTelemetryPeriodMS = 0;
+	m_Param.iVelEstimator = 0;
+	m_Param.dVelEstimatorAccNoise = 2;
 
 	if(m_iNumMotors >= 1)
 		m_Param.iHasWheel1DriveMotor = 0;
@@ -188,9 +219,23 @@ CanCtrlPltfCOb3::CanCtrlPltfCOb3(std::string iniDirectory)
 CanCtrlPltfCOb3::~CanCtrlPltfCOb3()
 {
 
-	if (m_pCanCtrl != NULL)
+	stopRxThreads();
+
+	// stop the simulated drives before their bus goes away
+	for(unsigned int i = 0; i < m_vpMotorSim.size(); i++)
+	{
+		delete m_vpMotorSim[i];
+		delete m_vpMotorSimCanItf[i];
+	}
+
+	for(unsigned int i = 0; i < m_vpCanCtrl.size(); i++)
 	{
-		delete m_pCanCtrl;
+		delete m_vpCanCtrl[i];
+	}
+
+	for(unsigned int i = 0; i < m_vpVirtualBus.size(); i++)
+	{
+		delete m_vpVirtualBus[i];
 	}
 
 	for(unsigned int i = 0; i < m_vpMotor.size(); i++)
@@ -206,6 +251,7 @@ CanCtrlPltfCOb3::~CanCtrlPltfCOb3()
 //-----------------------------------------------
 void CanCtrlPltfCOb3::readConfiguration()
 {
+	TRACE_PHASE("CanCtrlPltfCOb3::readConfiguration");
 
 	int iTypeCan = 0;
 	int iMaxMessages = 0;
@@ -249,26 +295,39 @@ void CanCtrlPltfCOb3::readConfiguration()
 
 	// read Configuration of the Can-Network (CanCtrl.ini)
 	m_IniFile.GetKeyInt("TypeCan", "Can", &iTypeCan, true);
-	if (iTypeCan == 0)
-	{
-		sComposed = sIniDirectory;
-		sComposed += "CanCtrl.ini";
-		m_pCanCtrl = new CanPeakSys(sComposed.c_str());
-		std::cout << "Uses CAN-Peak-Systems dongle" << std::endl;
-	}
-	else if (iTypeCan == 1)
+
+	// drives can be spread across several buses of the same interface type
+	int iNumBuses = 1;
+	m_IniFile.GetKeyInt("TypeCan", "NumBuses", &iNumBuses, false);
+	if (iNumBuses < 1)
+		iNumBuses = 1;
+
+	m_vsCanDevice.resize(iNumBuses);
+	m_vpVirtualBus.assign(iNumBuses, NULL);
+	for (int iBus = 0; iBus < iNumBuses; iBus++)
 	{
-		sComposed = sIniDirectory;
-		sComposed += "CanCtrl.ini";
-		m_pCanCtrl = new CANPeakSysUSB(sComposed.c_str());
-		std::cout << "Uses CAN-Peak-USB" << std::endl;
+		CanItf* pCanItf = createCanItf(iTypeCan, iBus);
+		if (pCanItf == NULL)
+		{
+			std::cout << "CAN type " << iTypeCan << " does not support more than one bus, all motors use bus 0" << std::endl;
+			break;
+		}
+		m_vpCanCtrl.push_back(pCanItf);
 	}
-	else if (iTypeCan == 2)
+	m_pCanCtrl = m_vpCanCtrl.empty() ? NULL : m_vpCanCtrl[0];
+
+	static const char* c_pcMotorNames[] = { "W1Drive", "W1Steer", "W2Drive", "W2Steer", "W3Drive", "W3Steer", "W4Drive", "W4Steer" };
+	for (int i = 0; i < m_iNumMotors; i++)
 	{
-		sComposed = sIniDirectory;
-		sComposed += "CanCtrl.ini";
-		m_pCanCtrl = new CanESD(sComposed.c_str(), false);
-		std::cout << "Uses CAN-ESD-card" << std::endl;
+		m_viMotorBus[i] = 0;
+		m_IniFile.GetKeyInt("TypeCan", (std::string("Bus_") + c_pcMotorNames[i]).c_str(), &m_viMotorBus[i], false);
+		if (m_viMotorBus[i] < 0 || m_viMotorBus[i] >= (int)m_vpCanCtrl.size())
+		{
+			std::cout << "Bus " << m_viMotorBus[i] << " of motor " << c_pcMotorNames[i] << " is not configured, using bus 0" << std::endl;
+			m_viMotorBus[i] = 0;
+		}
+		if (m_vpCanCtrl.size() > 1)
+			std::cout << "Motor " << c_pcMotorNames[i] << " on CAN bus " << m_viMotorBus[i] << std::endl;
 	}
 
 	// CanOpenId's ----- Default values (DESIRE)
@@ -687,7 +746,7 @@ void CanCtrlPltfCOb3::readConfiguration()
 			((CanDriveHarmonica*) m_vpMotor[0])->setCanOpenParam(
 				m_CanOpenIDParam.TxPDO1_W1Drive, m_CanOpenIDParam.TxPDO2_W1Drive, m_CanOpenIDParam.RxPDO2_W1Drive,
 				m_CanOpenIDParam.TxSDO_W1Drive, m_CanOpenIDParam.RxSDO_W1Drive);
-			m_vpMotor[0]->setCanItf(m_pCanCtrl);
+			m_vpMotor[0]->setCanItf(m_vpCanCtrl[m_viMotorBus[0]]);
 			m_vpMotor[0]->setDriveParam(DriveParamW1DriveMotor);
 		}
 	}
@@ -709,7 +768,7 @@ void CanCtrlPltfCOb3::readConfiguration()
 			((CanDriveHarmonica*) m_vpMotor[1])->setCanOpenParam(
 				m_CanOpenIDParam.TxPDO1_W1Steer, m_CanOpenIDParam.TxPDO2_W1Steer, m_CanOpenIDParam.RxPDO2_W1Steer,
 				m_CanOpenIDParam.TxSDO_W1Steer, m_CanOpenIDParam.RxSDO_W1Steer);
-			m_vpMotor[1]->setCanItf(m_pCanCtrl);
+			m_vpMotor[1]->setCanItf(m_vpCanCtrl[m_viMotorBus[1]]);
 			m_vpMotor[1]->setDriveParam(DriveParamW1SteerMotor);
 
 		}
@@ -733,7 +792,7 @@ void CanCtrlPltfCOb3::readConfiguration()
 			((CanDriveHarmonica*) m_vpMotor[2])->setCanOpenParam(
 				m_CanOpenIDParam.TxPDO1_W2Drive, m_CanOpenIDParam.TxPDO2_W2Drive, m_CanOpenIDParam.RxPDO2_W2Drive,
 				m_CanOpenIDParam.TxSDO_W2Drive, m_CanOpenIDParam.RxSDO_W2Drive);
-			m_vpMotor[2]->setCanItf(m_pCanCtrl);
+			m_vpMotor[2]->setCanItf(m_vpCanCtrl[m_viMotorBus[2]]);
 			m_vpMotor[2]->setDriveParam(DriveParamW2DriveMotor);
 		}
 	}
@@ -755,7 +814,7 @@ void CanCtrlPltfCOb3::readConfiguration()
 			((CanDriveHarmonica*) m_vpMotor[3])->setCanOpenParam(
 				m_CanOpenIDParam.TxPDO1_W2Steer, m_CanOpenIDParam.TxPDO2_W2Steer, m_CanOpenIDParam.RxPDO2_W2Steer,
 				m_CanOpenIDParam.TxSDO_W2Steer, m_CanOpenIDParam.RxSDO_W2Steer);
-			m_vpMotor[3]->setCanItf(m_pCanCtrl);
+			m_vpMotor[3]->setCanItf(m_vpCanCtrl[m_viMotorBus[3]]);
 			m_vpMotor[3]->setDriveParam(DriveParamW2SteerMotor);
 
 		}
@@ -779,7 +838,7 @@ void CanCtrlPltfCOb3::readConfiguration()
 			((CanDriveHarmonica*) m_vpMotor[4])->setCanOpenParam(
 				m_CanOpenIDParam.TxPDO1_W3Drive, m_CanOpenIDParam.TxPDO2_W3Drive, m_CanOpenIDParam.RxPDO2_W3Drive,
 				m_CanOpenIDParam.TxSDO_W3Drive, m_CanOpenIDParam.RxSDO_W3Drive);
-			m_vpMotor[4]->setCanItf(m_pCanCtrl);
+			m_vpMotor[4]->setCanItf(m_vpCanCtrl[m_viMotorBus[4]]);
 			m_vpMotor[4]->setDriveParam(DriveParamW3DriveMotor);
 		}
 	}
@@ -801,7 +860,7 @@ void CanCtrlPltfCOb3::readConfiguration()
 			((CanDriveHarmonica*) m_vpMotor[5])->setCanOpenParam(
 				m_CanOpenIDParam.TxPDO1_W3Steer, m_CanOpenIDParam.TxPDO2_W3Steer, m_CanOpenIDParam.RxPDO2_W3Steer,
 				m_CanOpenIDParam.TxSDO_W3Steer, m_CanOpenIDParam.RxSDO_W3Steer);
-			m_vpMotor[5]->setCanItf(m_pCanCtrl);
+			m_vpMotor[5]->setCanItf(m_vpCanCtrl[m_viMotorBus[5]]);
 			m_vpMotor[5]->setDriveParam(DriveParamW3SteerMotor);
 
 		}
@@ -825,7 +884,7 @@ void CanCtrlPltfCOb3::readConfiguration()
 			((CanDriveHarmonica*) m_vpMotor[6])->setCanOpenParam(
 				m_CanOpenIDParam.TxPDO1_W4Drive, m_CanOpenIDParam.TxPDO2_W4Drive, m_CanOpenIDParam.RxPDO2_W4Drive,
 				m_CanOpenIDParam.TxSDO_W4Drive, m_CanOpenIDParam.RxSDO_W4Drive);
-			m_vpMotor[6]->setCanItf(m_pCanCtrl);
+			m_vpMotor[6]->setCanItf(m_vpCanCtrl[m_viMotorBus[6]]);
 			m_vpMotor[6]->setDriveParam(DriveParamW4DriveMotor);
 		}
 	}
@@ -847,7 +906,7 @@ void CanCtrlPltfCOb3::readConfiguration()
 			((CanDriveHarmonica*) m_vpMotor[7])->setCanOpenParam(
 				m_CanOpenIDParam.TxPDO1_W4Steer, m_CanOpenIDParam.TxPDO2_W4Steer, m_CanOpenIDParam.RxPDO2_W4Steer,
 				m_CanOpenIDParam.TxSDO_W4Steer, m_CanOpenIDParam.RxSDO_W4Steer);
-			m_vpMotor[7]->setCanItf(m_pCanCtrl);
+			m_vpMotor[7]->setCanItf(m_vpCanCtrl[m_viMotorBus[7]]);
 			m_vpMotor[7]->setDriveParam(DriveParamW4SteerMotor);
 
 		}
@@ -855,40 +914,414 @@ void CanCtrlPltfCOb3::readConfiguration()
 
 	m_IniFile.GetKeyInt("Config", "GenericBufferLen", &iMaxMessages, true);
 
+	m_IniFile.GetKeyInt("Config", "SyncPDOMode", &m_Param.iSyncPDOMode, false);
+	if(m_Param.iSyncPDOMode != 0)
+	{
+		std::cout << "Drives are configured for SYNC PDO mode" << std::endl;
+		for(int i=0; i<m_iNumMotors; i++)
+		{
+			if(m_vpMotor[i] != NULL)
+				((CanDriveHarmonica*) m_vpMotor[i])->setSyncPDOMode(true);
+		}
+	}
+
+	m_IniFile.GetKeyInt("Config", "EventErrorDetection", &m_Param.iEventErrorDetection, false);
+	m_IniFile.GetKeyInt("Config", "HeartbeatPeriodMS", &m_Param.iHeartbeatPeriodMS, false);
+	if(m_Param.iEventErrorDetection != 0)
+	{
+		std::cout << "Drive errors are reported by EMCY and heartbeat every " << m_Param.iHeartbeatPeriodMS << " ms" << std::endl;
+		for(int i=0; i<m_iNumMotors; i++)
+		{
+			if(m_vpMotor[i] != NULL)
+				((CanDriveHarmonica*) m_vpMotor[i])->setEventErrorDetection(true, m_Param.iHeartbeatPeriodMS);
+		}
+	}
+
+	// velocity estimator of all motors, may be overridden per motor by VelEstimator_<motor>
+	m_IniFile.GetKeyInt("Config", "VelEstimator", &m_Param.iVelEstimator, false);
+	m_IniFile.GetKeyDouble("Config", "VelEstimatorAccNoise", &m_Param.dVelEstimatorAccNoise, false);
+	for(int i=0; i<m_iNumMotors; i++)
+	{
+		int iVelEstimator = m_Param.iVelEstimator;
+		m_IniFile.GetKeyInt("Config", (std::string("VelEstimator_") + c_pcMotorNames[i]).c_str(), &iVelEstimator, false);
+		if((m_vpMotor[i] != NULL) && (iVelEstimator != VelEstimator::VEL_EST_DRIVE))
+		{
+			std::cout << "Velocity of motor " << c_pcMotorNames[i] << " is estimated by " <<
+				((iVelEstimator == VelEstimator::VEL_EST_KALMAN) ? "Kalman filter" : "position difference") << std::endl;
+			((CanDriveHarmonica*) m_vpMotor[i])->setVelEstimator(iVelEstimator, m_Param.dVelEstimatorAccNoise);
+		}
+	}
+
+	m_IniFile.GetKeyInt("Config", "TelemetryPeriodMS", &m_Param.iTelemetryPeriodMS, false);
+	if(m_Param.iTelemetryPeriodMS > 0)
+	{
+		std::cout << "Drives stream telemetry every " << m_Param.iTelemetryPeriodMS << " ms" << std::endl;
+		for(int i=0; i<m_iNumMotors; i++)
+		{
+			if(m_vpMotor[i] != NULL)
+				((CanDriveHarmonica*) m_vpMotor[i])->setTelemetryPeriod(m_Param.iTelemetryPeriodMS);
+		}
+	}
+
+	// each simulated drive answers on its own node of the virtual bus, with the CAN identifiers of its motor
+	if (iTypeCan == 3)
+	{
+		for(int i=0; i<m_iNumMotors; i++)
+		{
+			if(m_vpMotor[i] == NULL)
+				continue;
+
+			CanDriveHarmonica* pMotor = (CanDriveHarmonica*) m_vpMotor[i];
+			const CanDriveHarmonica::ParamCanOpenType& canOpenParam = pMotor->getCanOpenParam();
+			CanVirtualBus* pBus = m_vpVirtualBus[m_viMotorBus[i]];
+			CanItf* pSimCanItf = (pBus == NULL) ? new CanVirtual() : new CanVirtual(*pBus);
+			CanDriveHarmonicaSim* pSim = new CanDriveHarmonicaSim(pSimCanItf,
+				canOpenParam.iTxPDO1, canOpenParam.iTxPDO2, canOpenParam.iRxPDO2,
+				canOpenParam.iTxSDO, canOpenParam.iRxSDO, pMotor->getDriveParam()->getVelMeasFrqHz());
+
+			pSim->start();
+			m_vpMotorSim.push_back(pSim);
+			m_vpMotorSimCanItf.push_back(pSimCanItf);
+		}
+	}
+
 
 }
 
 //-----------------------------------------------
-int CanCtrlPltfCOb3::evalCanBuffer()
+CanItf* CanCtrlPltfCOb3::createCanItf(int iTypeCan, int iBus)
 {
-	bool bRet;
-//	char cBuf[200];
+	CanItf* pCanItf = NULL;
 
-	m_Mutex.lock();
+	sComposed = sIniDirectory;
+	sComposed += "CanCtrl.ini";
 
-	// as long as there is something in the can buffer -> read out next message
-	while(m_pCanCtrl->receiveMsg(&m_CanMsgRec) == true)
+	if (iBus == 0)
 	{
-		bRet = false;
-		// check for every motor if message belongs to it
-		for (unsigned int i = 0; i < m_vpMotor.size(); i++)
+		if (iTypeCan == 0)
+		{
+			pCanItf = new CanPeakSys(sComposed.c_str());
+			std::cout << "Uses CAN-Peak-Systems dongle" << std::endl;
+		}
+		else if (iTypeCan == 1)
+		{
+			pCanItf = new CANPeakSysUSB(sComposed.c_str());
+			std::cout << "Uses CAN-Peak-USB" << std::endl;
+		}
+		else if (iTypeCan == 2)
+		{
+			pCanItf = new CanESD(sComposed.c_str(), false);
+			std::cout << "Uses CAN-ESD-card" << std::endl;
+		}
+		else if (iTypeCan == 3)
+		{
+			pCanItf = new CanVirtual(sComposed.c_str());
+			std::cout << "Uses virtual CAN bus with simulated drives" << std::endl;
+		}
+		else if (iTypeCan == 5)
 		{
-			// if message belongs to this motor write data (Pos, Vel, ...) to internal member vars
-			bRet |= m_vpMotor[i]->evalReceivedMsg(m_CanMsgRec);
+			m_vsCanDevice[0] = "can0";
+			m_IniFile.GetKeyString("TypeCan", "DevicePath", &m_vsCanDevice[0], false);
+			pCanItf = new SocketCan(m_vsCanDevice[0].c_str());
+			// unlike the other interfaces SocketCan is not opened by its constructor
+			pCanItf->init();
+			std::cout << "Uses SocketCAN device " << m_vsCanDevice[0] << std::endl;
 		}
+		return pCanItf;
+	}
+
+	// further buses are configured by DevicePath1, DevicePath2, ...
+	std::string sKey = "DevicePath" + NumToString(iBus);
+	if (iTypeCan == 1)
+	{
+		int iBaudrateVal = 0;
+		m_IniFile.GetKeyString("TypeCan", sKey.c_str(), &m_vsCanDevice[iBus], true);
+		m_IniFile.GetKeyInt("CanCtrl", "BaudrateVal", &iBaudrateVal, true);
+		pCanItf = new CANPeakSysUSB(m_vsCanDevice[iBus].c_str(), iBaudrateVal);
+		pCanItf->init();
+		std::cout << "Uses CAN-Peak-USB " << m_vsCanDevice[iBus] << " as bus " << iBus << std::endl;
+	}
+	else if (iTypeCan == 3)
+	{
+		m_vpVirtualBus[iBus] = new CanVirtualBus();
+		pCanItf = new CanVirtual(*m_vpVirtualBus[iBus]);
+		std::cout << "Uses virtual CAN bus " << iBus << std::endl;
+	}
+	else if (iTypeCan == 5)
+	{
+		m_vsCanDevice[iBus] = "can" + NumToString(iBus);
+		m_IniFile.GetKeyString("TypeCan", sKey.c_str(), &m_vsCanDevice[iBus], false);
+		pCanItf = new SocketCan(m_vsCanDevice[iBus].c_str());
+		pCanItf->init();
+		std::cout << "Uses SocketCAN device " << m_vsCanDevice[iBus] << " as bus " << iBus << std::endl;
+	}
+	return pCanItf;
+}
+
+//-----------------------------------------------
+void CanCtrlPltfCOb3::startRxThreads()
+{
+	// a single bus is read by evalCanBuffer() in the cycle of the caller
+	if (m_vpCanCtrl.size() < 2 || m_bRxThreadsRunning)
+		return;
+
+	m_bRxThreadsRunning = true;
+	for (unsigned int i = 0; i < m_vpCanCtrl.size(); i++)
+		m_RxThreads.create_thread(boost::bind(&CanCtrlPltfCOb3::rxThread, this, (int)i));
+}
+
+//-----------------------------------------------
+void CanCtrlPltfCOb3::stopRxThreads()
+{
+	m_bRxThreadsRunning = false;
+	m_RxThreads.join_all();
+}
+
+//-----------------------------------------------
+void CanCtrlPltfCOb3::rxThread(int iBus)
+{
+	std::vector<CanMsg> vMsgs(m_vCanMsgRecBuf.size());
+
+	while (m_bRxThreadsRunning)
+	{
+		// a saturated bus only delays its own motors
+		int iNumMsgs = m_vpCanCtrl[iBus]->receiveMsgs(&vMsgs[0], vMsgs.size(), c_iRxTimeoutUs);
+		if (iNumMsgs <= 0)
+			continue;
 
-		if (bRet == false)
+		m_Mutex.lock();
+		dispatchMsgs(&vMsgs[0], iNumMsgs);
+		m_Mutex.unlock();
+	}
+}
+
+//-----------------------------------------------
+void CanCtrlPltfCOb3::dispatchMsgs(CanMsg* pMsgs, int iNumMsgs)
+{
+	for (int j = 0; j < iNumMsgs; j++)
+	{
+		CanMsg& msg = pMsgs[j];
+		CanDriveItf* pMotor = NULL;
+
+		// look up the motor the identifier belongs to and let it write the data (Pos, Vel, ...) to its internal member vars
+		if ((unsigned int)msg.m_iID < m_vpCanIdToMotor.size())
+			pMotor = m_vpCanIdToMotor[msg.m_iID];
+
+		if (pMotor == NULL || !pMotor->evalReceivedMsg(msg))
 		{
-			std::cout << "evalCanBuffer(): Received CAN_Message with unknown identifier " << m_CanMsgRec.m_iID << std::endl;
+			m_iUnknownCanIdCnt++;
+			m_iLastUnknownCanId = msg.m_iID;
 		}
+	}
+}
+
+//-----------------------------------------------
+int CanCtrlPltfCOb3::evalCanBuffer()
+{
+	TRACE_SCOPE("CanCtrlPltfCOb3::evalCanBuffer");
+	int iNumMsgs;
+	int iUnknownCanIdCnt = 0;
+	TimeStamp now;
+//	char cBuf[200];
+
+	m_Mutex.lock();
+
+	// as long as there is something in the can buffer -> read out all pending messages at once
+	while(!m_bRxThreadsRunning && (iNumMsgs = m_pCanCtrl->receiveMsgs(&m_vCanMsgRecBuf[0], m_vCanMsgRecBuf.size())) > 0)
+	{
+		dispatchMsgs(&m_vCanMsgRecBuf[0], iNumMsgs);
+
+		// buffer was not filled up, so the queue is empty
+		if (iNumMsgs < (int)m_vCanMsgRecBuf.size())
+			break;
 	};
 
+	// report unknown identifiers once per second instead of per message
+	now.SetNow();
+	if (m_iUnknownCanIdCnt > 0 && (now - m_UnknownCanIdReportTime) > 1.0)
+	{
+		iUnknownCanIdCnt = m_iUnknownCanIdCnt;
+		m_iUnknownCanIdCnt = 0;
+		m_UnknownCanIdReportTime = now;
+	}
+	int iLastUnknownCanId = m_iLastUnknownCanId;
+
+	publishTelemetrySnapshot(now);
 
 	m_Mutex.unlock();
 
+	if (iUnknownCanIdCnt > 0)
+	{
+		std::cout << "evalCanBuffer(): Received " << iUnknownCanIdCnt << " CAN_Message(s) with unknown identifier, last " << iLastUnknownCanId << std::endl;
+	}
+
 	return 0;
 }
 
+//-----------------------------------------------
+void CanCtrlPltfCOb3::publishTelemetrySnapshot(const TimeStamp& Stamp)
+{
+	unsigned int uiSeq = m_uiSnapshotSeq.load(boost::memory_order_relaxed);
+	m_uiSnapshotSeq.store(uiSeq + 1, boost::memory_order_relaxed);
+	boost::atomic_thread_fence(boost::memory_order_release);
+
+	m_Snapshot.uiCycle++;
+	m_Snapshot.Stamp = Stamp;
+	for(unsigned int i = 0; i < m_vpMotor.size(); i++)
+	{
+		if(m_vpMotor[i] == NULL || m_viMotorID[i] < 0 || m_viMotorID[i] >= (int)m_Snapshot.vStates.size())
+			continue;
+
+		MotorStateType& state = m_Snapshot.vStates[m_viMotorID[i]];
+		double dAngGearRadLast = state.dAngGearRad;
+		m_vpMotor[i]->getGearPosVelRadS(&state.dAngGearRad, &state.dVelGearRadS);
+		m_vpMotor[i]->getMotorTorque(&state.dTorqueNm);
+		m_vpMotor[i]->getStatus(&state.iStatus, &state.iTempCel);
+		state.dDeltaAngGearRad = (m_Snapshot.uiCycle > 1) ? state.dAngGearRad - dAngGearRadLast : 0.0;
+	}
+
+	m_uiSnapshotSeq.store(uiSeq + 2, boost::memory_order_release);
+}
+
+//-----------------------------------------------
+void CanCtrlPltfCOb3::getTelemetrySnapshot(TelemetrySnapshotType* pSnapshot) const
+{
+	// the number of motors does not change after the construction
+	pSnapshot->vStates.resize(m_Snapshot.vStates.size());
+
+	unsigned int uiSeqStart, uiSeqEnd;
+	do
+	{
+		uiSeqStart = m_uiSnapshotSeq.load(boost::memory_order_acquire);
+		pSnapshot->uiCycle = m_Snapshot.uiCycle;
+		pSnapshot->Stamp = m_Snapshot.Stamp;
+		for(unsigned int i = 0; i < m_Snapshot.vStates.size(); i++)
+			pSnapshot->vStates[i] = m_Snapshot.vStates[i];
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		uiSeqEnd = m_uiSnapshotSeq.load(boost::memory_order_relaxed);
+	}
+	while( (uiSeqStart & 1) || (uiSeqStart != uiSeqEnd) );
+}
+
+//-----------------------------------------------
+void CanCtrlPltfCOb3::buildCanIdTable()
+{
+	std::vector<int> viIDs;
+	std::vector<std::vector<int> > vviRxFilter(m_vpCanCtrl.size());
+
+	m_vpCanIdToMotor.assign(m_vpCanIdToMotor.size(), NULL);
+
+	for (unsigned int i = 0; i < m_vpMotor.size(); i++)
+	{
+		if (m_vpMotor[i] == NULL)
+			continue;
+
+		viIDs.clear();
+		m_vpMotor[i]->getReceivedCanIDs(&viIDs);
+
+		for (unsigned int j = 0; j < viIDs.size(); j++)
+		{
+			if (viIDs[j] < 0 || viIDs[j] >= (int)m_vpCanIdToMotor.size())
+			{
+				std::cout << "buildCanIdTable(): CAN identifier " << viIDs[j] << " of motor " << i << " out of range" << std::endl;
+			}
+			else if (m_vpCanIdToMotor[viIDs[j]] != NULL)
+			{
+				std::cout << "buildCanIdTable(): CAN identifier " << viIDs[j] << " is used by more than one motor" << std::endl;
+			}
+			else
+			{
+				m_vpCanIdToMotor[viIDs[j]] = m_vpMotor[i];
+				vviRxFilter[m_viMotorBus[i]].push_back(viIDs[j]);
+			}
+		}
+	}
+
+	// other traffic on a shared bus is then dropped by the driver instead of waking evalCanBuffer()
+	for (unsigned int i = 0; i < m_vpCanCtrl.size(); i++)
+	{
+		if (m_vpCanCtrl[i]->setRxFilter(vviRxFilter[i]))
+		{
+			std::cout << "buildCanIdTable(): CAN bus " << i << " only receives the " << vviRxFilter[i].size() << " identifiers of its motors" << std::endl;
+		}
+	}
+}
+
+//-----------------------------------------------
+void CanCtrlPltfCOb3::sendStepsToMotors(const std::vector<CanDriveItf*>& vpMotor, int (CanDriveItf::*pfnSendStep)(int))
+{
+	bool bStepSent = true;
+
+	for(int iStep = 0; bStepSent; iStep++)
+	{
+		int iMaxDelayUs = 0;
+		bStepSent = false;
+
+		for(unsigned int i = 0; i < vpMotor.size(); i++)
+		{
+			int iDelayUs = (vpMotor[i]->*pfnSendStep)(iStep);
+
+			if(iDelayUs >= 0)
+				bStepSent = true;
+			if(iDelayUs > iMaxDelayUs)
+				iMaxDelayUs = iDelayUs;
+		}
+
+		if(iMaxDelayUs > 0)
+			usleep(iMaxDelayUs);
+	}
+}
+
+//-----------------------------------------------
+void CanCtrlPltfCOb3::waitForInitAnswers(const std::vector<CanDriveItf*>& vpMotor, std::vector<bool>* pvbAnswered)
+{
+	// 3 s for all drives together
+	const int c_iMaxCnt = 3000;
+	bool bAllDone;
+	int iCnt = 0;
+
+	pvbAnswered->assign(vpMotor.size(), false);
+
+	do
+	{
+		// answers are routed to their motor by CAN identifier
+		evalCanBuffer();
+
+		bAllDone = true;
+		for(unsigned int i = 0; i < vpMotor.size(); i++)
+		{
+			// the requested answer is the last request of a drive, a drive without pending requests won't answer anymore
+			int iPending = vpMotor[i]->processSDOQueue();
+			(*pvbAnswered)[i] = vpMotor[i]->isInitAnswered();
+			bAllDone = bAllDone && ((*pvbAnswered)[i] || (iPending == 0));
+		}
+
+		if(!bAllDone)
+			usleep(1000);
+	}
+	while(!bAllDone && (iCnt++ < c_iMaxCnt));
+}
+
+//-----------------------------------------------
+void CanCtrlPltfCOb3::waitForSDOQueues(const std::vector<CanDriveItf*>& vpMotor)
+{
+	int iPending;
+
+	// every request is repeated a few times at most, then a silent drive drops its queue
+	do
+	{
+		evalCanBuffer();
+
+		iPending = 0;
+		for(unsigned int i = 0; i < vpMotor.size(); i++)
+			iPending += vpMotor[i]->processSDOQueue();
+
+		if(iPending > 0)
+			usleep(1000);
+	}
+	while(iPending > 0);
+}
+
 //-----------------------------------------------
 bool CanCtrlPltfCOb3::initPltf()
 {
@@ -924,6 +1357,13 @@ bool CanCtrlPltfCOb3::initPltf()
 //	vdFactorVel.assign(4,0);
 	vdFactorVel.assign(m_iNumDrives,0);
 
+	// route received messages directly to their motor
+	buildCanIdTable();
+	startRxThreads();
+
+
+	// startup phases of the CAN network, the motors and the homing
+	int64_t llPhaseStartNs = Trace::now();
 
 	// Start can open network
 	std::cout << "StartCanOpen" << std::endl;
@@ -947,7 +1387,7 @@ bool CanCtrlPltfCOb3::initPltf()
 	m_vpMotor[6]->startWatchdog(true);
 	m_vpMotor[7]->startWatchdog(true);
 */
-	usleep(10000);
+	waitForSDOQueues(m_vpMotor);
 
 	// 2nd send watchdogs to bed while initializing drives
 	for(int i=0; i<m_iNumMotors; i++)
@@ -963,9 +1403,11 @@ bool CanCtrlPltfCOb3::initPltf()
 	m_vpMotor[6]->startWatchdog(false);
 	m_vpMotor[7]->startWatchdog(false);
 */
-	usleep(100000);
+	waitForSDOQueues(m_vpMotor);
 
 	std::cout << "Initialization of Watchdogs done" << std::endl;
+	Trace::recordPhase("CanCtrlPltfCOb3::startNetwork", llPhaseStartNs, Trace::now());
+	llPhaseStartNs = Trace::now();
 
 
 	// ---------------------- start homing procedurs
@@ -973,16 +1415,46 @@ bool CanCtrlPltfCOb3::initPltf()
 	// o.k. to avoid crashing hardware -> lets check that we have at least the 8 motors, like we have on cob
 	if( (int)m_vpMotor.size() == m_iNumMotors )
 	{
-		// Initialize and start all motors
+		// Initialize and start all motors in parallel: every step is sent to all motors
+		// before waiting, the answers are evaluated per motor by evalCanBuffer()
+		std::vector<CanDriveItf*> vpAllMotor(m_vpMotor.begin(), m_vpMotor.begin() + m_iNumMotors);
+		std::vector<CanDriveItf*> vpInitMotor;
+		std::vector<bool> vbAnswered;
+		std::vector<bool> vbRetMotor;
+
+		// the init steps configure velocity control
+		sendStepsToMotors(vpAllMotor, &CanDriveItf::sendInitStep);
+		m_iTypeMotion = CanDriveItf::MOTIONTYPE_VELCTRL;
+		waitForInitAnswers(vpAllMotor, &vbAnswered);
+		vbRetMotor.assign(m_iNumMotors, false);
+		for (int i = 0; i<m_iNumMotors; i++)
+		{
+			vbRetMotor[i] = vpAllMotor[i]->finishInit(vbAnswered[i]);
+			if (vbRetMotor[i])
+				vpInitMotor.push_back(vpAllMotor[i]);
+		}
+		// PDO mapping of all drives
+		waitForSDOQueues(vpAllMotor);
+
+		// start only the motors which are initialized
+		sendStepsToMotors(vpInitMotor, &CanDriveItf::sendStartStep);
+		waitForInitAnswers(vpInitMotor, &vbAnswered);
+		for (int i = 0, j = 0; i<m_iNumMotors; i++)
+		{
+			if (vbRetMotor[i])
+			{
+				vbRetMotor[i] = vpAllMotor[i]->finishStart(vbAnswered[j]);
+				j++;
+			}
+		}
+		usleep(10000);
+		Trace::recordPhase("CanCtrlPltfCOb3::initMotors", llPhaseStartNs, Trace::now());
+		llPhaseStartNs = Trace::now();
+
 		for (int i = 0; i<m_iNumDrives; i++)
 		{
-			// init + start
-			vbRetDriveMotor[i] = vpDriveMotor[i]->init();
-			vbRetSteerMotor[i] = vpSteerMotor[i]->init();
-			usleep(10000);
-			vbRetDriveMotor[i] = vbRetDriveMotor[i] && vpDriveMotor[i]->start();
-			vbRetSteerMotor[i] = vbRetSteerMotor[i] && vpSteerMotor[i]->start();
-			usleep(10000);
+			vbRetDriveMotor[i] = vbRetMotor[2 * i];
+			vbRetSteerMotor[i] = vbRetMotor[2 * i + 1];
 			// output State / Errors
 			if (vbRetDriveMotor[i] && vbRetSteerMotor[i])
 				std::cout << "Initialization of Wheel "<< (i+1) << " OK" << std::endl;
@@ -1019,8 +1491,8 @@ bool CanCtrlPltfCOb3::initPltf()
 				vdFactorVel[3] = - m_Param.dWheel4SteerDriveCoupling + double(m_Param.iDistSteerAxisToDriveWheelMM) / double(m_Param.iRadiusWheelMM);
 
 			// initialize homing procedure
-			for (int i = 0; i<m_iNumDrives; i++)
-				vpSteerMotor[i]->initHoming();
+			sendStepsToMotors(vpSteerMotor, &CanDriveItf::sendHomingInitStep);
+			waitForSDOQueues(vpSteerMotor);
 
 			// make motors move
 			for (int i = 0; i<m_iNumDrives; i++)
@@ -1033,10 +1505,7 @@ bool CanCtrlPltfCOb3::initPltf()
 			usleep(500000);
 
 			// Get rid of unnecessary can messages
-			bool bRet;
-			do
-				bRet = m_pCanCtrl->receiveMsg(&m_CanMsgRec);
-			while(bRet == true);
+			evalCanBuffer();
 
 			// arm homing procedure
 			for (int i = 0; i<m_iNumDrives; i++)
@@ -1133,6 +1602,7 @@ bool CanCtrlPltfCOb3::initPltf()
 					vpDriveMotor[i]->setGearVelRadS(0);
 				}
 			}
+			Trace::recordPhase("CanCtrlPltfCOb3::homing", llPhaseStartNs, Trace::now());
 		}
 	}
 	// ---------------------- end homing procedure
@@ -1151,6 +1621,7 @@ bool CanCtrlPltfCOb3::initPltf()
 	m_vpMotor[6]->startWatchdog(true);
 	m_vpMotor[7]->startWatchdog(true);
 */
+	waitForSDOQueues(m_vpMotor);
 //	return  (
 //		vbRetDriveMotor[0] && vbRetDriveMotor[1] && vbRetDriveMotor[2] && vbRetDriveMotor[3] &&
 //		vbRetSteerMotor[0] && vbRetSteerMotor[1] && vbRetSteerMotor[2] && vbRetSteerMotor[3]);
@@ -1176,7 +1647,10 @@ bool CanCtrlPltfCOb3::resetPltf()
 		bRetMotor = m_vpMotor[i]->start();
 		if (bRetMotor == true)
 		{
-			m_vpMotor[i]->setGearVelRadS(0);
+			if(m_iTypeMotion == CanDriveItf::MOTIONTYPE_TORQUECTRL)
+				m_vpMotor[i]->setMotorTorque(0);
+			else
+				m_vpMotor[i]->setGearVelRadS(0);
 		}
 		else
 		{
@@ -1229,6 +1703,8 @@ bool CanCtrlPltfCOb3::isPltfError()
 
 	if (m_bWatchdogErr) return true;
 
+	// the drives supervise their heartbeat themselves
+	if (m_Param.iEventErrorDetection != 0) return false;
 
 	// Check communication
 	double dWatchTime = 0;
@@ -1262,10 +1738,35 @@ bool CanCtrlPltfCOb3::startWatchdog(bool bStarted)
 	{
 		bRet = m_vpMotor[i]->startWatchdog(bStarted);
 	}
+	waitForSDOQueues(m_vpMotor);
 
 	return (bRet);
 }
 
+//-----------------------------------------------
+bool CanCtrlPltfCOb3::setTypeMotion(int iType)
+{
+	std::vector<CanDriveItf*> vpAllMotor(m_vpMotor.begin(), m_vpMotor.begin() + m_iNumMotors);
+	std::vector<bool> vbAnswered;
+	bool bRet = true;
+
+	// the unit mode is changed with the motors switched off
+	for(unsigned int i = 0; i < vpAllMotor.size(); i++)
+		vpAllMotor[i]->queueTypeMotion(iType);
+	waitForSDOQueues(vpAllMotor);
+	m_iTypeMotion = iType;
+
+	sendStepsToMotors(vpAllMotor, &CanDriveItf::sendStartStep);
+	waitForInitAnswers(vpAllMotor, &vbAnswered);
+	for(unsigned int i = 0; i < vpAllMotor.size(); i++)
+	{
+		if(!vpAllMotor[i]->finishStart(vbAnswered[i]))
+			bRet = false;
+	}
+
+	return bRet;
+}
+
 //-----------------------------------------------
 void CanCtrlPltfCOb3::sendNetStartCanOpen()
 {
@@ -1274,7 +1775,8 @@ void CanCtrlPltfCOb3::sendNetStartCanOpen()
 	msg.m_iID  = 0;
 	msg.m_iLen = 2;
 	msg.set(1,0,0,0,0,0,0,0);
-	m_pCanCtrl->transmitMsg(msg, false);
+	for(unsigned int i = 0; i < m_vpCanCtrl.size(); i++)
+		m_vpCanCtrl[i]->transmitMsg(msg, false);
 
 	usleep(100000);
 }
@@ -1331,6 +1833,64 @@ int CanCtrlPltfCOb3::requestMotPosVel(int iCanIdent)
 	return 0;
 }
 
+//-----------------------------------------------
+void CanCtrlPltfCOb3::sendSync()
+{
+	if(m_Param.iSyncPDOMode == 0)
+		return;
+
+	// answered by TPDO1 and TPDO3 of all drives
+	CanMsg msg;
+	msg.m_iID  = 0x80;
+	msg.m_iLen = 0;
+	msg.set(0,0,0,0,0,0,0,0);
+
+	// one SYNC per bus right after each other, so all drives sample at the same time
+	m_Mutex.lock();
+	for(unsigned int i = 0; i < m_vpCanCtrl.size(); i++)
+		m_vpCanCtrl[i]->transmitMsg(msg);
+	m_Mutex.unlock();
+}
+
+//-----------------------------------------------
+void CanCtrlPltfCOb3::getLockStatistics(Mutex::Statistics* pStatistics)
+{
+	m_Mutex.getStatistics(pStatistics);
+}
+
+//-----------------------------------------------
+bool CanCtrlPltfCOb3::getCanStatistics(CanStatistics::Snapshot* pSnapshot)
+{
+	if(m_vpCanCtrl.empty())
+		return false;
+
+	m_vpCanCtrl[0]->getStatistics(pSnapshot);
+	for(unsigned int i = 1; i < m_vpCanCtrl.size(); i++)
+	{
+		CanStatistics::Snapshot bus;
+		m_vpCanCtrl[i]->getStatistics(&bus);
+		pSnapshot->ulRxFrames += bus.ulRxFrames;
+		pSnapshot->ulRxBytes += bus.ulRxBytes;
+		pSnapshot->ulTxFrames += bus.ulTxFrames;
+		pSnapshot->ulTxBytes += bus.ulTxBytes;
+		pSnapshot->ulErrors += bus.ulErrors;
+		pSnapshot->ulTxOverruns += bus.ulTxOverruns;
+		pSnapshot->iTxQueueDepth += bus.iTxQueueDepth;
+		for(int j = 0; j < CanStatistics::c_iNumLatencyBins; j++)
+			pSnapshot->ulRxLatency[j] += bus.ulRxLatency[j];
+	}
+	return true;
+}
+
+//-----------------------------------------------
+int CanCtrlPltfCOb3::getTelemetry(int iCanIdent, CanDriveItf::TelemetrySample* pSamples, int iMaxSamples)
+{
+	if( (iCanIdent < 0) || (iCanIdent >= m_iNumMotors) || (m_vpMotor[iCanIdent] == NULL) )
+		return 0;
+
+	return m_vpMotor[iCanIdent]->getTelemetry(pSamples, iMaxSamples);
+}
+
 //-----------------------------------------------
 void CanCtrlPltfCOb3::requestDriveStatus()
 {
@@ -1431,11 +1991,40 @@ void CanCtrlPltfCOb3::getMotorTorque(int iCanIdent, double* pdTorqueNm)
 	}
 
 }
+//-----------------------------------------------
+void CanCtrlPltfCOb3::getMotorStates(std::vector<MotorStateType>* pvStates)
+{
+	MotorStateType defaultState = { 0, 0, 0, 0, 0, 0 };
+	pvStates->assign(m_vpMotor.size(), defaultState);
+
+	m_Mutex.lock();
+
+	for(unsigned int i = 0; i < m_vpMotor.size(); i++)
+	{
+		if(m_viMotorID[i] < 0 || m_viMotorID[i] >= (int)pvStates->size())
+			continue;
+
+		MotorStateType& state = (*pvStates)[m_viMotorID[i]];
+		m_vpMotor[i]->getGearPosVelRadS(&state.dAngGearRad, &state.dVelGearRadS);
+		m_vpMotor[i]->getMotorTorque(&state.dTorqueNm);
+		m_vpMotor[i]->getStatus(&state.iStatus, &state.iTempCel);
+	}
+
+	m_Mutex.unlock();
+}
+
 //-----------------------------------------------
 void CanCtrlPltfCOb3::setMotorTorque(int iCanIdent, double dTorqueNm)
 {
 	m_Mutex.lock();
 
+	// If an error was detected and processed in isPltfErr().
+	if (m_bWatchdogErr == true)
+	{
+		// Error -> no torque
+		dTorqueNm = 0;
+	}
+
 	for(unsigned int i = 0; i < m_vpMotor.size(); i++)
 	{
 		// check if Identifier fits to availlable hardware
@@ -1472,6 +2061,12 @@ int CanCtrlPltfCOb3::ElmoRecordings(int iFlag, int iParam, std::string sString)
 			}
 			return bRet;
 
+		case 3: //Flag = 3 means select the logfile format
+			for(unsigned int i = 0; i < m_vpMotor.size(); i++) {
+				m_vpMotor[i]->setRecorder(3, iParam);
+			}
+			return 0;
+
 		case 99:
 			for(unsigned int i = 0; i < m_vpMotor.size(); i++) {
 				m_vpMotor[i]->setRecorder(99, 0); //Stop any ongoing SDO transfer and clear corresponding data.
@@ -1488,3 +2083,10 @@ int CanCtrlPltfCOb3::ElmoRecordings(int iFlag, int iParam, std::string sString)
 			return -1;
 	}
 }
+
+//-----------------------------------------------
+void CanCtrlPltfCOb3::setElmoRecorderCallback(const ElmoRecorder::ReadoutCallback& callback) {
+	for(unsigned int i = 0; i < m_vpMotor.size(); i++) {
+		m_vpMotor[i]->setRecorderCallback(callback);
+	}
+}
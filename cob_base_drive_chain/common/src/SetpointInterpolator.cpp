@@ -0,0 +1,149 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#include <cob_base_drive_chain/SetpointInterpolator.h>
+
+#include <math.h>
+
+//-----------------------------------------------
+const double SetpointInterpolator::c_dMaxStepS = 0.1;
+
+//-----------------------------------------------
+SetpointInterpolator::SetpointInterpolator()
+{
+	m_dExtrapolationS = 0;
+	m_dTimeoutS = 0;
+	m_dCmdTimeS = 0;
+	m_bCmdValid = false;
+	m_dTimeS = 0;
+	m_bTimeValid = false;
+}
+
+//-----------------------------------------------
+void SetpointInterpolator::init(const std::vector<JointLimitsType>& vLimits, double dExtrapolationS, double dTimeoutS)
+{
+	m_vLimits = vLimits;
+	m_dExtrapolationS = dExtrapolationS;
+	m_dTimeoutS = dTimeoutS;
+	reset();
+}
+
+//-----------------------------------------------
+void SetpointInterpolator::reset()
+{
+	m_vdCmdVel.assign(m_vLimits.size(), 0);
+	m_vdCmdAcc.assign(m_vLimits.size(), 0);
+	m_vdVel.assign(m_vLimits.size(), 0);
+	m_vdAcc.assign(m_vLimits.size(), 0);
+	m_bCmdValid = false;
+	m_bTimeValid = false;
+}
+
+//-----------------------------------------------
+void SetpointInterpolator::setCmd(const std::vector<double>& vdVelRadS, double dTimeS)
+{
+	double dDtS = dTimeS - m_dCmdTimeS;
+
+	for(unsigned int i = 0; i < m_vLimits.size() && i < vdVelRadS.size(); i++)
+	{
+		// trend only from consecutive commands, a restart begins without
+		if(m_bCmdValid && dDtS > 0 && dDtS < m_dTimeoutS)
+			m_vdCmdAcc[i] = (vdVelRadS[i] - m_vdCmdVel[i]) / dDtS;
+		else
+			m_vdCmdAcc[i] = 0;
+
+		if(m_vdCmdAcc[i] > m_vLimits[i].dMaxAccRadS2)
+			m_vdCmdAcc[i] = m_vLimits[i].dMaxAccRadS2;
+		else if(m_vdCmdAcc[i] < -m_vLimits[i].dMaxAccRadS2)
+			m_vdCmdAcc[i] = -m_vLimits[i].dMaxAccRadS2;
+
+		m_vdCmdVel[i] = vdVelRadS[i];
+	}
+
+	m_dCmdTimeS = dTimeS;
+	m_bCmdValid = true;
+}
+
+//-----------------------------------------------
+void SetpointInterpolator::update(double dTimeS, std::vector<double>* pvdVelRadS)
+{
+	double dDtS = m_bTimeValid ? dTimeS - m_dTimeS : 0;
+	if(dDtS < 0 || dDtS > c_dMaxStepS)
+		dDtS = 0;
+	m_dTimeS = dTimeS;
+	m_bTimeValid = true;
+
+	double dCmdAgeS = dTimeS - m_dCmdTimeS;
+	bool bCmdValid = m_bCmdValid && (dCmdAgeS < m_dTimeoutS);
+	double dExtrapolationS = dCmdAgeS < m_dExtrapolationS ? dCmdAgeS : m_dExtrapolationS;
+	if(dExtrapolationS < 0)
+		dExtrapolationS = 0;
+
+	pvdVelRadS->resize(m_vLimits.size());
+
+	for(unsigned int i = 0; i < m_vLimits.size(); i++)
+	{
+		const JointLimitsType& limits = m_vLimits[i];
+
+		// target velocity and its slope
+		double dTarget = 0;
+		double dTargetAcc = 0;
+		if(bCmdValid)
+		{
+			dTarget = m_vdCmdVel[i] + m_vdCmdAcc[i] * dExtrapolationS;
+			if(dCmdAgeS < m_dExtrapolationS)
+				dTargetAcc = m_vdCmdAcc[i];
+		}
+
+		if(dDtS > 0)
+		{
+			// acceleration that still reaches the target without overshoot when reduced with the jerk limit
+			double dErr = dTarget - m_vdVel[i];
+			double dAccDes = dTargetAcc + (dErr >= 0 ? 1 : -1) * sqrt(2 * limits.dMaxJerkRadS3 * fabs(dErr));
+			if(dAccDes > limits.dMaxAccRadS2)
+				dAccDes = limits.dMaxAccRadS2;
+			else if(dAccDes < -limits.dMaxAccRadS2)
+				dAccDes = -limits.dMaxAccRadS2;
+
+			double dMaxDeltaAcc = limits.dMaxJerkRadS3 * dDtS;
+			double dDeltaAcc = dAccDes - m_vdAcc[i];
+			if(dDeltaAcc > dMaxDeltaAcc)
+				dDeltaAcc = dMaxDeltaAcc;
+			else if(dDeltaAcc < -dMaxDeltaAcc)
+				dDeltaAcc = -dMaxDeltaAcc;
+			m_vdAcc[i] += dDeltaAcc;
+
+			double dVel = m_vdVel[i] + m_vdAcc[i] * dDtS;
+
+			// the discrete step would cross the target, snap to it
+			if((dErr >= 0) != (dTarget - dVel >= 0))
+			{
+				dVel = dTarget;
+				m_vdAcc[i] = dTargetAcc;
+			}
+			m_vdVel[i] = dVel;
+		}
+
+		if(m_vdVel[i] > limits.dMaxVelRadS)
+			m_vdVel[i] = limits.dMaxVelRadS;
+		else if(m_vdVel[i] < -limits.dMaxVelRadS)
+			m_vdVel[i] = -limits.dMaxVelRadS;
+
+		(*pvdVelRadS)[i] = m_vdVel[i];
+	}
+}
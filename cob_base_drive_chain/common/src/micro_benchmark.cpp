@@ -0,0 +1,121 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Micro-benchmark of the control cycle of CanCtrlPltfCOb3 against simulated drives.
+ *
+ * usage: pltf_micro_benchmark --ini_directory=dir [--filter=regex] [--format=console|json] [--out=file.json],
+ *        see MicroBenchmark.h
+ *
+ * The ini directory holds Platform.ini and CanCtrl.ini of the robot, with [TypeCan] Can=3 in CanCtrl.ini
+ * to run on the virtual CAN bus, see pltf_benchmark. Without it the benchmarks are skipped.
+ * The platform is initialized once and shared by all runs, the cycles run back to back, so each
+ * evalCanBuffer() dispatches the answers of the drives to the previous SYNC.
+ */
+
+#include <cob_base_drive_chain/CanCtrlPltfCOb3.h>
+#include <cob_utilities/IniFile.h>
+#include <cob_utilities/MicroBenchmark.h>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <string>
+#include <vector>
+
+// platform of the first benchmark, shut down at exit
+struct SharedPlatform
+{
+	int iNumMotors;
+	boost::scoped_ptr<CanCtrlPltfCOb3> pPltf;
+
+	~SharedPlatform()
+	{
+		if(pPltf)
+			pPltf->shutdownPltf();
+	}
+};
+static SharedPlatform s_Platform;
+
+static CanCtrlPltfCOb3* getPlatform(MicroBenchmark::State &state)
+{
+	std::string ini_directory = state.getArg("ini_directory", "");
+	if(ini_directory.empty())
+	{
+		state.skip("needs --ini_directory with a virtual CAN bus");
+		return NULL;
+	}
+	if(ini_directory[ini_directory.size()-1] != '/')
+		ini_directory += "/";
+
+	if(!s_Platform.pPltf)
+	{
+		IniFile ini_file;
+		s_Platform.iNumMotors = 8;
+		ini_file.SetFileName(ini_directory + "Platform.ini", "micro_benchmark.cpp");
+		ini_file.GetKeyInt("Config", "NumberOfMotors", &s_Platform.iNumMotors, true);
+
+		s_Platform.pPltf.reset(new CanCtrlPltfCOb3(ini_directory));
+		if(!s_Platform.pPltf->initPltf())
+		{
+			s_Platform.pPltf.reset();
+			state.skip("could not initialize the platform");
+			return NULL;
+		}
+	}
+	return s_Platform.pPltf.get();
+}
+
+// evalCanBuffer() alone, the velocities and the SYNC of each cycle are sent outside of the measurement
+static void Pltf_EvalCanBuffer(MicroBenchmark::State &state)
+{
+	CanCtrlPltfCOb3 *pltf = getPlatform(state);
+	if(pltf == NULL)
+		return;
+
+	while(state.keepRunning())
+	{
+		state.pauseTiming();
+		for(int i=0; i<s_Platform.iNumMotors; i++)
+			pltf->setVelGearRadS(i, 0.5);
+		pltf->sendSync();
+		state.resumeTiming();
+
+		pltf->evalCanBuffer();
+	}
+}
+MICRO_BENCHMARK(Pltf_EvalCanBuffer);
+
+// one cycle of the node: velocities of all motors, SYNC, evaluation of the CAN buffer and the motor states
+static void Pltf_ControlCycle(MicroBenchmark::State &state)
+{
+	CanCtrlPltfCOb3 *pltf = getPlatform(state);
+	if(pltf == NULL)
+		return;
+
+	std::vector<CanCtrlPltfCOb3::MotorStateType> states;
+	while(state.keepRunning())
+	{
+		for(int i=0; i<s_Platform.iNumMotors; i++)
+			pltf->setVelGearRadS(i, 0.5);
+		pltf->sendSync();
+		pltf->evalCanBuffer();
+		pltf->getMotorStates(&states);
+	}
+}
+MICRO_BENCHMARK(Pltf_ControlCycle);
+
+MICRO_BENCHMARK_MAIN()
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+/*
+ * Runs the control cycle of CanCtrlPltfCOb3 against simulated drives at a fixed rate.
+ *
+ * usage: pltf_benchmark ini_directory [rate_hz] [seconds]
+ *
+ * The ini directory holds Platform.ini and CanCtrl.ini of the robot, with [TypeCan] Can=3 in
+ * CanCtrl.ini to run on the virtual CAN bus. Each cycle sends the velocities of all motors and
+ * the SYNC, evaluates the CAN buffer and reads back positions and velocities, like the ROS node.
+ * Reports the cycle time, missed deadlines and the traffic of the bus.
+ */
+
+#include <cob_base_drive_chain/CanCtrlPltfCOb3.h>
+#include <cob_utilities/IniFile.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+static double getTime()
+{
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+	return sorted[std::min(sorted.size()-1, size_t(p*sorted.size()))];
+}
+
+int main(int argc, char** argv)
+{
+	if(argc<2)
+	{
+		std::cout << "usage: pltf_benchmark ini_directory [rate_hz] [seconds]" << std::endl;
+		return 1;
+	}
+
+	std::string ini_directory = argv[1];
+	if(ini_directory[ini_directory.size()-1] != '/')
+		ini_directory += "/";
+	const double rate = (argc>2) ? atof(argv[2]) : 500;
+	const double duration = (argc>3) ? atof(argv[3]) : 10;
+	const double period = 1.0/rate;
+
+	IniFile ini_file;
+	int num_motors = 8;
+	ini_file.SetFileName(ini_directory + "Platform.ini", "pltf_benchmark.cpp");
+	ini_file.GetKeyInt("Config", "NumberOfMotors", &num_motors, true);
+
+	CanCtrlPltfCOb3 pltf(ini_directory);
+	if(!pltf.initPltf())
+	{
+		std::cout << "could not initialize the platform" << std::endl;
+		return 1;
+	}
+
+	CanStatistics::Snapshot stats_start, stats_end;
+	const bool has_stats = pltf.getCanStatistics(&stats_start);
+
+	std::vector<double> cycle_time;
+	cycle_time.reserve(size_t(rate*duration) + 1);
+	unsigned int missed = 0;
+
+	std::vector<CanCtrlPltfCOb3::MotorStateType> states;
+	const double start = getTime();
+	double next = start;
+	while(next - start < duration)
+	{
+		const double t = getTime();
+		const double vel = 0.5*sin(t - start);
+
+		for(int i=0; i<num_motors; i++)
+			pltf.setVelGearRadS(i, vel);
+		pltf.sendSync();
+		pltf.evalCanBuffer();
+		pltf.getMotorStates(&states);
+
+		const double end = getTime();
+		cycle_time.push_back(end - t);
+
+		next += period;
+		if(end > next)
+		{
+			missed++;
+			// start over instead of catching up with a burst of cycles
+			next = end;
+		}
+		else
+			usleep((unsigned int)(1e6*(next - end)));
+	}
+	const double elapsed = getTime() - start;
+
+	if(cycle_time.empty())
+	{
+		std::cout << "no cycles run" << std::endl;
+		return 1;
+	}
+
+	std::sort(cycle_time.begin(), cycle_time.end());
+	std::cout << "cycles:   " << cycle_time.size() << " (" << missed << " missed deadlines)" << std::endl;
+	std::cout << "rate:     " << cycle_time.size()/elapsed << " Hz" << std::endl;
+	std::cout << "cycle:    p50 " << 1e6*percentile(cycle_time, 0.5) << " us, p99 " << 1e6*percentile(cycle_time, 0.99)
+			<< " us, max " << 1e6*cycle_time.back() << " us" << std::endl;
+
+	if(has_stats && pltf.getCanStatistics(&stats_end))
+	{
+		std::cout << "can:      " << (stats_end.ulTxFrames - stats_start.ulTxFrames)/elapsed << " tx/s, "
+				<< (stats_end.ulRxFrames - stats_start.ulRxFrames)/elapsed << " rx/s, "
+				<< (stats_end.ulErrors - stats_start.ulErrors) << " errors on "
+				<< pltf.getNumCanBuses() << " bus(es)" << std::endl;
+	}
+
+	pltf.shutdownPltf();
+	return 0;
+}
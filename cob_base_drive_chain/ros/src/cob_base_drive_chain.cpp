@@ -19,16 +19,25 @@
 //#### includes ####
 
 // standard includes
-//--
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <time.h>
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
 
 // ROS includes
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 
 // ROS message includes
 #include <std_msgs/Float64.h>
+#include <std_msgs/Float64MultiArray.h>
 #include <sensor_msgs/JointState.h>
 #include <diagnostic_msgs/DiagnosticStatus.h>
 #include <diagnostic_msgs/DiagnosticArray.h>
+#include <diagnostic_msgs/KeyValue.h>
 #include <control_msgs/JointTrajectoryControllerState.h>
 #include <control_msgs/JointControllerState.h>
 
@@ -36,10 +45,18 @@
 #include <std_srvs/Trigger.h>
 #include <cob_base_drive_chain/ElmoRecorderReadout.h>
 #include <cob_base_drive_chain/ElmoRecorderConfig.h>
+#include <cob_base_drive_chain/DriveTelemetry.h>
 
 
 // external includes
 #include <cob_base_drive_chain/CanCtrlPltfCOb3.h>
+#include <cob_base_drive_chain/SetpointInterpolator.h>
+#include <cob_utilities/TripleBuffer.h>
+#include <cob_utilities/RobotStateBlackboard.h>
+#include <cob_utilities/LatencyHistogram.h>
+#include <cob_utilities/RealTime.h>
+#include <cob_utilities/Trace.h>
+#include <cob_undercarriage_ctrl/undercarriage_ctrl_node.h>
 #include <cob_utilities/IniFile.h>
 #include <cob_utilities/MathSup.h>
 
@@ -54,6 +71,14 @@ class NodeClass
 		// create a handle for this node, initialize node
 		ros::NodeHandle n;
 
+		/**
+		* Services and the global diagnostics are served by their own spinner thread from this queue,
+		* so a slow service (e.g. the Elmo Recorder read-out or a recover) does not delay the control cycle.
+		* The joint commands stay on the global queue, which is spun by the control loop.
+		* Services which use the bus take m_IOMutex, the control loop skips its bus access while they hold it.
+		*/
+		ros::CallbackQueue m_ServiceQueue;
+
 		// topics to publish
 		/**
 		* On this topic "JointState" of type sensor_msgs::JointState the node publishes joint states
@@ -69,6 +94,11 @@ class NodeClass
 		*/
 		ros::Publisher topicPub_Diagnostic;
 
+		/**
+		* On this topic "telemetry" of type cob_base_drive_chain::DriveTelemetry the node publishes the samples streamed by each drive (Platform.ini: Config/TelemetryPeriodMS).
+		*/
+		ros::Publisher topicPub_Telemetry;
+
                 /**
                 * Timer to publish global diagnostic messages
                 */
@@ -139,13 +169,141 @@ class NodeClass
 		ros::Time m_gazeboStamp;
 
 		ros::Subscriber topicSub_GazeboJointStates;
+
+		/**
+		* Optional single command message for all joints (parameter "SimBatchedCmd"), in the joint order
+		* of the state topic, e.g. for a velocity group controller, instead of the 8 Float64 topics.
+		*/
+		bool m_bSimBatchedCmd;
+		ros::Publisher topicPub_SimCmd;
+		std_msgs::Float64MultiArray m_SimCmdMsg;
+
+		/**
+		* Lock-step simulation (parameter "SimLockStep"): each joint state of the simulation triggers
+		* one cycle of this node, so it runs with /clock at any real time factor of the simulation.
+		*/
+		bool m_bSimLockStep;
 #else
 		CanCtrlPltfCOb3 *m_CanCtrlPltf;
+
+		/**
+		* Optional real-time thread doing the CAN I/O with fixed period, decoupled from ROS callbacks.
+		* Measurements and commands are exchanged through wait-free buffers.
+		*/
+		struct IOStateType
+		{
+			std::vector<double> vdAngGearRad;
+			std::vector<double> vdVelGearRad;
+			std::vector<double> vdEffortGearNM;
+		};
+		struct IOCmdType
+		{
+			std::vector<double> vdVelGearRadS;
+			std::vector<double> vdEffortGearNm;
+			// reception time on CLOCK_MONOTONIC in s
+			double dTimeS;
+		};
+		bool m_bUseIOThread;
+		int m_iIOThreadPriority;
+		int m_iIOThreadCpu;
+		double m_dIOThreadRate;
+		boost::thread m_IOThread;
+		boost::atomic<bool> m_bIOThreadRunning;
+		// held by the I/O thread (or the control cycle without it) during a cycle and by services that need the bus for themselves
+		boost::mutex m_IOMutex;
+		boost::scoped_ptr<TripleBuffer<IOStateType> > m_pIOState;
+		boost::scoped_ptr<TripleBuffer<IOCmdType> > m_pIOCmd;
+
+		/**
+		* Optional setpoint interpolation in the I/O thread (parameter "InterpolateCmds").
+		* The drives get a new setpoint every I/O cycle, extrapolated and jerk-limited between the commands.
+		*/
+		bool m_bInterpolateCmds;
+		double m_dInterpolatorMaxAccDrive;
+		double m_dInterpolatorMaxAccSteer;
+		double m_dInterpolatorMaxJerk;
+		double m_dInterpolatorExtrapolation;
+		double m_dInterpolatorTimeout;
+		// only used by the I/O thread and with m_IOMutex held
+		SetpointInterpolator m_Interpolator;
+
+		/**
+		* Optional torque control (parameter "TorqueControl"), needs the I/O thread.
+		* The drives are switched to current control after the initialization. The desired efforts of
+		* "joint_command" are sent to all drives every I/O cycle, followed by one SYNC, and the currents
+		* measured on that SYNC are published as efforts.
+		*/
+		bool m_bTorqueCtrl;
+		// efforts older than this are replaced by zero torque
+		double m_dTorqueCmdTimeout;
+
+		/**
+		* Robot state shared with the relayboard and battery drivers (parameter "Blackboard").
+		* The drive state is written every cycle. With "HaltOnBlackboardEMStop" the drives are commanded to
+		* zero velocity as long as the EM-Stop on the blackboard is not free or older than "BlackboardTimeout".
+		*/
+		RobotStateBlackboard m_Blackboard;
+		bool m_bHaltOnEMStop;
+		double m_dBlackboardTimeout;
+
+		bool isEMStopOnBlackboard()
+		{
+			if(!m_bHaltOnEMStop)
+				return false;
+			RobotStateBlackboard::EmergencyStopData emStop;
+			if(m_Blackboard.readEmergencyStop(&emStop) == 0)
+				return true;
+			// 0 is EMFREE of cob_msgs/EmergencyStopState
+			return emStop.iState != 0 || !emStop.bOnline ||
+				(RobotStateBlackboard::getMonotonicTime() - emStop.dStampS > m_dBlackboardTimeout);
+		}
+
+		// CAN traffic of the last diagnostics period
+		int m_iCanBitrate;
+		CanStatistics::Snapshot m_LastCanStats;
+		ros::Time m_LastCanStatsTime;
 #endif
-		bool m_bisInitialized;
+		// period of cycle(), and for the I/O thread the lateness of its wake-up and the duration of a cycle
+		LatencyHistogram m_CycleHist;
+		double m_dLastCycleS;
+		// page faults of the cycle and I/O loops, major faults are reported as a warning
+		PageFaultCounter m_CyclePageFaults;
+#ifndef __SIM__
+		LatencyHistogram m_IOWakeupHist;
+		LatencyHistogram m_IOCycleHist;
+		PageFaultCounter m_IOPageFaults;
+#endif
+		boost::atomic<bool> m_bisInitialized;
 		int m_iNumMotors;
 		int m_iNumDrives;
 
+		// published every cycle, names and sizes are set once in initJointStateMsgs()
+		sensor_msgs::JointState m_JointStateMsg;
+		control_msgs::JointTrajectoryControllerState m_ControllerStateMsg;
+#ifndef __SIM__
+		// latest states of the drives, read without taking the lock of the CAN receive path
+		CanCtrlPltfCOb3::TelemetrySnapshotType m_Telemetry;
+#endif
+
+		void initJointStateMsgs()
+		{
+			static const char* c_pcJointNames[] = { "fl_caster_r_wheel_joint", "fl_caster_rotation_joint",
+				"bl_caster_r_wheel_joint", "bl_caster_rotation_joint", "br_caster_r_wheel_joint", "br_caster_rotation_joint",
+				"fr_caster_r_wheel_joint", "fr_caster_rotation_joint" };
+
+			m_JointStateMsg.name.assign(c_pcJointNames, c_pcJointNames + m_iNumMotors);
+			m_JointStateMsg.position.assign(m_iNumMotors, 0.0);
+			m_JointStateMsg.velocity.assign(m_iNumMotors, 0.0);
+			m_JointStateMsg.effort.assign(m_iNumMotors, 0.0);
+
+			m_ControllerStateMsg.joint_names = m_JointStateMsg.name;
+			m_ControllerStateMsg.actual.positions.assign(m_iNumMotors, 0.0);
+			m_ControllerStateMsg.actual.velocities.assign(m_iNumMotors, 0.0);
+#ifndef __SIM__
+			m_Telemetry.vStates.resize(m_iNumMotors);
+#endif
+		}
+
 		struct ParamType
 		{
 			double dMaxDriveRateRadpS;
@@ -157,7 +315,17 @@ class NodeClass
 
 		std::string sIniDirectory;
 		bool m_bPubEffort;
-		bool m_bReadoutElmo;
+		bool m_bElmoRecorderBinaryLog;
+		boost::atomic<bool> m_bReadoutElmo;
+		// error state of the last evaluation of the drives, for the global diagnostics
+		boost::atomic<bool> m_bPltfError;
+
+		/**
+		* Optional undercarriage controller running in this process (parameter "FusedUndercarriageCtrl").
+		* It gets the joint states right after the drives are read and its commands are sent to the
+		* drives directly, instead of through the topics "state" and "joint_command".
+		*/
+		boost::scoped_ptr<UndercarriageCtrlNode> m_pUndercarriageCtrl;
 
 		// Constructor
 		NodeClass()
@@ -178,6 +346,8 @@ class NodeClass
 			n.param<bool>("PublishEffort", m_bPubEffort, false);
 			if(m_bPubEffort) ROS_INFO("You have choosen to publish effort of motors, that charges capacity of CAN");
 
+			n.param<bool>("ElmoRecorderBinaryLog", m_bElmoRecorderBinaryLog, false);
+
 
 			IniFile iniFile;
 			iniFile.SetFileName(sIniDirectory + "Platform.ini", "PltfHardwareCoB3.h");
@@ -189,16 +359,32 @@ class NodeClass
 				m_iNumMotors = 8;
 				m_iNumDrives = 4;
 			}
+			initJointStateMsgs();
 
 #ifdef __SIM__
-			bl_caster_pub = n.advertise<std_msgs::Float64>("/base_bl_caster_r_wheel_controller/command", 1);
-			br_caster_pub = n.advertise<std_msgs::Float64>("/base_br_caster_r_wheel_controller/command", 1);
-			fl_caster_pub = n.advertise<std_msgs::Float64>("/base_fl_caster_r_wheel_controller/command", 1);
-			fr_caster_pub = n.advertise<std_msgs::Float64>("/base_fr_caster_r_wheel_controller/command", 1);
-			bl_steer_pub = n.advertise<std_msgs::Float64>("/base_bl_caster_rotation_controller/command", 1);
-			br_steer_pub = n.advertise<std_msgs::Float64>("/base_br_caster_rotation_controller/command", 1);
-			fl_steer_pub = n.advertise<std_msgs::Float64>("/base_fl_caster_rotation_controller/command", 1);
-			fr_steer_pub = n.advertise<std_msgs::Float64>("/base_fr_caster_rotation_controller/command", 1);
+			n.param<bool>("SimBatchedCmd", m_bSimBatchedCmd, false);
+			n.param<bool>("SimLockStep", m_bSimLockStep, false);
+			if(m_bSimBatchedCmd)
+			{
+				std::string sSimCmdTopic;
+				n.param<std::string>("SimCmdTopic", sSimCmdTopic, "/base_controller/command");
+				ROS_INFO("Joint commands are sent in one message on %s", sSimCmdTopic.c_str());
+				topicPub_SimCmd = n.advertise<std_msgs::Float64MultiArray>(sSimCmdTopic, 1);
+				m_SimCmdMsg.data.assign(m_iNumMotors, 0.0);
+			}
+			else
+			{
+				bl_caster_pub = n.advertise<std_msgs::Float64>("/base_bl_caster_r_wheel_controller/command", 1);
+				br_caster_pub = n.advertise<std_msgs::Float64>("/base_br_caster_r_wheel_controller/command", 1);
+				fl_caster_pub = n.advertise<std_msgs::Float64>("/base_fl_caster_r_wheel_controller/command", 1);
+				fr_caster_pub = n.advertise<std_msgs::Float64>("/base_fr_caster_r_wheel_controller/command", 1);
+				bl_steer_pub = n.advertise<std_msgs::Float64>("/base_bl_caster_rotation_controller/command", 1);
+				br_steer_pub = n.advertise<std_msgs::Float64>("/base_br_caster_rotation_controller/command", 1);
+				fl_steer_pub = n.advertise<std_msgs::Float64>("/base_fl_caster_rotation_controller/command", 1);
+				fr_steer_pub = n.advertise<std_msgs::Float64>("/base_fr_caster_rotation_controller/command", 1);
+			}
+			if(m_bSimLockStep)
+				ROS_INFO("Cycles are triggered by the joint states of the simulation");
 
 			topicSub_GazeboJointStates = n.subscribe("/joint_states", 1, &NodeClass::gazebo_joint_states_Callback, this);
 
@@ -206,7 +392,98 @@ class NodeClass
 			m_gazeboVel.resize(m_iNumMotors);
 #else
 			topicPub_JointState = n.advertise<sensor_msgs::JointState>("/joint_states", 1);
-			m_CanCtrlPltf = new CanCtrlPltfCOb3(sIniDirectory);
+			{
+				TRACE_PHASE("NodeClass::openCan");
+				m_CanCtrlPltf = new CanCtrlPltfCOb3(sIniDirectory);
+			}
+
+			n.param<int>("CanBitrate", m_iCanBitrate, 1000000);
+			memset(&m_LastCanStats, 0, sizeof(m_LastCanStats));
+
+			n.param<bool>("UseIOThread", m_bUseIOThread, false);
+			n.param<int>("IOThreadPriority", m_iIOThreadPriority, 80);
+			n.param<int>("IOThreadCpu", m_iIOThreadCpu, -1);
+			n.param<double>("IOThreadRate", m_dIOThreadRate, 100.0);
+			if(m_dIOThreadRate <= 0.0)
+			{
+				ROS_WARN("IOThreadRate must be positive, using 100 Hz");
+				m_dIOThreadRate = 100.0;
+			}
+
+			// locked memory needs the according memlock limit, run without it otherwise
+			bool bLockMemory;
+			int iPrefaultHeapMB;
+			n.param<bool>("LockMemory", bLockMemory, false);
+			n.param<int>("PrefaultHeapMB", iPrefaultHeapMB, 16);
+			if(bLockMemory)
+			{
+				std::string sError;
+				if(RealTime::lockMemory((size_t)std::max(iPrefaultHeapMB, 0) << 20, &sError))
+					ROS_INFO("Memory locked, %d MB heap prefaulted", iPrefaultHeapMB);
+				else
+					ROS_WARN("Could not lock memory: %s", sError.c_str());
+			}
+
+			std::string sBlackboard;
+			n.param<std::string>("Blackboard", sBlackboard, "cob_robot_state");
+			n.param<bool>("HaltOnBlackboardEMStop", m_bHaltOnEMStop, false);
+			n.param<double>("BlackboardTimeout", m_dBlackboardTimeout, 0.5);
+			if(!sBlackboard.empty() && !m_Blackboard.open(sBlackboard))
+				ROS_WARN("Could not open the robot state blackboard '%s'", sBlackboard.c_str());
+			if(m_bHaltOnEMStop && !m_Blackboard.isOpen())
+			{
+				ROS_WARN("HaltOnBlackboardEMStop needs the blackboard, drives are not halted on EM-Stop");
+				m_bHaltOnEMStop = false;
+			}
+
+			n.param<bool>("InterpolateCmds", m_bInterpolateCmds, false);
+			n.param<double>("InterpolatorMaxAccDrive", m_dInterpolatorMaxAccDrive, 20.0);
+			n.param<double>("InterpolatorMaxAccSteer", m_dInterpolatorMaxAccSteer, 20.0);
+			n.param<double>("InterpolatorMaxJerk", m_dInterpolatorMaxJerk, 500.0);
+			n.param<double>("InterpolatorExtrapolation", m_dInterpolatorExtrapolation, 0.1);
+			n.param<double>("InterpolatorTimeout", m_dInterpolatorTimeout, 0.5);
+			if(m_bInterpolateCmds && !m_bUseIOThread)
+			{
+				ROS_WARN("InterpolateCmds needs the I/O thread (UseIOThread), commands are sent unchanged");
+				m_bInterpolateCmds = false;
+			}
+
+			n.param<bool>("TorqueControl", m_bTorqueCtrl, false);
+			n.param<double>("TorqueCmdTimeout", m_dTorqueCmdTimeout, 0.1);
+			if(m_bTorqueCtrl && !m_bUseIOThread)
+			{
+				ROS_WARN("TorqueControl needs the I/O thread (UseIOThread), drives stay in velocity control");
+				m_bTorqueCtrl = false;
+			}
+			if(m_bTorqueCtrl)
+			{
+				if(m_bInterpolateCmds)
+					ROS_WARN("InterpolateCmds only applies to velocities, it is ignored with TorqueControl");
+				m_bInterpolateCmds = false;
+				m_bPubEffort = true;
+			}
+
+			IOStateType state;
+			state.vdAngGearRad.assign(m_iNumMotors, 0.0);
+			state.vdVelGearRad.assign(m_iNumMotors, 0.0);
+			state.vdEffortGearNM.assign(m_iNumMotors, 0.0);
+			m_pIOState.reset(new TripleBuffer<IOStateType>(state));
+			IOCmdType cmd;
+			cmd.vdVelGearRadS.assign(m_iNumMotors, 0.0);
+			cmd.vdEffortGearNm.assign(m_iNumMotors, 0.0);
+			cmd.dTimeS = 0.0;
+			m_pIOCmd.reset(new TripleBuffer<IOCmdType>(cmd));
+
+			m_bIOThreadRunning = m_bUseIOThread;
+			if(m_bUseIOThread)
+			{
+				ROS_INFO("CAN I/O runs in a separate thread at %.1f Hz", m_dIOThreadRate);
+				if(m_bInterpolateCmds)
+					ROS_INFO("Joint commands are interpolated at the I/O rate");
+				if(m_bTorqueCtrl)
+					ROS_INFO("Drives are torque controlled, efforts are sent at the I/O rate");
+				m_IOThread = boost::thread(&NodeClass::ioThread, this);
+			}
 #endif
 
 			// implementation of topics
@@ -215,20 +492,37 @@ class NodeClass
 			topicPub_DiagnosticGlobal_ = n.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
 
 			topicPub_Diagnostic = n.advertise<diagnostic_msgs::DiagnosticStatus>("diagnostic", 1);
+#ifndef __SIM__
+			topicPub_Telemetry = n.advertise<cob_base_drive_chain::DriveTelemetry>("telemetry", 10);
+#endif
 			// subscribed topics
-			topicSub_JointStateCmd = n.subscribe("joint_command", 1, &NodeClass::topicCallback_JointStateCmd, this);
-
-			// implementation of service servers
-			srvServer_Init = n.advertiseService("init", &NodeClass::srvCallback_Init, this);
-			srvServer_ElmoRecorderConfig = n.advertiseService("ElmoRecorderConfig", &NodeClass::srvCallback_ElmoRecorderConfig, this);
-			srvServer_ElmoRecorderReadout = n.advertiseService("ElmoRecorderReadout", &NodeClass::srvCallback_ElmoRecorderReadout, this);
+			bool bFusedUndercarriageCtrl;
+			n.param<bool>("FusedUndercarriageCtrl", bFusedUndercarriageCtrl, false);
+			if(bFusedUndercarriageCtrl)
+			{
+				ROS_INFO("Undercarriage controller runs in the drive chain process");
+				m_pUndercarriageCtrl.reset(new UndercarriageCtrlNode(true));
+				m_pUndercarriageCtrl->setJointCmdSink(boost::bind(&NodeClass::setJointCmd, this, _1));
+				if(!m_pUndercarriageCtrl->InitCtrl())
+					throw std::runtime_error("Undercarriage control initialization failed, check ini-Files!");
+			}
+			else
+				topicSub_JointStateCmd = n.subscribe("joint_command", 1, &NodeClass::topicCallback_JointStateCmd, this);
+
+			// implementation of service servers, on the service queue
+			ros::NodeHandle srv_n(n);
+			srv_n.setCallbackQueue(&m_ServiceQueue);
+			srvServer_Init = srv_n.advertiseService("init", &NodeClass::srvCallback_Init, this);
+			srvServer_ElmoRecorderConfig = srv_n.advertiseService("ElmoRecorderConfig", &NodeClass::srvCallback_ElmoRecorderConfig, this);
+			srvServer_ElmoRecorderReadout = srv_n.advertiseService("ElmoRecorderReadout", &NodeClass::srvCallback_ElmoRecorderReadout, this);
 			m_bReadoutElmo = false;
+			m_bPltfError = false;
 
-			srvServer_Recover = n.advertiseService("recover", &NodeClass::srvCallback_Recover, this);
-			srvServer_Shutdown = n.advertiseService("shutdown", &NodeClass::srvCallback_Shutdown, this);
+			srvServer_Recover = srv_n.advertiseService("recover", &NodeClass::srvCallback_Recover, this);
+			srvServer_Shutdown = srv_n.advertiseService("shutdown", &NodeClass::srvCallback_Shutdown, this);
 
 		        //Timer for publishing global diagnostics
-		        glDiagnostics_timer = n.createTimer(ros::Duration(1), &NodeClass::publish_globalDiagnostics, this);
+		        glDiagnostics_timer = srv_n.createTimer(ros::Duration(1), &NodeClass::publish_globalDiagnostics, this);
 
 			// initialization of variables
 #ifdef __SIM__
@@ -236,6 +530,7 @@ class NodeClass
 #else
 			m_bisInitialized = false;
 #endif
+			m_dLastCycleS = 0.0;
 
 		}
 
@@ -245,6 +540,9 @@ class NodeClass
 #ifdef __SIM__
 
 #else
+			m_bIOThreadRunning = false;
+			if(m_IOThread.joinable())
+				m_IOThread.join();
 			m_CanCtrlPltf->shutdownPltf();
 #endif
 		}
@@ -254,6 +552,12 @@ class NodeClass
 		void topicCallback_JointStateCmd(const control_msgs::JointTrajectoryControllerState::ConstPtr& msg)
 		{
 			ROS_DEBUG("Topic Callback joint_command");
+			setJointCmd(*msg);
+		}
+
+		// clamps the joint commands and sends them to the drives
+		void setJointCmd(const control_msgs::JointTrajectoryControllerState& msg)
+		{
 			// only process cmds when system is initialized
 			if(m_bisInitialized == true)
 			{
@@ -262,70 +566,75 @@ class NodeClass
 				JointStateCmd.position.resize(m_iNumMotors);
 				JointStateCmd.velocity.resize(m_iNumMotors);
 				JointStateCmd.effort.resize(m_iNumMotors);
+				// the efforts are optional, they are only used in torque control
+				const bool bEffort = (msg.desired.effort.size() == msg.joint_names.size());
 
-				for(unsigned int i = 0; i < msg->joint_names.size(); i++)
+				for(unsigned int i = 0; i < msg.joint_names.size(); i++)
 				{
 					// associate inputs to according steer and drive joints
 					// ToDo: specify this globally (Prms-File or config-File or via msg-def.)
 					// check if velocities lie inside allowed boundaries
 
 					//DRIVES
-					if(msg->joint_names[i] ==  "fl_caster_r_wheel_joint")
+					if(msg.joint_names[i] ==  "fl_caster_r_wheel_joint")
 					{
-							JointStateCmd.position[0] = msg->desired.positions[i];
-							JointStateCmd.velocity[0] = msg->desired.velocities[i];
-							//JointStateCmd.effort[0] = msg->effort[i];
+							JointStateCmd.position[0] = msg.desired.positions[i];
+							JointStateCmd.velocity[0] = msg.desired.velocities[i];
+							if(bEffort) JointStateCmd.effort[0] = msg.desired.effort[i];
 					}
-					else if(m_iNumDrives>=2 && msg->joint_names[i] ==  "bl_caster_r_wheel_joint")
+					else if(m_iNumDrives>=2 && msg.joint_names[i] ==  "bl_caster_r_wheel_joint")
 					{
-							JointStateCmd.position[2] = msg->desired.positions[i];
-							JointStateCmd.velocity[2] = msg->desired.velocities[i];
-							//JointStateCmd.effort[2] = msg->effort[i];
+							JointStateCmd.position[2] = msg.desired.positions[i];
+							JointStateCmd.velocity[2] = msg.desired.velocities[i];
+							if(bEffort) JointStateCmd.effort[2] = msg.desired.effort[i];
 					}
-					else if(m_iNumDrives>=3 && msg->joint_names[i] ==  "br_caster_r_wheel_joint")
+					else if(m_iNumDrives>=3 && msg.joint_names[i] ==  "br_caster_r_wheel_joint")
 					{
-							JointStateCmd.position[4] = msg->desired.positions[i];
-							JointStateCmd.velocity[4] = msg->desired.velocities[i];
-							//JointStateCmd.effort[4] = msg->effort[i];
+							JointStateCmd.position[4] = msg.desired.positions[i];
+							JointStateCmd.velocity[4] = msg.desired.velocities[i];
+							if(bEffort) JointStateCmd.effort[4] = msg.desired.effort[i];
 					}
-					else if(m_iNumDrives>=4 && msg->joint_names[i] ==  "fr_caster_r_wheel_joint")
+					else if(m_iNumDrives>=4 && msg.joint_names[i] ==  "fr_caster_r_wheel_joint")
 					{
-							JointStateCmd.position[6] = msg->desired.positions[i];
-							JointStateCmd.velocity[6] = msg->desired.velocities[i];
-							//JointStateCmd.effort[6] = msg->effort[i];
+							JointStateCmd.position[6] = msg.desired.positions[i];
+							JointStateCmd.velocity[6] = msg.desired.velocities[i];
+							if(bEffort) JointStateCmd.effort[6] = msg.desired.effort[i];
 					}
 					//STEERS
-					else if(msg->joint_names[i] ==  "fl_caster_rotation_joint")
+					else if(msg.joint_names[i] ==  "fl_caster_rotation_joint")
 					{
-							JointStateCmd.position[1] = msg->desired.positions[i];
-							JointStateCmd.velocity[1] = msg->desired.velocities[i];
-							//JointStateCmd.effort[1] = msg->effort[i];
+							JointStateCmd.position[1] = msg.desired.positions[i];
+							JointStateCmd.velocity[1] = msg.desired.velocities[i];
+							if(bEffort) JointStateCmd.effort[1] = msg.desired.effort[i];
 					}
-					else if(m_iNumDrives>=2 && msg->joint_names[i] ==  "bl_caster_rotation_joint")
+					else if(m_iNumDrives>=2 && msg.joint_names[i] ==  "bl_caster_rotation_joint")
 					{
-							JointStateCmd.position[3] = msg->desired.positions[i];
-							JointStateCmd.velocity[3] = msg->desired.velocities[i];
-							//JointStateCmd.effort[3] = msg->effort[i];
+							JointStateCmd.position[3] = msg.desired.positions[i];
+							JointStateCmd.velocity[3] = msg.desired.velocities[i];
+							if(bEffort) JointStateCmd.effort[3] = msg.desired.effort[i];
 					}
-					else if(m_iNumDrives>=3 && msg->joint_names[i] ==  "br_caster_rotation_joint")
+					else if(m_iNumDrives>=3 && msg.joint_names[i] ==  "br_caster_rotation_joint")
 					{
-							JointStateCmd.position[5] = msg->desired.positions[i];
-							JointStateCmd.velocity[5] = msg->desired.velocities[i];
-							//JointStateCmd.effort[5] = msg->effort[i];
+							JointStateCmd.position[5] = msg.desired.positions[i];
+							JointStateCmd.velocity[5] = msg.desired.velocities[i];
+							if(bEffort) JointStateCmd.effort[5] = msg.desired.effort[i];
 					}
-					else if(m_iNumDrives>=4 && msg->joint_names[i] ==  "fr_caster_rotation_joint")
+					else if(m_iNumDrives>=4 && msg.joint_names[i] ==  "fr_caster_rotation_joint")
 					{
-							JointStateCmd.position[7] = msg->desired.positions[i];
-							JointStateCmd.velocity[7] = msg->desired.velocities[i];
-							//JointStateCmd.effort[7] = msg->effort[i];
+							JointStateCmd.position[7] = msg.desired.positions[i];
+							JointStateCmd.velocity[7] = msg.desired.velocities[i];
+							if(bEffort) JointStateCmd.effort[7] = msg.desired.effort[i];
 					}
 					else
 					{
-						ROS_ERROR("Unkown joint name %s", (msg->joint_names[i]).c_str());
+						ROS_ERROR("Unkown joint name %s", (msg.joint_names[i]).c_str());
 					}
 				}
 
 
+#ifndef __SIM__
+				const bool bHalt = isEMStopOnBlackboard();
+#endif
 				// check if velocities lie inside allowed boundaries
 				for(int i = 0; i < m_iNumMotors; i++)
 				{
@@ -355,41 +664,68 @@ class NodeClass
 							JointStateCmd.velocity[i] = -m_Param.dMaxDriveRateRadpS;
 						}
 					}
+					if(bHalt)
+					{
+						JointStateCmd.velocity[i] = 0.0;
+						JointStateCmd.effort[i] = 0.0;
+					}
 #endif
 #ifdef __SIM__
+					if(m_bSimBatchedCmd)
+						continue;
 					ROS_DEBUG("Send velocity data to gazebo");
 					std_msgs::Float64 fl;
 					fl.data = JointStateCmd.velocity[i];
-					if(msg->joint_names[i] == "fl_caster_r_wheel_joint")
+					if(msg.joint_names[i] == "fl_caster_r_wheel_joint")
 						fl_caster_pub.publish(fl);
-					if(msg->joint_names[i] == "fr_caster_r_wheel_joint")
+					if(msg.joint_names[i] == "fr_caster_r_wheel_joint")
 						fr_caster_pub.publish(fl);
-					if(msg->joint_names[i] == "bl_caster_r_wheel_joint")
+					if(msg.joint_names[i] == "bl_caster_r_wheel_joint")
 						bl_caster_pub.publish(fl);
-					if(msg->joint_names[i] == "br_caster_r_wheel_joint")
+					if(msg.joint_names[i] == "br_caster_r_wheel_joint")
 						br_caster_pub.publish(fl);
 
-					if(msg->joint_names[i] == "fl_caster_rotation_joint")
+					if(msg.joint_names[i] == "fl_caster_rotation_joint")
 						fl_steer_pub.publish(fl);
-					if(msg->joint_names[i] == "fr_caster_rotation_joint")
+					if(msg.joint_names[i] == "fr_caster_rotation_joint")
 						fr_steer_pub.publish(fl);
-					if(msg->joint_names[i] == "bl_caster_rotation_joint")
+					if(msg.joint_names[i] == "bl_caster_rotation_joint")
 						bl_steer_pub.publish(fl);
-					if(msg->joint_names[i] == "br_caster_rotation_joint")
+					if(msg.joint_names[i] == "br_caster_rotation_joint")
 						br_steer_pub.publish(fl);
 					ROS_DEBUG("Successfully sent velicities to gazebo");
-#else
-					ROS_DEBUG("Send velocity data to drives");
-					m_CanCtrlPltf->setVelGearRadS(i, JointStateCmd.velocity[i]);
-					ROS_DEBUG("Successfully sent velicities to drives");
 #endif
 				}
 
 #ifdef __SIM__
-
+				if(m_bSimBatchedCmd) {
+					m_SimCmdMsg.data = JointStateCmd.velocity;
+					topicPub_SimCmd.publish(m_SimCmdMsg);
+				}
 #else
-				if(m_bPubEffort) {
-					m_CanCtrlPltf->requestMotorTorque();
+				if(m_bUseIOThread) {
+					// sent by the I/O thread with the next cycle
+					IOCmdType& cmd = m_pIOCmd->writeSlot();
+					cmd.vdVelGearRadS = JointStateCmd.velocity;
+					cmd.vdEffortGearNm = JointStateCmd.effort;
+					cmd.dTimeS = getMonotonicTime();
+					m_pIOCmd->publish();
+				}
+				else {
+					// a service has the bus, the drives keep the previous setpoints until the next command
+					boost::mutex::scoped_try_lock lock(m_IOMutex);
+					if(!lock.owns_lock()) {
+						ROS_DEBUG("Bus in use by a service, joint command dropped");
+						return;
+					}
+					ROS_DEBUG("Send velocity data to drives");
+					for(int i = 0; i < m_iNumMotors; i++)
+						m_CanCtrlPltf->setVelGearRadS(i, JointStateCmd.velocity[i]);
+					ROS_DEBUG("Successfully sent velicities to drives");
+					m_CanCtrlPltf->sendSync();
+					if(m_bPubEffort) {
+						m_CanCtrlPltf->requestMotorTorque();
+					}
 				}
 #endif
 			}
@@ -405,6 +741,9 @@ class NodeClass
 			ROS_DEBUG("Service callback init");
 			if(m_bisInitialized == false)
 			{
+#ifndef __SIM__
+				boost::mutex::scoped_lock lock(m_IOMutex);
+#endif
 				m_bisInitialized = initDrives();
 				//ROS_INFO("...initializing can-nodes...");
 				//m_bisInitialized = m_CanCtrlPltf->initPltf();
@@ -412,6 +751,7 @@ class NodeClass
 				if(m_bisInitialized)
 				{
 		   			ROS_INFO("base initialized");
+					ROS_INFO_STREAM("startup phases:\n" << Trace::getPhaseSummary());
 				}
 				else
 				{
@@ -435,6 +775,7 @@ class NodeClass
 #ifdef __SIM__
 				res.success = true;
 #else
+				boost::mutex::scoped_lock lock(m_IOMutex);
 				m_CanCtrlPltf->evalCanBuffer();
 				res.success = m_CanCtrlPltf->ElmoRecordings(0, req.recordinggap, "");
 #endif
@@ -444,12 +785,22 @@ class NodeClass
 			return true;
 		}
 
+		// called by the platform for each motor, while the read-outs of the other motors may still run
+		void elmoReadoutDone(int iDriveID, int iRecordedSource, bool bSuccess)
+		{
+			if(bSuccess)
+				ROS_INFO("Elmo Recorder read-out of source %d of motor %d written", iRecordedSource, iDriveID);
+			else
+				ROS_WARN("Elmo Recorder read-out of source %d of motor %d failed", iRecordedSource, iDriveID);
+		}
+
 		bool srvCallback_ElmoRecorderReadout(cob_base_drive_chain::ElmoRecorderReadout::Request &req,
 							  cob_base_drive_chain::ElmoRecorderReadout::Response &res ){
 			if(m_bisInitialized) {
 #ifdef __SIM__
 				res.success = true;
 #else
+				boost::mutex::scoped_lock lock(m_IOMutex);
 				m_CanCtrlPltf->evalCanBuffer();
 				res.success = m_CanCtrlPltf->ElmoRecordings(1, req.subindex, req.fileprefix);
 #endif
@@ -476,7 +827,10 @@ class NodeClass
 #ifdef __SIM__
 				res.success = true;
 #else
+				boost::mutex::scoped_lock lock(m_IOMutex);
 				res.success = m_CanCtrlPltf->resetPltf();
+				// the drives start from standstill
+				m_Interpolator.reset();
 #endif
 				if (res.success) {
 		   			ROS_INFO("base resetted");
@@ -502,6 +856,7 @@ class NodeClass
 #ifdef __SIM__
 			res.success = true;
 #else
+			boost::mutex::scoped_lock lock(m_IOMutex);
 			res.success = m_CanCtrlPltf->shutdownPltf();
 #endif
 			if (res.success)
@@ -513,22 +868,51 @@ class NodeClass
 		}
 
 		//publish JointStates cyclical instead of service callback
+#ifndef __SIM__
+		void publish_Telemetry()
+		{
+			const int c_iMaxSamples = 256;
+			CanDriveItf::TelemetrySample samples[c_iMaxSamples];
+
+			if(!m_bisInitialized)
+				return;
+
+			for(int i = 0; i < m_iNumMotors && i < 8; i++)
+			{
+				cob_base_drive_chain::DriveTelemetry msg;
+				int iNumSamples;
+
+				while( (iNumSamples = m_CanCtrlPltf->getTelemetry(i, samples, c_iMaxSamples)) > 0 )
+				{
+					for(int j = 0; j < iNumSamples; j++)
+					{
+						msg.time.push_back(samples[j].dTimeSec);
+						msg.position.push_back(samples[j].dPosGearRad);
+						msg.velocity_error.push_back(samples[j].dVelErrGearRadS);
+						msg.current.push_back(samples[j].dCurrentA);
+					}
+				}
+
+				// the buffers are drained even without subscribers to keep the samples recent
+				if(msg.time.empty() || topicPub_Telemetry.getNumSubscribers() == 0)
+					continue;
+
+				msg.header.stamp = ros::Time::now();
+				msg.joint_name = m_JointStateMsg.name[i];
+				topicPub_Telemetry.publish(msg);
+			}
+		}
+#endif
+
 		bool publish_JointStates()
 		{
 			// init local variables
-			int j, k;
+			int j;
 			bool bIsError;
-			std::vector<double> vdAngGearRad, vdVelGearRad, vdEffortGearNM;
-
-			// set default values
-			vdAngGearRad.resize(m_iNumMotors, 0);
-			vdVelGearRad.resize(m_iNumMotors, 0);
-			vdEffortGearNM.resize(m_iNumMotors, 0);
-
-			// create temporary (local) JointState/Diagnostics Data-Container
-			sensor_msgs::JointState jointstate;
 			diagnostic_msgs::DiagnosticStatus diagnostics;
-			control_msgs::JointTrajectoryControllerState controller_state;
+
+			sensor_msgs::JointState& jointstate = m_JointStateMsg;
+			control_msgs::JointTrajectoryControllerState& controller_state = m_ControllerStateMsg;
 
 			// get time stamp for header
 #ifdef __SIM__
@@ -539,20 +923,11 @@ class NodeClass
 			controller_state.header.stamp = jointstate.header.stamp;
 #endif
 
-			// assign right size to JointState
-			//jointstate.name.resize(m_iNumMotors);
-			jointstate.position.assign(m_iNumMotors, 0.0);
-			jointstate.velocity.assign(m_iNumMotors, 0.0);
-			jointstate.effort.assign(m_iNumMotors, 0.0);
-
 			if(m_bisInitialized == false)
 			{
 				// as long as system is not initialized
 				bIsError = false;
 
-				j = 0;
-				k = 0;
-
 				// set data to jointstate
 				for(int i = 0; i<m_iNumMotors; i++)
 				{
@@ -560,16 +935,6 @@ class NodeClass
 					jointstate.velocity[i] = 0.0;
 					jointstate.effort[i] = 0.0;
 				}
-				jointstate.name.push_back("fl_caster_r_wheel_joint");
-				jointstate.name.push_back("fl_caster_rotation_joint");
-				jointstate.name.push_back("bl_caster_r_wheel_joint");
-				jointstate.name.push_back("bl_caster_rotation_joint");
-				jointstate.name.push_back("br_caster_r_wheel_joint");
-				jointstate.name.push_back("br_caster_rotation_joint");
-				jointstate.name.push_back("fr_caster_r_wheel_joint");
-				jointstate.name.push_back("fr_caster_rotation_joint");
-				jointstate.name.resize(m_iNumMotors);
-
 			}
 			else
 			{
@@ -578,64 +943,60 @@ class NodeClass
 #ifdef __SIM__
 
 #else
-				ROS_DEBUG("Read CAN-Buffer");
-				m_CanCtrlPltf->evalCanBuffer();
-				ROS_DEBUG("Successfully read CAN-Buffer");
+				if(m_bUseIOThread)
+				{
+					// latest measurements of the I/O thread
+					m_pIOState->update();
+				}
+				else
+				{
+					// skipped while a service has the bus, the previous snapshot is published again
+					boost::mutex::scoped_try_lock lock(m_IOMutex);
+					if(lock.owns_lock())
+					{
+						ROS_DEBUG("Read CAN-Buffer");
+						m_CanCtrlPltf->evalCanBuffer();
+						ROS_DEBUG("Successfully read CAN-Buffer");
+						m_bPltfError = m_CanCtrlPltf->isPltfError();
+					}
+					// all motors of this evaluation of the CAN buffer
+					m_CanCtrlPltf->getTelemetrySnapshot(&m_Telemetry);
+				}
 #endif
 				j = 0;
-				k = 0;
 				for(int i = 0; i<m_iNumMotors; i++)
 				{
 #ifdef __SIM__
-					vdAngGearRad[i] = m_gazeboPos[i];
-					vdVelGearRad[i] = m_gazeboVel[i];
-#else
-					m_CanCtrlPltf->getGearPosVelRadS(i,  &vdAngGearRad[i], &vdVelGearRad[i]);
-#endif
-
-					//Get motor torque
-					if(m_bPubEffort) {
-						for(int i=0; i<m_iNumMotors; i++)
-						{
-#ifdef __SIM__
-							//vdEffortGearNM[i] = m_gazeboEff[i];
+					jointstate.position[i] = m_gazeboPos[i];
+					jointstate.velocity[i] = m_gazeboVel[i];
 #else
-							m_CanCtrlPltf->getMotorTorque(i, &vdEffortGearNM[i]); //(int iCanIdent, double* pdTorqueNm)
-#endif
-						}
+					if(m_bUseIOThread)
+					{
+						const IOStateType& state = m_pIOState->readSlot();
+						jointstate.position[i] = state.vdAngGearRad[i];
+						jointstate.velocity[i] = state.vdVelGearRad[i];
+						jointstate.effort[i] = m_bPubEffort ? state.vdEffortGearNM[i] : 0.0;
+					}
+					else
+					{
+						jointstate.position[i] = m_Telemetry.vStates[i].dAngGearRad;
+						jointstate.velocity[i] = m_Telemetry.vStates[i].dVelGearRadS;
+						jointstate.effort[i] = m_bPubEffort ? m_Telemetry.vStates[i].dTorqueNm : 0.0;
 					}
+#endif
 
    					// if a steering motor was read -> correct for offset
    					if( i == 1 || i == 3 || i == 5 || i == 7) // ToDo: specify this via the config-files
 					{
 						// correct for initial offset of steering angle (arbitrary homing position)
-						vdAngGearRad[i] += m_Param.vdWheelNtrlPosRad[j];
-						MathSup::normalizePi(vdAngGearRad[i]);
+						jointstate.position[i] += m_Param.vdWheelNtrlPosRad[j];
+						MathSup::normalizePi(jointstate.position[i]);
 						j = j+1;
 					}
 				}
-
-				// set data to jointstate
-				for(int i = 0; i<m_iNumMotors; i++)
-				{
-					jointstate.position[i] = vdAngGearRad[i];
-					jointstate.velocity[i] = vdVelGearRad[i];
-					jointstate.effort[i] = vdEffortGearNM[i];
-				}
-
-				jointstate.name.push_back("fl_caster_r_wheel_joint");
-				jointstate.name.push_back("fl_caster_rotation_joint");
-				jointstate.name.push_back("bl_caster_r_wheel_joint");
-				jointstate.name.push_back("bl_caster_rotation_joint");
-				jointstate.name.push_back("br_caster_r_wheel_joint");
-				jointstate.name.push_back("br_caster_rotation_joint");
-				jointstate.name.push_back("fr_caster_r_wheel_joint");
-				jointstate.name.push_back("fr_caster_rotation_joint");
-				jointstate.name.resize(m_iNumMotors);
-
 			}
 
-			controller_state.joint_names = jointstate.name;
+			// same sizes every cycle, so the copies reuse the allocated vectors
 			controller_state.actual.positions = jointstate.position;
 			controller_state.actual.velocities = jointstate.velocity;
 
@@ -646,6 +1007,8 @@ class NodeClass
 			topicPub_JointState.publish(jointstate);
 #endif
 			topicPub_ControllerState.publish(controller_state);
+			if(m_pUndercarriageCtrl)
+				m_pUndercarriageCtrl->setJointControllerState(controller_state);
 
 			ROS_DEBUG("published new drive-chain configuration (JointState message)");
 
@@ -656,10 +1019,33 @@ class NodeClass
 #ifdef __SIM__
 				bIsError = false;
 #else
-				bIsError = m_CanCtrlPltf->isPltfError();
+				// without I/O thread evaluated together with the CAN buffer
+				if(m_bUseIOThread)
+					m_bPltfError = m_CanCtrlPltf->isPltfError();
+				bIsError = m_bPltfError;
 #endif
 			}
 
+#ifndef __SIM__
+			if(m_Blackboard.isOpen())
+			{
+				RobotStateBlackboard::DriveData drives;
+				drives.iNumMotors = std::min<int>(m_iNumMotors, RobotStateBlackboard::MAX_MOTORS);
+				drives.bInitialized = m_bisInitialized;
+				drives.bError = bIsError;
+				// the snapshot does not block the I/O thread
+				if(m_bisInitialized && m_bUseIOThread)
+					m_CanCtrlPltf->getTelemetrySnapshot(&m_Telemetry);
+				for(int i = 0; i < drives.iNumMotors; i++)
+				{
+					drives.dVelGearRadS[i] = jointstate.velocity[i];
+					drives.iStatus[i] = m_bisInitialized ? m_Telemetry.vStates[i].iStatus : 0;
+				}
+				drives.dStampS = RobotStateBlackboard::getMonotonicTime();
+				m_Blackboard.writeDrives(drives);
+			}
+#endif
+
 			// set data to diagnostics
 			if(bIsError)
 			{
@@ -685,6 +1071,8 @@ class NodeClass
 
 			// publish diagnostic message
 			topicPub_Diagnostic.publish(diagnostics);
+			if(m_pUndercarriageCtrl)
+				m_pUndercarriageCtrl->setDriveChainDiagnostic(diagnostics);
 			ROS_DEBUG("published new drive-chain configuration (JointState message)");
 
 
@@ -696,12 +1084,17 @@ class NodeClass
 		  //publish global diagnostic messages
                   diagnostic_msgs::DiagnosticArray diagnostics_gl;
                   diagnostics_gl.header.stamp = ros::Time::now();
+#ifdef __SIM__
                   diagnostics_gl.status.resize(1);
+#else
+                  diagnostics_gl.status.resize(2);
+                  getCanDiagnostics(diagnostics_gl.status[1]);
+#endif
                   // set data to diagnostics
 #ifdef __SIM__
                   if (false)
 #else
-                  if(m_bisInitialized && m_CanCtrlPltf->isPltfError())
+                  if(m_bisInitialized && m_bPltfError)
 #endif
 
                   {
@@ -724,13 +1117,105 @@ class NodeClass
                       diagnostics_gl.status[0].message = "base_drive_chain not initialized";
                     }
                   }
+                  diagnostics_gl.status.push_back(diagnostic_msgs::DiagnosticStatus());
+                  getTimingDiagnostics(diagnostics_gl.status.back());
                   // publish diagnostic message
                   topicPub_DiagnosticGlobal_.publish(diagnostics_gl);
 		}
 
+		// percentiles since the last call, a cycle taking 1.5 times its period is an overrun
+		void getTimingDiagnostics(diagnostic_msgs::DiagnosticStatus& status)
+		{
+			status.name = ros::this_node::getName() + ": timing";
+			status.level = diagnostic_msgs::DiagnosticStatus::OK;
+			status.message = "no overruns";
+
+			std::vector<std::pair<std::string, std::string> > values;
+			LatencyHistogram::Summary summary;
+			uint64_t uiOverruns = 0;
+			m_CycleHist.getSummary(&summary, 1.5e6 / 100, true);
+			LatencyHistogram::appendKeyValues("cycle period", summary, &values);
+			uiOverruns += summary.uiOverruns;
+#ifndef __SIM__
+			if(m_bUseIOThread)
+			{
+				m_IOWakeupHist.getSummary(&summary, 0.5e6 / m_dIOThreadRate, true);
+				LatencyHistogram::appendKeyValues("I/O wake-up latency", summary, &values);
+				uiOverruns += summary.uiOverruns;
+				m_IOCycleHist.getSummary(&summary, 1e6 / m_dIOThreadRate, true);
+				LatencyHistogram::appendKeyValues("I/O cycle duration", summary, &values);
+				uiOverruns += summary.uiOverruns;
+			}
+#endif
+			uint64_t uiMajorFaults = appendPageFaults("cycle", m_CyclePageFaults, &values);
+#ifndef __SIM__
+			if(m_bUseIOThread)
+				uiMajorFaults += appendPageFaults("I/O", m_IOPageFaults, &values);
+#endif
+			if(uiOverruns > 0)
+			{
+				status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+				std::ostringstream ss;
+				ss << uiOverruns << " overruns";
+				status.message = ss.str();
+			}
+			if(uiMajorFaults > 0)
+			{
+				status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+				std::ostringstream ss;
+				ss << (uiOverruns > 0 ? status.message + ", " : "") << uiMajorFaults << " major page faults";
+				status.message = ss.str();
+			}
+			for(size_t i = 0; i < values.size(); i++)
+			{
+				diagnostic_msgs::KeyValue kv;
+				kv.key = values[i].first;
+				kv.value = values[i].second;
+				status.values.push_back(kv);
+			}
+		}
+
+		// appends the page faults since the last call, returns the major ones
+		static uint64_t appendPageFaults(const std::string& sName, PageFaultCounter& counter,
+			std::vector<std::pair<std::string, std::string> >* pvValues)
+		{
+			uint64_t uiMinor, uiMajor;
+			counter.get(&uiMinor, &uiMajor, true);
+			std::ostringstream ssMinor, ssMajor;
+			ssMinor << uiMinor;
+			ssMajor << uiMajor;
+			pvValues->push_back(std::make_pair(sName + " minor page faults", ssMinor.str()));
+			pvValues->push_back(std::make_pair(sName + " major page faults", ssMajor.str()));
+			return uiMajor;
+		}
+
 		// other function declarations
 		bool initDrives();
 
+		// publishes the joint states and runs the fused undercarriage controller
+		void cycle(const ros::Time& now)
+		{
+			double dNowS = ros::WallTime::now().toSec();
+			if(m_dLastCycleS > 0.0)
+				m_CycleHist.recordSeconds(dNowS - m_dLastCycleS);
+			m_dLastCycleS = dNowS;
+			m_CyclePageFaults.update();
+
+			publish_JointStates();
+			// fused mode: control step on the fresh measurements, commands go to the drives immediately
+			if(m_pUndercarriageCtrl)
+				m_pUndercarriageCtrl->updateCtrl(now);
+#ifndef __SIM__
+			publish_Telemetry();
+#endif
+		}
+#ifndef __SIM__
+		void getCanDiagnostics(diagnostic_msgs::DiagnosticStatus& status);
+		void ioThread();
+		void initInterpolator();
+		static double getMonotonicTime();
+#endif
+
 #ifdef __SIM__
 		void gazebo_joint_states_Callback(const sensor_msgs::JointState::ConstPtr& msg) {
 			for (unsigned int i=0; i<msg->name.size(); i++) {
@@ -771,6 +1256,9 @@ class NodeClass
 					m_gazeboVel[7] = msg->velocity[i];
 				}
 			}
+
+			if(m_bSimLockStep)
+				cycle(m_gazeboStamp);
 		}
 #else
 
@@ -786,6 +1274,19 @@ int main(int argc, char** argv)
 
 	NodeClass nodeClass;
 
+	// services and diagnostics in their own thread, the control cycle only spins the joint commands
+	ros::AsyncSpinner service_spinner(1, &nodeClass.m_ServiceQueue);
+	service_spinner.start();
+
+#ifdef __SIM__
+	// lock-step: the cycles are run by the joint state callback of the simulation
+	if(nodeClass.m_bSimLockStep)
+	{
+		ros::spin();
+		return 0;
+	}
+#endif
+
 	// specify looprate of control-cycle
  	ros::Rate loop_rate(100); // Hz
 
@@ -797,16 +1298,21 @@ int main(int argc, char** argv)
 		//Read-out of CAN buffer is only necessary during read-out of Elmo Recorder
 		if( nodeClass.m_bReadoutElmo )
 		{
-			if(nodeClass.m_bisInitialized) nodeClass.m_CanCtrlPltf->evalCanBuffer();
-			if(nodeClass.m_CanCtrlPltf->ElmoRecordings(100, 0, "") == 0)
+			// polled again next cycle while a service has the bus
+			boost::mutex::scoped_try_lock lock(nodeClass.m_IOMutex);
+			if(lock.owns_lock())
 			{
-				nodeClass.m_bReadoutElmo = false;
-				ROS_INFO("CPU consuming evalCanBuffer used for ElmoReadout deactivated");
+				if(nodeClass.m_bisInitialized) nodeClass.m_CanCtrlPltf->evalCanBuffer();
+				if(nodeClass.m_CanCtrlPltf->ElmoRecordings(100, 0, "") == 0)
+				{
+					nodeClass.m_bReadoutElmo = false;
+					ROS_INFO("CPU consuming evalCanBuffer used for ElmoReadout deactivated");
+				}
 			}
 		}
 #endif
 
-		nodeClass.publish_JointStates();
+		nodeClass.cycle(ros::Time::now());
 
 		loop_rate.sleep();
 		ros::spinOnce();
@@ -817,6 +1323,212 @@ int main(int argc, char** argv)
 
 //##################################
 //#### function implementations ####
+#ifndef __SIM__
+void NodeClass::getCanDiagnostics(diagnostic_msgs::DiagnosticStatus& status)
+{
+	status.name = ros::this_node::getName() + ": CAN bus";
+
+	CanStatistics::Snapshot stats;
+	ros::Time now = ros::Time::now();
+	if(!m_CanCtrlPltf->getCanStatistics(&stats))
+	{
+		status.level = diagnostic_msgs::DiagnosticStatus::OK;
+		status.message = "CAN interface not opened";
+		return;
+	}
+
+	double dt = (now - m_LastCanStatsTime).toSec();
+	if(m_LastCanStatsTime.isZero() || dt <= 0.0)
+	{
+		// first call, rates need two snapshots
+		m_LastCanStats = stats;
+		m_LastCanStatsTime = now;
+		status.level = diagnostic_msgs::DiagnosticStatus::OK;
+		status.message = "collecting CAN statistics";
+		return;
+	}
+
+	unsigned long ulFrames = (stats.ulRxFrames - m_LastCanStats.ulRxFrames) + (stats.ulTxFrames - m_LastCanStats.ulTxFrames);
+	unsigned long ulBytes = (stats.ulRxBytes - m_LastCanStats.ulRxBytes) + (stats.ulTxBytes - m_LastCanStats.ulTxBytes);
+	unsigned long ulErrors = stats.ulErrors - m_LastCanStats.ulErrors;
+	unsigned long ulTxOverruns = stats.ulTxOverruns - m_LastCanStats.ulTxOverruns;
+
+	// 47 bits of overhead per standard frame, bit stuffing is not accounted for
+	double dBusLoad = (47.0 * ulFrames + 8.0 * ulBytes) / (dt * m_iCanBitrate);
+
+	std::ostringstream ss;
+	ss << (int)(100.0 * dBusLoad) << "% bus load";
+	if(dBusLoad > 0.8)
+	{
+		status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+		ss << ", bus close to saturation";
+	}
+	else if(ulErrors > 0 || ulTxOverruns > 0)
+	{
+		status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+		ss << ", " << ulErrors << " errors, " << ulTxOverruns << " transmit overruns";
+	}
+	else
+	{
+		status.level = diagnostic_msgs::DiagnosticStatus::OK;
+	}
+	status.message = ss.str();
+
+	diagnostic_msgs::KeyValue kv;
+	std::ostringstream val;
+#define ADD_CAN_VALUE(name, number) \
+	val.str(""); val << (number); kv.key = name; kv.value = val.str(); status.values.push_back(kv);
+
+	ADD_CAN_VALUE("rx frames/s", (stats.ulRxFrames - m_LastCanStats.ulRxFrames) / dt);
+	ADD_CAN_VALUE("tx frames/s", (stats.ulTxFrames - m_LastCanStats.ulTxFrames) / dt);
+	ADD_CAN_VALUE("rx bytes/s", (stats.ulRxBytes - m_LastCanStats.ulRxBytes) / dt);
+	ADD_CAN_VALUE("tx bytes/s", (stats.ulTxBytes - m_LastCanStats.ulTxBytes) / dt);
+	ADD_CAN_VALUE("bus load [%]", 100.0 * dBusLoad);
+	ADD_CAN_VALUE("errors", stats.ulErrors);
+	ADD_CAN_VALUE("tx overruns", stats.ulTxOverruns);
+	ADD_CAN_VALUE("tx queue depth", stats.iTxQueueDepth);
+	for(int i = 0; i < CanStatistics::c_iNumLatencyBins; i++)
+	{
+		std::ostringstream key;
+		if(i < CanStatistics::c_iNumLatencyBins - 1)
+			key << "rx latency < " << 1000.0 * CanStatistics::getLatencyBinLimit(i) << " ms";
+		else
+			key << "rx latency >= " << 1000.0 * CanStatistics::getLatencyBinLimit(i - 1) << " ms";
+		ADD_CAN_VALUE(key.str(), stats.ulRxLatency[i] - m_LastCanStats.ulRxLatency[i]);
+	}
+
+	Mutex::Statistics lockStats;
+	m_CanCtrlPltf->getLockStatistics(&lockStats);
+	ADD_CAN_VALUE("lock contentions", lockStats.ulContended);
+	ADD_CAN_VALUE("lock contentions resolved by spinning", lockStats.ulSpinAcquired);
+#undef ADD_CAN_VALUE
+
+	m_LastCanStats = stats;
+	m_LastCanStatsTime = now;
+}
+
+void NodeClass::ioThread()
+{
+	// real-time priority and CPU pinning need the according rtprio limits, run without them otherwise
+	std::string sError;
+	if(!RealTime::setupThread(m_iIOThreadPriority, m_iIOThreadCpu, 256 * 1024, &sError))
+		ROS_WARN("Could not set up CAN I/O thread: %s", sError.c_str());
+
+	CanCtrlPltfCOb3::TelemetrySnapshotType telemetry;
+	telemetry.vStates.resize(m_iNumMotors);
+	std::vector<double> vdVelGearRadS(m_iNumMotors, 0.0);
+	const long lPeriodNs = (long)(1e9 / m_dIOThreadRate);
+	timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	while(m_bIOThreadRunning)
+	{
+		// absolute deadlines, so the cycle does not drift with the execution time
+		deadline.tv_nsec += lPeriodNs;
+		while(deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_nsec -= 1000000000L;
+			deadline.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+		const double dWakeupS = getMonotonicTime();
+		m_IOWakeupHist.recordSeconds(dWakeupS - (deadline.tv_sec + 1e-9 * deadline.tv_nsec));
+
+		if(!m_bisInitialized)
+			continue;
+
+		boost::mutex::scoped_lock lock(m_IOMutex);
+
+		// EM-Stop on the blackboard overrides the commands every cycle, without waiting for the next command
+		if(isEMStopOnBlackboard())
+		{
+			if(m_bInterpolateCmds)
+				m_Interpolator.reset();
+			for(int i = 0; i < m_iNumMotors; i++)
+			{
+				if(m_bTorqueCtrl)
+					m_CanCtrlPltf->setMotorTorque(i, 0.0);
+				else
+					m_CanCtrlPltf->setVelGearRadS(i, 0.0);
+			}
+			m_CanCtrlPltf->sendSync();
+		}
+		// torque setpoints every cycle, the currents of TPDO3 are measured on the same SYNC
+		else if(m_bTorqueCtrl)
+		{
+			m_pIOCmd->update();
+			const IOCmdType& cmd = m_pIOCmd->readSlot();
+			const bool bTimeout = (dWakeupS - cmd.dTimeS) > m_dTorqueCmdTimeout;
+			for(int i = 0; i < m_iNumMotors; i++)
+				m_CanCtrlPltf->setMotorTorque(i, bTimeout ? 0.0 : cmd.vdEffortGearNm[i]);
+			m_CanCtrlPltf->sendSync();
+
+			// polls the currents if the drives are not in SYNC PDO mode
+			m_CanCtrlPltf->requestMotorTorque();
+		}
+		// new setpoints go out right at the deadline, followed by the SYNC for the PDO answers
+		else if(m_bInterpolateCmds)
+		{
+			// a setpoint every cycle
+			if(m_pIOCmd->update())
+				m_Interpolator.setCmd(m_pIOCmd->readSlot().vdVelGearRadS, m_pIOCmd->readSlot().dTimeS);
+			m_Interpolator.update(getMonotonicTime(), &vdVelGearRadS);
+			for(int i = 0; i < m_iNumMotors; i++)
+				m_CanCtrlPltf->setVelGearRadS(i, vdVelGearRadS[i]);
+			m_CanCtrlPltf->sendSync();
+
+			if(m_bPubEffort)
+				m_CanCtrlPltf->requestMotorTorque();
+		}
+		else if(m_pIOCmd->update())
+		{
+			const IOCmdType& cmd = m_pIOCmd->readSlot();
+			for(int i = 0; i < m_iNumMotors; i++)
+				m_CanCtrlPltf->setVelGearRadS(i, cmd.vdVelGearRadS[i]);
+			m_CanCtrlPltf->sendSync();
+
+			if(m_bPubEffort)
+				m_CanCtrlPltf->requestMotorTorque();
+		}
+
+		m_CanCtrlPltf->evalCanBuffer();
+
+		m_CanCtrlPltf->getTelemetrySnapshot(&telemetry);
+		IOStateType& state = m_pIOState->writeSlot();
+		for(int i = 0; i < m_iNumMotors; i++)
+		{
+			state.vdAngGearRad[i] = telemetry.vStates[i].dAngGearRad;
+			state.vdVelGearRad[i] = telemetry.vStates[i].dVelGearRadS;
+			state.vdEffortGearNM[i] = telemetry.vStates[i].dTorqueNm;
+		}
+		m_pIOState->publish();
+		m_IOCycleHist.recordSeconds(getMonotonicTime() - dWakeupS);
+		m_IOPageFaults.update();
+	}
+}
+
+double NodeClass::getMonotonicTime()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + 1e-9 * now.tv_nsec;
+}
+
+void NodeClass::initInterpolator()
+{
+	std::vector<SetpointInterpolator::JointLimitsType> vLimits(m_iNumMotors);
+	for(int i = 0; i < m_iNumMotors; i++)
+	{
+		// steering motors have odd indices, see setJointCmd()
+		bool bSteer = (i % 2) == 1;
+		vLimits[i].dMaxVelRadS = bSteer ? m_Param.dMaxSteerRateRadpS : m_Param.dMaxDriveRateRadpS;
+		vLimits[i].dMaxAccRadS2 = bSteer ? m_dInterpolatorMaxAccSteer : m_dInterpolatorMaxAccDrive;
+		vLimits[i].dMaxJerkRadS3 = m_dInterpolatorMaxJerk;
+	}
+	m_Interpolator.init(vLimits, m_dInterpolatorExtrapolation, m_dInterpolatorTimeout);
+}
+#endif
+
 bool NodeClass::initDrives()
 {
 	ROS_INFO("Initializing Base Drive Chain");
@@ -826,6 +1538,7 @@ bool NodeClass::initDrives()
 //	m_Param.vdWheelNtrlPosRad.assign(4,0);
 	// ToDo: replace the following steps by ROS configuration files
 	// create Inifile class and set target inifile (from which data shall be read)
+	TRACE_PHASE("NodeClass::initDrives");
 	IniFile iniFile;
 
 	//n.param<std::string>("PltfIniLoc", sIniFileName, "Platform/IniFiles/Platform.ini");
@@ -834,6 +1547,11 @@ bool NodeClass::initDrives()
 	// get max Joint-Velocities (in rad/s) for Steer- and Drive-Joint
 	iniFile.GetKeyDouble("DrivePrms", "MaxDriveRate", &m_Param.dMaxDriveRateRadpS, true);
 	iniFile.GetKeyDouble("DrivePrms", "MaxSteerRate", &m_Param.dMaxSteerRateRadpS, true);
+#ifndef __SIM__
+	// the I/O thread does not use it before the drives are initialized
+	if(m_bInterpolateCmds)
+		initInterpolator();
+#endif
 
 #ifdef __SIM__
 	// get Offset from Zero-Position of Steering
@@ -870,6 +1588,18 @@ bool NodeClass::initDrives()
 	bTemp1 = true;
 #else
 	bTemp1 =  m_CanCtrlPltf->initPltf();
+	if(bTemp1)
+	{
+		m_CanCtrlPltf->ElmoRecordings(3, m_bElmoRecorderBinaryLog ? 1 : 0, "");
+		m_CanCtrlPltf->setElmoRecorderCallback(boost::bind(&NodeClass::elmoReadoutDone, this, _1, _2, _3));
+	}
+	if(bTemp1 && m_bTorqueCtrl)
+	{
+		ROS_INFO("Switching drives to torque control");
+		if(!m_CanCtrlPltf->isSyncPDOMode())
+			ROS_WARN("SyncPDOMode is not set in Platform.ini, the motor currents are polled every cycle");
+		bTemp1 = m_CanCtrlPltf->setTypeMotion(CanDriveItf::MOTIONTYPE_TORQUECTRL);
+	}
 #endif
 	// debug log
 	ROS_INFO("Initializing done");
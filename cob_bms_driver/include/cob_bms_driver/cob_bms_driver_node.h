@@ -22,10 +22,21 @@
 #include <XmlRpcValue.h>
 #include <diagnostic_updater/diagnostic_updater.h>
 #include <diagnostic_updater/publisher.h>
+#include <sensor_msgs/BatteryState.h>
+#include <cob_bms_driver/GetBmsHistory.h>
+#include <cob_utilities/LatencyHistogram.h>
+#include <cob_utilities/RobotStateBlackboard.h>
 
 #include <socketcan_interface/socketcan.h>
 #include <socketcan_interface/threading.h>
 
+#include <linux/can.h>
+
+#include <boost/chrono.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+
 struct BmsParameter
 {
     unsigned int offset;
@@ -33,18 +44,41 @@ struct BmsParameter
 
     bool is_signed;
 
+    //requested poll frequency, 0 if the CAN-ID of this parameter is polled at the default rate
+    double poll_frequency_hz;
+
+    //optional per-topic publisher, only advertised for the entries of the "topics" parameter
     ros::Publisher publisher;
 
+    //name in the configuration and key (with unit) for the diagnostics
+    std::string name;
     diagnostic_msgs::KeyValue kv;
 
+    BmsParameter() : offset(0), length(0), is_signed(false), poll_frequency_hz(0.0) {}
     virtual ~BmsParameter() {}
 
-    virtual void update(const can::Frame &f) = 0;
+    //converts the decoded (and sign extended) raw value
+    virtual double convert(int64_t value) const = 0;
+    //formats a converted value for the diagnostics
+    virtual std::string toString(double value) const = 0;
+    //publishes a converted value, if the BmsParameter is a topic
+    virtual void publish(double value) = 0;
     virtual void advertise(ros::NodeHandle &nh, const std::string &topic) = 0;
 
     typedef boost::shared_ptr<BmsParameter> Ptr;
 };
 
+//SocketCAN interface that lets the kernel drop all frames but the ones matching the filters (and error frames).
+//The filters are applied on every (re-)initialization of the socket.
+class FilteredSocketCANInterface : public can::SocketCANInterface
+{
+    std::vector<can_filter> filters_;
+public:
+    //an empty list disables filtering
+    void setFilters(const std::vector<can_filter> &filters) { filters_ = filters; }
+    virtual bool init(const std::string &device, bool loopback);
+};
+
 class CobBmsDriverNode
 {
 private:
@@ -63,26 +97,125 @@ private:
     boost::mutex data_mutex_;
 
     //polling lists that contain CAN-ID(s) that are to be polled. Each CAN-ID corresponds to a group of BMS parameters
+    //CAN-IDs with topics are in polling_list1_, they only determine the default poll rates of the schedule
     std::vector<uint8_t> polling_list1_;
     std::vector<uint8_t> polling_list2_;
-    std::vector<uint8_t>::iterator polling_list1_it_;
-    std::vector<uint8_t>::iterator polling_list2_it_;
 
-    //interface to send and recieve CAN frames
-    can::ThreadedSocketCANInterface socketcan_interface_;
+    typedef boost::chrono::steady_clock Clock;
+
+    //one entry per CAN-ID, polled whenever its deadline has passed
+    struct PollEntry
+    {
+        uint8_t id;
+        Clock::duration period;
+        Clock::time_point deadline;
+
+        //rate from createPollSchedule, configured if set by poll_frequency_hz of a BmsParameter
+        double default_hz;
+        bool configured;
+        //CAN-IDs with topics only, polled at idle_poll_frequency_hz_ while none of their topics has a subscriber
+        bool on_demand;
+        bool subscribed;
+        std::vector<BmsParameter*> topics;
+    };
+    std::vector<PollEntry> poll_schedule_;
+
+    //rate of unsubscribed on_demand CAN-IDs, keeps the diagnostics up to date. 0 disables demand-driven polling
+    double idle_poll_frequency_hz_;
+    //the subscribers are checked by the poll thread once per second
+    Clock::time_point next_subscriber_check_;
+
+    //a request is released as soon as all CAN-IDs of the previous request were answered, or after this timeout
+    Clock::duration response_timeout_;
+
+    //CAN-IDs of the last request that have not been answered yet, protected by data_mutex_
+    std::vector<uint8_t> pending_ids_;
+    boost::condition_variable response_cond_;
+
+    //time from a request to the last answer (or the timeout) and time between two requests, reported in the diagnostics
+    LatencyHistogram response_hist_;
+    LatencyHistogram request_period_hist_;
+    Clock::time_point last_request_;
+
+    //config_map_ compiled for handleFrames: the fields of all BmsParameters in a flat array, sorted by CAN-ID
+    struct FieldDecoder
+    {
+        uint8_t offset;
+        uint8_t end;        //offset + length, smaller frames are ignored
+        int64_t sign_bit;   //highest bit of signed fields, 0 for unsigned fields
+        int64_t last_value;
+        bool has_value;
+        BmsParameter *param;
+    };
+    std::vector<FieldDecoder> decoders_;
+    //the decoders_ of CAN-ID i are decoders_[decoder_index_[i]] to decoders_[decoder_index_[i+1]-1]
+    std::vector<size_t> decoder_index_;
+
+    //converted values of all decoders_
+    struct Snapshot
+    {
+        std::vector<double> values;
+        std::vector<uint8_t> valid;
+        ros::Time last_update;
+    };
+    //double buffer: received_ is written by handleFrames (protected by data_mutex_),
+    //the timer callbacks copy it to snapshot_ and work on that copy without holding the lock
+    Snapshot received_;
+    Snapshot snapshot_;
+
+    //fixed-size history of the received values of one decoder, with running statistics (Welford) over all values
+    struct History
+    {
+        std::vector<double> stamps;
+        std::vector<double> values;
+        size_t next;    //slot of the next sample
+        size_t size;    //number of valid samples, at most stamps.size()
+        uint64_t count;
+        double min;
+        double max;
+        double mean;
+        double m2;      //sum of squared differences from the mean
+
+        History() : next(0), size(0), count(0), min(0.0), max(0.0), mean(0.0), m2(0.0) {}
+        void add(double stamp, double value);
+    };
+    //one History per decoder, protected by data_mutex_. Every received value is added, not only changed ones
+    std::vector<History> histories_;
+    ros::ServiceServer history_service_;
+
+    //aggregated message, published at a fixed rate
+    ros::Publisher battery_state_pub_;
+    ros::Timer battery_state_timer_;
+    //decoder of each BatteryState field, -1 if the field is not mapped
+    enum { BS_VOLTAGE, BS_CURRENT, BS_CHARGE, BS_CAPACITY, BS_DESIGN_CAPACITY, BS_NUM_FIELDS };
+    int battery_state_fields_[BS_NUM_FIELDS];
+
+    //power state for the other drivers, written together with the BatteryState
+    RobotStateBlackboard blackboard_;
+
+    //interface to send and recieve CAN frames, restricted to the BMS responses if response_id_base is set
+    can::ThreadedInterface<FilteredSocketCANInterface> socketcan_interface_;
+
+    //polls the BMS independently of the ROS callbacks
+    boost::scoped_ptr<boost::thread> poll_thread_;
+    void pollThread();
 
     //pointer to callback function to handle CAN frames from BMS
     can::CommInterface::FrameListener::Ptr frame_listener_;
 
-    //diagnostics data received from BMS
-    diagnostic_updater::DiagnosticStatusWrapper stat_;
-
     //function to get ROS parameters from parameter server
     bool getParams();
 
+    //function to read the "battery_state" mapping from BatteryState fields to BmsParameter names and set up its publisher
+    bool setupBatteryState();
+
     //function to interpret the diagnostics XmlRpcValue and save data in config_map_
     bool loadConfigMap(XmlRpc::XmlRpcValue &diagnostics, std::vector<std::string> &topics);
 
+    //function that fills decoders_ and decoder_index_ from config_map_
+    //and allocates histories_ with history_size samples each
+    void compileDecoders(int history_size);
+
     //helper function to evaluate poll period from given poll frequency
     void evaluatePollPeriodFrom(int poll_frequency);
 
@@ -91,8 +224,20 @@ private:
     //Otherwise, all CAN-ID are divided between both lists.
     void optimizePollingLists();
 
+    //function that creates poll_schedule_. Each CAN-ID is polled with the highest poll_frequency_hz of its BmsParameters.
+    //CAN-IDs without configured frequency get the rate they had with the two polling lists:
+    //every poll_period_for_two_ids_in_ms_ one CAN-ID of each list.
+    void createPollSchedule();
+
+    //function that marks the CAN-IDs of poll_schedule_ whose BmsParameters are only needed for their topics (and the diagnostics)
+    void setupDemandPolling();
+
+    //function that sets the poll rates from the subscribers of the topics. Unsubscribed on_demand CAN-IDs drop to
+    //idle_poll_frequency_hz_, the bus time saved goes to the subscribed CAN-IDs without configured poll frequency
+    void updatePollRates(const Clock::time_point &now);
+
     //function that polls BMS (bms_id_to_poll_ is used here!).
-    //Also, this function sleeps for time given by poll_period_for_two_ids_in_ms_ to ensure BMS is polled at the desired frequency
+    //Waits until the BMS answered all (non-zero) ids or response_timeout_ passed.
     void pollBmsForIds(const uint16_t first_id, const uint16_t second_id);
 
     //callback function to handle all types of frames received from BMS
@@ -101,8 +246,17 @@ private:
     //updates the diagnostics data with the new data received from BMS
     void produceDiagnostics(diagnostic_updater::DiagnosticStatusWrapper &stat);
 
+    //copies received_ to snapshot_
+    void takeSnapshot();
+
     //calls update function of diagnostics_updater
     void diagnosticsTimerCallback(const ros::TimerEvent&);
+
+    //publishes the BatteryState of the current snapshot
+    void batteryStateTimerCallback(const ros::TimerEvent&);
+
+    //returns the history and statistics of one BmsParameter
+    bool historyServiceCallback(cob_bms_driver::GetBmsHistory::Request &req, cob_bms_driver::GetBmsHistory::Response &res);
 public:
 
     //updater for diagnostics data
@@ -114,8 +268,12 @@ public:
     //initlializes SocketCAN interface, saves data from ROS parameter server, loads polling lists and sets up diagnostic updater
     bool prepare();
 
-    //cycles through polling lists and sends 2 ids at a time (one from each list) to the BMS
-    void pollNextInLists();
+    //sends the (up to 2) CAN-IDs with the earliest passed deadlines to the BMS.
+    //If no CAN-ID is due, waits for the next deadline, but at most for 100 ms.
+    void pollNextDue();
+
+    //starts the poll thread, ROS callbacks are processed by the caller
+    void startPolling();
 };
 
 
@@ -19,54 +19,26 @@
 #include <std_msgs/Bool.h>
 #include <XmlRpcException.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <stdint.h>
-#include <endian.h>
 
 #include <cob_bms_driver/cob_bms_driver_node.h>
 
-using boost::make_shared;
-
-//template to be used to read CAN frames received from the BMS
-template<int N> void big_endian_to_host(const void* in, void* out);
-template<> void big_endian_to_host<1>(const void* in, void* out){ *(uint8_t*)out = *(uint8_t*)in;}
-template<> void big_endian_to_host<2>(const void* in, void* out){ *(uint16_t*)out = be16toh(*(uint16_t*)in);}
-template<> void big_endian_to_host<4>(const void* in, void* out){ *(uint32_t*)out = be32toh(*(uint32_t*)in);}
-template<> void big_endian_to_host<8>(const void* in, void* out){ *(uint64_t*)out = be64toh(*(uint64_t*)in);}
-
-template<typename T> T read_value(const can::Frame &f, uint8_t offset){
-    T res;
-    big_endian_to_host<sizeof(T)>(&f.data[offset], &res);
-    return res;
-}
-template<typename T> bool readTypedValue(const can::Frame &f, const BmsParameter &param, T &data){
-    switch (param.length)
-    {
-    case 1:
-        data = param.is_signed ? read_value<int8_t> (f, param.offset) : read_value<uint8_t> (f, param.offset);
-        break;
-
-    case 2:
-        data = param.is_signed ? read_value<int16_t> (f, param.offset) : read_value<uint16_t> (f, param.offset);
-        break;
+#include <linux/can/raw.h>
+#include <sys/socket.h>
 
-    case 4:
-        data = param.is_signed ? read_value<int32_t> (f, param.offset) : read_value<uint32_t> (f, param.offset);
-        break;
-
-    default:
-            ROS_WARN_STREAM("Unknown length of BmsParameter: " << param.kv.key << ". Cannot read data!");
-            return false;
-    }
-    return true;
-}
+using boost::make_shared;
 
 template<typename T> struct TypedBmsParameter : BmsParameter {
     T msg_;
 
-    void publish(){
+    void publish(double value){
         //if the BmsParameter is a topic, publish data to the topic
         if (static_cast<void*>(publisher))
         {
+            msg_.data = value;
             publisher.publish(msg_);
         }
     }
@@ -79,35 +51,51 @@ template<typename T> struct TypedBmsParameter : BmsParameter {
 struct FloatBmsParameter : TypedBmsParameter<std_msgs::Float64> {
     double factor;
     FloatBmsParameter(double factor) : factor(factor) {}
-    void update(const can::Frame &f){
-        readTypedValue(f, *this, msg_.data);
-        msg_.data *= factor;
-
-        //save data for diagnostics updater (and round to two digits for readability)
-        kv.value = (boost::format("%.2f") % msg_.data).str();
-        publish();
+    double convert(int64_t value) const {
+        return value * factor;
+    }
+    std::string toString(double value) const {
+        //round to two digits for readability
+        return (boost::format("%.2f") % value).str();
     }
 };
 
 struct BooleanBmsParameter : TypedBmsParameter<std_msgs::Bool> {
     int bit_mask;
     BooleanBmsParameter(int bit_mask) : bit_mask(bit_mask) { is_signed = true; }
-    void update(const can::Frame &f){
-        int value;
-        readTypedValue(f, *this, value);
-        msg_.data = (value & bit_mask) == bit_mask;
-
-        kv.value = msg_.data ? "True" : "False";
-        publish();
+    double convert(int64_t value) const {
+        return ((value & bit_mask) == bit_mask) ? 1.0 : 0.0;
+    }
+    std::string toString(double value) const {
+        return value != 0.0 ? "True" : "False";
     }
 };
 
+bool FilteredSocketCANInterface::init(const std::string &device, bool loopback)
+{
+    if (!can::SocketCANInterface::init(device, loopback)) return false;
+    if (filters_.empty()) return true;
+
+    if (setsockopt(socket_.native_handle(), SOL_CAN_RAW, CAN_RAW_FILTER, &filters_[0], filters_.size() * sizeof(can_filter)) < 0)
+    {
+        ROS_ERROR_STREAM("Could not set CAN filters on " << device);
+        shutdown();
+        return false;
+    }
+    return true;
+}
+
 CobBmsDriverNode::CobBmsDriverNode()
-: nh_priv_("~")
+: nh_priv_("~"), idle_poll_frequency_hz_(0.0)
 {}
 
 CobBmsDriverNode::~CobBmsDriverNode()
 {
+    if (poll_thread_)
+    {
+        poll_thread_->interrupt();
+        poll_thread_->join();
+    }
     socketcan_interface_.shutdown();
 }
 
@@ -121,17 +109,45 @@ bool CobBmsDriverNode::prepare()
         return false;
     }
 
+    int history_size;
+    if (!nh_priv_.getParam("history_size", history_size) || history_size < 0)
+    {
+        ROS_INFO_STREAM("Did not find valid \"history_size\" on parameter server. Using default value: 600 samples");
+        history_size = 600;
+    }
+    compileDecoders(history_size);
     optimizePollingLists();
-
-    //initalize polling lists iterators
-    polling_list1_it_ = polling_list1_.begin();
-    polling_list2_it_ = polling_list2_.begin();
+    createPollSchedule();
+    if (!setupBatteryState()) return false;
+    setupDemandPolling();
 
     updater_.setHardwareID("bms");
     updater_.add("cob_bms_dagnostics_updater", this, &CobBmsDriverNode::produceDiagnostics);
 
     updater_timer_ = nh_.createTimer(ros::Duration(updater_.getPeriod()), &CobBmsDriverNode::diagnosticsTimerCallback, this);
 
+    history_service_ = nh_priv_.advertiseService("get_history", &CobBmsDriverNode::historyServiceCallback, this);
+
+    //only the responses to the polled CAN-IDs are received, if their base is known
+    int response_id_base;
+    if (nh_priv_.getParam("response_id_base", response_id_base))
+    {
+        std::vector<can_filter> filters;
+        for (size_t i = 0; i < poll_schedule_.size(); ++i)
+        {
+            can_filter filter;
+            filter.can_id = (response_id_base + poll_schedule_[i].id) & CAN_SFF_MASK;
+            filter.can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+            filters.push_back(filter);
+        }
+        socketcan_interface_.setFilters(filters);
+        ROS_INFO_STREAM("Receiving " << filters.size() << " CAN-ID(s) from 0x" << std::hex << response_id_base << std::dec << " on " << can_device_);
+    }
+    else
+    {
+        ROS_INFO_STREAM("Did not find \"response_id_base\" on parameter server. Receiving all CAN frames");
+    }
+
     //initialize the socketcan interface
     if(!socketcan_interface_.init(can_device_, false)) {
         ROS_ERROR("cob_bms_driver initialization failed");
@@ -200,6 +216,17 @@ bool CobBmsDriverNode::getParams()
         poll_frequency_hz = 20;
     }
     evaluatePollPeriodFrom(poll_frequency_hz);
+
+    std::string blackboard_name;
+    if (!nh_priv_.getParam("blackboard", blackboard_name))
+    {
+        ROS_INFO_STREAM("Did not find \"blackboard\" on parameter server. Using default value: cob_robot_state");
+        blackboard_name = "cob_robot_state";
+    }
+    if (!blackboard_name.empty() && !blackboard_.open(blackboard_name))
+    {
+        ROS_WARN_STREAM("Could not open the robot state blackboard '" << blackboard_name << "', the battery state is only published");
+    }
     return true;
 }
 
@@ -239,8 +266,20 @@ bool CobBmsDriverNode::loadConfigMap(XmlRpc::XmlRpcValue &diagnostics, std::vect
                 return false;
             }
             int len = static_cast<int>(field["len"]);
+            if(len != 1 && len != 2 && len != 4){
+                ROS_ERROR_STREAM("diagnostics[" << i << "]: fields[" << j << "]: len must be 1, 2 or 4.");
+                return false;
+            }
 
             BmsParameter::Ptr entry;
+            double poll_frequency_hz = 0.0;
+            if(field.hasMember("poll_frequency_hz")){
+                poll_frequency_hz = static_cast<double>(field["poll_frequency_hz"]);
+                if(poll_frequency_hz <= 0.0){
+                    ROS_ERROR_STREAM("diagnostics[" << i << "]: fields[" << j << "]: poll_frequency_hz must be positive.");
+                    return false;
+                }
+            }
             if(field.hasMember("bit_mask")){
                 int bit_mask = static_cast<int>(field["bit_mask"]);
                 if(bit_mask & ~((1<<(len*8))-1)){
@@ -256,6 +295,7 @@ bool CobBmsDriverNode::loadConfigMap(XmlRpc::XmlRpcValue &diagnostics, std::vect
                 }
 
                 entry = make_shared<FloatBmsParameter>(factor);
+                entry->kv.key = name;
 
                 if(!field.hasMember("is_signed")){
                     ROS_ERROR_STREAM("diagnostics[" << i << "]: fields[" << j << "]: is_signed is missing.");
@@ -273,8 +313,14 @@ bool CobBmsDriverNode::loadConfigMap(XmlRpc::XmlRpcValue &diagnostics, std::vect
                 return false;
             }
             entry->offset = static_cast<int>(field["offset"]);
+            if(entry->offset + len > 8){
+                ROS_ERROR_STREAM("diagnostics[" << i << "]: fields[" << j << "]: field does not fit into a CAN frame.");
+                return false;
+            }
 
             entry->length = len;
+            entry->name = name;
+            entry->poll_frequency_hz = poll_frequency_hz;
 
             std::vector<std::string>::iterator topic_it = find(topics.begin(), topics.end(), name);
             if(topic_it != topics.end()){
@@ -295,6 +341,107 @@ bool CobBmsDriverNode::loadConfigMap(XmlRpc::XmlRpcValue &diagnostics, std::vect
     return true;
 }
 
+//function that fills decoders_ and decoder_index_ from config_map_ and allocates histories_
+void CobBmsDriverNode::compileDecoders(int history_size)
+{
+    decoders_.clear();
+    decoder_index_.assign(257, 0);
+
+    //config_map_ is sorted by CAN-ID already
+    for (ConfigMap::iterator cm_it = config_map_.begin(); cm_it != config_map_.end(); ++cm_it)
+    {
+        const BmsParameter &param = *cm_it->second;
+        FieldDecoder decoder;
+        decoder.offset = param.offset;
+        decoder.end = param.offset + param.length;
+        decoder.sign_bit = param.is_signed ? (int64_t(1) << (8 * param.length - 1)) : 0;
+        decoder.last_value = 0;
+        decoder.has_value = false;
+        decoder.param = cm_it->second.get();
+        decoders_.push_back(decoder);
+        decoder_index_[cm_it->first + 1] = decoders_.size();
+    }
+    //CAN-IDs without parameters get an empty range
+    for (size_t i = 1; i < decoder_index_.size(); ++i)
+    {
+        decoder_index_[i] = std::max(decoder_index_[i], decoder_index_[i-1]);
+    }
+
+    received_.values.assign(decoders_.size(), 0.0);
+    received_.valid.assign(decoders_.size(), 0);
+    snapshot_ = received_;
+
+    //all memory is allocated here, adding samples only overwrites the oldest one
+    histories_.assign(decoders_.size(), History());
+    for (size_t i = 0; i < histories_.size(); ++i)
+    {
+        histories_[i].stamps.resize(history_size);
+        histories_[i].values.resize(history_size);
+    }
+}
+
+//adds a sample to the ring buffer and updates the running statistics
+void CobBmsDriverNode::History::add(double stamp, double value)
+{
+    if (!stamps.empty())
+    {
+        stamps[next] = stamp;
+        values[next] = value;
+        next = (next + 1) % stamps.size();
+        size = std::min(size + 1, stamps.size());
+    }
+
+    ++count;
+    if (count == 1 || value < min) min = value;
+    if (count == 1 || value > max) max = value;
+    const double delta = value - mean;
+    mean += delta / count;
+    m2 += delta * (value - mean);
+}
+
+//function to read the "battery_state" mapping from BatteryState fields to BmsParameter names and set up its publisher
+bool CobBmsDriverNode::setupBatteryState()
+{
+    static const char* field_names[BS_NUM_FIELDS] = { "voltage", "current", "charge", "capacity", "design_capacity" };
+    std::fill(battery_state_fields_, battery_state_fields_ + BS_NUM_FIELDS, -1);
+
+    std::map<std::string, std::string> mapping;
+    if (!nh_priv_.getParam("battery_state", mapping))
+    {
+        ROS_INFO_STREAM("Did not find \"battery_state\" on parameter server. BatteryState is not published");
+        return true;
+    }
+
+    for (std::map<std::string, std::string>::iterator it = mapping.begin(); it != mapping.end(); ++it)
+    {
+        const char** field = std::find(field_names, field_names + BS_NUM_FIELDS, it->first);
+        if (field == field_names + BS_NUM_FIELDS)
+        {
+            ROS_ERROR_STREAM("battery_state: unknown BatteryState field '" << it->first << "'.");
+            return false;
+        }
+        size_t i = 0;
+        while (i < decoders_.size() && decoders_[i].param->name != it->second) ++i;
+        if (i == decoders_.size())
+        {
+            ROS_ERROR_STREAM("battery_state: could not find entry for '" << it->second << "'.");
+            return false;
+        }
+        battery_state_fields_[field - field_names] = i;
+    }
+
+    double rate_hz;
+    if (!nh_priv_.getParam("battery_state_rate_hz", rate_hz) || rate_hz <= 0.0)
+    {
+        ROS_INFO_STREAM("Did not find valid \"battery_state_rate_hz\" on parameter server. Using default value: 10 Hz");
+        rate_hz = 10.0;
+    }
+
+    battery_state_pub_ = nh_priv_.advertise<sensor_msgs::BatteryState>("battery_state", 1);
+    battery_state_timer_ = nh_.createTimer(ros::Duration(1.0 / rate_hz), &CobBmsDriverNode::batteryStateTimerCallback, this);
+    return true;
+}
+
 //helper function to evaluate poll period from given poll frequency
 void CobBmsDriverNode::evaluatePollPeriodFrom(int poll_frequency_hz)
 {
@@ -326,7 +473,142 @@ void CobBmsDriverNode::optimizePollingLists()
     ROS_INFO_STREAM("Loaded \'"<< polling_list1_.size() << "\' CAN-ID(s) in polling_list1_ and \'"<< polling_list2_.size() <<"\' CAN-ID(s) in polling_list2_");
 }
 
-//function that polls BMS for given ids
+//function that creates poll_schedule_, each CAN-ID is polled with the highest poll frequency of its BmsParameters
+void CobBmsDriverNode::createPollSchedule()
+{
+    const Clock::time_point now = Clock::now();
+    const std::vector<uint8_t>* lists[] = { &polling_list1_, &polling_list2_ };
+
+    for (size_t l = 0; l < 2; ++l)
+    {
+        for (std::vector<uint8_t>::const_iterator id_it = lists[l]->begin(); id_it != lists[l]->end(); ++id_it)
+        {
+            //default: each list advances by one CAN-ID per poll period
+            double poll_frequency_hz = 1000.0 / (poll_period_for_two_ids_in_ms_ * lists[l]->size());
+            bool configured = false;
+
+            std::pair<ConfigMap::iterator, ConfigMap::iterator> range = config_map_.equal_range(*id_it);
+            for (; range.first != range.second; ++range.first)
+            {
+                double f = range.first->second->poll_frequency_hz;
+                if (f > 0.0 && (!configured || f > poll_frequency_hz))
+                {
+                    poll_frequency_hz = f;
+                    configured = true;
+                }
+            }
+
+            PollEntry entry;
+            entry.id = *id_it;
+            entry.period = boost::chrono::duration_cast<Clock::duration>(boost::chrono::duration<double>(1.0 / poll_frequency_hz));
+            entry.deadline = now;
+            entry.default_hz = poll_frequency_hz;
+            entry.configured = configured;
+            entry.on_demand = false;
+            entry.subscribed = true;
+            poll_schedule_.push_back(entry);
+
+            ROS_INFO_STREAM("Polling CAN-ID 0x" << std::hex << (unsigned int) entry.id << std::dec << " at " << poll_frequency_hz << " Hz");
+        }
+    }
+
+    int response_timeout_ms;
+    if (!nh_priv_.getParam("response_timeout_ms", response_timeout_ms))
+    {
+        response_timeout_ms = poll_period_for_two_ids_in_ms_;
+    }
+    response_timeout_ = boost::chrono::milliseconds(response_timeout_ms);
+}
+
+//function that marks the CAN-IDs of poll_schedule_ whose BmsParameters are only needed for their topics (and the diagnostics)
+void CobBmsDriverNode::setupDemandPolling()
+{
+    if (!nh_priv_.getParam("idle_poll_frequency_hz", idle_poll_frequency_hz_))
+    {
+        idle_poll_frequency_hz_ = 1.0 / updater_.getPeriod();
+        ROS_INFO_STREAM("Did not find \"idle_poll_frequency_hz\" on parameter server. Using the diagnostics rate: " << idle_poll_frequency_hz_ << " Hz");
+    }
+    if (idle_poll_frequency_hz_ <= 0.0)
+    {
+        ROS_INFO_STREAM("Demand-driven polling disabled");
+        return;
+    }
+
+    //the fields of the BatteryState are always needed
+    std::vector<BmsParameter*> battery_state_params;
+    for (size_t i = 0; i < BS_NUM_FIELDS; ++i)
+    {
+        if (battery_state_fields_[i] >= 0) battery_state_params.push_back(decoders_[battery_state_fields_[i]].param);
+    }
+
+    size_t on_demand = 0;
+    for (std::vector<PollEntry>::iterator entry = poll_schedule_.begin(); entry != poll_schedule_.end(); ++entry)
+    {
+        bool needed = false;
+        std::pair<ConfigMap::iterator, ConfigMap::iterator> range = config_map_.equal_range(entry->id);
+        for (; range.first != range.second; ++range.first)
+        {
+            BmsParameter *param = range.first->second.get();
+            if (static_cast<void*>(param->publisher)) entry->topics.push_back(param);
+            if (std::find(battery_state_params.begin(), battery_state_params.end(), param) != battery_state_params.end()) needed = true;
+        }
+        entry->on_demand = !needed && !entry->topics.empty();
+        if (entry->on_demand) ++on_demand;
+    }
+    ROS_INFO_STREAM("Polling " << on_demand << " CAN-ID(s) depending on the subscribers of their topics");
+}
+
+//function that sets the poll rates from the subscribers of the topics
+void CobBmsDriverNode::updatePollRates(const Clock::time_point &now)
+{
+    //two CAN-IDs per poll period
+    double budget_hz = 2000.0 / poll_period_for_two_ids_in_ms_;
+    std::vector<PollEntry*> boosted;
+    std::vector<double> rates(poll_schedule_.size());
+
+    for (size_t i = 0; i < poll_schedule_.size(); ++i)
+    {
+        PollEntry &entry = poll_schedule_[i];
+        bool subscribed = !entry.on_demand;
+        for (size_t t = 0; t < entry.topics.size() && !subscribed; ++t)
+        {
+            subscribed = entry.topics[t]->publisher.getNumSubscribers() > 0;
+        }
+        if (subscribed != entry.subscribed)
+        {
+            ROS_INFO_STREAM("CAN-ID 0x" << std::hex << (unsigned int) entry.id << std::dec << (subscribed ? " subscribed, polled at full rate" : " not subscribed, polled at the idle rate"));
+            entry.subscribed = subscribed;
+        }
+
+        if (!subscribed) rates[i] = std::min(idle_poll_frequency_hz_, entry.default_hz);
+        else if (entry.on_demand && !entry.configured)
+        {
+            boosted.push_back(&entry);
+            continue;
+        }
+        else rates[i] = entry.default_hz;
+        budget_hz -= rates[i];
+    }
+
+    //the remaining bus time is shared by the subscribed CAN-IDs, but they are not polled slower than by default
+    for (size_t i = 0; i < boosted.size(); ++i)
+    {
+        rates[boosted[i] - &poll_schedule_[0]] = std::max(boosted[i]->default_hz, budget_hz / boosted.size());
+    }
+
+    for (size_t i = 0; i < poll_schedule_.size(); ++i)
+    {
+        PollEntry &entry = poll_schedule_[i];
+        Clock::duration period = boost::chrono::duration_cast<Clock::duration>(boost::chrono::duration<double>(1.0 / rates[i]));
+        if (period == entry.period) continue;
+        entry.period = period;
+        //a faster rate applies right away
+        if (entry.deadline > now + period) entry.deadline = now + period;
+        ROS_DEBUG_STREAM("Polling CAN-ID 0x" << std::hex << (unsigned int) entry.id << std::dec << " at " << rates[i] << " Hz");
+    }
+}
+
+//function that polls BMS for given ids and waits for the answers
 void CobBmsDriverNode::pollBmsForIds(const uint16_t first_id, const uint16_t second_id)
 {
     can::Frame f(can::Header(bms_id_to_poll_,false,false,false),4);
@@ -335,30 +617,104 @@ void CobBmsDriverNode::pollBmsForIds(const uint16_t first_id, const uint16_t sec
     f.data[2] = second_id >> 8;
     f.data[3] = second_id & 0xff;
 
+    boost::mutex::scoped_lock lock(data_mutex_);
+    pending_ids_.clear();
+    if (first_id) pending_ids_.push_back(first_id & 0xff);
+    if (second_id) pending_ids_.push_back(second_id & 0xff);
+
     socketcan_interface_.send(f);
 
-    boost::this_thread::sleep_for(boost::chrono::milliseconds(poll_period_for_two_ids_in_ms_));
+    const Clock::time_point request = Clock::now();
+    if (last_request_ != Clock::time_point())
+    {
+        request_period_hist_.record(boost::chrono::duration_cast<boost::chrono::microseconds>(request - last_request_).count());
+    }
+    last_request_ = request;
+
+    const Clock::time_point timeout = request + response_timeout_;
+    while (!pending_ids_.empty())
+    {
+        if (response_cond_.wait_until(lock, timeout) == boost::cv_status::timeout)
+        {
+            ROS_DEBUG_STREAM("BMS did not answer " << pending_ids_.size() << " CAN-ID(s) in time");
+            break;
+        }
+    }
+    response_hist_.record(boost::chrono::duration_cast<boost::chrono::microseconds>(Clock::now() - request).count());
 }
 
-//cycles through polling lists and sends 2 ids at a time (one from each list) to the BMS
-void CobBmsDriverNode::pollNextInLists()
+//sends the CAN-IDs with the earliest passed deadlines to the BMS
+void CobBmsDriverNode::pollNextDue()
 {
-    //restart if reached the end of polling lists
-    if (polling_list1_it_ == polling_list1_.end()) polling_list1_it_ = polling_list1_.begin();
-    if (polling_list2_it_ == polling_list2_.end()) polling_list2_it_ = polling_list2_.begin();
-    //clear stat_, so that it can be refilled with new data
-    stat_.clear();
+    const Clock::time_point now = Clock::now();
+    const Clock::time_point max_idle = now + boost::chrono::milliseconds(100);
+
+    if (idle_poll_frequency_hz_ > 0.0 && now >= next_subscriber_check_)
+    {
+        updatePollRates(now);
+        next_subscriber_check_ = now + boost::chrono::seconds(1);
+    }
+
+    std::vector<PollEntry>::iterator first = poll_schedule_.end();
+    std::vector<PollEntry>::iterator second = poll_schedule_.end();
+    for (std::vector<PollEntry>::iterator it = poll_schedule_.begin(); it != poll_schedule_.end(); ++it)
+    {
+        if (first == poll_schedule_.end() || it->deadline < first->deadline)
+        {
+            second = first;
+            first = it;
+        }
+        else if (second == poll_schedule_.end() || it->deadline < second->deadline)
+        {
+            second = it;
+        }
+    }
+
+    if (first == poll_schedule_.end() || first->deadline > now)
+    {
+        boost::this_thread::sleep_until(first == poll_schedule_.end() ? max_idle : std::min(first->deadline, max_idle));
+        return;
+    }
 
-    uint16_t first_id = (polling_list1_it_ == polling_list1_.end()) ? 0 : (*polling_list1_it_ | 0x0100);
-    uint16_t second_id = (polling_list2_it_ == polling_list2_.end()) ? 0 : (*polling_list2_it_ | 0x0100);
+    //the second slot of the request is only used if that CAN-ID is due as well
+    if (second != poll_schedule_.end() && second->deadline > now) second = poll_schedule_.end();
+
+    std::vector<PollEntry>::iterator polled[] = { first, second };
+    for (size_t i = 0; i < 2; ++i)
+    {
+        if (polled[i] == poll_schedule_.end()) continue;
+        //keep the phase, but do not try to catch up on missed polls
+        polled[i]->deadline += polled[i]->period;
+        if (polled[i]->deadline < now) polled[i]->deadline = now + polled[i]->period;
+    }
+
+    uint16_t first_id = first->id | 0x0100;
+    uint16_t second_id = (second == poll_schedule_.end()) ? 0 : (second->id | 0x0100);
 
     ROS_DEBUG_STREAM("polling BMS for CAN-IDs: 0x" << std::hex << (int)first_id << " and 0x" << (int) second_id << std::dec);
 
     pollBmsForIds(first_id,second_id);
+}
 
-    //increment iterators for next poll
-    if (!polling_list1_.empty()) ++polling_list1_it_;
-    if (!polling_list2_.empty()) ++polling_list2_it_;
+//polls the BMS independently of the ROS callbacks
+void CobBmsDriverNode::pollThread()
+{
+    try
+    {
+        while (ros::ok())
+        {
+            pollNextDue();
+        }
+    }
+    catch (boost::thread_interrupted&)
+    {
+    }
+}
+
+//starts the poll thread, ROS callbacks are processed by the caller
+void CobBmsDriverNode::startPolling()
+{
+    poll_thread_.reset(new boost::thread(&CobBmsDriverNode::pollThread, this));
 }
 
 //callback function to handle all types of frames received from BMS
@@ -366,19 +722,51 @@ void CobBmsDriverNode::handleFrames(const can::Frame &f)
 {
     boost::mutex::scoped_lock lock(data_mutex_);
 
-    //id to find in config map
-    std::pair<ConfigMap::iterator, ConfigMap::iterator>  range = config_map_.equal_range(f.id);
+    const uint8_t id = static_cast<uint8_t>(f.id);
+    const double stamp = ros::Time::now().toSec();
 
-    for (; range.first != range.second; ++range.first)
+    for (size_t i = decoder_index_[id]; i < decoder_index_[id + 1]; ++i)
     {
-        range.first->second->update(f);
+        FieldDecoder &decoder = decoders_[i];
+        if (f.dlc < decoder.end) continue;
+
+        //big endian value, sign extended for signed fields
+        int64_t value = 0;
+        for (uint8_t b = decoder.offset; b < decoder.end; ++b)
+        {
+            value = (value << 8) | f.data[b];
+        }
+        if (value & decoder.sign_bit) value -= decoder.sign_bit << 1;
+
+        //only changed values are converted, stored for the snapshot and published
+        const bool unchanged = decoder.has_value && value == decoder.last_value;
+        const double converted = unchanged ? received_.values[i] : decoder.param->convert(value);
+
+        //the history keeps the sampling of the BMS, so unchanged values are added as well
+        histories_[i].add(stamp, converted);
+        if (unchanged) continue;
+
+        decoder.last_value = value;
+        decoder.has_value = true;
+        received_.values[i] = converted;
+        received_.valid[i] = 1;
+        received_.last_update = ros::Time::now();
+        decoder.param->publish(converted);
+    }
+
+    //release the next request once all polled CAN-IDs were answered
+    std::vector<uint8_t>::iterator pending_it = std::find(pending_ids_.begin(), pending_ids_.end(), static_cast<uint8_t>(f.id));
+    if (pending_it != pending_ids_.end())
+    {
+        pending_ids_.erase(pending_it);
+        if (pending_ids_.empty()) response_cond_.notify_one();
     }
 }
 
 //updates the diagnostics data with the new data received from BMS
 void CobBmsDriverNode::produceDiagnostics(diagnostic_updater::DiagnosticStatusWrapper &stat)
 {
-    boost::mutex::scoped_lock lock(data_mutex_);
+    takeSnapshot();
 
     can::State state = socketcan_interface_.getState();
     stat.add("error_code", state.error_code);
@@ -402,12 +790,36 @@ void CobBmsDriverNode::produceDiagnostics(diagnostic_updater::DiagnosticStatusWr
         break;
     }
 
-    for (ConfigMap::iterator cm_it = config_map_.begin(); cm_it != config_map_.end(); ++cm_it)
+    stat.values.reserve(stat.values.size() + decoders_.size());
+    for (size_t i = 0; i < decoders_.size(); ++i)
     {
-                stat.values.push_back(cm_it->second->kv);
+        diagnostic_msgs::KeyValue kv = decoders_[i].param->kv;
+        if (snapshot_.valid[i]) kv.value = decoders_[i].param->toString(snapshot_.values[i]);
+        stat.values.push_back(kv);
+    }
+
+    //requests that ran into the timeout count as overruns, as do requests delayed by more than a default poll period
+    std::vector<std::pair<std::string, std::string> > timing;
+    LatencyHistogram::Summary summary;
+    response_hist_.getSummary(&summary, boost::chrono::duration_cast<boost::chrono::microseconds>(response_timeout_).count() - 1, true);
+    LatencyHistogram::appendKeyValues("response time", summary, &timing);
+    request_period_hist_.getSummary(&summary, 2e3 * poll_period_for_two_ids_in_ms_, true);
+    LatencyHistogram::appendKeyValues("request period", summary, &timing);
+    for (size_t i = 0; i < timing.size(); ++i)
+    {
+        stat.add(timing[i].first, timing[i].second);
     }
 }
 
+//copies received_ to snapshot_
+void CobBmsDriverNode::takeSnapshot()
+{
+    boost::mutex::scoped_lock lock(data_mutex_);
+    snapshot_.values = received_.values;
+    snapshot_.valid = received_.valid;
+    snapshot_.last_update = received_.last_update;
+}
+
 void CobBmsDriverNode::diagnosticsTimerCallback(const ros::TimerEvent& event)
 {
     //update diagnostics
@@ -419,6 +831,86 @@ void CobBmsDriverNode::diagnosticsTimerCallback(const ros::TimerEvent& event)
     }
 }
 
+//publishes the BatteryState of the current snapshot
+void CobBmsDriverNode::batteryStateTimerCallback(const ros::TimerEvent& event)
+{
+    takeSnapshot();
+
+    //fields which are not mapped or not received yet are NaN
+    double values[BS_NUM_FIELDS];
+    bool any_valid = false;
+    for (int f = 0; f < BS_NUM_FIELDS; ++f)
+    {
+        const int i = battery_state_fields_[f];
+        const bool valid = (i >= 0) && snapshot_.valid[i];
+        values[f] = valid ? snapshot_.values[i] : std::numeric_limits<double>::quiet_NaN();
+        any_valid = any_valid || valid;
+    }
+    if (!any_valid) return;
+
+    sensor_msgs::BatteryState msg;
+    msg.header.stamp = snapshot_.last_update;
+    msg.voltage = values[BS_VOLTAGE];
+    msg.current = values[BS_CURRENT];
+    msg.charge = values[BS_CHARGE];
+    msg.capacity = values[BS_CAPACITY];
+    msg.design_capacity = values[BS_DESIGN_CAPACITY];
+    msg.percentage = (values[BS_CAPACITY] > 0.0) ? values[BS_CHARGE] / values[BS_CAPACITY] : std::numeric_limits<double>::quiet_NaN();
+    msg.power_supply_status = sensor_msgs::BatteryState::POWER_SUPPLY_STATUS_UNKNOWN;
+    msg.power_supply_health = sensor_msgs::BatteryState::POWER_SUPPLY_HEALTH_UNKNOWN;
+    msg.power_supply_technology = sensor_msgs::BatteryState::POWER_SUPPLY_TECHNOLOGY_UNKNOWN;
+    msg.present = true;
+
+    if (blackboard_.isOpen())
+    {
+        RobotStateBlackboard::PowerData data;
+        data.dVoltage = msg.voltage;
+        data.dCurrent = msg.current;
+        data.dRelativeCapacity = std::isnan(msg.percentage) ? -1.0 : 100.0 * msg.percentage;
+        data.bCharging = msg.current > 0.0;
+        data.dStampS = RobotStateBlackboard::getMonotonicTime();
+        blackboard_.writePower(data);
+    }
+    battery_state_pub_.publish(msg);
+}
+
+//returns the history and statistics of one BmsParameter
+bool CobBmsDriverNode::historyServiceCallback(cob_bms_driver::GetBmsHistory::Request &req, cob_bms_driver::GetBmsHistory::Response &res)
+{
+    size_t i = 0;
+    while (i < decoders_.size() && decoders_[i].param->name != req.name) ++i;
+    if (i == decoders_.size())
+    {
+        res.success = false;
+        res.message = "unknown parameter '" + req.name + "'";
+        return true;
+    }
+
+    boost::mutex::scoped_lock lock(data_mutex_);
+    const History &history = histories_[i];
+
+    size_t n = history.size;
+    if (req.max_samples > 0 && req.max_samples < n) n = req.max_samples;
+    res.stamps.resize(n);
+    res.values.resize(n);
+    //the oldest requested sample is n slots before next
+    const size_t capacity = history.stamps.size();
+    for (size_t k = 0; k < n; ++k)
+    {
+        const size_t slot = (history.next + capacity - n + k) % capacity;
+        res.stamps[k] = history.stamps[slot];
+        res.values[k] = history.values[slot];
+    }
+
+    res.count = history.count;
+    res.min = history.min;
+    res.max = history.max;
+    res.mean = history.mean;
+    res.variance = (history.count > 1) ? history.m2 / (history.count - 1) : 0.0;
+    res.success = true;
+    return true;
+}
+
 int main(int argc, char **argv)
 {
     ros::init(argc, argv, "bms_driver_node");
@@ -428,10 +920,7 @@ int main(int argc, char **argv)
     if (!cob_bms_driver_node.prepare()) return 1;
 
     ROS_INFO("Started polling BMS...");
-    while (ros::ok())
-    {
-        cob_bms_driver_node.pollNextInLists();
-        ros::spinOnce();
-    }
+    cob_bms_driver_node.startPolling();
+    ros::spin();
     return 0;
 }
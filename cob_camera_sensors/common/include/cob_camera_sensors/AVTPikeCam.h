@@ -32,6 +32,8 @@
 
 #include <cstdlib>
 
+#include <boost/shared_ptr.hpp>
+
 #ifdef _WIN32
 	#include <fgcamera.h>
 	#ifdef __MINGW__
@@ -65,6 +67,46 @@ using namespace std;
 
 namespace ipa_CameraSensors {
 
+/// @ingroup CameraSensorDriver
+/// Frame of the DMA ring buffer, acquired with <code>AVTPikeCam::GetDMAFrame</code>.
+/// The image is a header directly on the DMA buffer in the color coding of the camera
+/// (i.e. RGB order for RGB8 modes). The buffer is returned to the driver, when the
+/// frame is destroyed, hence the camera's DMA buffer size must be larger than
+/// the number of frames held at the same time.
+class __DLL_LIBCAMERASENSORS__ AVTPikeCamFrame
+{
+	friend class AVTPikeCam;
+
+	public:
+		/// Destructor. Returns the buffer to the DMA ring buffer.
+		~AVTPikeCamFrame();
+
+		/// Image header on the DMA buffer.
+		/// The data is only valid as long as the frame exists.
+		const cv::Mat& GetImage() const { return m_Image; }
+
+		/// Capture time and sequence number of the frame.
+		const t_FrameInfo& GetFrameInfo() const { return m_FrameInfo; }
+
+	private:
+#ifdef __LINUX__
+		AVTPikeCamFrame(dc1394camera_t* cam, dc1394video_frame_t* frame, boost::shared_ptr<bool> captureActive);
+
+		dc1394camera_t* m_cam;	///< Camera, the frame belongs to
+		dc1394video_frame_t* m_Frame;	///< Dequeued DMA frame
+		boost::shared_ptr<bool> m_CaptureActive;	///< False, when DMA capture of the camera has been stopped
+#endif
+		cv::Mat m_Image;	///< Header on the DMA buffer
+		t_FrameInfo m_FrameInfo;	///< Capture time and sequence number
+
+		/// Frames are not copyable.
+		AVTPikeCamFrame(const AVTPikeCamFrame&);
+		AVTPikeCamFrame& operator=(const AVTPikeCamFrame&);
+};
+
+/// Smart pointer to a DMA frame, the frame is released with the last reference.
+typedef boost::shared_ptr<AVTPikeCamFrame> AVTPikeCamFramePtr;
+
 /// @ingroup CameraSensorDriver
 /// Interface developed for AVT PIKE 145C camera.
 /// Interface should also fit to other IEEE 1394 cameras.
@@ -104,7 +146,45 @@ class __DLL_LIBCAMERASENSORS__ AVTPikeCam : public AbstractColorCamera
 		dc1394framerate_t m_FrameRate;		///< Frame rate.
 		dc1394video_mode_t m_VideoMode;		///< Comprise format and mode (i.e. DC1394_VIDEO_MODE_1280x960_RGB8 or DC1394_VIDEO_MODE_FORMAT7_0)
 		dc1394color_coding_t m_ColorCoding;	///< Necessary for Format 7 video mode. Here the color coding is not specified through the video mode
+		boost::shared_ptr<bool> m_CaptureActive;	///< Shared with the handed out DMA frames, reset when DMA capture stops
+
+		/// Dequeues the next frame from the DMA ring buffer.
+		/// @param frame The dequeued frame, has to be enqueued again by the caller
+		/// @param getLatestFrame Drop all frames already waiting in the ring buffer
+		/// @return Return code
+		unsigned long DequeueFrame(dc1394video_frame_t** frame, bool getLatestFrame);
+
+		/// Releases the previous frame and dequeues the next one to <code>m_Frame</code>.
+		/// @param getLatestFrame Drop all frames already waiting in the ring buffer
+		/// @return Return code
+		unsigned long AcquireFrame(bool getLatestFrame);
+
+		/// Converts <code>m_Frame</code> from its color coding to a BGR image.
+		/// @param colorImage The converted image, created if necessary
+		/// @return Return code
+		unsigned long ConvertFrame(cv::Mat& colorImage);
+
+		cv::Rect m_Format7ROI;		///< Format7 region of interest in (binned) sensor pixels, zero width or height for the whole sensor
+		unsigned int m_PacketSize;	///< Format7 bytes per isochronous packet, 0 for the size recommended by the camera
+		int m_Binning;				///< Format7 binning factor (1 or 2), 0 to keep the configured Format7 mode
+
+		/// Stops transmission and DMA capture, the camera itself stays open.
+		/// Frames still held by the user are invalidated as in <code>Close</code>.
+		/// @param wasCapturing True, if DMA capture had been running
+		/// @return Return code
+		unsigned long StopCapture(bool* wasCapturing);
+
+		/// Sets up DMA capture with <code>m_BufferSize</code> buffers and starts transmission.
+		/// @return Return code
+		unsigned long StartCapture();
+
+		/// Applies <code>m_Binning</code>, <code>m_Format7ROI</code> and <code>m_PacketSize</code> to the camera.
+		/// A running DMA capture is stopped and set up again for the new image size,
+		/// without closing the camera. Before <code>Open</code>, the values are only stored.
+		/// @return Return code
+		unsigned long ApplyFormat7();
 #endif
+		int m_Downscale;	///< Color images are reduced by this factor (1 or 2) during the color conversion
 
 #ifdef _WIN32
 		CFGCamera m_cam;			///< The camera object for AVT FireGrab (part of AVT FirePackage)
@@ -143,6 +223,13 @@ class __DLL_LIBCAMERASENSORS__ AVTPikeCam : public AbstractColorCamera
 		unsigned long GetColorImage(char* colorImageData, bool getLatestFrame);
 		unsigned long GetColorImage(cv::Mat* colorImage, bool getLatestFrame);
 
+		/// Acquires the next frame without copying it out of the DMA ring buffer.
+		/// In contrast to <code>GetColorImage</code>, the image is not converted to BGR.
+		/// @param frame The acquired frame, holds the DMA buffer until it is released
+		/// @param getLatestFrame Drop all frames already waiting in the ring buffer
+		/// @return Return code
+		unsigned long GetDMAFrame(AVTPikeCamFramePtr* frame, bool getLatestFrame);
+
 		unsigned long SaveParameters(const char* filename);		//speichert die Parameter in das File
 
 		/// Sets the camera properties.
@@ -159,7 +246,15 @@ class __DLL_LIBCAMERASENSORS__ AVTPikeCam : public AbstractColorCamera
 		///	<li> PROP_GAIN: 0..680</li>
 		///	<li> PROP_FRAME_RATE: 0..60</li>
 		///	<li> PROP_FW_OPERATION_MODE: A / B</li>
+		///	<li> PROP_DMA_BUFFER_SIZE: 1.., only before the camera is opened</li>
+		///	<li> PROP_RESOLUTION: width x height of the Format7 region of interest, VALUE_AUTO for the whole sensor</li>
+		///	<li> PROP_ROI_OFFSET: left x top of the Format7 region of interest</li>
+		///	<li> PROP_PACKET_SIZE: bytes per Format7 packet, VALUE_AUTO for the size recommended by the camera</li>
+		///	<li> PROP_BINNING: 1 (Format7 mode 0) or 2 (Format7 mode 3, 2x2 binning)</li>
 		///</ol>
+		/// The Format7 properties are rounded to the units of the camera and may be changed
+		/// while the camera is open. DMA capture is then set up again without <code>Close</code>/<code>Open</code>.
+		/// The largest packet size gives the highest frame rate for the region of interest.
 		unsigned long SetProperty(t_cameraProperty* cameraProperty);
 		unsigned long SetPropertyDefaults();
 		unsigned long GetProperty(t_cameraProperty* cameraProperty);
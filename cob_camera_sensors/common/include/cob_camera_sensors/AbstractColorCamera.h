@@ -31,6 +31,12 @@
 	#include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/CameraSensorTypes.h"
 #endif
 
+#ifdef __LINUX__
+	#include "cob_camera_sensors/FrameInfo.h"
+#else
+	#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/FrameInfo.h"
+#endif
+
 #include <boost/shared_ptr.hpp>
 #include <sstream>
 
@@ -118,6 +124,11 @@ class __DLL_LIBCAMERASENSORS__ AbstractColorCamera
 		/// @throw IPA_Exception Throws an exception, if camera access failed
 		virtual unsigned long GetColorImage(cv::Mat* colorImage, bool getLatestFrame=true)=0;
 
+		/// Returns capture time and sequence number of the image returned by the last
+		/// call to <code>GetColorImage</code>.
+		/// @return The frame descriptor
+		virtual t_FrameInfo GetFrameInfo() {return m_FrameInfo;}
+
 		/// Returns the camera type.
 		/// @return The camera type
 		virtual t_cameraType GetCameraType();
@@ -180,6 +191,8 @@ class __DLL_LIBCAMERASENSORS__ AbstractColorCamera
 		t_cameraType m_CameraType; ///< Camera Type
 
 		unsigned int m_BufferSize; ///< Number of images, the camera buffers internally
+
+		t_FrameInfo m_FrameInfo; ///< Descriptor of the last returned image, set by the camera implementation
 	private:
 
 		/// Loads all camera specific parameters from the xml configuration file and saves them in t_ColorCameraParameters.
@@ -68,6 +68,12 @@
 	#include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/CameraSensorTypes.h"
 #endif
 
+#ifdef __LINUX__
+	#include "cob_camera_sensors/FrameInfo.h"
+#else
+	#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/FrameInfo.h"
+#endif
+
 #include <opencv2/core/core.hpp>
 
 #include <iostream>
@@ -78,6 +84,39 @@
 
 namespace ipa_CameraSensors {
 
+/// Image channels of a range imaging sensor, combined to a bit mask in <code>t_RangeFrameRequest</code>.
+enum t_RangeChannel
+{
+	RANGE_CHANNEL = 1,	///< Range image
+	GRAY_CHANNEL = 2,	///< Intensity or amplitude image
+	CARTESIAN_CHANNEL = 4	///< Cartesian (x,y,z) image
+};
+
+/// Describes which images <code>AcquireFrame</code> acquires and how.
+struct t_RangeFrameRequest
+{
+	int channels; ///< Bit mask of <code>t_RangeChannel</code>
+	bool getLatestFrame; ///< Set true to acquire a new image on calling instead of returning the one acquired last time
+	bool undistort; ///< Undistort the images
+	ipa_CameraSensors::t_ToFGrayImageType grayImageType; ///< Either gray image data is filled with amplitude image or intensity image
+
+	t_RangeFrameRequest(int _channels = GRAY_CHANNEL | CARTESIAN_CHANNEL, bool _getLatestFrame = true, bool _undistort = true,
+		ipa_CameraSensors::t_ToFGrayImageType _grayImageType = ipa_CameraSensors::INTENSITY_32F1)
+	: channels(_channels), getLatestFrame(_getLatestFrame), undistort(_undistort), grayImageType(_grayImageType) {}
+};
+
+/// Images of one acquisition, meant to be reused for the next acquisition (e.g. from a <code>FramePool</code>).
+/// <code>AcquireFrame</code> writes into the existing buffers of the images, if they have the right size and type,
+/// so images bound to external memory (e.g. a message) are filled without copy.
+/// Images of channels that were not requested keep their data.
+struct t_RangeFrame
+{
+	cv::Mat rangeImage; ///< Range image, 32 bit float
+	cv::Mat grayImage; ///< Gray image of the requested type
+	cv::Mat cartesianImage; ///< Cartesian (x,y,z) image in meters, 32 bit float with 3 channels
+	t_FrameInfo info; ///< Capture time and sequence number of the acquired images
+};
+
 /// Define smart pointer type for toolbox
 class AbstractRangeImagingSensor;
 typedef boost::shared_ptr<AbstractRangeImagingSensor> AbstractRangeImagingSensorPtr;
@@ -143,6 +182,13 @@ public:
 	/// @return Return code.
 	virtual unsigned long GetProperty(t_cameraProperty* cameraProperty) =0;
 
+	/// Acquires the requested images into a reusable frame.
+	/// The default implementation calls the <code>cv::Mat</code> version of <code>AcquireImages</code>.
+	/// @param request The requested channels and acquisition settings
+	/// @param frame The frame, its images are (re-)allocated only if size or type do not match
+	/// @return Return code
+	virtual unsigned long AcquireFrame(const t_RangeFrameRequest& request, t_RangeFrame& frame);
+
 	/// Acquires an image from SwissRanger camera.
 	/// Data is read from the camera and put into a corresponding OpenCV <code>cv::Mat</code> data type.
 	/// The <code>cv::Mat</code> are allocated on demand.
@@ -173,6 +219,11 @@ public:
 		char* cartesianImage=NULL, bool getLatestFrame=true, bool undistort=true, 
 		ipa_CameraSensors::t_ToFGrayImageType grayImageType = ipa_CameraSensors::INTENSITY) = 0;
 
+	/// Returns capture time and sequence number of the images returned by the last
+	/// call to <code>AcquireImages</code>.
+	/// @return The frame descriptor
+	virtual t_FrameInfo GetFrameInfo() {return m_FrameInfo;}
+
 	/// Save camera parameters.
 	/// Saves the on-line set parameters for the range imaging camera to a file.
 	/// @param filename Configuration file name.
@@ -234,11 +285,18 @@ protected:
 
 	unsigned int m_BufferSize; ///< Number of images, the camera buffers internally
 
+	t_FrameInfo m_FrameInfo; ///< Descriptor of the last returned images, set by the camera implementation
+
 	cv::Mat m_intrinsicMatrix;		///< Intrinsic parameters [fx 0 cx; 0 fy cy; 0 0 1]
 	cv::Mat m_extrinsicMatrix;		///< Extrinsic parameters: Translation und Rotation
 	cv::Mat m_undistortMapX;		///< The output array of x coordinates for the undistortion map
 	cv::Mat m_undistortMapY;		///< The output array of Y coordinates for the undistortion map
 
+	/// Implementation of the <code>cv::Mat</code> version of <code>AcquireImages</code> for cameras that implement <code>AcquireFrame</code>.
+	/// The given images share their buffers with the frame, so no data is copied.
+	unsigned long AcquireImagesIntoFrame(cv::Mat* rangeImage, cv::Mat* grayImage, cv::Mat* cartesianImage,
+		bool getLatestFrame, bool undistort, ipa_CameraSensors::t_ToFGrayImageType grayImageType);
+
 private:
 	
 	/// Load general SR31 parameters and previously determined calibration parameters.
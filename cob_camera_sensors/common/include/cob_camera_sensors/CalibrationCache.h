@@ -0,0 +1,77 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/// @file CalibrationCache.h
+/// Binary cache of calibration matrices that are stored as opencv xml files.
+
+#ifndef __IPA_CALIBRATIONCACHE_H__
+#define __IPA_CALIBRATIONCACHE_H__
+
+#ifdef __LINUX__
+	#include "cob_vision_utils/CameraSensorDefines.h"
+#else
+	#include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/CameraSensorDefines.h"
+#endif
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace ipa_CameraSensors {
+
+/// File layout of a calibration cache.
+/// The file starts with the header, followed by one entry per matrix and the matrix data.
+/// Matrix data is stored row by row without padding and starts on a c_CalibrationCacheAlignment byte boundary.
+/// All values are stored in host byte order.
+struct t_CalibrationCacheHeader
+{
+	char magic[8]; ///< "IPACALIB"
+	boost::uint32_t version; ///< File format version
+	boost::uint32_t numberOfMatrices; ///< Number of entries
+	boost::uint64_t sourceHash; ///< Hash over the contents of all source files, in order
+};
+
+/// One matrix of a calibration cache.
+struct t_CalibrationCacheEntry
+{
+	boost::int32_t rows;
+	boost::int32_t cols;
+	boost::int32_t type; ///< Opencv type e.g. CV_64FC1, -1 if the source file could not be loaded
+	boost::uint32_t reserved;
+	boost::uint64_t offset; ///< Offset of the data, measured from the file start
+};
+
+static const char c_CalibrationCacheMagic[8] = {'I', 'P', 'A', 'C', 'A', 'L', 'I', 'B'};
+static const boost::uint32_t c_CalibrationCacheVersion = 1;
+static const size_t c_CalibrationCacheAlignment = 64;
+
+/// Loads matrices that were stored with cvSave, e.g. the z-calibration coefficients of the range cameras.
+/// Parsing the xml files takes long for per-pixel matrices. Therefore the matrices are read from a binary cache file,
+/// if it was built from source files with the same contents. Otherwise the xml files are parsed and the cache
+/// is (re-)written for the next start. A cache that can not be written, e.g. in a read-only directory, only costs time.
+/// @param sourceFiles The xml files, one per matrix
+/// @param cacheFile File-path and file-name of the cache
+/// @param matrices One matrix per source file, empty if the file could not be loaded
+/// @return Return code
+__DLL_LIBCAMERASENSORS__ unsigned long LoadCalibrationMatrices(const std::vector<std::string>& sourceFiles,
+	const std::string& cacheFile, std::vector<cv::Mat>& matrices);
+
+} // end namespace ipa_CameraSensors
+#endif // __IPA_CALIBRATIONCACHE_H__
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/// @file DepthRegistration.h
+/// Registration of range sensor points with the image of a color camera.
+
+#ifndef __IPA_DEPTHREGISTRATION_H__
+#define __IPA_DEPTHREGISTRATION_H__
+
+#ifdef __LINUX__
+	#include "cob_vision_utils/CameraSensorDefines.h"
+#else
+	#include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/CameraSensorDefines.h"
+#endif
+
+#include <opencv2/core/core.hpp>
+
+namespace ipa_CameraSensors {
+
+/// Looks up the color of each point of a range sensor in the image of a color camera.
+/// Intrinsic and extrinsic parameters are combined once into a single 3x4 projection,
+/// so registering a point costs one matrix multiplication, one division and one lookup.
+/// All steps run over whole images with the vectorized OpenCV functions.
+class __DLL_LIBCAMERASENSORS__ DepthRegistration
+{
+public:
+
+	DepthRegistration();
+
+	/// Sets up the projection of range sensor points into the color image.
+	/// @param colorIntrinsicMatrix 3x3 intrinsic matrix of the color camera
+	/// @param colorImageSize Image size the intrinsic matrix has been calibrated for
+	/// @param rotation 3x3 rotation from range sensor to color camera coordinates
+	/// @param translation 3x1 translation from range sensor to color camera coordinates in meters
+	/// @return Return code
+	unsigned long Init(const cv::Mat& colorIntrinsicMatrix, cv::Size colorImageSize,
+		const cv::Mat& rotation, const cv::Mat& translation);
+
+	bool isInitialized() {return m_Initialized;}
+
+	/// Projects each point into the color image.
+	/// @param xyzImage CV_32FC3 points of the range sensor in meters
+	/// @param colorImageSize Size of the color image, a downscaled image scales the projection
+	/// @param uvImage CV_32FC2 color image coordinates of each point, (-1,-1) for points behind the color camera
+	/// @return Return code
+	unsigned long Project(const cv::Mat& xyzImage, cv::Size colorImageSize, cv::Mat& uvImage);
+
+	/// Looks up the color of each point.
+	/// @param xyzImage CV_32FC3 points of the range sensor in meters
+	/// @param colorImage CV_8UC3 color image
+	/// @param registeredColorImage CV_8UC3 color of each point in the size of <code>xyzImage</code>,
+	///		   black for points outside the color image
+	/// @return Return code
+	unsigned long Register(const cv::Mat& xyzImage, const cv::Mat& colorImage, cv::Mat& registeredColorImage);
+
+private:
+
+	bool m_Initialized;
+	cv::Matx34f m_Projection;	///< Color intrinsics times [R|t]
+	cv::Size m_ColorImageSize;	///< Calibrated color image size
+	cv::Mat m_Homogeneous;	///< CV_32FC3 projected points before the division, reused
+	cv::Mat m_UV;	///< CV_32FC2 color image coordinates, reused
+};
+
+} // end namespace ipa_CameraSensors
+#endif // __IPA_DEPTHREGISTRATION_H__
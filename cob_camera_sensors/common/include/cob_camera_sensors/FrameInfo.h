@@ -0,0 +1,52 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/// @file FrameInfo.h
+/// Capture time and sequence number of acquired frames.
+
+#ifndef __IPA_FRAMEINFO_H__
+#define __IPA_FRAMEINFO_H__
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace ipa_CameraSensors {
+
+/// Descriptor of the frame returned by the last acquisition of a camera.
+struct t_FrameInfo
+{
+	/// Capture time in seconds since 1970-01-01 UTC, taken from the driver where available.
+	/// 0 if no frame has been acquired yet.
+	double timestamp;
+
+	/// Number of frames delivered by the device since it was opened, starting with 1.
+	/// Gaps between successive frames indicate dropped or skipped frames.
+	unsigned long sequenceNumber;
+
+	t_FrameInfo() : timestamp(0), sequenceNumber(0) {}
+};
+
+/// Current system time in seconds since 1970-01-01 UTC.
+/// Used as capture time by drivers, that get no timestamp from the device.
+inline double GetFrameTimestamp()
+{
+	static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+	return (boost::posix_time::microsec_clock::universal_time() - epoch).total_microseconds() * 1e-6;
+}
+
+} // end namespace ipa_CameraSensors
+
+#endif // __IPA_FRAMEINFO_H__
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/// @file FramePool.h
+/// Pool of reusable, reference counted frame buffers.
+
+#ifndef __IPA_FRAMEPOOL_H__
+#define __IPA_FRAMEPOOL_H__
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace ipa_CameraSensors {
+
+/// Hands out objects (e.g. image messages) through reference counted pointers.
+/// When the last reference to an object is released, the object goes back to the pool
+/// with its contents, so that buffers keep their allocated memory for the next frame.
+/// Objects may be released from any thread and may outlive the pool.
+template <class T>
+class FramePool
+{
+	/// State shared with the deleters of the handed out objects.
+	struct t_PoolState
+	{
+		boost::mutex mutex;
+		std::vector<T*> idle;	///< Released objects, ready for reuse
+		size_t capacity;	///< Maximal number of idle objects
+
+		~t_PoolState()
+		{
+			for (size_t i=0; i<idle.size(); i++)
+			{
+				delete idle[i];
+			}
+		}
+	};
+
+	/// Returns released objects to the pool instead of deleting them.
+	struct t_Recycler
+	{
+		boost::shared_ptr<t_PoolState> state;
+
+		void operator()(T* object)
+		{
+			{
+				boost::mutex::scoped_lock lock(state->mutex);
+				if (state->idle.size() < state->capacity)
+				{
+					state->idle.push_back(object);
+					return;
+				}
+			}
+			delete object;
+		}
+	};
+
+public:
+	typedef boost::shared_ptr<T> Ptr;
+
+	/// Constructor.
+	/// @param capacity Maximal number of idle objects kept for reuse.
+	///		   Should cover the frames held by consumers at the same time.
+	explicit FramePool(size_t capacity = 4)
+	: m_State(new t_PoolState())
+	{
+		m_State->capacity = capacity;
+	}
+
+	/// Returns a released object, or a new one if none is idle.
+	/// Reused objects keep the contents they had when they were released.
+	Ptr Get()
+	{
+		T* object = 0;
+		{
+			boost::mutex::scoped_lock lock(m_State->mutex);
+			if (!m_State->idle.empty())
+			{
+				object = m_State->idle.back();
+				m_State->idle.pop_back();
+			}
+		}
+		if (object == 0)
+		{
+			object = new T();
+		}
+
+		t_Recycler recycler;
+		recycler.state = m_State;
+		return Ptr(object, recycler);
+	}
+
+	/// Returns the number of idle objects.
+	size_t GetNumberOfIdle()
+	{
+		boost::mutex::scoped_lock lock(m_State->mutex);
+		return m_State->idle.size();
+	}
+
+private:
+	boost::shared_ptr<t_PoolState> m_State;
+};
+
+} // end namespace ipa_CameraSensors
+
+#endif // __IPA_FRAMEPOOL_H__
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/// @file IIDCColorConversion.h
+/// Conversion of the IIDC (IEEE 1394 digital camera) color codings to BGR images.
+
+#ifndef __IPA_IIDCCOLORCONVERSION_H__
+#define __IPA_IIDCCOLORCONVERSION_H__
+
+#ifdef __LINUX__
+	#include "cob_vision_utils/CameraSensorDefines.h"
+#else
+	#include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/CameraSensorDefines.h"
+#endif
+
+#include <opencv2/core/core.hpp>
+
+namespace ipa_CameraSensors {
+
+/// Bayer patterns, named by the colors of the upper left 2x2 block.
+enum t_BayerPattern
+{
+	BAYER_RGGB = 0,
+	BAYER_GBRG,
+	BAYER_GRBG,
+	BAYER_BGGR
+};
+
+/// @ingroup CameraSensorDriver
+/// Each function converts a <code>width</code> x <code>height</code> source image
+/// and creates <code>dst</code> as 8 bit BGR image, if necessary.
+/// With <code>downscale</code> = 2, the image is reduced to half width and height
+/// within the same pass by averaging 2x2 pixel blocks. Admitted values are 1 and 2.
+/// The loops work on integers only, so that the compiler can vectorise them.
+/// @{
+
+/// Converts RGB8 (r,g,b) to BGR.
+__DLL_LIBCAMERASENSORS__ unsigned long ConvertRGB8ToBGR(const unsigned char* src, int srcStep,
+	int width, int height, int downscale, cv::Mat& dst);
+
+/// Converts YUV422 in IIDC byte order (u,y0,v,y1) to BGR.
+__DLL_LIBCAMERASENSORS__ unsigned long ConvertYUV422ToBGR(const unsigned char* src, int srcStep,
+	int width, int height, int downscale, cv::Mat& dst);
+
+/// Converts YUV411 in IIDC byte order (u,y0,y1,v,y2,y3) to BGR.
+__DLL_LIBCAMERASENSORS__ unsigned long ConvertYUV411ToBGR(const unsigned char* src, int srcStep,
+	int width, int height, int downscale, cv::Mat& dst);
+
+/// Converts MONO8 to a grey BGR image.
+__DLL_LIBCAMERASENSORS__ unsigned long ConvertMono8ToBGR(const unsigned char* src, int srcStep,
+	int width, int height, int downscale, cv::Mat& dst);
+
+/// Demosaics RAW8 Bayer images.
+/// Without downscaling, the OpenCV demosaicing is used. When downscaling, each 2x2 Bayer
+/// block becomes one BGR pixel, which needs no interpolation at all.
+__DLL_LIBCAMERASENSORS__ unsigned long ConvertBayer8ToBGR(const unsigned char* src, int srcStep,
+	int width, int height, t_BayerPattern pattern, int downscale, cv::Mat& dst);
+
+/// @}
+
+} // end namespace ipa_CameraSensors
+
+#endif // __IPA_IIDCCOLORCONVERSION_H__
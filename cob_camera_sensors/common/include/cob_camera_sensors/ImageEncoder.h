@@ -0,0 +1,99 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/// @file ImageEncoder.h
+/// Compression of camera images in a background thread.
+
+#ifndef __IPA_IMAGEENCODER_H__
+#define __IPA_IMAGEENCODER_H__
+
+#ifdef __LINUX__
+	#include "cob_vision_utils/CameraSensorDefines.h"
+#else
+	#include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/CameraSensorDefines.h"
+#endif
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+namespace ipa_CameraSensors {
+
+/// Encodes images to JPEG or PNG in its own thread, so the capture loop only hands over the image.
+/// Only the latest submitted image is kept: if the encoder is still busy, a newer image replaces
+/// the waiting one. Together with a maximal rate this bounds the CPU time spent on compression.
+class __DLL_LIBCAMERASENSORS__ ImageEncoder
+{
+public:
+
+	/// Receives the encoded image and the timestamp given to Submit().
+	/// Called from the encoder thread.
+	typedef boost::function<void (const std::vector<unsigned char>& data, double timestamp)> t_EncodedFunction;
+
+	ImageEncoder();
+	~ImageEncoder();
+
+	/// Starts the encoder thread. A running encoder is stopped before.
+	/// @param encodedFunction Function receiving the encoded images
+	/// @param format "jpeg" or "png"
+	/// @param quality JPEG quality from 0 to 100, or PNG compression level from 0 to 9
+	/// @param maxRate Maximal number of encoded images per second, 0 to encode every image the encoder keeps up with
+	/// @return Return code
+	unsigned long Start(t_EncodedFunction encodedFunction, const std::string& format, int quality, double maxRate);
+
+	/// Stops and joins the encoder thread and drops a waiting image.
+	void Stop();
+
+	bool isRunning() {return m_Encoder != 0;}
+
+	/// Queues an image for encoding, unless the maximal rate has been reached.
+	/// The image data is not copied. It must not be modified until it is released by the encoder.
+	/// @param image 8 bit image with 1 or 3 channels
+	/// @param timestamp Passed through to the encoded function
+	/// @param owner Keeps the image data alive until the encoder has finished, e.g. the message holding the data
+	/// @return <code>true</code> if the image has been queued, <code>false</code> if it has been skipped
+	bool Submit(const cv::Mat& image, double timestamp, const boost::shared_ptr<const void>& owner);
+
+private:
+
+	void EncoderThread();
+
+	t_EncodedFunction m_EncodedFunction;
+	std::string m_Extension;
+	std::vector<int> m_Parameters;
+	double m_MinInterval; ///< Minimal time between two submitted timestamps in s
+
+	boost::mutex m_Mutex;
+	boost::condition_variable m_ImageAvailable;
+	bool m_Pending;
+	cv::Mat m_Image;
+	double m_Timestamp;
+	boost::shared_ptr<const void> m_Owner;
+	double m_LastTimestamp; ///< Timestamp of the last queued image
+	bool m_Stop;
+
+	boost::scoped_ptr<boost::thread> m_Encoder;
+};
+
+} // end namespace ipa_CameraSensors
+#endif // __IPA_IMAGEENCODER_H__
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/// @file ImagePrefetcher.h
+/// Read-ahead of images for virtual cameras.
+
+#ifndef __IPA_IMAGEPREFETCHER_H__
+#define __IPA_IMAGEPREFETCHER_H__
+
+#ifdef __LINUX__
+	#include "cob_vision_utils/CameraSensorDefines.h"
+#else
+	#include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/CameraSensorDefines.h"
+#endif
+
+#include <opencv2/core/core.hpp>
+
+#include <deque>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+namespace ipa_CameraSensors {
+
+/// @ingroup VirtualCameraDriver
+/// Loads the images following the currently consumed one in a pool of worker threads.
+/// Images are expected to be consumed in ascending order, wrapping around after the last one.
+/// Requesting any other index restarts the read-ahead at that index.
+class __DLL_LIBCAMERASENSORS__ ImagePrefetcher
+{
+public:
+
+	/// Loads all images of the frame with the given index.
+	/// Called concurrently from the worker threads.
+	typedef boost::function<unsigned long (int index, std::vector<cv::Mat>& images)> t_LoadFunction;
+
+	ImagePrefetcher();
+	~ImagePrefetcher();
+
+	/// Starts the worker threads. A running read-ahead is stopped before.
+	/// @param loadFunction Function loading one frame
+	/// @param numberOfImages Number of frames, indices wrap around at this value
+	/// @param depth Number of frames loaded ahead of the consumer
+	/// @param numberOfThreads Number of worker threads
+	/// @return Return code
+	unsigned long Start(t_LoadFunction loadFunction, int numberOfImages, int depth, int numberOfThreads);
+
+	/// Stops and joins the worker threads and drops all loaded frames.
+	void Stop();
+
+	bool isRunning() {return !m_Workers.empty();}
+
+	/// Returns the frame with the given index and schedules the next frame.
+	/// Blocks until the frame is loaded.
+	/// @param index The frame index
+	/// @param images The images of the frame
+	/// @return Return code of the load function
+	unsigned long GetImages(int index, std::vector<cv::Mat>& images);
+
+private:
+
+	struct t_Slot
+	{
+		int index;
+		bool ready;
+		unsigned long result;
+		std::vector<cv::Mat> images;
+	};
+	typedef boost::shared_ptr<t_Slot> t_SlotPtr;
+
+	/// Drops all scheduled frames and starts loading at index.
+	/// Frames being loaded are finished by the workers and then discarded.
+	/// Requires m_Mutex to be locked.
+	void Restart(int index);
+
+	/// Schedules the next frame. Requires m_Mutex to be locked.
+	void Schedule();
+
+	void WorkerThread();
+
+	t_LoadFunction m_LoadFunction;
+	int m_NumberOfImages;
+	int m_Depth;
+
+	boost::mutex m_Mutex;
+	boost::condition_variable m_JobAvailable;
+	boost::condition_variable m_SlotReady;
+	std::deque<t_SlotPtr> m_Slots; ///< Scheduled frames in the order of consumption
+	std::deque<t_SlotPtr> m_Jobs; ///< Scheduled frames not yet taken by a worker
+	int m_NextIndex; ///< Index of the next frame to schedule
+	bool m_Stop;
+
+	std::vector<boost::shared_ptr<boost::thread> > m_Workers;
+};
+
+} // end namespace ipa_CameraSensors
+#endif // __IPA_IMAGEPREFETCHER_H__
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/// @file RangeCamRecorder.h
+/// Asynchronous recording of range camera frames into a replay file.
+
+#ifndef __IPA_RANGECAMRECORDER_H__
+#define __IPA_RANGECAMRECORDER_H__
+
+#ifdef __LINUX__
+	#include "cob_vision_utils/CameraSensorDefines.h"
+	#include "cob_camera_sensors/FrameInfo.h"
+	#include "cob_camera_sensors/RangeCamReplayFile.h"
+#else
+	#include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/CameraSensorDefines.h"
+	#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/FrameInfo.h"
+	#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/RangeCamReplayFile.h"
+#endif
+
+#include <opencv2/core/core.hpp>
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+namespace ipa_CameraSensors {
+
+/// @ingroup VirtualCameraDriver
+/// Records frames of a running camera into a replay file, that can be played back by the virtual range camera.
+/// Frames are copied into a fixed number of preallocated slots and written by a separate thread,
+/// so the capture loop never waits for the disk. If all slots are in use, the frame is dropped.
+/// Capture time and sequence number of each recorded frame are written line by line to '<filename>.stamps'.
+class __DLL_LIBCAMERASENSORS__ RangeCamRecorder
+{
+public:
+
+	RangeCamRecorder();
+	~RangeCamRecorder();
+
+	/// Creates the replay file and starts the writer thread. A running recording is stopped before.
+	/// @param filename Replay file-path and file-name
+	/// @param width Image width
+	/// @param height Image height
+	/// @param types Opencv type of each of the REPLAY_NUM_STREAMS streams, -1 for streams that are not recorded
+	/// @param numberOfSlots Number of frames buffered for the writer thread
+	/// @return Return code
+	unsigned long Start(const std::string& filename, int width, int height, const int* types, int numberOfSlots);
+
+	/// Writes all buffered frames, stops the writer thread and closes the replay file.
+	/// @return Return code
+	unsigned long Stop();
+
+	bool isRunning() {return m_Writer != 0;}
+
+	/// Queues one frame for writing. The images are copied, they may be reused as soon as the function returns.
+	/// @param frames One image per stream, images of streams that are not recorded are ignored
+	/// @param frameInfo Capture time and sequence number of the frame
+	/// @return Return code, RET_FAILED if the frame has been dropped
+	unsigned long Record(const cv::Mat* frames, const t_FrameInfo& frameInfo);
+
+	/// Number of frames dropped since Start(), because the writer thread fell behind.
+	unsigned long GetNumberOfDroppedFrames() {return m_DroppedFrames;}
+
+private:
+
+	struct t_Slot
+	{
+		cv::Mat frames[REPLAY_NUM_STREAMS];
+		t_FrameInfo frameInfo;
+	};
+
+	void WriterThread();
+
+	RangeCamReplayFileWriter m_File;
+	std::ofstream m_StampFile;
+	int m_Types[REPLAY_NUM_STREAMS];
+
+	boost::mutex m_Mutex;
+	boost::condition_variable m_FrameAvailable;
+	std::vector<t_Slot> m_Slots; ///< Preallocated frame buffers
+	std::deque<t_Slot*> m_Free; ///< Slots available to Record()
+	std::deque<t_Slot*> m_Queued; ///< Slots waiting for the writer, in recording order
+	bool m_Stop;
+	bool m_WriteFailed;
+	unsigned long m_DroppedFrames;
+
+	boost::scoped_ptr<boost::thread> m_Writer;
+};
+
+} // end namespace ipa_CameraSensors
+#endif // __IPA_RANGECAMRECORDER_H__
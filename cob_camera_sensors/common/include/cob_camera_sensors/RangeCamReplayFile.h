@@ -0,0 +1,152 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/// @file RangeCamReplayFile.h
+/// Memory-mapped container for recorded range camera frames.
+
+#ifndef __IPA_RANGECAMREPLAYFILE_H__
+#define __IPA_RANGECAMREPLAYFILE_H__
+
+#ifdef __LINUX__
+	#include "cob_vision_utils/CameraSensorDefines.h"
+#else
+	#include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/CameraSensorDefines.h"
+#endif
+
+#include <opencv2/core/core.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace ipa_CameraSensors {
+
+/// Image streams stored in a replay file.
+enum t_ReplayStream
+{
+	REPLAY_RANGE = 0,
+	REPLAY_INTENSITY,
+	REPLAY_AMPLITUDE,
+	REPLAY_COORDINATE,
+	REPLAY_NUM_STREAMS
+};
+
+/// File layout of a replay file.
+/// The file starts with the header, followed by the raw frame data and the index.
+/// The index holds one offset per frame and stream, measured from the file start.
+/// Frame data is stored row by row without padding and starts on a c_ReplayAlignment byte boundary.
+/// All values are stored in host byte order.
+struct t_ReplayFileHeader
+{
+	char magic[8]; ///< "IPARCREC"
+	boost::uint32_t version; ///< File format version
+	boost::int32_t width; ///< Image width, equal for all streams
+	boost::int32_t height; ///< Image height, equal for all streams
+	boost::int32_t numberOfFrames; ///< Number of frames
+	boost::int32_t types[REPLAY_NUM_STREAMS]; ///< Opencv type of each stream e.g. CV_32FC1, -1 if the stream is not recorded
+	boost::uint64_t indexOffset; ///< Offset of the index
+};
+
+static const char c_ReplayMagic[8] = {'I', 'P', 'A', 'R', 'C', 'R', 'E', 'C'};
+static const boost::uint32_t c_ReplayVersion = 1;
+static const size_t c_ReplayAlignment = 64;
+
+/// @ingroup VirtualCameraDriver
+/// Read access to a replay file.
+/// The file is mapped read-only into memory, no data is copied or parsed when frames are accessed.
+class __DLL_LIBCAMERASENSORS__ RangeCamReplayFile
+{
+public:
+
+	RangeCamReplayFile();
+	~RangeCamReplayFile();
+
+	/// Maps the given file and validates header and index.
+	/// @param filename Replay file-path and file-name
+	/// @return Return code
+	unsigned long Open(const std::string& filename);
+	unsigned long Close();
+
+	bool isOpen() {return m_Region != 0;}
+
+	int GetNumberOfFrames() {return m_Header.numberOfFrames;}
+	int GetImageWidth() {return m_Header.width;}
+	int GetImageHeight() {return m_Header.height;}
+
+	/// Returns the opencv type of the given stream.
+	/// @return The type or -1 if the stream is not recorded
+	int GetImageType(t_ReplayStream stream) {return m_Header.types[stream];}
+
+	/// Returns a view on one frame of the given stream.
+	/// The view points into the mapped file and stays valid until the file is closed.
+	/// It must not be written to, the mapping is read-only.
+	/// @param stream The image stream
+	/// @param index The frame index
+	/// @param frame Header of the returned view
+	/// @return Return code
+	unsigned long GetFrame(t_ReplayStream stream, int index, cv::Mat& frame);
+
+private:
+
+	t_ReplayFileHeader m_Header;
+	const boost::uint64_t* m_Index; ///< Points into the mapped index
+	boost::scoped_ptr<boost::interprocess::file_mapping> m_Mapping;
+	boost::scoped_ptr<boost::interprocess::mapped_region> m_Region;
+};
+
+/// Stores recorded frames in a replay file.
+/// Frames are appended one after the other, the index is written by Close().
+class __DLL_LIBCAMERASENSORS__ RangeCamReplayFileWriter
+{
+public:
+
+	RangeCamReplayFileWriter();
+	~RangeCamReplayFileWriter();
+
+	/// Creates the file and writes a preliminary header.
+	/// @param filename Replay file-path and file-name
+	/// @param width Image width
+	/// @param height Image height
+	/// @param types Opencv type of each of the REPLAY_NUM_STREAMS streams, -1 for streams that are not recorded
+	/// @return Return code
+	unsigned long Open(const std::string& filename, int width, int height, const int* types);
+
+	/// Appends one frame.
+	/// @param frames One image per stream, images of streams that are not recorded are ignored
+	/// @return Return code
+	unsigned long AppendFrame(const cv::Mat* frames);
+
+	/// Writes index and final header and closes the file.
+	/// @return Return code
+	unsigned long Close();
+
+private:
+
+	unsigned long WritePadding();
+
+	std::ofstream m_File;
+	t_ReplayFileHeader m_Header;
+	std::vector<boost::uint64_t> m_Index;
+};
+
+} // end namespace ipa_CameraSensors
+#endif // __IPA_RANGECAMREPLAYFILE_H__
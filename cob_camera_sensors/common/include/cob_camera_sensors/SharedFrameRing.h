@@ -0,0 +1,141 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/// @file SharedFrameRing.h
+/// Ring of frames in shared memory, to pass images to other processes on the same host without serialisation.
+
+#ifndef __IPA_SHAREDFRAMERING_H__
+#define __IPA_SHAREDFRAMERING_H__
+
+#ifdef __LINUX__
+	#include "cob_vision_utils/CameraSensorDefines.h"
+	#include "cob_camera_sensors/FrameInfo.h"
+#else
+	#include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/CameraSensorDefines.h"
+	#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/FrameInfo.h"
+#endif
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace ipa_CameraSensors {
+
+static const int c_SharedFrameMaxStreams = 4;
+
+/// Layout of the shared memory.
+/// The header is followed by numberOfSlots slots. Each slot starts with a t_SharedFrameSlot
+/// and holds one image per stream, stored row by row without padding at the given offsets.
+struct t_SharedFrameRingHeader
+{
+	char magic[8]; ///< "IPASHMFR"
+	boost::uint32_t version; ///< Layout version
+	boost::int32_t width; ///< Image width, equal for all streams
+	boost::int32_t height; ///< Image height, equal for all streams
+	boost::int32_t numberOfSlots; ///< Number of frames in the ring
+	boost::int32_t numberOfStreams; ///< Number of images per frame
+	boost::int32_t types[c_SharedFrameMaxStreams]; ///< Opencv type of each stream e.g. CV_32FC1
+	boost::uint64_t streamOffsets[c_SharedFrameMaxStreams]; ///< Offset of each image from the slot start
+	boost::uint64_t slotSize; ///< Distance between two slots
+};
+
+/// Descriptor at the start of each slot.
+struct t_SharedFrameSlot
+{
+	/// Ring sequence number of the stored frame, 0 while the slot is written
+	volatile boost::uint64_t sequenceNumber;
+	double timestamp; ///< Capture time of the frame
+	boost::uint64_t cameraSequenceNumber; ///< Sequence number assigned by the camera driver
+};
+
+/// Frames written by one process and read by any number of others.
+/// The writer assigns increasing sequence numbers and fills the slots in turn, so a frame stays
+/// available until numberOfSlots-1 newer frames have been written. Readers get a view on the shared
+/// memory and check with IsValid() after using it, that the writer has not reused the slot meanwhile.
+class __DLL_LIBCAMERASENSORS__ SharedFrameRing
+{
+public:
+
+	SharedFrameRing();
+	~SharedFrameRing();
+
+	/// Creates the shared memory for writing. An existing object with the same name is replaced.
+	/// @param name Name of the shared memory object
+	/// @param width Image width
+	/// @param height Image height
+	/// @param numberOfStreams Number of images per frame, at most c_SharedFrameMaxStreams
+	/// @param types Opencv type of each stream
+	/// @param numberOfSlots Number of frames in the ring, at least 2
+	/// @return Return code
+	unsigned long Create(const std::string& name, int width, int height, int numberOfStreams, const int* types, int numberOfSlots);
+
+	/// Maps existing shared memory for reading.
+	/// @param name Name of the shared memory object
+	/// @return Return code
+	unsigned long Open(const std::string& name);
+
+	/// Unmaps the shared memory. The creator also removes the shared memory object.
+	unsigned long Close();
+
+	bool isOpen() {return m_Region != 0;}
+
+	const std::string& GetName() {return m_Name;}
+	int GetImageWidth() {return m_Header->width;}
+	int GetImageHeight() {return m_Header->height;}
+	int GetNumberOfSlots() {return m_Header->numberOfSlots;}
+	int GetNumberOfStreams() {return m_Header->numberOfStreams;}
+
+	/// Copies one frame into the next slot. Only available to the creator.
+	/// @param frames One image per stream, matching size and type of the ring
+	/// @param frameInfo Capture time and sequence number of the frame
+	/// @param slot Returns the slot holding the frame
+	/// @param sequenceNumber Returns the ring sequence number of the frame
+	/// @return Return code
+	unsigned long Write(const cv::Mat* frames, const t_FrameInfo& frameInfo, int& slot, boost::uint64_t& sequenceNumber);
+
+	/// Returns views on the images of a frame.
+	/// The views point into the shared memory and must not be written to.
+	/// @param slot The slot holding the frame
+	/// @param sequenceNumber The ring sequence number of the frame
+	/// @param frames Array of GetNumberOfStreams() image headers receiving the views
+	/// @param frameInfo Returns capture time and camera sequence number of the frame, may be 0
+	/// @return Return code, RET_FAILED if the frame has already been overwritten
+	unsigned long GetFrame(int slot, boost::uint64_t sequenceNumber, cv::Mat* frames, t_FrameInfo* frameInfo);
+
+	/// Checks if the slot still holds the given frame.
+	/// Call after copying or processing the views returned by GetFrame().
+	bool IsValid(int slot, boost::uint64_t sequenceNumber);
+
+private:
+
+	t_SharedFrameSlot* GetSlot(int slot);
+
+	std::string m_Name;
+	bool m_IsCreator;
+	boost::uint64_t m_NextSequenceNumber;
+	t_SharedFrameRingHeader* m_Header; ///< Points into the mapped memory
+	boost::scoped_ptr<boost::interprocess::shared_memory_object> m_SharedMemory;
+	boost::scoped_ptr<boost::interprocess::mapped_region> m_Region;
+};
+
+} // end namespace ipa_CameraSensors
+#endif // __IPA_SHAREDFRAMERING_H__
@@ -40,8 +40,12 @@ typedef unsigned long DWORD;
 
 #ifdef __LINUX__
 	#include <cob_camera_sensors/AbstractRangeImagingSensor.h>
+	#include <cob_camera_sensors/ToFFilter.h>
+	#include <cob_utilities/TripleBuffer.h>
 #else
 	#include <cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/AbstractRangeImagingSensor.h>
+	#include <cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/ToFFilter.h>
+	#include <cob_driver/cob_utilities/common/include/cob_utilities/TripleBuffer.h>
 #endif
 
 #include <stdio.h>
@@ -50,6 +54,10 @@ typedef unsigned long DWORD;
 #include <assert.h>
 #include <libMesaSR.h>
 
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
 namespace ipa_CameraSensors {
 
 // former SR31Consts.h entries
@@ -69,6 +77,8 @@ int LibMesaCallback(SRCAM srCam, unsigned int msg, unsigned int param, void* dat
 /// Interface class to SwissRanger camera SR-3000.
 /// Platform independent interface to SwissRanger camera SR-3000. Implementation depends on
 /// libusbSR library.
+/// The first acquisition starts a capture thread, that acquires continuously until the camera is closed.
+/// Requests for the latest frame return the newest captured frame without waiting.
 class __DLL_LIBCAMERASENSORS__ Swissranger : public AbstractRangeImagingSensor
 {
 public:
@@ -95,9 +105,14 @@ public:
 	unsigned long AcquireImages(cv::Mat* rangeImage = 0, cv::Mat* grayImage = 0,
 		cv::Mat* cartesianImage = 0, bool getLatestFrame = true, bool undistort = true,
 		ipa_CameraSensors::t_ToFGrayImageType grayImageType = ipa_CameraSensors::INTENSITY_32F1);
+	unsigned long AcquireFrame(const t_RangeFrameRequest& request, t_RangeFrame& frame);
 
 	unsigned long SaveParameters(const char* filename);
 
+	/// Assigns the intrinsics and recomputes the per-pixel viewing rays on the next acquisition.
+	unsigned long SetIntrinsics(cv::Mat& intrinsicMatrix,
+		cv::Mat& undistortMapX, cv::Mat& undistortMapY);
+
 	bool isInitialized() {return m_initialized;}
 	bool isOpen() {return m_open;}
 
@@ -111,6 +126,13 @@ private:
 	unsigned long GetCalibratedXYMatlab(int u, int v, float z, float& x, float& y);
 	unsigned long GetCalibratedXYSwissranger(int u, int v, int width, float& x, float& y);
 
+	/// Computes m_RayX and m_RayY from the intrinsics for the current resolution.
+	/// @return Return code
+	unsigned long UpdateRayLUT();
+
+	/// Copies m_CoeffsA0 ... m_CoeffsA6 into m_ZCoeffs.
+	void UpdateZCoeffsLUT();
+
 	/// Load general Swissranger parameters and previously determined calibration parameters.
 	/// @param filename Swissranger parameter path and file name.
 	/// @param cameraIndex The index of the camera within the configuration file
@@ -123,6 +145,31 @@ private:
 	/// @return Return code
 	unsigned long SetParameters();
 
+	/// One frame copied out of the camera by the capture thread.
+	struct t_SRFrame
+	{
+		std::vector<WORD> pixels; ///< Range and amplitude image as returned by SR_GetImage
+		std::vector<float> x; ///< x coordinates from SR_CoordTrfFlt, empty if not needed by the calibration method
+		std::vector<float> y; ///< y coordinates from SR_CoordTrfFlt, empty if not needed by the calibration method
+		std::vector<float> z; ///< z coordinates from SR_CoordTrfFlt, empty if not needed by the calibration method
+		t_FrameInfo info; ///< Capture time and sequence number
+	};
+
+	/// Starts the capture thread.
+	/// @return Return code
+	unsigned long StartCapture();
+
+	/// Stops and joins the capture thread.
+	void StopCapture();
+
+	/// Acquires frames and hands them to <code>AcquireImages</code> through m_CaptureBuffer.
+	void CaptureThread();
+
+	/// Makes the newest captured frame available in the read slot of m_CaptureBuffer.
+	/// @param newFrame Wait for a frame that has not been returned before
+	/// @return Return code
+	unsigned long WaitForCapturedFrame(bool newFrame);
+
 	SRCAM m_SRCam; 			 ///< Handle to USB SR3000 camera
 	int m_NumOfImages;		 ///< Number of images the siwssranger returns (i.e. an intensity and a range image)
 	ImgEntry* m_DataBuffer;  ///< Image array
@@ -132,6 +179,21 @@ private:
 	float m_Y[SWISSRANGER_COLUMNS * SWISSRANGER_ROWS];
 	float m_Z[SWISSRANGER_COLUMNS * SWISSRANGER_ROWS];
 
+	int m_ImageWidth; ///< Image width, read from the camera on <code>Open</code>
+	int m_ImageHeight; ///< Image height, read from the camera on <code>Open</code>
+
+	/// x and y component of the viewing ray of each pixel at z = 1, i.e. (u-cx)/fx and (v-cy)/fy.
+	/// Replaces the evaluation of the intrinsics per pixel and frame.
+	std::vector<float> m_RayX;
+	std::vector<float> m_RayY;
+	bool m_RayLUTValid; ///< False, when resolution or intrinsics changed since m_RayX and m_RayY were computed
+
+	boost::mutex m_SRMutex; ///< Serializes libMesaSR calls of the capture thread and the property functions
+	boost::scoped_ptr<boost::thread> m_CaptureThread;
+	boost::atomic<bool> m_StopCapture;
+	boost::scoped_ptr<TripleBuffer<t_SRFrame> > m_CaptureBuffer; ///< Written by the capture thread, read by <code>AcquireImages</code>
+	bool m_CapturedFrameAvailable; ///< True, when the read slot of m_CaptureBuffer holds a frame
+
 	bool m_CoeffsInitialized; ///< True, when m_CoeffsAx have been initialized
 	bool m_GrayImageAcquireCalled; ///< Is false, when acquiring gray image has not been called, yet
 
@@ -146,6 +208,12 @@ private:
 	cv::Mat m_CoeffsA4; ///< a4 z-calibration parameters. One matrix entry corresponds to one pixel
 	cv::Mat m_CoeffsA5; ///< a5 z-calibration parameters. One matrix entry corresponds to one pixel
 	cv::Mat m_CoeffsA6; ///< a6 z-calibration parameters. One matrix entry corresponds to one pixel
+
+	/// The seven z-calibration parameters of each pixel stored consecutively, pixel after pixel.
+	std::vector<double> m_ZCoeffs;
+
+	ToFFilter m_Filter; ///< Optional filter stage of the cv::Mat <code>AcquireImages</code>, configured by tag 'Filter'
+	cv::Mat m_FilterAmplitude; ///< Amplitude image for the filter, when the caller requests no gray image
 };
 
 /// Creates, intializes and returns a smart pointer object for the camera.
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/// @file ToFFilter.h
+/// Removal of unreliable time-of-flight measurements inside the camera driver.
+
+#ifndef __IPA_TOFFILTER_H__
+#define __IPA_TOFFILTER_H__
+
+#ifdef __LINUX__
+	#include "cob_vision_utils/CameraSensorDefines.h"
+#else
+	#include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/CameraSensorDefines.h"
+#endif
+
+#include <opencv2/core/core.hpp>
+
+#include <deque>
+#include <vector>
+
+namespace ipa_CameraSensors {
+
+/// Filters the images returned by <code>AcquireImages</code> of a range imaging sensor.
+/// The stages are applied in the following order, each one is disabled by default:
+///<ol>
+///	<li> Temporal median: each range and xyz value is replaced by its median over the last K frames</li>
+///	<li> Amplitude threshold: pixels with an amplitude below the threshold are invalid</li>
+///	<li> Jump edges: pixels differing from both opposite neighbours (horizontal or vertical)
+///		 by more than a fraction of their depth are invalid. These are the flying pixels
+///		 between foreground and background, object borders are kept.</li>
+///</ol>
+/// Invalid pixels are set to 0 in the range and xyz image.
+/// All stages work on whole images with the vectorized OpenCV functions.
+class __DLL_LIBCAMERASENSORS__ ToFFilter
+{
+public:
+
+	ToFFilter();
+
+	/// @param threshold Minimal amplitude of a valid pixel, 0 to disable
+	void SetAmplitudeThreshold(float threshold) {m_AmplitudeThreshold = threshold;}
+
+	/// @param threshold Maximal depth difference to a neighbour as fraction of the depth, 0 to disable
+	void SetJumpEdgeThreshold(float threshold) {m_JumpEdgeThreshold = threshold;}
+
+	/// @param frames Number of frames of the temporal median, 1 to disable
+	void SetTemporalMedian(int frames);
+
+	bool isEnabled() {return m_AmplitudeThreshold > 0 || m_JumpEdgeThreshold > 0 || m_MedianFrames > 1;}
+	bool NeedsAmplitude() {return m_AmplitudeThreshold > 0;}
+
+	/// Drops the frames of the temporal median, i.e. after a pause of the acquisition.
+	void Reset();
+
+	/// Filters the images of one frame in place.
+	/// @param rangeImage CV_32FC1 range image or null
+	/// @param amplitudeImage CV_32FC1 amplitude image, needed for the amplitude threshold
+	/// @param xyzImage CV_32FC3 cartesian image or null
+	/// @return Return code
+	unsigned long Apply(cv::Mat* rangeImage, const cv::Mat* amplitudeImage, cv::Mat* xyzImage);
+
+private:
+
+	/// Replaces image by the median of the last m_MedianFrames images given to this function.
+	void TemporalMedian(std::deque<cv::Mat>& history, cv::Mat& image);
+
+	/// Marks pixels differing from both opposite neighbours in mask.
+	void MarkJumpEdges(const cv::Mat& depth, cv::Mat& mask);
+
+	float m_AmplitudeThreshold;
+	float m_JumpEdgeThreshold;
+	int m_MedianFrames;
+
+	std::deque<cv::Mat> m_RangeHistory;	///< Last frames of the range image, newest last
+	std::deque<cv::Mat> m_XYZHistory;	///< Last frames of the xyz image, newest last
+	std::vector<cv::Mat> m_Sorted;	///< Scratch images of the median sorting network
+	cv::Mat m_Depth;	///< Scratch images of the jump edge detection
+	cv::Mat m_Threshold;
+	cv::Mat m_Difference1;
+	cv::Mat m_Difference2;
+	cv::Mat m_InvalidMask;	///< CV_8UC1, non-zero for invalid pixels
+};
+
+} // end namespace ipa_CameraSensors
+#endif // __IPA_TOFFILTER_H__
@@ -25,8 +25,10 @@
 
 #ifdef __LINUX__
 	#include "cob_camera_sensors/AbstractColorCamera.h"
+	#include "cob_camera_sensors/ImagePrefetcher.h"
 #else
 	#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/AbstractColorCamera.h"
+	#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/ImagePrefetcher.h"
 #endif
 
 #include <cstdlib>
@@ -37,6 +39,7 @@ namespace ipa_CameraSensors {
 /// The class offers an interface to a virtual color camera, that is equivalent
 /// to the interface of a real color camera.
 /// However, pictures are read from a directory instead of the camera.
+/// The optional configuration tag 'Prefetch' enables loading the next images in a pool of worker threads.
 class __DLL_LIBCAMERASENSORS__ VirtualColorCam : public AbstractColorCamera
 {
 	private:
@@ -50,6 +53,16 @@ class __DLL_LIBCAMERASENSORS__ VirtualColorCam : public AbstractColorCamera
 
 		unsigned int m_ImageCounter; ///< Holds the index of the image that is extracted during the next call of <code>AcquireImages</code>
 
+		ImagePrefetcher m_Prefetcher;
+		int m_PrefetchDepth; ///< Number of images loaded ahead, 0 disables prefetching
+		int m_PrefetchThreads; ///< Number of worker threads of m_Prefetcher
+
+		/// Loads the color image with the given index.
+		/// @param index The image index
+		/// @param images Vector holding the loaded image as only element
+		/// @return Return code
+		unsigned long LoadImage(int index, std::vector<cv::Mat>& images);
+
 		/// Parses the XML configuration file, that holds the camera settings
 		/// @param filename The file name and path of the configuration file
 		/// @param cameraIndex The index of the camera within the configuration file
@@ -25,8 +25,12 @@
 
 #ifdef __LINUX__
 	#include <cob_camera_sensors/AbstractRangeImagingSensor.h>
+	#include <cob_camera_sensors/RangeCamReplayFile.h>
+	#include <cob_camera_sensors/ImagePrefetcher.h>
 #else
 	#include <cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/AbstractRangeImagingSensor.h>
+	#include <cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/RangeCamReplayFile.h>
+	#include <cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/ImagePrefetcher.h>
 #endif
 
 #include <stdio.h>
@@ -45,6 +49,9 @@ static const int SWISSRANGER_ROWS = 144;
 /// Interface class to virtual range camera like Swissranger 3000/4000.
 /// The class offers an interface to a virtual range camera, that is equal to the interface of a real range camera.
 /// However, pictures are read from a directory instead of the camera.
+/// If the directory contains a replay file 'RangeCamReplay_<cameraIndex>.replay', all frames are
+/// taken from this memory-mapped file instead of the single image files.
+/// Otherwise, the optional configuration tag 'Prefetch' enables loading the next frames in a pool of worker threads.
 class __DLL_LIBCAMERASENSORS__ VirtualRangeCam : public AbstractRangeImagingSensor
 {
 public:
@@ -71,6 +78,7 @@ public:
 	unsigned long AcquireImages(cv::Mat* rangeImage = 0, cv::Mat* intensityImage = 0,
 		cv::Mat* cartesianImage = 0, bool getLatestFrame = true, bool undistort = true,
 		ipa_CameraSensors::t_ToFGrayImageType grayImageType = ipa_CameraSensors::INTENSITY);
+	unsigned long AcquireFrame(const t_RangeFrameRequest& request, t_RangeFrame& frame);
 
 	unsigned long GetCalibratedUV(double x, double y, double z, double& u, double& v);
 
@@ -91,6 +99,13 @@ public:
 	/// @return Return code
 	unsigned long SetPathToImages(std::string path);
 
+	/// Function specific to virtual camera.
+	/// Stores all images of the opened directory in one replay file.
+	/// Images are stored as read from the directory, i.e. without undistortion or calibration.
+	/// @param filename Replay file-path and file-name
+	/// @return Return code
+	unsigned long ExportReplayFile(std::string filename);
+
 private:
 	//*******************************************************************************
 	// Camera specific members
@@ -106,6 +121,30 @@ private:
 	/// @param ext Is empty if no extension was found before, otherwise it contains the found extension.
 	inline void FindSourceImageFormat(std::map<std::string, int>::iterator& itCounter, std::string& ext);
 
+	/// Returns the image file names of the given stream.
+	std::vector<std::string>& GetImageFileNames(t_ReplayStream stream);
+
+	/// Returns the number of images of the given stream, either from the replay file or the directory.
+	size_t GetNumberOfImages(t_ReplayStream stream);
+
+	/// Loads one image of the given stream.
+	/// Images from the replay file are returned as view into the mapped file without copying.
+	/// @param stream The image stream
+	/// @param index The image index
+	/// @param image The loaded image
+	/// @return Return code
+	unsigned long LoadImage(t_ReplayStream stream, int index, cv::Mat& image);
+
+	/// Loads the given streams of one frame.
+	/// @param streams Bit mask of the streams to load, bit i corresponds to t_ReplayStream i
+	/// @param index The frame index
+	/// @param images One image per stream, images of streams not in the mask stay empty
+	/// @return Return code
+	unsigned long LoadFrame(unsigned int streams, int index, std::vector<cv::Mat>& images);
+
+	/// Returns the given streams of frame m_ImageCounter, from the prefetcher if enabled.
+	unsigned long AcquireFrame(unsigned int streams, std::vector<cv::Mat>& images);
+
 	unsigned long GetCalibratedZMatlab(int u, int v, float zRaw, float& zCalibrated);
 	unsigned long GetCalibratedXYMatlab(int u, int v, float z, float& x, float& y);
 
@@ -138,6 +177,14 @@ private:
 	std::vector<std::string> m_RangeImageFileNames ;
 	std::vector<std::string> m_CoordinateImageFileNames ;
 
+	RangeCamReplayFile m_ReplayFile; ///< Replay file, if present in the directory
+	bool m_UseReplayFile; ///< Images are read from m_ReplayFile instead of the image files
+
+	ImagePrefetcher m_Prefetcher;
+	int m_PrefetchDepth; ///< Number of frames loaded ahead, 0 disables prefetching
+	int m_PrefetchThreads; ///< Number of worker threads of m_Prefetcher
+	unsigned int m_PrefetchStreams; ///< Bit mask of the streams loaded by m_Prefetcher
+
 	int m_IntensityImageType; ///< Opencv type e.g. CV_8UC3
 	int m_AmplitudeImageType; ///< Opencv type e.g. CV_8UC3
 	int m_RangeImageImageType; ///< Opencv type e.g. CV_32FC1
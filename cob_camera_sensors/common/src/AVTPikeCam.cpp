@@ -57,11 +57,14 @@
 
 #ifdef __LINUX__
 #include "cob_camera_sensors/AVTPikeCam.h"
+#include "cob_camera_sensors/IIDCColorConversion.h"
 #include "tinyxml.h"
 
 #include <iostream>
+#include <algorithm>
 #else
 #include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/AVTPikeCam.h"
+#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/IIDCColorConversion.h"
 #include "cob_object_perception_intern/windows/src/extern/TinyXml/tinyxml.h"
 #endif
 
@@ -78,17 +81,47 @@ __DLL_LIBCAMERASENSORS__ AbstractColorCameraPtr ipa_CameraSensors::CreateColorCa
 	return AbstractColorCameraPtr(new AVTPikeCam());
 }
 
+#ifdef __LINUX__
+AVTPikeCamFrame::AVTPikeCamFrame(dc1394camera_t* cam, dc1394video_frame_t* frame, boost::shared_ptr<bool> captureActive)
+: m_cam(cam),
+  m_Frame(frame),
+  m_CaptureActive(captureActive)
+{
+}
+#endif
+
+AVTPikeCamFrame::~AVTPikeCamFrame()
+{
+#ifdef __LINUX__
+	// Buffers of a stopped capture have already been freed by the driver
+	if (m_Frame && m_CaptureActive && *m_CaptureActive)
+	{
+		dc1394error_t err = dc1394_capture_enqueue(m_cam, m_Frame);
+		if (err!=DC1394_SUCCESS)
+		{
+			std::cerr << "ERROR - AVTPikeCamFrame::~AVTPikeCamFrame:" << std::endl;
+			std::cerr << "\t ... 'dc1394_capture_enqueue' failed." << std::endl;
+			std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+		}
+	}
+#endif
+}
+
 AVTPikeCam::AVTPikeCam()
 {
 	m_initialized = false;
 	m_open = false;
 	m_BufferSize = 2;
+	m_Downscale = 1;
 
 #ifdef __LINUX__
 	m_cam = 0;
 	m_IEEE1394Cameras = 0;
 	m_IEEE1394Info = 0;
 	m_Frame = 0;
+	m_Format7ROI = cv::Rect();
+	m_PacketSize = 0;
+	m_Binning = 0;
 #endif
 #ifndef __LINUX__
 	m_Frame.pData = 0;
@@ -225,8 +258,6 @@ unsigned long AVTPikeCam::Open()
 
 
 #ifdef __LINUX__
-	dc1394error_t err;
-
 	// Connect with IEEE1394 node
 	unsigned int i=0;
 	for(; i<m_IEEE1394Cameras->num; i++)
@@ -260,47 +291,10 @@ unsigned long AVTPikeCam::Open()
 		return RET_FAILED;
 	}
 
-	err = dc1394_capture_setup(m_cam, m_BufferSize, DC1394_CAPTURE_FLAGS_DEFAULT);
-	// Relase allocated bandwidth and retry
-	if (err!=DC1394_SUCCESS)
-	{
-		std::cout << "INFO - AVTPikeCam::Open:" << std::endl;
-		std::cout << "\t ... Releasing bandwdith and retrying to setup DMA capture" << std::endl;
-		uint32_t bandwidth = -1;
-		err = dc1394_video_get_bandwidth_usage(m_cam, &bandwidth);
-		if (err!=DC1394_SUCCESS)
-		{
-			std::cerr << "ERROR - AVTPikeCam::Open:" << std::endl;
-			std::cerr << "\t ... Failed to get bandwith usage of camera device" << std::endl;
-			std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
-			return RET_FAILED;
-		}
-		dc1394_iso_release_bandwidth(m_cam, bandwidth);
-		if (err!=DC1394_SUCCESS)
-		{
-			std::cerr << "ERROR - AVTPikeCam::Open:" << std::endl;
-			std::cerr << "\t ... Failed to relase requested bandwidth '" << bandwidth << "'" << std::endl;
-			std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
-			return RET_FAILED;
-		}
-		err = dc1394_capture_setup(m_cam, m_BufferSize, DC1394_CAPTURE_FLAGS_DEFAULT);
-		if (err!=DC1394_SUCCESS)
-		{
-			std::cerr << "ERROR - AVTPikeCam::Open:" << std::endl;
-			std::cerr << "\t ... Failed to setup cameras device" << std::endl;
-			std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
-			return RET_FAILED;
-		}
-	}
-
-
-	// Start transmission
-	err=dc1394_video_set_transmission(m_cam, DC1394_ON);
-	if (err!=DC1394_SUCCESS)
+	if (StartCapture() & ipa_CameraSensors::RET_FAILED)
 	{
 		std::cerr << "ERROR - AVTPikeCam::Open:" << std::endl;
-		std::cerr << "\t ... 'dc1394_video_set_transmission' failed." << std::endl;
-		std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+		std::cerr << "\t... Error while starting DMA capture" << std::endl;
 		return RET_FAILED;
 	}
 
@@ -377,6 +371,7 @@ unsigned long AVTPikeCam::Open()
 	std::cout << "**************************************************" << std::endl;
 	std::cout << "AVTPikeCam::Open: AVT Pike 145C camera device OPEN" << std::endl;
 	std::cout << "**************************************************" << std::endl << std::endl;
+	m_FrameInfo = t_FrameInfo();
 	m_open = true;
 	return RET_OK;
 }
@@ -411,6 +406,13 @@ unsigned long AVTPikeCam::Close()
 			std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
 			return RET_FAILED;
 		}
+		// Frames still held by the user must not be enqueued anymore
+		if (m_CaptureActive)
+		{
+			*m_CaptureActive = false;
+			m_CaptureActive.reset();
+		}
+		m_Frame = 0;
 	    dc1394_capture_stop(m_cam);
 		dc1394_camera_free(m_cam);
 		m_cam = 0;
@@ -451,6 +453,206 @@ unsigned long AVTPikeCam::Close()
 
 
 
+#ifdef __LINUX__
+unsigned long AVTPikeCam::StartCapture()
+{
+	dc1394error_t err;
+
+	err = dc1394_capture_setup(m_cam, m_BufferSize, DC1394_CAPTURE_FLAGS_DEFAULT);
+	// Relase allocated bandwidth and retry
+	if (err!=DC1394_SUCCESS)
+	{
+		std::cout << "INFO - AVTPikeCam::StartCapture:" << std::endl;
+		std::cout << "\t ... Releasing bandwdith and retrying to setup DMA capture" << std::endl;
+		uint32_t bandwidth = -1;
+		err = dc1394_video_get_bandwidth_usage(m_cam, &bandwidth);
+		if (err!=DC1394_SUCCESS)
+		{
+			std::cerr << "ERROR - AVTPikeCam::StartCapture:" << std::endl;
+			std::cerr << "\t ... Failed to get bandwith usage of camera device" << std::endl;
+			std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+			return RET_FAILED;
+		}
+		dc1394_iso_release_bandwidth(m_cam, bandwidth);
+		if (err!=DC1394_SUCCESS)
+		{
+			std::cerr << "ERROR - AVTPikeCam::StartCapture:" << std::endl;
+			std::cerr << "\t ... Failed to relase requested bandwidth '" << bandwidth << "'" << std::endl;
+			std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+			return RET_FAILED;
+		}
+		err = dc1394_capture_setup(m_cam, m_BufferSize, DC1394_CAPTURE_FLAGS_DEFAULT);
+		if (err!=DC1394_SUCCESS)
+		{
+			std::cerr << "ERROR - AVTPikeCam::StartCapture:" << std::endl;
+			std::cerr << "\t ... Failed to setup cameras device" << std::endl;
+			std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+			return RET_FAILED;
+		}
+	}
+	m_CaptureActive.reset(new bool(true));
+
+
+	// Start transmission
+	err=dc1394_video_set_transmission(m_cam, DC1394_ON);
+	if (err!=DC1394_SUCCESS)
+	{
+		std::cerr << "ERROR - AVTPikeCam::StartCapture:" << std::endl;
+		std::cerr << "\t ... 'dc1394_video_set_transmission' failed." << std::endl;
+		std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+		return RET_FAILED;
+	}
+
+	return RET_OK;
+}
+
+unsigned long AVTPikeCam::StopCapture(bool* wasCapturing)
+{
+	*wasCapturing = false;
+	if (!m_CaptureActive)
+	{
+		return RET_OK;
+	}
+
+	dc1394error_t err;
+	err=dc1394_video_set_transmission(m_cam, DC1394_OFF);
+	if (err!=DC1394_SUCCESS)
+	{
+		std::cerr << "ERROR - AVTPikeCam::StopCapture:" << std::endl;
+		std::cerr << "\t ... 'dc1394_video_set_transmission' failed." << std::endl;
+		std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+		return RET_FAILED;
+	}
+	// Frames still held by the user must not be enqueued anymore
+	*m_CaptureActive = false;
+	m_CaptureActive.reset();
+	m_Frame = 0;
+	dc1394_capture_stop(m_cam);
+	*wasCapturing = true;
+	return RET_OK;
+}
+
+unsigned long AVTPikeCam::ApplyFormat7()
+{
+	// Applied by SetParameters, when the camera is opened
+	if (m_cam == 0)
+	{
+		return RET_OK;
+	}
+
+	dc1394error_t err;
+	dc1394video_mode_t videoMode;
+	err=dc1394_video_get_mode(m_cam, &videoMode);
+	if (err!=DC1394_SUCCESS) 
+	{    
+		std::cerr << "ERROR - AVTPikeCam::ApplyFormat7:" << std::endl;
+		std::cerr << "\t ... Failed to get video mode." << std::endl;
+		std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+		return RET_FAILED;                                         
+	} 
+	if (!dc1394_is_video_mode_scalable(videoMode))
+	{
+		if (m_Format7ROI.width == 0 && m_Format7ROI.height == 0 && m_Format7ROI.x == 0 &&
+			m_Format7ROI.y == 0 && m_PacketSize == 0 && m_Binning == 0)
+		{
+			return RET_OK;
+		}
+		std::cerr << "ERROR - AVTPikeCam::ApplyFormat7:" << std::endl;
+		std::cerr << "\t ... Region of interest, packet size and binning require video format 'FORMAT_7'." << std::endl;
+		return RET_FAILED;
+	}
+
+	// Mode 0 reads out the whole sensor, mode 3 bins 2x2 pixels
+	dc1394video_mode_t binnedVideoMode = videoMode;
+	if (m_Binning == 1)
+	{
+		binnedVideoMode = DC1394_VIDEO_MODE_FORMAT7_0;
+	}
+	else if (m_Binning == 2)
+	{
+		binnedVideoMode = DC1394_VIDEO_MODE_FORMAT7_3;
+	}
+
+	uint32_t maxWidth = 0;
+	uint32_t maxHeight = 0;
+	uint32_t unitWidth = 0;
+	uint32_t unitHeight = 0;
+	uint32_t unitLeft = 0;
+	uint32_t unitTop = 0;
+	if (dc1394_format7_get_max_image_size(m_cam, binnedVideoMode, &maxWidth, &maxHeight) != DC1394_SUCCESS ||
+		dc1394_format7_get_unit_size(m_cam, binnedVideoMode, &unitWidth, &unitHeight) != DC1394_SUCCESS ||
+		dc1394_format7_get_unit_position(m_cam, binnedVideoMode, &unitLeft, &unitTop) != DC1394_SUCCESS)
+	{
+		std::cerr << "ERROR - AVTPikeCam::ApplyFormat7:" << std::endl;
+		std::cerr << "\t ... Failed to get image size limits of Format7 mode " << binnedVideoMode - DC1394_VIDEO_MODE_FORMAT7_0 << "." << std::endl;
+		return RET_FAILED;
+	}
+	unitWidth = std::max(unitWidth, (uint32_t) 1);
+	unitHeight = std::max(unitHeight, (uint32_t) 1);
+	unitLeft = std::max(unitLeft, (uint32_t) 1);
+	unitTop = std::max(unitTop, (uint32_t) 1);
+
+	// Round the region of interest to the units of the camera and clip it to the sensor
+	uint32_t left = std::min((uint32_t) std::max(m_Format7ROI.x, 0), maxWidth - unitWidth);
+	uint32_t top = std::min((uint32_t) std::max(m_Format7ROI.y, 0), maxHeight - unitHeight);
+	left -= left % unitLeft;
+	top -= top % unitTop;
+	uint32_t width = (m_Format7ROI.width > 0) ? (uint32_t) m_Format7ROI.width : maxWidth;
+	uint32_t height = (m_Format7ROI.height > 0) ? (uint32_t) m_Format7ROI.height : maxHeight;
+	width = std::max(std::min(width, maxWidth - left) / unitWidth, (uint32_t) 1) * unitWidth;
+	height = std::max(std::min(height, maxHeight - top) / unitHeight, (uint32_t) 1) * unitHeight;
+
+	bool wasCapturing = false;
+	if (StopCapture(&wasCapturing) & ipa_CameraSensors::RET_FAILED)
+	{
+		return RET_FAILED;
+	}
+
+	if (binnedVideoMode != videoMode)
+	{
+		// Keep the color coding of the configured mode
+		dc1394color_coding_t colorCoding;
+		err = dc1394_get_color_coding_from_video_mode(m_cam, videoMode, &colorCoding);
+		if (err==DC1394_SUCCESS)
+		{
+			err = dc1394_video_set_mode(m_cam, binnedVideoMode);
+		}
+		if (err==DC1394_SUCCESS)
+		{
+			err = dc1394_format7_set_color_coding(m_cam, binnedVideoMode, colorCoding);
+		}
+		if (err!=DC1394_SUCCESS)
+		{
+			std::cerr << "ERROR - AVTPikeCam::ApplyFormat7:" << std::endl;
+			std::cerr << "\t ... Failed to switch to Format7 mode " << binnedVideoMode - DC1394_VIDEO_MODE_FORMAT7_0 << "." << std::endl;
+			std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+			if (wasCapturing) StartCapture();
+			return RET_FAILED;
+		}
+	}
+
+	// The camera checks the packet size against the new image size
+	int32_t packetSize = (m_PacketSize > 0) ? (int32_t) m_PacketSize : DC1394_USE_RECOMMENDED;
+	err = dc1394_format7_set_roi(m_cam, binnedVideoMode, (dc1394color_coding_t) DC1394_QUERY_FROM_CAMERA,
+		packetSize, left, top, width, height);
+	if (err!=DC1394_SUCCESS)
+	{
+		std::cerr << "ERROR - AVTPikeCam::ApplyFormat7:" << std::endl;
+		std::cerr << "\t ... Failed to set region of interest " << width << "x" << height
+			<< " at " << left << "," << top << " with packet size " << packetSize << "." << std::endl;
+		std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+		if (wasCapturing) StartCapture();
+		return RET_FAILED;
+	}
+
+	if (wasCapturing)
+	{
+		return StartCapture();
+	}
+	return RET_OK;
+}
+#endif
+
 unsigned long AVTPikeCam::SetPropertyDefaults()
 {
 	return RET_FUNCTION_NOT_IMPLEMENTED;
@@ -481,7 +683,15 @@ unsigned long AVTPikeCam::GetProperty(t_cameraProperty* cameraProperty)
 					return RET_FAILED;                                         
 				} 
 	
-				err = dc1394_get_image_size_from_video_mode(m_cam, videoMode, &imageWidth, &imageHeight);
+				// Format7 images have the size of the region of interest
+				if (dc1394_is_video_mode_scalable(videoMode))
+				{
+					err = dc1394_format7_get_image_size(m_cam, videoMode, &imageWidth, &imageHeight);
+				}
+				else
+				{
+					err = dc1394_get_image_size_from_video_mode(m_cam, videoMode, &imageWidth, &imageHeight);
+				}
 				if (err!=DC1394_SUCCESS) 
 				{    
 					std::cerr << "ERROR - AVTPikeCam::GetProperty:" << std::endl;
@@ -489,8 +699,8 @@ unsigned long AVTPikeCam::GetProperty(t_cameraProperty* cameraProperty)
 					std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
 					return RET_FAILED;                                         
 				} 
-				cameraProperty->cameraResolution.xResolution = (int) imageWidth;
-				cameraProperty->cameraResolution.yResolution = (int) imageHeight;
+				cameraProperty->cameraResolution.xResolution = (int) imageWidth / m_Downscale;
+				cameraProperty->cameraResolution.yResolution = (int) imageHeight / m_Downscale;
 			}
 			else
 			{
@@ -502,6 +712,54 @@ unsigned long AVTPikeCam::GetProperty(t_cameraProperty* cameraProperty)
 				cameraProperty->propertyType = TYPE_CAMERA_RESOLUTION;
 			}
 
+			return RET_OK;
+			break;
+		case PROP_ROI_OFFSET:
+			cameraProperty->propertyType = TYPE_CAMERA_RESOLUTION;
+			cameraProperty->cameraResolution.xResolution = m_Format7ROI.x;
+			cameraProperty->cameraResolution.yResolution = m_Format7ROI.y;
+			if (m_cam != 0)
+			{
+				dc1394video_mode_t videoMode;
+				uint32_t left = 0;
+				uint32_t top = 0;
+				if (dc1394_video_get_mode(m_cam, &videoMode) == DC1394_SUCCESS &&
+					dc1394_is_video_mode_scalable(videoMode) &&
+					dc1394_format7_get_image_position(m_cam, videoMode, &left, &top) == DC1394_SUCCESS)
+				{
+					cameraProperty->cameraResolution.xResolution = (int) left;
+					cameraProperty->cameraResolution.yResolution = (int) top;
+				}
+			}
+			return RET_OK;
+			break;
+		case PROP_PACKET_SIZE:
+			cameraProperty->propertyType = (TYPE_UNSIGNED | TYPE_LONG);
+			cameraProperty->u_longData = m_PacketSize;
+			if (m_cam != 0)
+			{
+				dc1394video_mode_t videoMode;
+				uint32_t packetSize = 0;
+				if (dc1394_video_get_mode(m_cam, &videoMode) == DC1394_SUCCESS &&
+					dc1394_is_video_mode_scalable(videoMode) &&
+					dc1394_format7_get_packet_size(m_cam, videoMode, &packetSize) == DC1394_SUCCESS)
+				{
+					cameraProperty->u_longData = packetSize;
+				}
+			}
+			return RET_OK;
+			break;
+		case PROP_BINNING:
+			cameraProperty->propertyType = (TYPE_UNSIGNED | TYPE_LONG);
+			cameraProperty->u_longData = std::max(m_Binning, 1);
+			if (m_cam != 0)
+			{
+				dc1394video_mode_t videoMode;
+				if (dc1394_video_get_mode(m_cam, &videoMode) == DC1394_SUCCESS)
+				{
+					cameraProperty->u_longData = (videoMode == DC1394_VIDEO_MODE_FORMAT7_3) ? 2 : 1;
+				}
+			}
 			return RET_OK;
 			break;
 		default: 				
@@ -609,92 +867,14 @@ unsigned long AVTPikeCam::GetColorImage(char* colorImageData, bool getLatestFram
 		return (RET_FAILED | RET_CAMERA_NOT_OPEN);
 	}
 #ifdef __LINUX__
-	
-	dc1394error_t err;
-
-	if (m_Frame)
-	{
-		// Release the buffer from previous function call
-		err=dc1394_capture_enqueue(m_cam, m_Frame);                            
-		if (err!=DC1394_SUCCESS) 
-		{    
-			std::cerr << "AVTPikeCam::GetColorImage:" << std::endl;
-			std::cerr << "\t ... 'dc1394_capture_enqueue' failed." << std::endl;
-			std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
-			return RET_FAILED;                                         
-		}
-	}
-
-	//std::cout << "INFO - AVTPikeCam::GetColorImage:" << std::endl;
-	//std::cout << "\t ... Flushing DMA" << std::endl;
-
-	if (getLatestFrame)
+	if (AcquireFrame(getLatestFrame) & RET_FAILED)
 	{
-		// Flush the DMA ring buffer
-		do
-		{
-			m_Frame = 0;
-			err=dc1394_capture_dequeue(m_cam, DC1394_CAPTURE_POLICY_POLL, &m_Frame);
-			if (err!=DC1394_SUCCESS) 
-			{    
-				std::cerr << "ERROR - AVTPikeCam::GetColorImage:" << std::endl;
-				std::cerr << "\t ... 'dc1394_capture_dequeue' failed." << std::endl;
-				std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
-				return RET_FAILED;                                         
-			}
-
-			if (m_Frame == 0)
-			{
-				break;
-			}
-			
-			err=dc1394_capture_enqueue(m_cam, m_Frame);                            
-			if (err!=DC1394_SUCCESS) 
-			{    
-				std::cerr << "ERROR - AVTPikeCam::GetColorImage:" << std::endl;
-				std::cerr << "\t ... 'dc1394_capture_enqueue' failed." << std::endl;
-				std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
-				return RET_FAILED;                                         
-			}
-		} 
-		while (true);
-	}
-
-	//std::cout << "INFO - AVTPikeCam::GetColorImage:" << std::endl;
-	//std::cout << "\t ... Waiting for images" << std::endl;
-
-	// Capture
-	err=dc1394_capture_dequeue(m_cam, DC1394_CAPTURE_POLICY_WAIT, &m_Frame);
-	if (err!=DC1394_SUCCESS) 
-	{    
-		std::cerr << "ERROR - AVTPikeCam::GetColorImage:" << std::endl;
-		std::cerr << "\t ... 'dc1394_capture_dequeue' failed." << std::endl;
-		std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
-		return RET_FAILED;                                         
-	} 
-	unsigned char * src = (unsigned char *)m_Frame->image;
-	unsigned char * dst = (unsigned char *)colorImageData;
-	
-	// Convert RGB to BGR
-	int width;
-	int height;
-	ipa_CameraSensors::t_cameraProperty cameraProperty;
-	cameraProperty.propertyID = PROP_CAMERA_RESOLUTION;
-	if (GetProperty(&cameraProperty) & RET_FAILED) return RET_FAILED;
-	width = cameraProperty.cameraResolution.xResolution;
-	height = cameraProperty.cameraResolution.yResolution;
-
-	for (int i=0;i<width*height*3;i+=6) 
-	{
-		dst[i]   = src[i+2];
-		dst[i+1] = src[i+1];
-		dst[i+2] = src[i];
-		dst[i+3] = src[i+5];
-		dst[i+4] = src[i+4];
-		dst[i+5] = src[i+3];
+		return RET_FAILED;
 	}
 
-	return RET_OK;
+	// Header on the caller's buffer, the conversion writes directly into it
+	cv::Mat colorImage(m_Frame->size[1]/m_Downscale, m_Frame->size[0]/m_Downscale, CV_8UC3, colorImageData);
+	return ConvertFrame(colorImage);
 	
 #else
 	
@@ -724,6 +904,8 @@ unsigned long AVTPikeCam::GetColorImage(char* colorImageData, bool getLatestFram
 		std::cerr << "\t ... Could not acquire image ( error " << err << " )" << std::endl;
 		return RET_FAILED;
 	}
+	m_FrameInfo.timestamp = GetFrameTimestamp();
+	m_FrameInfo.sequenceNumber++;
 
 	unsigned char * src = (unsigned char *)m_Frame.pData;
 	unsigned char * dst = (unsigned char *)colorImageData;
@@ -777,6 +959,15 @@ unsigned long AVTPikeCam::GetColorImage(cv::Mat* colorImage, bool getLatestFrame
 		return (RET_FAILED | RET_CAMERA_NOT_OPEN);
 	}
 
+#ifdef __LINUX__
+	if (AcquireFrame(getLatestFrame) & RET_FAILED)
+	{
+		return RET_FAILED;
+	}
+
+	// Creates color image, if necessary
+	return ConvertFrame(*colorImage);
+#else
 	ipa_CameraSensors::t_cameraProperty cameraProperty;
 	cameraProperty.propertyID = PROP_CAMERA_RESOLUTION;
 	if (GetProperty(&cameraProperty) & RET_FAILED) 
@@ -791,6 +982,177 @@ unsigned long AVTPikeCam::GetColorImage(cv::Mat* colorImage, bool getLatestFrame
 	// Create color image, if necessary
 	colorImage->create(height, width, CV_8UC3);
 	return GetColorImage(colorImage->ptr<char>(0), getLatestFrame);
+#endif
+}
+
+#ifdef __LINUX__
+unsigned long AVTPikeCam::AcquireFrame(bool getLatestFrame)
+{
+	if (m_Frame)
+	{
+		// Release the buffer from previous function call
+		dc1394error_t err=dc1394_capture_enqueue(m_cam, m_Frame);
+		if (err!=DC1394_SUCCESS) 
+		{    
+			std::cerr << "AVTPikeCam::AcquireFrame:" << std::endl;
+			std::cerr << "\t ... 'dc1394_capture_enqueue' failed." << std::endl;
+			std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+			return RET_FAILED;                                         
+		}
+	}
+
+	m_Frame = 0;
+	return DequeueFrame(&m_Frame, getLatestFrame);
+}
+
+unsigned long AVTPikeCam::ConvertFrame(cv::Mat& colorImage)
+{
+	const unsigned char* src = (const unsigned char*) m_Frame->image;
+	int width = m_Frame->size[0];
+	int height = m_Frame->size[1];
+	int step = m_Frame->stride;
+	if (step == 0 && height > 0)
+	{
+		step = m_Frame->image_bytes / height;
+	}
+
+	// The color coding follows the video mode set with SetProperty
+	switch (m_Frame->color_coding)
+	{
+		case DC1394_COLOR_CODING_RGB8:
+			return ConvertRGB8ToBGR(src, step, width, height, m_Downscale, colorImage);
+		case DC1394_COLOR_CODING_YUV422:
+			return ConvertYUV422ToBGR(src, step, width, height, m_Downscale, colorImage);
+		case DC1394_COLOR_CODING_YUV411:
+			return ConvertYUV411ToBGR(src, step, width, height, m_Downscale, colorImage);
+		case DC1394_COLOR_CODING_MONO8:
+			return ConvertMono8ToBGR(src, step, width, height, m_Downscale, colorImage);
+		case DC1394_COLOR_CODING_RAW8:
+		{
+			t_BayerPattern pattern = BAYER_RGGB;
+			switch (m_Frame->color_filter)
+			{
+				case DC1394_COLOR_FILTER_RGGB: pattern = BAYER_RGGB; break;
+				case DC1394_COLOR_FILTER_GBRG: pattern = BAYER_GBRG; break;
+				case DC1394_COLOR_FILTER_GRBG: pattern = BAYER_GRBG; break;
+				case DC1394_COLOR_FILTER_BGGR: pattern = BAYER_BGGR; break;
+			}
+			return ConvertBayer8ToBGR(src, step, width, height, pattern, m_Downscale, colorImage);
+		}
+		default:
+			std::cerr << "ERROR - AVTPikeCam::ConvertFrame:" << std::endl;
+			std::cerr << "\t ... Conversion of color coding " << m_Frame->color_coding << " to BGR not supported." << std::endl;
+			return RET_FAILED;
+	}
+}
+#endif
+
+#ifdef __LINUX__
+unsigned long AVTPikeCam::DequeueFrame(dc1394video_frame_t** frame, bool getLatestFrame)
+{
+	dc1394error_t err;
+	unsigned long flushedFrames = 0;
+
+	//std::cout << "INFO - AVTPikeCam::DequeueFrame:" << std::endl;
+	//std::cout << "\t ... Flushing DMA" << std::endl;
+
+	if (getLatestFrame)
+	{
+		// Flush the DMA ring buffer
+		do
+		{
+			*frame = 0;
+			err=dc1394_capture_dequeue(m_cam, DC1394_CAPTURE_POLICY_POLL, frame);
+			if (err!=DC1394_SUCCESS) 
+			{    
+				std::cerr << "ERROR - AVTPikeCam::DequeueFrame:" << std::endl;
+				std::cerr << "\t ... 'dc1394_capture_dequeue' failed." << std::endl;
+				std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+				return RET_FAILED;                                         
+			}
+
+			if (*frame == 0)
+			{
+				break;
+			}
+			flushedFrames++;
+			
+			err=dc1394_capture_enqueue(m_cam, *frame);                            
+			if (err!=DC1394_SUCCESS) 
+			{    
+				*frame = 0;
+				std::cerr << "ERROR - AVTPikeCam::DequeueFrame:" << std::endl;
+				std::cerr << "\t ... 'dc1394_capture_enqueue' failed." << std::endl;
+				std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+				return RET_FAILED;                                         
+			}
+		} 
+		while (true);
+	}
+
+	//std::cout << "INFO - AVTPikeCam::DequeueFrame:" << std::endl;
+	//std::cout << "\t ... Waiting for images" << std::endl;
+
+	// Capture
+	err=dc1394_capture_dequeue(m_cam, DC1394_CAPTURE_POLICY_WAIT, frame);
+	if (err!=DC1394_SUCCESS) 
+	{    
+		*frame = 0;
+		std::cerr << "ERROR - AVTPikeCam::DequeueFrame:" << std::endl;
+		std::cerr << "\t ... 'dc1394_capture_dequeue' failed." << std::endl;
+		std::cerr << "\t ... " << dc1394_error_get_string(err) << std::endl;
+		return RET_FAILED;                                         
+	} 
+
+	// Flushed frames count as skipped, the timestamp is taken by the driver on reception (in us)
+	m_FrameInfo.timestamp = (*frame)->timestamp * 1e-6;
+	m_FrameInfo.sequenceNumber += flushedFrames + 1;
+	return RET_OK;
+}
+#endif
+
+unsigned long AVTPikeCam::GetDMAFrame(AVTPikeCamFramePtr* frame, bool getLatestFrame)
+{
+	if (!isOpen())
+	{
+		std::cerr << "ERROR - AVTPikeCam::GetDMAFrame:" << std::endl;
+		std::cerr << "\t ... Color camera not open." << std::endl;
+		return (RET_FAILED | RET_CAMERA_NOT_OPEN);
+	}
+#ifdef __LINUX__
+	dc1394video_frame_t* dmaFrame = 0;
+	if (DequeueFrame(&dmaFrame, getLatestFrame) & RET_FAILED)
+	{
+		return RET_FAILED;
+	}
+	// The frame owns the DMA buffer from here on, also in case of errors
+	AVTPikeCamFramePtr newFrame(new AVTPikeCamFrame(m_cam, dmaFrame, m_CaptureActive));
+	newFrame->m_FrameInfo = m_FrameInfo;
+
+	int type = -1;
+	switch (dmaFrame->color_coding)
+	{
+		case DC1394_COLOR_CODING_RGB8: type = CV_8UC3; break;
+		case DC1394_COLOR_CODING_RGB16: type = CV_16UC3; break;
+		case DC1394_COLOR_CODING_MONO8:
+		case DC1394_COLOR_CODING_RAW8: type = CV_8UC1; break;
+		case DC1394_COLOR_CODING_MONO16:
+		case DC1394_COLOR_CODING_RAW16: type = CV_16UC1; break;
+		case DC1394_COLOR_CODING_YUV422: type = CV_8UC2; break;
+		default:
+			std::cerr << "ERROR - AVTPikeCam::GetDMAFrame:" << std::endl;
+			std::cerr << "\t ... Color coding " << dmaFrame->color_coding << " has no matching image type." << std::endl;
+			return RET_FAILED;
+	}
+	newFrame->m_Image = cv::Mat(dmaFrame->size[1], dmaFrame->size[0], type, dmaFrame->image, dmaFrame->stride);
+
+	*frame = newFrame;
+	return RET_OK;
+#else
+	std::cerr << "ERROR - AVTPikeCam::GetDMAFrame:" << std::endl;
+	std::cerr << "\t ... Not implemented for AVT FireGrab." << std::endl;
+	return RET_FUNCTION_NOT_IMPLEMENTED;
+#endif
 }
 
 unsigned long AVTPikeCam::PrintCameraInformation()
@@ -2289,6 +2651,8 @@ unsigned long AVTPikeCam::SetProperty(t_cameraProperty* cameraProperty)
 							std::cerr << "\t ... Could not set packet size " << bytesPerPacket << " ( error " << err << " )" << std::endl;
 							return RET_FAILED;
 						}
+						// Kept when the region of interest changes
+						m_PacketSize = bytesPerPacket;
 					}
 #else
 					UINT32 bytesPerImage = 0;
@@ -2553,6 +2917,34 @@ unsigned long AVTPikeCam::SetProperty(t_cameraProperty* cameraProperty)
 			}
 			break;
 ///====================================================================
+// PROP_DMA_BUFFER_SIZE
+///====================================================================	
+		case PROP_DMA_BUFFER_SIZE:
+			if (isOpen())
+			{
+				std::cerr << "ERROR - AVTPikeCam::SetProperty:" << std::endl;
+				std::cerr << "\t ... DMA buffer size can only be set before the camera is opened." << std::endl;
+				return RET_FAILED;
+			}
+			if (cameraProperty->propertyType & (ipa_CameraSensors::TYPE_LONG | ipa_CameraSensors::TYPE_UNSIGNED))
+			{
+				if (cameraProperty->u_integerData < 1)
+				{
+					std::cerr << "ERROR - AVTPikeCam::SetProperty:" << std::endl;
+					std::cerr << "\t ... DMA buffer size must hold at least one frame." << std::endl;
+					return RET_FAILED;
+				}
+				m_BufferSize = cameraProperty->u_integerData;
+				return RET_OK;
+			}
+			else
+			{
+				std::cerr << "ERROR - AVTPikeCam::SetProperty:" << std::endl;
+				std::cerr << "\t ... Wrong property type. '(TYPE_LONG|TYPE_UNSIGNED)' expected." << std::endl;
+				return RET_FAILED;
+			}
+			break;
+///====================================================================
 // PROP_ISO_SPEED
 ///====================================================================	
 		case PROP_ISO_SPEED:
@@ -2669,6 +3061,10 @@ unsigned long AVTPikeCam::SetProperty(t_cameraProperty* cameraProperty)
 				if(cameraProperty->specialValue == ipa_CameraSensors::VALUE_AUTO)
 				{
 #ifdef __LINUX__
+					// Whole sensor, starting at the current offset
+					m_Format7ROI.width = 0;
+					m_Format7ROI.height = 0;
+					return ApplyFormat7();
 #else
 					err = m_cam.SetParameter(FGP_XSIZE, PVAL_AUTO);
 					if(err!=FCE_NOERROR)
@@ -2700,6 +3096,16 @@ unsigned long AVTPikeCam::SetProperty(t_cameraProperty* cameraProperty)
 			else if (cameraProperty->propertyType & ipa_CameraSensors::TYPE_CAMERA_RESOLUTION)
 			{
 #ifdef __LINUX__
+				if (cameraProperty->cameraResolution.xResolution < 1 ||
+					cameraProperty->cameraResolution.yResolution < 1)
+				{
+					std::cerr << "ERROR - AVTPikeCam::SetProperty:" << std::endl;
+					std::cerr << "\t ... Region of interest must be at least 1x1 pixels." << std::endl;
+					return RET_FAILED;
+				}
+				m_Format7ROI.width = cameraProperty->cameraResolution.xResolution;
+				m_Format7ROI.height = cameraProperty->cameraResolution.yResolution;
+				return ApplyFormat7();
 #else
 				m_cam.GetParameterInfo(FGP_XSIZE, &info);
 				if (((unsigned int) cameraProperty->cameraResolution.xResolution < info.MinValue) ||
@@ -2746,6 +3152,120 @@ unsigned long AVTPikeCam::SetProperty(t_cameraProperty* cameraProperty)
 			}
 			break;
 ///====================================================================
+// PROP_ROI_OFFSET
+///====================================================================	
+		case PROP_ROI_OFFSET:
+#ifdef __LINUX__
+			if (cameraProperty->propertyType & ipa_CameraSensors::TYPE_CAMERA_RESOLUTION)
+			{
+				if (cameraProperty->cameraResolution.xResolution < 0 ||
+					cameraProperty->cameraResolution.yResolution < 0)
+				{
+					std::cerr << "ERROR - AVTPikeCam::SetProperty:" << std::endl;
+					std::cerr << "\t ... Region of interest offset must not be negative." << std::endl;
+					return RET_FAILED;
+				}
+				m_Format7ROI.x = cameraProperty->cameraResolution.xResolution;
+				m_Format7ROI.y = cameraProperty->cameraResolution.yResolution;
+				return ApplyFormat7();
+			}
+			else
+			{
+				std::cerr << "ERROR - AVTPikeCam::SetProperty:" << std::endl;
+				std::cerr << "\t ... Wrong property type. 'TYPE_CAMERA_RESOLUTION' expected." << std::endl;
+				return RET_FAILED;
+			}
+#else
+			return RET_FUNCTION_NOT_IMPLEMENTED;
+#endif
+			break;
+///====================================================================
+// PROP_PACKET_SIZE
+///====================================================================	
+		case PROP_PACKET_SIZE:
+#ifdef __LINUX__
+			if (cameraProperty->propertyType & ipa_CameraSensors::TYPE_SPECIAL)
+			{
+				if(cameraProperty->specialValue == ipa_CameraSensors::VALUE_AUTO || 
+					cameraProperty->specialValue == ipa_CameraSensors::VALUE_DEFAULT)
+				{
+					m_PacketSize = 0;
+					return ApplyFormat7();
+				}
+				else
+				{
+					std::cerr << "ERROR - AVTPikeCam::SetProperty:" << std::endl;
+					std::cerr << "\t ... Special value 'VALUE_AUTO' or 'VALUE_DEFAULT' expected." << std::endl;
+					return RET_FAILED;
+				}
+			}
+			else if (cameraProperty->propertyType & (ipa_CameraSensors::TYPE_LONG | ipa_CameraSensors::TYPE_UNSIGNED))
+			{
+				unsigned int packetSize = (unsigned int) cameraProperty->u_longData;
+				dc1394video_mode_t videoMode;
+				uint32_t min = 0;
+				uint32_t max = 0;
+				// Bytes per packet must be a multiple of min bytes
+				if (m_cam != 0 &&
+					dc1394_video_get_mode(m_cam, &videoMode) == DC1394_SUCCESS &&
+					dc1394_is_video_mode_scalable(videoMode) &&
+					dc1394_format7_get_packet_parameters(m_cam, videoMode, &min, &max) == DC1394_SUCCESS &&
+					min > 0)
+				{
+					if (packetSize < min || packetSize > max)
+					{
+						std::cout << "WARNING - AVTPikeCam::SetProperty:" << std::endl;
+						std::cout << "\t ... Packet size " << packetSize << " has to be a value between " 
+							<< min << " and " << max << "." << std::endl;
+						packetSize = std::max(std::min(packetSize, (unsigned int) max), (unsigned int) min);
+					}
+					packetSize = (packetSize/min)*min;
+				}
+				m_PacketSize = packetSize;
+				return ApplyFormat7();
+			}
+			else
+			{
+				std::cerr << "ERROR - AVTPikeCam::SetProperty:" << std::endl;
+				std::cerr << "\t ... Wrong property type. '(TYPE_LONG|TYPE_UNSIGNED)' or 'TYPE_SPECIAL' expected." << std::endl;
+				return RET_FAILED;
+			}
+#else
+			return RET_FUNCTION_NOT_IMPLEMENTED;
+#endif
+			break;
+///====================================================================
+// PROP_BINNING
+///====================================================================	
+		case PROP_BINNING:
+#ifdef __LINUX__
+			if (cameraProperty->propertyType & (ipa_CameraSensors::TYPE_LONG | ipa_CameraSensors::TYPE_UNSIGNED))
+			{
+				if (cameraProperty->u_longData != 1 && cameraProperty->u_longData != 2)
+				{
+					std::cerr << "ERROR - AVTPikeCam::SetProperty:" << std::endl;
+					std::cerr << "\t ... Binning factor " << cameraProperty->u_longData << " not supported, 1 or 2 expected." << std::endl;
+					return RET_FAILED;
+				}
+				if (m_Binning != (int) cameraProperty->u_longData)
+				{
+					// The region of interest refers to the binned sensor
+					m_Format7ROI = cv::Rect();
+				}
+				m_Binning = (int) cameraProperty->u_longData;
+				return ApplyFormat7();
+			}
+			else
+			{
+				std::cerr << "ERROR - AVTPikeCam::SetProperty:" << std::endl;
+				std::cerr << "\t ... Wrong property type. '(TYPE_LONG|TYPE_UNSIGNED)' expected." << std::endl;
+				return RET_FAILED;
+			}
+#else
+			return RET_FUNCTION_NOT_IMPLEMENTED;
+#endif
+			break;
+///====================================================================
 // DEFAULT
 ///====================================================================	
 		default: 
@@ -3016,6 +3536,16 @@ unsigned long AVTPikeCam::SetParameters()
 		std::cout << "\t ... Could not set video format, video mode and color mode" << std::endl;
 	}
 
+#ifdef __LINUX__
+// -----------------------------------------------------------------
+// Set Format7 region of interest, packet size and binning set before Open
+// -----------------------------------------------------------------
+	if (ApplyFormat7() & ipa_CameraSensors::RET_FAILED)
+	{
+		std::cout << "WARNING - AVTPikeCam::SetParameters:" << std::endl;
+		std::cout << "\t ... Could not set Format7 region of interest" << std::endl;
+	}
+#endif
 
 // -----------------------------------------------------------------
 // Set resolution
@@ -3731,6 +4261,64 @@ unsigned long AVTPikeCam::LoadParameters(const char* filename, int cameraIndex)
 					return (RET_FAILED | RET_XML_TAG_NOT_FOUND);
 				}
 
+//************************************************************************************
+//	BEGIN LibCameraSensors->AVTPikeCam->DMABufferSize
+//************************************************************************************
+				// Subtag element "DMABufferSize" of Xml Inifile, optional
+				p_xmlElement_Child = NULL;
+				p_xmlElement_Child = p_xmlElement_Root_AVTPikeCam->FirstChildElement( "DMABufferSize" );
+				if ( p_xmlElement_Child )
+				{
+					int bufferSize = 0;
+					// read and save value of attribute
+					if ( p_xmlElement_Child->QueryIntAttribute( "value", &bufferSize ) != TIXML_SUCCESS)
+					{
+						std::cerr << "ERROR - AVTPikeCam::LoadParameters:" << std::endl;
+						std::cerr << "\t ... Can't find attribute 'value' of tag 'DMABufferSize'." << std::endl;
+						return (RET_FAILED | RET_XML_ATTR_NOT_FOUND);
+					}
+					if (bufferSize < 1)
+					{
+						std::cerr << "ERROR - AVTPikeCam::LoadParameters:" << std::endl;
+						std::cerr << "\t ... DMA buffer size must hold at least one frame." << std::endl;
+						return (RET_FAILED);
+					}
+					m_BufferSize = bufferSize;
+				}
+
+//************************************************************************************
+//	BEGIN LibCameraSensors->AVTPikeCam->Downscale
+//************************************************************************************
+				// Subtag element "Downscale" of Xml Inifile, optional
+				p_xmlElement_Child = NULL;
+				p_xmlElement_Child = p_xmlElement_Root_AVTPikeCam->FirstChildElement( "Downscale" );
+				if ( p_xmlElement_Child )
+				{
+					int downscale = 1;
+					// read and save value of attribute
+					if ( p_xmlElement_Child->QueryIntAttribute( "value", &downscale ) != TIXML_SUCCESS)
+					{
+						std::cerr << "ERROR - AVTPikeCam::LoadParameters:" << std::endl;
+						std::cerr << "\t ... Can't find attribute 'value' of tag 'Downscale'." << std::endl;
+						return (RET_FAILED | RET_XML_ATTR_NOT_FOUND);
+					}
+					if (downscale != 1 && downscale != 2)
+					{
+						std::cerr << "ERROR - AVTPikeCam::LoadParameters:" << std::endl;
+						std::cerr << "\t ... Downscale factor " << downscale << " unspecified, use 1 or 2." << std::endl;
+						return (RET_FAILED);
+					}
+#ifdef __LINUX__
+					m_Downscale = downscale;
+#else
+					if (downscale != 1)
+					{
+						std::cout << "WARNING - AVTPikeCam::LoadParameters:" << std::endl;
+						std::cout << "\t ... Downscaling is only supported with libdc1394, ignoring tag 'Downscale'." << std::endl;
+					}
+#endif
+				}
+
 //************************************************************************************
 //	BEGIN LibCameraSensors->AVTPikeCam->PROP_SHUTTER
 //************************************************************************************
@@ -67,6 +67,46 @@ AbstractRangeImagingSensor::~AbstractRangeImagingSensor()
 {
 }
 
+unsigned long AbstractRangeImagingSensor::AcquireFrame(const t_RangeFrameRequest& request, t_RangeFrame& frame)
+{
+	unsigned long ret = AcquireImages((request.channels & RANGE_CHANNEL) ? &frame.rangeImage : 0,
+		(request.channels & GRAY_CHANNEL) ? &frame.grayImage : 0,
+		(request.channels & CARTESIAN_CHANNEL) ? &frame.cartesianImage : 0,
+		request.getLatestFrame, request.undistort, request.grayImageType);
+	frame.info = GetFrameInfo();
+	return ret;
+}
+
+unsigned long AbstractRangeImagingSensor::AcquireImagesIntoFrame(cv::Mat* rangeImage, cv::Mat* grayImage, cv::Mat* cartesianImage,
+		bool getLatestFrame, bool undistort, ipa_CameraSensors::t_ToFGrayImageType grayImageType)
+{
+	// headers only, the frame writes into the buffers of the given images if they fit
+	t_RangeFrame frame;
+	t_RangeFrameRequest request(0, getLatestFrame, undistort, grayImageType);
+	if (rangeImage)
+	{
+		frame.rangeImage = *rangeImage;
+		request.channels |= RANGE_CHANNEL;
+	}
+	if (grayImage)
+	{
+		frame.grayImage = *grayImage;
+		request.channels |= GRAY_CHANNEL;
+	}
+	if (cartesianImage)
+	{
+		frame.cartesianImage = *cartesianImage;
+		request.channels |= CARTESIAN_CHANNEL;
+	}
+
+	unsigned long ret = AcquireFrame(request, frame);
+
+	if (rangeImage) *rangeImage = frame.rangeImage;
+	if (grayImage) *grayImage = frame.grayImage;
+	if (cartesianImage) *cartesianImage = frame.cartesianImage;
+	return ret;
+}
+
 unsigned long AbstractRangeImagingSensor::SetIntrinsics(cv::Mat& intrinsicMatrix,
 		cv::Mat& undistortMapX, cv::Mat& undistortMapY)
 {
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cob_vision_utils/StdAfx.h>
+
+#ifdef __LINUX__
+#include "cob_camera_sensors/CalibrationCache.h"
+#else
+#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/CalibrationCache.h"
+#endif
+
+#include <opencv2/core/core_c.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/scoped_ptr.hpp>
+
+namespace bip = boost::interprocess;
+using namespace ipa_CameraSensors;
+
+namespace
+{
+	/// FNV-1a hash, continued from hash.
+	boost::uint64_t Hash(boost::uint64_t hash, const char* data, size_t size)
+	{
+		for (size_t i=0; i<size; i++)
+		{
+			hash ^= (unsigned char) data[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	/// Hash over the sizes and contents of the files, a missing file is hashed as empty file with size -1.
+	boost::uint64_t HashFiles(const std::vector<std::string>& files)
+	{
+		boost::uint64_t hash = 14695981039346656037ULL;
+		std::vector<char> buffer(1 << 16);
+		for (size_t f=0; f<files.size(); f++)
+		{
+			std::ifstream file(files[f].c_str(), std::ios::binary);
+			boost::int64_t size = -1;
+			if (file.is_open())
+			{
+				size = 0;
+				while (file.read(&buffer[0], buffer.size()) || file.gcount() > 0)
+				{
+					hash = Hash(hash, &buffer[0], file.gcount());
+					size += file.gcount();
+				}
+			}
+			hash = Hash(hash, (const char*) &size, sizeof(size));
+		}
+		return hash;
+	}
+
+	/// Copies the matrices from the cache, if it is valid and was built from the given source files.
+	bool ReadCache(const std::string& cacheFile, boost::uint64_t sourceHash, size_t numberOfMatrices, std::vector<cv::Mat>& matrices)
+	{
+		boost::scoped_ptr<bip::file_mapping> mapping;
+		boost::scoped_ptr<bip::mapped_region> region;
+		try
+		{
+			mapping.reset(new bip::file_mapping(cacheFile.c_str(), bip::read_only));
+			region.reset(new bip::mapped_region(*mapping, bip::read_only));
+		}
+		catch (const bip::interprocess_exception&)
+		{
+			// no cache yet
+			return false;
+		}
+
+		const char* data = (const char*) region->get_address();
+		boost::uint64_t fileSize = region->get_size();
+		boost::uint64_t entriesEnd = sizeof(t_CalibrationCacheHeader) + numberOfMatrices * sizeof(t_CalibrationCacheEntry);
+		if (fileSize < entriesEnd)
+		{
+			return false;
+		}
+
+		t_CalibrationCacheHeader header;
+		memcpy(&header, data, sizeof(header));
+		if (memcmp(header.magic, c_CalibrationCacheMagic, sizeof(c_CalibrationCacheMagic)) != 0 ||
+			header.version != c_CalibrationCacheVersion || header.numberOfMatrices != numberOfMatrices ||
+			header.sourceHash != sourceHash)
+		{
+			return false;
+		}
+
+		std::vector<cv::Mat> result(numberOfMatrices);
+		const t_CalibrationCacheEntry* entries = (const t_CalibrationCacheEntry*) (data + sizeof(t_CalibrationCacheHeader));
+		for (size_t i=0; i<numberOfMatrices; i++)
+		{
+			const t_CalibrationCacheEntry& entry = entries[i];
+			if (entry.type == -1)
+			{
+				continue;
+			}
+			if (entry.rows <= 0 || entry.cols <= 0 || entry.type != CV_MAT_TYPE(entry.type) ||
+				entry.offset < entriesEnd || entry.offset + (boost::uint64_t)entry.rows * entry.cols * CV_ELEM_SIZE(entry.type) > fileSize)
+			{
+				return false;
+			}
+			// copy, the mapping is closed when returning
+			result[i] = cv::Mat(entry.rows, entry.cols, entry.type, (void*) (data + entry.offset)).clone();
+		}
+
+		matrices.swap(result);
+		return true;
+	}
+
+	/// Writes the cache to a temporary file, which replaces the old cache when it is complete.
+	bool WriteCache(const std::string& cacheFile, boost::uint64_t sourceHash, const std::vector<cv::Mat>& matrices)
+	{
+		std::string tmpFile = cacheFile + ".tmp";
+		std::ofstream file(tmpFile.c_str(), std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		t_CalibrationCacheHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, c_CalibrationCacheMagic, sizeof(c_CalibrationCacheMagic));
+		header.version = c_CalibrationCacheVersion;
+		header.numberOfMatrices = matrices.size();
+		header.sourceHash = sourceHash;
+		file.write((const char*) &header, sizeof(header));
+
+		std::vector<t_CalibrationCacheEntry> entries(matrices.size());
+		boost::uint64_t offset = sizeof(header) + entries.size() * sizeof(t_CalibrationCacheEntry);
+		for (size_t i=0; i<matrices.size(); i++)
+		{
+			memset(&entries[i], 0, sizeof(t_CalibrationCacheEntry));
+			entries[i].type = -1;
+			if (matrices[i].empty())
+			{
+				continue;
+			}
+			offset = (offset + c_CalibrationCacheAlignment - 1) / c_CalibrationCacheAlignment * c_CalibrationCacheAlignment;
+			entries[i].rows = matrices[i].rows;
+			entries[i].cols = matrices[i].cols;
+			entries[i].type = matrices[i].type();
+			entries[i].offset = offset;
+			offset += matrices[i].total() * matrices[i].elemSize();
+		}
+		if (!entries.empty())
+		{
+			file.write((const char*) &entries[0], entries.size() * sizeof(t_CalibrationCacheEntry));
+		}
+
+		const char padding[c_CalibrationCacheAlignment] = {0};
+		for (size_t i=0; i<matrices.size(); i++)
+		{
+			if (entries[i].type == -1)
+			{
+				continue;
+			}
+			file.write(padding, entries[i].offset - (boost::uint64_t) file.tellp());
+			const cv::Mat& matrix = matrices[i];
+			for (int row=0; row<matrix.rows; row++)
+			{
+				file.write((const char*) matrix.ptr(row), matrix.cols * matrix.elemSize());
+			}
+		}
+
+		bool good = file.good();
+		file.close();
+		if (!good || rename(tmpFile.c_str(), cacheFile.c_str()) != 0)
+		{
+			remove(tmpFile.c_str());
+			return false;
+		}
+		return true;
+	}
+}
+
+unsigned long ipa_CameraSensors::LoadCalibrationMatrices(const std::vector<std::string>& sourceFiles,
+	const std::string& cacheFile, std::vector<cv::Mat>& matrices)
+{
+	boost::uint64_t sourceHash = HashFiles(sourceFiles);
+	if (ReadCache(cacheFile, sourceHash, sourceFiles.size(), matrices))
+	{
+		return RET_OK;
+	}
+
+	matrices.assign(sourceFiles.size(), cv::Mat());
+	bool anyLoaded = false;
+	for (size_t i=0; i<sourceFiles.size(); i++)
+	{
+		CvMat* c_mat = (CvMat*)cvLoad(sourceFiles[i].c_str());
+		if (c_mat)
+		{
+			// copy, c_mat owns its data
+			matrices[i] = cv::Mat(c_mat, true);
+			cvReleaseMat(&c_mat);
+			anyLoaded = true;
+		}
+	}
+
+	// without any calibration there is nothing to speed up
+	if (anyLoaded && !WriteCache(cacheFile, sourceHash, matrices))
+	{
+		std::cerr << "WARNING - LoadCalibrationMatrices:" << std::endl;
+		std::cerr << "\t ... Could not write calibration cache '" << cacheFile << "'." << std::endl;
+	}
+
+	return RET_OK;
+}
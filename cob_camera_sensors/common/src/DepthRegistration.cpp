@@ -0,0 +1,133 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cob_vision_utils/StdAfx.h>
+
+#ifdef __LINUX__
+#include "cob_camera_sensors/DepthRegistration.h"
+#else
+#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/DepthRegistration.h"
+#endif
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <iostream>
+
+using namespace ipa_CameraSensors;
+
+DepthRegistration::DepthRegistration()
+{
+	m_Initialized = false;
+}
+
+unsigned long DepthRegistration::Init(const cv::Mat& colorIntrinsicMatrix, cv::Size colorImageSize,
+	const cv::Mat& rotation, const cv::Mat& translation)
+{
+	m_Initialized = false;
+	if (colorIntrinsicMatrix.rows != 3 || colorIntrinsicMatrix.cols != 3 ||
+		rotation.rows != 3 || rotation.cols != 3 || translation.total() != 3 ||
+		colorImageSize.width <= 0 || colorImageSize.height <= 0)
+	{
+		std::cerr << "ERROR - DepthRegistration::Init:" << std::endl;
+		std::cerr << "\t ... 3x3 intrinsic matrix, 3x3 rotation, 3x1 translation and image size expected." << std::endl;
+		return RET_FAILED;
+	}
+
+	cv::Mat k, r, t;
+	colorIntrinsicMatrix.convertTo(k, CV_64F);
+	rotation.convertTo(r, CV_64F);
+	translation.reshape(1, 3).convertTo(t, CV_64F);
+
+	cv::Mat extrinsics(3, 4, CV_64F);
+	r.copyTo(extrinsics.colRange(0, 3));
+	t.copyTo(extrinsics.col(3));
+	cv::Mat projection = k * extrinsics;
+	for (int i=0; i<3; i++)
+	{
+		for (int j=0; j<4; j++)
+		{
+			m_Projection(i, j) = (float) projection.at<double>(i, j);
+		}
+	}
+
+	m_ColorImageSize = colorImageSize;
+	m_Initialized = true;
+	return RET_OK;
+}
+
+unsigned long DepthRegistration::Project(const cv::Mat& xyzImage, cv::Size colorImageSize, cv::Mat& uvImage)
+{
+	if (!m_Initialized)
+	{
+		std::cerr << "ERROR - DepthRegistration::Project:" << std::endl;
+		std::cerr << "\t ... Registration not initialized." << std::endl;
+		return RET_FAILED;
+	}
+	if (xyzImage.type() != CV_32FC3)
+	{
+		std::cerr << "ERROR - DepthRegistration::Project:" << std::endl;
+		std::cerr << "\t ... CV_32FC3 xyz image expected." << std::endl;
+		return RET_FAILED;
+	}
+
+	// Color images may be downscaled against the calibration
+	cv::Matx34f projection = m_Projection;
+	float scaleU = (float) colorImageSize.width / m_ColorImageSize.width;
+	float scaleV = (float) colorImageSize.height / m_ColorImageSize.height;
+	for (int j=0; j<4; j++)
+	{
+		projection(0, j) *= scaleU;
+		projection(1, j) *= scaleV;
+	}
+
+	cv::transform(xyzImage, m_Homogeneous, projection);
+
+	uvImage.create(xyzImage.size(), CV_32FC2);
+	// Points at or behind the color camera get coordinates outside the image
+	const float minDepth = 1e-3f;
+	for (int row=0; row<m_Homogeneous.rows; row++)
+	{
+		const float* p = m_Homogeneous.ptr<float>(row);
+		float* uv = uvImage.ptr<float>(row);
+		for (int col=0; col<m_Homogeneous.cols; col++, p+=3, uv+=2)
+		{
+			bool valid = p[2] > minDepth;
+			float w = 1.f / (valid ? p[2] : 1.f);
+			uv[0] = valid ? p[0]*w : -1.f;
+			uv[1] = valid ? p[1]*w : -1.f;
+		}
+	}
+	return RET_OK;
+}
+
+unsigned long DepthRegistration::Register(const cv::Mat& xyzImage, const cv::Mat& colorImage, cv::Mat& registeredColorImage)
+{
+	if (colorImage.type() != CV_8UC3)
+	{
+		std::cerr << "ERROR - DepthRegistration::Register:" << std::endl;
+		std::cerr << "\t ... CV_8UC3 color image expected." << std::endl;
+		return RET_FAILED;
+	}
+	if (Project(xyzImage, colorImage.size(), m_UV) & RET_FAILED)
+	{
+		return RET_FAILED;
+	}
+
+	cv::remap(colorImage, registeredColorImage, m_UV, cv::Mat(), cv::INTER_NEAREST,
+		cv::BORDER_CONSTANT, cv::Scalar(0, 0, 0));
+	return RET_OK;
+}
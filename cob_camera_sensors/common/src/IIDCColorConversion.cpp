@@ -0,0 +1,267 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cob_vision_utils/StdAfx.h>
+
+#ifdef __LINUX__
+#include "cob_camera_sensors/IIDCColorConversion.h"
+#else
+#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/IIDCColorConversion.h"
+#endif
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <iostream>
+
+using namespace ipa_CameraSensors;
+
+namespace
+{
+	inline unsigned char Clamp(int value)
+	{
+		return (unsigned char) (value < 0 ? 0 : (value > 255 ? 255 : value));
+	}
+
+	/// ITU-R BT.601 conversion in 10 bit fixed point, as used by libdc1394.
+	/// u and v are centered around 0.
+	inline void YUVToBGR(int y, int u, int v, unsigned char* bgr)
+	{
+		bgr[0] = Clamp(y + ((1814*u) >> 10));
+		bgr[1] = Clamp(y - ((352*u + 731*v) >> 10));
+		bgr[2] = Clamp(y + ((1436*v) >> 10));
+	}
+
+	/// Checks the arguments and creates the destination image.
+	unsigned long PrepareDestination(const char* function, const unsigned char* src,
+		int width, int height, int downscale, cv::Mat& dst)
+	{
+		if (src == 0 || width <= 0 || height <= 0)
+		{
+			std::cerr << "ERROR - " << function << ":" << std::endl;
+			std::cerr << "\t ... Source image is empty." << std::endl;
+			return RET_FAILED;
+		}
+		if (downscale != 1 && downscale != 2)
+		{
+			std::cerr << "ERROR - " << function << ":" << std::endl;
+			std::cerr << "\t ... Downscale factor " << downscale << " not supported, use 1 or 2." << std::endl;
+			return RET_FAILED;
+		}
+		dst.create(height/downscale, width/downscale, CV_8UC3);
+		return RET_OK;
+	}
+}
+
+unsigned long ipa_CameraSensors::ConvertRGB8ToBGR(const unsigned char* src, int srcStep,
+	int width, int height, int downscale, cv::Mat& dst)
+{
+	if (PrepareDestination("ConvertRGB8ToBGR", src, width, height, downscale, dst) & RET_FAILED)
+	{
+		return RET_FAILED;
+	}
+
+	for (int row=0; row<dst.rows; row++)
+	{
+		const unsigned char* s0 = src + row*downscale*srcStep;
+		unsigned char* d = dst.ptr<unsigned char>(row);
+		if (downscale == 1)
+		{
+			for (int col=0; col<dst.cols; col++, s0+=3, d+=3)
+			{
+				d[0] = s0[2];
+				d[1] = s0[1];
+				d[2] = s0[0];
+			}
+		}
+		else
+		{
+			const unsigned char* s1 = s0 + srcStep;
+			for (int col=0; col<dst.cols; col++, s0+=6, s1+=6, d+=3)
+			{
+				d[0] = (unsigned char) ((s0[2] + s0[5] + s1[2] + s1[5] + 2) >> 2);
+				d[1] = (unsigned char) ((s0[1] + s0[4] + s1[1] + s1[4] + 2) >> 2);
+				d[2] = (unsigned char) ((s0[0] + s0[3] + s1[0] + s1[3] + 2) >> 2);
+			}
+		}
+	}
+	return RET_OK;
+}
+
+unsigned long ipa_CameraSensors::ConvertYUV422ToBGR(const unsigned char* src, int srcStep,
+	int width, int height, int downscale, cv::Mat& dst)
+{
+	if (PrepareDestination("ConvertYUV422ToBGR", src, width, height, downscale, dst) & RET_FAILED)
+	{
+		return RET_FAILED;
+	}
+
+	// Each macro pixel (u,y0,v,y1) holds 2 pixels
+	int macroPixels = width/2;
+	for (int row=0; row<dst.rows; row++)
+	{
+		const unsigned char* s0 = src + row*downscale*srcStep;
+		unsigned char* d = dst.ptr<unsigned char>(row);
+		if (downscale == 1)
+		{
+			for (int i=0; i<macroPixels; i++, s0+=4, d+=6)
+			{
+				int u = s0[0] - 128;
+				int v = s0[2] - 128;
+				YUVToBGR(s0[1], u, v, d);
+				YUVToBGR(s0[3], u, v, d+3);
+			}
+		}
+		else
+		{
+			// One output pixel per macro pixel and row pair
+			const unsigned char* s1 = s0 + srcStep;
+			for (int i=0; i<macroPixels; i++, s0+=4, s1+=4, d+=3)
+			{
+				int y = (s0[1] + s0[3] + s1[1] + s1[3] + 2) >> 2;
+				int u = ((s0[0] + s1[0] + 1) >> 1) - 128;
+				int v = ((s0[2] + s1[2] + 1) >> 1) - 128;
+				YUVToBGR(y, u, v, d);
+			}
+		}
+	}
+	return RET_OK;
+}
+
+unsigned long ipa_CameraSensors::ConvertYUV411ToBGR(const unsigned char* src, int srcStep,
+	int width, int height, int downscale, cv::Mat& dst)
+{
+	if (PrepareDestination("ConvertYUV411ToBGR", src, width, height, downscale, dst) & RET_FAILED)
+	{
+		return RET_FAILED;
+	}
+
+	// Each macro pixel (u,y0,y1,v,y2,y3) holds 4 pixels
+	int macroPixels = width/4;
+	for (int row=0; row<dst.rows; row++)
+	{
+		const unsigned char* s0 = src + row*downscale*srcStep;
+		unsigned char* d = dst.ptr<unsigned char>(row);
+		if (downscale == 1)
+		{
+			for (int i=0; i<macroPixels; i++, s0+=6, d+=12)
+			{
+				int u = s0[0] - 128;
+				int v = s0[3] - 128;
+				YUVToBGR(s0[1], u, v, d);
+				YUVToBGR(s0[2], u, v, d+3);
+				YUVToBGR(s0[4], u, v, d+6);
+				YUVToBGR(s0[5], u, v, d+9);
+			}
+		}
+		else
+		{
+			// Two output pixels per macro pixel and row pair
+			const unsigned char* s1 = s0 + srcStep;
+			for (int i=0; i<macroPixels; i++, s0+=6, s1+=6, d+=6)
+			{
+				int u = ((s0[0] + s1[0] + 1) >> 1) - 128;
+				int v = ((s0[3] + s1[3] + 1) >> 1) - 128;
+				YUVToBGR((s0[1] + s0[2] + s1[1] + s1[2] + 2) >> 2, u, v, d);
+				YUVToBGR((s0[4] + s0[5] + s1[4] + s1[5] + 2) >> 2, u, v, d+3);
+			}
+		}
+	}
+	return RET_OK;
+}
+
+unsigned long ipa_CameraSensors::ConvertMono8ToBGR(const unsigned char* src, int srcStep,
+	int width, int height, int downscale, cv::Mat& dst)
+{
+	if (PrepareDestination("ConvertMono8ToBGR", src, width, height, downscale, dst) & RET_FAILED)
+	{
+		return RET_FAILED;
+	}
+
+	for (int row=0; row<dst.rows; row++)
+	{
+		const unsigned char* s0 = src + row*downscale*srcStep;
+		unsigned char* d = dst.ptr<unsigned char>(row);
+		if (downscale == 1)
+		{
+			for (int col=0; col<dst.cols; col++, d+=3)
+			{
+				d[0] = d[1] = d[2] = s0[col];
+			}
+		}
+		else
+		{
+			const unsigned char* s1 = s0 + srcStep;
+			for (int col=0; col<dst.cols; col++, s0+=2, s1+=2, d+=3)
+			{
+				d[0] = d[1] = d[2] = (unsigned char) ((s0[0] + s0[1] + s1[0] + s1[1] + 2) >> 2);
+			}
+		}
+	}
+	return RET_OK;
+}
+
+unsigned long ipa_CameraSensors::ConvertBayer8ToBGR(const unsigned char* src, int srcStep,
+	int width, int height, t_BayerPattern pattern, int downscale, cv::Mat& dst)
+{
+	if (PrepareDestination("ConvertBayer8ToBGR", src, width, height, downscale, dst) & RET_FAILED)
+	{
+		return RET_FAILED;
+	}
+
+	if (downscale == 1)
+	{
+		// OpenCV names the patterns after the second row and column
+		int code = CV_BayerBG2BGR;
+		switch (pattern)
+		{
+			case BAYER_RGGB: code = CV_BayerBG2BGR; break;
+			case BAYER_GBRG: code = CV_BayerGR2BGR; break;
+			case BAYER_GRBG: code = CV_BayerGB2BGR; break;
+			case BAYER_BGGR: code = CV_BayerRG2BGR; break;
+		}
+		cv::Mat raw(height, width, CV_8UC1, const_cast<unsigned char*>(src), srcStep);
+		cv::cvtColor(raw, dst, code);
+		return RET_OK;
+	}
+
+	// Offsets of the red and blue pixel within a 2x2 block, the others are green
+	int redRow = 0, redCol = 0;
+	switch (pattern)
+	{
+		case BAYER_RGGB: redRow = 0; redCol = 0; break;
+		case BAYER_GBRG: redRow = 1; redCol = 0; break;
+		case BAYER_GRBG: redRow = 0; redCol = 1; break;
+		case BAYER_BGGR: redRow = 1; redCol = 1; break;
+	}
+	int redOffset = redRow*srcStep + redCol;
+	int blueOffset = (1-redRow)*srcStep + (1-redCol);
+	int green1Offset = redRow*srcStep + (1-redCol);
+	int green2Offset = (1-redRow)*srcStep + redCol;
+
+	for (int row=0; row<dst.rows; row++)
+	{
+		const unsigned char* s = src + 2*row*srcStep;
+		unsigned char* d = dst.ptr<unsigned char>(row);
+		for (int col=0; col<dst.cols; col++, s+=2, d+=3)
+		{
+			d[0] = s[blueOffset];
+			d[1] = (unsigned char) ((s[green1Offset] + s[green2Offset] + 1) >> 1);
+			d[2] = s[redOffset];
+		}
+	}
+	return RET_OK;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cob_vision_utils/StdAfx.h>
+
+#ifdef __LINUX__
+#include "cob_camera_sensors/ImageEncoder.h"
+#else
+#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/ImageEncoder.h"
+#endif
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include <algorithm>
+
+using namespace ipa_CameraSensors;
+
+ImageEncoder::ImageEncoder()
+{
+	m_MinInterval = 0;
+	m_Pending = false;
+	m_Timestamp = 0;
+	m_LastTimestamp = 0;
+	m_Stop = false;
+}
+
+ImageEncoder::~ImageEncoder()
+{
+	Stop();
+}
+
+unsigned long ImageEncoder::Start(t_EncodedFunction encodedFunction, const std::string& format, int quality, double maxRate)
+{
+	Stop();
+
+	m_Parameters.clear();
+	if (format == "jpeg")
+	{
+		m_Extension = ".jpg";
+		m_Parameters.push_back(CV_IMWRITE_JPEG_QUALITY);
+		m_Parameters.push_back(std::max(0, std::min(quality, 100)));
+	}
+	else if (format == "png")
+	{
+		m_Extension = ".png";
+		m_Parameters.push_back(CV_IMWRITE_PNG_COMPRESSION);
+		m_Parameters.push_back(std::max(0, std::min(quality, 9)));
+	}
+	else
+	{
+		std::cerr << "ERROR - ImageEncoder::Start:" << std::endl;
+		std::cerr << "\t ... Format '" << format << "' unknown, try 'jpeg' or 'png'." << std::endl;
+		return RET_FAILED;
+	}
+
+	m_EncodedFunction = encodedFunction;
+	m_MinInterval = (maxRate > 0) ? 1.0/maxRate : 0;
+	m_Pending = false;
+	m_LastTimestamp = 0;
+	m_Stop = false;
+	m_Encoder.reset(new boost::thread(&ImageEncoder::EncoderThread, this));
+
+	return RET_OK;
+}
+
+void ImageEncoder::Stop()
+{
+	if (!isRunning())
+	{
+		return;
+	}
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_ImageAvailable.notify_one();
+	m_Encoder->join();
+	m_Encoder.reset();
+
+	m_Pending = false;
+	m_Image = cv::Mat();
+	m_Owner.reset();
+}
+
+bool ImageEncoder::Submit(const cv::Mat& image, double timestamp, const boost::shared_ptr<const void>& owner)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	// Timestamps running backwards e.g. after a restart of a simulation are not limited
+	if (!isRunning() || (timestamp >= m_LastTimestamp && timestamp - m_LastTimestamp < m_MinInterval))
+	{
+		return false;
+	}
+
+	// Replaces an image the encoder has not started yet
+	m_Image = image;
+	m_Timestamp = timestamp;
+	m_Owner = owner;
+	m_Pending = true;
+	m_LastTimestamp = timestamp;
+	lock.unlock();
+
+	m_ImageAvailable.notify_one();
+	return true;
+}
+
+void ImageEncoder::EncoderThread()
+{
+	std::vector<unsigned char> data;
+	while (true)
+	{
+		cv::Mat image;
+		double timestamp = 0;
+		boost::shared_ptr<const void> owner;
+		{
+			boost::mutex::scoped_lock lock(m_Mutex);
+			while (!m_Pending && !m_Stop)
+			{
+				m_ImageAvailable.wait(lock);
+			}
+			if (m_Stop)
+			{
+				return;
+			}
+			image = m_Image;
+			timestamp = m_Timestamp;
+			owner.swap(m_Owner);
+			m_Image = cv::Mat();
+			m_Pending = false;
+		}
+
+		if (!cv::imencode(m_Extension, image, data, m_Parameters))
+		{
+			std::cerr << "ERROR - ImageEncoder::EncoderThread:" << std::endl;
+			std::cerr << "\t ... Encoding image failed." << std::endl;
+			continue;
+		}
+		// Release the image data before the encoded function may take its time
+		image = cv::Mat();
+		owner.reset();
+
+		m_EncodedFunction(data, timestamp);
+	}
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cob_vision_utils/StdAfx.h>
+
+#ifdef __LINUX__
+#include "cob_camera_sensors/ImagePrefetcher.h"
+#else
+#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/ImagePrefetcher.h"
+#endif
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+using namespace ipa_CameraSensors;
+
+ImagePrefetcher::ImagePrefetcher()
+{
+	m_NumberOfImages = 0;
+	m_Depth = 0;
+	m_NextIndex = 0;
+	m_Stop = false;
+}
+
+ImagePrefetcher::~ImagePrefetcher()
+{
+	Stop();
+}
+
+unsigned long ImagePrefetcher::Start(t_LoadFunction loadFunction, int numberOfImages, int depth, int numberOfThreads)
+{
+	Stop();
+
+	if (numberOfImages <= 0 || depth <= 0 || numberOfThreads <= 0)
+	{
+		std::cerr << "ERROR - ImagePrefetcher::Start:" << std::endl;
+		std::cerr << "\t ... Number of images, depth and number of threads must be positive." << std::endl;
+		return RET_FAILED;
+	}
+
+	m_LoadFunction = loadFunction;
+	m_NumberOfImages = numberOfImages;
+	// Loading the same frame twice at a time is useless
+	m_Depth = std::min(depth, numberOfImages);
+	m_Stop = false;
+
+	for (int i=0; i<numberOfThreads; i++)
+	{
+		m_Workers.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&ImagePrefetcher::WorkerThread, this))));
+	}
+	return RET_OK;
+}
+
+void ImagePrefetcher::Stop()
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Stop = true;
+		m_Slots.clear();
+		m_Jobs.clear();
+	}
+	m_JobAvailable.notify_all();
+
+	for (unsigned int i=0; i<m_Workers.size(); i++)
+	{
+		m_Workers[i]->join();
+	}
+	m_Workers.clear();
+}
+
+unsigned long ImagePrefetcher::GetImages(int index, std::vector<cv::Mat>& images)
+{
+	if (!isRunning())
+	{
+		return RET_FAILED;
+	}
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+	if (m_Slots.empty() || m_Slots.front()->index != index)
+	{
+		Restart(index);
+	}
+
+	t_SlotPtr slot = m_Slots.front();
+	while (!slot->ready)
+	{
+		m_SlotReady.wait(lock);
+	}
+	m_Slots.pop_front();
+	Schedule();
+
+	images.swap(slot->images);
+	return slot->result;
+}
+
+void ImagePrefetcher::Restart(int index)
+{
+	m_Slots.clear();
+	m_Jobs.clear();
+	m_NextIndex = index % m_NumberOfImages;
+	for (int i=0; i<m_Depth; i++)
+	{
+		Schedule();
+	}
+}
+
+void ImagePrefetcher::Schedule()
+{
+	t_SlotPtr slot(new t_Slot);
+	slot->index = m_NextIndex;
+	slot->ready = false;
+	slot->result = RET_FAILED;
+	m_Slots.push_back(slot);
+	m_Jobs.push_back(slot);
+	m_NextIndex = (m_NextIndex + 1) % m_NumberOfImages;
+	m_JobAvailable.notify_one();
+}
+
+void ImagePrefetcher::WorkerThread()
+{
+	while (true)
+	{
+		t_SlotPtr slot;
+		{
+			boost::mutex::scoped_lock lock(m_Mutex);
+			while (!m_Stop && m_Jobs.empty())
+			{
+				m_JobAvailable.wait(lock);
+			}
+			if (m_Stop)
+			{
+				return;
+			}
+			slot = m_Jobs.front();
+			m_Jobs.pop_front();
+		}
+
+		// Load without the lock, the consumer does not touch the slot before it is marked ready
+		std::vector<cv::Mat> images;
+		unsigned long result = m_LoadFunction(slot->index, images);
+
+		{
+			boost::mutex::scoped_lock lock(m_Mutex);
+			slot->images.swap(images);
+			slot->result = result;
+			slot->ready = true;
+		}
+		m_SlotReady.notify_all();
+	}
+}
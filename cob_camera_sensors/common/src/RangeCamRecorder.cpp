@@ -0,0 +1,212 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cob_vision_utils/StdAfx.h>
+
+#ifdef __LINUX__
+#include "cob_camera_sensors/RangeCamRecorder.h"
+#else
+#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/RangeCamRecorder.h"
+#endif
+
+#include <iomanip>
+
+using namespace ipa_CameraSensors;
+
+RangeCamRecorder::RangeCamRecorder()
+{
+	for (int stream=0; stream<REPLAY_NUM_STREAMS; stream++)
+	{
+		m_Types[stream] = -1;
+	}
+	m_Stop = false;
+	m_WriteFailed = false;
+	m_DroppedFrames = 0;
+}
+
+RangeCamRecorder::~RangeCamRecorder()
+{
+	Stop();
+}
+
+unsigned long RangeCamRecorder::Start(const std::string& filename, int width, int height, const int* types, int numberOfSlots)
+{
+	Stop();
+
+	if (numberOfSlots < 1)
+	{
+		std::cerr << "ERROR - RangeCamRecorder::Start:" << std::endl;
+		std::cerr << "\t ... At least one slot is required." << std::endl;
+		return RET_FAILED;
+	}
+
+	if (m_File.Open(filename, width, height, types) & RET_FAILED)
+	{
+		std::cerr << "ERROR - RangeCamRecorder::Start:" << std::endl;
+		std::cerr << "\t ... Could not create replay file '" << filename << "'." << std::endl;
+		return RET_FAILED;
+	}
+
+	std::string stampFilename = filename + ".stamps";
+	m_StampFile.open(stampFilename.c_str(), std::ios::out | std::ios::trunc);
+	if (!m_StampFile.is_open())
+	{
+		std::cerr << "ERROR - RangeCamRecorder::Start:" << std::endl;
+		std::cerr << "\t ... Could not create file '" << stampFilename << "'." << std::endl;
+		m_File.Close();
+		return (RET_FAILED | RET_FAILED_OPEN_FILE);
+	}
+	m_StampFile << std::fixed << std::setprecision(6);
+
+	// Allocate all buffers now, Record() only copies into them
+	m_Slots.assign(numberOfSlots, t_Slot());
+	m_Free.clear();
+	m_Queued.clear();
+	for (int i=0; i<numberOfSlots; i++)
+	{
+		for (int stream=0; stream<REPLAY_NUM_STREAMS; stream++)
+		{
+			if (types[stream] != -1)
+			{
+				m_Slots[i].frames[stream].create(height, width, types[stream]);
+			}
+		}
+		m_Free.push_back(&m_Slots[i]);
+	}
+
+	for (int stream=0; stream<REPLAY_NUM_STREAMS; stream++)
+	{
+		m_Types[stream] = types[stream];
+	}
+	m_Stop = false;
+	m_WriteFailed = false;
+	m_DroppedFrames = 0;
+	m_Writer.reset(new boost::thread(&RangeCamRecorder::WriterThread, this));
+
+	return RET_OK;
+}
+
+unsigned long RangeCamRecorder::Stop()
+{
+	if (!isRunning())
+	{
+		return RET_OK;
+	}
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_FrameAvailable.notify_one();
+	m_Writer->join();
+	m_Writer.reset();
+
+	bool failed = m_WriteFailed;
+	if (m_File.Close() & RET_FAILED)
+	{
+		failed = true;
+	}
+	m_StampFile.close();
+
+	m_Free.clear();
+	m_Queued.clear();
+	m_Slots.clear();
+
+	if (m_DroppedFrames > 0)
+	{
+		std::cout << "INFO - RangeCamRecorder::Stop:" << std::endl;
+		std::cout << "\t ... Dropped " << m_DroppedFrames << " frames during recording" << std::endl;
+	}
+
+	return failed ? RET_FAILED : RET_OK;
+}
+
+unsigned long RangeCamRecorder::Record(const cv::Mat* frames, const t_FrameInfo& frameInfo)
+{
+	t_Slot* slot = 0;
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		if (!isRunning() || m_WriteFailed)
+		{
+			return RET_FAILED;
+		}
+		if (m_Free.empty())
+		{
+			m_DroppedFrames++;
+			return RET_FAILED;
+		}
+		slot = m_Free.front();
+		m_Free.pop_front();
+	}
+
+	// The slot is owned by the caller until it is queued
+	for (int stream=0; stream<REPLAY_NUM_STREAMS; stream++)
+	{
+		if (m_Types[stream] != -1)
+		{
+			frames[stream].copyTo(slot->frames[stream]);
+		}
+	}
+	slot->frameInfo = frameInfo;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Queued.push_back(slot);
+	}
+	m_FrameAvailable.notify_one();
+
+	return RET_OK;
+}
+
+void RangeCamRecorder::WriterThread()
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	while (true)
+	{
+		while (m_Queued.empty() && !m_Stop)
+		{
+			m_FrameAvailable.wait(lock);
+		}
+		// Queued frames are written before stopping
+		if (m_Queued.empty())
+		{
+			return;
+		}
+		t_Slot* slot = m_Queued.front();
+		m_Queued.pop_front();
+		bool writeFailed = m_WriteFailed;
+		lock.unlock();
+
+		if (!writeFailed)
+		{
+			if (m_File.AppendFrame(slot->frames) & RET_FAILED)
+			{
+				std::cerr << "ERROR - RangeCamRecorder::WriterThread:" << std::endl;
+				std::cerr << "\t ... Writing frame " << slot->frameInfo.sequenceNumber << " failed, recording stopped." << std::endl;
+				writeFailed = true;
+			}
+			else
+			{
+				m_StampFile << slot->frameInfo.sequenceNumber << " " << slot->frameInfo.timestamp << "\n";
+			}
+		}
+
+		lock.lock();
+		m_WriteFailed = writeFailed;
+		m_Free.push_back(slot);
+	}
+}
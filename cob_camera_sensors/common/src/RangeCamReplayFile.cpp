@@ -0,0 +1,263 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cob_vision_utils/StdAfx.h>
+
+#ifdef __LINUX__
+#include "cob_camera_sensors/RangeCamReplayFile.h"
+#else
+#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/RangeCamReplayFile.h"
+#endif
+
+#include <string.h>
+
+#include <boost/interprocess/exceptions.hpp>
+
+namespace bip = boost::interprocess;
+using namespace ipa_CameraSensors;
+
+namespace
+{
+	/// Number of bytes of one frame of the given type.
+	boost::uint64_t FrameSize(int width, int height, int type)
+	{
+		return (boost::uint64_t)width * height * CV_ELEM_SIZE(type);
+	}
+}
+
+RangeCamReplayFile::RangeCamReplayFile()
+{
+	memset(&m_Header, 0, sizeof(m_Header));
+	m_Index = 0;
+}
+
+RangeCamReplayFile::~RangeCamReplayFile()
+{
+	Close();
+}
+
+unsigned long RangeCamReplayFile::Open(const std::string& filename)
+{
+	Close();
+
+	try
+	{
+		m_Mapping.reset(new bip::file_mapping(filename.c_str(), bip::read_only));
+		m_Region.reset(new bip::mapped_region(*m_Mapping, bip::read_only));
+	}
+	catch (const bip::interprocess_exception& ex)
+	{
+		std::cerr << "ERROR - RangeCamReplayFile::Open:" << std::endl;
+		std::cerr << "\t ... Could not map file '" << filename << "': " << ex.what() << std::endl;
+		Close();
+		return (RET_FAILED | RET_FAILED_OPEN_FILE);
+	}
+
+	const char* data = (const char*) m_Region->get_address();
+	boost::uint64_t fileSize = m_Region->get_size();
+
+	if (fileSize < sizeof(t_ReplayFileHeader))
+	{
+		std::cerr << "ERROR - RangeCamReplayFile::Open:" << std::endl;
+		std::cerr << "\t ... File '" << filename << "' is too short." << std::endl;
+		Close();
+		return RET_FAILED;
+	}
+	memcpy(&m_Header, data, sizeof(t_ReplayFileHeader));
+
+	if (memcmp(m_Header.magic, c_ReplayMagic, sizeof(c_ReplayMagic)) != 0 || m_Header.version != c_ReplayVersion)
+	{
+		std::cerr << "ERROR - RangeCamReplayFile::Open:" << std::endl;
+		std::cerr << "\t ... File '" << filename << "' is no replay file of version " << c_ReplayVersion << "." << std::endl;
+		Close();
+		return RET_FAILED;
+	}
+
+	boost::uint64_t indexSize = (boost::uint64_t)m_Header.numberOfFrames * REPLAY_NUM_STREAMS * sizeof(boost::uint64_t);
+	if (m_Header.width <= 0 || m_Header.height <= 0 || m_Header.numberOfFrames < 0 ||
+		m_Header.indexOffset % sizeof(boost::uint64_t) != 0 || m_Header.indexOffset + indexSize > fileSize)
+	{
+		std::cerr << "ERROR - RangeCamReplayFile::Open:" << std::endl;
+		std::cerr << "\t ... Header of file '" << filename << "' is corrupt." << std::endl;
+		Close();
+		return RET_FAILED;
+	}
+	m_Index = (const boost::uint64_t*) (data + m_Header.indexOffset);
+
+	// Check every index entry once, so GetFrame() only has to check the arguments
+	for (int stream=0; stream<REPLAY_NUM_STREAMS; stream++)
+	{
+		if (m_Header.types[stream] == -1)
+		{
+			continue;
+		}
+
+		boost::uint64_t frameSize = FrameSize(m_Header.width, m_Header.height, m_Header.types[stream]);
+		for (int i=0; i<m_Header.numberOfFrames; i++)
+		{
+			boost::uint64_t offset = m_Index[i*REPLAY_NUM_STREAMS + stream];
+			if (offset < sizeof(t_ReplayFileHeader) || offset + frameSize > m_Header.indexOffset)
+			{
+				std::cerr << "ERROR - RangeCamReplayFile::Open:" << std::endl;
+				std::cerr << "\t ... Index of file '" << filename << "' is corrupt." << std::endl;
+				Close();
+				return RET_FAILED;
+			}
+		}
+	}
+
+	return RET_OK;
+}
+
+unsigned long RangeCamReplayFile::Close()
+{
+	m_Region.reset();
+	m_Mapping.reset();
+	m_Index = 0;
+	memset(&m_Header, 0, sizeof(m_Header));
+	return RET_OK;
+}
+
+unsigned long RangeCamReplayFile::GetFrame(t_ReplayStream stream, int index, cv::Mat& frame)
+{
+	if (!isOpen() || stream < 0 || stream >= REPLAY_NUM_STREAMS || m_Header.types[stream] == -1 ||
+		index < 0 || index >= m_Header.numberOfFrames)
+	{
+		std::cerr << "ERROR - RangeCamReplayFile::GetFrame:" << std::endl;
+		std::cerr << "\t ... Frame " << index << " of stream " << stream << " not available." << std::endl;
+		return RET_FAILED;
+	}
+
+	char* data = (char*) m_Region->get_address() + m_Index[index*REPLAY_NUM_STREAMS + stream];
+	frame = cv::Mat(m_Header.height, m_Header.width, m_Header.types[stream], data);
+	return RET_OK;
+}
+
+
+RangeCamReplayFileWriter::RangeCamReplayFileWriter()
+{
+	memset(&m_Header, 0, sizeof(m_Header));
+}
+
+RangeCamReplayFileWriter::~RangeCamReplayFileWriter()
+{
+	if (m_File.is_open())
+	{
+		Close();
+	}
+}
+
+unsigned long RangeCamReplayFileWriter::Open(const std::string& filename, int width, int height, const int* types)
+{
+	m_File.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!m_File.is_open())
+	{
+		std::cerr << "ERROR - RangeCamReplayFileWriter::Open:" << std::endl;
+		std::cerr << "\t ... Could not create file '" << filename << "'." << std::endl;
+		return (RET_FAILED | RET_FAILED_OPEN_FILE);
+	}
+
+	memset(&m_Header, 0, sizeof(m_Header));
+	memcpy(m_Header.magic, c_ReplayMagic, sizeof(c_ReplayMagic));
+	m_Header.version = c_ReplayVersion;
+	m_Header.width = width;
+	m_Header.height = height;
+	m_Header.numberOfFrames = 0;
+	for (int stream=0; stream<REPLAY_NUM_STREAMS; stream++)
+	{
+		m_Header.types[stream] = types[stream];
+	}
+	m_Index.clear();
+
+	// Rewritten with the final frame count and index offset by Close()
+	m_File.write((const char*) &m_Header, sizeof(m_Header));
+	return m_File.good() ? RET_OK : RET_FAILED;
+}
+
+unsigned long RangeCamReplayFileWriter::WritePadding()
+{
+	static const char zeros[c_ReplayAlignment] = {0};
+	size_t remainder = (size_t) m_File.tellp() % c_ReplayAlignment;
+	if (remainder != 0)
+	{
+		m_File.write(zeros, c_ReplayAlignment - remainder);
+	}
+	return m_File.good() ? RET_OK : RET_FAILED;
+}
+
+unsigned long RangeCamReplayFileWriter::AppendFrame(const cv::Mat* frames)
+{
+	if (!m_File.is_open())
+	{
+		return RET_FAILED;
+	}
+
+	for (int stream=0; stream<REPLAY_NUM_STREAMS; stream++)
+	{
+		if (m_Header.types[stream] == -1)
+		{
+			m_Index.push_back(0);
+			continue;
+		}
+
+		const cv::Mat& frame = frames[stream];
+		if (frame.rows != m_Header.height || frame.cols != m_Header.width || frame.type() != m_Header.types[stream])
+		{
+			std::cerr << "ERROR - RangeCamReplayFileWriter::AppendFrame:" << std::endl;
+			std::cerr << "\t ... Image of stream " << stream << " does not match size or type of the file." << std::endl;
+			return RET_FAILED;
+		}
+
+		WritePadding();
+		m_Index.push_back((boost::uint64_t) m_File.tellp());
+		size_t rowSize = frame.cols * frame.elemSize();
+		for (int row=0; row<frame.rows; row++)
+		{
+			m_File.write((const char*) frame.ptr(row), rowSize);
+		}
+	}
+	m_Header.numberOfFrames++;
+
+	return m_File.good() ? RET_OK : RET_FAILED;
+}
+
+unsigned long RangeCamReplayFileWriter::Close()
+{
+	if (!m_File.is_open())
+	{
+		return RET_OK;
+	}
+
+	WritePadding();
+	m_Header.indexOffset = (boost::uint64_t) m_File.tellp();
+	if (!m_Index.empty())
+	{
+		m_File.write((const char*) &m_Index[0], m_Index.size() * sizeof(boost::uint64_t));
+	}
+	m_File.seekp(0);
+	m_File.write((const char*) &m_Header, sizeof(m_Header));
+
+	bool good = m_File.good();
+	m_File.close();
+	if (!good)
+	{
+		std::cerr << "ERROR - RangeCamReplayFileWriter::Close:" << std::endl;
+		std::cerr << "\t ... Writing the replay file failed." << std::endl;
+		return RET_FAILED;
+	}
+	return RET_OK;
+}
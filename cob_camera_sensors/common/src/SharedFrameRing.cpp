@@ -0,0 +1,255 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cob_vision_utils/StdAfx.h>
+
+#ifdef __LINUX__
+#include "cob_camera_sensors/SharedFrameRing.h"
+#else
+#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/SharedFrameRing.h"
+#endif
+
+#include <string.h>
+
+#include <boost/interprocess/exceptions.hpp>
+
+namespace bip = boost::interprocess;
+using namespace ipa_CameraSensors;
+
+namespace
+{
+	const char c_SharedFrameMagic[8] = {'I', 'P', 'A', 'S', 'H', 'M', 'F', 'R'};
+	const boost::uint32_t c_SharedFrameVersion = 1;
+	const boost::uint64_t c_SharedFrameAlignment = 64;
+
+	boost::uint64_t Align(boost::uint64_t size)
+	{
+		return (size + c_SharedFrameAlignment - 1) / c_SharedFrameAlignment * c_SharedFrameAlignment;
+	}
+
+	/// Orders the slot descriptor against the image data for readers in other processes.
+	inline void FrameBarrier()
+	{
+#ifdef __LINUX__
+		__sync_synchronize();
+#else
+		MemoryBarrier();
+#endif
+	}
+}
+
+SharedFrameRing::SharedFrameRing()
+{
+	m_IsCreator = false;
+	m_NextSequenceNumber = 1;
+	m_Header = 0;
+}
+
+SharedFrameRing::~SharedFrameRing()
+{
+	Close();
+}
+
+unsigned long SharedFrameRing::Create(const std::string& name, int width, int height, int numberOfStreams, const int* types, int numberOfSlots)
+{
+	Close();
+
+	if (width <= 0 || height <= 0 || numberOfStreams < 1 || numberOfStreams > c_SharedFrameMaxStreams || numberOfSlots < 2)
+	{
+		std::cerr << "ERROR - SharedFrameRing::Create:" << std::endl;
+		std::cerr << "\t ... Invalid image size, number of streams or number of slots." << std::endl;
+		return RET_FAILED;
+	}
+
+	t_SharedFrameRingHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, c_SharedFrameMagic, sizeof(c_SharedFrameMagic));
+	header.version = c_SharedFrameVersion;
+	header.width = width;
+	header.height = height;
+	header.numberOfSlots = numberOfSlots;
+	header.numberOfStreams = numberOfStreams;
+	boost::uint64_t offset = Align(sizeof(t_SharedFrameSlot));
+	for (int stream=0; stream<numberOfStreams; stream++)
+	{
+		header.types[stream] = types[stream];
+		header.streamOffsets[stream] = offset;
+		offset = Align(offset + (boost::uint64_t)width * height * CV_ELEM_SIZE(types[stream]));
+	}
+	header.slotSize = offset;
+	boost::uint64_t size = Align(sizeof(t_SharedFrameRingHeader)) + header.slotSize * numberOfSlots;
+
+	try
+	{
+		// Left over by a writer that has not been shut down properly
+		bip::shared_memory_object::remove(name.c_str());
+		m_SharedMemory.reset(new bip::shared_memory_object(bip::create_only, name.c_str(), bip::read_write));
+		m_IsCreator = true;
+		m_SharedMemory->truncate(size);
+		m_Region.reset(new bip::mapped_region(*m_SharedMemory, bip::read_write));
+	}
+	catch (const bip::interprocess_exception& ex)
+	{
+		std::cerr << "ERROR - SharedFrameRing::Create:" << std::endl;
+		std::cerr << "\t ... Could not create shared memory '" << name << "': " << ex.what() << std::endl;
+		m_Name = name;
+		Close();
+		return RET_FAILED;
+	}
+
+	m_Name = name;
+	m_NextSequenceNumber = 1;
+	memset(m_Region->get_address(), 0, size);
+	m_Header = (t_SharedFrameRingHeader*) m_Region->get_address();
+	*m_Header = header;
+
+	return RET_OK;
+}
+
+unsigned long SharedFrameRing::Open(const std::string& name)
+{
+	Close();
+
+	try
+	{
+		m_SharedMemory.reset(new bip::shared_memory_object(bip::open_only, name.c_str(), bip::read_only));
+		m_Region.reset(new bip::mapped_region(*m_SharedMemory, bip::read_only));
+	}
+	catch (const bip::interprocess_exception& ex)
+	{
+		std::cerr << "ERROR - SharedFrameRing::Open:" << std::endl;
+		std::cerr << "\t ... Could not map shared memory '" << name << "': " << ex.what() << std::endl;
+		Close();
+		return RET_FAILED;
+	}
+
+	m_Name = name;
+	m_Header = (t_SharedFrameRingHeader*) m_Region->get_address();
+	boost::uint64_t size = m_Region->get_size();
+	if (size < sizeof(t_SharedFrameRingHeader) ||
+		memcmp(m_Header->magic, c_SharedFrameMagic, sizeof(c_SharedFrameMagic)) != 0 ||
+		m_Header->version != c_SharedFrameVersion ||
+		m_Header->numberOfStreams < 1 || m_Header->numberOfStreams > c_SharedFrameMaxStreams ||
+		m_Header->numberOfSlots < 2 ||
+		Align(sizeof(t_SharedFrameRingHeader)) + m_Header->slotSize * m_Header->numberOfSlots > size)
+	{
+		std::cerr << "ERROR - SharedFrameRing::Open:" << std::endl;
+		std::cerr << "\t ... Shared memory '" << name << "' holds no frame ring of version " << c_SharedFrameVersion << "." << std::endl;
+		Close();
+		return RET_FAILED;
+	}
+
+	return RET_OK;
+}
+
+unsigned long SharedFrameRing::Close()
+{
+	m_Region.reset();
+	m_SharedMemory.reset();
+	m_Header = 0;
+	if (m_IsCreator)
+	{
+		bip::shared_memory_object::remove(m_Name.c_str());
+		m_IsCreator = false;
+	}
+	m_Name.clear();
+	return RET_OK;
+}
+
+t_SharedFrameSlot* SharedFrameRing::GetSlot(int slot)
+{
+	char* data = (char*) m_Region->get_address() + Align(sizeof(t_SharedFrameRingHeader));
+	return (t_SharedFrameSlot*) (data + slot * m_Header->slotSize);
+}
+
+unsigned long SharedFrameRing::Write(const cv::Mat* frames, const t_FrameInfo& frameInfo, int& slot, boost::uint64_t& sequenceNumber)
+{
+	if (!isOpen() || !m_IsCreator)
+	{
+		std::cerr << "ERROR - SharedFrameRing::Write:" << std::endl;
+		std::cerr << "\t ... Shared memory not created by this instance." << std::endl;
+		return RET_FAILED;
+	}
+
+	for (int stream=0; stream<m_Header->numberOfStreams; stream++)
+	{
+		if (frames[stream].rows != m_Header->height || frames[stream].cols != m_Header->width ||
+			frames[stream].type() != m_Header->types[stream])
+		{
+			std::cerr << "ERROR - SharedFrameRing::Write:" << std::endl;
+			std::cerr << "\t ... Image of stream " << stream << " does not match size or type of the ring." << std::endl;
+			return RET_FAILED;
+		}
+	}
+
+	sequenceNumber = m_NextSequenceNumber++;
+	slot = (int)(sequenceNumber % m_Header->numberOfSlots);
+	t_SharedFrameSlot* descriptor = GetSlot(slot);
+
+	// Readers of the previous frame in this slot see it invalid from now on
+	descriptor->sequenceNumber = 0;
+	FrameBarrier();
+
+	for (int stream=0; stream<m_Header->numberOfStreams; stream++)
+	{
+		cv::Mat image(m_Header->height, m_Header->width, m_Header->types[stream], (char*) descriptor + m_Header->streamOffsets[stream]);
+		frames[stream].copyTo(image);
+	}
+	descriptor->timestamp = frameInfo.timestamp;
+	descriptor->cameraSequenceNumber = frameInfo.sequenceNumber;
+
+	FrameBarrier();
+	descriptor->sequenceNumber = sequenceNumber;
+
+	return RET_OK;
+}
+
+unsigned long SharedFrameRing::GetFrame(int slot, boost::uint64_t sequenceNumber, cv::Mat* frames, t_FrameInfo* frameInfo)
+{
+	if (!isOpen() || slot < 0 || slot >= m_Header->numberOfSlots || !IsValid(slot, sequenceNumber))
+	{
+		return RET_FAILED;
+	}
+
+	t_SharedFrameSlot* descriptor = GetSlot(slot);
+	for (int stream=0; stream<m_Header->numberOfStreams; stream++)
+	{
+		frames[stream] = cv::Mat(m_Header->height, m_Header->width, m_Header->types[stream], (char*) descriptor + m_Header->streamOffsets[stream]);
+	}
+	if (frameInfo)
+	{
+		frameInfo->timestamp = descriptor->timestamp;
+		frameInfo->sequenceNumber = (unsigned long) descriptor->cameraSequenceNumber;
+		// The descriptor may have been rewritten while reading it
+		if (!IsValid(slot, sequenceNumber))
+		{
+			return RET_FAILED;
+		}
+	}
+
+	return RET_OK;
+}
+
+bool SharedFrameRing::IsValid(int slot, boost::uint64_t sequenceNumber)
+{
+	if (!isOpen() || slot < 0 || slot >= m_Header->numberOfSlots)
+	{
+		return false;
+	}
+	FrameBarrier();
+	return sequenceNumber != 0 && GetSlot(slot)->sequenceNumber == sequenceNumber;
+}
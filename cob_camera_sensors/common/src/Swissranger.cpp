@@ -55,13 +55,36 @@
 	#include "cob_camera_sensors/Swissranger.h"
 	#include "cob_vision_utils/VisionUtils.h"
 	#include "tinyxml.h"
+	#include "cob_camera_sensors/CalibrationCache.h"
 #else
 	#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/Swissranger.h"
+	#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/CalibrationCache.h"
 	#include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/VisionUtils.h"
 #endif
 
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+#include <cob_utilities/Trace.h>
+
 using namespace ipa_CameraSensors;
 
+namespace
+{
+	/// Scales the viewing rays by the calibrated z values and stores interleaved xyz triples.
+	/// Free of calls and branches, so the compiler can vectorize it.
+	inline void ComputeXYZ(const float* z, const float* rayX, const float* rayY, float* xyz, int n)
+	{
+		for (int i=0; i<n; i++)
+		{
+			xyz[3*i] = z[i] * rayX[i];
+			xyz[3*i + 1] = z[i] * rayY[i];
+			xyz[3*i + 2] = z[i];
+		}
+	}
+}
+
 __DLL_LIBCAMERASENSORS__ AbstractRangeImagingSensorPtr ipa_CameraSensors::CreateRangeImagingSensor_Swissranger()
 {
 	return AbstractRangeImagingSensorPtr(new Swissranger());
@@ -77,6 +100,13 @@ Swissranger::Swissranger()
 	m_BufferSize = 1;
 
 	m_CoeffsInitialized = false;
+
+	m_ImageWidth = SWISSRANGER_COLUMNS;
+	m_ImageHeight = SWISSRANGER_ROWS;
+	m_RayLUTValid = false;
+
+	m_StopCapture = false;
+	m_CapturedFrameAvailable = false;
 }
 
 
@@ -139,120 +169,40 @@ unsigned long Swissranger::Init(std::string directory, int cameraIndex)
 
 	if (m_CalibrationMethod == MATLAB)
 	{
-		// Load z-calibration files
-		std::string filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA0.xml";
-		CvMat* c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
+		// Load z-calibration files, from the binary cache if the xml files did not change
+		std::vector<std::string> filenames;
+		for (int i=0; i<7; i++)
 		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA0.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
-		{
-			m_CoeffsA0 = c_mat;
-			cvReleaseMat(&c_mat);
-		}
-
-		filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA1.xml";
-		c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA1.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
-		{
-			m_CoeffsA1 = c_mat;
-			cvReleaseMat(&c_mat);
+			std::stringstream filename;
+			filename << directory << "MatlabCalibrationData/PMD/ZCoeffsA" << i << ".xml";
+			filenames.push_back(filename.str());
 		}
+		std::vector<cv::Mat> coeffs;
+		LoadCalibrationMatrices(filenames, directory + "MatlabCalibrationData/PMD/ZCoeffs.cache", coeffs);
 
-		filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA2.xml";
-		c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA2.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
+		cv::Mat* targets[7] = {&m_CoeffsA0, &m_CoeffsA1, &m_CoeffsA2, &m_CoeffsA3, &m_CoeffsA4, &m_CoeffsA5, &m_CoeffsA6};
+		for (int i=0; i<7; i++)
 		{
-			m_CoeffsA2 = c_mat;
-			cvReleaseMat(&c_mat);
-		}
-
-		filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA3.xml";
-		c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA3.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
-		{
-			m_CoeffsA3 = c_mat;
-			cvReleaseMat(&c_mat);
-		}
-
-		filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA4.xml";
-		c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA4.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
-		{
-			m_CoeffsA4 = c_mat;
-			cvReleaseMat(&c_mat);
-		}
-
-		filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA5.xml";
-		c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA5.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
-		{
-			m_CoeffsA5 = c_mat;
-			cvReleaseMat(&c_mat);
-		}
-
-		filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA6.xml";
-		c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA6.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
-		{
-			m_CoeffsA6 = c_mat;
-			cvReleaseMat(&c_mat);
+			if (coeffs[i].empty())
+			{
+				std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
+				std::cerr << "\t ... Error while loading " << filenames[i] << "." << std::endl;
+				std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
+				m_CoeffsInitialized = false;
+				// no RET_FAILED, as we might want to calibrate the camera to create these files
+			}
+			else
+			{
+				*targets[i] = coeffs[i];
+			}
 		}
 	}
 	
+	if (m_CoeffsInitialized)
+	{
+		UpdateZCoeffsLUT();
+	}
+
 	// set init flag
 	m_initialized = true;
 	m_GrayImageAcquireCalled = false;
@@ -322,9 +272,15 @@ unsigned long Swissranger::Open()
 		return RET_FAILED;
 	}
 
+	// The resolution does not change while the camera is open
+	m_ImageWidth = (int)SR_GetCols(m_SRCam);
+	m_ImageHeight = (int)SR_GetRows(m_SRCam);
+	m_RayLUTValid = false;
+
 	std::cout << "**************************************************" << std::endl;
 	std::cout << "Swissranger::Open: Swissranger camera device OPEN" << std::endl;
 	std::cout << "**************************************************" << std::endl << std::endl;
+	m_FrameInfo = t_FrameInfo();
 	m_open = true;
 
 	return RET_OK;
@@ -338,6 +294,10 @@ unsigned long Swissranger::Close()
 		return (RET_OK);
 	}
 
+	StopCapture();
+	// Frames before a reopen must not enter the temporal median
+	m_Filter.Reset();
+
 	if(SR_Close(m_SRCam)<0)
 	{
 		std::cout << "ERROR - Swissranger::Close():" << std::endl;
@@ -359,6 +319,8 @@ unsigned long Swissranger::SetProperty(t_cameraProperty* cameraProperty)
 		return (RET_FAILED | RET_CAMERA_NOT_OPEN);
 	}
 
+	boost::mutex::scoped_lock lock(m_SRMutex);
+
 	int err = 0;
 	switch (cameraProperty->propertyID)
 	{
@@ -585,6 +547,7 @@ unsigned long Swissranger::SetPropertyDefaults()
 
 unsigned long Swissranger::GetProperty(t_cameraProperty* cameraProperty) 
 {
+	boost::mutex::scoped_lock lock(m_SRMutex);
 	switch (cameraProperty->propertyID)
 	{
 		case PROP_DMA_BUFFER_SIZE:
@@ -654,11 +617,22 @@ unsigned long Swissranger::GetProperty(t_cameraProperty* cameraProperty)
 }
 
 
-// Wrapper for IplImage retrival from AcquireImage
-// Images have to be initialized prior to calling this function
+// Wrapper for cv::Mat retrival from AcquireFrame
 unsigned long Swissranger::AcquireImages(cv::Mat* rangeImage, cv::Mat* grayImage, cv::Mat* cartesianImage, 
 										 bool getLatestFrame, bool undistort, ipa_CameraSensors::t_ToFGrayImageType grayImageType)
 {
+	return AcquireImagesIntoFrame(rangeImage, grayImage, cartesianImage, getLatestFrame, undistort, grayImageType);
+}
+
+// The images of the frame are only allocated if their size or type changed
+unsigned long Swissranger::AcquireFrame(const t_RangeFrameRequest& request, t_RangeFrame& frame)
+{
+	TRACE_SCOPE("Swissranger::AcquireFrame");
+
+	cv::Mat* rangeImage = (request.channels & RANGE_CHANNEL) ? &frame.rangeImage : 0;
+	cv::Mat* grayImage = (request.channels & GRAY_CHANNEL) ? &frame.grayImage : 0;
+	cv::Mat* cartesianImage = (request.channels & CARTESIAN_CHANNEL) ? &frame.cartesianImage : 0;
+
 	char* rangeImageData = 0;
 	char* grayImageData = 0;
 	char* cartesianImageData = 0;
@@ -666,13 +640,8 @@ unsigned long Swissranger::AcquireImages(cv::Mat* rangeImage, cv::Mat* grayImage
 	int widthStepGray = -1;
 	int widthStepCartesian = -1;
 
-	int width = -1;
-	int height = -1;
-	ipa_CameraSensors::t_cameraProperty cameraProperty;
-	cameraProperty.propertyID = PROP_CAMERA_RESOLUTION;
-	GetProperty(&cameraProperty);
-	width = cameraProperty.cameraResolution.xResolution;
-	height = cameraProperty.cameraResolution.yResolution;
+	int width = m_ImageWidth;
+	int height = m_ImageHeight;
 
 	if(rangeImage)
 	{
@@ -700,8 +669,25 @@ unsigned long Swissranger::AcquireImages(cv::Mat* rangeImage, cv::Mat* grayImage
 		return RET_OK;
 	}
 
-	return AcquireImages(widthStepRange, widthStepGray, widthStepCartesian, rangeImageData, grayImageData, cartesianImageData, getLatestFrame, undistort, grayImageType);
-	
+	// The amplitude threshold needs the gray image, even if the caller does not
+	cv::Mat* amplitudeImage = grayImage;
+	if (m_Filter.NeedsAmplitude() && !grayImage)
+	{
+		m_FilterAmplitude.create(height, width, CV_32FC1);
+		amplitudeImage = &m_FilterAmplitude;
+		grayImageData = m_FilterAmplitude.ptr<char>(0);
+		widthStepGray = m_FilterAmplitude.step;
+	}
+
+	unsigned long ret = AcquireImages(widthStepRange, widthStepGray, widthStepCartesian, rangeImageData, grayImageData, cartesianImageData,
+		request.getLatestFrame, request.undistort, request.grayImageType);
+	if (ret & RET_FAILED)
+	{
+		return ret;
+	}
+	frame.info = m_FrameInfo;
+
+	return m_Filter.Apply(rangeImage, amplitudeImage, cartesianImage);
 }
 
 // Enables faster image retrival than AcquireImage
@@ -723,34 +709,32 @@ unsigned long Swissranger::AcquireImages(int widthStepRange, int widthStepGray,
 	//std::cout << "\t ... Integration time is '" << c << "'" << std::endl;
 	//std::cout << "\t ... Amplitude threshold is '" << a << "'" << std::endl;
 
-	int width = -1;
-	int height = -1;
-	ipa_CameraSensors::t_cameraProperty cameraProperty;
-	cameraProperty.propertyID = PROP_CAMERA_RESOLUTION;
-	GetProperty(&cameraProperty);
-	width = cameraProperty.cameraResolution.xResolution;
-	height = cameraProperty.cameraResolution.yResolution;
-
-	unsigned int bytesRead	= 0;
-	bytesRead = SR_Acquire(m_SRCam);
-	if(bytesRead <= 0)
+	int width = m_ImageWidth;
+	int height = m_ImageHeight;
+
+	if (!m_CaptureThread && (StartCapture() & RET_FAILED))
 	{
-		std::cerr << "ERROR - Swissranger::AcquireImages:" << std::endl;
-		std::cerr << "\t ... Could not acquire image!" << std::endl;
 		return RET_FAILED;
 	}
 
-	if (getLatestFrame == true)
+	// The newest frame is returned right away, otherwise wait for a frame not returned before
+	if (WaitForCapturedFrame(!getLatestFrame) & RET_FAILED)
 	{
-		bytesRead = SR_Acquire(m_SRCam);
-		if(bytesRead <= 0)
-		{
-			std::cerr << "ERROR - Swissranger::AcquireImages:" << std::endl;
-			std::cerr << "\t ... Could not acquire image!" << std::endl;
-			return RET_FAILED;
-		}
+		return RET_FAILED;
+	}
+	const t_SRFrame& frame = m_CaptureBuffer->readSlot();
+	m_FrameInfo = frame.info;
+	const WORD* pixels = &frame.pixels[0];
+	if (cartesianImageData && !frame.z.empty())
+	{
+		// Keep the coordinates of the returned frame for GetCalibratedZSwissranger() and GetCalibratedXYSwissranger()
+		std::copy(frame.x.begin(), frame.x.end(), m_X);
+		std::copy(frame.y.begin(), frame.y.end(), m_Y);
+		std::copy(frame.z.begin(), frame.z.end(), m_Z);
 	}
-	WORD* pixels =(WORD*) SR_GetImage(m_SRCam, 0);
+	const float* srX = m_X;
+	const float* srY = m_Y;
+	const float* srZ = m_Z;
 ///***********************************************************************
 // Range image (distorted or undistorted)
 ///***********************************************************************
@@ -758,12 +742,16 @@ unsigned long Swissranger::AcquireImages(int widthStepRange, int widthStepGray,
 	{
 		int imageStep = -1;
 		float* f_ptr = 0;
+
+		// Convert directly into the output, or into a temporary image that is undistorted into the output
+		cv::Mat rangeMat(height, width, CV_32FC1, rangeImageData, widthStepRange);
+		cv::Mat distortedData = undistort ? cv::Mat(height, width, CV_32FC1) : rangeMat;
 		
 		// put data in corresponding IPLImage structures
 		for(unsigned int row=0; row<(unsigned int)height; row++)
 		{
 			imageStep = row*width;
-			f_ptr = (float*)(rangeImageData + row*widthStepRange);
+			f_ptr = distortedData.ptr<float>(row);
 
 			for (unsigned int col=0; col<(unsigned int)width; col++)
 			{
@@ -773,11 +761,8 @@ unsigned long Swissranger::AcquireImages(int widthStepRange, int widthStepGray,
 		
 		if (undistort)
 		{
-			cv::Mat undistortedData(height, width, CV_32FC(1), (float*) rangeImageData);
-			cv::Mat distortedData;
- 
 			assert (!m_undistortMapX.empty() && !m_undistortMapY.empty());
-			cv::remap(distortedData, undistortedData, m_undistortMapX, m_undistortMapY, cv::INTER_LINEAR);
+			cv::remap(distortedData, rangeMat, m_undistortMapX, m_undistortMapY, cv::INTER_LINEAR);
 		}
 
 	} // End if (rangeImage)
@@ -801,12 +786,15 @@ unsigned long Swissranger::AcquireImages(int widthStepRange, int widthStepGray,
 		int imageStep = 0;
 		float* f_ptr = 0;
 
-		for(unsigned int row=0; row<(unsigned int)height-1; row++)
+		cv::Mat grayMat(height, width, CV_32FC1, grayImageData, widthStepGray);
+		cv::Mat distortedData = undistort ? cv::Mat(height, width, CV_32FC1) : grayMat;
+
+		for(unsigned int row=0; row<(unsigned int)height; row++)
 		{
 			imageStep = imageSize+row*width;
-			f_ptr = (float*)(grayImageData + row*widthStepGray);
+			f_ptr = distortedData.ptr<float>(row);
 
-			for (unsigned int col=0; col<(unsigned int)width-1; col++)
+			for (unsigned int col=0; col<(unsigned int)width; col++)
 			{
 				f_ptr[col] = (float)(pixels[imageStep+col]);
 			}	
@@ -814,11 +802,8 @@ unsigned long Swissranger::AcquireImages(int widthStepRange, int widthStepGray,
 		
 		if (undistort)
 		{
-			cv::Mat undistortedData( height, width, CV_32FC1, (float*) grayImageData);
-			cv::Mat distortedData;
- 
 			assert (!m_undistortMapX.empty() && !m_undistortMapY.empty());
-			cv::remap(distortedData, undistortedData, m_undistortMapX, m_undistortMapY, cv::INTER_LINEAR);
+			cv::remap(distortedData, grayMat, m_undistortMapX, m_undistortMapY, cv::INTER_LINEAR);
 		}
 
 	}
@@ -828,66 +813,43 @@ unsigned long Swissranger::AcquireImages(int widthStepRange, int widthStepGray,
 ///***********************************************************************
 	if(cartesianImageData)
 	{
-		float x = -1;
-		float y = -1;
-		float zRaw = -1;
-		float* zCalibratedPtr = 0;
-		float zCalibrated = -1;
 		float* f_ptr = 0;
 
+		if ((m_CalibrationMethod==MATLAB || m_CalibrationMethod==MATLAB_NO_Z) &&
+			!m_RayLUTValid && (UpdateRayLUT() & RET_FAILED))
+		{
+			return RET_FAILED;
+		}
+
 		if(m_CalibrationMethod==MATLAB)
 		{
-			if (m_CoeffsInitialized)
+			if (m_CoeffsInitialized && m_ZCoeffs.size() == (size_t)(7*width*height))
 			{
 				// Calculate calibrated z values (in meter) based on 6 degree polynomial approximation
 				cv::Mat distortedData( height, width, CV_32FC1 );
+				const double* c = &m_ZCoeffs[0];
 				for(unsigned int row=0; row<(unsigned int)height; row++)
 				{
 					f_ptr = distortedData.ptr<float>(row);
-					for (unsigned int col=0; col<(unsigned int)width; col++)
+					const WORD* zRaw = pixels + width*row;
+					for (unsigned int col=0; col<(unsigned int)width; col++, c+=7)
 					{
-						zRaw = (float)(pixels[width*row + col]);
-						GetCalibratedZMatlab(col, row, zRaw, zCalibrated);
-						f_ptr[col] = zCalibrated;
+						// Horner scheme
+						double d = (double)zRaw[col];
+						f_ptr[col] = (float)((((((c[6]*d + c[5])*d + c[4])*d + c[3])*d + c[2])*d + c[1])*d + c[0]);
 					}	
 				}
-				/*IplImage dummy;
-				IplImage *z = cvGetImage(distortedData, &dummy);
-				IplImage *image = cvCreateImage(cvGetSize(z), IPL_DEPTH_8U, 3);
-				ipa_Utils::ConvertToShowImage(z, image, 1);
-				cvNamedWindow("Z");
-				cvShowImage("Z", image);
-				cvWaitKey();
-				*/
 
 				// Undistort
 				cv::Mat undistortedData;
 				assert (!m_undistortMapX.empty() && !m_undistortMapY.empty());
 				cv::remap(distortedData, undistortedData, m_undistortMapX, m_undistortMapY, cv::INTER_LINEAR);
-				
-				/*IplImage dummy;
-				IplImage* z = cvGetImage(undistortedData, &dummy);
-				IplImage* image = cvCreateImage(cvGetSize(z), IPL_DEPTH_8U, 3);
-				ipa_utils::ConvertToShowImage(z, image, 1);
-				cvNamedWindow("Z");
-				cvShowImage("Z", image);
-				cvWaitKey();*/
 
 				// Calculate X and Y based on instrinsic rotation and translation
 				for(unsigned int row=0; row<(unsigned int)height; row++)
 				{
-					zCalibratedPtr = undistortedData.ptr<float>(row);
-					f_ptr = (float*)(cartesianImageData + row*widthStepCartesian);
-
-					for (unsigned int col=0; col<(unsigned int)width; col++)
-					{
-						int colTimes3 = 3*col;
-						GetCalibratedXYMatlab(col, row, zCalibratedPtr[col], x, y);
-
-						f_ptr[colTimes3] = x;
-						f_ptr[colTimes3 + 1] = y;
-						f_ptr[colTimes3 + 2] = zCalibratedPtr[col];
-					}
+					ComputeXYZ(undistortedData.ptr<float>(row), &m_RayX[row*width], &m_RayY[row*width],
+						(float*)(cartesianImageData + row*widthStepCartesian), width);
 				}
 			}
 			else
@@ -900,18 +862,8 @@ unsigned long Swissranger::AcquireImages(int widthStepRange, int widthStepGray,
 		}
 		else if(m_CalibrationMethod==MATLAB_NO_Z)
 		{
-			SR_CoordTrfFlt(m_SRCam, m_X, m_Y, m_Z, sizeof(float), sizeof(float), sizeof(float));
-			// Calculate calibrated z values (in meter) based on 6 degree polynomial approximation
-			cv::Mat distortedData( height, width, CV_32FC1 );
-			for(unsigned int row=0; row<(unsigned int)height; row++)
-			{
-				f_ptr = distortedData.ptr<float>(row);
-				for (unsigned int col=0; col<(unsigned int)width; col++)
-				{
-					GetCalibratedZSwissranger(col, row, width, zCalibrated);
-					f_ptr[col] = zCalibrated;
-				}	
-			}
+			// Calibrated z values (in meter) of the swissranger
+			cv::Mat distortedData( height, width, CV_32FC1, (float*) srZ );
 
 			// Undistort
 			cv::Mat undistortedData;
@@ -921,38 +873,24 @@ unsigned long Swissranger::AcquireImages(int widthStepRange, int widthStepGray,
 			// Calculate X and Y based on instrinsic rotation and translation
 			for(unsigned int row=0; row<(unsigned int)height; row++)
 			{
-				zCalibratedPtr = undistortedData.ptr<float>(row);
-				f_ptr = (float*)(cartesianImageData + row*widthStepCartesian);
-
-				for (unsigned int col=0; col<(unsigned int)width; col++)
-				{
-					int colTimes3 = 3*col;
-					GetCalibratedXYMatlab(col, row, zCalibratedPtr[col], x, y);
-
-					f_ptr[colTimes3] = x;
-					f_ptr[colTimes3 + 1] = y;
-					f_ptr[colTimes3 + 2] = zCalibratedPtr[col];
-				}
+				ComputeXYZ(undistortedData.ptr<float>(row), &m_RayX[row*width], &m_RayY[row*width],
+					(float*)(cartesianImageData + row*widthStepCartesian), width);
 			}
 		}
 		else if(m_CalibrationMethod==NATIVE)
 		{
-			SR_CoordTrfFlt(m_SRCam, m_X, m_Y, m_Z, sizeof(float), sizeof(float), sizeof(float));
-					
 			for(unsigned int row=0; row<(unsigned int)height; row++)
 			{
 				f_ptr = (float*)(cartesianImageData + row*widthStepCartesian);
+				int imageStep = row*width;
 
 				for (unsigned int col=0; col<(unsigned int)width; col++)
 				{
 					int colTimes3 = 3*col;
 
-					GetCalibratedZSwissranger(col, row, width, zCalibrated);
-					GetCalibratedXYSwissranger(col, row, width, x, y);
-
-					f_ptr[colTimes3] = x;
-					f_ptr[colTimes3 + 1] = y;
-					f_ptr[colTimes3 + 2] = zCalibrated;
+					f_ptr[colTimes3] = srX[imageStep + col];
+					f_ptr[colTimes3 + 1] = srY[imageStep + col];
+					f_ptr[colTimes3 + 2] = srZ[imageStep + col];
 				}
 			}
 		}
@@ -1041,6 +979,159 @@ unsigned long Swissranger::GetCalibratedXYSwissranger(int u, int v, int width, f
 	return RET_OK;
 }
 
+unsigned long Swissranger::StartCapture()
+{
+	t_SRFrame frame;
+	frame.pixels.resize(2 * m_ImageWidth * m_ImageHeight);
+	if (m_CalibrationMethod==MATLAB_NO_Z || m_CalibrationMethod==NATIVE)
+	{
+		frame.x.resize(m_ImageWidth * m_ImageHeight);
+		frame.y.resize(m_ImageWidth * m_ImageHeight);
+		frame.z.resize(m_ImageWidth * m_ImageHeight);
+	}
+	m_CaptureBuffer.reset(new TripleBuffer<t_SRFrame>(frame));
+	m_CapturedFrameAvailable = false;
+	m_StopCapture = false;
+
+	try
+	{
+		m_CaptureThread.reset(new boost::thread(boost::bind(&Swissranger::CaptureThread, this)));
+	}
+	catch (const boost::thread_resource_error& ex)
+	{
+		std::cerr << "ERROR - Swissranger::StartCapture:" << std::endl;
+		std::cerr << "\t ... Could not start capture thread: " << ex.what() << std::endl;
+		return RET_FAILED;
+	}
+	return RET_OK;
+}
+
+void Swissranger::StopCapture()
+{
+	if (!m_CaptureThread)
+	{
+		return;
+	}
+
+	m_StopCapture = true;
+	m_CaptureThread->join();
+	m_CaptureThread.reset();
+	m_CaptureBuffer.reset();
+	m_CapturedFrameAvailable = false;
+}
+
+void Swissranger::CaptureThread()
+{
+	unsigned long sequenceNumber = 0;
+	while (!m_StopCapture)
+	{
+		t_SRFrame& frame = m_CaptureBuffer->writeSlot();
+		{
+			boost::mutex::scoped_lock lock(m_SRMutex);
+			int bytesRead = SR_Acquire(m_SRCam);
+			// libMesaSR provides no capture time, SR_Acquire returns with the completed frame
+			frame.info.timestamp = GetFrameTimestamp();
+			if (bytesRead <= 0)
+			{
+				lock.unlock();
+				std::cerr << "ERROR - Swissranger::CaptureThread:" << std::endl;
+				std::cerr << "\t ... Could not acquire image!" << std::endl;
+				boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+				continue;
+			}
+			const WORD* pixels = (WORD*) SR_GetImage(m_SRCam, 0);
+			std::copy(pixels, pixels + frame.pixels.size(), frame.pixels.begin());
+			if (!frame.z.empty())
+			{
+				SR_CoordTrfFlt(m_SRCam, &frame.x[0], &frame.y[0], &frame.z[0], sizeof(float), sizeof(float), sizeof(float));
+			}
+		}
+		frame.info.sequenceNumber = ++sequenceNumber;
+		m_CaptureBuffer->publish();
+	}
+}
+
+unsigned long Swissranger::WaitForCapturedFrame(bool newFrame)
+{
+	// Only waits for the first frame after the start, or for a frame not returned before if newFrame is set
+	for (int i=0; i<1000; i++)
+	{
+		bool updated = m_CaptureBuffer->update();
+		m_CapturedFrameAvailable |= updated;
+		if (m_CapturedFrameAvailable && (updated || !newFrame))
+		{
+			return RET_OK;
+		}
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+	}
+
+	std::cerr << "ERROR - Swissranger::AcquireImages:" << std::endl;
+	std::cerr << "\t ... No image captured within 1 s." << std::endl;
+	return RET_FAILED;
+}
+
+unsigned long Swissranger::SetIntrinsics(cv::Mat& intrinsicMatrix,
+		cv::Mat& undistortMapX, cv::Mat& undistortMapY)
+{
+	m_RayLUTValid = false;
+	return AbstractRangeImagingSensor::SetIntrinsics(intrinsicMatrix, undistortMapX, undistortMapY);
+}
+
+unsigned long Swissranger::UpdateRayLUT()
+{
+	if (m_intrinsicMatrix.empty())
+	{
+		std::cerr << "ERROR - Swissranger::UpdateRayLUT:" << std::endl;
+		std::cerr << "\t ... Intrinsics not set.\n";
+		return RET_FAILED;
+	}
+
+	double fx = m_intrinsicMatrix.at<double>(0, 0);
+	double fy = m_intrinsicMatrix.at<double>(1, 1);
+	double cx = m_intrinsicMatrix.at<double>(0, 2);
+	double cy = m_intrinsicMatrix.at<double>(1, 2);
+
+	// Fundamental equations: u = (fx*x)/z + cx and v = (fy*y)/z + cy
+	if (fx == 0 || fy == 0)
+	{
+		std::cerr << "ERROR - Swissranger::UpdateRayLUT:" << std::endl;
+		std::cerr << "\t ... fx or fy is 0.\n";
+		return RET_FAILED;
+	}
+
+	m_RayX.resize(m_ImageWidth * m_ImageHeight);
+	m_RayY.resize(m_ImageWidth * m_ImageHeight);
+	for (int v=0; v<m_ImageHeight; v++)
+	{
+		for (int u=0; u<m_ImageWidth; u++)
+		{
+			m_RayX[v*m_ImageWidth + u] = (float) ((u-cx)/fx);
+			m_RayY[v*m_ImageWidth + u] = (float) ((v-cy)/fy);
+		}
+	}
+
+	m_RayLUTValid = true;
+	return RET_OK;
+}
+
+void Swissranger::UpdateZCoeffsLUT()
+{
+	const cv::Mat* coeffs[7] = {&m_CoeffsA0, &m_CoeffsA1, &m_CoeffsA2, &m_CoeffsA3, &m_CoeffsA4, &m_CoeffsA5, &m_CoeffsA6};
+
+	m_ZCoeffs.resize(7 * m_CoeffsA0.rows * m_CoeffsA0.cols);
+	for (int v=0; v<m_CoeffsA0.rows; v++)
+	{
+		for (int u=0; u<m_CoeffsA0.cols; u++)
+		{
+			double* c = &m_ZCoeffs[7 * (v*m_CoeffsA0.cols + u)];
+			for (int i=0; i<7; i++)
+			{
+				c[i] = coeffs[i]->at<double>(v, u);
+			}
+		}
+	}
+}
+
 unsigned long Swissranger::SetParameters()
 {
 	ipa_CameraSensors::t_cameraProperty cameraProperty;
@@ -1559,6 +1650,25 @@ unsigned long Swissranger::LoadParameters(const char* filename, int cameraIndex)
 					std::cerr << "\t ... Can't find tag 'CalibrationMethod'." << std::endl;
 					return (RET_FAILED | RET_XML_TAG_NOT_FOUND);
 				}
+
+//************************************************************************************
+//	BEGIN LibCameraSensors->Swissranger->Filter
+//************************************************************************************
+				// Optional subtag element "Filter" of Xml Inifile, all filters are disabled without it
+				p_xmlElement_Child = NULL;
+				p_xmlElement_Child = p_xmlElement_Root_SR31->FirstChildElement( "Filter" );
+				if ( p_xmlElement_Child )
+				{
+					double amplitudeThreshold = 0;
+					double jumpEdgeThreshold = 0;
+					int temporalMedian = 1;
+					p_xmlElement_Child->QueryDoubleAttribute( "amplitudeThreshold", &amplitudeThreshold );
+					p_xmlElement_Child->QueryDoubleAttribute( "jumpEdgeThreshold", &jumpEdgeThreshold );
+					p_xmlElement_Child->QueryIntAttribute( "temporalMedian", &temporalMedian );
+					m_Filter.SetAmplitudeThreshold((float) amplitudeThreshold);
+					m_Filter.SetJumpEdgeThreshold((float) jumpEdgeThreshold);
+					m_Filter.SetTemporalMedian(temporalMedian);
+				}
 			
 			}
 //************************************************************************************
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cob_vision_utils/StdAfx.h>
+
+#ifdef __LINUX__
+#include "cob_camera_sensors/ToFFilter.h"
+#else
+#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/ToFFilter.h"
+#endif
+
+#include <algorithm>
+#include <iostream>
+
+using namespace ipa_CameraSensors;
+
+ToFFilter::ToFFilter()
+{
+	m_AmplitudeThreshold = 0;
+	m_JumpEdgeThreshold = 0;
+	m_MedianFrames = 1;
+}
+
+void ToFFilter::SetTemporalMedian(int frames)
+{
+	m_MedianFrames = std::max(frames, 1);
+	Reset();
+}
+
+void ToFFilter::Reset()
+{
+	m_RangeHistory.clear();
+	m_XYZHistory.clear();
+}
+
+unsigned long ToFFilter::Apply(cv::Mat* rangeImage, const cv::Mat* amplitudeImage, cv::Mat* xyzImage)
+{
+	if (!isEnabled())
+	{
+		return RET_OK;
+	}
+	if ((rangeImage && rangeImage->type() != CV_32FC1) || (xyzImage && xyzImage->type() != CV_32FC3))
+	{
+		std::cerr << "ERROR - ToFFilter::Apply:" << std::endl;
+		std::cerr << "\t ... CV_32FC1 range image and CV_32FC3 xyz image expected." << std::endl;
+		return RET_FAILED;
+	}
+
+	if (m_MedianFrames > 1)
+	{
+		if (rangeImage) TemporalMedian(m_RangeHistory, *rangeImage);
+		if (xyzImage) TemporalMedian(m_XYZHistory, *xyzImage);
+	}
+
+	const cv::Mat* depthImage = xyzImage ? xyzImage : rangeImage;
+	if (!depthImage)
+	{
+		return RET_OK;
+	}
+	m_InvalidMask.create(depthImage->size(), CV_8UC1);
+	m_InvalidMask.setTo(cv::Scalar(0));
+
+	if (NeedsAmplitude())
+	{
+		if (!amplitudeImage || amplitudeImage->size() != depthImage->size() || amplitudeImage->type() != CV_32FC1)
+		{
+			std::cerr << "ERROR - ToFFilter::Apply:" << std::endl;
+			std::cerr << "\t ... CV_32FC1 amplitude image of the same size needed for the amplitude threshold." << std::endl;
+			return RET_FAILED;
+		}
+		cv::compare(*amplitudeImage, m_AmplitudeThreshold, m_InvalidMask, cv::CMP_LT);
+	}
+
+	if (m_JumpEdgeThreshold > 0)
+	{
+		if (xyzImage)
+		{
+			m_Depth.create(xyzImage->size(), CV_32FC1);
+			const int fromTo[] = { 2,0 };
+			cv::mixChannels(xyzImage, 1, &m_Depth, 1, fromTo, 1);
+		}
+		else
+		{
+			m_Depth = *rangeImage;
+		}
+		MarkJumpEdges(m_Depth, m_InvalidMask);
+	}
+
+	if (rangeImage) rangeImage->setTo(cv::Scalar(0), m_InvalidMask);
+	if (xyzImage) xyzImage->setTo(cv::Scalar(0, 0, 0), m_InvalidMask);
+	return RET_OK;
+}
+
+void ToFFilter::TemporalMedian(std::deque<cv::Mat>& history, cv::Mat& image)
+{
+	if (!history.empty() && (history.back().size() != image.size() || history.back().type() != image.type()))
+	{
+		history.clear();
+	}
+
+	// Reuse the buffer of the oldest frame
+	cv::Mat frame;
+	if ((int)history.size() >= m_MedianFrames)
+	{
+		frame = history.front();
+		history.pop_front();
+	}
+	image.copyTo(frame);
+	history.push_back(frame);
+
+	// Until K frames are available, the median of the available ones is used
+	int n = (int)history.size();
+	if (n < 3)
+	{
+		return;
+	}
+
+	// Odd-even transposition sort over whole images, n passes of elementwise min and max
+	m_Sorted.resize(n + 1);
+	for (int i=0; i<n; i++)
+	{
+		history[i].copyTo(m_Sorted[i]);
+	}
+	cv::Mat& lower = m_Sorted[n];
+	for (int pass=0; pass<n; pass++)
+	{
+		for (int i=pass%2; i+1<n; i+=2)
+		{
+			cv::min(m_Sorted[i], m_Sorted[i+1], lower);
+			cv::max(m_Sorted[i], m_Sorted[i+1], m_Sorted[i+1]);
+			std::swap(m_Sorted[i], lower);
+		}
+	}
+	m_Sorted[n/2].copyTo(image);
+}
+
+void ToFFilter::MarkJumpEdges(const cv::Mat& depth, cv::Mat& mask)
+{
+	int width = depth.cols;
+	int height = depth.rows;
+	depth.convertTo(m_Threshold, CV_32FC1, m_JumpEdgeThreshold);
+
+	// Horizontal neighbours of the inner columns, then vertical neighbours of the inner rows
+	for (int direction=0; direction<2; direction++)
+	{
+		int dx = (direction == 0) ? 1 : 0;
+		int dy = 1 - dx;
+		if (width <= 2*dx || height <= 2*dy)
+		{
+			continue;
+		}
+		cv::Rect center(dx, dy, width - 2*dx, height - 2*dy);
+		cv::Rect previous(0, 0, center.width, center.height);
+		cv::Rect next(2*dx, 2*dy, center.width, center.height);
+
+		cv::absdiff(depth(center), depth(previous), m_Difference1);
+		cv::absdiff(depth(center), depth(next), m_Difference2);
+		cv::min(m_Difference1, m_Difference2, m_Difference1);
+
+		cv::Mat jumps;
+		cv::compare(m_Difference1, m_Threshold(center), jumps, cv::CMP_GT);
+		cv::Mat maskCenter = mask(center);
+		cv::bitwise_or(maskCenter, jumps, maskCenter);
+	}
+}
@@ -63,6 +63,8 @@
 #include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/VirtualColorCam.h"
 #endif
 
+#include <boost/bind.hpp>
+
 namespace fs = boost::filesystem;
 using namespace ipa_CameraSensors;
 
@@ -82,6 +84,9 @@ VirtualColorCam::VirtualColorCam()
 	m_ImageHeight = 0;
 
 	m_ImageCounter = 0;
+
+	m_PrefetchDepth = 0;
+	m_PrefetchThreads = 1;
 }
 
 VirtualColorCam::~VirtualColorCam()
@@ -219,6 +224,7 @@ unsigned long VirtualColorCam::Open()
 	std::cout << "VirtualColorCam::Open: Virtual color camera device OPEN" << std::endl;
 	std::cout << "*******************************************************" << std::endl << std::endl;
 
+	m_FrameInfo = t_FrameInfo();
 	m_open = true;
 	return RET_OK;
 
@@ -226,6 +232,7 @@ unsigned long VirtualColorCam::Open()
 
 unsigned long VirtualColorCam::ResetImages()
 { 
+	m_Prefetcher.Stop();
 	m_ColorImageFileNames.clear();
 	return RET_OK;
 }
@@ -235,6 +242,19 @@ int VirtualColorCam::GetNumberOfImages()
 	return m_ColorImageFileNames.size();
 }
 
+unsigned long VirtualColorCam::LoadImage(int index, std::vector<cv::Mat>& images)
+{
+	images.resize(1);
+	images[0] = cv::imread(m_ColorImageFileNames[index], CV_LOAD_IMAGE_COLOR);
+	if (images[0].empty())
+	{
+		std::cerr << "ERROR - VirtualColorCam::LoadImage:" << std::endl;
+		std::cerr << "\t ... Could not load image '" << m_ColorImageFileNames[index] << "'." << std::endl;
+		return RET_FAILED;
+	}
+	return RET_OK;
+}
+
 unsigned long VirtualColorCam::SaveParameters(const char* filename)
 { 
 	return RET_FAILED;
@@ -254,6 +274,8 @@ unsigned long VirtualColorCam::Close()
 		return RET_OK;
 	}
 
+	m_Prefetcher.Stop();
+
 	m_open = false;
 	return RET_OK;
 } 
@@ -323,20 +345,31 @@ unsigned long VirtualColorCam::GetColorImage(char* colorImageData, bool getLates
 		return (RET_FAILED | RET_CAMERA_NOT_OPEN);
 	}
 	
-	IplImage* colorImage = (IplImage*) cvLoadImage(m_ColorImageFileNames[m_ImageCounter].c_str(), CV_LOAD_IMAGE_COLOR);
+	std::vector<cv::Mat> images;
+	if (m_PrefetchDepth > 0)
+	{
+		if (!m_Prefetcher.isRunning() && (m_Prefetcher.Start(boost::bind(&VirtualColorCam::LoadImage, this, _1, _2),
+			GetNumberOfImages(), m_PrefetchDepth, m_PrefetchThreads) & RET_FAILED))
+		{
+			return RET_FAILED;
+		}
+		if (m_Prefetcher.GetImages(m_ImageCounter, images) & RET_FAILED)
+		{
+			return RET_FAILED;
+		}
+	}
+	else if (LoadImage(m_ImageCounter, images) & RET_FAILED)
+	{
+		return RET_FAILED;
+	}
+	m_FrameInfo.timestamp = GetFrameTimestamp();
+	m_FrameInfo.sequenceNumber++;
+	const cv::Mat& colorImage = images[0];
 
 	for(int row=0; row<m_ImageHeight; row++)
 	{
-		for (int col=0; col<m_ImageWidth; col++)
-		{
-			char* f_color_ptr = &((char*) (colorImage->imageData + row*colorImage->widthStep))[col*3];
-			((char*) (colorImageData + row*colorImage->widthStep))[col*3 + 0] = f_color_ptr[0];
-			((char*) (colorImageData + row*colorImage->widthStep))[col*3 + 1] = f_color_ptr[1];
-			((char*) (colorImageData + row*colorImage->widthStep))[col*3 + 2] = f_color_ptr[2];
-		}	
+		memcpy(colorImageData + row*colorImage.step, colorImage.ptr(row), m_ImageWidth*3);
 	}
-	
-	cvReleaseImage(&colorImage);
 
 	m_ImageCounter++;
 	if (m_ImageCounter >= m_ColorImageFileNames.size())
@@ -443,6 +476,27 @@ unsigned long VirtualColorCam::LoadParameters(const char* filename, int cameraIn
 					std::cerr << "\t ... Can't find tag 'CameraDataDirectory'." << std::endl;
 					return (RET_FAILED | RET_XML_TAG_NOT_FOUND);
 				}
+
+//************************************************************************************
+//	BEGIN LibCameraSensors->VirtualColorCam->Prefetch
+//************************************************************************************
+				// Subtag element "Prefetch" of Xml Inifile, optional
+				p_xmlElement_Child = NULL;
+				p_xmlElement_Child = p_xmlElement_Root_VirtualColorCam->FirstChildElement( "Prefetch" );
+				if ( p_xmlElement_Child )
+				{
+					// read and save value of attributes
+					if ( p_xmlElement_Child->QueryIntAttribute( "depth", &m_PrefetchDepth ) != TIXML_SUCCESS)
+					{
+						std::cerr << "ERROR - VirtualColorCam::LoadParameters:" << std::endl;
+						std::cerr << "\t ... Can't find attribute 'depth' of tag 'Prefetch'." << std::endl;
+						return (RET_FAILED | RET_XML_ATTR_NOT_FOUND);
+					}
+					if ( p_xmlElement_Child->QueryIntAttribute( "threads", &m_PrefetchThreads ) != TIXML_SUCCESS)
+					{
+						m_PrefetchThreads = 1;
+					}
+				}
 			}
 //************************************************************************************
 //	END LibCameraSensors->VirtualColorCam
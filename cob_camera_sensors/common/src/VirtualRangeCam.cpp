@@ -55,6 +55,7 @@
 
 #ifdef __LINUX__
 #include "cob_camera_sensors/VirtualRangeCam.h"
+#include "cob_camera_sensors/CalibrationCache.h"
 #include "cob_vision_utils/VisionUtils.h"
 
 #include "tinyxml.h"
@@ -62,9 +63,12 @@
 #include <boost/filesystem.hpp>
 #else
 #include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/VirtualRangeCam.h"
+#include "cob_driver/cob_camera_sensors/common/include/cob_camera_sensors/CalibrationCache.h"
 #include "cob_perception_common/cob_vision_utils/common/include/cob_vision_utils/VisionUtils.h"
 #endif
 
+#include <boost/bind.hpp>
+
 
 
 namespace fs = boost::filesystem;
@@ -83,6 +87,12 @@ VirtualRangeCam::VirtualRangeCam()
 	m_BufferSize = 1;
 
 	m_ImageCounter = 0;
+
+	m_UseReplayFile = false;
+
+	m_PrefetchDepth = 0;
+	m_PrefetchThreads = 1;
+	m_PrefetchStreams = 0;
 }
 
 
@@ -117,117 +127,32 @@ unsigned long VirtualRangeCam::Init(std::string directory, int cameraIndex)
 	m_CoeffsInitialized = true;
 	if (m_CalibrationMethod == MATLAB)
 	{
-		// Load z-calibration files
-		std::string filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA0.xml";
-		CvMat* c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA0.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
-		{
-			m_CoeffsA0 = c_mat;
-			cvReleaseMat(&c_mat);
-		}
-
-		filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA1.xml";
-		c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA1.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
-		{
-			m_CoeffsA1 = c_mat;
-			cvReleaseMat(&c_mat);
-		}
-
-		filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA2.xml";
-		c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA2.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
-		{
-			m_CoeffsA2 = c_mat;
-			cvReleaseMat(&c_mat);
-		}
-
-		filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA3.xml";
-		c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA3.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
-		{
-			m_CoeffsA3 = c_mat;
-			cvReleaseMat(&c_mat);
-		}
-
-		filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA4.xml";
-		c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA4.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
-		{
-			m_CoeffsA4 = c_mat;
-			cvReleaseMat(&c_mat);
-		}
-
-		filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA5.xml";
-		c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA5.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
+		// Load z-calibration files, from the binary cache if the xml files did not change
+		std::vector<std::string> filenames;
+		for (int i=0; i<7; i++)
 		{
-			m_CoeffsA5 = c_mat;
-			cvReleaseMat(&c_mat);
+			std::stringstream filename;
+			filename << directory << "MatlabCalibrationData/PMD/ZCoeffsA" << i << ".xml";
+			filenames.push_back(filename.str());
 		}
+		std::vector<cv::Mat> coeffs;
+		LoadCalibrationMatrices(filenames, directory + "MatlabCalibrationData/PMD/ZCoeffs.cache", coeffs);
 
-		filename = directory + "MatlabCalibrationData/PMD/ZCoeffsA6.xml";
-		c_mat = (CvMat*)cvLoad(filename.c_str()); 
-		if (! c_mat)
-		{
-			std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
-			std::cerr << "\t ... Error while loading " << directory + "MatlabCalibrationData/ZcoeffsA6.txt" << "." << std::endl;
-			std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
-			m_CoeffsInitialized = false;
-			// no RET_FAILED, as we might want to calibrate the camera to create these files
-		}
-		else
+		cv::Mat* targets[7] = {&m_CoeffsA0, &m_CoeffsA1, &m_CoeffsA2, &m_CoeffsA3, &m_CoeffsA4, &m_CoeffsA5, &m_CoeffsA6};
+		for (int i=0; i<7; i++)
 		{
-			m_CoeffsA6 = c_mat;
-			cvReleaseMat(&c_mat);
+			if (coeffs[i].empty())
+			{
+				std::cerr << "ERROR - PMDCamCube::LoadParameters:" << std::endl;
+				std::cerr << "\t ... Error while loading " << filenames[i] << "." << std::endl;
+				std::cerr << "\t ... Data is necessary for z-calibration of swissranger camera" << std::endl;
+				m_CoeffsInitialized = false;
+				// no RET_FAILED, as we might want to calibrate the camera to create these files
+			}
+			else
+			{
+				*targets[i] = coeffs[i];
+			}
 		}
 	}
 
@@ -321,6 +246,49 @@ unsigned long VirtualRangeCam::Open()
 		return (ipa_CameraSensors::RET_FAILED | ipa_CameraSensors::RET_FAILED_OPEN_FILE);
 	}
 
+	// Prefer the replay file over parsing the single image files
+	fs::path replayFileName = absoluteDirectoryName / ("RangeCamReplay_" + sCameraIndex + ".replay");
+	if ( fs::exists( replayFileName ) )
+	{
+		std::cout << "INFO - VirtualRangeCam::Open:" << std::endl;
+		std::cout << "\t ... Mapping replay file '" << replayFileName.string() << "'" << std::endl;
+		if (m_ReplayFile.Open(replayFileName.string()) & RET_FAILED)
+		{
+			std::cerr << "ERROR - VirtualRangeCam::Open:" << std::endl;
+			std::cerr << "\t ... Could not open replay file '" << replayFileName.string() << "'" << std::endl;
+			return (ipa_CameraSensors::RET_FAILED | ipa_CameraSensors::RET_FAILED_OPEN_FILE);
+		}
+
+		m_ImageWidth = m_ReplayFile.GetImageWidth();
+		m_ImageHeight = m_ReplayFile.GetImageHeight();
+		m_RangeImageImageType = m_ReplayFile.GetImageType(REPLAY_RANGE);
+		m_IntensityImageType = m_ReplayFile.GetImageType(REPLAY_INTENSITY);
+		m_AmplitudeImageType = m_ReplayFile.GetImageType(REPLAY_AMPLITUDE);
+		m_CoordinateImageType = m_ReplayFile.GetImageType(REPLAY_COORDINATE);
+		std::cout << "\t ... Mapped '" << m_ReplayFile.GetNumberOfFrames() << "' frames\n";
+
+		if (m_IntensityImageType == -1 && m_AmplitudeImageType == -1)
+		{
+			std::cerr << "ERROR - VirtualRangeCam::Open:" << std::endl;
+			std::cerr << "\t ... Replay file contains neither intensity nor amplitude images" << std::endl;
+			m_ReplayFile.Close();
+			return ipa_CameraSensors::RET_FAILED;
+		}
+
+		if((m_CalibrationMethod == NATIVE || m_CalibrationMethod == MATLAB_NO_Z) && m_CoordinateImageType == -1)
+		{
+			std::cerr << "ERROR - VirtualRangeCam::Open:" << std::endl;
+			std::cerr << "\t ... Coordinate images must be available for calibration mode NATIVE or MATLAB_NO_Z." << std::endl;
+			m_ReplayFile.Close();
+			return ipa_CameraSensors::RET_FAILED;
+		}
+
+		m_UseReplayFile = true;
+		m_FrameInfo = t_FrameInfo();
+		m_open = true;
+		return RET_OK;
+	}
+
 	std::vector<std::string> extensionList;
 	extensionList.push_back(".xml"); extensionList.push_back(".bin"); extensionList.push_back(".png"); extensionList.push_back(".jpg"); extensionList.push_back(".bmp");
 	std::map<std::string, int> amplitudeImageCounter;	// first index is the extension (.xml, .bin), second is the number of such images found
@@ -473,6 +441,7 @@ unsigned long VirtualRangeCam::Open()
 	std::cout << "**************************************************" << std::endl;
 	std::cout << "VirtualRangeCam::Open(): Virtual range camera OPEN" << std::endl;
 	std::cout << "**************************************************" << std::endl<< std::endl;
+	m_FrameInfo = t_FrameInfo();
 	m_open = true;
 
 	return RET_OK;
@@ -486,6 +455,11 @@ unsigned long VirtualRangeCam::Close()
 		return (RET_OK);
 	}
 
+	m_Prefetcher.Stop();
+	m_PrefetchStreams = 0;
+	m_ReplayFile.Close();
+	m_UseReplayFile = false;
+
 	m_open = false;
 	return RET_OK;
 
@@ -542,12 +516,20 @@ unsigned long VirtualRangeCam::GetProperty(t_cameraProperty* cameraProperty)
 }
 
 
-// Wrapper for IplImage retrival from AcquireImage
-// Images have to be initialized prior to calling this function
+// Wrapper for cv::Mat retrival from AcquireFrame
 unsigned long VirtualRangeCam::AcquireImages(cv::Mat* rangeImage, cv::Mat* grayImage, cv::Mat* cartesianImage,
 											 bool getLatestFrame, bool undistort, ipa_CameraSensors::t_ToFGrayImageType grayImageType)
 {
-	//std::cout << m_ImageCounter << std::endl;
+	return AcquireImagesIntoFrame(rangeImage, grayImage, cartesianImage, getLatestFrame, undistort, grayImageType);
+}
+
+// The images of the frame are only allocated if their size or type changed
+unsigned long VirtualRangeCam::AcquireFrame(const t_RangeFrameRequest& request, t_RangeFrame& frame)
+{
+	cv::Mat* rangeImage = (request.channels & RANGE_CHANNEL) ? &frame.rangeImage : 0;
+	cv::Mat* grayImage = (request.channels & GRAY_CHANNEL) ? &frame.grayImage : 0;
+	cv::Mat* cartesianImage = (request.channels & CARTESIAN_CHANNEL) ? &frame.cartesianImage : 0;
+	ipa_CameraSensors::t_ToFGrayImageType grayImageType = request.grayImageType;
 
 	char* rangeImageData = 0;
 	char* grayImageData = 0;
@@ -558,7 +540,7 @@ unsigned long VirtualRangeCam::AcquireImages(cv::Mat* rangeImage, cv::Mat* grayI
 
 	if(rangeImage)
 	{
-		if (!m_RangeImageFileNames.empty())
+		if (GetNumberOfImages(REPLAY_RANGE) != 0)
 		{
 			rangeImage->create(m_ImageHeight, m_ImageWidth, CV_32FC1);
 			rangeImageData = (char*) rangeImage->data;
@@ -574,7 +556,7 @@ unsigned long VirtualRangeCam::AcquireImages(cv::Mat* rangeImage, cv::Mat* grayI
 	{
 		if (grayImageType == ipa_CameraSensors::INTENSITY)
 		{
-			if (!m_IntensityImageFileNames.empty())
+			if (GetNumberOfImages(REPLAY_INTENSITY) != 0)
 			{
 				grayImage->create(m_ImageHeight, m_ImageWidth, m_IntensityImageType);
 				grayImageData = (char*) grayImage->data;
@@ -587,7 +569,7 @@ unsigned long VirtualRangeCam::AcquireImages(cv::Mat* rangeImage, cv::Mat* grayI
 		}
 		if (grayImageType == ipa_CameraSensors::AMPLITUDE)
 		{
-			if (!m_AmplitudeImageFileNames.empty())
+			if (GetNumberOfImages(REPLAY_AMPLITUDE) != 0)
 			{
 				grayImage->create(m_ImageHeight, m_ImageWidth, m_AmplitudeImageType);
 				grayImageData = (char*) grayImage->data;
@@ -603,7 +585,7 @@ unsigned long VirtualRangeCam::AcquireImages(cv::Mat* rangeImage, cv::Mat* grayI
 
 	if(cartesianImage)
 	{
-		if (!m_CoordinateImageFileNames.empty())
+		if (GetNumberOfImages(REPLAY_COORDINATE) != 0)
 		{
 			cartesianImage->create(m_ImageHeight, m_ImageWidth, CV_32FC3);
 			cartesianImageData = (char*) cartesianImage->data;
@@ -620,8 +602,10 @@ unsigned long VirtualRangeCam::AcquireImages(cv::Mat* rangeImage, cv::Mat* grayI
 		return RET_OK;
 	}
 
-	return AcquireImages(widthStepRange, widthStepGray, widthStepCartesian, rangeImageData, grayImageData, cartesianImageData, getLatestFrame, undistort, grayImageType);
-
+	unsigned long ret = AcquireImages(widthStepRange, widthStepGray, widthStepCartesian, rangeImageData, grayImageData, cartesianImageData,
+		request.getLatestFrame, request.undistort, grayImageType);
+	frame.info = m_FrameInfo;
+	return ret;
 }
 
 unsigned long VirtualRangeCam::AcquireImages(int widthStepRange, int widthStepGray, int widthStepCartesian, char* rangeImageData, char* grayImageData, char* cartesianImageData,
@@ -634,6 +618,26 @@ unsigned long VirtualRangeCam::AcquireImages(int widthStepRange, int widthStepGr
 		return (RET_FAILED | RET_CAMERA_NOT_OPEN);
 	}
 
+	if (grayImageData && grayImageType != ipa_CameraSensors::INTENSITY && grayImageType != ipa_CameraSensors::AMPLITUDE)
+	{
+		std::cerr << "ERROR - VirtualRangeCam::AcquireImages:\n";
+		std::cerr << "\t ... value of 'grayImageType' unknown.\n";
+		return RET_FAILED;
+	}
+
+	// Load all requested images of the frame at once
+	unsigned int streams = 0;
+	if (rangeImageData) streams |= (1 << REPLAY_RANGE);
+	if (grayImageData) streams |= (1 << ((grayImageType == ipa_CameraSensors::INTENSITY) ? REPLAY_INTENSITY : REPLAY_AMPLITUDE));
+	if (cartesianImageData && (m_CalibrationMethod == MATLAB_NO_Z || m_CalibrationMethod == NATIVE)) streams |= (1 << REPLAY_COORDINATE);
+	std::vector<cv::Mat> frame;
+	if (AcquireFrame(streams, frame) & RET_FAILED)
+	{
+		return RET_FAILED;
+	}
+	m_FrameInfo.timestamp = GetFrameTimestamp();
+	m_FrameInfo.sequenceNumber++;
+
 ///***********************************************************************
 // Range image (distorted or undistorted)
 ///***********************************************************************
@@ -641,27 +645,9 @@ unsigned long VirtualRangeCam::AcquireImages(int widthStepRange, int widthStepGr
 	{
 		float* f_ptr = 0;
 		float* f_ptr_dst = 0;
-		bool releaseNecessary = false;
 
-		cv::Mat rangeMat;
-		IplImage rangeIpl;
+		IplImage rangeIpl = (IplImage)frame[REPLAY_RANGE];
 		IplImage* rangeImage = &rangeIpl;
-		if (m_RangeImageFileNames[m_ImageCounter].find(".bin") != std::string::npos)
-		{
-			ipa_Utils::LoadMat(rangeMat, m_RangeImageFileNames[m_ImageCounter]);
-			rangeIpl = (IplImage)rangeMat;
-		}
-		else if (m_RangeImageFileNames[m_ImageCounter].find(".xml") != std::string::npos)
-		{
-			rangeImage = (IplImage*) cvLoad(m_RangeImageFileNames[m_ImageCounter].c_str(), 0);
-			releaseNecessary = true;
-		}
-		else
-		{
-			std::cerr << "ERROR - VirtualRangeCam::AcquireImages:\n";
-			std::cerr << "\t ... Wrong file format for file " << m_RangeImageFileNames[m_ImageCounter] << ".\n";
-			CV_Assert(false);
-		}
 		
 		if (!undistort)
 		{
@@ -685,8 +671,6 @@ unsigned long VirtualRangeCam::AcquireImages(int widthStepRange, int widthStepGr
 			assert (!m_undistortMapX.empty() && !m_undistortMapY.empty());
 			cv::remap(cpp_rangeImage, undistortedData, m_undistortMapX, m_undistortMapY, cv::INTER_LINEAR);
 		}
-
-		if (releaseNecessary) cvReleaseImage(&rangeImage);
 	} // End if (rangeImage)
 ///***********************************************************************
 // Gray image based on amplitude or intensity (distorted or undistorted)
@@ -697,63 +681,9 @@ unsigned long VirtualRangeCam::AcquireImages(int widthStepRange, int widthStepGr
 		float* f_ptr_dst = 0;
 		unsigned char* uc_ptr = 0;
 		unsigned char* uc_ptr_dst = 0;
-		cv::Mat grayMat;
-		IplImage grayIpl;
+		// intensity or amplitude image
+		IplImage grayIpl = (IplImage)frame[(grayImageType == ipa_CameraSensors::INTENSITY) ? REPLAY_INTENSITY : REPLAY_AMPLITUDE];
 		IplImage* grayImage = &grayIpl;
-		bool releaseNecessary = false;
-
-		// load image
-		if (grayImageType == ipa_CameraSensors::INTENSITY)
-		{
-			// intensity image
-			if (m_IntensityImageFileNames[m_ImageCounter].find(".bin") != std::string::npos)
-			{
-				ipa_Utils::LoadMat(grayMat, m_IntensityImageFileNames[m_ImageCounter]);
-				grayIpl = (IplImage)grayMat;
-			}
-			else if (m_IntensityImageFileNames[m_ImageCounter].find(".xml") != std::string::npos)
-			{
-				grayImage = (IplImage*) cvLoad(m_IntensityImageFileNames[m_ImageCounter].c_str());
-				releaseNecessary = true;
-			}
-			else if ((m_IntensityImageFileNames[m_ImageCounter].find(".png") != std::string::npos) || (m_IntensityImageFileNames[m_ImageCounter].find(".bmp") != std::string::npos) ||
-					(m_IntensityImageFileNames[m_ImageCounter].find(".jpg") != std::string::npos))
-			{
-				grayMat = cv::imread(m_IntensityImageFileNames[m_ImageCounter], -1);
-				grayIpl = (IplImage)grayMat;
-			}
-			else
-			{
-				std::cerr << "ERROR - VirtualRangeCam::AcquireImages:\n";
-				std::cerr << "\t ... Wrong file format for file " << m_IntensityImageFileNames[m_ImageCounter] << ".\n";
-				CV_Assert(false);
-			}
-		}
-		else if (grayImageType == ipa_CameraSensors::AMPLITUDE)
-		{
-			// amplitude image
-			if (m_AmplitudeImageFileNames[m_ImageCounter].find(".bin") != std::string::npos)
-			{
-				ipa_Utils::LoadMat(grayMat, m_AmplitudeImageFileNames[m_ImageCounter]);
-				grayIpl = (IplImage)grayMat;
-			}
-			else if (m_AmplitudeImageFileNames[m_ImageCounter].find(".xml") != std::string::npos)
-			{
-				grayImage = (IplImage*) cvLoad(m_AmplitudeImageFileNames[m_ImageCounter].c_str());
-				releaseNecessary = true;
-			}
-			else
-			{
-				std::cerr << "ERROR - VirtualRangeCam::AcquireImages:\n";
-				std::cerr << "\t ... Wrong file format for file " << m_AmplitudeImageFileNames[m_ImageCounter] << ".\n";
-				CV_Assert(false);
-			}
-		}
-		else
-		{
-			std::cerr << "ERROR - VirtualRangeCam::AcquireImages:\n";
-			std::cerr << "\t ... value of 'grayImageType' unknown.\n";
-		}
 		
 		// process image
 		if (!undistort)
@@ -796,8 +726,6 @@ unsigned long VirtualRangeCam::AcquireImages(int widthStepRange, int widthStepGr
 			assert (!m_undistortMapX.empty() && !m_undistortMapY.empty());
 			cv::remap(cpp_grayImage, undistortedData, m_undistortMapX, m_undistortMapY, cv::INTER_LINEAR);
 		}
-
-		if (releaseNecessary) cvReleaseImage(&grayImage);
 	}
 ///***********************************************************************
 // Cartesian image (always undistorted)
@@ -809,7 +737,6 @@ unsigned long VirtualRangeCam::AcquireImages(int widthStepRange, int widthStepGr
 		float zCalibrated = -1;
 		float* f_ptr = 0;
 		float* f_ptr_dst = 0;
-		bool releaseNecessary = false;
 
 		if(m_CalibrationMethod==MATLAB)
 		{
@@ -820,25 +747,8 @@ unsigned long VirtualRangeCam::AcquireImages(int widthStepRange, int widthStepGr
 			// XYZ image is assumed to be undistorted
 			// Unfortunately we have no access to the swissranger calibration
 
-			cv::Mat coordinateMat;
-			IplImage coordinateIpl;
+			IplImage coordinateIpl = (IplImage)frame[REPLAY_COORDINATE];
 			IplImage* coordinateImage = &coordinateIpl;
-			if (m_CoordinateImageFileNames[m_ImageCounter].find(".bin") != std::string::npos)
-			{
-				ipa_Utils::LoadMat(coordinateMat, m_CoordinateImageFileNames[m_ImageCounter]);
-				coordinateIpl = (IplImage)coordinateMat;
-			}
-			else if (m_CoordinateImageFileNames[m_ImageCounter].find(".xml") != std::string::npos)
-			{
-				coordinateImage = (IplImage*) cvLoad(m_CoordinateImageFileNames[m_ImageCounter].c_str(), 0);
-				releaseNecessary = true;
-			}
-			else
-			{
-				std::cerr << "ERROR - VirtualRangeCam::AcquireImages:\n";
-				std::cerr << "\t ... Wrong file format for file " << m_CoordinateImageFileNames[m_ImageCounter] << ".\n";
-				CV_Assert(false);
-			}
 
 			for(unsigned int row=0; row<(unsigned int)m_ImageHeight; row++)
 			{
@@ -862,29 +772,11 @@ unsigned long VirtualRangeCam::AcquireImages(int widthStepRange, int widthStepGr
 					}
 				}
 			}
-			if (releaseNecessary) cvReleaseImage(&coordinateImage);
 		}
 		else if(m_CalibrationMethod==NATIVE)
 		{
-			cv::Mat coordinateMat;
-			IplImage coordinateIpl;
+			IplImage coordinateIpl = (IplImage)frame[REPLAY_COORDINATE];
 			IplImage* coordinateImage = &coordinateIpl;
-			if (m_CoordinateImageFileNames[m_ImageCounter].find(".bin") != std::string::npos)
-			{
-				ipa_Utils::LoadMat(coordinateMat, m_CoordinateImageFileNames[m_ImageCounter]);
-				coordinateIpl = (IplImage)coordinateMat;
-			}
-			else if (m_CoordinateImageFileNames[m_ImageCounter].find(".xml") != std::string::npos)
-			{
-				coordinateImage = (IplImage*) cvLoad(m_CoordinateImageFileNames[m_ImageCounter].c_str(), 0);
-				releaseNecessary = true;
-			}
-			else
-			{
-				std::cerr << "ERROR - VirtualRangeCam::AcquireImages:\n";
-				std::cerr << "\t ... Wrong file format for file " << m_CoordinateImageFileNames[m_ImageCounter] << ".\n";
-				CV_Assert(false);
-			}
 
 			for(unsigned int row=0; row<(unsigned int)m_ImageHeight; row++)
 			{
@@ -900,7 +792,6 @@ unsigned long VirtualRangeCam::AcquireImages(int widthStepRange, int widthStepGr
 					f_ptr_dst[colTimes3 + 2] = f_ptr[colTimes3+2];
 				}
 			}
-			if (releaseNecessary) cvReleaseImage(&coordinateImage);
 		}
 		else
 		{
@@ -912,10 +803,10 @@ unsigned long VirtualRangeCam::AcquireImages(int widthStepRange, int widthStepGr
 
 	std::cout << m_ImageCounter << "        \r" << std::endl;
 	m_ImageCounter++;
-	if ((m_IntensityImageFileNames.size() != 0 && m_ImageCounter >= m_IntensityImageFileNames.size()) ||
-		(m_AmplitudeImageFileNames.size() != 0 && m_ImageCounter >= m_AmplitudeImageFileNames.size()) ||
-		(m_RangeImageFileNames.size() != 0 && m_ImageCounter >= m_RangeImageFileNames.size()) ||
-		(m_CoordinateImageFileNames.size() != 0 && m_ImageCounter >= m_CoordinateImageFileNames.size()))
+	if ((GetNumberOfImages(REPLAY_INTENSITY) != 0 && m_ImageCounter >= GetNumberOfImages(REPLAY_INTENSITY)) ||
+		(GetNumberOfImages(REPLAY_AMPLITUDE) != 0 && m_ImageCounter >= GetNumberOfImages(REPLAY_AMPLITUDE)) ||
+		(GetNumberOfImages(REPLAY_RANGE) != 0 && m_ImageCounter >= GetNumberOfImages(REPLAY_RANGE)) ||
+		(GetNumberOfImages(REPLAY_COORDINATE) != 0 && m_ImageCounter >= GetNumberOfImages(REPLAY_COORDINATE)))
 	{
 		// Reset image counter
 		m_ImageCounter = 0;
@@ -926,20 +817,20 @@ unsigned long VirtualRangeCam::AcquireImages(int widthStepRange, int widthStepGr
 
 int VirtualRangeCam::GetNumberOfImages()
 {
-	if (m_IntensityImageFileNames.size() == 0 && 
-		m_AmplitudeImageFileNames.size() == 0 &&
-		m_RangeImageFileNames.size() == 0 && 
-		m_CoordinateImageFileNames.size() == 0)
+	if (GetNumberOfImages(REPLAY_INTENSITY) == 0 &&
+		GetNumberOfImages(REPLAY_AMPLITUDE) == 0 &&
+		GetNumberOfImages(REPLAY_RANGE) == 0 &&
+		GetNumberOfImages(REPLAY_COORDINATE) == 0)
 	{
 		return 0;
 	}
 
 	int min=std::numeric_limits<int>::max();
 
-	if (m_IntensityImageFileNames.size() != 0) min = (int)std::min((float)min, (float)m_IntensityImageFileNames.size());
-	if (m_AmplitudeImageFileNames.size() != 0) min = (int)std::min((float)min, (float)m_AmplitudeImageFileNames.size());
-	if (m_RangeImageFileNames.size() != 0) min = (int)std::min((float)min, (float)m_RangeImageFileNames.size());
-	if (m_CoordinateImageFileNames.size() != 0) min = (int)std::min((float)min, (float)m_CoordinateImageFileNames.size());
+	if (GetNumberOfImages(REPLAY_INTENSITY) != 0) min = (int)std::min((float)min, (float)GetNumberOfImages(REPLAY_INTENSITY));
+	if (GetNumberOfImages(REPLAY_AMPLITUDE) != 0) min = (int)std::min((float)min, (float)GetNumberOfImages(REPLAY_AMPLITUDE));
+	if (GetNumberOfImages(REPLAY_RANGE) != 0) min = (int)std::min((float)min, (float)GetNumberOfImages(REPLAY_RANGE));
+	if (GetNumberOfImages(REPLAY_COORDINATE) != 0) min = (int)std::min((float)min, (float)GetNumberOfImages(REPLAY_COORDINATE));
 
 	return min;
 }
@@ -950,6 +841,10 @@ unsigned long VirtualRangeCam::ResetImages()
 	m_AmplitudeImageFileNames.clear();
 	m_RangeImageFileNames.clear();
 	m_CoordinateImageFileNames.clear();
+	m_Prefetcher.Stop();
+	m_PrefetchStreams = 0;
+	m_ReplayFile.Close();
+	m_UseReplayFile = false;
 	return ipa_Utils::RET_OK;
 }
 
@@ -959,6 +854,150 @@ unsigned long VirtualRangeCam::SetPathToImages(std::string path)
 	return ipa_Utils::RET_OK;
 }
 
+std::vector<std::string>& VirtualRangeCam::GetImageFileNames(t_ReplayStream stream)
+{
+	switch (stream)
+	{
+		case REPLAY_RANGE:
+			return m_RangeImageFileNames;
+		case REPLAY_INTENSITY:
+			return m_IntensityImageFileNames;
+		case REPLAY_AMPLITUDE:
+			return m_AmplitudeImageFileNames;
+		default:
+			return m_CoordinateImageFileNames;
+	}
+}
+
+size_t VirtualRangeCam::GetNumberOfImages(t_ReplayStream stream)
+{
+	if (m_UseReplayFile)
+	{
+		return (m_ReplayFile.GetImageType(stream) == -1) ? 0 : m_ReplayFile.GetNumberOfFrames();
+	}
+	return GetImageFileNames(stream).size();
+}
+
+unsigned long VirtualRangeCam::LoadImage(t_ReplayStream stream, int index, cv::Mat& image)
+{
+	if (m_UseReplayFile)
+	{
+		return m_ReplayFile.GetFrame(stream, index, image);
+	}
+
+	const std::string& filename = GetImageFileNames(stream)[index];
+	if (filename.find(".bin") != std::string::npos)
+	{
+		ipa_Utils::LoadMat(image, filename);
+	}
+	else if (filename.find(".xml") != std::string::npos)
+	{
+		IplImage* iplImage = (IplImage*) cvLoad(filename.c_str(), 0);
+		if (iplImage)
+		{
+			image = cv::Mat(iplImage, true);
+			cvReleaseImage(&iplImage);
+		}
+	}
+	else if (stream == REPLAY_INTENSITY && ((filename.find(".png") != std::string::npos) || (filename.find(".bmp") != std::string::npos) ||
+		(filename.find(".jpg") != std::string::npos)))
+	{
+		image = cv::imread(filename, -1);
+	}
+	else
+	{
+		std::cerr << "ERROR - VirtualRangeCam::LoadImage:\n";
+		std::cerr << "\t ... Wrong file format for file " << filename << ".\n";
+		return RET_FAILED;
+	}
+
+	if (image.empty())
+	{
+		std::cerr << "ERROR - VirtualRangeCam::LoadImage:\n";
+		std::cerr << "\t ... Could not load file " << filename << ".\n";
+		return RET_FAILED;
+	}
+	return RET_OK;
+}
+
+unsigned long VirtualRangeCam::LoadFrame(unsigned int streams, int index, std::vector<cv::Mat>& images)
+{
+	images.resize(REPLAY_NUM_STREAMS);
+	for (int stream=0; stream<REPLAY_NUM_STREAMS; stream++)
+	{
+		if ((streams & (1 << stream)) && (LoadImage((t_ReplayStream)stream, index, images[stream]) & RET_FAILED))
+		{
+			return RET_FAILED;
+		}
+	}
+	return RET_OK;
+}
+
+unsigned long VirtualRangeCam::AcquireFrame(unsigned int streams, std::vector<cv::Mat>& images)
+{
+	// Images of the replay file are mapped views, there is nothing to load ahead
+	if (m_PrefetchDepth <= 0 || m_UseReplayFile)
+	{
+		return LoadFrame(streams, m_ImageCounter, images);
+	}
+
+	// (Re)start whenever a stream is requested that is not loaded yet
+	if (!m_Prefetcher.isRunning() || (streams & ~m_PrefetchStreams) != 0)
+	{
+		m_PrefetchStreams |= streams;
+		if (m_Prefetcher.Start(boost::bind(&VirtualRangeCam::LoadFrame, this, m_PrefetchStreams, _1, _2),
+			GetNumberOfImages(), m_PrefetchDepth, m_PrefetchThreads) & RET_FAILED)
+		{
+			return RET_FAILED;
+		}
+	}
+
+	return m_Prefetcher.GetImages(m_ImageCounter, images);
+}
+
+unsigned long VirtualRangeCam::ExportReplayFile(std::string filename)
+{
+	if (!isOpen())
+	{
+		std::cerr << "ERROR - VirtualRangeCam::ExportReplayFile:" << std::endl;
+		std::cerr << "\t ... Camera not open." << std::endl;
+		return (RET_FAILED | RET_CAMERA_NOT_OPEN);
+	}
+
+	int types[REPLAY_NUM_STREAMS];
+	types[REPLAY_RANGE] = (GetNumberOfImages(REPLAY_RANGE) != 0) ? m_RangeImageImageType : -1;
+	types[REPLAY_INTENSITY] = (GetNumberOfImages(REPLAY_INTENSITY) != 0) ? m_IntensityImageType : -1;
+	types[REPLAY_AMPLITUDE] = (GetNumberOfImages(REPLAY_AMPLITUDE) != 0) ? m_AmplitudeImageType : -1;
+	types[REPLAY_COORDINATE] = (GetNumberOfImages(REPLAY_COORDINATE) != 0) ? m_CoordinateImageType : -1;
+
+	RangeCamReplayFileWriter writer;
+	if (writer.Open(filename, m_ImageWidth, m_ImageHeight, types) & RET_FAILED)
+	{
+		return RET_FAILED;
+	}
+
+	int numberOfImages = GetNumberOfImages();
+	for (int i=0; i<numberOfImages; i++)
+	{
+		cv::Mat frames[REPLAY_NUM_STREAMS];
+		for (int stream=0; stream<REPLAY_NUM_STREAMS; stream++)
+		{
+			if (types[stream] != -1 && (LoadImage((t_ReplayStream)stream, i, frames[stream]) & RET_FAILED))
+			{
+				return RET_FAILED;
+			}
+		}
+		if (writer.AppendFrame(frames) & RET_FAILED)
+		{
+			return RET_FAILED;
+		}
+	}
+
+	std::cout << "INFO - VirtualRangeCam::ExportReplayFile:" << std::endl;
+	std::cout << "\t ... Stored '" << numberOfImages << "' frames in '" << filename << "'" << std::endl;
+	return writer.Close();
+}
+
 unsigned long VirtualRangeCam::SaveParameters(const char* filename)
 {
 	return RET_FUNCTION_NOT_IMPLEMENTED;
@@ -1162,6 +1201,27 @@ unsigned long VirtualRangeCam::LoadParameters(const char* filename, int cameraIn
 					std::cerr << "\t ... Can't find tag 'CalibrationMethod'." << std::endl;
 					return (RET_FAILED | RET_XML_TAG_NOT_FOUND);
 				}
+
+//************************************************************************************
+//	BEGIN LibCameraSensors->VirtualRangeCam->Prefetch
+//************************************************************************************
+				// Subtag element "Prefetch" of Xml Inifile, optional
+				p_xmlElement_Child = NULL;
+				p_xmlElement_Child = p_xmlElement_Root_VirtualRangeCam->FirstChildElement( "Prefetch" );
+				if ( p_xmlElement_Child )
+				{
+					// read and save value of attributes
+					if ( p_xmlElement_Child->QueryIntAttribute( "depth", &m_PrefetchDepth ) != TIXML_SUCCESS)
+					{
+						std::cerr << "ERROR - VirtualRangeCam::LoadParameters:" << std::endl;
+						std::cerr << "\t ... Can't find attribute 'depth' of tag 'Prefetch'." << std::endl;
+						return (RET_FAILED | RET_XML_ATTR_NOT_FOUND);
+					}
+					if ( p_xmlElement_Child->QueryIntAttribute( "threads", &m_PrefetchThreads ) != TIXML_SUCCESS)
+					{
+						m_PrefetchThreads = 1;
+					}
+				}
 			}
 //************************************************************************************
 //	END LibCameraSensors->VirtualRangeCam
@@ -19,11 +19,10 @@
 //#### includes ####
 
 // standard includes
-//--
+#include <algorithm>
 
 // ROS includes
 #include <ros/ros.h>
-#include <cv_bridge/CvBridge.h>
 #include <image_transport/image_transport.h>
 #include <image_transport/subscriber_filter.h>
 #include <message_filters/subscriber.h>
@@ -37,12 +36,14 @@
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/CameraInfo.h>
 #include <sensor_msgs/fill_image.h>
+#include <sensor_msgs/image_encodings.h>
 
 #include <cob_camera_sensors/AcquireCalibrationImages.h>
 
 // external includes
 #include <cob_vision_utils/VisionUtils.h>
 
+#include <opencv/cv.h>
 #include <opencv/highgui.h>
 #include <boost/thread/mutex.hpp>
 
@@ -93,24 +94,18 @@ private:
 	sensor_msgs::Image xyz_image_msg_;
 	sensor_msgs::Image confidence_mask_msg_;
 
-	IplImage* right_color_image_8U3_;	///< Received color image of the right camera
-	IplImage* left_color_image_8U3_;	///< Received color image of the left camera
-	IplImage* xyz_image_32F3_;	///< Received point cloud form tof sensor
-	IplImage* grey_image_32F1_;	///< Received gray values from tof sensor
+	sensor_msgs::ImageConstPtr right_color_image_msg_;	///< Received color image of the right camera, holds the data of right_color_mat_8U3_
+	sensor_msgs::ImageConstPtr left_color_image_msg_;	///< Received color image of the left camera, holds the data of left_color_mat_8U3_
+	sensor_msgs::ImageConstPtr grey_image_msg_;	///< Received gray values from tof sensor, holds the data of grey_mat_32F1_
 
 	cv::Mat right_color_mat_8U3_;	///< Received color image of the right camera
 	cv::Mat left_color_mat_8U3_;	///< Received color image of the left camera
-	cv::Mat xyz_mat_32F3_;	///< Received point cloud form tof sensor
 	cv::Mat grey_mat_32F1_;	///< Received gray values from tof sensor
 	cv::Mat grey_mat_8U1_;	///< Received gray values from tof sensor
 	std::vector<cv::Mat> vec_grey_mat_32F1_; ///< Accumulated tof greyscale images for noise reduction
 
 	int image_counter_; ///< Counts the number of images saved to the hard disk
 
-	sensor_msgs::CvBridge cv_bridge_0_; ///< Converts ROS image messages to openCV IplImages
-	sensor_msgs::CvBridge cv_bridge_1_; ///< Converts ROS image messages to openCV IplImages
-	sensor_msgs::CvBridge cv_bridge_2_; ///< Converts ROS image messages to openCV IplImages
-
 	ros::ServiceServer save_camera_images_service_;
 
 	boost::mutex m_ServiceMutex;
@@ -120,6 +115,13 @@ private:
 	bool use_tof_camera_;
 	bool use_left_color_camera_;
 	bool use_right_color_camera_;
+
+	/// Preview mode: image sets are dropped to match <code>preview_rate_</code>
+	/// and color images are shown downsampled by <code>preview_scale_</code>
+	bool preview_;
+	double preview_rate_;	///< Maximal display rate in Hz
+	int preview_scale_;	///< Downsampling factor of the color images
+	ros::Time last_display_;	///< Time the last image set has been shown
 public:
 	/// Constructor.
 	AllCameraViewer(const ros::NodeHandle& node_handle)
@@ -134,17 +136,16 @@ public:
 	  stereo_sub_sync_(3),
 	  all_sub_sync_(3),
 #endif
-	  sub_counter_(0),
-	  right_color_image_8U3_(0),
-	  left_color_image_8U3_(0),
-	  xyz_image_32F3_(0),
-	  grey_image_32F1_(0)
+	  sub_counter_(0)
 	{
 		use_tof_camera_ = true;
 		use_left_color_camera_ = true;
 		use_right_color_camera_ = true;
 		image_counter_ = 0;
 		tof_image_counter_ = 0;
+		preview_ = false;
+		preview_rate_ = 5;
+		preview_scale_ = 4;
 	}
 
 	/// Destructor.
@@ -255,28 +256,16 @@ public:
 			const sensor_msgs::ImageConstPtr& right_camera_data,
 			const sensor_msgs::ImageConstPtr& tof_camera_grey_data)
 	{
+		if (dropPreviewFrame()) return;
 		ROS_INFO("[all_camera_viewer] allModeSrvCallback");
 		boost::mutex::scoped_lock lock(m_ServiceMutex);
-		// Convert ROS image messages to openCV IplImages
-		try
-		{
-			right_color_image_8U3_ = cv_bridge_0_.imgMsgToCv(right_camera_data, "bgr8");
-			left_color_image_8U3_ = cv_bridge_1_.imgMsgToCv(left_camera_data, "bgr8");
-			grey_image_32F1_ = cv_bridge_2_.imgMsgToCv(tof_camera_grey_data, "passthrough");
-
-			cv::Mat tmp = right_color_image_8U3_;
-			right_color_mat_8U3_ = tmp.clone();
-
-			tmp = left_color_image_8U3_;
-			left_color_mat_8U3_ = tmp.clone();
-
-			tmp = grey_image_32F1_;
-			grey_mat_32F1_ = tmp.clone();
-		}
-		catch (sensor_msgs::CvBridgeException& e)
-		{
-			ROS_ERROR("[all_camera_viewer] Could not convert stereo images with cv_bridge.");
-		}
+		// Views on the message data, the messages are kept until the next image set
+		right_color_image_msg_ = right_camera_data;
+		left_color_image_msg_ = left_camera_data;
+		right_color_mat_8U3_ = imageView(*right_camera_data, true);
+		left_color_mat_8U3_ = imageView(*left_camera_data, true);
+		grey_image_msg_ = tof_camera_grey_data;
+		grey_mat_32F1_ = imageView(*tof_camera_grey_data, false);
 
 		// Modifies <code>grey_mat_8U1_</code> and <code>vec_grey_mat_32F1_</code>
 		// using <code>grey_mat_32F1_</code>
@@ -284,14 +273,10 @@ public:
 
 		cv::imshow("TOF grey data", grey_mat_8U1_);
 
-		cv::Mat right_color_8U3;
-		cv::resize(right_color_mat_8U3_, right_color_8U3, cv::Size(), 0.5, 0.5);
-		cv::imshow("Right color data", right_color_8U3);
+		showColorImage("Right color data", right_color_mat_8U3_);
 
-		cv::Mat left_color_8U3;
-		cv::resize(left_color_mat_8U3_, left_color_8U3, cv::Size(), 0.5, 0.5);
-		cv::imshow("Left color data", left_color_8U3);
-		cv::waitKey(50);
+		showColorImage("Left color data", left_color_mat_8U3_);
+		cv::waitKey(preview_ ? 1 : 50);
 
 		ROS_INFO("[all_camera_viewer] allModeSrvCallback [OK]");
 	}
@@ -301,35 +286,93 @@ public:
 	void sharedModeSrvCallback(const sensor_msgs::ImageConstPtr& right_camera_data,
 			const sensor_msgs::ImageConstPtr& tof_camera_grey_data)
 	{
+		if (dropPreviewFrame()) return;
 		boost::mutex::scoped_lock lock(m_ServiceMutex);
 		ROS_INFO("[all_camera_viewer] sharedModeSrvCallback");
-		// Convert ROS image messages to openCV IplImages
-		try
-		{
-			right_color_image_8U3_ = cv_bridge_0_.imgMsgToCv(right_camera_data, "passthrough");
-			grey_image_32F1_ = cv_bridge_2_.imgMsgToCv(tof_camera_grey_data, "passthrough");
+		// Views on the message data, the messages are kept until the next image set
+		right_color_image_msg_ = right_camera_data;
+		right_color_mat_8U3_ = imageView(*right_camera_data, false);
+		grey_image_msg_ = tof_camera_grey_data;
+		grey_mat_32F1_ = imageView(*tof_camera_grey_data, false);
+
+		// Modifies <code>grey_mat_8U1_</code> and <code>vec_grey_mat_32F1_</code>
+		// using <code>grey_mat_32F1_</code>
+		updateTofGreyscaleData();
+
+		cv::imshow("TOF grey data", grey_mat_8U1_);
 
-			cv::Mat tmp = right_color_image_8U3_;
-			right_color_mat_8U3_ = tmp.clone();
+		showColorImage("Right color data", right_color_mat_8U3_);
+		cv::waitKey(preview_ ? 1 : 1000);
+	}
 
-			tmp = grey_image_32F1_;
-			grey_mat_32F1_ = tmp.clone();
+	/// Returns a view on the pixels of an image message, without copy.
+	/// The message has to be kept as long as the view is used.
+	/// @param image_msg The image message
+	/// @param bgr Convert rgb8 color images to bgr8, this copies the image
+	/// @return The view, empty for unknown encodings
+	cv::Mat imageView(const sensor_msgs::Image& image_msg, bool bgr)
+	{
+		namespace enc = sensor_msgs::image_encodings;
+		int depth = -1;
+		switch (enc::bitDepth(image_msg.encoding))
+		{
+			case 8: depth = (image_msg.encoding.find("8S") != std::string::npos) ? CV_8S : CV_8U; break;
+			case 16: depth = (image_msg.encoding.find("16S") != std::string::npos) ? CV_16S : CV_16U; break;
+			case 32: depth = (image_msg.encoding.find("32S") != std::string::npos) ? CV_32S : CV_32F; break;
+			case 64: depth = CV_64F; break;
 		}
-		catch (sensor_msgs::CvBridgeException& e)
+		if (depth == -1 || image_msg.data.empty())
 		{
-			ROS_ERROR("[all_camera_viewer] Could not convert images with cv_bridge.");
+			ROS_ERROR("[all_camera_viewer] Image encoding '%s' not supported", image_msg.encoding.c_str());
+			return cv::Mat();
 		}
 
-		// Modifies <code>grey_mat_8U1_</code> and <code>vec_grey_mat_32F1_</code>
-		// using <code>grey_mat_32F1_</code>
-		updateTofGreyscaleData();
+		cv::Mat view(image_msg.height, image_msg.width, CV_MAKETYPE(depth, enc::numChannels(image_msg.encoding)),
+			const_cast<uint8_t*>(&image_msg.data[0]), image_msg.step);
+		if (bgr && image_msg.encoding == enc::RGB8)
+		{
+			cv::Mat bgr_view;
+			cv::cvtColor(view, bgr_view, CV_RGB2BGR);
+			return bgr_view;
+		}
+		return view;
+	}
 
-		cv::imshow("TOF grey data", grey_mat_8U1_);
+	/// Returns <code>true</code>, if the image set arrives within the preview period of the last shown set.
+	/// Dropped sets are not converted at all.
+	bool dropPreviewFrame()
+	{
+		if (!preview_ || preview_rate_ <= 0)
+		{
+			return false;
+		}
+		ros::Time now = ros::Time::now();
+		if (!last_display_.isZero() && now >= last_display_ && (now - last_display_).toSec() < 1.0/preview_rate_)
+		{
+			return true;
+		}
+		last_display_ = now;
+		return false;
+	}
 
-		cv::Mat right_color_8U3;
-		cv::resize(right_color_mat_8U3_, right_color_8U3, cv::Size(), 0.5, 0.5);
-		cv::imshow("Right color data", right_color_8U3);
-		cv::waitKey(1000);
+	/// Shows a color image at half size, or downsampled by the preview scale in preview mode.
+	void showColorImage(const std::string& window_name, const cv::Mat& color_mat_8U3)
+	{
+		if (color_mat_8U3.empty())
+		{
+			return;
+		}
+		cv::Mat color_8U3;
+		if (preview_)
+		{
+			// Picks every n-th pixel instead of averaging
+			cv::resize(color_mat_8U3, color_8U3, cv::Size(), 1.0/preview_scale_, 1.0/preview_scale_, cv::INTER_NEAREST);
+		}
+		else
+		{
+			cv::resize(color_mat_8U3, color_8U3, cv::Size(), 0.5, 0.5);
+		}
+		cv::imshow(window_name, color_8U3);
 	}
 
 	/// Accumulates tof greyscale images, computes the average image out of it
@@ -339,11 +382,12 @@ public:
 	{
 		cv::Mat filtered_grey_mat_32F1 = cv::Mat::zeros(grey_mat_32F1_.rows, grey_mat_32F1_.cols, CV_8UC1/*32FC1*/);
 
-		// Accumulate greyscale images to remove noise
+		// Accumulate greyscale images to remove noise.
+		// grey_mat_32F1_ is a view on the message, so it is copied into the buffer of the slot
 		if (vec_grey_mat_32F1_.size() <=  (unsigned int) tof_image_counter_)
-			vec_grey_mat_32F1_.push_back(grey_mat_32F1_);
+			vec_grey_mat_32F1_.push_back(grey_mat_32F1_.clone());
 		else
-			vec_grey_mat_32F1_[tof_image_counter_] = grey_mat_32F1_;
+			grey_mat_32F1_.copyTo(vec_grey_mat_32F1_[tof_image_counter_]);
 		// Update counter
 		tof_image_counter_ = (++tof_image_counter_)%5;
 
@@ -378,33 +422,19 @@ public:
 	void stereoModeSrvCallback(const sensor_msgs::ImageConstPtr& left_camera_data,
 			const sensor_msgs::ImageConstPtr& right_camera_data)
 	{
+		if (dropPreviewFrame()) return;
 		ROS_INFO("[all_camera_viewer] stereoModeSrvCallback");
 		boost::mutex::scoped_lock lock(m_ServiceMutex);
-		// Convert ROS image messages to openCV IplImages
-		try
-		{
-			right_color_image_8U3_ = cv_bridge_0_.imgMsgToCv(right_camera_data, "passthrough");
-			left_color_image_8U3_ = cv_bridge_1_.imgMsgToCv(left_camera_data, "passthrough");
+		// Views on the message data, the messages are kept until the next image set
+		right_color_image_msg_ = right_camera_data;
+		left_color_image_msg_ = left_camera_data;
+		right_color_mat_8U3_ = imageView(*right_camera_data, false);
+		left_color_mat_8U3_ = imageView(*left_camera_data, false);
 
-			cv::Mat tmp = right_color_image_8U3_;
-			right_color_mat_8U3_ = tmp.clone();
+		showColorImage("Right color data", right_color_mat_8U3_);
 
-			tmp = left_color_image_8U3_;
-			left_color_mat_8U3_ = tmp.clone();
-		}
-		catch (sensor_msgs::CvBridgeException& e)
-		{
-			ROS_ERROR("[all_camera_viewer] Could not convert stereo images with cv_bridge.");
-		}
-
-		cv::Mat right_color_8U3;
-		cv::resize(right_color_mat_8U3_, right_color_8U3, cv::Size(), 0.5, 0.5);
-		cv::imshow("Right color data", right_color_8U3);
-
-		cv::Mat left_color_8U3;
-		cv::resize(left_color_mat_8U3_, left_color_8U3, cv::Size(), 0.5, 0.5);
-		cv::imshow("Left color data", left_color_8U3);
-		cv::waitKey(1000);
+		showColorImage("Left color data", left_color_mat_8U3_);
+		cv::waitKey(preview_ ? 1 : 1000);
 
 		ROS_INFO("[all_camera_viewer] stereoModeSrvCallback [OK]");
 	}
@@ -504,6 +534,12 @@ public:
 		}
 		ROS_INFO("use left color camera: %d", use_left_color_camera_);
 
+		node_handle_.param("all_camera_viewer/preview", preview_, false);
+		node_handle_.param("all_camera_viewer/preview_rate", preview_rate_, 5.0);
+		node_handle_.param("all_camera_viewer/preview_scale", preview_scale_, 4);
+		preview_scale_ = std::max(preview_scale_, 1);
+		if (preview_) ROS_INFO("preview at %.1f Hz, downsampled by %d", preview_rate_, preview_scale_);
+
 		return true;
 	}
 
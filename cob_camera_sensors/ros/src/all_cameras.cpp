@@ -19,25 +19,39 @@
 //#### includes ####
 
 // standard includes
-//--
+#include <algorithm>
+#include <cmath>
 
 // ROS includes
 #include <ros/ros.h>
-#include <cv_bridge/CvBridge.h>
 #include <image_transport/image_transport.h>
 
 // ROS message includes
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/CompressedImage.h>
 #include <sensor_msgs/fill_image.h>
+#include <sensor_msgs/image_encodings.h>
+#include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/SetCameraInfo.h>
 
 // external includes
 #include <cob_camera_sensors/AbstractColorCamera.h>
 #include <cob_camera_sensors/AbstractRangeImagingSensor.h>
+#include <cob_camera_sensors/DepthRegistration.h>
+#include <cob_camera_sensors/FramePool.h>
+#include <cob_camera_sensors/ImageEncoder.h>
 #include <cob_vision_utils/GlobalDefines.h>
 #include <cob_vision_utils/CameraSensorToolbox.h>
 
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
 using namespace ipa_CameraSensors;
 
 /// @class CobColorCameraNode
@@ -45,6 +59,19 @@ using namespace ipa_CameraSensors;
 class CobAllCamerasNode
 {
 private:
+	/// Latest image of a sensor, handed from its capture thread to the publishing thread.
+	/// The camera writes directly into pooled messages, which are handed over by swapping
+	/// the message pointers, so no buffer is shared between threads.
+	struct CapturedFrame
+	{
+		sensor_msgs::ImagePtr image_1;	///< Color image or xyz image
+		sensor_msgs::ImagePtr image_2;	///< Grey image of the tof camera
+		ros::Time stamp;	///< Capture time of the image
+		bool available;	///< Frame not published yet
+
+		CapturedFrame() : available(false) {}
+	};
+
 	ros::NodeHandle node_handle_;
 
 	AbstractColorCameraPtr left_color_camera_;	///< Color camera instance
@@ -73,34 +100,67 @@ private:
 	ros::ServiceServer right_color_camera_info_service_;
 	ros::ServiceServer tof_camera_info_service_;
 
-	cv::Mat left_color_image_8U3_;	///< color image of left camera
-	cv::Mat right_color_image_8U3_;	///< color image of right camera
-	cv::Mat xyz_tof_image_32F3_;      /// OpenCV image holding the point cloud from tof sensor
-	cv::Mat grey_tof_image_32F1_;     /// OpenCV image holding the amplitude values of the point cloud
-
 	image_transport::ImageTransport image_transport_;	///< Image transport instance
 	image_transport::CameraPublisher xyz_tof_image_publisher_;	///< Publishes xyz image data
 	image_transport::CameraPublisher grey_tof_image_publisher_;	///< Publishes grey image data
 	image_transport::CameraPublisher left_color_image_publisher_;	///< Publishes grey image data
 	image_transport::CameraPublisher right_color_image_publisher_;	///< Publishes grey image data
 
+	/// Image messages are reused once all subscribers released them
+	ipa_CameraSensors::FramePool<sensor_msgs::Image> image_pool_;
+
+	bool publish_registered_cloud_;	///< Publish the tof points colored by the right color camera
+	double registration_max_delay_;	///< Maximal time between tof and color image of a registered cloud in s
+	ros::Publisher registered_cloud_publisher_;	///< Publishes xyz and rgb of each tof point
+	ipa_CameraSensors::DepthRegistration depth_registration_;	///< Projection of tof points into the right color image
+	ipa_CameraSensors::FramePool<sensor_msgs::PointCloud2> point_cloud2_pool_;
+	sensor_msgs::ImageConstPtr registration_color_image_;	///< Latest right color image
+
+	bool publish_compressed_;	///< Publish compressed color images encoded by the node itself
+	std::string compressed_format_;	///< "jpeg" or "png"
+	int compressed_quality_;	///< JPEG quality or PNG compression level
+	double compressed_max_rate_;	///< Maximal rate of compressed images per camera in Hz, 0 for no limit
+	ros::Publisher left_compressed_publisher_;
+	ros::Publisher right_compressed_publisher_;
+	ipa_CameraSensors::ImageEncoder left_encoder_;	///< Compresses the left color images in its own thread
+	ipa_CameraSensors::ImageEncoder right_encoder_;	///< Compresses the right color images in its own thread
+	cv::Mat registered_color_image_8U3_;	///< Color of each tof point
+
+	boost::thread_group capture_threads_;	///< One acquisition thread per sensor
+	boost::scoped_ptr<boost::barrier> stereo_barrier_;	///< Releases both color cameras together for synchronous stereo images
+	boost::atomic<bool> capture_failed_;	///< Set by a capture thread, if its sensor failed
+
+	boost::mutex frame_mutex_;	///< Protects the captured frames
+	boost::condition_variable frame_condition_;	///< Signaled, when a new frame has been captured
+	CapturedFrame left_color_frame_;
+	CapturedFrame right_color_frame_;
+	CapturedFrame tof_frame_;
+
 public:
 	CobAllCamerasNode(const ros::NodeHandle& node_handle)
 	: node_handle_(node_handle),
 	  left_color_camera_(AbstractColorCameraPtr()),
 	  right_color_camera_(AbstractColorCameraPtr()),
 	  tof_camera_(AbstractRangeImagingSensorPtr()),
-	  left_color_image_8U3_(cv::Mat()),
-	  right_color_image_8U3_(cv::Mat()),
-	  xyz_tof_image_32F3_(cv::Mat()),
-	  grey_tof_image_32F1_(cv::Mat()),
-	  image_transport_(node_handle)
+	  image_transport_(node_handle),
+	  image_pool_(12),
+	  publish_registered_cloud_(false),
+	  registration_max_delay_(0.05),
+	  publish_compressed_(false),
+	  compressed_quality_(80),
+	  compressed_max_rate_(0),
+	  point_cloud2_pool_(3),
+	  capture_failed_(false)
 	{
 		/// Void
 	}
 
 	~CobAllCamerasNode()
 	{
+		stopCapture();
+		left_encoder_.Stop();
+		right_encoder_.Stop();
+
 		ROS_INFO("[all_cameras] Shutting down cameras");
 		if (left_color_camera_)
 		{
@@ -302,7 +362,78 @@ public:
 			xyz_tof_image_publisher_ = image_transport_.advertiseCamera(tof_camera_ns_ + "/image_xyz", 1);
 			tof_camera_info_service_ = node_handle_.advertiseService(tof_camera_ns_ + "/set_camera_info", &CobAllCamerasNode::setCameraInfo, this);
 		}
+		if (publish_compressed_)
+		{
+			// Published beside image_color, so image_transport plugins on image_color are not involved
+			if (left_color_camera_)
+			{
+				left_compressed_publisher_ = node_handle_.advertise<sensor_msgs::CompressedImage>(left_color_camera_ns_ + "/left/image_color_compressed", 1);
+				left_encoder_.Start(boost::bind(&CobAllCamerasNode::publishCompressedImage, this, boost::ref(left_compressed_publisher_),
+					std::string("head_color_camera_l_link"), _1, _2), compressed_format_, compressed_quality_, compressed_max_rate_);
+			}
+			if (right_color_camera_)
+			{
+				right_compressed_publisher_ = node_handle_.advertise<sensor_msgs::CompressedImage>(right_color_camera_ns_ + "/right/image_color_compressed", 1);
+				right_encoder_.Start(boost::bind(&CobAllCamerasNode::publishCompressedImage, this, boost::ref(right_compressed_publisher_),
+					std::string("head_color_camera_r_link"), _1, _2), compressed_format_, compressed_quality_, compressed_max_rate_);
+			}
+		}
+		if (publish_registered_cloud_)
+		{
+			if (!tof_camera_ || !right_color_camera_)
+			{
+				ROS_WARN("[all_cameras] Registered point cloud needs the tof and the right color camera");
+			}
+			else if (initRegistration())
+			{
+				registered_cloud_publisher_ = node_handle_.advertise<sensor_msgs::PointCloud2>(tof_camera_ns_ + "/point_cloud2_rgb", 1);
+			}
+		}
+
+		return true;
+	}
 
+	/// Sets up the projection of tof points into the right color image.
+	/// The pose of the right color camera in tof coordinates is read from the parameters
+	/// 'registration_rotation' (row major 3x3) and 'registration_translation' (m).
+	/// @return <code>false</code> on failure, <code>true</code> otherwise
+	bool initRegistration()
+	{
+		std::vector<double> rotation;
+		std::vector<double> translation;
+		node_handle_.param("all_cameras/registration_rotation", rotation, std::vector<double>());
+		node_handle_.param("all_cameras/registration_translation", translation, std::vector<double>());
+		if (rotation.empty() && translation.empty())
+		{
+			ROS_WARN("[all_cameras] Extrinsics of the registered point cloud not specified, assuming identity");
+		}
+		if (rotation.empty())
+		{
+			double identity[] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+			rotation.assign(identity, identity + 9);
+		}
+		if (translation.empty())
+		{
+			translation.assign(3, 0.0);
+		}
+		if (rotation.size() != 9 || translation.size() != 3)
+		{
+			ROS_ERROR("[all_cameras] 'registration_rotation' needs 9 and 'registration_translation' 3 values");
+			return false;
+		}
+
+		cv::Mat k(3, 3, CV_64FC1);
+		for (int i=0; i<9; i++)
+		{
+			k.at<double>(i/3, i%3) = right_color_camera_info_msg_.K[i];
+		}
+		cv::Size color_image_size(right_color_camera_info_msg_.width, right_color_camera_info_msg_.height);
+		if (depth_registration_.Init(k, color_image_size, cv::Mat(rotation).reshape(1, 3), cv::Mat(translation))
+			& ipa_CameraSensors::RET_FAILED)
+		{
+			ROS_ERROR("[all_cameras] Could not set up registration of tof and color camera");
+			return false;
+		}
 		return true;
 	}
 
@@ -322,139 +453,363 @@ public:
     		return true;
   	}
 
-	/// Callback function for image requests on topic 'request_image'
-	void spin()
+	/// Returns the capture time of a frame, or the current time if the driver provides none.
+	/// Driver timestamps are wall clock, so they are not used with simulated time.
+	ros::Time frameStamp(const ipa_CameraSensors::t_FrameInfo& frame_info)
 	{
-		// Set maximal spinning rate
-		ros::Rate rate(30);
-		while(node_handle_.ok())
+		if (frame_info.timestamp > 0 && !ros::Time::isSimTime())
 		{
-			// ROS images
-			sensor_msgs::Image right_color_image_msg;
-			sensor_msgs::Image left_color_image_msg;
-			sensor_msgs::Image xyz_tof_image_msg;
-			sensor_msgs::Image grey_tof_image_msg;
+			return ros::Time(frame_info.timestamp);
+		}
+		return ros::Time::now();
+	}
 
-			// ROS camera information messages
-			sensor_msgs::CameraInfo right_color_image_info;
-			sensor_msgs::CameraInfo left_color_image_info;
-			sensor_msgs::CameraInfo tof_image_info;
+	/// Takes a message from the pool and returns an image header on its data,
+	/// so that the camera writes the image directly into the message.
+	cv::Mat bindImageMessage(sensor_msgs::ImagePtr& image_msg_ptr, int rows, int cols, int type, const std::string& encoding)
+	{
+		image_msg_ptr = image_pool_.Get();
+		image_msg_ptr->height = rows;
+		image_msg_ptr->width = cols;
+		image_msg_ptr->encoding = encoding;
+		image_msg_ptr->is_bigendian = false;
+		image_msg_ptr->step = cols * CV_ELEM_SIZE(type);
+		image_msg_ptr->data.resize(rows * image_msg_ptr->step);
+		if (image_msg_ptr->data.empty())
+		{
+			return cv::Mat();
+		}
+		return cv::Mat(rows, cols, type, &image_msg_ptr->data[0], image_msg_ptr->step);
+	}
 
-			ros::Time now = ros::Time::now();
+	/// Copies the image into the message, if the camera did not write into the bound header
+	/// (i.e. the image size differs from the camera info).
+	void syncImageMessage(sensor_msgs::Image& image_msg, const cv::Mat& image)
+	{
+		if (!image_msg.data.empty() && image.data == &image_msg.data[0])
+		{
+			return;
+		}
+		cv::Mat continuous_image = image.isContinuous() ? image : image.clone();
+		sensor_msgs::fillImage(image_msg, image_msg.encoding, continuous_image.rows, continuous_image.cols,
+			continuous_image.cols * continuous_image.elemSize(), continuous_image.data);
+	}
 
-			// Acquire right color image
-			if (right_color_camera_)
+	/// Acquires images from a color camera until the node shuts down.
+	/// Stereo cameras wait for each other at the stereo barrier before each acquisition.
+	void captureColorImages(AbstractColorCameraPtr color_camera, CapturedFrame* frame,
+		const sensor_msgs::CameraInfo* camera_info_msg, std::string name)
+	{
+		// Set maximal acquisition rate
+		ros::Rate rate(30);
+		sensor_msgs::ImagePtr image_msg_ptr;
+		try
+		{
+			while(node_handle_.ok() && !capture_failed_)
 			{
-				//ROS_INFO("[all_cameras] RIGHT");
+				if (stereo_barrier_) stereo_barrier_->wait();
+
 				/// Acquire new image
-				if (right_color_camera_->GetColorImage(&right_color_image_8U3_, false) & ipa_Utils::RET_FAILED)
+				cv::Mat image = bindImageMessage(image_msg_ptr, camera_info_msg->height, camera_info_msg->width,
+					CV_8UC3, sensor_msgs::image_encodings::BGR8);
+				if (color_camera->GetColorImage(&image, false) & ipa_Utils::RET_FAILED)
 				{
-					ROS_ERROR("[all_cameras] Right color image acquisition failed");
+					ROS_ERROR("[all_cameras] %s color image acquisition failed", name.c_str());
+					capture_failed_ = true;
+					frame_condition_.notify_all();
 					break;
 				}
+				ros::Time stamp = frameStamp(color_camera->GetFrameInfo());
+				syncImageMessage(*image_msg_ptr, image);
 
-				try
-		  		{
-					IplImage img = right_color_image_8U3_;
-					right_color_image_msg = *(sensor_msgs::CvBridge::cvToImgMsg(&img, "bgr8"));
-				}
-				catch (sensor_msgs::CvBridgeException error)
 				{
-					ROS_ERROR("[all_cameras] Could not convert right IplImage to ROS message");
-					break;
+					boost::mutex::scoped_lock lock(frame_mutex_);
+					frame->image_1.swap(image_msg_ptr);
+					frame->stamp = stamp;
+					frame->available = true;
 				}
-				right_color_image_msg.header.stamp = now;
-				right_color_image_msg.encoding = "bgr8";
-				right_color_image_msg.header.frame_id = "head_color_camera_r_link";
+				frame_condition_.notify_all();
 
-				right_color_image_info = right_color_camera_info_msg_;
-				right_color_image_info.width = right_color_image_8U3_.cols;
-				right_color_image_info.height = right_color_image_8U3_.rows;
-				right_color_image_info.header.stamp = now;
-				right_color_image_info.header.frame_id = "head_color_camera_r_link";
+				rate.sleep();
+			}
+		}
+		catch (boost::thread_interrupted&)
+		{
+			// Interrupted while waiting for the other stereo camera
+		}
+	}
 
-				right_color_image_publisher_.publish(right_color_image_msg, right_color_image_info);
+	/// Acquires images from the tof camera until the node shuts down.
+	void captureTofImages()
+	{
+		// Set maximal acquisition rate
+		ros::Rate rate(30);
+		sensor_msgs::ImagePtr xyz_image_msg_ptr;
+		sensor_msgs::ImagePtr grey_image_msg_ptr;
+		while(node_handle_.ok() && !capture_failed_)
+		{
+			cv::Mat xyz_image = bindImageMessage(xyz_image_msg_ptr, tof_camera_info_msg_.height, tof_camera_info_msg_.width,
+				CV_32FC3, sensor_msgs::image_encodings::TYPE_32FC3);
+			cv::Mat grey_image = bindImageMessage(grey_image_msg_ptr, tof_camera_info_msg_.height, tof_camera_info_msg_.width,
+				CV_32FC1, sensor_msgs::image_encodings::TYPE_32FC1);
+			if(tof_camera_->AcquireImages(0, &grey_image, &xyz_image, false, false, ipa_CameraSensors::INTENSITY_32F1) & ipa_Utils::RET_FAILED)
+			{
+				ROS_ERROR("[all_cameras] Tof image acquisition failed");
+				capture_failed_ = true;
+				frame_condition_.notify_all();
+				break;
 			}
+			ros::Time stamp = frameStamp(tof_camera_->GetFrameInfo());
+			syncImageMessage(*xyz_image_msg_ptr, xyz_image);
+			syncImageMessage(*grey_image_msg_ptr, grey_image);
 
-			// Acquire left color image
-			if (left_color_camera_)
 			{
-				//ROS_INFO("[all_cameras] LEFT");
+				boost::mutex::scoped_lock lock(frame_mutex_);
+				tof_frame_.image_1.swap(xyz_image_msg_ptr);
+				tof_frame_.image_2.swap(grey_image_msg_ptr);
+				tof_frame_.stamp = stamp;
+				tof_frame_.available = true;
+			}
+			frame_condition_.notify_all();
 
-				/// Acquire new image
-				if (left_color_camera_->GetColorImage(&left_color_image_8U3_, false) & ipa_Utils::RET_FAILED)
+			rate.sleep();
+		}
+	}
+
+	/// Starts one capture thread per opened sensor.
+	void startCapture()
+	{
+		capture_failed_ = false;
+		if (left_color_camera_ && right_color_camera_)
+		{
+			stereo_barrier_.reset(new boost::barrier(2));
+		}
+		if (right_color_camera_)
+		{
+			capture_threads_.create_thread(boost::bind(&CobAllCamerasNode::captureColorImages, this, right_color_camera_, &right_color_frame_, &right_color_camera_info_msg_, std::string("Right")));
+		}
+		if (left_color_camera_)
+		{
+			capture_threads_.create_thread(boost::bind(&CobAllCamerasNode::captureColorImages, this, left_color_camera_, &left_color_frame_, &left_color_camera_info_msg_, std::string("Left")));
+		}
+		if (tof_camera_)
+		{
+			capture_threads_.create_thread(boost::bind(&CobAllCamerasNode::captureTofImages, this));
+		}
+	}
+
+	/// Stops and joins all capture threads.
+	void stopCapture()
+	{
+		capture_failed_ = true;
+		capture_threads_.interrupt_all();
+		capture_threads_.join_all();
+		stereo_barrier_.reset();
+	}
+
+	/// Publishes the images of the capture threads until the node shuts down.
+	void spin()
+	{
+		startCapture();
+
+		// Images taken out of the capture frames
+		CapturedFrame right_color_frame;
+		CapturedFrame left_color_frame;
+		CapturedFrame tof_frame;
+
+		while(node_handle_.ok() && !capture_failed_)
+		{
+			ros::spinOnce();
+
+			{
+				boost::mutex::scoped_lock lock(frame_mutex_);
+
+				// Stereo images are published as pair
+				bool stereo = left_color_camera_ && right_color_camera_;
+				bool color_available = stereo ?
+					(left_color_frame_.available && right_color_frame_.available) :
+					(left_color_frame_.available || right_color_frame_.available);
+				if (!color_available && !tof_frame_.available)
 				{
-					ROS_ERROR("[all_cameras] Left color image acquisition failed");
-					break;
+					frame_condition_.timed_wait(lock, boost::posix_time::milliseconds(100));
+					continue;
 				}
 
-				try
-		  		{
-					IplImage img = left_color_image_8U3_;
-					left_color_image_msg = *(sensor_msgs::CvBridge::cvToImgMsg(&img, "bgr8"));
-				}
-				catch (sensor_msgs::CvBridgeException error)
+				if (color_available)
 				{
-					ROS_ERROR("[all_cameras] Could not convert left IplImage to ROS message");
-					break;
+					right_color_frame.available = right_color_frame_.available;
+					left_color_frame.available = left_color_frame_.available;
+					if (right_color_frame_.available) right_color_frame.image_1.swap(right_color_frame_.image_1);
+					if (left_color_frame_.available) left_color_frame.image_1.swap(left_color_frame_.image_1);
+					right_color_frame.stamp = right_color_frame_.stamp;
+					left_color_frame.stamp = left_color_frame_.stamp;
+					right_color_frame_.available = false;
+					left_color_frame_.available = false;
+					if (stereo)
+					{
+						// Both images have been triggered together
+						right_color_frame.stamp = left_color_frame.stamp = std::min(right_color_frame.stamp, left_color_frame.stamp);
+					}
 				}
-				left_color_image_msg.header.stamp = now;
-				left_color_image_msg.encoding = "bgr8";
-				left_color_image_msg.header.frame_id = "head_color_camera_l_link";
 
-				left_color_image_info = left_color_camera_info_msg_;
-				left_color_image_info.width = left_color_image_8U3_.cols;
-				left_color_image_info.height = left_color_image_8U3_.rows;
-				left_color_image_info.header.stamp = now;
-				left_color_image_info.header.frame_id = "head_color_camera_l_link";
-
-				left_color_image_publisher_.publish(left_color_image_msg, left_color_image_info);
+				tof_frame.available = tof_frame_.available;
+				if (tof_frame_.available)
+				{
+					tof_frame.image_1.swap(tof_frame_.image_1);
+					tof_frame.image_2.swap(tof_frame_.image_2);
+					tof_frame.stamp = tof_frame_.stamp;
+					tof_frame_.available = false;
+				}
 			}
 
-			// Acquire image from tof camera
-			if (tof_camera_)
+			if (right_color_frame.available)
 			{
-				//ROS_INFO("[all_cameras] TOF");
-				if(tof_camera_->AcquireImages(0, &grey_tof_image_32F1_, &xyz_tof_image_32F3_, false, false, ipa_CameraSensors::INTENSITY_32F1) & ipa_Utils::RET_FAILED)
-				{
-					ROS_ERROR("[all_cameras] Tof image acquisition failed");
-					tof_camera_->Close();
-		      tof_camera_ = AbstractRangeImagingSensorPtr();
-					break;
-				}
+				right_color_frame.available = false;
+				if (depth_registration_.isInitialized()) registration_color_image_ = right_color_frame.image_1;
+				submitCompressedImage(right_color_frame, right_encoder_, right_compressed_publisher_);
+				publishColorImage(right_color_frame, right_color_image_publisher_, right_color_camera_info_msg_, "head_color_camera_r_link");
+			}
+			if (left_color_frame.available)
+			{
+				left_color_frame.available = false;
+				submitCompressedImage(left_color_frame, left_encoder_, left_compressed_publisher_);
+				publishColorImage(left_color_frame, left_color_image_publisher_, left_color_camera_info_msg_, "head_color_camera_l_link");
+			}
+			if (tof_frame.available)
+			{
+				tof_frame.available = false;
+				if (registered_cloud_publisher_.getNumSubscribers() > 0) publishRegisteredCloud(tof_frame);
+				publishTofImages(tof_frame);
+			}
+		} // END while-loop
 
-				try
-		                {
-					IplImage grey_img = grey_tof_image_32F1_;
-					IplImage xyz_img = xyz_tof_image_32F3_;
-		                        xyz_tof_image_msg = *(sensor_msgs::CvBridge::cvToImgMsg(&xyz_img, "passthrough"));
-		                        grey_tof_image_msg = *(sensor_msgs::CvBridge::cvToImgMsg(&grey_img, "passthrough"));
-		                }
-		                catch (sensor_msgs::CvBridgeException error)
-		                {
-		                        ROS_ERROR("[all_cameras] Could not convert tof IplImage to ROS message");
-					break;
-		                }
+		stopCapture();
+	}
 
-				xyz_tof_image_msg.header.stamp = now;
-				xyz_tof_image_msg.header.frame_id = "head_tof_link";
-				grey_tof_image_msg.header.stamp = now;
-				grey_tof_image_msg.header.frame_id = "head_tof_link";
+	/// Publishes the message of the frame, subscribers share the pooled message.
+	void publishColorImage(CapturedFrame& frame, image_transport::CameraPublisher& publisher,
+			const sensor_msgs::CameraInfo& camera_info_msg, const std::string& frame_id)
+	{
+		sensor_msgs::CameraInfoPtr color_image_info(new sensor_msgs::CameraInfo(camera_info_msg));
 
-				tof_image_info = tof_camera_info_msg_;
-				tof_image_info.width = grey_tof_image_32F1_.cols;
-				tof_image_info.height = grey_tof_image_32F1_.rows;
-				tof_image_info.header.stamp = now;
-				tof_image_info.header.frame_id = "head_tof_link";
+		frame.image_1->header.stamp = frame.stamp;
+		frame.image_1->header.frame_id = frame_id;
 
-				grey_tof_image_publisher_.publish(grey_tof_image_msg, tof_image_info);
-				xyz_tof_image_publisher_.publish(xyz_tof_image_msg, tof_image_info);
-			}
+		color_image_info->width = frame.image_1->width;
+		color_image_info->height = frame.image_1->height;
+		color_image_info->header.stamp = frame.stamp;
+		color_image_info->header.frame_id = frame_id;
 
-			ros::spinOnce();
-			rate.sleep();
+		publisher.publish(frame.image_1, color_image_info);
+		frame.image_1.reset();
+	}
 
-		} // END while-loop
+	/// Hands the color image of the frame to the encoder, if the compressed image has subscribers.
+	/// The encoder keeps a reference on the message until it has been encoded.
+	void submitCompressedImage(const CapturedFrame& frame, ipa_CameraSensors::ImageEncoder& encoder, const ros::Publisher& publisher)
+	{
+		if (!encoder.isRunning() || publisher.getNumSubscribers() == 0 || frame.image_1->data.empty())
+		{
+			return;
+		}
+		const sensor_msgs::Image& image_msg = *frame.image_1;
+		cv::Mat image(image_msg.height, image_msg.width, CV_8UC3, const_cast<unsigned char*>(&image_msg.data[0]), image_msg.step);
+		encoder.Submit(image, frame.stamp.toSec(), frame.image_1);
+	}
+
+	/// Publishes an image encoded by one of the encoder threads.
+	void publishCompressedImage(const ros::Publisher& publisher, const std::string& frame_id,
+			const std::vector<unsigned char>& data, double timestamp)
+	{
+		sensor_msgs::CompressedImagePtr compressed_msg(new sensor_msgs::CompressedImage());
+		compressed_msg->header.stamp = ros::Time(timestamp);
+		compressed_msg->header.frame_id = frame_id;
+		compressed_msg->format = "bgr8; " + compressed_format_ + " compressed bgr8";
+		compressed_msg->data = data;
+		publisher.publish(compressed_msg);
+	}
+
+	/// Publishes the tof points with the color of the latest right color image as x, y, z and rgb of 16 byte points.
+	/// Clouds are only published, if the color image has been taken within <code>registration_max_delay_</code>.
+	void publishRegisteredCloud(const CapturedFrame& frame)
+	{
+		if (!registration_color_image_ ||
+			std::fabs((registration_color_image_->header.stamp - frame.stamp).toSec()) > registration_max_delay_)
+		{
+			return;
+		}
+
+		const sensor_msgs::Image& xyz_msg = *frame.image_1;
+		const sensor_msgs::Image& color_msg = *registration_color_image_;
+		if (xyz_msg.data.empty() || color_msg.data.empty())
+		{
+			return;
+		}
+		cv::Mat xyz_image(xyz_msg.height, xyz_msg.width, CV_32FC3, const_cast<uint8_t*>(&xyz_msg.data[0]), xyz_msg.step);
+		cv::Mat color_image(color_msg.height, color_msg.width, CV_8UC3, const_cast<uint8_t*>(&color_msg.data[0]), color_msg.step);
+		if (depth_registration_.Register(xyz_image, color_image, registered_color_image_8U3_) & ipa_CameraSensors::RET_FAILED)
+		{
+			return;
+		}
+
+		sensor_msgs::PointCloud2Ptr pc_msg_ptr = point_cloud2_pool_.Get();
+		sensor_msgs::PointCloud2& pc_msg = *pc_msg_ptr;
+		pc_msg.header.stamp = frame.stamp;
+		pc_msg.header.frame_id = "head_tof_link";
+		pc_msg.width = xyz_image.cols;
+		pc_msg.height = xyz_image.rows;
+		pc_msg.fields.resize(4);
+		pc_msg.fields[0].name = "x";
+		pc_msg.fields[1].name = "y";
+		pc_msg.fields[2].name = "z";
+		pc_msg.fields[3].name = "rgb";
+		for (size_t d = 0; d < pc_msg.fields.size(); ++d)
+		{
+			pc_msg.fields[d].datatype = sensor_msgs::PointField::FLOAT32;
+			pc_msg.fields[d].offset = 4 * d;
+			pc_msg.fields[d].count = 1;
+		}
+		pc_msg.point_step = 16;
+		pc_msg.row_step = pc_msg.point_step * pc_msg.width;
+		pc_msg.data.resize(pc_msg.width*pc_msg.height*pc_msg.point_step);
+		pc_msg.is_dense = true;
+		pc_msg.is_bigendian = false;
+		if (pc_msg.data.empty())
+		{
+			return;
+		}
+
+		/// Interleave x, y, z and the packed color directly into the message buffer
+		cv::Mat points(pc_msg.height, pc_msg.width, CV_32FC4, &pc_msg.data[0], pc_msg.row_step);
+		const int xyz_from_to[] = { 0,0, 1,1, 2,2 };
+		cv::mixChannels(&xyz_image, 1, &points, 1, xyz_from_to, 3);
+		// rgb is stored as 0x00RRGGBB in little endian, i.e. the bytes b, g, r, 0
+		cv::Mat point_bytes(pc_msg.height, pc_msg.width, CV_8UC(16), &pc_msg.data[0], pc_msg.row_step);
+		const int rgb_from_to[] = { 0,12, 1,13, 2,14 };
+		cv::mixChannels(&registered_color_image_8U3_, 1, &point_bytes, 1, rgb_from_to, 3);
+
+		registered_cloud_publisher_.publish(pc_msg_ptr);
+	}
+
+	/// Publishes the messages of the frame, subscribers share the pooled messages.
+	void publishTofImages(CapturedFrame& frame)
+	{
+		sensor_msgs::CameraInfoPtr tof_image_info(new sensor_msgs::CameraInfo(tof_camera_info_msg_));
+
+		frame.image_1->header.stamp = frame.stamp;
+		frame.image_1->header.frame_id = "head_tof_link";
+		frame.image_2->header.stamp = frame.stamp;
+		frame.image_2->header.frame_id = "head_tof_link";
+
+		tof_image_info->width = frame.image_2->width;
+		tof_image_info->height = frame.image_2->height;
+		tof_image_info->header.stamp = frame.stamp;
+		tof_image_info->header.frame_id = "head_tof_link";
+
+		grey_tof_image_publisher_.publish(frame.image_2, tof_image_info);
+		xyz_tof_image_publisher_.publish(frame.image_1, tof_image_info);
+		frame.image_1.reset();
+		frame.image_2.reset();
 	}
 
 	bool loadParameters()
@@ -649,6 +1004,14 @@ public:
 
 		ROS_INFO("Intrinsic for tof camera: %s_%d", tmp_string.c_str(), tof_camera_intrinsic_id_);
 
+		node_handle_.param("all_cameras/publish_registered_cloud", publish_registered_cloud_, false);
+		node_handle_.param("all_cameras/registration_max_delay", registration_max_delay_, 0.05);
+
+		node_handle_.param("all_cameras/publish_compressed", publish_compressed_, false);
+		node_handle_.param<std::string>("all_cameras/compressed_format", compressed_format_, "jpeg");
+		node_handle_.param("all_cameras/compressed_quality", compressed_quality_, 80);
+		node_handle_.param("all_cameras/compressed_max_rate", compressed_max_rate_, 0.0);
+
 		return true;
 	}
 };
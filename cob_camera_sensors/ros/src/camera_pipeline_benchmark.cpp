@@ -0,0 +1,297 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+//##################
+//#### includes ####
+
+// standard includes
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// ROS includes
+#include <ros/time.h>
+#include <ros/serialization.h>
+
+// ROS message includes
+#include <sensor_msgs/PointCloud2.h>
+
+// external includes
+#include <opencv/cv.h>
+
+#include <cob_camera_sensors/DepthRegistration.h>
+#include <cob_camera_sensors/VirtualColorCam.h>
+#include <cob_camera_sensors/VirtualRangeCam.h>
+#include <cob_vision_utils/CameraSensorToolbox.h>
+
+/// Durations of one processing stage over all benchmarked frames.
+class StageTimes
+{
+public:
+	StageTimes(const std::string& name)
+	: name_(name)
+	{
+		/// Void
+	}
+
+	void add(const ros::WallDuration& duration)
+	{
+		durations_.push_back(duration.toSec() * 1000.0);
+	}
+
+	/// Prints latency percentiles in ms and the achievable frame rate of the stage.
+	void print()
+	{
+		if (durations_.empty())
+		{
+			return;
+		}
+		std::vector<double> sorted = durations_;
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0;
+		for (size_t i=0; i<sorted.size(); i++)
+		{
+			sum += sorted[i];
+		}
+
+		std::cout << std::left << std::setw(18) << name_ << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(10) << percentile(sorted, 0.5)
+			<< std::setw(10) << percentile(sorted, 0.9)
+			<< std::setw(10) << percentile(sorted, 0.99)
+			<< std::setw(10) << sorted.back()
+			<< std::setw(12) << std::setprecision(1) << (sum > 0 ? 1000.0 * sorted.size() / sum : 0) << std::endl;
+	}
+
+private:
+	static double percentile(const std::vector<double>& sorted, double fraction)
+	{
+		size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+		return sorted[index];
+	}
+
+	std::string name_;
+	std::vector<double> durations_;	///< Durations in ms
+};
+
+/// Interleaves xyz and confidence values into a cloud of 16 byte points, as the tof camera node does.
+void buildPointCloud2(const cv::Mat& xyz_image_32F3, const cv::Mat& confidence_image_32F1, sensor_msgs::PointCloud2& pc_msg)
+{
+	pc_msg.header.frame_id = "head_tof_link";
+	pc_msg.width = xyz_image_32F3.cols;
+	pc_msg.height = xyz_image_32F3.rows;
+	pc_msg.fields.resize(4);
+	pc_msg.fields[0].name = "x";
+	pc_msg.fields[1].name = "y";
+	pc_msg.fields[2].name = "z";
+	pc_msg.fields[3].name = "confidence";
+	for (size_t d = 0; d < pc_msg.fields.size(); ++d)
+	{
+		pc_msg.fields[d].datatype = sensor_msgs::PointField::FLOAT32;
+		pc_msg.fields[d].offset = 4 * d;
+		pc_msg.fields[d].count = 1;
+	}
+	pc_msg.point_step = 16;
+	pc_msg.row_step = pc_msg.point_step * pc_msg.width;
+	pc_msg.data.resize(pc_msg.width*pc_msg.height*pc_msg.point_step);
+	pc_msg.is_dense = true;
+	pc_msg.is_bigendian = false;
+
+	if (pc_msg.data.empty())
+	{
+		return;
+	}
+
+	cv::Mat points(pc_msg.height, pc_msg.width, CV_32FC4, &pc_msg.data[0], pc_msg.row_step);
+	const cv::Mat channels[] = { xyz_image_32F3, confidence_image_32F1 };
+	const int from_to[] = { 0,0, 1,1, 2,2, 3,3 };
+	cv::mixChannels(channels, 2, &points, 1, from_to, 4);
+}
+
+/// Runs the acquisition-to-publish pipeline of the camera nodes on the virtual cameras
+/// and prints per stage latency percentiles and throughput.
+/// The camera data directory must contain the configuration file 'cameraSensorsIni.xml'
+/// and the recorded images. Publishing is measured as serialization of the point cloud,
+/// which is what roscpp does for every message sent to another process.
+/// No ROS master is needed.
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <camera data directory> [number of frames] [camera index]" << std::endl;
+		return 1;
+	}
+
+	std::string directory = argv[1];
+	if (directory[directory.size()-1] != '/')
+	{
+		directory += "/";
+	}
+
+	int numberOfFrames = 300;
+	if (argc > 2)
+	{
+		std::stringstream ss(argv[2]);
+		ss >> numberOfFrames;
+	}
+
+	int cameraIndex = 0;
+	if (argc > 3)
+	{
+		std::stringstream ss(argv[3]);
+		ss >> cameraIndex;
+	}
+
+	ros::Time::init();
+
+	ipa_CameraSensors::VirtualRangeCam rangeCam;
+	if ((rangeCam.Init(directory, cameraIndex) & ipa_CameraSensors::RET_FAILED) ||
+		(rangeCam.Open() & ipa_CameraSensors::RET_FAILED))
+	{
+		std::cerr << "ERROR - camera_pipeline_benchmark:" << std::endl;
+		std::cerr << "\t ... Could not open virtual range camera." << std::endl;
+		return 1;
+	}
+
+	// The color camera is optional, its stage is skipped without recorded color images
+	ipa_CameraSensors::VirtualColorCam colorCam;
+	bool colorCamOpen = !(colorCam.Init(directory, cameraIndex) & ipa_CameraSensors::RET_FAILED) &&
+		!(colorCam.Open() & ipa_CameraSensors::RET_FAILED);
+	if (!colorCamOpen)
+	{
+		std::cout << "INFO - camera_pipeline_benchmark:" << std::endl;
+		std::cout << "\t ... No virtual color camera, color stage is skipped." << std::endl;
+	}
+
+	/// Setup undistortion as the tof camera node does
+	ipa_CameraSensors::t_cameraProperty cameraProperty;
+	cameraProperty.propertyID = ipa_CameraSensors::PROP_CAMERA_RESOLUTION;
+	rangeCam.GetProperty(&cameraProperty);
+	cv::Size rangeImageSize(cameraProperty.cameraResolution.xResolution, cameraProperty.cameraResolution.yResolution);
+
+	ipa_CameraSensors::CameraSensorToolboxPtr toolbox = ipa_CameraSensors::CreateCameraSensorToolbox();
+	if (toolbox->Init(directory, rangeCam.GetCameraType(), cameraIndex, rangeImageSize) & ipa_CameraSensors::RET_FAILED)
+	{
+		std::cerr << "ERROR - camera_pipeline_benchmark:" << std::endl;
+		std::cerr << "\t ... Could not read intrinsic parameters." << std::endl;
+		return 1;
+	}
+	cv::Mat intrinsicMatrix = toolbox->GetIntrinsicMatrix(rangeCam.GetCameraType(), cameraIndex);
+	cv::Mat distortionParameters = toolbox->GetDistortionParameters(rangeCam.GetCameraType(), cameraIndex);
+	cv::Mat map1, map2;
+	cv::initUndistortRectifyMap(intrinsicMatrix, distortionParameters, cv::Mat(), intrinsicMatrix,
+		rangeImageSize, CV_16SC2, map1, map2);
+
+	/// Registration cost does not depend on the extrinsics, both cameras are assumed at the same pose
+	ipa_CameraSensors::DepthRegistration registration;
+	if (colorCamOpen)
+	{
+		cameraProperty.propertyID = ipa_CameraSensors::PROP_CAMERA_RESOLUTION;
+		colorCam.GetProperty(&cameraProperty);
+		cv::Size colorImageSize(cameraProperty.cameraResolution.xResolution, cameraProperty.cameraResolution.yResolution);
+		ipa_CameraSensors::CameraSensorToolboxPtr colorToolbox = ipa_CameraSensors::CreateCameraSensorToolbox();
+		if (!(colorToolbox->Init(directory, colorCam.GetCameraType(), cameraIndex, colorImageSize) & ipa_CameraSensors::RET_FAILED))
+		{
+			registration.Init(colorToolbox->GetIntrinsicMatrix(colorCam.GetCameraType(), cameraIndex), colorImageSize,
+				cv::Mat::eye(3, 3, CV_64FC1), cv::Mat::zeros(3, 1, CV_64FC1));
+		}
+	}
+
+	StageTimes acquireTimes("AcquireImages");
+	StageTimes undistortTimes("Undistortion");
+	StageTimes pointCloudTimes("PointCloud2");
+	StageTimes publishTimes("Publish");
+	StageTimes colorTimes("GetColorImage");
+	StageTimes registrationTimes("Registration");
+	StageTimes totalTimes("Total");
+
+	cv::Mat xyzImage, greyImage, xyzImageUndistorted, greyImageUndistorted, colorImage, registeredImage;
+	sensor_msgs::PointCloud2 pcMsg;
+	std::vector<uint8_t> buffer;
+
+	ros::WallTime start = ros::WallTime::now();
+	for (int i=0; i<numberOfFrames; i++)
+	{
+		ros::WallTime t0 = ros::WallTime::now();
+		if (rangeCam.AcquireImages(0, &greyImage, &xyzImage, false, false, ipa_CameraSensors::INTENSITY_32F1) & ipa_CameraSensors::RET_FAILED)
+		{
+			std::cerr << "ERROR - camera_pipeline_benchmark:" << std::endl;
+			std::cerr << "\t ... Range image acquisition failed." << std::endl;
+			return 1;
+		}
+		ros::WallTime t1 = ros::WallTime::now();
+
+		cv::remap(xyzImage, xyzImageUndistorted, map1, map2, cv::INTER_LINEAR);
+		cv::remap(greyImage, greyImageUndistorted, map1, map2, cv::INTER_LINEAR);
+		ros::WallTime t2 = ros::WallTime::now();
+
+		buildPointCloud2(xyzImageUndistorted, greyImageUndistorted, pcMsg);
+		pcMsg.header.stamp = ros::Time::now();
+		ros::WallTime t3 = ros::WallTime::now();
+
+		uint32_t serializedLength = ros::serialization::serializationLength(pcMsg);
+		buffer.resize(serializedLength);
+		ros::serialization::OStream stream(&buffer[0], serializedLength);
+		ros::serialization::serialize(stream, pcMsg);
+		ros::WallTime t4 = ros::WallTime::now();
+
+		if (colorCamOpen)
+		{
+			if (colorCam.GetColorImage(&colorImage, false) & ipa_CameraSensors::RET_FAILED)
+			{
+				std::cerr << "ERROR - camera_pipeline_benchmark:" << std::endl;
+				std::cerr << "\t ... Color image acquisition failed." << std::endl;
+				return 1;
+			}
+		}
+		ros::WallTime t5 = ros::WallTime::now();
+
+		if (registration.isInitialized())
+		{
+			registration.Register(xyzImageUndistorted, colorImage, registeredImage);
+			registrationTimes.add(ros::WallTime::now() - t5);
+		}
+
+		acquireTimes.add(t1 - t0);
+		undistortTimes.add(t2 - t1);
+		pointCloudTimes.add(t3 - t2);
+		publishTimes.add(t4 - t3);
+		if (colorCamOpen) colorTimes.add(t5 - t4);
+		totalTimes.add(t5 - t0);
+	}
+	double elapsed = (ros::WallTime::now() - start).toSec();
+
+	std::cout << "Frames: " << numberOfFrames << ", " << rangeImageSize.width << "x" << rangeImageSize.height
+		<< ", throughput " << std::fixed << std::setprecision(1) << (elapsed > 0 ? numberOfFrames / elapsed : 0) << " fps" << std::endl;
+	std::cout << std::left << std::setw(18) << "Stage [ms]" << std::right
+		<< std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+		<< std::setw(10) << "max" << std::setw(12) << "fps" << std::endl;
+	acquireTimes.print();
+	undistortTimes.print();
+	pointCloudTimes.print();
+	publishTimes.print();
+	colorTimes.print();
+	registrationTimes.print();
+	totalTimes.print();
+
+	if (colorCamOpen) colorCam.Close();
+	rangeCam.Close();
+	return 0;
+}
@@ -24,19 +24,22 @@
 // ROS includes
 #include <ros/ros.h>
 #include <polled_camera/publication_server.h>
-#include <cv_bridge/CvBridge.h>
 
 // ROS message includes
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/CompressedImage.h>
 #include <sensor_msgs/fill_image.h>
 #include <sensor_msgs/SetCameraInfo.h>
 
 // external includes
 #include <cob_camera_sensors/AbstractColorCamera.h>
+#include <cob_camera_sensors/ImageEncoder.h>
 #include <cob_vision_utils/CameraSensorToolbox.h>
 #include <cob_vision_utils/GlobalDefines.h>
 
+#include <boost/bind.hpp>
+
 using namespace ipa_CameraSensors;
 
 /// @class CobColorCameraNode
@@ -60,11 +63,21 @@ private:
 
 	cv::Mat color_image_8U3_;
 
+	bool publish_compressed_;	///< Publish the polled images compressed by the node itself
+	std::string compressed_format_;	///< "jpeg" or "png"
+	int compressed_quality_;	///< JPEG quality or PNG compression level
+	double compressed_max_rate_;	///< Maximal rate of compressed images in Hz, 0 for no limit
+	ros::Publisher compressed_publisher_;
+	ipa_CameraSensors::ImageEncoder encoder_;	///< Compresses the polled images in its own thread
+
 public:
 	CobColorCameraNode(const ros::NodeHandle& node_handle)
 	: node_handle_(node_handle),
 	  color_camera_(AbstractColorCameraPtr()),
-	  color_image_8U3_(cv::Mat())
+	  color_image_8U3_(cv::Mat()),
+	  publish_compressed_(false),
+	  compressed_quality_(80),
+	  compressed_max_rate_(0)
 	{
 		/// Void
 	}
@@ -72,6 +85,7 @@ public:
 	~CobColorCameraNode()
 	{
 		image_poll_server_.shutdown();
+		encoder_.Stop();
 		color_camera_->Close();
 	}
 
@@ -150,6 +164,12 @@ public:
 
 		/// Topics to publish
 		image_poll_server_ = polled_camera::advertise(node_handle_, "request_image", &CobColorCameraNode::pollCallback, this);
+		if (publish_compressed_)
+		{
+			compressed_publisher_ = node_handle_.advertise<sensor_msgs::CompressedImage>("image_color_compressed", 1);
+			encoder_.Start(boost::bind(&CobColorCameraNode::publishCompressedImage, this, _1, _2),
+				compressed_format_, compressed_quality_, compressed_max_rate_);
+		}
 
 		return true;
 	}
@@ -170,12 +190,23 @@ public:
     		return true;
   	}
 
+	/// Returns the capture time of a frame, or the current time if the driver provides none.
+	/// Driver timestamps are wall clock, so they are not used with simulated time.
+	ros::Time frameStamp(const ipa_CameraSensors::t_FrameInfo& frame_info)
+	{
+		if (frame_info.timestamp > 0 && !ros::Time::isSimTime())
+		{
+			return ros::Time(frame_info.timestamp);
+		}
+		return ros::Time::now();
+	}
+
 	/// Callback function for image requests on topic 'request_image'
 	void pollCallback(polled_camera::GetPolledImage::Request& req,
 			polled_camera::GetPolledImage::Response& res,
 			sensor_msgs::Image& image_msg, sensor_msgs::CameraInfo& info)
 	{
-		/// Acquire new image
+		/// Images are only acquired and converted on request, there is no continuous publishing
 		if (color_camera_->GetColorImage(&color_image_8U3_) & ipa_Utils::RET_FAILED)
 		{
 			ROS_ERROR("[color_camera] Color image acquisition failed");
@@ -183,18 +214,13 @@ public:
 			return;
 		}
 
-		try
-  		{
-			IplImage img = color_image_8U3_;
-			image_msg = *(sensor_msgs::CvBridge::cvToImgMsg(&img, "bgr8"));
-		}
-		catch (sensor_msgs::CvBridgeException error)
-		{
-			ROS_ERROR("[color_camera] Could not convert IplImage to ROS message");
-		}
+		/// Copy once into the message handed out by the publication server
+		cv::Mat continuous_image = color_image_8U3_.isContinuous() ? color_image_8U3_ : color_image_8U3_.clone();
+		sensor_msgs::fillImage(image_msg, "bgr8", continuous_image.rows, continuous_image.cols,
+			continuous_image.cols * continuous_image.elemSize(), continuous_image.data);
 
 		/// Set time stamp
-		ros::Time now = ros::Time::now();
+		ros::Time now = frameStamp(color_camera_->GetFrameInfo());
 		image_msg.header.stamp = now;
 		if (camera_index_ == 0)
 			image_msg.header.frame_id = "head_color_camera_r_link";
@@ -202,6 +228,12 @@ public:
 			image_msg.header.frame_id = "head_color_camera_l_link";
 		image_msg.encoding = "bgr8";
 
+		/// The encoder gets its own copy, color_image_8U3_ is overwritten by the next request
+		if (encoder_.isRunning() && compressed_publisher_.getNumSubscribers() > 0)
+		{
+			encoder_.Submit(color_image_8U3_.clone(), now.toSec(), boost::shared_ptr<const void>());
+		}
+
 		info = camera_info_msg_;
 		info.width = color_image_8U3_.cols;
 		info.height = color_image_8U3_.rows;
@@ -215,6 +247,20 @@ public:
     return;
 	}
 
+	/// Publishes an image encoded by the encoder thread.
+	void publishCompressedImage(const std::vector<unsigned char>& data, double timestamp)
+	{
+		sensor_msgs::CompressedImagePtr compressed_msg(new sensor_msgs::CompressedImage());
+		compressed_msg->header.stamp = ros::Time(timestamp);
+		if (camera_index_ == 0)
+			compressed_msg->header.frame_id = "head_color_camera_r_link";
+		else
+			compressed_msg->header.frame_id = "head_color_camera_l_link";
+		compressed_msg->format = "bgr8; " + compressed_format_ + " compressed bgr8";
+		compressed_msg->data = data;
+		compressed_publisher_.publish(compressed_msg);
+	}
+
 	bool loadParameters()
 	{
 		std::string tmp_string = "NULL";
@@ -285,6 +331,11 @@ public:
 
 		ROS_INFO("Intrinsic for color camera: %s_%d", tmp_string.c_str(), color_camera_intrinsic_id_);
 
+		node_handle_.param("publish_compressed", publish_compressed_, false);
+		node_handle_.param<std::string>("compressed_format", compressed_format_, "jpeg");
+		node_handle_.param("compressed_quality", compressed_quality_, 80);
+		node_handle_.param("compressed_max_rate", compressed_max_rate_, 0.0);
+
 		return true;
 	}
 };
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+//##################
+//#### includes ####
+
+// standard includes
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// external includes
+#include <boost/filesystem.hpp>
+
+#include <cob_camera_sensors/VirtualRangeCam.h>
+
+/// Converts the recorded images of a virtual range camera directory into one replay file.
+/// The directory must contain the configuration file 'cameraSensorsIni.xml' used for recording.
+/// The replay file is stored as 'RangeCamReplay_<camera index>.replay' in the same directory,
+/// where the virtual range camera picks it up instead of the single image files.
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <camera data directory> [camera index]" << std::endl;
+		return 1;
+	}
+
+	std::string directory = argv[1];
+	if (directory[directory.size()-1] != '/')
+	{
+		directory += "/";
+	}
+
+	int cameraIndex = 0;
+	if (argc > 2)
+	{
+		std::stringstream ss(argv[2]);
+		ss >> cameraIndex;
+	}
+
+	std::stringstream ss;
+	ss << directory << "RangeCamReplay_" << cameraIndex << ".replay";
+	std::string replayFileName = ss.str();
+
+	// The camera would read the existing replay file instead of the image files
+	if (boost::filesystem::exists(replayFileName))
+	{
+		std::cerr << "ERROR - range_cam_replay_converter:" << std::endl;
+		std::cerr << "\t ... Replay file '" << replayFileName << "' already exists." << std::endl;
+		return 1;
+	}
+
+	ipa_CameraSensors::VirtualRangeCam camera;
+	if (camera.Init(directory, cameraIndex) & ipa_CameraSensors::RET_FAILED)
+	{
+		std::cerr << "ERROR - range_cam_replay_converter:" << std::endl;
+		std::cerr << "\t ... Could not initialize virtual range camera." << std::endl;
+		return 1;
+	}
+
+	if (camera.Open() & ipa_CameraSensors::RET_FAILED)
+	{
+		std::cerr << "ERROR - range_cam_replay_converter:" << std::endl;
+		std::cerr << "\t ... Could not open virtual range camera." << std::endl;
+		return 1;
+	}
+
+	if (camera.ExportReplayFile(replayFileName) & ipa_CameraSensors::RET_FAILED)
+	{
+		std::cerr << "ERROR - range_cam_replay_converter:" << std::endl;
+		std::cerr << "\t ... Could not write replay file '" << replayFileName << "'." << std::endl;
+		boost::filesystem::remove(replayFileName);
+		return 1;
+	}
+
+	camera.Close();
+	return 0;
+}
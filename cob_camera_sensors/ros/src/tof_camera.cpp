@@ -30,17 +30,24 @@
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/CameraInfo.h>
 #include <sensor_msgs/fill_image.h>
+#include <sensor_msgs/image_encodings.h>
 #include <sensor_msgs/SetCameraInfo.h>
 #include <sensor_msgs/PointCloud.h>
 #include <sensor_msgs/PointCloud2.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 
 #include <cob_camera_sensors/GetTOFImages.h>
 
 // external includes
 #include <cob_camera_sensors/AbstractRangeImagingSensor.h>
+#include <cob_camera_sensors/FramePool.h>
+#include <cob_camera_sensors/RangeCamRecorder.h>
+#include <cob_camera_sensors/SharedFrameRing.h>
 #include <cob_vision_utils/CameraSensorToolbox.h>
 #include <cob_vision_utils/GlobalDefines.h>
 #include <cob_vision_utils/VisionUtils.h>
+#include <cob_utilities/LatencyHistogram.h>
+#include <cob_utilities/Trace.h>
 
 #include <boost/thread/mutex.hpp>
 
@@ -79,8 +86,14 @@ private:
 	int upper_amplitude_threshold_;
 	double tearoff_tear_half_fraction_;
 
-	cv::Mat xyz_image_32F3_;	/// OpenCV image holding the point cloud
-	cv::Mat grey_image_32F1_;	/// OpenCV image holding the amplitude values
+	ipa_CameraSensors::t_RangeFrame tof_frame_;	/// Point cloud (cartesianImage) and amplitude values (grayImage), bound to the messages
+
+	/// Messages are reused once all subscribers released them, the images above
+	/// are headers on the data of the current messages
+	ipa_CameraSensors::FramePool<sensor_msgs::Image> image_pool_;
+	ipa_CameraSensors::FramePool<sensor_msgs::PointCloud2> point_cloud2_pool_;
+	sensor_msgs::ImagePtr xyz_image_msg_ptr_;	///< Message holding the data of tof_frame_.cartesianImage
+	sensor_msgs::ImagePtr grey_image_msg_ptr_;	///< Message holding the data of tof_frame_.grayImage
 
 	CobTofCameraNode::t_Mode ros_node_mode_;	///< Specifies if node is started as topic or service
 	boost::mutex service_mutex_;
@@ -88,16 +101,37 @@ private:
 	bool publish_point_cloud_;
 	bool publish_point_cloud_2_;
 
+	unsigned long last_sequence_number_;	///< Sequence number of the last published frame
+	bool images_complete_;	///< xyz and grey image are from the same, latest frame
+
+	std::string record_file_;	///< Replay file receiving all acquired frames, empty to disable recording
+	int record_buffer_frames_;	///< Number of frames buffered for the recorder
+	ipa_CameraSensors::RangeCamRecorder recorder_;
+
+	std::string shared_memory_name_;	///< Name of the frame ring for service requests with use_shared_memory
+	int shared_memory_slots_;	///< Number of frames in the ring
+	ipa_CameraSensors::SharedFrameRing shared_frame_ring_;	///< Created on the first request with use_shared_memory
+
+	ros::Publisher diagnostics_publisher_;	///< Publishes the timing histograms
+	LatencyHistogram frame_period_hist_;	///< Time between two acquired frames
+	LatencyHistogram acquisition_hist_;	///< Duration of acquireImages()
+	LatencyHistogram publish_hist_;	///< Duration of publishing all outputs of a frame
+	ros::WallTime last_frame_time_;	///< Time of the last acquired frame, zero before the first one
+
 public:
 	/// Constructor.
     CobTofCameraNode(const ros::NodeHandle& node_handle)
     : node_handle_(node_handle),
 	  image_transport_(node_handle),
       tof_camera_(AbstractRangeImagingSensorPtr()),
-      xyz_image_32F3_(cv::Mat()),
-      grey_image_32F1_(cv::Mat()),
+      image_pool_(6),
+      point_cloud2_pool_(3),
       publish_point_cloud_(false),
-      publish_point_cloud_2_(false)
+      publish_point_cloud_2_(false),
+      last_sequence_number_(0),
+      images_complete_(false),
+      record_buffer_frames_(30),
+      shared_memory_slots_(4)
     {
             /// Void
     }
@@ -105,6 +139,7 @@ public:
 	/// Destructor
 	~CobTofCameraNode()
     {
+	recorder_.Stop();
 	tof_camera_->Close();
     }
 
@@ -112,12 +147,15 @@ public:
 	/// @return <code>false</code> on failure, <code>true</code> otherwise
     bool init()
     {
+		int64_t phase_start = Trace::now();
 		if (loadParameters() == false)
 		{
 			ROS_ERROR("[color_camera] Could not read all parameters from launch file");
 			return false;
 		}
+		Trace::recordPhase("CobTofCameraNode::loadParameters", phase_start, Trace::now());
 
+		phase_start = Trace::now();
 
 		if (tof_camera_->Init(config_directory_, tof_camera_index_) & ipa_CameraSensors::RET_FAILED)
 		{
@@ -130,7 +168,9 @@ public:
 			tof_camera_ = AbstractRangeImagingSensorPtr();
 			return false;
 		}
+		Trace::recordPhase("CobTofCameraNode::initCamera", phase_start, Trace::now());
 
+		phase_start = Trace::now();
 		if (tof_camera_->Open() & ipa_CameraSensors::RET_FAILED)
 		{
 			std::stringstream ss;
@@ -140,6 +180,7 @@ public:
 			tof_camera_ = AbstractRangeImagingSensorPtr();
 			return false;
 		}
+		Trace::recordPhase("CobTofCameraNode::openCamera", phase_start, Trace::now());
 
 		/// Read camera properties of range tof sensor
 		ipa_CameraSensors::t_cameraProperty cameraProperty;
@@ -149,9 +190,23 @@ public:
 		int range_sensor_height = cameraProperty.cameraResolution.yResolution;
 		cv::Size range_image_size(range_sensor_width, range_sensor_height);
 
+		/// Record the unfiltered grey and xyz images in the format of the virtual range camera
+		if (!record_file_.empty())
+		{
+			int types[ipa_CameraSensors::REPLAY_NUM_STREAMS] = {-1, CV_32FC1, -1, CV_32FC3};
+			if (recorder_.Start(record_file_, range_sensor_width, range_sensor_height, types, record_buffer_frames_) & ipa_CameraSensors::RET_FAILED)
+			{
+				ROS_ERROR("[tof_camera] Could not start recording to '%s'", record_file_.c_str());
+				return false;
+			}
+			ROS_INFO("[tof_camera] Recording to '%s'", record_file_.c_str());
+		}
+
 		/// Setup camera toolbox
+		phase_start = Trace::now();
 		ipa_CameraSensors::CameraSensorToolboxPtr tof_sensor_toolbox = ipa_CameraSensors::CreateCameraSensorToolbox();
 		tof_sensor_toolbox->Init(config_directory_, tof_camera_->GetCameraType(), tof_camera_index_, range_image_size);
+		Trace::recordPhase("CobTofCameraNode::initToolbox", phase_start, Trace::now());
 
 		cv::Mat intrinsic_mat = tof_sensor_toolbox->GetIntrinsicMatrix(tof_camera_type_, tof_camera_index_);
 		cv::Mat distortion_map_X = tof_sensor_toolbox->GetDistortionMapX(tof_camera_type_, tof_camera_index_);
@@ -165,6 +220,7 @@ public:
 		grey_image_publisher_ = image_transport_.advertiseCamera("image_grey", 1);
 		if(publish_point_cloud_2_) topicPub_pointCloud2_ = node_handle_.advertise<sensor_msgs::PointCloud2>("point_cloud2", 1);
 		if(publish_point_cloud_) topicPub_pointCloud_ = node_handle_.advertise<sensor_msgs::PointCloud>("point_cloud", 1);
+		diagnostics_publisher_ = node_handle_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
 
 		cv::Mat d = tof_sensor_toolbox->GetDistortionParameters(tof_camera_type_, tof_camera_index_);
 		camera_info_msg_.header.stamp = ros::Time::now();
@@ -189,6 +245,7 @@ public:
 		camera_info_msg_.width = range_sensor_width;
 		camera_info_msg_.height = range_sensor_height;
 
+		ROS_INFO_STREAM("[tof_camera] Startup phases:\n" << Trace::getPhaseSummary());
 		return true;
 	}
 
@@ -208,71 +265,209 @@ public:
 		return true;
 	}
 
-    	/// Continuously advertises xyz and grey images.
-	bool spin()
+	/// Returns the capture time of a frame, or the current time if the driver provides none.
+	/// Driver timestamps are wall clock, so they are not used with simulated time.
+	ros::Time frameStamp(const ipa_CameraSensors::t_FrameInfo& frame_info)
 	{
-		boost::mutex::scoped_lock lock(service_mutex_);
-		sensor_msgs::Image::Ptr xyz_image_msg_ptr;
-		sensor_msgs::Image::Ptr grey_image_msg_ptr;
-		sensor_msgs::CameraInfo tof_image_info;
+		if (frame_info.timestamp > 0 && !ros::Time::isSimTime())
+		{
+			return ros::Time(frame_info.timestamp);
+		}
+		return ros::Time::now();
+	}
+
+	/// Takes a message from the pool and returns an image header on its data,
+	/// so that the camera writes the image directly into the message.
+	cv::Mat bindImageMessage(sensor_msgs::ImagePtr& image_msg_ptr, int rows, int cols, int type, const std::string& encoding)
+	{
+		image_msg_ptr = image_pool_.Get();
+		image_msg_ptr->height = rows;
+		image_msg_ptr->width = cols;
+		image_msg_ptr->encoding = encoding;
+		image_msg_ptr->is_bigendian = false;
+		image_msg_ptr->step = cols * CV_ELEM_SIZE(type);
+		image_msg_ptr->data.resize(rows * image_msg_ptr->step);
+		if (image_msg_ptr->data.empty())
+		{
+			return cv::Mat();
+		}
+		return cv::Mat(rows, cols, type, &image_msg_ptr->data[0], image_msg_ptr->step);
+	}
+
+	/// Copies the image into the message, if the camera did not write into the bound header
+	/// (i.e. the image size differs from the camera info).
+	void syncImageMessage(sensor_msgs::Image& image_msg, const cv::Mat& image)
+	{
+		if (!image_msg.data.empty() && image.data == &image_msg.data[0])
+		{
+			return;
+		}
+		cv::Mat continuous_image = image.isContinuous() ? image : image.clone();
+		sensor_msgs::fillImage(image_msg, image_msg.encoding, continuous_image.rows, continuous_image.cols,
+			continuous_image.cols * continuous_image.elemSize(), continuous_image.data);
+	}
+
+	/// Acquires the requested images directly into pooled messages and filters the xyz image.
+	/// Images not requested keep the data of an earlier frame.
+	/// @param acquire_grey Acquire the grey image
+	/// @param acquire_xyz Acquire the xyz image
+	/// @param frame_info Capture time and sequence number of the acquired frame
+	/// @return <code>false</code> on failure, <code>true</code> otherwise
+	bool acquireImages(bool acquire_grey, bool acquire_xyz, ipa_CameraSensors::t_FrameInfo& frame_info)
+	{
+		ipa_CameraSensors::t_RangeFrameRequest request(0, false, false, ipa_CameraSensors::INTENSITY_32F1);
+		if (acquire_xyz)
+		{
+			tof_frame_.cartesianImage = bindImageMessage(xyz_image_msg_ptr_, camera_info_msg_.height, camera_info_msg_.width,
+				CV_32FC3, sensor_msgs::image_encodings::TYPE_32FC3);
+			request.channels |= ipa_CameraSensors::CARTESIAN_CHANNEL;
+		}
+		if (acquire_grey)
+		{
+			tof_frame_.grayImage = bindImageMessage(grey_image_msg_ptr_, camera_info_msg_.height, camera_info_msg_.width,
+				CV_32FC1, sensor_msgs::image_encodings::TYPE_32FC1);
+			request.channels |= ipa_CameraSensors::GRAY_CHANNEL;
+		}
+		images_complete_ = false;
 
-		if(tof_camera_->AcquireImages(0, &grey_image_32F1_, &xyz_image_32F3_, false, false, ipa_CameraSensors::INTENSITY_32F1) & ipa_Utils::RET_FAILED)
+		if(tof_camera_->AcquireFrame(request, tof_frame_) & ipa_Utils::RET_FAILED)
 		{
 			ROS_ERROR("[tof_camera] Tof image acquisition failed");
 			return false;
 		}
 
-		/// Filter images by amplitude and remove tear-off edges
-		//if(filter_xyz_tearoff_edges_ || filter_xyz_by_amplitude_)
-		//	ROS_ERROR("[tof_camera] FUNCTION UNCOMMENT BY JSF");
-		if(filter_xyz_tearoff_edges_) ipa_Utils::FilterTearOffEdges(xyz_image_32F3_, 0, (float)tearoff_tear_half_fraction_);
-		if(filter_xyz_by_amplitude_) ipa_Utils::FilterByAmplitude(xyz_image_32F3_, grey_image_32F1_, 0, 0, lower_amplitude_threshold_, upper_amplitude_threshold_);
+		frame_info = tof_frame_.info;
+		if (last_sequence_number_ != 0 && frame_info.sequenceNumber > last_sequence_number_ + 1)
+		{
+			ROS_DEBUG("[tof_camera] Skipped %lu frames", frame_info.sequenceNumber - last_sequence_number_ - 1);
+		}
+		last_sequence_number_ = frame_info.sequenceNumber;
 
-		try
+		if (recorder_.isRunning() && acquire_grey && acquire_xyz)
 		{
-			IplImage img = xyz_image_32F3_;
-			xyz_image_msg_ptr = sensor_msgs::CvBridge::cvToImgMsg(&img, "passthrough");
+			cv::Mat frames[ipa_CameraSensors::REPLAY_NUM_STREAMS];
+			frames[ipa_CameraSensors::REPLAY_INTENSITY] = tof_frame_.grayImage;
+			frames[ipa_CameraSensors::REPLAY_COORDINATE] = tof_frame_.cartesianImage;
+			if (recorder_.Record(frames, frame_info) & ipa_CameraSensors::RET_FAILED)
+			{
+				ROS_DEBUG("[tof_camera] Frame %lu not recorded", frame_info.sequenceNumber);
+			}
 		}
-		catch (sensor_msgs::CvBridgeException error)
+
+		/// Filter images by amplitude and remove tear-off edges
+		if (acquire_xyz)
 		{
-			ROS_ERROR("[tof_camera] Could not convert 32bit xyz IplImage to ROS message");
-			return false;
+			if(filter_xyz_tearoff_edges_) ipa_Utils::FilterTearOffEdges(tof_frame_.cartesianImage, 0, (float)tearoff_tear_half_fraction_);
+			if(filter_xyz_by_amplitude_ && acquire_grey) ipa_Utils::FilterByAmplitude(tof_frame_.cartesianImage, tof_frame_.grayImage, 0, 0, lower_amplitude_threshold_, upper_amplitude_threshold_);
+			syncImageMessage(*xyz_image_msg_ptr_, tof_frame_.cartesianImage);
+		}
+		if (acquire_grey)
+		{
+			syncImageMessage(*grey_image_msg_ptr_, tof_frame_.grayImage);
 		}
 
-		try
+		images_complete_ = acquire_grey && acquire_xyz;
+		return true;
+	}
+
+	/// Continuously advertises xyz and grey images.
+	/// Only the outputs with subscribers are computed, and only the images they need are acquired.
+	bool spin()
+	{
+		boost::mutex::scoped_lock lock(service_mutex_);
+
+		bool publish_xyz = xyz_image_publisher_.getNumSubscribers() > 0;
+		bool publish_grey = grey_image_publisher_.getNumSubscribers() > 0;
+		bool publish_point_cloud = publish_point_cloud_ && topicPub_pointCloud_.getNumSubscribers() > 0;
+		bool publish_point_cloud_2 = publish_point_cloud_2_ && topicPub_pointCloud2_.getNumSubscribers() > 0;
+
+		// In service mode and while recording both images are kept up to date
+		bool acquire_all = ros_node_mode_ == CobTofCameraNode::MODE_SERVICE || recorder_.isRunning();
+		bool acquire_xyz = publish_xyz || publish_point_cloud || publish_point_cloud_2 || acquire_all;
+		bool acquire_grey = publish_grey || publish_point_cloud_2 || (acquire_xyz && filter_xyz_by_amplitude_) || acquire_all;
+		if (!acquire_xyz && !acquire_grey)
 		{
-			IplImage img = grey_image_32F1_;
-			grey_image_msg_ptr = sensor_msgs::CvBridge::cvToImgMsg(&img, "passthrough");
+			return true;
 		}
-		catch (sensor_msgs::CvBridgeException error)
+
+		ipa_CameraSensors::t_FrameInfo frame_info;
+		ros::WallTime acquisition_start = ros::WallTime::now();
+		if (!acquireImages(acquire_grey, acquire_xyz, frame_info))
 		{
-			ROS_ERROR("[tof_camera] Could not convert 32bit grey IplImage to ROS message");
 			return false;
 		}
+		ros::WallTime acquisition_end = ros::WallTime::now();
+		acquisition_hist_.recordSeconds((acquisition_end - acquisition_start).toSec());
+		if (!last_frame_time_.isZero())
+		{
+			frame_period_hist_.recordSeconds((acquisition_end - last_frame_time_).toSec());
+		}
+		last_frame_time_ = acquisition_end;
 
 		/// Set time stamp
-		ros::Time now = ros::Time::now();
-		xyz_image_msg_ptr->header.stamp = now;
-		xyz_image_msg_ptr->header.frame_id = "head_tof_link";
-		grey_image_msg_ptr->header.stamp = now;
-		grey_image_msg_ptr->header.frame_id = "head_tof_link";
-
-		tof_image_info = camera_info_msg_;
-		tof_image_info.width = grey_image_32F1_.cols;
-		tof_image_info.height = grey_image_32F1_.rows;
-		tof_image_info.header.stamp = now;
-		tof_image_info.header.frame_id = "head_tof_link";
-
-		/// publish message
-		xyz_image_publisher_.publish(*xyz_image_msg_ptr, tof_image_info);
-		grey_image_publisher_.publish(*grey_image_msg_ptr, tof_image_info);
+		ros::Time now = frameStamp(frame_info);
+		if (publish_xyz || publish_grey)
+		{
+			sensor_msgs::CameraInfoPtr tof_image_info(new sensor_msgs::CameraInfo(camera_info_msg_));
+			cv::Size image_size = acquire_grey ? tof_frame_.grayImage.size() : tof_frame_.cartesianImage.size();
+			tof_image_info->width = image_size.width;
+			tof_image_info->height = image_size.height;
+			tof_image_info->header.stamp = now;
+			tof_image_info->header.frame_id = "head_tof_link";
+
+			/// publish message, subscribers share the pooled messages
+			if (publish_xyz)
+			{
+				xyz_image_msg_ptr_->header.stamp = now;
+				xyz_image_msg_ptr_->header.frame_id = "head_tof_link";
+				xyz_image_publisher_.publish(xyz_image_msg_ptr_, tof_image_info);
+			}
+			if (publish_grey)
+			{
+				grey_image_msg_ptr_->header.stamp = now;
+				grey_image_msg_ptr_->header.frame_id = "head_tof_link";
+				grey_image_publisher_.publish(grey_image_msg_ptr_, tof_image_info);
+			}
+		}
 
-		if(publish_point_cloud_) publishPointCloud(now);
-		if(publish_point_cloud_2_) publishPointCloud2(now);
+		if(publish_point_cloud) publishPointCloud(now);
+		if(publish_point_cloud_2) publishPointCloud2(now);
 
+		publish_hist_.recordSeconds((ros::WallTime::now() - acquisition_end).toSec());
 		return true;
 	}
 
+	/// Publishes the timing histograms since the last call on /diagnostics.
+	/// Frames arriving later than twice the expected period count as overruns.
+	void publishDiagnostics(double expected_period)
+	{
+		std::vector<std::pair<std::string, std::string> > timing;
+		LatencyHistogram::Summary summary;
+		frame_period_hist_.getSummary(&summary, 2e6 * expected_period, true);
+		LatencyHistogram::appendKeyValues("frame period", summary, &timing);
+		uint64_t overruns = summary.uiOverruns;
+		acquisition_hist_.getSummary(&summary, 1e6 * expected_period, true);
+		LatencyHistogram::appendKeyValues("acquisition", summary, &timing);
+		publish_hist_.getSummary(&summary, 1e6 * expected_period, true);
+		LatencyHistogram::appendKeyValues("publish", summary, &timing);
+
+		diagnostic_msgs::DiagnosticArray diagnostics;
+		diagnostics.header.stamp = ros::Time::now();
+		diagnostics.status.resize(1);
+		diagnostics.status[0].name = ros::this_node::getName() + " timing";
+		diagnostics.status[0].hardware_id = "tof_camera";
+		diagnostics.status[0].level = overruns > 0 ? diagnostic_msgs::DiagnosticStatus::WARN : diagnostic_msgs::DiagnosticStatus::OK;
+		diagnostics.status[0].message = overruns > 0 ? "frames delayed" : "frame rate ok";
+		for (size_t i = 0; i < timing.size(); i++)
+		{
+			diagnostic_msgs::KeyValue kv;
+			kv.key = timing[i].first;
+			kv.value = timing[i].second;
+			diagnostics.status[0].values.push_back(kv);
+		}
+		diagnostics_publisher_.publish(diagnostics);
+	}
+
     void publishPointCloud(ros::Time now)
     {
         ROS_DEBUG("convert xyz_image to point_cloud");
@@ -281,31 +476,36 @@ public:
 		pc_msg.header.stamp = now;
 		pc_msg.header.frame_id = "head_tof_link";
 
-		cv::Mat cpp_xyz_image_32F3 = xyz_image_32F3_;
-		cv::Mat cpp_grey_image_32F1 = grey_image_32F1_;
+		cv::Mat cpp_xyz_image_32F3 = tof_frame_.cartesianImage;
+		cv::Mat cpp_grey_image_32F1 = tof_frame_.grayImage;
 
+		pc_msg.points.resize(cpp_xyz_image_32F3.rows * cpp_xyz_image_32F3.cols);
 		float* f_ptr = 0;
+		int pc_msg_idx = 0;
 		for (int row = 0; row < cpp_xyz_image_32F3.rows; row++)
 		{
 			f_ptr = cpp_xyz_image_32F3.ptr<float>(row);
-			for (int col = 0; col < cpp_xyz_image_32F3.cols; col++)
+			for (int col = 0; col < cpp_xyz_image_32F3.cols; col++, pc_msg_idx++)
 			{
-				geometry_msgs::Point32 pt;
+				geometry_msgs::Point32& pt = pc_msg.points[pc_msg_idx];
 				pt.x = f_ptr[3*col + 0];
 				pt.y = f_ptr[3*col + 1];
 				pt.z = f_ptr[3*col + 2];
-				pc_msg.points.push_back(pt);
 			}
 		}
         topicPub_pointCloud_.publish(pc_msg);
     }
 
+	/// Publishes xyz and confidence values as one cloud of 16 byte points.
+	/// The message is taken from the pool and published by pointer, so intra-process
+	/// subscribers (e.g. nodelets) receive it without serialization or copy.
 	void publishPointCloud2(ros::Time now)
 	{
-		cv::Mat cpp_xyz_image_32F3 = xyz_image_32F3_;
-		cv::Mat cpp_confidence_mask_32F1 = grey_image_32F1_;
+		cv::Mat cpp_xyz_image_32F3 = tof_frame_.cartesianImage;
+		cv::Mat cpp_confidence_mask_32F1 = tof_frame_.grayImage;
 
-		sensor_msgs::PointCloud2 pc_msg;
+		sensor_msgs::PointCloud2Ptr pc_msg_ptr = point_cloud2_pool_.Get();
+		sensor_msgs::PointCloud2& pc_msg = *pc_msg_ptr;
 		// create point_cloud message
 		pc_msg.header.stamp = now;
 		pc_msg.header.frame_id = "head_tof_link";
@@ -331,37 +531,53 @@ public:
 		pc_msg.is_dense = true;
 		pc_msg.is_bigendian = false;
 
-		float* f_ptr = 0;
-		float* g_ptr = 0;
-		int pc_msg_idx=0;
-		for (int row = 0; row < cpp_xyz_image_32F3.rows; row++)
+		if (pc_msg.data.empty())
 		{
-			f_ptr = cpp_xyz_image_32F3.ptr<float>(row);
-			g_ptr = cpp_confidence_mask_32F1.ptr<float>(row);
-			for (int col = 0; col < cpp_xyz_image_32F3.cols; col++, pc_msg_idx++)
-			{
-				memcpy(&pc_msg.data[pc_msg_idx * pc_msg.point_step], &f_ptr[3*col], 3*sizeof(float));
-				memcpy(&pc_msg.data[pc_msg_idx * pc_msg.point_step + pc_msg.fields[3].offset], &g_ptr[col], sizeof(float));
-			}
+			return;
 		}
-		topicPub_pointCloud2_.publish(pc_msg);
+
+		/// Interleave x, y, z and confidence directly into the message buffer in a single pass
+		cv::Mat points(pc_msg.height, pc_msg.width, CV_32FC4, &pc_msg.data[0], pc_msg.row_step);
+		const cv::Mat channels[] = { cpp_xyz_image_32F3, cpp_confidence_mask_32F1 };
+		const int from_to[] = { 0,0, 1,1, 2,2, 3,3 };
+		cv::mixChannels(channels, 2, &points, 1, from_to, 4);
+
+		topicPub_pointCloud2_.publish(pc_msg_ptr);
 	}
 
 	bool imageSrvCallback(cob_camera_sensors::GetTOFImages::Request &req,
 			cob_camera_sensors::GetTOFImages::Response &res)
 	{
 		boost::mutex::scoped_lock lock(service_mutex_);
-		// Convert openCV IplImages to ROS messages
-		try
+		// Topic subscribers may have needed only one of the images
+		ipa_CameraSensors::t_FrameInfo frame_info;
+		if (!images_complete_ && !acquireImages(true, true, frame_info))
 		{
-			IplImage grey_img = grey_image_32F1_;
-			IplImage xyz_img = xyz_image_32F3_;
-			res.greyImage = *(sensor_msgs::CvBridge::cvToImgMsg(&grey_img, "passthrough"));
-			res.xyzImage = *(sensor_msgs::CvBridge::cvToImgMsg(&xyz_img, "passthrough"));
+			return false;
 		}
-		catch (sensor_msgs::CvBridgeException error)
+
+		if (req.use_shared_memory)
 		{
-			ROS_ERROR("[tof_camera_type_node] Could not convert IplImage to ROS message");
+			// Only the location of the frame is serialised
+			if (!writeSharedFrame(frame_info, res))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			// Convert openCV IplImages to ROS messages
+			try
+			{
+				IplImage grey_img = tof_frame_.grayImage;
+				IplImage xyz_img = tof_frame_.cartesianImage;
+				res.greyImage = *(sensor_msgs::CvBridge::cvToImgMsg(&grey_img, "passthrough"));
+				res.xyzImage = *(sensor_msgs::CvBridge::cvToImgMsg(&xyz_img, "passthrough"));
+			}
+			catch (sensor_msgs::CvBridgeException error)
+			{
+				ROS_ERROR("[tof_camera_type_node] Could not convert IplImage to ROS message");
+			}
 		}
 
 		// Set time stamp
@@ -373,6 +589,45 @@ public:
 		return true;
 	}
 
+	/// Copies grey and xyz image into the shared memory frame ring
+	/// and fills the response with the location of the frame and the image properties.
+	/// @return <code>false</code> on failure, <code>true</code> otherwise
+	bool writeSharedFrame(const ipa_CameraSensors::t_FrameInfo& frame_info, cob_camera_sensors::GetTOFImages::Response &res)
+	{
+		if (!shared_frame_ring_.isOpen())
+		{
+			int types[2] = {CV_32FC1, CV_32FC3};
+			if (shared_frame_ring_.Create(shared_memory_name_, tof_frame_.grayImage.cols, tof_frame_.grayImage.rows, 2, types,
+				shared_memory_slots_) & ipa_Utils::RET_FAILED)
+			{
+				ROS_ERROR("[tof_camera] Could not create shared memory '%s'", shared_memory_name_.c_str());
+				return false;
+			}
+		}
+
+		cv::Mat frames[2] = {tof_frame_.grayImage, tof_frame_.cartesianImage};
+		int slot = 0;
+		boost::uint64_t sequence_number = 0;
+		if (shared_frame_ring_.Write(frames, frame_info, slot, sequence_number) & ipa_Utils::RET_FAILED)
+		{
+			ROS_ERROR("[tof_camera] Could not write frame to shared memory");
+			return false;
+		}
+		res.shared_memory_name = shared_frame_ring_.GetName();
+		res.slot = slot;
+		res.sequence_number = sequence_number;
+
+		res.greyImage.height = tof_frame_.grayImage.rows;
+		res.greyImage.width = tof_frame_.grayImage.cols;
+		res.greyImage.encoding = sensor_msgs::image_encodings::TYPE_32FC1;
+		res.greyImage.step = tof_frame_.grayImage.cols * tof_frame_.grayImage.elemSize();
+		res.xyzImage.height = tof_frame_.cartesianImage.rows;
+		res.xyzImage.width = tof_frame_.cartesianImage.cols;
+		res.xyzImage.encoding = sensor_msgs::image_encodings::TYPE_32FC3;
+		res.xyzImage.step = tof_frame_.cartesianImage.cols * tof_frame_.cartesianImage.elemSize();
+		return true;
+	}
+
 	bool loadParameters()
 	{
 		std::string tmp_string = "NULL";
@@ -478,6 +733,15 @@ public:
 			ROS_WARN("[tof_camera] Flag for publishing PointCloud2 not set, falling back to default (false)");
 		}
 
+		/// Optional, frames are only recorded if a file is given
+		node_handle_.param<std::string>("tof_camera/record_file", record_file_, "");
+		node_handle_.param("tof_camera/record_buffer_frames", record_buffer_frames_, 30);
+
+		std::stringstream default_shared_memory_name;
+		default_shared_memory_name << "cob_tof_camera_" << tof_camera_index_;
+		node_handle_.param<std::string>("tof_camera/shared_memory_name", shared_memory_name_, default_shared_memory_name.str());
+		node_handle_.param("tof_camera/shared_memory_slots", shared_memory_slots_, 4);
+
 
 		ROS_INFO("ROS node mode: %s", tmp_string.c_str());
 
@@ -504,10 +768,16 @@ int main(int argc, char** argv)
 
     //ros::spin();
 	ros::Rate rate(100);
+	ros::WallTime next_diagnostics = ros::WallTime::now() + ros::WallDuration(1.0);
 	while(nh.ok())
 	{
 		camera_node.spin();
 		ros::spinOnce();
+		if (ros::WallTime::now() >= next_diagnostics)
+		{
+			camera_node.publishDiagnostics(rate.expectedCycleTime().toSec());
+			next_diagnostics = ros::WallTime::now() + ros::WallDuration(1.0);
+		}
 		rate.sleep();
 	}
 
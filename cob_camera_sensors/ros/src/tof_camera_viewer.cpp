@@ -31,6 +31,7 @@
 #include <opencv/highgui.h>
 
 #include <cob_vision_utils/VisionUtils.h>
+#include <algorithm>
 #include <sstream>
 
 //####################
@@ -54,6 +55,20 @@ private:
 
 	int grey_image_counter_;
 
+	/// Preview mode: images are dropped to match <code>preview_rate_</code> and
+	/// downsampled by <code>preview_scale_</code> before they are mapped to colors
+	bool preview_;
+	double preview_rate_;	///< Maximal display rate in Hz
+	int preview_scale_;	///< Downsampling factor
+	ros::Time last_xyz_display_;
+	ros::Time last_grey_display_;
+	cv::Mat z_lut_8U3_;	///< Color of each quantized z value
+	cv::Mat xyz_preview_32F3_;
+	cv::Mat z_preview_8U1_;
+	cv::Mat z_preview_8U3_;
+	cv::Mat grey_preview_32F1_;
+	cv::Mat grey_preview_8U1_;
+
 public:
 	/// Constructor.
 	/// @param node_handle Node handle instance
@@ -64,7 +79,10 @@ public:
           xyz_mat_8U3_(cv::Mat()),
           grey_image_32F1_(0),
           grey_mat_8U3_(cv::Mat()),
-	  grey_image_counter_(0)
+	  grey_image_counter_(0),
+	  preview_(false),
+	  preview_rate_(5),
+	  preview_scale_(2)
         {
 					///Void
         }
@@ -89,17 +107,100 @@ public:
 		cv::namedWindow("z data");
 		cv::namedWindow("grey data");
 
+		m_NodeHandle.param("tof_camera_viewer/preview", preview_, false);
+		m_NodeHandle.param("tof_camera_viewer/preview_rate", preview_rate_, 5.0);
+		m_NodeHandle.param("tof_camera_viewer/preview_scale", preview_scale_, 2);
+		preview_scale_ = std::max(preview_scale_, 1);
+		if (preview_)
+		{
+			createZLut();
+			ROS_INFO("[tof_camera_viewer] Preview at %.1f Hz, downsampled by %d", preview_rate_, preview_scale_);
+		}
+
 		xyz_image_subscriber_ = image_transport_.subscribe("image_xyz", 1, &CobTofCameraViewerNode::xyzImageCallback, this);
 		grey_image_subscriber_ = image_transport_.subscribe("image_grey", 1, &CobTofCameraViewerNode::greyImageCallback, this);
 
 		return true;
 	}
 
+	/// Builds the color map of the z preview, from red at the camera over yellow, green and cyan to blue at 5 m.
+	void createZLut()
+	{
+		cv::Mat hsv(1, 256, CV_8UC3);
+		for (int i=0; i<256; i++)
+		{
+			// Opencv hue ranges from 0 to 180, index 0 is reserved for invalid points
+			hsv.at<cv::Vec3b>(0, i) = cv::Vec3b((uchar)(i*120/255), 255, (i == 0) ? 0 : 255);
+		}
+		cv::cvtColor(hsv, z_lut_8U3_, CV_HSV2BGR);
+	}
+
+	/// Returns <code>true</code>, if the last displayed image is older than the preview period.
+	bool previewDue(ros::Time& last_display)
+	{
+		ros::Time now = ros::Time::now();
+		if (preview_rate_ > 0 && !last_display.isZero() && now >= last_display && (now - last_display).toSec() < 1.0/preview_rate_)
+		{
+			return false;
+		}
+		last_display = now;
+		return true;
+	}
+
+	/// Returns a header on the message data without copying it.
+	cv::Mat messageImage(const sensor_msgs::Image& image_msg, int type)
+	{
+		return cv::Mat(image_msg.height, image_msg.width, type, const_cast<unsigned char*>(&image_msg.data[0]), image_msg.step);
+	}
+
+	/// Shows a downsampled grey image, scaled linearly from 0 to 800 like the full view.
+	void showGreyPreview(const sensor_msgs::ImageConstPtr& grey_image_msg)
+	{
+		if (grey_image_msg->encoding != "32FC1" || grey_image_msg->data.empty())
+		{
+			ROS_ERROR("[tof_camera_viewer] Preview expects '32FC1' grey images, got '%s'.", grey_image_msg->encoding.c_str());
+			return;
+		}
+		cv::resize(messageImage(*grey_image_msg, CV_32FC1), grey_preview_32F1_, cv::Size(), 1.0/preview_scale_, 1.0/preview_scale_, cv::INTER_NEAREST);
+		grey_preview_32F1_.convertTo(grey_preview_8U1_, CV_8U, 255.0/800.0);
+		cv::imshow("grey data", grey_preview_8U1_);
+		cv::waitKey(1);
+	}
+
+	/// Shows the z values of a downsampled xyz image through the color map.
+	void showXyzPreview(const sensor_msgs::ImageConstPtr& xyz_image_msg)
+	{
+		if (xyz_image_msg->encoding != "32FC3" || xyz_image_msg->data.empty())
+		{
+			ROS_ERROR("[tof_camera_viewer] Preview expects '32FC3' xyz images, got '%s'.", xyz_image_msg->encoding.c_str());
+			return;
+		}
+		cv::resize(messageImage(*xyz_image_msg, CV_32FC3), xyz_preview_32F3_, cv::Size(), 1.0/preview_scale_, 1.0/preview_scale_, cv::INTER_NEAREST);
+
+		// z from 0 to 5 m on 1 to 255, invalid points with z <= 0 saturate to 0
+		cv::Mat z_32F1(xyz_preview_32F3_.size(), CV_32FC1);
+		int from_to[] = {2, 0};
+		cv::mixChannels(&xyz_preview_32F3_, 1, &z_32F1, 1, from_to, 1);
+		z_32F1.convertTo(z_preview_8U1_, CV_8U, 254.0/5.0, 1);
+		z_preview_8U1_.setTo(0, z_32F1 <= 0);
+
+		cv::Mat z_8U3;
+		cv::cvtColor(z_preview_8U1_, z_8U3, CV_GRAY2BGR);
+		cv::LUT(z_8U3, z_lut_8U3_, z_preview_8U3_);
+		cv::imshow("z data", z_preview_8U3_);
+	}
+
 	/// Topic callback functions.
 	/// Function will be called when a new message arrives on a topic.
 	/// @param grey_image_msg The gray values of point cloud, saved in a 32bit, 1 channel OpenCV IplImage
 	void greyImageCallback(const sensor_msgs::ImageConstPtr& grey_image_msg)
 	{
+		if (preview_)
+		{
+			if (previewDue(last_grey_display_)) showGreyPreview(grey_image_msg);
+			return;
+		}
+
 		/// Do not release <code>m_GrayImage32F3</code>
 		/// Image allocation is managed by Cv_Bridge object
 		ROS_INFO("Grey Image Callback");
@@ -138,6 +239,12 @@ public:
 	/// @param xyz_image_msg The point cloud, saved in a 32bit, 3 channel OpenCV IplImage
 	void xyzImageCallback(const sensor_msgs::ImageConstPtr& xyz_image_msg)
 	{
+		if (preview_)
+		{
+			if (previewDue(last_xyz_display_)) showXyzPreview(xyz_image_msg);
+			return;
+		}
+
 		/// Do not release <code>xyz_image_32F3_</code>
 		/// Image allocation is managed by Cv_Bridge object
 
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Micro-benchmark of the image conversion of VirtualRangeCam::AcquireImages on recorded camera data.
+ *
+ * usage: tof_micro_benchmark --camera_data=<camera data directory> [--camera_index=0] [--filter=regex] [--format=console|json] [--out=file.json], see MicroBenchmark.h
+ *
+ * The recorded frames are replayed in a loop, as by camera_pipeline_benchmark, so the time
+ * includes reading the frame from the replay. Without --camera_data the benchmark is skipped.
+ */
+
+//##################
+//#### includes ####
+
+// standard includes
+#include <cstdlib>
+#include <string>
+
+// external includes
+#include <opencv/cv.h>
+
+#include <cob_camera_sensors/VirtualRangeCam.h>
+#include <cob_utilities/MicroBenchmark.h>
+
+static void ToF_AcquireImages(MicroBenchmark::State& state)
+{
+	std::string directory = state.getArg("camera_data", "");
+	if (directory.empty())
+	{
+		state.skip("no --camera_data given");
+		return;
+	}
+	int cameraIndex = atoi(state.getArg("camera_index", "0").c_str());
+
+	ipa_CameraSensors::VirtualRangeCam rangeCam;
+	if ((rangeCam.Init(directory, cameraIndex) & ipa_CameraSensors::RET_FAILED) ||
+		(rangeCam.Open() & ipa_CameraSensors::RET_FAILED))
+	{
+		state.skip("could not open the virtual range camera");
+		return;
+	}
+
+	cv::Mat xyzImage, greyImage;
+	while (state.keepRunning())
+	{
+		if (rangeCam.AcquireImages(0, &greyImage, &xyzImage, false, false, ipa_CameraSensors::INTENSITY_32F1) & ipa_CameraSensors::RET_FAILED)
+		{
+			state.skip("range image acquisition failed");
+			break;
+		}
+	}
+	state.setItemsProcessed(state.iterations() * xyzImage.rows * xyzImage.cols);
+
+	rangeCam.Close();
+}
+MICRO_BENCHMARK(ToF_AcquireImages);
+
+MICRO_BENCHMARK_MAIN();
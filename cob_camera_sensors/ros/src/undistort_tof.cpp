@@ -19,7 +19,7 @@
 //#### includes ####
 
 // standard includes
-//--
+#include <algorithm>
 
 // ROS includes
 #include <ros/ros.h>
@@ -28,6 +28,8 @@
 #include <message_filters/sync_policies/approximate_time.h>
 #include <message_filters/synchronizer.h>
 
+#include <boost/array.hpp>
+
 // ROS message includes
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/CameraInfo.h>
@@ -52,11 +54,27 @@ private:
 	message_filters::Synchronizer<SyncPolicy> sub_sync_;
 	ros::Publisher pub_pc2_;
 
+	bool show_images_;	///< Show distorted and undistorted z image for debugging
+
+	boost::array<double, 9> K_;	///< Intrinsics the undistortion maps were built for
+	boost::array<double, 4> D_;	///< Distortion coefficients the undistortion maps were built for
+	double fx_, fy_, cx_, cy_;
+	cv::Mat map_1_;	///< Cached undistortion map, fixed point coordinates
+	cv::Mat map_2_;	///< Cached undistortion map, interpolation table
+
+	cv::Mat z_image_;
+	cv::Mat intensity_image_;
+	cv::Mat z_image_undistorted_;
+	cv::Mat intensity_image_undistorted_;
+
 public:
 	UndistortTOF(const ros::NodeHandle& node_handle)
 	: node_handle_(node_handle),
-	  sub_sync_(SyncPolicy(3))
+	  sub_sync_(SyncPolicy(3)),
+	  show_images_(false),
+	  fx_(0), fy_(0), cx_(0), cy_(0)
 	  {
+		node_handle_.param("undistort_tof/show_images", show_images_, false);
 		sub_sync_.connectInput(sub_pc2_, sub_camera_info_);
 		sub_sync_.registerCallback(boost::bind(&UndistortTOF::Undistort, this, _1, _2));
 		sub_pc2_.subscribe(node_handle_, "tof/point_cloud2", 1);
@@ -105,87 +123,138 @@ public:
 		return RET_OK;*/
 	}
 
-	//void Undistort(const sensor_msgs::PointCloud2ConstPtr& tof_camera_data, const sensor_msgs::CameraInfoConstPtr& camera_info)
-	void Undistort(const boost::shared_ptr<sensor_msgs::PointCloud2 const>& tof_camera_data, const sensor_msgs::CameraInfoConstPtr& camera_info)
+	/// Rebuilds the undistortion maps if the intrinsics or the image size changed.
+	/// @return <code>false</code> if the camera info holds no valid intrinsics
+	bool UpdateUndistortMaps(const sensor_msgs::CameraInfo& camera_info, int width, int height)
 	{
+		if (camera_info.D.size() < 4)
+		{
+			ROS_ERROR("[undistort_tof] Camera info holds %d instead of 4 distortion coefficients", (int)camera_info.D.size());
+			return false;
+		}
+		if (!map_1_.empty() && map_1_.cols == width && map_1_.rows == height &&
+			std::equal(camera_info.K.begin(), camera_info.K.end(), K_.begin()) &&
+			std::equal(camera_info.D.begin(), camera_info.D.begin() + 4, D_.begin()))
+		{
+			return true;
+		}
+
 		cv::Mat D = cv::Mat(1,4,CV_64FC1);
-		D.at<double>(0,0) = camera_info->D[0];
-		D.at<double>(0,1) = camera_info->D[1];
-		D.at<double>(0,2) = camera_info->D[2];
-		D.at<double>(0,3) = camera_info->D[3];
+		D.at<double>(0,0) = camera_info.D[0];
+		D.at<double>(0,1) = camera_info.D[1];
+		D.at<double>(0,2) = camera_info.D[2];
+		D.at<double>(0,3) = camera_info.D[3];
 		cv::Mat cam_matrix = cv::Mat::zeros(3,3,CV_64FC1);
-		cam_matrix.at<double>(0,0) = camera_info->K[0];
-		cam_matrix.at<double>(0,2) = camera_info->K[2];
-		cam_matrix.at<double>(1,1) = camera_info->K[4];
-		cam_matrix.at<double>(1,2) = camera_info->K[5];
+		cam_matrix.at<double>(0,0) = camera_info.K[0];
+		cam_matrix.at<double>(0,2) = camera_info.K[2];
+		cam_matrix.at<double>(1,1) = camera_info.K[4];
+		cam_matrix.at<double>(1,2) = camera_info.K[5];
 		cam_matrix.at<double>(2,2) = 1;
 
-		int z_offset = 0, i_offset = 0, c_offset = 0, x_offset = 0, y_offset = 0;;
+		// Fixed point maps, remapping with them is considerably faster than with float maps
+		cv::initUndistortRectifyMap(cam_matrix, D, cv::Mat(), cam_matrix, cv::Size(width, height), CV_16SC2, map_1_, map_2_);
+
+		fx_ = camera_info.K[0];
+		fy_ = camera_info.K[4];
+		cx_ = camera_info.K[2];
+		cy_ = camera_info.K[5];
+		K_ = camera_info.K;
+		std::copy(camera_info.D.begin(), camera_info.D.begin() + 4, D_.begin());
+		return true;
+	}
+
+	//void Undistort(const sensor_msgs::PointCloud2ConstPtr& tof_camera_data, const sensor_msgs::CameraInfoConstPtr& camera_info)
+	void Undistort(const boost::shared_ptr<sensor_msgs::PointCloud2 const>& tof_camera_data, const sensor_msgs::CameraInfoConstPtr& camera_info)
+	{
+		int width = tof_camera_data->width;
+		int height = tof_camera_data->height;
+		if (width == 0 || height == 0)
+		{
+			return;
+		}
+
+		int z_offset = -1, i_offset = -1, x_offset = -1, y_offset = -1;
 		for (size_t d = 0; d < tof_camera_data->fields.size(); ++d)
 		{
-			if(tof_camera_data->fields[d].name == "x")
-				x_offset = tof_camera_data->fields[d].offset;
-			if(tof_camera_data->fields[d].name == "y")
-				y_offset = tof_camera_data->fields[d].offset;
-			if(tof_camera_data->fields[d].name == "z")
-				z_offset = tof_camera_data->fields[d].offset;
-			if(tof_camera_data->fields[d].name == "intensity")
-				i_offset = tof_camera_data->fields[d].offset;
-			if(tof_camera_data->fields[d].name == "confidence")
-				c_offset = tof_camera_data->fields[d].offset;
+			const sensor_msgs::PointField& field = tof_camera_data->fields[d];
+			if (field.datatype != sensor_msgs::PointField::FLOAT32)
+				continue;
+			if(field.name == "x")
+				x_offset = field.offset;
+			if(field.name == "y")
+				y_offset = field.offset;
+			if(field.name == "z")
+				z_offset = field.offset;
+			// Intensity takes precedence over confidence
+			if(field.name == "intensity" || (field.name == "confidence" && i_offset < 0))
+				i_offset = field.offset;
 		}
-		cv::Mat z_image = cv::Mat(tof_camera_data->height, tof_camera_data->width,CV_32FC1);
-		cv::Mat intensity_image = cv::Mat(tof_camera_data->height, tof_camera_data->width,CV_32FC1);
-		float* f_ptr = 0;
-		float* i_ptr = 0;
-		int pc_msg_idx=0;
-		for (int row = 0; row < z_image.rows; row++)
+		if (x_offset < 0 || y_offset < 0 || z_offset < 0)
 		{
-			f_ptr = z_image.ptr<float>(row);
-			i_ptr = intensity_image.ptr<float>(row);
-			for (int col = 0; col < z_image.cols; col++, pc_msg_idx++)
-			{
-				memcpy(&f_ptr[col], &tof_camera_data->data[pc_msg_idx * tof_camera_data->point_step + z_offset], sizeof(float));
-				memcpy(&i_ptr[col], &tof_camera_data->data[pc_msg_idx * tof_camera_data->point_step + i_offset], sizeof(float));
-			}
+			ROS_ERROR("[undistort_tof] Point cloud has no float x, y and z fields");
+			return;
+		}
+		// The point cloud is accessed as an image of float channels
+		const int float_size = sizeof(float);
+		if (tof_camera_data->point_step % float_size != 0 || x_offset % float_size != 0 ||
+			y_offset % float_size != 0 || z_offset % float_size != 0 || (i_offset >= 0 && i_offset % float_size != 0) ||
+			tof_camera_data->data.size() < (size_t)height * tof_camera_data->row_step)
+		{
+			ROS_ERROR("[undistort_tof] Point cloud layout is not float aligned");
+			return;
 		}
 
-		cv::imshow("distorted", z_image);
-		// Undistort
-		cv::Mat z_image_undistorted;
-		cv::undistort(z_image, z_image_undistorted, cam_matrix, D);
-		cv::Mat intensity_image_undistorted;
-		cv::undistort(intensity_image, intensity_image_undistorted, cam_matrix, D);
-
-		cv::imshow("undistorted", z_image_undistorted);
-		cv::waitKey(20);
+		if (!UpdateUndistortMaps(*camera_info, width, height))
+		{
+			return;
+		}
 
-		sensor_msgs::PointCloud2 pc_pub = *(tof_camera_data.get());
-		// Calculate X and Y based on instrinsic rotation and translation
-		double fx, fy, cx, cy;
+		int num_channels = tof_camera_data->point_step / float_size;
+		cv::Mat points(height, width, CV_32FC(num_channels),
+			const_cast<unsigned char*>(&tof_camera_data->data[0]), tof_camera_data->row_step);
 
-		fx = cam_matrix.at<double>(0,0);
-		fy = cam_matrix.at<double>(1, 1);
+		// Extract z and intensity in one pass
+		z_image_.create(height, width, CV_32FC1);
+		intensity_image_.create(height, width, CV_32FC1);
+		cv::Mat channels[] = { z_image_, intensity_image_ };
+		int from_to[] = { z_offset / float_size, 0, i_offset / float_size, 1 };
+		cv::mixChannels(&points, 1, channels, 2, from_to, i_offset < 0 ? 1 : 2);
 
-		cx = cam_matrix.at<double>(0, 2);
-		cy = cam_matrix.at<double>(1, 2);
+		if (show_images_) cv::imshow("distorted", z_image_);
 
+		// Undistort with the cached maps
+		cv::remap(z_image_, z_image_undistorted_, map_1_, map_2_, cv::INTER_LINEAR);
+		if (i_offset >= 0) cv::remap(intensity_image_, intensity_image_undistorted_, map_1_, map_2_, cv::INTER_LINEAR);
 
-		for (size_t d = 0; d < pc_pub.fields.size(); ++d)
+		if (show_images_)
 		{
+			cv::imshow("undistorted", z_image_undistorted_);
+			cv::waitKey(20);
 		}
-		for(unsigned int row=0; row<pc_pub.height; row++)
+
+		sensor_msgs::PointCloud2Ptr pc_pub(new sensor_msgs::PointCloud2(*tof_camera_data));
+		cv::Mat points_pub(height, width, CV_32FC(num_channels), &pc_pub->data[0], pc_pub->row_step);
+
+		// Calculate X and Y based on instrinsic rotation and translation
+		int x_channel = x_offset / float_size;
+		int y_channel = y_offset / float_size;
+		int z_channel = z_offset / float_size;
+		int i_channel = i_offset / float_size;
+		float inv_fx = (float)(1.0 / fx_);
+		float inv_fy = (float)(1.0 / fy_);
+		for (int row=0; row<height; row++)
 		{
-			float* z =  z_image_undistorted.ptr<float>(row);
-			//f_ptr = (float*)(cartesianImageData + row*widthStepCartesianImage);
+			const float* z = z_image_undistorted_.ptr<float>(row);
+			const float* intensity = i_offset < 0 ? 0 : intensity_image_undistorted_.ptr<float>(row);
+			float* f_ptr = points_pub.ptr<float>(row);
+			float y_factor = (float)(row-cy_) * inv_fy;
 
-			for (unsigned int col=0; col<pc_pub.width; col++)
+			for (int col=0; col<width; col++, f_ptr += num_channels)
 			{
-				memcpy(&pc_pub.data[row * col * pc_pub.point_step + z_offset], &z[col], sizeof(float));
-				float x = (float) (z[col]*(col-cx)/fx);
-				float y =  (float) (z[col]*(row-cy)/fy);
-				memcpy(&pc_pub.data[row * col * pc_pub.point_step + x_offset], &x, sizeof(float));
-				memcpy(&pc_pub.data[row * col * pc_pub.point_step + y_offset], &y, sizeof(float));
+				f_ptr[x_channel] = z[col] * (float)(col-cx_) * inv_fx;
+				f_ptr[y_channel] = z[col] * y_factor;
+				f_ptr[z_channel] = z[col];
+				if (intensity) f_ptr[i_channel] = intensity[col];
 			}
 		}
 		pub_pc2_.publish(pc_pub);
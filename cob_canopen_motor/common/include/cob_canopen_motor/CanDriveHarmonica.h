@@ -21,9 +21,14 @@
 //-----------------------------------------------
 #include <cob_canopen_motor/CanDriveItf.h>
 #include <cob_utilities/TimeStamp.h>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <cob_canopen_motor/SDOSegmented.h>
+#include <cob_canopen_motor/SDOQueue.h>
 #include <cob_canopen_motor/ElmoRecorder.h>
+#include <cob_canopen_motor/RingBuffer.h>
+#include <cob_canopen_motor/VelEstimator.h>
 //-----------------------------------------------
 
 /**
@@ -42,6 +47,14 @@ public:
 		int iNumRetryOfSend;
 		int iDivForRequestStatus;
 		double dCanTimeout;
+		// status and current are sent with TPDO3 on SYNC instead of being requested through the interpreter
+		bool bSyncPDOMode;
+		// period of the telemetry TPDO4 in ms, 0 disables the telemetry stream
+		int iTelemetryPeriodMS;
+		// errors are reported by EMCY and heartbeat of the drive instead of polling the status register
+		bool bEventErrorDetection;
+		// producer heartbeat period of the drive in ms, used in event error detection mode
+		int iHeartbeatPeriodMS;
 	};
 
 	/**
@@ -62,9 +75,14 @@ public:
 	{
 		int iTxPDO1;
 		int iTxPDO2;
+		int iTxPDO3;
+		int iTxPDO4;
 		int iRxPDO2;
 		int iTxSDO;
 		int iRxSDO;
+		// emergency and heartbeat (NMT error control) of the drive
+		int iEMCY;
+		int iHeartbeat;
 	};
 
 	// ------------------------- Interface
@@ -126,6 +144,37 @@ public:
 	 */
 	bool execHoming();
 
+	/**
+	 * Sends step iStep of init() without waiting for the drive.
+	 * @return time in us the drive needs before the next step, -1 if there is no step iStep
+	 */
+	int sendInitStep(int iStep);
+
+	/**
+	 * Completes the initialization started with sendInitStep().
+	 */
+	bool finishInit(bool bAnswered);
+
+	/**
+	 * Sends step iStep of start() without waiting for the drive.
+	 */
+	int sendStartStep(int iStep);
+
+	/**
+	 * Completes the start begun with sendStartStep().
+	 */
+	bool finishStart(bool bAnswered);
+
+	/**
+	 * Sends step iStep of initHoming() without waiting for the drive.
+	 */
+	int sendHomingInitStep(int iStep);
+
+	/**
+	 * Returns true if the position or status requested by the last init or start step has been received.
+	 */
+	bool isInitAnswered() { return !m_bInitPosRequested && !m_bStartStatusRequested; }
+
 	/**
 	 * Performs homing procedure
 	 * Drives wheel in neutral Position for Startup.
@@ -152,6 +201,27 @@ public:
 	 */
 	bool startWatchdog(bool bStarted);
 
+	/**
+	 * Queues an expedited SDO download, sent as soon as the previous request is confirmed.
+	 */
+	void queueSDODownload(int iObjIndex, int iObjSub, int iData);
+
+	/**
+	 * Queues an expedited SDO upload, the value is evaluated by evalReceivedMsg().
+	 */
+	void queueSDOUpload(int iObjIndex, int iObjSub);
+
+	/**
+	 * Queues a command of the binary interpreter, confirmed by its echo or answer.
+	 */
+	void queueIntprtSetInt(int iDataLen, char cCmdChar1, char cCmdChar2, int iIndex, int iData);
+
+	/**
+	 * Repeats a request which has not been confirmed in time.
+	 * @return number of requests not confirmed yet
+	 */
+	int processSDOQueue();
+
 	/**
 	 * Evals a received message.
 	 * Only messages with fitting identifiers are evaluated.
@@ -159,6 +229,11 @@ public:
 	 */
 	bool evalReceivedMsg(CanMsg& msg);
 
+	/**
+	 * Returns the PDO and SDO identifiers the drive answers on.
+	 */
+	void getReceivedCanIDs(std::vector<int>* pviIDs);
+
 	/**
 	 * Evals received messages in OBJECT mode.
 	 * @todo To be implemented!
@@ -183,6 +258,11 @@ public:
 	 */
 	bool setTypeMotion(int iType);
 
+	/**
+	 * Queues the commands of setTypeMotion(), they are sent by processSDOQueue().
+	 */
+	void queueTypeMotion(int iType);
+
 	/**
 	 * Returns the position and the velocity of the drive.
 	 */
@@ -202,7 +282,7 @@ public:
 	/**
 	 * Sets the drive parameter.
 	 */
-	void setDriveParam(DriveParam driveParam) { m_DriveParam = driveParam; }
+	void setDriveParam(DriveParam driveParam);
 
 	/**
 	 * Returns true if an error has been detected.
@@ -260,6 +340,68 @@ public:
 	 */
 	void setCanOpenParam( int iTxPDO1, int iTxPDO2, int iRxPDO2, int iTxSDO, int iRxSDO);
 
+	/**
+	 * Gets the CAN identifiers of the drive node, e.g. to attach a simulated drive.
+	 */
+	const ParamCanOpenType& getCanOpenParam() const { return m_ParamCanOpen; }
+
+	/**
+	 * Gets the parameters set by setDriveParam().
+	 */
+	DriveParam* getDriveParam() { return &m_DriveParam; }
+
+	/**
+	 * Enables the SYNC-synchronous PDO mode. Call before init().
+	 * In this mode a single SYNC frame on the bus returns position, velocity, status register
+	 * and active current (TPDO1 and TPDO3), so setGearVelRadS(), requestStatus() and
+	 * requestMotorTorque() do not send any request frames. The SYNC has to be sent
+	 * once per cycle by the owner of the bus.
+	 * @param bSyncPDOMode true to enable the mode
+	 */
+	void setSyncPDOMode(bool bSyncPDOMode) { m_Param.bSyncPDOMode = bSyncPDOMode; }
+
+	/**
+	 * Streams position and active current with TPDO4 at a fixed period, independent of SYNC.
+	 * The samples are queued for getTelemetry(). Has to be called before init().
+	 * @param iPeriodMS period of the event timer in ms, 0 disables the stream
+	 */
+	void setTelemetryPeriod(int iPeriodMS) { m_Param.iTelemetryPeriodMS = iPeriodMS; }
+
+	/**
+	 * Enables the event based error detection. Call before init().
+	 * The drive produces a heartbeat and reports faults by EMCY, both are evaluated by
+	 * evalReceivedMsg() as they arrive. The status register is no longer requested
+	 * by setGearVelRadS(), the heartbeat of the drive is supervised there instead,
+	 * and isError() only returns the state evaluated from the events.
+	 * @param bEnabled true to enable the mode
+	 * @param iHeartbeatPeriodMS producer heartbeat period of the drive
+	 */
+	void setEventErrorDetection(bool bEnabled, int iHeartbeatPeriodMS = 100)
+	{
+		m_Param.bEventErrorDetection = bEnabled;
+		m_Param.iHeartbeatPeriodMS = iHeartbeatPeriodMS;
+	}
+
+	/**
+	 * Selects how the velocity returned by getGearPosVelRadS() is obtained. Call after setDriveParam().
+	 * The positions of TPDO1 are evaluated with the receive time stamps of the CAN interface,
+	 * the measurement noise of the Kalman filter is the quantization of the encoder and the time stamp jitter.
+	 * @param iMode one of VelEstimator::Mode, VEL_EST_DRIVE keeps the velocity measured by the drive
+	 * @param dAccNoiseRadS2 acceleration noise of the Kalman filter in rad/s^2/sqrt(Hz)
+	 * @param dTimeJitterS standard deviation of the receive time stamps
+	 */
+	void setVelEstimator(int iMode, double dAccNoiseRadS2 = 2, double dTimeJitterS = 30e-6);
+
+	/**
+	 * Fetches the telemetry samples received since the last call, oldest first.
+	 */
+	int getTelemetry(TelemetrySample* pSamples, int iMaxSamples) { return m_Telemetry.pop(pSamples, iMaxSamples); }
+
+	/**
+	 * Number of telemetry samples dropped because they were not fetched in time.
+	 */
+	unsigned int getTelemetryDropped() const { return m_Telemetry.getNumDropped(); }
+
 	/**
 	 * Sends an integer value to the Harmonica using the built in interpreter.
 	 */
@@ -309,12 +451,18 @@ public:
 	 * 0: Configure the Recorder to record the sources Main Speed(1), Main position(2), Active current(10), Speed command(16). With iParam = iRecordingGap you specify every which time quantum (4*90usec) a new data point (of 1024 points in total) is recorded;
 	 * 1: Query Upload of recorded source (1=Main Speed, 2=Main position, 10=Active Current, 16=Speed command) with iParam and log data to file sParam = file prefix. Filename is extended with _MotorNumber_RecordedSource.log
 	 * 2: Request status of ongoing readout process
+	 * 3: Select the logfile format with iParam (0 = text, 1 = binary, see ElmoRecorder::LogFormat)
 	 * 99: Abort and clear current SDO readout process
 	 * @return 0: Success, 1: Recorder hasn't been configured yet, 2: data collection still in progress
 	 *
 	*/
 	int setRecorder(int iFlag, int iParam = 0, std::string sParam = "/home/MyLog_");
 
+	/**
+	 * Sets the function called when a read-out requested by setRecorder(1, ...) has ended.
+	 */
+	void setRecorderCallback(const ElmoRecorder::ReadoutCallback& callback);
+
 
 	//--------------------------
 	//CanDriveHarmonica specific functions (not from CanDriveItf)
@@ -329,6 +477,12 @@ public:
 	 */
 	void sendSDOUpload(int iObjIndex, int iObjSub);
 
+	/**
+	 * CANopen: Uploads a large service data object using the SDO block upload, which confirms up to 127 segments at once.
+	 * Falls back to the segmented upload if the drive rejects block transfers.
+	 */
+	void sendSDOBlockUpload(int iObjIndex, int iObjSub);
+
     /**
 	 * CANopen: This protocol cancels an active segmented transmission due to the given Error Code
 	 */
@@ -370,18 +524,35 @@ protected:
 	TimeStamp m_CurrentTime;
 	TimeStamp m_WatchdogTime;
 	TimeStamp m_VelCalcTime;
+	// receive time of the last position and velocity from TPDO1
+	TimeStamp m_PosVelMeasTime;
 	TimeStamp m_FailureStartTime;
 	TimeStamp m_SendTime;
+	// receive time of the last heartbeat of the drive
+	TimeStamp m_HeartbeatTime;
 	TimeStamp m_StartTime;
 
 	double m_dAngleGearRadMem;
 	double m_dVelGearMeasRadS;
 	double m_dPosGearMeasRad;
+	// sequence counter guarding the measured position and velocity (odd while the CAN thread writes)
+	boost::atomic<unsigned int> m_uiPosVelSeq;
+
+	/**
+	 * Stores a new measurement, called from the CAN receive path only.
+	 */
+	void setPosVelMeas(double dPosGearRad, double dVelGearRadS);
+
+	/**
+	 * Reads a consistent pair of position and velocity without locking.
+	 */
+	void getPosVelMeas(double* pdPosGearRad, double* pdVelGearRadS) const;
 
 	bool m_bLimSwLeft;
 	bool m_bLimSwRight;
 
-	double m_dOldPos;
+	// estimates the velocity from the positions of TPDO1, written by the CAN receive path only
+	VelEstimator m_VelEstimator;
 
 	std::string m_sErrorMessage;
 
@@ -398,19 +569,129 @@ protected:
 
 	bool m_bIsInitialized;
 
+	// answers requested by sendInitStep()/sendStartStep() and evaluated by evalReceivedMsg()
+	bool m_bInitPosRequested;
+	bool m_bStartStatusRequested;
+	bool m_bStartStatusOk;
+
+	/**
+	 * Queues the commands for velocity control, used by setTypeMotion() and sendInitStep().
+	 */
+	void sendTypeMotionVelCtrl();
+
+	// frames sent by setGearVelRadS(): JV, BG, heartbeat and, unless in SYNC PDO mode, SYNC
+	static const int c_iNumSetpointMsgs = 4;
+	CanMsg m_SetpointMsgs[c_iNumSetpointMsgs];
+	// frames sent by setMotorTorque(): TC, heartbeat and, unless in SYNC PDO mode, SYNC
+	static const int c_iNumTorqueMsgs = 3;
+	CanMsg m_TorqueMsgs[c_iNumTorqueMsgs];
+	// velocity conversion including the sign of the drive, and the velocity limit in increments
+	double m_dVelGearRadSToIncr;
+	double m_dVelIncrToGearRadS;
+	double m_dVelMaxIncr;
+	// position conversion including the sign of the drive, used to decode TPDO1, TPDO4 and PX
+	double m_dPosIncrToGearRad;
+
+	/**
+	 * Encodes everything of the setpoint frames which does not depend on the velocity or torque.
+	 * Called when the CAN identifiers or the drive parameters change.
+	 */
+	void prepareSetpointMsgs();
+
 	double m_dMotorCurr;
+	// rated current (object 0x6075) in mA, scales the current of TPDO3 and TPDO4
+	int m_iRatedCurrentmA;
+
+	// telemetry samples, written by the CAN receive path and read by the owner of the drive
+	RingBuffer<TelemetrySample> m_Telemetry;
+	// last commanded velocity and last telemetry position to form the velocity error
+	double m_dVelGearCmdRadS;
+	double m_dTelemetryPosGearRad;
+	// receive time of the last telemetry sample, CLOCK_MONOTONIC
+	TimeStamp m_TelemetryTime;
+	bool m_bTelemetryPosValid;
 
 	bool m_bWatchdogActive;
 
+	// heartbeats missed before the drive is regarded as lost
+	static const int c_iNumHeartbeatsMissed = 3;
+	// set by finishStart(), the heartbeat of the drive is supervised from then on
+	bool m_bHeartbeatSupervised;
+	// NMT state reported by the last heartbeat of the drive
+	int m_iNMTState;
+
 	segData seg_Data;
 
+	// configuration requests, confirmed one by one in evalReceivedMsg()
+	SDOQueue m_SDOQueue;
+	boost::mutex m_SDOQueueMutex;
+	// time after which an unconfirmed request is repeated
+	static const int c_iSDOTimeoutMS = 100;
+	// repetitions before the drive is regarded as silent and its remaining requests are dropped
+	static const int c_iSDOMaxRetries = 2;
+
+	/**
+	 * Appends a request to m_SDOQueue and sends it if no other request is outstanding.
+	 */
+	void queueRequest(const SDOQueue::Request& req);
+
+	/**
+	 * Completes the outstanding request if the answer belongs to it and sends the next one.
+	 * @return true if the answer confirmed (or aborted) the outstanding request
+	 */
+	bool confirmRequest(bool bIntprt, int iObjIndex, int iObjSub, bool bAborted, unsigned int uiAbortCode);
+
+	void transmitRequest(const SDOQueue::Request& req);
+
+	/**
+	 * Reads the answers of the drive from the CAN interface until all queued requests are done.
+	 * For the blocking functions, which read the CAN interface themselves.
+	 */
+	bool waitForRequests();
+
+	// number of segments per block requested in an SDO block upload (1..127)
+	static const int c_iSDOBlockSize = 127;
+	// cleared when the drive aborted a block upload, further uploads are segmented
+	bool m_bSDOBlockUploadSupported;
+
 
 	// ------------------------- Member functions
-	double estimVel(double dPos);
+	/**
+	 * Estimates the velocity from a position of TPDO1 received at m_PosVelMeasTime.
+	 * @param dPos measured position in rad
+	 * @param dVelDrive velocity measured by the drive in rad/s
+	 */
+	double estimVel(double dPos, double dVelDrive);
+
+	/**
+	 * Gets the receive time of a message, the current time if the CAN interface did not stamp it.
+	 */
+	static void getRxTime(const CanMsg& msg, TimeStamp* pTime);
 
 	bool evalStatusRegister(int iStatus);
 	void evalMotorFailure(int iFailure);
 
+	/**
+	 * Evaluates an emergency message of the drive, any error code but "no error" is a motor failure.
+	 */
+	void evalEmergency(CanMsg& msg);
+
+	/**
+	 * Evaluates the heartbeat of the drive, a boot-up or a stopped drive is a motor failure.
+	 */
+	void evalHeartbeat(CanMsg& msg);
+
+	/**
+	 * Node guarding: sets the motor failure if the heartbeat of the drive is overdue.
+	 * @param now current time
+	 */
+	void checkHeartbeat(const TimeStamp& now);
+
+	/**
+	 * Sets the motor failure, prints the reason once until the next status without error.
+	 */
+	void setMotorFailure(const std::string& sReason);
+
 	int m_iPartnerDriveRatio;
 	int m_iDistSteerAxisToDriveWheelMM;
 
@@ -459,6 +740,33 @@ protected:
 	 */
 	void finishedSDOSegmentedTransfer();
 
+	/**
+	 * CANopen: The drive accepted the block upload, request the first block.
+	 * Function is called by evalReceivedMsg.
+	 */
+	void receivedSDOBlockInitiation(CanMsg& msg);
+
+	/**
+	 * CANopen: Stores a segment of a block upload. Only the last segment of a block, or the segment marked as the last one, is confirmed.
+	 * Segments received out of order are dropped, the confirmation tells the drive to repeat them.
+	 */
+	void receivedSDOBlockSegment(CanMsg& msg);
+
+	/**
+	 * CANopen: Strips the unused bytes of the last segment, checks the CRC and hands the data to finishedSDOSegmentedTransfer().
+	 */
+	void receivedSDOBlockEnd(CanMsg& msg);
+
+	/**
+	 * CANopen: Confirms the segments of a block up to the last one received in order and requests the next block.
+	 */
+	void sendSDOBlockAck();
+
+	/**
+	 * CRC-CCITT (x^16 + x^12 + x^5 + 1, start value 0) used by the SDO block transfer.
+	 */
+	static unsigned short calcSDOBlockCRC(const std::vector<unsigned char>& vData);
+
 };
 //-----------------------------------------------
 #endif
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#ifndef CANDRIVEHARMONICASIM_INCLUDEDEF_H
+#define CANDRIVEHARMONICASIM_INCLUDEDEF_H
+
+//-----------------------------------------------
+#include <map>
+#include <boost/thread.hpp>
+
+#include <cob_generic_can/CanItf.h>
+#include <cob_utilities/TimeStamp.h>
+//-----------------------------------------------
+
+/**
+ * Simulated Harmonica drive on the far end of a CAN bus, e.g. a CanVirtual node.
+ * Answers the SYNC with TPDO1 (and TPDO3 if mapped), the binary interpreter commands
+ * and expedited SDOs the way CanDriveHarmonica uses them, after a configurable response delay.
+ * Produces the heartbeat once its period is written to object 0x1017 and an EMCY on setError().
+ * The motor follows the commanded velocity without dynamics, homing completes a short time after it was armed.
+ * \ingroup DriversCanModul
+ */
+class CanDriveHarmonicaSim
+{
+public:
+	/**
+	 * @param pCanItf node of the bus the simulated drive is connected to, not owned
+	 * @param iTxPDO1, iTxPDO2, iRxPDO2, iTxSDO, iRxSDO CAN identifiers as configured for CanDriveHarmonica
+	 * @param dVelMeasFrqHz velocity measurement frequency of the drive, see DriveParam (1 for the Harmonica)
+	 * @param iResponseDelayUs time between a request and the answer of the drive
+	 */
+	CanDriveHarmonicaSim(CanItf* pCanItf, int iTxPDO1, int iTxPDO2, int iRxPDO2, int iTxSDO, int iRxSDO,
+		double dVelMeasFrqHz = 1, int iResponseDelayUs = 200);
+	~CanDriveHarmonicaSim();
+
+	/**
+	 * Starts the thread answering the bus.
+	 */
+	void start();
+
+	/**
+	 * Stops the thread, called by the destructor.
+	 */
+	void stop();
+
+	/**
+	 * Simulates a drive error, the status register reports it until the drive is switched on again.
+	 * Setting the error sends an under voltage EMCY.
+	 */
+	void setError(bool bError);
+
+private:
+	// time the motor has to move until the homing event is simulated
+	static const double c_dHomingTimeS;
+
+	CanItf* m_pCanItf;
+	int m_iTxPDO1;
+	int m_iTxPDO2;
+	int m_iTxPDO3;
+	int m_iRxPDO2;
+	int m_iTxSDO;
+	int m_iRxSDO;
+	int m_iEMCY;
+	int m_iHeartbeat;
+	double m_dVelMeasFrqHz;
+	int m_iResponseDelayUs;
+
+	// state of the drive, only accessed by the thread except m_bError
+	double m_dPosIncr;
+	int m_iVelIncrPeriod;
+	bool m_bMotorOn;
+	boost::atomic<bool> m_bError;
+	boost::atomic<bool> m_bEmcyPending;
+	// producer heartbeat period (object 0x1017), 0 = off
+	int m_iHeartbeatPeriodMS;
+	TimeStamp m_HeartbeatTime;
+	bool m_bHomingArmed;
+	bool m_bTPDO3Enabled;
+	TimeStamp m_PosTime;
+	TimeStamp m_HomingArmedTime;
+	// values of the interpreter commands which are only stored and read back, key is command and index
+	std::map<int, int> m_Values;
+
+	boost::thread m_Thread;
+	boost::atomic<bool> m_bShutdown;
+
+	void thread();
+	void evalMsg(const CanMsg& msg);
+	void sendEvents();
+	void updatePos();
+	void evalSync();
+	void evalIntprt(const CanMsg& msg);
+	void evalSDO(const CanMsg& msg);
+	int getStatusRegister();
+	int getValue(int iCmd, int iIndex);
+	void sendIntprtAnswer(int iCmdChar1, int iCmdChar2, int iIndex, int iData);
+	void sendMsg(int iID, const unsigned char* pData, int iLen);
+	static void setInt32(unsigned char* pData, int iValue);
+	static int getInt32(const CanMsg& msg, int iStart);
+};
+//-----------------------------------------------
+#endif
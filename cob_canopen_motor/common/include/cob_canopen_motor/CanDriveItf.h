@@ -19,9 +19,11 @@
 #define CANDRIVEITF_INCLUDEDEF_H
 
 //-----------------------------------------------
+#include <vector>
 #include <cob_generic_can/CanItf.h>
 #include <cob_canopen_motor/DriveParam.h>
 #include <cob_canopen_motor/SDOSegmented.h>
+#include <cob_canopen_motor/ElmoRecorder.h>
 //-----------------------------------------------
 
 /**
@@ -31,6 +33,20 @@
 class CanDriveItf
 {
 public:
+	/**
+	 * Sample of the continuous telemetry stream of a drive.
+	 */
+	struct TelemetrySample
+	{
+		/// receive time in s since the epoch
+		double dTimeSec;
+		double dPosGearRad;
+		/// commanded minus measured gear velocity
+		double dVelErrGearRadS;
+		/// active current in A
+		double dCurrentA;
+	};
+
 	/**
 	 * Motion type of the controller.
 	 */
@@ -102,6 +118,43 @@ public:
 	 */
 	virtual bool execHoming() = 0;
 
+	/**
+	 * Sends step iStep of init() without waiting for the drive.
+	 * Lets the platform initialize all drives in parallel: it sends each step to all drives,
+	 * waits for the longest returned delay once and after the last step waits until
+	 * isInitAnswered() of all drives before calling finishInit().
+	 * @return time in us the drive needs before the next step, -1 if there is no step iStep
+	 */
+	virtual int sendInitStep(int iStep) = 0;
+
+	/**
+	 * Completes the initialization started with sendInitStep().
+	 * @param bAnswered false if the drive did not answer in time
+	 */
+	virtual bool finishInit(bool bAnswered) = 0;
+
+	/**
+	 * Sends step iStep of start() without waiting for the drive, see sendInitStep().
+	 */
+	virtual int sendStartStep(int iStep) = 0;
+
+	/**
+	 * Completes the start begun with sendStartStep().
+	 * @param bAnswered false if the drive did not answer in time
+	 */
+	virtual bool finishStart(bool bAnswered) = 0;
+
+	/**
+	 * Sends step iStep of initHoming() without waiting for the drive, see sendInitStep().
+	 */
+	virtual int sendHomingInitStep(int iStep) = 0;
+
+	/**
+	 * Returns true if the answer requested by the last step of sendInitStep() or sendStartStep()
+	 * has been evaluated by evalReceivedMsg().
+	 */
+	virtual bool isInitAnswered() = 0;
+
 	/**
 	 * Returns the elapsed time since the last received message.
 	 */
@@ -122,6 +175,14 @@ public:
 	 */
 	virtual bool startWatchdog(bool bStarted) = 0;
 
+	/**
+	 * Handles the timeouts of the configuration requests (SDOs and interpreter commands) the
+	 * drive has queued, e.g. by sendInitStep(), finishInit() and startWatchdog().
+	 * The requests are confirmed by evalReceivedMsg(), each drive has one outstanding at a time.
+	 * @return number of requests not confirmed yet, 0 when the configuration is complete
+	 */
+	virtual int processSDOQueue() = 0;
+
 	/**
 	 * Evals a received message.
 	 * Only messages with fitting identifiers are evaluated.
@@ -129,6 +190,13 @@ public:
 	 */
 	virtual bool evalReceivedMsg(CanMsg& msg) = 0;
 
+	/**
+	 * Returns the identifiers of all messages evalReceivedMsg(CanMsg&) is interested in.
+	 * Used to route received messages directly to the drive.
+	 * @param pviIDs vector the identifiers are appended to.
+	 */
+	virtual void getReceivedCanIDs(std::vector<int>* pviIDs) = 0;
+
 	/**
 	 * Evals received messages in OBJECT mode.
 	 * The CAN drives have to implement which identifiers they are interested in.
@@ -156,6 +224,12 @@ public:
 	 */
 	virtual bool setTypeMotion(int iType) = 0;
 
+	/**
+	 * Queues the commands of setTypeMotion() without waiting for their confirmation.
+	 * The drive is switched off by the commands and has to be started again.
+	 */
+	virtual void queueTypeMotion(int iType) = 0;
+
 	/**
 	 * Returns the position and the velocity of the drive.
 	 */
@@ -222,6 +296,11 @@ public:
      */
     virtual	int setRecorder(int iFlag, int iParam = 0, std::string sParam = "/home/MyLog") = 0;
 
+	/**
+	 * Sets the function called when a recorder read-out has ended, from the CAN receive path or a background thread.
+	 */
+	virtual void setRecorderCallback(const ElmoRecorder::ReadoutCallback& callback) = 0;
+
 	/**
 	 * Sends Requests for "active current" to motor via CAN
 	 */
@@ -238,6 +317,12 @@ public:
      * Sends command for motor Torque (in Nm)
      */
     virtual void setMotorTorque(double dTorqueNm) = 0;
+
+	/**
+	 * Fetches the telemetry samples received since the last call, oldest first.
+	 * @return number of samples copied to pSamples
+	 */
+	virtual int getTelemetry(TelemetrySample* pSamples, int iMaxSamples) = 0;
 };
 
 
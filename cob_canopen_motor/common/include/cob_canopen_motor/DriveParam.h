@@ -40,6 +40,10 @@ private:
 	double m_dAccIncrS2;		// max. acceleration
 	double m_dDecIncrS2;		// max. decelration
 	double m_dPosGearRadToPosMotIncr;
+	// factors of the other conversions, so the control cycle only multiplies
+	double m_dPosMotIncrToPosGearRad;
+	double m_dVelGearRadSToVelMotIncrPeriod;
+	double m_dVelMotIncrPeriodToVelGearRadS;
 	int m_iEncOffsetIncr;		// Position in Increments of Steerwheel when Homingposition
 					//  is reached (only needed forCoB3)
 	int m_iHomingDigIn; // specifies which digital input is used for homing signal, standart 11 is good for COB3, 19 for Cob3_5
@@ -57,6 +61,10 @@ public:
 
 		m_bIsSteer = true; //has to be set, because it is checked for absolute / relative positioning
 
+		m_dPosGearRadToPosMotIncr = 0;
+		m_dPosMotIncrToPosGearRad = 0;
+		m_dVelGearRadSToVelMotIncrPeriod = 0;
+		m_dVelMotIncrPeriodToVelGearRadS = 0;
 	}
 
 	/**
@@ -95,10 +103,7 @@ public:
 
 		m_iHomingDigIn = 11; //for Cob3
 
-		double dPI = 3.14159265358979323846;
-
-		m_dPosGearRadToPosMotIncr = m_iEncIncrPerRevMot * m_dGearRatio
-			* m_dBeltRatio / (2. * dPI);
+		calcConversionFactors();
 	}
 
 	//Overloaded Method for CoB3
@@ -132,10 +137,7 @@ public:
 
 		m_iHomingDigIn = 11; //for Cob3
 
-		double dPI = 3.14159265358979323846;
-
-		m_dPosGearRadToPosMotIncr = m_iEncIncrPerRevMot * m_dGearRatio
-			* m_dBeltRatio / (2. * dPI);
+		calcConversionFactors();
 
         m_dCurrToTorque = dCurrToTorque;
 		m_dCurrMax = dCurrMax;
@@ -171,16 +173,27 @@ public:
 		m_iEncOffsetIncr = iEncOffsetIncr;
 		m_bIsSteer = bIsSteer;
 
-		double dPI = 3.14159265358979323846;
-
-		m_dPosGearRadToPosMotIncr = m_iEncIncrPerRevMot * m_dGearRatio
-			* m_dBeltRatio / (2. * dPI);
+		calcConversionFactors();
 
         m_dCurrToTorque = dCurrToTorque;
 		m_dCurrMax = dCurrMax;
 		m_iHomingDigIn = iHomingDigIn;
 	}
 
+	/**
+	 * Computes the factors of all conversions from the encoder resolution and the ratios, once per setParam().
+	 */
+	void calcConversionFactors()
+	{
+		double dPI = 3.14159265358979323846;
+
+		m_dPosGearRadToPosMotIncr = m_iEncIncrPerRevMot * m_dGearRatio
+			* m_dBeltRatio / (2. * dPI);
+		m_dPosMotIncrToPosGearRad = 1. / m_dPosGearRadToPosMotIncr;
+		m_dVelGearRadSToVelMotIncrPeriod = m_dPosGearRadToPosMotIncr / m_dVelMeasFrqHz;
+		m_dVelMotIncrPeriodToVelGearRadS = m_dVelMeasFrqHz / m_dPosGearRadToPosMotIncr;
+	}
+
 	/**
 	 * Returns the identifier of the drive.
 	 */
@@ -244,19 +257,37 @@ public:
 	/// Conversions of encoder increments to gear position in radians.
 	double PosMotIncrToPosGearRad(int iPosIncr)
 	{
-		return ((double)iPosIncr / m_dPosGearRadToPosMotIncr);
+		return ((double)iPosIncr * m_dPosMotIncrToPosGearRad);
 	}
 
 	/// Conversions of gear velocity in rad/s to encoder increments per measurment period.
 	int VelGearRadSToVelMotIncrPeriod(double dVelGearRadS)
 	{
-		return ((int)(dVelGearRadS * m_dPosGearRadToPosMotIncr / m_dVelMeasFrqHz));
+		return ((int)(dVelGearRadS * m_dVelGearRadSToVelMotIncrPeriod));
+	}
+
+	/// Factor of VelGearRadSToVelMotIncrPeriod(), to convert without a division in the control cycle.
+	double getVelGearRadSToVelMotIncrPeriodFactor()
+	{
+		return m_dVelGearRadSToVelMotIncrPeriod;
 	}
 
 	/// Conversions of  encoder increments per measurment period to gear velocity in rad/s.
 	double VelMotIncrPeriodToVelGearRadS(int iVelMotIncrPeriod)
 	{
-		return ((double)iVelMotIncrPeriod / m_dPosGearRadToPosMotIncr * m_dVelMeasFrqHz);
+		return ((double)iVelMotIncrPeriod * m_dVelMotIncrPeriodToVelGearRadS);
+	}
+
+	/// Factor of PosMotIncrToPosGearRad(), to convert without a division in the control cycle.
+	double getPosMotIncrToPosGearRadFactor()
+	{
+		return m_dPosMotIncrToPosGearRad;
+	}
+
+	/// Factor of VelMotIncrPeriodToVelGearRadS(), to convert without a division in the control cycle.
+	double getVelMotIncrPeriodToVelGearRadSFactor()
+	{
+		return m_dVelMotIncrPeriodToVelGearRadS;
 	}
 
 	/**
@@ -355,6 +386,13 @@ public:
 	{
 		return m_iEncIncrPerRevMot;
 	}
+	/**
+	 * Get the frequency of the velocity measurement
+	 */
+	double getVelMeasFrqHz()
+	{
+		return m_dVelMeasFrqHz;
+	}
 	/**
 	 * Get factor to convert motor active current [A] into torque [Nm]
 	 */
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef DRIVEPROFILE_INCLUDEDEF_H
+#define DRIVEPROFILE_INCLUDEDEF_H
+
+//-----------------------------------------------
+#include <math.h>
+#include <cob_canopen_motor/DriveParam.h>
+//-----------------------------------------------
+
+/**
+ * Conversions of DriveParam for a hardware variant whose encoder and gear are fixed at compile time.
+ * The ratios are given as fractions, so every conversion factor is a constant expression and a
+ * conversion compiles to one multiplication with a literal. Like DriveParam, the sign of the drive
+ * is not applied, and the velocity is measured per second (VelMeasFrqHz = 1).
+ * @param iEncIncrPerRevMot encoder increments per revolution of the motor shaft
+ * @param iGearRatioNum numerator of the gear ratio
+ * @param iGearRatioDen denominator of the gear ratio
+ * @param iBeltRatioNum numerator of the belt ratio
+ * @param iBeltRatioDen denominator of the belt ratio
+ */
+template<int iEncIncrPerRevMot, int iGearRatioNum, int iGearRatioDen = 1, int iBeltRatioNum = 1, int iBeltRatioDen = 1>
+class DriveProfile
+{
+public:
+	/// Conversion of gear position in radians to encoder increments.
+	static int PosGearRadToPosMotIncr(double dPosGearRad)
+	{
+		return (int)(dPosGearRad * ((double)iEncIncrPerRevMot * iGearRatioNum * iBeltRatioNum
+			/ (2. * 3.14159265358979323846 * iGearRatioDen * iBeltRatioDen)));
+	}
+
+	/// Conversion of encoder increments to gear position in radians.
+	static double PosMotIncrToPosGearRad(int iPosIncr)
+	{
+		return iPosIncr * ((2. * 3.14159265358979323846 * iGearRatioDen * iBeltRatioDen)
+			/ ((double)iEncIncrPerRevMot * iGearRatioNum * iBeltRatioNum));
+	}
+
+	/// Conversion of gear velocity in rad/s to encoder increments per second.
+	static int VelGearRadSToVelMotIncrPeriod(double dVelGearRadS)
+	{
+		return PosGearRadToPosMotIncr(dVelGearRadS);
+	}
+
+	/// Conversion of encoder increments per second to gear velocity in rad/s.
+	static double VelMotIncrPeriodToVelGearRadS(int iVelMotIncrPeriod)
+	{
+		return PosMotIncrToPosGearRad(iVelMotIncrPeriod);
+	}
+
+	/**
+	 * Checks that parameters read at runtime describe this variant, before its conversions are used for them.
+	 */
+	static bool matches(DriveParam& param)
+	{
+		const double c_dRelTol = 1e-9;
+		double dRatio = (double)iGearRatioNum * iBeltRatioNum / ((double)iGearRatioDen * iBeltRatioDen);
+
+		return (param.getEncIncrPerRevMot() == iEncIncrPerRevMot) && (param.getVelMeasFrqHz() == 1)
+			&& (fabs(param.getGearRatio() * param.getBeltRatio() - dRatio) <= c_dRelTol * dRatio);
+	}
+};
+
+//-----------------------------------------------
+#endif
@@ -19,6 +19,11 @@
 #define _ElmoRecorder_H
 
 #include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
 #include <cob_canopen_motor/SDOSegmented.h>
 
 class CanDriveHarmonica;
@@ -32,6 +37,37 @@ class CanDriveHarmonica;
  */
 class ElmoRecorder {
 	public:
+		/**
+		* Formats of the logfiles written after a read-out.
+		*/
+		enum LogFormat {
+			LOG_TEXT = 0, /**< one line "time value" per sample, file extension .log */
+			LOG_BINARY = 1, /**< BinaryLogHeader followed by the samples as 32bit floats, appended to a file with extension .bin */
+		};
+
+		/**
+		* Header written in front of every read-out in a binary logfile, all values in host byte order.
+		* Sample i of channel c is stored at position i * iNumChannels + c and was taken at i * fSamplePeriodSec.
+		*/
+		struct BinaryLogHeader {
+			char cMagic[4]; /**< "ELMR" */
+			uint16_t iVersion; /**< format version, currently 1 */
+			uint16_t iHeaderSize; /**< size of this header in bytes, the samples follow directly */
+			int32_t iDriveID;
+			int32_t iRecordedSource; /**< recorded source, i.e. the sub-index of object 0x2030 */
+			uint32_t iNumChannels;
+			uint32_t iNumSamples; /**< samples per channel */
+			float fSamplePeriodSec;
+			uint32_t iReserved;
+			uint64_t iTimeStampUSec; /**< time of the read-out in usec since the epoch */
+		};
+
+		/**
+		* Called once per requested read-out when it has ended, with the drive ID, the recorded source and
+		* whether the data have been written to the logfile. Runs in the processing thread or in the CAN receive path.
+		*/
+		typedef boost::function<void(int iDriveID, int iRecordedSource, bool bSuccess)> ReadoutCallback;
+
 		/**
 		* @param pParentHarmonicaDrive This pointer is used to give ElmoRecorder the ability to take use of CANopen functions of CanDriveHarmonica
 		*/
@@ -40,10 +76,17 @@ class ElmoRecorder {
 		~ElmoRecorder();
 
 		/**
-		* Processes the collected Elmo Recorder data and saves them into a logfile.
+		* Hands the collected Elmo Recorder data to a background thread, which processes them and saves them into a logfile.
+		* The collected data are moved out of SDOData, so the CAN receive path is not blocked by the file output.
+		* @return 1 as the processing is still running, poll isProcessing() to see when it has finished
 		*/
 		int processData(segData& SDOData);
 
+		/**
+		* @return true while the data of the last read-out are still processed in the background.
+		*/
+		bool isProcessing();
+
 		/**
 		* Configures the Elmo Recorder to log internal data at a high frequency
 		* (This can be used for identification of the drive chain)
@@ -55,6 +98,11 @@ class ElmoRecorder {
 		*/
 		int configureElmoRecorder(int iRecordingGap, int driveID, int startImmediately = 1);
 
+		/**
+		* @return Number of bytes uploaded by one read-out of the configured recording length, including the header.
+		*/
+		unsigned int getReadoutSize();
+
 		/**
 		* @param initNow Enter true to set the initialization state to true, enter false to only request the state.
 		* @return Return the initialization state of the recorder.
@@ -78,6 +126,21 @@ class ElmoRecorder {
 		*/
 		int setLogFilename(std::string sLogFileprefix);
 
+		/**
+		* @param iLogFormat One of LogFormat, text is the default.
+		*/
+		int setLogFormat(int iLogFormat);
+
+		/**
+		* @param callback Called when a read-out has ended, see ReadoutCallback.
+		*/
+		void setReadoutCallback(const ReadoutCallback& callback);
+
+		/**
+		* Ends a requested read-out that failed before its data could be processed, e.g. an aborted SDO transfer.
+		*/
+		void readoutFailed();
+
 	private:
 		/**
 		* Stores the targeted object from the time of requesting the read-out to the actual begin after "Recorder has finished" confirmation by SR
@@ -86,8 +149,17 @@ class ElmoRecorder {
 
 		float m_fRecordingStepSec;
 
+		/**
+		* Number of samples per recorded signal (RL), determines the size of a read-out.
+		*/
+		int m_iRecordingLength;
+
+		ReadoutCallback m_ReadoutCallback;
+
 		std::string m_sLogFilename;
 
+		int m_iLogFormat;
+
 		/**
 		* A flag that tells, whether we are waiting for read-out until the confirmation by SR, that the recorder is ready for read-out
 		*/
@@ -105,6 +177,18 @@ class ElmoRecorder {
 		*/
 		bool m_bIsInitialized;
 
+		/**
+		* Data of the last read-out, owned by the processing thread while m_bProcessing is set.
+		*/
+		segData m_ProcessData;
+		boost::atomic<bool> m_bProcessing;
+		boost::thread m_ProcessThread;
+
+		/**
+		* Decodes m_ProcessData and logs it to file, runs in m_ProcessThread.
+		*/
+		void processDataThread();
+
 		/**
 		* @param iObjSubIndex Requests the SDO Upload of the recorder object 0x2030 of the selected iObjSubIndex-source
 		*/
@@ -117,6 +201,21 @@ class ElmoRecorder {
 		*/
 		int logToFile(std::string filename, std::vector<float> vtValues[]);
 
+		/**
+		* Appends the recorded values with a BinaryLogHeader to a binary logfile.
+		* @param filename Path and file-prefix to an existing directory! It is extended with _MotorNumber_RecordedSource.bin
+		*/
+		int logToBinaryFile(std::string filename, const std::vector<float>& vfValues);
+
+		/**
+		* Decode the Little Endian data items of the recorder stream and scale them with the floating point factor.
+		* @param pData first item in the stream
+		* @param iNumItems number of items to decode into pfValues
+		*/
+		void decodeFloats(const unsigned char* pData, unsigned int iNumItems, float fFactor, float* pfValues);
+		void decodeHalfFloats(const unsigned char* pData, unsigned int iNumItems, float fFactor, float* pfValues);
+		void decodeLongs(const unsigned char* pData, unsigned int iNumItems, float fFactor, float* pfValues);
+
 		/**
 		* Convert the 32bit binary representation of a float to an actual 32bit float value
 		*/
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef RINGBUFFER_INCLUDEDEF_H
+#define RINGBUFFER_INCLUDEDEF_H
+
+//-----------------------------------------------
+#include <vector>
+#include <boost/atomic.hpp>
+//-----------------------------------------------
+
+/**
+ * Lock-free queue for one writer thread and one reader thread.
+ * The writer never blocks, values are dropped while the queue is full.
+ */
+template <class T>
+class RingBuffer
+{
+public:
+	/**
+	 * @param iMinSize capacity, rounded up to a power of two
+	 */
+	RingBuffer(unsigned int iMinSize = 1024)
+	{
+		unsigned int iSize = 1;
+		while(iSize < iMinSize)
+			iSize <<= 1;
+
+		m_vBuffer.resize(iSize);
+		m_iMask = iSize - 1;
+		m_iHead = 0;
+		m_iTail = 0;
+		m_iNumDropped = 0;
+	}
+
+	/**
+	 * Appends a value, called by the writer only.
+	 * @return false if the queue was full and the value has been dropped
+	 */
+	bool push(const T& value)
+	{
+		unsigned int iHead = m_iHead.load(boost::memory_order_relaxed);
+		if(iHead - m_iTail.load(boost::memory_order_acquire) > m_iMask)
+		{
+			m_iNumDropped.fetch_add(1, boost::memory_order_relaxed);
+			return false;
+		}
+
+		m_vBuffer[iHead & m_iMask] = value;
+		m_iHead.store(iHead + 1, boost::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Removes up to iMaxValues of the oldest values, called by the reader only.
+	 * @return number of values copied to pValues
+	 */
+	int pop(T* pValues, int iMaxValues)
+	{
+		unsigned int iTail = m_iTail.load(boost::memory_order_relaxed);
+		unsigned int iAvail = m_iHead.load(boost::memory_order_acquire) - iTail;
+		if(iAvail > (unsigned int)iMaxValues)
+			iAvail = iMaxValues;
+
+		for(unsigned int i = 0; i < iAvail; i++)
+			pValues[i] = m_vBuffer[(iTail + i) & m_iMask];
+
+		m_iTail.store(iTail + iAvail, boost::memory_order_release);
+		return iAvail;
+	}
+
+	/**
+	 * Number of values dropped because the reader did not keep up.
+	 */
+	unsigned int getNumDropped() const
+	{
+		return m_iNumDropped.load(boost::memory_order_relaxed);
+	}
+
+private:
+	std::vector<T> m_vBuffer;
+	unsigned int m_iMask;
+	// free running indices, the difference is the number of stored values
+	boost::atomic<unsigned int> m_iHead;
+	boost::atomic<unsigned int> m_iTail;
+	boost::atomic<unsigned int> m_iNumDropped;
+};
+//-----------------------------------------------
+#endif
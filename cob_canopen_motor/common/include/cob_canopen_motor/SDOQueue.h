@@ -0,0 +1,141 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SDOQUEUE_INCLUDEDEF_H
+#define SDOQUEUE_INCLUDEDEF_H
+
+//-----------------------------------------------
+#include <deque>
+#include <cob_utilities/TimeStamp.h>
+//-----------------------------------------------
+
+/**
+ * Configuration requests to one drive which are confirmed one by one: expedited SDO transfers
+ * and set commands of the binary interpreter.
+ * The drive handles one request at a time, so only the oldest request is outstanding. Its answer
+ * is correlated by object index and subindex (command and index for the interpreter), then the
+ * next request is released. Every drive has its own queue and the queues of all drives run at the
+ * same time, the configuration of several drives takes about as long as the one of a single drive.
+ * Segmented and block uploads (ElmoRecorder) are handled separately by segData.
+ */
+class SDOQueue
+{
+public:
+	enum RequestType
+	{
+		REQ_SDO_DOWNLOAD,
+		REQ_SDO_UPLOAD,
+		REQ_INTPRT
+	};
+
+	struct Request
+	{
+		int iType;
+		// object index and subindex of an SDO, command characters (char1 << 8 | char2) and index of an interpreter command
+		int iObjIndex;
+		int iObjSub;
+		int iData;
+		// length of an interpreter command, 4 for get and 8 for set commands
+		int iDataLen;
+	};
+
+	SDOQueue()
+	{
+		bOutstanding = false;
+		iRetries = 0;
+		uiConfirmed = 0;
+		uiRetried = 0;
+		uiFailed = 0;
+	}
+
+	void push(const Request& req) { requests.push_back(req); }
+
+	bool isEmpty() const { return requests.empty(); }
+
+	size_t size() const { return requests.size(); }
+
+	const Request& front() const { return requests.front(); }
+
+	/**
+	 * Marks the oldest request as sent.
+	 */
+	void setSent(const TimeStamp& now)
+	{
+		bOutstanding = true;
+		sentTime = now;
+	}
+
+	/**
+	 * Returns true if an answer confirms the outstanding request.
+	 * @param bIntprt the answer came from the interpreter, not from the SDO server
+	 */
+	bool matches(bool bIntprt, int iObjIndex, int iObjSub) const
+	{
+		if(!bOutstanding)
+			return false;
+		const Request& req = requests.front();
+		return ((req.iType == REQ_INTPRT) == bIntprt) && (req.iObjIndex == iObjIndex) && (req.iObjSub == iObjSub);
+	}
+
+	/**
+	 * Removes the outstanding request, the next one may be sent.
+	 */
+	void pop()
+	{
+		requests.pop_front();
+		bOutstanding = false;
+		iRetries = 0;
+	}
+
+	/**
+	 * Drops all requests, e.g. if the drive does not answer at all.
+	 */
+	void clear()
+	{
+		requests.clear();
+		bOutstanding = false;
+		iRetries = 0;
+	}
+
+	//all attributes are public, as this class is used only as container like segData
+
+	std::deque<Request> requests;
+
+	/**
+	 * The oldest request has been sent and is not confirmed yet.
+	 */
+	bool bOutstanding;
+
+	/**
+	 * Time the outstanding request was sent last.
+	 */
+	TimeStamp sentTime;
+
+	/**
+	 * Number of times the outstanding request has been repeated.
+	 */
+	int iRetries;
+
+	/**
+	 * Statistics since the construction of the drive.
+	 */
+	unsigned int uiConfirmed;
+	unsigned int uiRetried;
+	unsigned int uiFailed;
+};
+
+#endif
@@ -38,11 +38,25 @@ class segData {
 			SDO_SEG_PROCESSING = 1, /**< collection of data is finished but still has to be processed */
 		};
 
+		/**
+		* Sub-states of an SDO block upload, the overall workflow is still described by the statusFlag.
+		*/
+		enum SDOBlockState {
+			SDO_BLOCK_NONE = 0, /**< no block upload, segments are confirmed one by one */
+			SDO_BLOCK_INITIATING = 1, /**< block upload requested, waiting for the server to accept it */
+			SDO_BLOCK_RECEIVING = 2, /**< receiving the segments of a block */
+			SDO_BLOCK_ENDING = 3, /**< last block confirmed, waiting for the end of the upload */
+		};
+
 		segData() {
 			objectID = 0x0000;
 			objectSubID = 0x00;
 			toggleBit = false;
 			statusFlag = SDO_SEG_FREE;
+			blockState = SDO_BLOCK_NONE;
+			blockSeqNo = 0;
+			blockLastSegment = false;
+			blockCRC = false;
 		}
 
 		~segData() {}
@@ -56,6 +70,10 @@ class segData {
 			objectSubID = 0x00;
 			toggleBit = false;
 			statusFlag = SDO_SEG_FREE;
+			blockState = SDO_BLOCK_NONE;
+			blockSeqNo = 0;
+			blockLastSegment = false;
+			blockCRC = false;
 		}
 
 		//public attributes
@@ -90,6 +108,26 @@ class segData {
 		*/
 		unsigned int numTotalBytes;
 
+		/**
+		* State of a block upload, SDO_BLOCK_NONE for the normal segmented upload.
+		*/
+		int blockState;
+
+		/**
+		* Sequence number of the last segment received in order within the current block.
+		*/
+		int blockSeqNo;
+
+		/**
+		* The segment with the last data has been received in order.
+		*/
+		bool blockLastSegment;
+
+		/**
+		* The server protects the block upload with a CRC.
+		*/
+		bool blockCRC;
+
 		/**
 		* This vector holds the received data byte-wise
 		*/
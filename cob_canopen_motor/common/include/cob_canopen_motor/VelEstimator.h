@@ -0,0 +1,162 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef VELESTIMATOR_INCLUDEDEF_H
+#define VELESTIMATOR_INCLUDEDEF_H
+
+//-----------------------------------------------
+
+/**
+ * Estimates the gear velocity from the positions of a drive.
+ * Called once per received position, a Kalman update costs a few multiplications and one division.
+ */
+class VelEstimator
+{
+public:
+	enum Mode
+	{
+		// velocity measured by the drive itself, positions are not evaluated
+		VEL_EST_DRIVE,
+		// difference of two consecutive positions over the time between their receive time stamps
+		VEL_EST_DIFF,
+		// Kalman filter with a constant velocity model, driven by white acceleration noise
+		VEL_EST_KALMAN
+	};
+
+	VelEstimator()
+	{
+		m_iMode = VEL_EST_DRIVE;
+		m_dPosNoiseVar = 1e-8;
+		m_dAccNoiseVar = 100;
+		m_dTimeJitterVar = 0;
+		reset();
+	}
+
+	/**
+	 * Selects the estimator and sets the noise of the Kalman filter.
+	 * @param iMode one of Mode
+	 * @param dPosNoiseRad standard deviation of the measured position, e.g. the encoder resolution / sqrt(12)
+	 * @param dAccNoiseRadS2 spectral density of the acceleration in rad/s^2/sqrt(Hz), larger values follow faster
+	 * @param dTimeJitterS standard deviation of the receive time stamps against the sampling of the drive
+	 */
+	void setMode(int iMode, double dPosNoiseRad, double dAccNoiseRadS2, double dTimeJitterS)
+	{
+		m_iMode = iMode;
+		m_dPosNoiseVar = dPosNoiseRad * dPosNoiseRad;
+		m_dAccNoiseVar = dAccNoiseRadS2 * dAccNoiseRadS2;
+		m_dTimeJitterVar = dTimeJitterS * dTimeJitterS;
+		reset();
+	}
+
+	int getMode() const { return m_iMode; }
+
+	/**
+	 * Restarts the estimation, the next position is taken as it is.
+	 */
+	void reset()
+	{
+		m_bValid = false;
+		m_dPos = 0;
+		m_dVel = 0;
+		m_dP00 = 0;
+		m_dP01 = 0;
+		m_dP11 = 0;
+	}
+
+	/**
+	 * Evaluates a new position.
+	 * @param dPos measured position in rad
+	 * @param dt time since the previous position in s, from the receive time stamps of both
+	 * @param dVelDrive velocity measured by the drive in rad/s
+	 * @return estimated velocity in rad/s
+	 */
+	double update(double dPos, double dt, double dVelDrive)
+	{
+		// longest gap between two positions that is still bridged by the model
+		const double c_dMaxGapS = 0.5;
+		// variance of the velocity after a restart, (rad/s)^2
+		const double c_dInitVelVar = 100;
+
+		if(m_iMode == VEL_EST_DRIVE)
+			return dVelDrive;
+
+		// first sample, or the drive has been silent for too long to extrapolate
+		if(!m_bValid || (dt > c_dMaxGapS))
+		{
+			m_bValid = true;
+			m_dPos = dPos;
+			m_dVel = dVelDrive;
+			m_dP00 = m_dPosNoiseVar;
+			m_dP01 = 0;
+			m_dP11 = c_dInitVelVar;
+			return m_dVel;
+		}
+
+		// two positions within the time stamp resolution carry no velocity information
+		if(dt <= 0)
+			return m_dVel;
+
+		if(m_iMode == VEL_EST_DIFF)
+		{
+			m_dVel = (dPos - m_dPos) / dt;
+			m_dPos = dPos;
+			return m_dVel;
+		}
+
+		// predict, Q = q * [dt^3/3 dt^2/2; dt^2/2 dt]
+		double dQ11 = m_dAccNoiseVar * dt;
+		double dQ01 = 0.5 * dQ11 * dt;
+		double dQ00 = dQ01 * dt * (2.0 / 3.0);
+
+		m_dPos += m_dVel * dt;
+		m_dP00 += dt * (2 * m_dP01 + dt * m_dP11) + dQ00;
+		m_dP01 += dt * m_dP11 + dQ01;
+		m_dP11 += dQ11;
+
+		// correct with the measured position, a time stamp error appears as a position error growing with the velocity
+		double dInvS = 1.0 / (m_dP00 + m_dPosNoiseVar + m_dVel * m_dVel * m_dTimeJitterVar);
+		double dK0 = m_dP00 * dInvS;
+		double dK1 = m_dP01 * dInvS;
+		double dInnov = dPos - m_dPos;
+
+		m_dPos += dK0 * dInnov;
+		m_dVel += dK1 * dInnov;
+
+		m_dP11 -= dK1 * m_dP01;
+		m_dP00 -= dK0 * m_dP00;
+		m_dP01 -= dK0 * m_dP01;
+
+		return m_dVel;
+	}
+
+private:
+	int m_iMode;
+	double m_dPosNoiseVar;
+	double m_dAccNoiseVar;
+	double m_dTimeJitterVar;
+
+	bool m_bValid;
+	double m_dPos;
+	double m_dVel;
+	// covariance of position and velocity
+	double m_dP00;
+	double m_dP01;
+	double m_dP11;
+};
+
+//-----------------------------------------------
+#endif
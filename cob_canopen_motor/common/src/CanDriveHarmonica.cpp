@@ -17,7 +17,9 @@
 
 #include <assert.h>
 #include <cob_canopen_motor/CanDriveHarmonica.h>
+#include <math.h>
 #include <unistd.h>
+#include <sstream>
 
 //-----------------------------------------------
 CanDriveHarmonica::CanDriveHarmonica()
@@ -25,6 +27,10 @@ CanDriveHarmonica::CanDriveHarmonica()
 	// Parameter
 	m_Param.iDivForRequestStatus = 10;
 	m_Param.dCanTimeout = 6;
+	m_Param.bSyncPDOMode = false;
+	m_Param.iTelemetryPeriodMS = 0;
+	m_Param.bEventErrorDetection = false;
+	m_Param.iHeartbeatPeriodMS = 100;
 
 	// Variables
 	m_pCanCtrl = NULL;
@@ -33,8 +39,18 @@ CanDriveHarmonica::CanDriveHarmonica()
 	m_dPosGearMeasRad = 0;
 	m_dAngleGearRadMem  = 0;
 	m_dVelGearMeasRadS = 0;
+	m_uiPosVelSeq = 0;
+	m_iRatedCurrentmA = 0;
+	m_dVelGearCmdRadS = 0;
+	m_dVelGearRadSToIncr = 0;
+	m_dVelIncrToGearRadS = 0;
+	m_dVelMaxIncr = 0;
+	m_dPosIncrToGearRad = 0;
+	m_dTelemetryPosGearRad = 0;
+	m_bTelemetryPosValid = false;
 
 	m_VelCalcTime.SetNow();
+	m_PosVelMeasTime.SetNow();
 
 	m_bLimSwLeft = false;
 	m_bLimSwRight = false;
@@ -52,11 +68,17 @@ CanDriveHarmonica::CanDriveHarmonica()
 	m_StartTime.SetNow();
 
 	m_bOutputOfFailure = false;
+	m_bHeartbeatSupervised = false;
+	m_iNMTState = 0;
 
 	m_bIsInitialized = false;
+	m_bInitPosRequested = false;
+	m_bStartStatusRequested = false;
+	m_bStartStatusOk = false;
 
 
 	ElmoRec = new ElmoRecorder(this);
+	m_bSDOBlockUploadSupported = true;
 
 }
 
@@ -65,10 +87,63 @@ void CanDriveHarmonica::setCanOpenParam( int iTxPDO1, int iTxPDO2, int iRxPDO2,
 {
 	m_ParamCanOpen.iTxPDO1 = iTxPDO1;
 	m_ParamCanOpen.iTxPDO2 = iTxPDO2;
+	// default CANopen identifier of TPDO3 is 0x380 + node ID
+	m_ParamCanOpen.iTxPDO3 = iTxPDO1 + 0x200;
+	// default CANopen identifier of TPDO4 is 0x480 + node ID
+	m_ParamCanOpen.iTxPDO4 = iTxPDO1 + 0x300;
 	m_ParamCanOpen.iRxPDO2 = iRxPDO2;
 	m_ParamCanOpen.iTxSDO = iTxSDO;
 	m_ParamCanOpen.iRxSDO = iRxSDO;
+	// the node ID is taken from the default CANopen identifier 0x580 + node ID of the transmit SDO
+	m_ParamCanOpen.iEMCY = iTxSDO - 0x580 + 0x80;
+	m_ParamCanOpen.iHeartbeat = iTxSDO - 0x580 + 0x700;
 
+	prepareSetpointMsgs();
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::setDriveParam(DriveParam driveParam)
+{
+	m_DriveParam = driveParam;
+
+	prepareSetpointMsgs();
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::prepareSetpointMsgs()
+{
+	m_dVelGearRadSToIncr = m_DriveParam.getSign() * m_DriveParam.getVelGearRadSToVelMotIncrPeriodFactor();
+	m_dVelIncrToGearRadS = m_DriveParam.getSign() * m_DriveParam.getVelMotIncrPeriodToVelGearRadSFactor();
+	m_dPosIncrToGearRad = m_DriveParam.getSign() * m_DriveParam.getPosMotIncrToPosGearRadFactor();
+	m_dVelMaxIncr = m_DriveParam.getVelMax();
+
+	// jog velocity, the value in bytes 4..7 is filled in per cycle
+	m_SetpointMsgs[0].m_iID = m_ParamCanOpen.iRxPDO2;
+	m_SetpointMsgs[0].m_iLen = 8;
+	m_SetpointMsgs[0].set('J', 'V', 0, 0, 0, 0, 0, 0);
+
+	// begin motion
+	m_SetpointMsgs[1].m_iID = m_ParamCanOpen.iRxPDO2;
+	m_SetpointMsgs[1].m_iLen = 4;
+	m_SetpointMsgs[1].set('B', 'G', 0, 0, 0, 0, 0, 0);
+
+	// heartbeat to keep watchdog inactive
+	m_SetpointMsgs[2].m_iID = 0x700;
+	m_SetpointMsgs[2].m_iLen = 5;
+	m_SetpointMsgs[2].set(0x00, 0, 0, 0, 0, 0, 0, 0);
+
+	// request pos and vel by TPDO1, triggered by SYNC msg
+	// (to request pos by SDO use sendSDOUpload(0x6064, 0) )
+	m_SetpointMsgs[3].m_iID = 0x80;
+	m_SetpointMsgs[3].m_iLen = 0;
+	m_SetpointMsgs[3].set(0, 0, 0, 0, 0, 0, 0, 0);
+
+	// torque command as float (index bit 7 set), the current in bytes 4..7 is filled in per cycle
+	m_TorqueMsgs[0].m_iID = m_ParamCanOpen.iRxPDO2;
+	m_TorqueMsgs[0].m_iLen = 8;
+	m_TorqueMsgs[0].set('T', 'C', 0, 0x80, 0, 0, 0, 0);
+	m_TorqueMsgs[1] = m_SetpointMsgs[2];
+	m_TorqueMsgs[2] = m_SetpointMsgs[3];
 }
 
 //-----------------------------------------------
@@ -91,14 +166,13 @@ bool CanDriveHarmonica::evalReceivedMsg(CanMsg& msg)
 		iTemp1 = (msg.getAt(3) << 24) | (msg.getAt(2) << 16)
 				| (msg.getAt(1) << 8) | (msg.getAt(0) );
 
-		m_dPosGearMeasRad = m_DriveParam.getSign() * m_DriveParam.
-			PosMotIncrToPosGearRad(iTemp1);
-
 		iTemp2 = (msg.getAt(7) << 24) | (msg.getAt(6) << 16)
 				| (msg.getAt(5) << 8) | (msg.getAt(4) );
 
-		m_dVelGearMeasRadS = m_DriveParam.getSign() * m_DriveParam.
-			VelMotIncrPeriodToVelGearRadS(iTemp2);
+		getRxTime(msg, &m_PosVelMeasTime);
+		double dPosGearRad = iTemp1 * m_dPosIncrToGearRad;
+		double dVelGearRadS = iTemp2 * m_dVelIncrToGearRadS;
+		setPosVelMeas(dPosGearRad, estimVel(dPosGearRad, dVelGearRadS));
 
 		m_WatchdogTime.SetNow();
 
@@ -111,6 +185,16 @@ bool CanDriveHarmonica::evalReceivedMsg(CanMsg& msg)
 	{
 		if( (msg.getAt(0) == 'P') && (msg.getAt(1) == 'X') ) // current pos
 		{
+			if(m_bInitPosRequested)
+			{
+				iTemp1 = (msg.getAt(7) << 24) | (msg.getAt(6) << 16)
+					| (msg.getAt(5) << 8) | (msg.getAt(4) );
+
+				setPosVelMeas(iTemp1 * m_dPosIncrToGearRad, 0);
+				m_VelEstimator.reset();
+				m_dAngleGearRadMem  = m_dPosGearMeasRad;
+				m_bInitPosRequested = false;
+			}
 		}
 
 		else if( (msg.getAt(0) == 'P') && (msg.getAt(1) == 'A') ) // position absolute
@@ -149,9 +233,15 @@ bool CanDriveHarmonica::evalReceivedMsg(CanMsg& msg)
 			m_iStatusCtrl = (msg.getAt(7) << 24) | (msg.getAt(6) << 16)
 				| (msg.getAt(5) << 8) | (msg.getAt(4) );
 
-			evalStatusRegister(m_iStatusCtrl);
+			bool bStatusOk = evalStatusRegister(m_iStatusCtrl);
 			ElmoRec->readoutRecorderTryStatus(m_iStatusCtrl, seg_Data);
 
+			if(m_bStartStatusRequested)
+			{
+				m_bStartStatusOk = bStatusOk;
+				m_bStartStatusRequested = false;
+			}
+
 		}
 
 		else if( (msg.getAt(0) == 'M') && (msg.getAt(1) == 'F') ) // motor failure
@@ -217,18 +307,89 @@ bool CanDriveHarmonica::evalReceivedMsg(CanMsg& msg)
 		{
 		}
 
+		// after the evaluation, a queued request is completed only once its answer has taken effect
+		confirmRequest(true, (msg.getAt(0) << 8) | msg.getAt(1), msg.getAt(2) | ((msg.getAt(3) & 0x3F) << 8), false, 0);
+
 		m_WatchdogTime.SetNow();
 
 		bRet = true;
 	}
 
+	//-----------------------
+	// eval answers from PDO3 - status register and active current, transmitted on SYNC msg
+	if (m_Param.bSyncPDOMode && (msg.m_iID == m_ParamCanOpen.iTxPDO3))
+	{
+		m_iStatusCtrl = (msg.getAt(3) << 24) | (msg.getAt(2) << 16)
+			| (msg.getAt(1) << 8) | (msg.getAt(0) );
+
+		evalStatusRegister(m_iStatusCtrl);
+		ElmoRec->readoutRecorderTryStatus(m_iStatusCtrl, seg_Data);
+
+		// current actual value in thousandths of the rated current
+		short iCurrent = (short)((msg.getAt(5) << 8) | msg.getAt(4));
+		m_dMotorCurr = (double)iCurrent * m_iRatedCurrentmA / 1.0e6;
+
+		m_WatchdogTime.SetNow();
+
+		bRet = true;
+	}
+
+	//-----------------------
+	// eval answers from PDO4 - position and active current, transmitted on event timer
+	if ((m_Param.iTelemetryPeriodMS > 0) && (msg.m_iID == m_ParamCanOpen.iTxPDO4))
+	{
+		TelemetrySample sample;
+		// the samples are stamped with the wall clock at reception, the velocity uses the monotonic receive times
+		TimeStamp now(TimeStamp::CLOCK_TYPE_REALTIME);
+		TimeStamp nowMono, rxTime;
+		long lSec, lNSec;
+
+		iTemp1 = (msg.getAt(3) << 24) | (msg.getAt(2) << 16)
+				| (msg.getAt(1) << 8) | (msg.getAt(0) );
+		short iCurrent = (short)((msg.getAt(5) << 8) | msg.getAt(4));
+
+		getRxTime(msg, &rxTime);
+		now.SetNow();
+		nowMono.SetNow();
+		now -= (nowMono - rxTime);
+		now.getTimeStamp(lSec, lNSec);
+
+		sample.dTimeSec = lSec + 1e-9 * lNSec;
+		sample.dPosGearRad = iTemp1 * m_dPosIncrToGearRad;
+		sample.dCurrentA = (double)iCurrent * m_iRatedCurrentmA / 1.0e6;
+
+		// velocity from consecutive positions, TPDO1 only arrives at the control rate
+		double dt = rxTime - m_TelemetryTime;
+		if(m_bTelemetryPosValid && (dt > 0))
+			sample.dVelErrGearRadS = m_dVelGearCmdRadS - (sample.dPosGearRad - m_dTelemetryPosGearRad) / dt;
+		else
+			sample.dVelErrGearRadS = 0;
+
+		m_dTelemetryPosGearRad = sample.dPosGearRad;
+		m_TelemetryTime = rxTime;
+		m_bTelemetryPosValid = true;
+
+		m_Telemetry.push(sample);
+
+		bRet = true;
+	}
+
 	//-----------------------
 	// eval answer from SDO
 	if (msg.m_iID == m_ParamCanOpen.iTxSDO)
 	{
 		m_WatchdogTime.SetNow();
 
-		if( (msg.getAt(0) >> 5) == 0) { //Received Upload SDO Segment (scs = 0)
+		if(seg_Data.blockState == segData::SDO_BLOCK_RECEIVING) { //Segments of a block carry a sequence number instead of a command specifier
+			receivedSDOBlockSegment(msg);
+
+		} else if( ((msg.getAt(0) & 0xE1) == 0xC0) && (seg_Data.blockState == segData::SDO_BLOCK_INITIATING) ) { //Received Initiate Block Upload (scs = 6, ss = 0)
+			receivedSDOBlockInitiation(msg);
+
+		} else if( ((msg.getAt(0) & 0xE1) == 0xC1) && (seg_Data.blockState == segData::SDO_BLOCK_ENDING) ) { //Received End Block Upload (scs = 6, ss = 1)
+			receivedSDOBlockEnd(msg);
+
+		} else if( (msg.getAt(0) >> 5) == 0) { //Received Upload SDO Segment (scs = 0)
 			//std::cout << "SDO Upload Segment received" << std::endl;
 			receivedSDODataSegment(msg);
 
@@ -236,66 +397,118 @@ bool CanDriveHarmonica::evalReceivedMsg(CanMsg& msg)
 			//std::cout << "SDO Initiate Segmented Upload received, Object ID: " << (msg.getAt(1) | (msg.getAt(2) << 8) ) << std::endl;
 			receivedSDOSegmentedInitiation(msg);
 
+		} else if( (msg.getAt(0) & 0xE2) == 0x42) { //Received expedited Initiate SDO Upload (scs = 2 AND expedited flag = 1)
+			int iObjIndex = msg.getAt(1) | (msg.getAt(2) << 8);
+			int iData = msg.getAt(4) | (msg.getAt(5) << 8) | (msg.getAt(6) << 16) | (msg.getAt(7) << 24);
+
+			if(iObjIndex == 0x6075)
+				m_iRatedCurrentmA = iData;
+
+			confirmRequest(false, iObjIndex, msg.getAt(3), false, 0);
+
+		} else if( (msg.getAt(0) >> 5) == 3) { //Received Initiate SDO Download response (scs = 3)
+			confirmRequest(false, msg.getAt(1) | (msg.getAt(2) << 8), msg.getAt(3), false, 0);
+
 		} else if( (msg.getAt(0) >> 5) == 4) { // Received an Abort SDO Transfer message, cs = 4
 			unsigned int iErrorNum = (msg.getAt(4) | msg.getAt(5) << 8 | msg.getAt(6) << 16 | msg.getAt(7) << 24);
-			receivedSDOTransferAbort(iErrorNum);
+			// an abort of a queued request does not concern a segmented transfer of the ElmoRecorder
+			if( !confirmRequest(false, msg.getAt(1) | (msg.getAt(2) << 8), msg.getAt(3), true, iErrorNum) )
+				receivedSDOTransferAbort(iErrorNum);
 		}
 
 		bRet = true;
 	}
 
+	//-----------------------
+	// eval emergency and heartbeat of the drive
+	if (m_Param.bEventErrorDetection && (msg.m_iID == m_ParamCanOpen.iEMCY))
+	{
+		evalEmergency(msg);
+		bRet = true;
+	}
+
+	if (m_Param.bEventErrorDetection && (msg.m_iID == m_ParamCanOpen.iHeartbeat))
+	{
+		evalHeartbeat(msg);
+		m_WatchdogTime.SetNow();
+		bRet = true;
+	}
+
 	return bRet;
 }
 
 //-----------------------------------------------
-bool CanDriveHarmonica::init()
+void CanDriveHarmonica::getReceivedCanIDs(std::vector<int>* pviIDs)
 {
-	int iCnt, iPosCnt;
-	bool bRet = true;
-	CanMsg Msg;
+	pviIDs->push_back(m_ParamCanOpen.iTxPDO1);
+	pviIDs->push_back(m_ParamCanOpen.iTxPDO2);
+	pviIDs->push_back(m_ParamCanOpen.iTxSDO);
 
-	m_iMotorState = ST_PRE_INITIALIZED;
+	if( m_Param.bSyncPDOMode )
+		pviIDs->push_back(m_ParamCanOpen.iTxPDO3);
 
+	if( m_Param.iTelemetryPeriodMS > 0 )
+		pviIDs->push_back(m_ParamCanOpen.iTxPDO4);
 
-	// Set Values for Modulo-Counting. Neccessary to preserve absolute position for homed motors (after encoder overflow)
-	int iIncrRevWheel = int( (double)m_DriveParam.getGearRatio() * (double)m_DriveParam.getBeltRatio()
-					* (double)m_DriveParam.getEncIncrPerRevMot() * 3 );
-	IntprtSetInt(8, 'M', 'O', 0, 0);
-	usleep(20000);
-	IntprtSetInt(8, 'X', 'M', 2, iIncrRevWheel * 5000);
-	usleep(20000);
-	IntprtSetInt(8, 'X', 'M', 1, -iIncrRevWheel * 5000);
-	usleep(20000);
-
+	if( m_Param.bEventErrorDetection )
+	{
+		pviIDs->push_back(m_ParamCanOpen.iEMCY);
+		pviIDs->push_back(m_ParamCanOpen.iHeartbeat);
+	}
+}
 
-	setTypeMotion(MOTIONTYPE_VELCTRL);
-	// ---------- set position counter to zero
-	IntprtSetInt(8, 'P', 'X', 0, 0);
+//-----------------------------------------------
+bool CanDriveHarmonica::init()
+{
+	int iDelayUs;
+	for(int iStep = 0; (iDelayUs = sendInitStep(iStep)) >= 0; iStep++)
+		usleep(iDelayUs);
 
-	iCnt = 0;
-	while(true)
-	{
-		m_pCanCtrl->receiveMsg(&Msg);
+	// the position counter is set by the last request
+	bool bRet = waitForRequests() && isInitAnswered();
 
-		if( (Msg.getAt(0) == 'P') && (Msg.getAt(1) == 'X') )
-		{
-			iPosCnt = (Msg.getAt(7) << 24) | (Msg.getAt(6) << 16)
-				| (Msg.getAt(5) << 8) | (Msg.getAt(4) );
+	bRet = finishInit(bRet);
+	waitForRequests();
 
-			m_dPosGearMeasRad = m_DriveParam.getSign() * m_DriveParam.PosMotIncrToPosGearRad(iPosCnt);
-			m_dAngleGearRadMem  = m_dPosGearMeasRad;
-			break;
-		}
+	return bRet;
+}
+//-----------------------------------------------
+int CanDriveHarmonica::sendInitStep(int iStep)
+{
+	int iIncrRevWheel = int( (double)m_DriveParam.getGearRatio() * (double)m_DriveParam.getBeltRatio()
+					* (double)m_DriveParam.getEncIncrPerRevMot() * 3 );
 
-		if ( iCnt > 300 )
-		{
-			std::cout << "CanDriveHarmonica: initial position not set" << std::endl;
-			bRet = false;
-			break;
-		}
+	// the commands are queued, each one is sent when the drive has confirmed the previous one
+	switch(iStep)
+	{
+	case 0:
+		m_iMotorState = ST_PRE_INITIALIZED;
+		m_bInitPosRequested = false;
+		// Set Values for Modulo-Counting. Neccessary to preserve absolute position for homed motors (after encoder overflow)
+		queueIntprtSetInt(8, 'M', 'O', 0, 0);
+		queueIntprtSetInt(8, 'X', 'M', 2, iIncrRevWheel * 5000);
+		queueIntprtSetInt(8, 'X', 'M', 1, -iIncrRevWheel * 5000);
+
+		sendTypeMotionVelCtrl();
+		m_iTypeMotion = MOTIONTYPE_VELCTRL;
+
+		// ---------- set position counter to zero, the answer is evaluated in evalReceivedMsg()
+		m_bInitPosRequested = true;
+		queueIntprtSetInt(8, 'P', 'X', 0, 0);
+		return 0;
+	default:
+		return -1;
+	}
+}
+//-----------------------------------------------
+bool CanDriveHarmonica::finishInit(bool bAnswered)
+{
+	bool bRet = bAnswered;
 
-		usleep(10000);
-		iCnt++;
+	if( !bAnswered )
+	{
+		m_bInitPosRequested = false;
+		std::cout << "CanDriveHarmonica: initial position not set" << std::endl;
 	}
 
 	// ---------- set PDO mapping
@@ -304,21 +517,91 @@ bool CanDriveHarmonica::init()
 	// - velocity
 
 	// stop all emissions of TPDO1
-	sendSDODownload(0x1A00, 0, 0);
+	queueSDODownload(0x1A00, 0, 0);
 
 	// position 4 byte of TPDO1
-	sendSDODownload(0x1A00, 1, 0x60640020);
+	queueSDODownload(0x1A00, 1, 0x60640020);
 
 	// velocity 4 byte of TPDO1
-	sendSDODownload(0x1A00, 2, 0x60690020);
+	queueSDODownload(0x1A00, 2, 0x60690020);
 
 	// transmission type "synch"
-	sendSDODownload(0x1800, 2, 1);
+	queueSDODownload(0x1800, 2, 1);
 
 	// activate mapped objects
-	sendSDODownload(0x1A00, 0, 2);
+	queueSDODownload(0x1A00, 0, 2);
+
+	if( m_Param.bSyncPDOMode )
+	{
+		// Mapping of TPDO3:
+		// - status register
+		// - active current
+
+		// invalidate TPDO3 while it is reconfigured
+		queueSDODownload(0x1802, 1, m_ParamCanOpen.iTxPDO3 | 0x80000000);
+
+		// stop all emissions of TPDO3
+		queueSDODownload(0x1A02, 0, 0);
+
+		// status register 4 byte of TPDO3
+		queueSDODownload(0x1A02, 1, 0x10020020);
+
+		// current actual value 2 byte of TPDO3
+		queueSDODownload(0x1A02, 2, 0x60780010);
+
+		// transmission type "synch"
+		queueSDODownload(0x1802, 2, 1);
+
+		// activate mapped objects
+		queueSDODownload(0x1A02, 0, 2);
+
+		// validate TPDO3
+		queueSDODownload(0x1802, 1, m_ParamCanOpen.iTxPDO3);
+	}
+
+	if( m_Param.iTelemetryPeriodMS > 0 )
+	{
+		// Mapping of TPDO4:
+		// - position
+		// - active current
+
+		// invalidate TPDO4 while it is reconfigured
+		queueSDODownload(0x1803, 1, m_ParamCanOpen.iTxPDO4 | 0x80000000);
+
+		// stop all emissions of TPDO4
+		queueSDODownload(0x1A03, 0, 0);
+
+		// position 4 byte of TPDO4
+		queueSDODownload(0x1A03, 1, 0x60640020);
+
+		// current actual value 2 byte of TPDO4
+		queueSDODownload(0x1A03, 2, 0x60780010);
+
+		// transmission type "asynchronous", sent by the event timer
+		queueSDODownload(0x1803, 2, 255);
+		queueSDODownload(0x1803, 5, m_Param.iTelemetryPeriodMS);
+
+		// activate mapped objects
+		queueSDODownload(0x1A03, 0, 2);
+
+		// validate TPDO4
+		queueSDODownload(0x1803, 1, m_ParamCanOpen.iTxPDO4);
+	}
+
+	if( m_Param.bSyncPDOMode || (m_Param.iTelemetryPeriodMS > 0) )
+	{
+		// rated current to scale the current of TPDO3 and TPDO4
+		queueSDOUpload(0x6075, 0);
+	}
+
+	if( m_Param.bEventErrorDetection )
+	{
+		// producer heartbeat time, supervised by checkHeartbeat()
+		queueSDODownload(0x1017, 0, m_Param.iHeartbeatPeriodMS);
+	}
 
 	m_bWatchdogActive = false;
+	m_bHeartbeatSupervised = false;
 
 	if( bRet )
 		m_bIsInitialized = true;
@@ -337,56 +620,51 @@ bool CanDriveHarmonica::stop()
 //-----------------------------------------------
 bool CanDriveHarmonica::start()
 {
-	// motor on
-	IntprtSetInt(8, 'M', 'O', 0, 1);
-	usleep(20000);
+	int iDelayUs;
+	for(int iStep = 0; (iDelayUs = sendStartStep(iStep)) >= 0; iStep++)
+		usleep(iDelayUs);
 
-	// ------------------- request status
-	int iCnt;
-	bool bRet = true;
-	int iStatus;
-	CanMsg Msg;
+	// the status is requested by the last request
+	bool bRet = waitForRequests() && isInitAnswered();
 
-	//  clear the can buffer
-	do
+	return finishStart(bRet);
+}
+//-----------------------------------------------
+int CanDriveHarmonica::sendStartStep(int iStep)
+{
+	switch(iStep)
 	{
-		bRet = m_pCanCtrl->receiveMsg(&Msg);
+	case 0:
+		// motor on
+		queueIntprtSetInt(8, 'M', 'O', 0, 1);
+
+		// request status once the motor is on, the answer is evaluated in evalReceivedMsg()
+		m_bStartStatusOk = false;
+		m_bStartStatusRequested = true;
+		queueIntprtSetInt(4, 'S', 'R', 0, 0);
+		return 0;
+	default:
+		return -1;
 	}
-	while(bRet == true);
-
-	// send request
-	IntprtSetInt(4, 'S', 'R', 0, 0);
-
-	iCnt = 0;
-	while(true)
+}
+//-----------------------------------------------
+bool CanDriveHarmonica::finishStart(bool bAnswered)
+{
+	if( !bAnswered )
 	{
-		m_pCanCtrl->receiveMsg(&Msg);
-
-		if( (Msg.getAt(0) == 'S') && (Msg.getAt(1) == 'R') )
-		{
-			iStatus = (Msg.getAt(7) << 24) | (Msg.getAt(6) << 16)
-				| (Msg.getAt(5) << 8) | (Msg.getAt(4) );
-
-			bRet = evalStatusRegister(iStatus);
-			break;
-		}
-
-		if ( iCnt > 300 )
-		{
-			std::cout << "CanDriveHarmonica::enableMotor(): No answer on status request" << std::endl;
-			bRet = false;
-			break;
-		}
-
-		usleep(10000);
-		iCnt++;
+		m_bStartStatusRequested = false;
+		std::cout << "CanDriveHarmonica::enableMotor(): No answer on status request" << std::endl;
 	}
 
 	// ------------------- start watchdog timer
 	m_WatchdogTime.SetNow();
 	m_SendTime.SetNow();
 
-	return bRet;
+	// ------------------- start node guarding
+	m_HeartbeatTime.SetNow();
+	m_bHeartbeatSupervised = m_Param.bEventErrorDetection;
+
+	return bAnswered && m_bStartStatusOk;
 }
 
 //-----------------------------------------------
@@ -432,19 +710,18 @@ bool CanDriveHarmonica::startWatchdog(bool bStarted)
 		const int c_iNMTNodeID = 0x00;
 
 		// consumer (PC) heartbeat time
-		sendSDODownload(0x1016, 1, (c_iNMTNodeID << 16) | c_iHeartbeatTimeMS);
+		queueSDODownload(0x1016, 1, (c_iNMTNodeID << 16) | c_iHeartbeatTimeMS);
 
 		// error behavior after failure: 0=pre-operational, 1=no state change, 2=stopped"
-		sendSDODownload(0x1029, 1, 2);
+		queueSDODownload(0x1029, 1, 2);
 
 		// motor behavior after heartbeat failre: "quick stop"
-		sendSDODownload(0x6007, 0, 3);
+		queueSDODownload(0x6007, 0, 3);
 
 		// acivate emergency events: "heartbeat event"
 		// Object 0x2F21 = "Emergency Events" which cause an Emergency Message
 		// Bit 3 is responsible for Heartbeart-Failure.--> Hex 0x08
-		sendSDODownload(0x2F21, 0, 0x08);
-		usleep(20000);
+		queueSDODownload(0x2F21, 0, 0x08);
 
 	}
 	else
@@ -453,18 +730,15 @@ bool CanDriveHarmonica::startWatchdog(bool bStarted)
 		m_bWatchdogActive = false;
 
 		//Motor action after Hearbeat-Error: No Action
-		sendSDODownload(0x6007, 0, 0);
+		queueSDODownload(0x6007, 0, 0);
 
 		//Error Behavior: No state change
-		sendSDODownload(0x1029, 1, 1);
+		queueSDODownload(0x1029, 1, 1);
 
 		// Deacivate emergency events: "heartbeat event"
 		// Object 0x2F21 = "Emergency Events" which cause an Emergency Message
 		// Bit 3 is responsible for Heartbeart-Failure.
-		sendSDODownload(0x2F21, 0, 0x00);
-		usleep(25000);
-
-
+		queueSDODownload(0x2F21, 0, 0x00);
 	}
 
 	return true;
@@ -490,53 +764,61 @@ bool CanDriveHarmonica::getStatusLimitSwitch()
 }
 //-----------------------------------------------
 bool CanDriveHarmonica::initHoming()
+{
+	int iDelayUs;
+	for(int iStep = 0; (iDelayUs = sendHomingInitStep(iStep)) >= 0; iStep++)
+		usleep(iDelayUs);
+
+	bool bRet = waitForRequests();
+
+	// 3. let the motor turn some time to give him the possibility to escape the approximation sensor if accidently in home position already at the beginning of the sequence (done in CanCtrlPltf...)
+
+	return bRet;
+}
+//-----------------------------------------------
+int CanDriveHarmonica::sendHomingInitStep(int iStep)
 {
 	const int c_iPosRef = m_DriveParam.getEncOffset();
 
+	// the commands are queued, the controller confirms each one before the next is sent
+	switch(iStep)
+	{
+	case 0:
 		// 1. make sure that, if on elmo controller still a pending homing from a previous startup is running (in case of warm-start without switching of the whole robot), this old sequence is disabled
 		// disarm homing process
-		IntprtSetInt(8, 'H', 'M', 1, 0);
-
-		// always give can and controller some time to understand the command
-		usleep(20000);
+		queueIntprtSetInt(8, 'H', 'M', 1, 0);
 
 		/* THIS is needed for head_axis on cob3-2!
 
 		//set input logic to 'general purpose'
-		IntprtSetInt(8, 'I', 'L', 2, 7);
-		usleep(20000);
+		queueIntprtSetInt(8, 'I', 'L', 2, 7);
 		*/
 
 		// 2. configure the homing sequence
 		// 2.a set the value to which the increment counter shall be reseted as soon as the homing event occurs
 		// value to load at homing event
-		IntprtSetInt(8, 'H', 'M', 2, c_iPosRef);
-		usleep(20000);
+		queueIntprtSetInt(8, 'H', 'M', 2, c_iPosRef);
 
 		// 2.b choose the chanel/switch on which the controller listens for a change or defined logic level (the homing event) (high/low/falling/rising)
 		// home event
 		// iHomeEvent = 5 : event according to defined FLS switch (for scara arm)
 		// iHomeEvent = 9 : event according to definded DIN1 switch (for full steerable wheels COb3)
 		// iHomeEvent =11 : event according to ?? (for COb3 Head-Axis)
-		IntprtSetInt(8, 'H', 'M', 3, m_DriveParam.getHomingDigIn());
-		//IntprtSetInt(8, 'H', 'M', 3, 11); //cob3-2
-		usleep(20000);
-
+		queueIntprtSetInt(8, 'H', 'M', 3, m_DriveParam.getHomingDigIn());
+		//queueIntprtSetInt(8, 'H', 'M', 3, 11); //cob3-2
 
 		// 2.c choose the action that the controller shall perform after the homing event occured
 		// HM[4] = 0 : after Event stop immediately
 		// HM[4] = 2 : Do nothing!
-		IntprtSetInt(8, 'H', 'M', 4, 2);
-		usleep(20000);
+		queueIntprtSetInt(8, 'H', 'M', 4, 2);
 
 		// 2.d choose the setting of the position counter (i.e. to the value defined in 2.a) after the homing event occured
 		// HM[5] = 0 : absolute setting of position counter: PX = HM[2]
-		IntprtSetInt(8, 'H', 'M', 5, 0);
-		usleep(20000);
-
-		// 3. let the motor turn some time to give him the possibility to escape the approximation sensor if accidently in home position already at the beginning of the sequence (done in CanCtrlPltf...)
-
-	return true;
+		queueIntprtSetInt(8, 'H', 'M', 5, 0);
+		return 0;
+	default:
+		return -1;
+	}
 }
 
 
@@ -669,37 +951,31 @@ void CanDriveHarmonica::setGearVelRadS(double dVelGearRadS)
 	int iVelEncIncrPeriod;
 
 	// calc motor velocity from joint velocity
-	iVelEncIncrPeriod = m_DriveParam.getSign() * m_DriveParam.VelGearRadSToVelMotIncrPeriod(dVelGearRadS);
+	double dVelEncIncrPeriod = dVelGearRadS * m_dVelGearRadSToIncr;
 
-	if(iVelEncIncrPeriod > m_DriveParam.getVelMax())
+	if(dVelEncIncrPeriod > m_dVelMaxIncr)
 	{
-		std::cout << "SteerVelo asked for " << iVelEncIncrPeriod << " EncIncrements" << std::endl;
-		iVelEncIncrPeriod = (int)m_DriveParam.getVelMax();
+		std::cout << "SteerVelo asked for " << (int)dVelEncIncrPeriod << " EncIncrements" << std::endl;
+		dVelEncIncrPeriod = m_dVelMaxIncr;
 	}
 
-	if(iVelEncIncrPeriod < -m_DriveParam.getVelMax())
+	if(dVelEncIncrPeriod < -m_dVelMaxIncr)
 	{
-		std::cout << "SteerVelo asked for " << iVelEncIncrPeriod << " EncIncrements" << std::endl;
-		iVelEncIncrPeriod = -1 * (int)m_DriveParam.getVelMax();
+		std::cout << "SteerVelo asked for " << (int)dVelEncIncrPeriod << " EncIncrements" << std::endl;
+		dVelEncIncrPeriod = -m_dVelMaxIncr;
 	}
 
-	IntprtSetInt(8, 'J', 'V', 0, iVelEncIncrPeriod);
-	IntprtSetInt(4, 'B', 'G', 0, 0);
+	iVelEncIncrPeriod = (int)dVelEncIncrPeriod;
 
-	// request pos and vel by TPDO1, triggered by SYNC msg
-	// (to request pos by SDO use sendSDOUpload(0x6064, 0) )
-	// sync msg is: iID 0x80 with msg (0,0,0,0,0,0,0,0)
-	CanMsg msg;
-	msg.m_iID  = 0x80;
-	msg.m_iLen = 0;
-	msg.set(0,0,0,0,0,0,0,0);
-	m_pCanCtrl->transmitMsg(msg);
+	m_SetpointMsgs[0].setAt(iVelEncIncrPeriod, 4);
+	m_SetpointMsgs[0].setAt(iVelEncIncrPeriod >> 8, 5);
+	m_SetpointMsgs[0].setAt(iVelEncIncrPeriod >> 16, 6);
+	m_SetpointMsgs[0].setAt(iVelEncIncrPeriod >> 24, 7);
 
-	// send heartbeat to keep watchdog inactive
-	msg.m_iID  = 0x700;
-	msg.m_iLen = 5;
-	msg.set(0x00,0,0,0,0,0,0,0);
-	m_pCanCtrl->transmitMsg(msg);
+	m_dVelGearCmdRadS = iVelEncIncrPeriod * m_dVelIncrToGearRadS;
+
+	// JV, BG and heartbeat in one go; in SYNC PDO mode a single SYNC is sent for all drives by the platform
+	m_pCanCtrl->transmitMsgs(m_SetpointMsgs, m_Param.bSyncPDOMode ? c_iNumSetpointMsgs - 1 : c_iNumSetpointMsgs);
 
 	m_CurrentTime.SetNow();
 	double dt = m_CurrentTime - m_SendTime;
@@ -708,8 +984,14 @@ void CanDriveHarmonica::setGearVelRadS(double dVelGearRadS)
 		std::cout << "Time between send velocity of motor " << m_DriveParam.getDriveIdent()
 			<< " is too large: " << dt << " s" << std::endl;
 	}
-	m_SendTime.SetNow();
+	m_SendTime = m_CurrentTime;
 
+	// errors are reported by events, only the heartbeat of the drive is checked
+	if( m_Param.bEventErrorDetection )
+	{
+		checkHeartbeat(m_CurrentTime);
+		return;
+	}
 
 	// request status
 	m_iCountRequestDiv++;
@@ -723,34 +1005,63 @@ void CanDriveHarmonica::setGearVelRadS(double dVelGearRadS)
 //-----------------------------------------------
 void CanDriveHarmonica::getGearPosRad(double* dGearPosRad)
 {
-	*dGearPosRad = m_dPosGearMeasRad;
+	double dVelGearRadS;
+	getPosVelMeas(dGearPosRad, &dVelGearRadS);
 }
 
 //-----------------------------------------------
 void CanDriveHarmonica::getGearPosVelRadS(double* pdAngleGearRad, double* pdVelGearRadS)
 {
-	*pdAngleGearRad = m_dPosGearMeasRad;
-	*pdVelGearRadS = m_dVelGearMeasRadS;
+	getPosVelMeas(pdAngleGearRad, pdVelGearRadS);
 }
 
 //-----------------------------------------------
 void CanDriveHarmonica::getGearDeltaPosVelRadS(double* pdAngleGearRad, double* pdVelGearRadS)
 {
-	*pdAngleGearRad = m_dPosGearMeasRad - m_dAngleGearRadMem;
-	*pdVelGearRadS = m_dVelGearMeasRadS;
-	m_dAngleGearRadMem = m_dPosGearMeasRad;
+	double dPosGearRad;
+	getPosVelMeas(&dPosGearRad, pdVelGearRadS);
+	*pdAngleGearRad = dPosGearRad - m_dAngleGearRadMem;
+	m_dAngleGearRadMem = dPosGearRad;
 }
 
 //-----------------------------------------------
 void CanDriveHarmonica::getData(double* pdPosGearRad, double* pdVelGearRadS,
 								int* piTorqueCtrl, int* piStatusCtrl)
 {
-	*pdPosGearRad = m_dPosGearMeasRad;
-	*pdVelGearRadS = m_dVelGearMeasRadS;
+	getPosVelMeas(pdPosGearRad, pdVelGearRadS);
 	*piTorqueCtrl = m_iTorqueCtrl;
 	*piStatusCtrl = m_iStatusCtrl;
 }
 
+//-----------------------------------------------
+void CanDriveHarmonica::setPosVelMeas(double dPosGearRad, double dVelGearRadS)
+{
+	// single writer seqlock: readers retry while the counter is odd or has changed
+	unsigned int uiSeq = m_uiPosVelSeq.load(boost::memory_order_relaxed);
+	m_uiPosVelSeq.store(uiSeq + 1, boost::memory_order_relaxed);
+	boost::atomic_thread_fence(boost::memory_order_release);
+
+	m_dPosGearMeasRad = dPosGearRad;
+	m_dVelGearMeasRadS = dVelGearRadS;
+
+	m_uiPosVelSeq.store(uiSeq + 2, boost::memory_order_release);
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::getPosVelMeas(double* pdPosGearRad, double* pdVelGearRadS) const
+{
+	unsigned int uiSeqStart, uiSeqEnd;
+	do
+	{
+		uiSeqStart = m_uiPosVelSeq.load(boost::memory_order_acquire);
+		*pdPosGearRad = m_dPosGearMeasRad;
+		*pdVelGearRadS = m_dVelGearMeasRadS;
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		uiSeqEnd = m_uiPosVelSeq.load(boost::memory_order_relaxed);
+	}
+	while( (uiSeqStart & 1) || (uiSeqStart != uiSeqEnd) );
+}
+
 //-----------------------------------------------
 void CanDriveHarmonica::requestPosVel()
 {
@@ -776,12 +1087,20 @@ void CanDriveHarmonica::sendHeartbeat()
 //-----------------------------------------------
 void CanDriveHarmonica::requestStatus()
 {
+	// in SYNC PDO mode the status register arrives with TPDO3
+	if( m_Param.bSyncPDOMode )
+		return;
+
 	IntprtSetInt(4, 'S', 'R', 0, 0);
 }
 
 //-----------------------------------------------
 void CanDriveHarmonica::requestMotorTorque()
 {
+	// in SYNC PDO mode the active current arrives with TPDO3
+	if( m_Param.bSyncPDOMode )
+		return;
+
    	// send command for requesting motor current:
  	IntprtSetInt(4, 'I', 'Q', 0, 0);	// active current
 	//IntprtSetInt(4, 'I', 'D', 0, 0);	// reactive current
@@ -790,6 +1109,10 @@ void CanDriveHarmonica::requestMotorTorque()
 //-----------------------------------------------
 bool CanDriveHarmonica::isError()
 {
+	// the state is kept up to date by evalEmergency(), evalHeartbeat() and checkHeartbeat()
+	if( m_Param.bEventErrorDetection )
+		return (m_iMotorState == ST_MOTOR_FAILURE);
+
 	if (m_iMotorState != ST_MOTOR_FAILURE)
 	{
 		// Check timeout of can communication
@@ -813,69 +1136,73 @@ bool CanDriveHarmonica::isError()
 }
 //-----------------------------------------------
 bool CanDriveHarmonica::setTypeMotion(int iType)
+{
+	queueTypeMotion(iType);
+	return waitForRequests();
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::queueTypeMotion(int iType)
 {
 	int iMaxAcc = int(m_DriveParam.getMaxAcc());
 	int iMaxDcc = int(m_DriveParam.getMaxDec());
-	CanMsg Msg;
 
 	if (iType == MOTIONTYPE_POSCTRL)
 	{
 		// 1.) Switch to UnitMode = 5 (Single Loop Position Control) //
 
 		// switch off Motor to change Unit-Mode
-		IntprtSetInt(8, 'M', 'O', 0, 0);
-		usleep(20000);
+		queueIntprtSetInt(8, 'M', 'O', 0, 0);
 		// switch Unit-Mode
-		IntprtSetInt(8, 'U', 'M', 0, 5);
+		queueIntprtSetInt(8, 'U', 'M', 0, 5);
 
 		// set Target Radius to X Increments
-		IntprtSetInt(8, 'T', 'R', 1, 15);
+		queueIntprtSetInt(8, 'T', 'R', 1, 15);
 		// set Target Time to X ms
-		IntprtSetInt(8, 'T', 'R', 2, 100);
+		queueIntprtSetInt(8, 'T', 'R', 2, 100);
 
 		// set maximum Acceleration to X Incr/s^2
-		IntprtSetInt(8, 'A', 'C', 0, iMaxAcc);
+		queueIntprtSetInt(8, 'A', 'C', 0, iMaxAcc);
 		// set maximum decceleration to X Incr/s^2
-		IntprtSetInt(8, 'D', 'C', 0, iMaxDcc);
-		usleep(100000);
-
-
+		queueIntprtSetInt(8, 'D', 'C', 0, iMaxDcc);
 	}
 	else if (iType == MOTIONTYPE_TORQUECTRL)
 	{
 		// Switch to TorqueControll-Mode
 		// switch off Motor to change Unit-Mode
-		IntprtSetInt(8, 'M', 'O', 0, 0);
-		usleep(50000);
+		queueIntprtSetInt(8, 'M', 'O', 0, 0);
 		// switch Unit-Mode 1: Torque Controlled
-		IntprtSetInt(8, 'U', 'M', 0, 1);
+		queueIntprtSetInt(8, 'U', 'M', 0, 1);
 		// disable external compensation input
 		// to avoid noise from that input pin
-		IntprtSetInt(8, 'R', 'M', 0, 0);
+		queueIntprtSetInt(8, 'R', 'M', 0, 0);
 
 		// debugging:
 		std::cout << "Motor"<<m_DriveParam.getDriveIdent()<<" Unit Mode switched to: TORQUE controlled" << std::endl;
-		usleep(100000);
 	}
 	else
 	{
 		//Default Motion Type = VelocityControled
-		// switch off Motor to change Unit-Mode
-		IntprtSetInt(8, 'M', 'O', 0, 0);
-		// switch Unit-Mode
-		IntprtSetInt(8, 'U', 'M', 0, 2);
-		// set profiler Mode (only if Unit Mode = 2)
-		IntprtSetInt(8, 'P', 'M', 0, 1);
-
-		// set maximum Acceleration to X Incr/s^2
-		IntprtSetInt(8, 'A', 'C', 0, iMaxAcc);
-		// set maximum decceleration to X Incr/s^2
-		IntprtSetInt(8, 'D', 'C', 0, iMaxDcc);
-		usleep(100000);
+		sendTypeMotionVelCtrl();
 	}
 
 	m_iTypeMotion = iType;
-	return true;
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::sendTypeMotionVelCtrl()
+{
+	// switch off Motor to change Unit-Mode
+	queueIntprtSetInt(8, 'M', 'O', 0, 0);
+	// switch Unit-Mode
+	queueIntprtSetInt(8, 'U', 'M', 0, 2);
+	// set profiler Mode (only if Unit Mode = 2)
+	queueIntprtSetInt(8, 'P', 'M', 0, 1);
+
+	// set maximum Acceleration to X Incr/s^2
+	queueIntprtSetInt(8, 'A', 'C', 0, int(m_DriveParam.getMaxAcc()));
+	// set maximum decceleration to X Incr/s^2
+	queueIntprtSetInt(8, 'D', 'C', 0, int(m_DriveParam.getMaxDec()));
 }
 
 
@@ -955,7 +1282,19 @@ void CanDriveHarmonica::sendSDOAbort(int iObjIndex, int iObjSubIndex, unsigned i
 
 //-----------------------------------------------
 void CanDriveHarmonica::receivedSDOTransferAbort(unsigned int iErrorCode){
+	if(seg_Data.blockState == segData::SDO_BLOCK_INITIATING) {
+		//drive doesn't support block transfers, repeat the request as normal segmented upload
+		std::cout << "SDO Block Upload rejected with error code: " << iErrorCode << ", using segmented upload" << std::endl;
+		m_bSDOBlockUploadSupported = false;
+		seg_Data.blockState = segData::SDO_BLOCK_NONE;
+		sendSDOUpload(seg_Data.objectID, seg_Data.objectSubID);
+		return;
+	}
+
 	std::cout << "SDO Abort Transfer received with error code: " << iErrorCode;
+	if( (seg_Data.objectID == 0x2030) && (seg_Data.statusFlag != segData::SDO_SEG_FREE) && (seg_Data.statusFlag != segData::SDO_SEG_PROCESSING) )
+		ElmoRec->readoutFailed();
+	seg_Data.blockState = segData::SDO_BLOCK_NONE;
 	seg_Data.statusFlag = segData::SDO_SEG_FREE;
 }
 
@@ -983,6 +1322,40 @@ void CanDriveHarmonica::sendSDOUpload(int iObjIndex, int iObjSubIndex)
 	m_pCanCtrl->transmitMsg(CMsgTr);
 }
 
+//-----------------------------------------------
+void CanDriveHarmonica::sendSDOBlockUpload(int iObjIndex, int iObjSubIndex)
+{
+	if(!m_bSDOBlockUploadSupported) {
+		sendSDOUpload(iObjIndex, iObjSubIndex);
+		return;
+	}
+
+	CanMsg CMsgTr;
+	const int ciInitBlockUploadReq = 0xA0; //ccs = 5, cs = 0
+	const int ciCRCSupported = 0x04;
+
+	CMsgTr.m_iLen = 8;
+	CMsgTr.m_iID = m_ParamCanOpen.iRxSDO;
+
+	unsigned char cMsg[8];
+
+	cMsg[0] = ciInitBlockUploadReq | ciCRCSupported;
+	cMsg[1] = iObjIndex;
+	cMsg[2] = iObjIndex >> 8;
+	cMsg[3] = iObjSubIndex;
+	cMsg[4] = c_iSDOBlockSize;
+	cMsg[5] = 0x00; //protocol switch threshold, always use block transfer
+	cMsg[6] = 0x00;
+	cMsg[7] = 0x00;
+
+	seg_Data.objectID = iObjIndex;
+	seg_Data.objectSubID = iObjSubIndex;
+	seg_Data.blockState = segData::SDO_BLOCK_INITIATING;
+
+	CMsgTr.set(cMsg[0], cMsg[1], cMsg[2], cMsg[3], cMsg[4], cMsg[5], cMsg[6], cMsg[7]);
+	m_pCanCtrl->transmitMsg(CMsgTr);
+}
+
 //-----------------------------------------------
 void CanDriveHarmonica::sendSDODownload(int iObjIndex, int iObjSubIndex, int iData)
 {
@@ -1011,6 +1384,174 @@ void CanDriveHarmonica::sendSDODownload(int iObjIndex, int iObjSubIndex, int iDa
 	m_pCanCtrl->transmitMsg(CMsgTr);
 }
 
+//-----------------------------------------------
+void CanDriveHarmonica::queueSDODownload(int iObjIndex, int iObjSub, int iData)
+{
+	SDOQueue::Request req;
+	req.iType = SDOQueue::REQ_SDO_DOWNLOAD;
+	req.iObjIndex = iObjIndex;
+	req.iObjSub = iObjSub;
+	req.iData = iData;
+	req.iDataLen = 8;
+	queueRequest(req);
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::queueSDOUpload(int iObjIndex, int iObjSub)
+{
+	SDOQueue::Request req;
+	req.iType = SDOQueue::REQ_SDO_UPLOAD;
+	req.iObjIndex = iObjIndex;
+	req.iObjSub = iObjSub;
+	req.iData = 0;
+	req.iDataLen = 8;
+	queueRequest(req);
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::queueIntprtSetInt(int iDataLen, char cCmdChar1, char cCmdChar2, int iIndex, int iData)
+{
+	SDOQueue::Request req;
+	req.iType = SDOQueue::REQ_INTPRT;
+	req.iObjIndex = ((unsigned char)cCmdChar1 << 8) | (unsigned char)cCmdChar2;
+	req.iObjSub = iIndex & 0x3FFF;
+	req.iData = iData;
+	req.iDataLen = iDataLen;
+	queueRequest(req);
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::queueRequest(const SDOQueue::Request& req)
+{
+	bool bSend = false;
+	{
+		boost::mutex::scoped_lock lock(m_SDOQueueMutex);
+		m_SDOQueue.push(req);
+		if(!m_SDOQueue.bOutstanding)
+		{
+			TimeStamp now;
+			now.SetNow();
+			m_SDOQueue.setSent(now);
+			bSend = true;
+		}
+	}
+
+	// only one request is outstanding, so the frames of the drive can't overtake each other
+	if(bSend)
+		transmitRequest(req);
+}
+
+//-----------------------------------------------
+bool CanDriveHarmonica::confirmRequest(bool bIntprt, int iObjIndex, int iObjSub, bool bAborted, unsigned int uiAbortCode)
+{
+	SDOQueue::Request next;
+	bool bSend = false;
+	{
+		boost::mutex::scoped_lock lock(m_SDOQueueMutex);
+		if(!m_SDOQueue.matches(bIntprt, iObjIndex, iObjSub))
+			return false;
+
+		if(bAborted)
+		{
+			std::cout << "CanDriveHarmonica: drive " << m_DriveParam.getDriveIdent() << " aborted SDO 0x" << std::hex
+				<< iObjIndex << " sub " << iObjSub << " with code 0x" << uiAbortCode << std::dec << std::endl;
+			m_SDOQueue.uiFailed++;
+		}
+		else
+			m_SDOQueue.uiConfirmed++;
+
+		m_SDOQueue.pop();
+		if(!m_SDOQueue.isEmpty())
+		{
+			TimeStamp now;
+			now.SetNow();
+			m_SDOQueue.setSent(now);
+			next = m_SDOQueue.front();
+			bSend = true;
+		}
+	}
+
+	if(bSend)
+		transmitRequest(next);
+
+	return true;
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::transmitRequest(const SDOQueue::Request& req)
+{
+	switch(req.iType)
+	{
+	case SDOQueue::REQ_SDO_DOWNLOAD:
+		sendSDODownload(req.iObjIndex, req.iObjSub, req.iData);
+		break;
+	case SDOQueue::REQ_SDO_UPLOAD:
+		sendSDOUpload(req.iObjIndex, req.iObjSub);
+		break;
+	default:
+		IntprtSetInt(req.iDataLen, req.iObjIndex >> 8, req.iObjIndex & 0xFF, req.iObjSub, req.iData);
+		break;
+	}
+}
+
+//-----------------------------------------------
+int CanDriveHarmonica::processSDOQueue()
+{
+	SDOQueue::Request req;
+	bool bSend = false;
+	int iPending;
+	{
+		boost::mutex::scoped_lock lock(m_SDOQueueMutex);
+		TimeStamp now;
+		now.SetNow();
+
+		if(m_SDOQueue.bOutstanding && (now - m_SDOQueue.sentTime > 0.001 * c_iSDOTimeoutMS))
+		{
+			if(m_SDOQueue.iRetries < c_iSDOMaxRetries)
+			{
+				m_SDOQueue.iRetries++;
+				m_SDOQueue.uiRetried++;
+				m_SDOQueue.setSent(now);
+				req = m_SDOQueue.front();
+				bSend = true;
+			}
+			else
+			{
+				// the drive does not answer at all, the remaining requests would time out one after the other
+				std::cout << "CanDriveHarmonica: drive " << m_DriveParam.getDriveIdent() << " did not confirm request 0x" << std::hex
+					<< m_SDOQueue.front().iObjIndex << " sub " << m_SDOQueue.front().iObjSub << std::dec << ", dropping "
+					<< m_SDOQueue.size() << " requests" << std::endl;
+				m_SDOQueue.uiFailed += m_SDOQueue.size();
+				m_SDOQueue.clear();
+			}
+		}
+
+		iPending = m_SDOQueue.size();
+	}
+
+	if(bSend)
+		transmitRequest(req);
+
+	return iPending;
+}
+
+//-----------------------------------------------
+bool CanDriveHarmonica::waitForRequests()
+{
+	CanMsg Msg;
+	unsigned int uiFailed = m_SDOQueue.uiFailed;
+
+	// every request is repeated c_iSDOMaxRetries times at most, then the queue is dropped
+	while(processSDOQueue() > 0)
+	{
+		while(m_pCanCtrl->receiveMsg(&Msg))
+			evalReceivedMsg(Msg);
+		usleep(1000);
+	}
+
+	return m_SDOQueue.uiFailed == uiFailed;
+}
+
 //-----------------------------------------------
 void CanDriveHarmonica::evalSDO(CanMsg& CMsg, int* pIndex, int* pSubindex)
 {
@@ -1040,6 +1581,7 @@ int CanDriveHarmonica::receivedSDOSegmentedInitiation(CanMsg& msg) {
 		//data in byte 4 to 7 contain the number of bytes to be uploaded (if Size indicator flag is set)
 		if( (msg.getAt(0) & 0x01) == 1) {
 			seg_Data.numTotalBytes = msg.getAt(7) << 24 | msg.getAt(6) << 16 | msg.getAt(5) << 8 | msg.getAt(4);
+			seg_Data.data.reserve(seg_Data.numTotalBytes);
 		} else seg_Data.numTotalBytes = 0;
 
 		sendSDOUploadSegmentConfirmation(seg_Data.toggleBit);
@@ -1124,26 +1666,154 @@ void CanDriveHarmonica::finishedSDOSegmentedTransfer() {
 	}
 
 	if(seg_Data.objectID == 0x2030) {
+		//processed in the background, seg_Data stays in SDO_SEG_PROCESSING until ElmoRec has finished
 		if(ElmoRec->processData(seg_Data) == 0) seg_Data.statusFlag = segData::SDO_SEG_FREE;
 	}
 }
 
 //-----------------------------------------------
-double CanDriveHarmonica::estimVel(double dPos)
-{
-	double dVel;
-	double dt;
+void CanDriveHarmonica::receivedSDOBlockInitiation(CanMsg& msg) {
+	if(seg_Data.statusFlag != segData::SDO_SEG_WAITING) {
+		seg_Data.blockState = segData::SDO_BLOCK_NONE;
+		return;
+	}
 
-	m_CurrentTime.SetNow();
+	seg_Data.data.clear();
+	seg_Data.statusFlag = segData::SDO_SEG_COLLECTING;
+	seg_Data.blockState = segData::SDO_BLOCK_RECEIVING;
+	seg_Data.blockSeqNo = 0;
+	seg_Data.blockLastSegment = false;
 
-	dt = m_CurrentTime - m_VelCalcTime;
+	evalSDO(msg, &seg_Data.objectID, &seg_Data.objectSubID);
 
-	dVel = (dPos - m_dOldPos)/dt;
+	//Byte 0: SSS XX C S 0 | SSS=Cmd-Specifier, C=CRC supported, S=Size indicated
+	seg_Data.blockCRC = (msg.getAt(0) & 0x04) != 0;
+	if( (msg.getAt(0) & 0x02) != 0) {
+		seg_Data.numTotalBytes = msg.getAt(7) << 24 | msg.getAt(6) << 16 | msg.getAt(5) << 8 | msg.getAt(4);
+		seg_Data.data.reserve(seg_Data.numTotalBytes + 7);
+	} else seg_Data.numTotalBytes = 0;
 
-	m_dOldPos = dPos;
-	m_VelCalcTime.SetNow();
+	CanMsg CMsgTr;
+	const int ciStartBlockUploadReq = 0xA3; //ccs = 5, cs = 3
+
+	CMsgTr.m_iLen = 8;
+	CMsgTr.m_iID = m_ParamCanOpen.iRxSDO;
+	CMsgTr.set(ciStartBlockUploadReq, 0, 0, 0, 0, 0, 0, 0);
+	m_pCanCtrl->transmitMsg(CMsgTr);
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::receivedSDOBlockSegment(CanMsg& msg) {
+	//Byte 0: C NNNNNNN | C=last segment, NNNNNNN=sequence number 1..blksize
+	//Byte 1 to 7: Data
+	int iSeqNo = msg.getAt(0) & 0x7F;
+	bool bLast = (msg.getAt(0) & 0x80) != 0;
+
+	if( (iSeqNo == seg_Data.blockSeqNo + 1) && !seg_Data.blockLastSegment ) {
+		for(int i=1; i<=7; i++) {
+			seg_Data.data.push_back(msg.getAt(i));
+		}
+		seg_Data.blockSeqNo = iSeqNo;
+		seg_Data.blockLastSegment = bLast;
+	}
+
+	if( (iSeqNo == c_iSDOBlockSize) || bLast ) {
+		sendSDOBlockAck();
+	}
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::sendSDOBlockAck() {
+	CanMsg CMsgTr;
+	const int ciBlockUploadAck = 0xA2; //ccs = 5, cs = 2
+
+	CMsgTr.m_iLen = 8;
+	CMsgTr.m_iID = m_ParamCanOpen.iRxSDO;
+	CMsgTr.set(ciBlockUploadAck, seg_Data.blockSeqNo, c_iSDOBlockSize, 0, 0, 0, 0, 0);
+
+	//the drive continues after the confirmed segment, numbering restarts with 1
+	seg_Data.blockSeqNo = 0;
+	if(seg_Data.blockLastSegment)
+		seg_Data.blockState = segData::SDO_BLOCK_ENDING;
+
+	m_pCanCtrl->transmitMsg(CMsgTr);
+}
 
-	return dVel;
+//-----------------------------------------------
+void CanDriveHarmonica::receivedSDOBlockEnd(CanMsg& msg) {
+	//Byte 0: SSS NNN X 1 | SSS=Cmd-Specifier, NNN=num of empty bytes in last segment
+	//Byte 1, 2: CRC
+	unsigned int numEmptyBytes = (msg.getAt(0) >> 2) & 0x07;
+
+	if(seg_Data.data.size() >= numEmptyBytes)
+		seg_Data.data.resize(seg_Data.data.size() - numEmptyBytes);
+
+	if(seg_Data.blockCRC) {
+		unsigned short iCRC = msg.getAt(1) | (msg.getAt(2) << 8);
+		if(iCRC != calcSDOBlockCRC(seg_Data.data)) {
+			std::cout << "CRC error in SDO Block Upload, send Abort SDO" << std::endl;
+			sendSDOAbort(seg_Data.objectID, seg_Data.objectSubID, 0x05040004); //Send SDO Abort with error code CRC error
+			if(seg_Data.objectID == 0x2030) ElmoRec->readoutFailed();
+			seg_Data.resetTransferData();
+			return;
+		}
+	}
+
+	CanMsg CMsgTr;
+	const int ciEndBlockUploadReq = 0xA1; //ccs = 5, cs = 1
+
+	CMsgTr.m_iLen = 8;
+	CMsgTr.m_iID = m_ParamCanOpen.iRxSDO;
+	CMsgTr.set(ciEndBlockUploadReq, 0, 0, 0, 0, 0, 0, 0);
+	m_pCanCtrl->transmitMsg(CMsgTr);
+
+	seg_Data.blockState = segData::SDO_BLOCK_NONE;
+	finishedSDOSegmentedTransfer();
+}
+
+//-----------------------------------------------
+unsigned short CanDriveHarmonica::calcSDOBlockCRC(const std::vector<unsigned char>& vData) {
+	unsigned short iCRC = 0;
+
+	for(unsigned int i = 0; i < vData.size(); i++) {
+		iCRC ^= (unsigned short)vData[i] << 8;
+		for(int j = 0; j < 8; j++) {
+			if(iCRC & 0x8000)
+				iCRC = (iCRC << 1) ^ 0x1021;
+			else
+				iCRC = iCRC << 1;
+		}
+	}
+
+	return iCRC;
+}
+
+//-----------------------------------------------
+double CanDriveHarmonica::estimVel(double dPos, double dVelDrive)
+{
+	// the position was sampled when TPDO1 was received, not when it is evaluated
+	double dt = m_PosVelMeasTime - m_VelCalcTime;
+	m_VelCalcTime = m_PosVelMeasTime;
+
+	return m_VelEstimator.update(dPos, dt, dVelDrive);
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::setVelEstimator(int iMode, double dAccNoiseRadS2, double dTimeJitterS)
+{
+	// quantization noise of the encoder, one increment / sqrt(12)
+	double dPosNoiseRad = m_DriveParam.PosMotIncrToPosGearRad(1) / sqrt(12.0);
+	m_VelEstimator.setMode(iMode, fabs(dPosNoiseRad), dAccNoiseRadS2, dTimeJitterS);
+}
+//-----------------------------------------------
+void CanDriveHarmonica::getRxTime(const CanMsg& msg, TimeStamp* pTime)
+{
+	int64_t llRxTimeNs = msg.getRxTime();
+
+	if(llRxTimeNs == 0)
+		pTime->SetNow();
+	else
+		pTime->setTimeStamp(long(llRxTimeNs / 1000000000LL), long(llRxTimeNs % 1000000000LL));
 }
 //-----------------------------------------------
 bool CanDriveHarmonica::evalStatusRegister(int iStatus)
@@ -1284,6 +1954,86 @@ void CanDriveHarmonica::evalMotorFailure(int iFailure)
 	}
 }
 
+//-----------------------------------------------
+void CanDriveHarmonica::evalEmergency(CanMsg& msg)
+{
+	int iErrorCode = msg.getAt(0) | (msg.getAt(1) << 8);
+	int iErrorRegister = msg.getAt(2);
+
+	// error reset, the state is restored by the status register when the drive is started again
+	if(iErrorCode == 0)
+		return;
+
+	std::ostringstream reason;
+	reason << "emergency 0x" << std::hex << iErrorCode << ", error register 0x" << iErrorRegister << std::dec;
+
+	// classes of the error codes of CiA 301
+	switch(iErrorCode >> 12)
+	{
+	case 0x2: reason << " - current"; break;
+	case 0x3: reason << " - voltage"; break;
+	case 0x4: reason << " - temperature"; break;
+	case 0x5: reason << " - device hardware"; break;
+	case 0x6: reason << " - device software"; break;
+	case 0x7: reason << " - additional modules"; break;
+	case 0x8: reason << " - monitoring"; break;
+	case 0x9: reason << " - external error"; break;
+	case 0xF: reason << " - device specific"; break;
+	default: break;
+	}
+
+	// Request detailed description of failure
+	if ( m_bOutputOfFailure == false )
+		IntprtSetInt(4, 'M', 'F', 0, 0);
+
+	setMotorFailure(reason.str());
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::evalHeartbeat(CanMsg& msg)
+{
+	getRxTime(msg, &m_HeartbeatTime);
+	m_iNMTState = msg.getAt(0) & 0x7F;
+
+	if( !m_bHeartbeatSupervised )
+		return;
+
+	// 0x00 = boot-up, 0x04 = stopped, 0x05 = operational, 0x7F = pre-operational
+	if(m_iNMTState == 0x00)
+		setMotorFailure("drive has rebooted");
+	else if(m_iNMTState == 0x04)
+		setMotorFailure("drive has stopped");
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::checkHeartbeat(const TimeStamp& now)
+{
+	if( !m_bHeartbeatSupervised || (m_iMotorState == ST_MOTOR_FAILURE) )
+		return;
+
+	double dAge = now - m_HeartbeatTime;
+	if(dAge > c_iNumHeartbeatsMissed * m_Param.iHeartbeatPeriodMS / 1000.0)
+	{
+		std::ostringstream reason;
+		reason << "no heartbeat for " << dAge << " s";
+		setMotorFailure(reason.str());
+	}
+}
+
+//-----------------------------------------------
+void CanDriveHarmonica::setMotorFailure(const std::string& sReason)
+{
+	if ( m_bOutputOfFailure == false )
+	{
+		std::cout << "Motor " << m_DriveParam.getDriveIdent() << " failure: " << sReason << std::endl;
+		m_FailureStartTime.SetNow();
+	}
+
+	m_iMotorState = ST_MOTOR_FAILURE;
+	m_iNewMotorState = ST_MOTOR_FAILURE;
+	m_bOutputOfFailure = true;
+}
+
 //-----------------------------------------------
 void CanDriveHarmonica::setMotorTorque(double dTorqueNm)
 {
@@ -1302,18 +2052,12 @@ void CanDriveHarmonica::setMotorTorque(double dTorqueNm)
 		std::cout << "Torque command too high: " << fMotCurr << " Nm. Torque has been limitited." << std::endl;
 	}
 
-	// send Command
-	IntprtSetFloat(8, 'T', 'C', 0, fMotCurr);
-
-	// request pos and vel by TPDO1, triggered by SYNC msg
-	CanMsg msg;
-	msg.m_iID  = 0x80;
-	msg.m_iLen = 0;
-	msg.set(0,0,0,0,0,0,0,0);
-	m_pCanCtrl->transmitMsg(msg);
-
-	// send heartbeat to keep watchdog inactive
-	sendHeartbeat();
+	// TC, heartbeat to keep the watchdog inactive and the SYNC requesting pos and vel by TPDO1 in one call,
+	// in SYNC PDO mode a single SYNC is sent for all drives by the platform
+	const char* pcCurr = (const char*)&fMotCurr;
+	for(int i = 0; i < 4; i++)
+		m_TorqueMsgs[0].setAt(pcCurr[i], 4 + i);
+	m_pCanCtrl->transmitMsgs(m_TorqueMsgs, m_Param.bSyncPDOMode ? c_iNumTorqueMsgs - 1 : c_iNumTorqueMsgs);
 
 	m_CurrentTime.SetNow();
 	double dt = m_CurrentTime - m_SendTime;
@@ -1324,6 +2068,11 @@ void CanDriveHarmonica::setMotorTorque(double dTorqueNm)
 	}
 	m_SendTime.SetNow();
 
+	if( m_Param.bEventErrorDetection )
+	{
+		checkHeartbeat(m_CurrentTime);
+		return;
+	}
 
 	// request status
 	m_iCountRequestDiv++;
@@ -1352,11 +2101,16 @@ void CanDriveHarmonica::getMotorTorque(double* dTorqueNm)
 //-----------------------------------------------
 int CanDriveHarmonica::setRecorder(int iFlag, int iParam, std::string sParam) {
 
+	if( (seg_Data.statusFlag == segData::SDO_SEG_PROCESSING) && !ElmoRec->isProcessing() )
+		seg_Data.statusFlag = segData::SDO_SEG_FREE;
+
 	switch(iFlag) {
 		case 0: //Configure Elmo Recorder for new Record, param = iRecordingGap, which specifies every which time quantum (4*90usec) a new data point is recorded
 			if(iParam < 1) iParam = 1;
 			ElmoRec->isInitialized(true);
 			ElmoRec->configureElmoRecorder(iParam, m_DriveParam.getDriveIdent()); //int startImmediately is default = 1
+			//allocate the read-out buffer now, so that readouts of all drives running at the same time don't reallocate while collecting
+			seg_Data.data.reserve(ElmoRec->getReadoutSize());
 			return 0;
 
 		case 1: //Query upload of previous recorded data, data is being proceeded after complete upload, param = recorded ID, filename
@@ -1394,6 +2148,10 @@ int CanDriveHarmonica::setRecorder(int iFlag, int iParam, std::string sParam) {
 
 			break;
 
+		case 3: //Select the format of the logfiles, param = ElmoRecorder::LogFormat
+			ElmoRec->setLogFormat(iParam);
+			return 0;
+
 		case 99: //Abort ongoing SDO data Transmission and clear collected data
 			sendSDOAbort(0x2030, 0x00, 0x08000020); //send general error abort
 			seg_Data.resetTransferData(); //!overwrites previous collected data (even from other processes)
@@ -1402,3 +2160,8 @@ int CanDriveHarmonica::setRecorder(int iFlag, int iParam, std::string sParam) {
 
 	return 0;
 }
+
+//-----------------------------------------------
+void CanDriveHarmonica::setRecorderCallback(const ElmoRecorder::ReadoutCallback& callback) {
+	ElmoRec->setReadoutCallback(callback);
+}
@@ -0,0 +1,364 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+// general includes
+#include <string.h>
+#include <unistd.h>
+
+// Headers provided by other cob-packages
+#include <cob_canopen_motor/CanDriveHarmonicaSim.h>
+
+//-----------------------------------------------
+const double CanDriveHarmonicaSim::c_dHomingTimeS = 0.2;
+
+//-----------------------------------------------
+CanDriveHarmonicaSim::CanDriveHarmonicaSim(CanItf* pCanItf, int iTxPDO1, int iTxPDO2, int iRxPDO2,
+	int iTxSDO, int iRxSDO, double dVelMeasFrqHz, int iResponseDelayUs)
+{
+	m_pCanItf = pCanItf;
+	m_iTxPDO1 = iTxPDO1;
+	m_iTxPDO2 = iTxPDO2;
+	// same mapping as CanDriveHarmonica::setCanOpenParam()
+	m_iTxPDO3 = iTxPDO1 + 0x200;
+	m_iRxPDO2 = iRxPDO2;
+	m_iTxSDO = iTxSDO;
+	m_iRxSDO = iRxSDO;
+	// node ID taken from the transmit SDO 0x580 + node ID
+	m_iEMCY = iTxSDO - 0x580 + 0x80;
+	m_iHeartbeat = iTxSDO - 0x580 + 0x700;
+	m_dVelMeasFrqHz = dVelMeasFrqHz;
+	m_iResponseDelayUs = iResponseDelayUs;
+
+	m_dPosIncr = 0;
+	m_iVelIncrPeriod = 0;
+	m_bMotorOn = false;
+	m_bError = false;
+	m_bEmcyPending = false;
+	m_iHeartbeatPeriodMS = 0;
+	m_HeartbeatTime.SetNow();
+	m_bHomingArmed = false;
+	m_bTPDO3Enabled = false;
+	m_PosTime.SetNow();
+	m_HomingArmedTime.SetNow();
+
+	m_bShutdown = false;
+}
+
+//-----------------------------------------------
+CanDriveHarmonicaSim::~CanDriveHarmonicaSim()
+{
+	stop();
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::start()
+{
+	m_bShutdown = false;
+	m_Thread = boost::thread(&CanDriveHarmonicaSim::thread, this);
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::stop()
+{
+	m_bShutdown = true;
+	if(m_Thread.joinable())
+		m_Thread.join();
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::setError(bool bError)
+{
+	m_bError = bError;
+	if(bError)
+		m_bEmcyPending = true;
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::thread()
+{
+	CanMsg msg;
+
+	while(!m_bShutdown)
+	{
+		// the timeout only bounds the reaction to stop()
+		if(m_pCanItf->receiveMsgTimeout(&msg, 10000))
+			evalMsg(msg);
+
+		sendEvents();
+	}
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::sendEvents()
+{
+	unsigned char data[8];
+	TimeStamp now;
+
+	memset(data, 0, sizeof(data));
+
+	if(m_bEmcyPending.exchange(false))
+	{
+		// error code 0x3120 "mains voltage too low", error register bit 2 "voltage"
+		data[0] = 0x20;
+		data[1] = 0x31;
+		data[2] = 0x04;
+		sendMsg(m_iEMCY, data, 8);
+		data[0] = data[1] = data[2] = 0;
+	}
+
+	if(m_iHeartbeatPeriodMS <= 0)
+		return;
+
+	now.SetNow();
+	if((now - m_HeartbeatTime) >= m_iHeartbeatPeriodMS / 1000.0)
+	{
+		// NMT state operational
+		data[0] = 0x05;
+		sendMsg(m_iHeartbeat, data, 1);
+		m_HeartbeatTime = now;
+	}
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::evalMsg(const CanMsg& msg)
+{
+	if( (msg.m_iID != 0x80) && (msg.m_iID != m_iRxPDO2) && (msg.m_iID != m_iRxSDO) )
+		return;
+
+	if(m_iResponseDelayUs > 0)
+		usleep(m_iResponseDelayUs);
+
+	if(msg.m_iID == 0x80)
+		evalSync();
+	else if(msg.m_iID == m_iRxPDO2)
+		evalIntprt(msg);
+	else
+		evalSDO(msg);
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::updatePos()
+{
+	TimeStamp now;
+
+	// called before each change of the velocity, so the position is exact between the commands
+	now.SetNow();
+	m_dPosIncr += m_iVelIncrPeriod * m_dVelMeasFrqHz * (now - m_PosTime);
+	m_PosTime = now;
+
+	// homing event as soon as the motor moved long enough to reach the homing switch
+	if(m_bHomingArmed && (m_iVelIncrPeriod != 0) && ((now - m_HomingArmedTime) > c_dHomingTimeS))
+	{
+		m_dPosIncr = getValue(('H' << 8) | 'M', 2);
+		m_bHomingArmed = false;
+	}
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::evalSync()
+{
+	unsigned char data[8];
+
+	updatePos();
+
+	setInt32(&data[0], (int)m_dPosIncr);
+	setInt32(&data[4], m_iVelIncrPeriod);
+	sendMsg(m_iTxPDO1, data, 8);
+
+	if(m_bTPDO3Enabled)
+	{
+		// active current is always 0
+		setInt32(&data[0], getStatusRegister());
+		data[4] = 0;
+		data[5] = 0;
+		sendMsg(m_iTxPDO3, data, 6);
+	}
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::evalIntprt(const CanMsg& msg)
+{
+	const unsigned char* pMsgData = msg.getData();
+	int iCmdChar1 = pMsgData[0];
+	int iCmdChar2 = pMsgData[1];
+	int iCmd = (iCmdChar1 << 8) | iCmdChar2;
+	int iIndex = pMsgData[2] | (pMsgData[3] << 8);
+	int iData;
+
+	if(msg.m_iLen == 8)
+	{
+		// set command, the drive echoes the value
+		iData = getInt32(msg, 4);
+		m_Values[(iCmd << 16) | iIndex] = iData;
+
+		updatePos();
+
+		if(iCmd == (('M' << 8) | 'O'))
+		{
+			m_bMotorOn = (iData != 0);
+			if(m_bMotorOn)
+				m_bError = false;
+			else
+				m_iVelIncrPeriod = 0;
+		}
+		else if(iCmd == (('P' << 8) | 'X'))
+			m_dPosIncr = iData;
+		else if( (iCmd == (('H' << 8) | 'M')) && (iIndex == 1) )
+		{
+			m_bHomingArmed = (iData != 0);
+			m_HomingArmedTime.SetNow();
+		}
+
+		sendIntprtAnswer(iCmdChar1, iCmdChar2, iIndex, iData);
+		return;
+	}
+
+	// execute and get commands
+	if(iCmd == (('B' << 8) | 'G'))
+	{
+		// begin motion with the last jog velocity
+		updatePos();
+		if(m_bMotorOn && !m_bError)
+			m_iVelIncrPeriod = getValue(('J' << 8) | 'V', 0);
+		return;
+	}
+
+	updatePos();
+
+	if(iCmd == (('S' << 8) | 'R'))
+		iData = getStatusRegister();
+	else if(iCmd == (('P' << 8) | 'X'))
+		iData = (int)m_dPosIncr;
+	else if(iCmd == (('H' << 8) | 'M') && (iIndex == 1))
+		iData = m_bHomingArmed ? 1 : 0;
+	else if( (iCmd == (('I' << 8) | 'Q')) || (iCmd == (('M' << 8) | 'F')) )
+		// no current and no motor failure, the float 0.0 has the same bits as the int 0
+		iData = 0;
+	else
+		iData = getValue(iCmd, iIndex);
+
+	sendIntprtAnswer(iCmdChar1, iCmdChar2, iIndex, iData);
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::evalSDO(const CanMsg& msg)
+{
+	const unsigned char* pMsgData = msg.getData();
+	unsigned char data[8];
+	int iObjIndex = pMsgData[1] | (pMsgData[2] << 8);
+	int iObjSub = pMsgData[3];
+
+	memset(data, 0, sizeof(data));
+	data[1] = pMsgData[1];
+	data[2] = pMsgData[2];
+	data[3] = pMsgData[3];
+
+	switch(pMsgData[0] & 0xE0)
+	{
+	case 0x20:
+		// expedited download, only the mapping of TPDO3 and the heartbeat period are evaluated
+		if( (iObjIndex == 0x1802) && (iObjSub == 1) )
+			m_bTPDO3Enabled = ((getInt32(msg, 4) & 0x80000000) == 0);
+		else if( (iObjIndex == 0x1017) && (iObjSub == 0) )
+			m_iHeartbeatPeriodMS = getInt32(msg, 4) & 0xFFFF;
+		data[0] = 0x60;
+		break;
+	case 0x40:
+		// expedited upload of 4 bytes, all objects read 0
+		data[0] = 0x43;
+		break;
+	default:
+		// segmented and block transfers are not simulated
+		data[0] = 0x80;
+		// abort code: command specifier not valid or unknown
+		setInt32(&data[4], 0x05040001);
+		break;
+	}
+
+	sendMsg(m_iTxSDO, data, 8);
+}
+
+//-----------------------------------------------
+int CanDriveHarmonicaSim::getStatusRegister()
+{
+	int iStatus = 0;
+
+	if(m_bError)
+		// bit 0: error, bits 1-3: 2 = under voltage
+		iStatus |= 0x03;
+	else if(m_bMotorOn)
+		// bit 4: motor on
+		iStatus |= 0x10;
+
+	return iStatus;
+}
+
+//-----------------------------------------------
+int CanDriveHarmonicaSim::getValue(int iCmd, int iIndex)
+{
+	std::map<int, int>::const_iterator it = m_Values.find((iCmd << 16) | iIndex);
+
+	return (it != m_Values.end()) ? it->second : 0;
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::sendIntprtAnswer(int iCmdChar1, int iCmdChar2, int iIndex, int iData)
+{
+	unsigned char data[8];
+
+	data[0] = iCmdChar1;
+	data[1] = iCmdChar2;
+	data[2] = iIndex & 0xFF;
+	data[3] = (iIndex >> 8) & 0x3F;
+	setInt32(&data[4], iData);
+
+	sendMsg(m_iTxPDO2, data, 8);
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::sendMsg(int iID, const unsigned char* pData, int iLen)
+{
+	CanMsg msg;
+	unsigned char data[8];
+
+	for(int i = 0; i < 8; i++)
+		data[i] = (i < iLen) ? pData[i] : 0;
+
+	msg.m_iID = iID;
+	msg.m_iLen = iLen;
+	msg.setData(data);
+
+	m_pCanItf->transmitMsg(msg, false);
+}
+
+//-----------------------------------------------
+void CanDriveHarmonicaSim::setInt32(unsigned char* pData, int iValue)
+{
+	pData[0] = iValue & 0xFF;
+	pData[1] = (iValue >> 8) & 0xFF;
+	pData[2] = (iValue >> 16) & 0xFF;
+	pData[3] = (iValue >> 24) & 0xFF;
+}
+
+//-----------------------------------------------
+int CanDriveHarmonicaSim::getInt32(const CanMsg& msg, int iStart)
+{
+	const unsigned char* pData = msg.getData();
+
+	return pData[iStart] | (pData[iStart + 1] << 8) | (pData[iStart + 2] << 16) | (pData[iStart + 3] << 24);
+}
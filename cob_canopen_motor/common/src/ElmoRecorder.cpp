@@ -18,6 +18,8 @@
 #include <math.h>
 #include <vector>
 #include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
 #include <sstream>
 #include <cob_canopen_motor/ElmoRecorder.h>
 #include <cob_canopen_motor/CanDriveHarmonica.h>
@@ -27,9 +29,14 @@ ElmoRecorder::ElmoRecorder(CanDriveHarmonica * pParentHarmonicaDrive) {
 
 	m_bIsInitialized = false;
 	m_iReadoutRecorderTry = 0;
+	m_iLogFormat = LOG_TEXT;
+	m_iRecordingLength = 1024;
+	m_bProcessing = false;
 }
 
 ElmoRecorder::~ElmoRecorder() {
+	if(m_ProcessThread.joinable())
+		m_ProcessThread.join();
 }
 
 bool ElmoRecorder::isInitialized(bool initNow) {
@@ -55,7 +62,7 @@ int ElmoRecorder::configureElmoRecorder(int iRecordingGap, int driveID, int star
 	m_pHarmonicaDrive->IntprtSetInt(8, 'R', 'G', 0, iRecordingGap);
 	// Set Recording Length
 	// RL = (4096 / Number of Signals)
-	m_pHarmonicaDrive->IntprtSetInt(8, 'R', 'L', 0, 1024);
+	m_pHarmonicaDrive->IntprtSetInt(8, 'R', 'L', 0, m_iRecordingLength);
 
 	// Set Time Quantum, Default: RP=0 -> TS * 4; TS is 90us by default
 	// m_pHarmonicaDrive->IntprtSetInt(8, 'R', 'P', 0, 0);
@@ -65,9 +72,18 @@ int ElmoRecorder::configureElmoRecorder(int iRecordingGap, int driveID, int star
 
 	m_fRecordingStepSec = 0.000090 * 4 * iRecordingGap;
 
+	//the buffer of the processing thread is swapped with the one of the SDO transfer, so both are allocated once here
+	if(!m_bProcessing)
+		m_ProcessData.data.reserve(getReadoutSize());
+
 	return 0;
 }
 
+unsigned int ElmoRecorder::getReadoutSize() {
+	//7 bytes header, then 4 bytes per sample of one source
+	return 7 + 4 * m_iRecordingLength;
+}
+
 int ElmoRecorder::readoutRecorderTry(int iObjSubIndex) {
 	//Request the SR (status register) and begin all the read-out process with this action.
 	//SDOData.statusFlag is segData::SDO_SEG_WAITING;
@@ -91,9 +107,11 @@ int ElmoRecorder::readoutRecorderTryStatus(int iStatusReg, segData& SDOData) {
 	if(iRecorderStatus == 0) {
 		std::cout << "Recorder " << m_iDriveID << " inactive with no valid data to upload" << std::endl;
 		SDOData.statusFlag = segData::SDO_SEG_FREE;
+		readoutFailed();
 	} else if(iRecorderStatus == 1) {
 		std::cout << "Recorder " << m_iDriveID << " waiting for a trigger event" << std::endl;
 		SDOData.statusFlag = segData::SDO_SEG_FREE;
+		readoutFailed();
 	} else if(iRecorderStatus == 2) {
 		std::cout << "Recorder " << m_iDriveID << " finished, valid data ready for use" << std::endl;
 		readoutRecorder(m_iCurrentObject);
@@ -101,6 +119,7 @@ int ElmoRecorder::readoutRecorderTryStatus(int iStatusReg, segData& SDOData) {
 	} else if(iRecorderStatus == 3) {
 		std::cout << "Recorder " << m_iDriveID << " is still recording" << std::endl;
 		SDOData.statusFlag = segData::SDO_SEG_FREE;
+		readoutFailed();
 	}
 
 	return 0;
@@ -110,15 +129,33 @@ int ElmoRecorder::readoutRecorder(int iObjSubIndex){
 	//initialize Upload of Recorded Data (object 0x2030)
 	int iObjIndex = 0x2030;
 
-	m_pHarmonicaDrive->sendSDOUpload(iObjIndex, iObjSubIndex);
+	m_pHarmonicaDrive->sendSDOBlockUpload(iObjIndex, iObjSubIndex);
 	m_iCurrentObject = iObjSubIndex;
 
 	return 0;
 }
 
 int ElmoRecorder::processData(segData& SDOData) {
+	if(m_ProcessThread.joinable())
+		m_ProcessThread.join();
+
+	m_ProcessData.numTotalBytes = SDOData.numTotalBytes;
+	m_ProcessData.data.swap(SDOData.data);
+	SDOData.data.clear();
+
+	m_bProcessing = true;
+	m_ProcessThread = boost::thread(&ElmoRecorder::processDataThread, this);
+
+	return 1;
+}
+
+bool ElmoRecorder::isProcessing() {
+	return m_bProcessing;
+}
+
+void ElmoRecorder::processDataThread() {
+	segData& SDOData = m_ProcessData;
 	int iItemSize = 4;
-	int iItemCount = 0;
 	unsigned int iNumDataItems = 0;
 	bool bCollectFloats = true;
 	float fFloatingPointFactor = 0;
@@ -137,6 +174,14 @@ int ElmoRecorder::processData(segData& SDOData) {
 	//
 	//Byte 7 to Byte (7+ iNumdataItems * 4) contain data
 
+	if(SDOData.data.size() < 7) {
+		std::cout << "Recorder data of motor " << m_iDriveID << " too short, header is missing" << std::endl;
+		SDOData.data.clear();
+		m_bProcessing = false;
+		readoutFailed();
+		return;
+	}
+
 	//B[0]: Time quantum and data type
 	switch ((SDOData.data[0] >> 4) ) {
 		case 4:
@@ -175,34 +220,40 @@ int ElmoRecorder::processData(segData& SDOData) {
 	//END HEADER
 	//--------------------------------------
 
-	vfResData[0].assign(iNumDataItems, 0.0);
-	vfResData[1].assign(iNumDataItems, 0.0);
-	iItemCount = 0;
-
-	//extract values from data stream, consider Little Endian conversion for every single object!
-	for(unsigned int i=7;i<=SDOData.data.size() - iItemSize; i=i+iItemSize) {
-		if(bCollectFloats) {
-			if(iItemSize == 4)
-				vfResData[1][iItemCount] = fFloatingPointFactor * convertBinaryToFloat( (SDOData.data[i] << 0) | (SDOData.data[i+1] << 8) | (SDOData.data[i+2] << 16) | (SDOData.data[i+3] << 24) );
+	//never read beyond the received data, even if the header announces more items
+	if(iNumDataItems > (SDOData.data.size() - 7) / iItemSize)
+		iNumDataItems = (SDOData.data.size() - 7) / iItemSize;
 
-				//DEBUG
-				if(iItemCount == 120)
-					std::cout << (unsigned int)( (SDOData.data[i] << 0) | (SDOData.data[i+1] << 8) | (SDOData.data[i+2] << 16) | (SDOData.data[i+3] << 24) ) << std::endl;
+	vfResData[0].resize(iNumDataItems);
+	vfResData[1].resize(iNumDataItems);
 
-			else vfResData[1][iItemCount] = fFloatingPointFactor * convertBinaryToHalfFloat( (SDOData.data[i] << 0) | (SDOData.data[i+1] << 8) | (SDOData.data[i+2] << 16) | (SDOData.data[i+3] << 24) );
-			iItemCount ++;
-		} else {
-			vfResData[1][iItemCount] = fFloatingPointFactor * (float)( (SDOData.data[i] << 0) | (SDOData.data[i+1] << 8) | (SDOData.data[i+2] << 16) | (SDOData.data[i+3] << 24) );
-			iItemCount ++;
-		}
+	//extract values from data stream, all items are stored Little Endian
+	if(iNumDataItems > 0) {
+		const unsigned char* pData = &SDOData.data[7];
+		float* pfValues = &vfResData[1][0];
 
-		vfResData[0][iItemCount] = m_fRecordingStepSec * iItemCount;
+		if(bCollectFloats && (iItemSize == 4))
+			decodeFloats(pData, iNumDataItems, fFloatingPointFactor, pfValues);
+		else if(bCollectFloats)
+			decodeHalfFloats(pData, iNumDataItems, fFloatingPointFactor, pfValues);
+		else
+			decodeLongs(pData, iNumDataItems, fFloatingPointFactor, pfValues);
 	}
 
-	logToFile(m_sLogFilename, vfResData);
+	for(unsigned int i = 0; i < iNumDataItems; i++)
+		vfResData[0][i] = m_fRecordingStepSec * i;
 
-	SDOData.statusFlag = segData::SDO_SEG_FREE;
-	return 0;
+	bool bOk;
+	if(m_iLogFormat == LOG_BINARY)
+		bOk = logToBinaryFile(m_sLogFilename, vfResData[1]);
+	else
+		bOk = logToFile(m_sLogFilename, vfResData);
+
+	SDOData.data.clear();
+	m_bProcessing = false;
+
+	if(m_ReadoutCallback)
+		m_ReadoutCallback(m_iDriveID, m_iCurrentObject, bOk);
 }
 
 int ElmoRecorder::setLogFilename(std::string sLogFileprefix) {
@@ -210,60 +261,70 @@ int ElmoRecorder::setLogFilename(std::string sLogFileprefix) {
 	return 0;
 }
 
+int ElmoRecorder::setLogFormat(int iLogFormat) {
+	m_iLogFormat = (iLogFormat == LOG_BINARY) ? LOG_BINARY : LOG_TEXT;
+	return 0;
+}
 
+void ElmoRecorder::setReadoutCallback(const ReadoutCallback& callback) {
+	m_ReadoutCallback = callback;
+}
 
-float ElmoRecorder::convertBinaryToFloat(unsigned int iBinaryRepresentation) {
-	//Converting binary-numbers to 32bit float values according to IEEE 754 see http://de.wikipedia.org/wiki/IEEE_754
-	int iSign;
-	int iExponent;
-	unsigned int iMantissa;
-	float iNumMantissa = 0.0f;
-
-	if((iBinaryRepresentation & (1 << 31)) == 0) //first bit is sign bit: 0 = +, 1 = -
-		iSign = 1;
-	else
-		iSign = -1;
-
-	iExponent = ((iBinaryRepresentation >> 23) & 0xFF) - 127; //take away Bias(127) for positive and negative exponents
-
-	iMantissa = (iBinaryRepresentation & 0x7FFFFF); //only keep mantissa part of binary number
-
-	iNumMantissa = 1.0f;
+void ElmoRecorder::readoutFailed() {
+	if(m_ReadoutCallback)
+		m_ReadoutCallback(m_iDriveID, m_iCurrentObject, false);
+}
 
-	for(int i=1; i<=23; i++) { //calculate decimal places (convert binary mantissa to decimal number
-		if((iMantissa & (1 << (23-i))) > 0) {
-			iNumMantissa = iNumMantissa + pow(2,(-1)*i);
-		}
+void ElmoRecorder::decodeFloats(const unsigned char* pData, unsigned int iNumItems, float fFactor, float* pfValues) {
+	for(unsigned int i = 0; i < iNumItems; i++) {
+		uint32_t iBits = pData[4*i] | (pData[4*i+1] << 8) | (pData[4*i+2] << 16) | ((uint32_t)pData[4*i+3] << 24);
+		pfValues[i] = fFactor * convertBinaryToFloat(iBits);
 	}
-
-	return iSign * pow(2,iExponent) * iNumMantissa;
 }
 
-float ElmoRecorder::convertBinaryToHalfFloat(unsigned int iBinaryRepresentation) {
-	//Converting binary-numbers to 16bit float values according to IEEE 754 see http://de.wikipedia.org/wiki/IEEE_754
-	int iSign;
-	int iExponent;
-	unsigned int iMantissa;
-	float iNumMantissa = 0.0f;
+void ElmoRecorder::decodeHalfFloats(const unsigned char* pData, unsigned int iNumItems, float fFactor, float* pfValues) {
+	for(unsigned int i = 0; i < iNumItems; i++)
+		pfValues[i] = fFactor * convertBinaryToHalfFloat(pData[2*i] | (pData[2*i+1] << 8));
+}
 
-	if((iBinaryRepresentation & (1 << 15)) == 0) //first bit is sign bit: 0 = +, 1 = -
-		iSign = 1;
-	else
-		iSign = -1;
+void ElmoRecorder::decodeLongs(const unsigned char* pData, unsigned int iNumItems, float fFactor, float* pfValues) {
+	for(unsigned int i = 0; i < iNumItems; i++) {
+		int32_t iValue = (int32_t)(pData[4*i] | (pData[4*i+1] << 8) | (pData[4*i+2] << 16) | ((uint32_t)pData[4*i+3] << 24));
+		pfValues[i] = fFactor * (float)iValue;
+	}
+}
 
-	iExponent = ((iBinaryRepresentation >> 10) & 0x1F) - 15; //take away Bias(15) for positive and negative exponents
 
-	iMantissa = (iBinaryRepresentation & 0x3FF); //only keep mantissa part of binary number
 
-	iNumMantissa = 1.0f;
+float ElmoRecorder::convertBinaryToFloat(unsigned int iBinaryRepresentation) {
+	//The drive sends 32bit float values according to IEEE 754 see http://de.wikipedia.org/wiki/IEEE_754
+	//which is the host representation as well, so the bits are only reinterpreted
+	uint32_t iBits = iBinaryRepresentation;
+	float fValue;
+	memcpy(&fValue, &iBits, sizeof(fValue));
+	return fValue;
+}
 
-	for(int i=1; i<=10; i++) { //calculate decimal places (convert binary mantissa to decimal number
-		if((iMantissa & (1 << (10-i))) > 0) {
-			iNumMantissa = iNumMantissa + pow(2,(-1)*i);
-		}
+float ElmoRecorder::convertBinaryToHalfFloat(unsigned int iBinaryRepresentation) {
+	//Converting binary-numbers to 16bit float values according to IEEE 754 see http://de.wikipedia.org/wiki/IEEE_754
+	//by moving sign, exponent and mantissa to their positions in a 32bit float
+	uint32_t iSign = (iBinaryRepresentation & 0x8000) << 16;
+	uint32_t iExponent = (iBinaryRepresentation >> 10) & 0x1F;
+	uint32_t iMantissa = iBinaryRepresentation & 0x3FF;
+	uint32_t iBits;
+
+	if(iExponent == 0x1F) { //infinity and NaN
+		iBits = iSign | 0x7F800000 | (iMantissa << 13);
+	} else if(iExponent != 0) { //normalized number, change Bias from 15 to 127
+		iBits = iSign | ((iExponent + 112) << 23) | (iMantissa << 13);
+	} else if(iMantissa == 0) { //zero
+		iBits = iSign;
+	} else { //denormalized number, mantissa * 2^-24
+		float fValue = ldexpf((float)iMantissa, -24);
+		return iSign ? -fValue : fValue;
 	}
 
-	return iSign * pow(2,iExponent) * iNumMantissa;
+	return convertBinaryToFloat(iBits);
 }
 
 // Function for writing Logfile
@@ -279,6 +340,7 @@ int ElmoRecorder::logToFile(std::string filename, std::vector<float> vtValues[])
 	if( pFile == NULL )
 	{
 		std::cout << "Error while writing file: " << outputFileName.str() << " Maybe the selected folder does'nt exist." << std::endl;
+		return false;
 	}
 	else
 	{
@@ -290,3 +352,46 @@ int ElmoRecorder::logToFile(std::string filename, std::vector<float> vtValues[])
 
 	return true;
 }
+
+// Function for writing binary Logfile
+int ElmoRecorder::logToBinaryFile(std::string filename, const std::vector<float>& vfValues) {
+	std::stringstream outputFileName;
+	outputFileName << filename << "mot_" << m_iDriveID << "_" << m_iCurrentObject << ".bin";
+
+	BinaryLogHeader header;
+	memcpy(header.cMagic, "ELMR", 4);
+	header.iVersion = 1;
+	header.iHeaderSize = sizeof(BinaryLogHeader);
+	header.iDriveID = m_iDriveID;
+	header.iRecordedSource = m_iCurrentObject;
+	header.iNumChannels = 1;
+	header.iNumSamples = vfValues.size();
+	header.fSamplePeriodSec = m_fRecordingStepSec;
+	header.iReserved = 0;
+
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	header.iTimeStampUSec = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+
+	FILE* pFile;
+	//append to the file, a file holds all read-outs of one motor and source
+	pFile = fopen(outputFileName.str().c_str(), "ab");
+
+	//Check if there was a problem
+	if( pFile == NULL )
+	{
+		std::cout << "Error while writing file: " << outputFileName.str() << " Maybe the selected folder does'nt exist." << std::endl;
+		return false;
+	}
+
+	bool bOk = fwrite(&header, sizeof(header), 1, pFile) == 1;
+	if(bOk && !vfValues.empty())
+		bOk = fwrite(&vfValues[0], sizeof(float), vfValues.size(), pFile) == vfValues.size();
+	if(fclose(pFile) != 0)
+		bOk = false;
+
+	if(!bOk)
+		std::cout << "Error while writing file: " << outputFileName.str() << std::endl;
+
+	return bOk;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * Compares the decoding of TPDO1 (position and velocity in increments) into gear units.
+ *
+ * usage: driveparam_benchmark [num_frames] [repetitions]
+ *
+ * The frames are decoded like in CanDriveHarmonica::evalReceivedMsg() with the conversions of
+ * DriveParam before the factors were precomputed (two divisions per frame), with the precomputed
+ * factors of DriveParam including the sign of the drive, and with a DriveProfile fixed at compile
+ * time. For each variant the time per frame and the largest deviation from the first variant are
+ * reported.
+ */
+
+#include <cob_canopen_motor/DriveParam.h>
+#include <cob_canopen_motor/DriveProfile.h>
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <iostream>
+#include <vector>
+
+static double getTime()
+{
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+// drive motor of the example: 4096 increments, gear 37:1, belt 3:2
+typedef DriveProfile<4096, 37, 1, 3, 2> ExampleProfile;
+
+struct Frame
+{
+	unsigned char cData[8];
+};
+
+static int decodeInt(const unsigned char* pData)
+{
+	return (pData[3] << 24) | (pData[2] << 16) | (pData[1] << 8) | pData[0];
+}
+
+// conversion of DriveParam before the factors were precomputed
+static double divPosMotIncrToPosGearRad(int iPosIncr, double dPosGearRadToPosMotIncr)
+{
+	return ((double)iPosIncr / dPosGearRadToPosMotIncr);
+}
+
+static double divVelMotIncrPeriodToVelGearRadS(int iVelMotIncrPeriod, double dPosGearRadToPosMotIncr, double dVelMeasFrqHz)
+{
+	return ((double)iVelMotIncrPeriod / dPosGearRadToPosMotIncr * dVelMeasFrqHz);
+}
+
+int main(int argc, char** argv)
+{
+	const int num_frames = (argc>1) ? atoi(argv[1]) : 4096;
+	const int repetitions = (argc>2) ? atoi(argv[2]) : 2000;
+
+	DriveParam param;
+	param.setParam(1, 4096, 1, 1.5, 37, -1, 1e6, 1e6, 1e6);
+	if(!ExampleProfile::matches(param))
+	{
+		std::cout << "profile does not match the parameters" << std::endl;
+		return 1;
+	}
+
+	const int sign = param.getSign();
+	const double pos_gear_rad_to_incr = param.getEncIncrPerRevMot() * param.getGearRatio() * param.getBeltRatio() / (2. * M_PI);
+	const double vel_meas_frq_hz = param.getVelMeasFrqHz();
+	// as cached by CanDriveHarmonica::prepareSetpointMsgs()
+	const double pos_incr_to_gear_rad = sign * param.getPosMotIncrToPosGearRadFactor();
+	const double vel_incr_to_gear_rad_s = sign * param.getVelMotIncrPeriodToVelGearRadSFactor();
+
+	srand(1);
+	std::vector<Frame> frames(num_frames);
+	for(int i = 0; i < num_frames; i++)
+		for(int j = 0; j < 8; j++)
+			frames[i].cData[j] = rand() & 0xFF;
+
+	std::vector<double> pos[3], vel[3];
+	const char* names[3] =
+	{
+		"division per frame       ",
+		"precomputed DriveParam   ",
+		"compile-time DriveProfile",
+	};
+
+	for(int v = 0; v < 3; v++)
+	{
+		pos[v].resize(num_frames);
+		vel[v].resize(num_frames);
+
+		double time_start = getTime();
+		for(int r = 0; r < repetitions; r++)
+		{
+			for(int i = 0; i < num_frames; i++)
+			{
+				int pos_incr = decodeInt(&frames[i].cData[0]);
+				int vel_incr = decodeInt(&frames[i].cData[4]);
+
+				if(v == 0)
+				{
+					pos[v][i] = sign * divPosMotIncrToPosGearRad(pos_incr, pos_gear_rad_to_incr);
+					vel[v][i] = sign * divVelMotIncrPeriodToVelGearRadS(vel_incr, pos_gear_rad_to_incr, vel_meas_frq_hz);
+				}
+				else if(v == 1)
+				{
+					pos[v][i] = pos_incr * pos_incr_to_gear_rad;
+					vel[v][i] = vel_incr * vel_incr_to_gear_rad_s;
+				}
+				else
+				{
+					pos[v][i] = sign * ExampleProfile::PosMotIncrToPosGearRad(pos_incr);
+					vel[v][i] = sign * ExampleProfile::VelMotIncrPeriodToVelGearRadS(vel_incr);
+				}
+			}
+		}
+		double frame_ns = (getTime() - time_start) / ((double)repetitions * num_frames) * 1e9;
+
+		double max_rel_err = 0;
+		for(int i = 0; i < num_frames; i++)
+		{
+			if(pos[0][i] != 0)
+				max_rel_err = std::max(max_rel_err, fabs(pos[v][i] / pos[0][i] - 1));
+			if(vel[0][i] != 0)
+				max_rel_err = std::max(max_rel_err, fabs(vel[v][i] / vel[0][i] - 1));
+		}
+
+		std::cout << names[v] << ": " << frame_ns << " ns per frame, largest relative deviation " << max_rel_err << std::endl;
+	}
+
+	return 0;
+}
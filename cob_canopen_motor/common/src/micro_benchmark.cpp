@@ -0,0 +1,130 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Micro-benchmarks of the ElmoRecorder read-out processing on a synthesized recorder upload.
+ *
+ * usage: elmo_recorder_micro_benchmark [--log_prefix=/tmp/prefix_] [--filter=regex] [--format=console|json] [--out=file.json], see MicroBenchmark.h
+ *
+ * Each iteration hands the upload of object 0x2030 to processData() and waits until the
+ * processing thread has decoded it and written the logfile, so the time includes the thread
+ * start and the file output. The recorder is configured through a drive on a CAN interface
+ * which drops all messages. The argument of each benchmark is the number of samples.
+ */
+
+#include <cob_canopen_motor/CanDriveHarmonica.h>
+#include <cob_canopen_motor/ElmoRecorder.h>
+
+#include <cob_utilities/MicroBenchmark.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+// CAN interface which drops all transmitted messages and never receives one
+class NullCanItf : public CanItf
+{
+public:
+	bool init_ret() {return true;}
+	void init() {}
+	bool transmitMsg(CanMsg CMsg, bool bBlocking = true) {return true;}
+	bool receiveMsg(CanMsg* pCMsg) {return false;}
+	bool receiveMsgRetry(CanMsg* pCMsg, int iNrOfRetry) {return false;}
+	bool receiveMsgTimeout(CanMsg* pCMsg, int nMicroSecTimeout) {return false;}
+	bool isObjectMode() {return false;}
+};
+
+static const int DRIVE_ID = 1;
+static const int RECORDED_SOURCE = 1;
+
+// upload of iNumSamples 32bit floats (data type 5), see ElmoRecorder::processDataThread for the header
+static std::vector<unsigned char> createUpload(int iNumSamples)
+{
+	std::vector<unsigned char> data(7 + 4 * iNumSamples);
+	float fFactor = 0.001f;
+	unsigned int iFactor;
+	memcpy(&iFactor, &fFactor, 4);
+
+	data[0] = 0x50;
+	data[1] = iNumSamples & 0xFF;
+	data[2] = (iNumSamples >> 8) & 0xFF;
+	for(int i = 0; i < 4; i++)
+		data[3 + i] = (iFactor >> (8 * i)) & 0xFF;
+
+	for(int i = 0; i < iNumSamples; i++)
+	{
+		float fValue = 1000.0f * sin(0.01 * i);
+		unsigned int iValue;
+		memcpy(&iValue, &fValue, 4);
+		for(int k = 0; k < 4; k++)
+			data[7 + 4 * i + k] = (iValue >> (8 * k)) & 0xFF;
+	}
+	return data;
+}
+
+static void runProcessData(MicroBenchmark::State &state, int iLogFormat, const char* pcExtension)
+{
+	const std::string sPrefix = state.getArg("log_prefix", "/tmp/elmo_recorder_micro_benchmark_");
+	const std::vector<unsigned char> upload = createUpload(state.range());
+
+	NullCanItf canItf;
+	CanDriveHarmonica drive;
+	drive.setCanItf(&canItf);
+
+	ElmoRecorder recorder(&drive);
+	recorder.configureElmoRecorder(1, DRIVE_ID);
+	recorder.setLogFilename(sPrefix);
+	recorder.setLogFormat(iLogFormat);
+	// selects the recorded source, the status request is dropped by the CAN interface
+	recorder.readoutRecorderTry(RECORDED_SOURCE);
+
+	segData SDOData;
+	while(state.keepRunning())
+	{
+		// processData takes the buffer, so it is refilled outside of the measurement
+		state.pauseTiming();
+		SDOData.data.assign(upload.begin(), upload.end());
+		SDOData.numTotalBytes = upload.size();
+		state.resumeTiming();
+
+		recorder.processData(SDOData);
+		while(recorder.isProcessing())
+			usleep(10);
+	}
+	state.setItemsProcessed(state.iterations() * state.range());
+
+	char pcFilename[32];
+	sprintf(pcFilename, "mot_%d_%d.%s", DRIVE_ID, RECORDED_SOURCE, pcExtension);
+	unlink((sPrefix + pcFilename).c_str());
+}
+
+static void ElmoRecorder_ProcessDataBinary(MicroBenchmark::State &state)
+{
+	runProcessData(state, ElmoRecorder::LOG_BINARY, "bin");
+}
+MICRO_BENCHMARK_ARG(ElmoRecorder_ProcessDataBinary, 1024);
+
+static void ElmoRecorder_ProcessDataText(MicroBenchmark::State &state)
+{
+	runProcessData(state, ElmoRecorder::LOG_TEXT, "log");
+}
+MICRO_BENCHMARK_ARG(ElmoRecorder_ProcessDataText, 1024);
+
+MICRO_BENCHMARK_MAIN();
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * Compares the velocity estimators of CanDriveHarmonica on a simulated wheel.
+ *
+ * usage: velestim_benchmark [sync_rate_hz] [process_jitter_us] [acc_noise] [incr_per_rev]
+ *
+ * The drive samples its encoder on each SYNC, TPDO1 is stamped by the CAN interface after a
+ * short arbitration delay and evaluated after the scheduling delay of the receive thread.
+ * The wheel accelerates, cruises, reverses and follows a sine. For each estimator the delay
+ * that best aligns the estimate with the true velocity is reported as latency, with the
+ * remaining RMS error as tracking error, the RMS error while cruising as noise, and the time
+ * of one update.
+ */
+
+#include <cob_canopen_motor/VelEstimator.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <iostream>
+#include <vector>
+
+static double getTime()
+{
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+static double uniform()
+{
+	return rand() / (RAND_MAX + 1.0);
+}
+
+// true velocity of the wheel in rad/s
+static double trueVel(double t)
+{
+	if(t < 0.5)
+		return 0;
+	if(t < 1.0)
+		return 20 * (t - 0.5);
+	if(t < 2.0)
+		return 10;
+	if(t < 3.0)
+		return 10 - 20 * (t - 2.0);
+	if(t < 4.0)
+		return -10;
+	return -10 * cos(2 * M_PI * 2 * (t - 4.0));
+}
+
+struct Sample
+{
+	double dSyncTime;
+	double dRxTime;
+	double dProcTime;
+	double dPos;
+};
+
+static void evaluate(const char* pcName, const std::vector<Sample>& vSamples, const std::vector<double>& vEst)
+{
+	// latency: delay of the true velocity that fits the estimate best, from 0.5 s on when all estimators have settled
+	double dBestRms = 1e100;
+	int iBestShift = 0;
+	for(int iShift = 0; iShift < 200; iShift++)
+	{
+		double dSum = 0;
+		size_t n = 0;
+		for(size_t i = 0; i < vSamples.size(); i++)
+		{
+			if(vSamples[i].dSyncTime < 0.5)
+				continue;
+			// estimate compared with the true velocity iShift * 0.1 ms earlier
+			double dErr = vEst[i] - trueVel(vSamples[i].dSyncTime - iShift * 1e-4);
+			dSum += dErr * dErr;
+			n++;
+		}
+		double dRms = sqrt(dSum / n);
+		if(dRms < dBestRms)
+		{
+			dBestRms = dRms;
+			iBestShift = iShift;
+		}
+	}
+
+	// noise: error while cruising at constant velocity
+	double dSum = 0;
+	size_t n = 0;
+	for(size_t i = 0; i < vSamples.size(); i++)
+	{
+		if((vSamples[i].dSyncTime < 1.2) || (vSamples[i].dSyncTime > 1.9))
+			continue;
+		double dErr = vEst[i] - trueVel(vSamples[i].dSyncTime);
+		dSum += dErr * dErr;
+		n++;
+	}
+
+	std::cout << pcName << ": latency " << iBestShift * 0.1 << " ms, noise " << sqrt(dSum / n) <<
+		" rad/s rms at 10 rad/s, tracking error " << dBestRms << " rad/s rms" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	const double rate = (argc>1) ? atof(argv[1]) : 500;
+	const double process_jitter = ((argc>2) ? atof(argv[2]) : 500) * 1e-6;
+	const double acc_noise = (argc>3) ? atof(argv[3]) : 2;
+	const double incr_per_rev = (argc>4) ? atof(argv[4]) : 4096 * 40;
+	const double period = 1.0/rate;
+	const double duration = 6.0;
+
+	// arbitration delay of TPDO1 behind the SYNC and the other drives
+	const double rx_delay = 150e-6;
+	const double rx_jitter = 100e-6;
+
+	srand(1);
+	std::vector<Sample> samples;
+	double pos = 0;
+	for(double t = 0; t < duration; t += period)
+	{
+		Sample s;
+		s.dSyncTime = t;
+		s.dRxTime = t + rx_delay + rx_jitter * uniform();
+		s.dProcTime = s.dRxTime + process_jitter * uniform();
+		// the drive reports whole encoder increments
+		s.dPos = floor(pos * incr_per_rev / (2 * M_PI)) * 2 * M_PI / incr_per_rev;
+		samples.push_back(s);
+
+		// midpoint integration of the true velocity up to the next SYNC
+		pos += trueVel(t + 0.5 * period) * period;
+	}
+
+	std::cout << samples.size() << " positions at " << rate << " Hz, process jitter " << process_jitter * 1e6 << " us, " <<
+		incr_per_rev << " increments per revolution" << std::endl;
+
+	const double pos_noise = 2 * M_PI / incr_per_rev / sqrt(12.0);
+	struct Variant
+	{
+		const char* pcName;
+		int iMode;
+		bool bRxTime;
+	};
+	const Variant variants[] =
+	{
+		{ "difference, processing time", VelEstimator::VEL_EST_DIFF, false },
+		{ "difference, receive time   ", VelEstimator::VEL_EST_DIFF, true },
+		{ "Kalman, receive time       ", VelEstimator::VEL_EST_KALMAN, true },
+	};
+
+	std::vector<double> est(samples.size());
+	for(unsigned int v = 0; v < sizeof(variants)/sizeof(variants[0]); v++)
+	{
+		VelEstimator estimator;
+		estimator.setMode(variants[v].iMode, pos_noise, acc_noise, rx_jitter / sqrt(12.0));
+
+		const int repetitions = 100;
+		double time_start = getTime();
+		for(int r = 0; r < repetitions; r++)
+		{
+			estimator.reset();
+			double last_time = 0;
+			for(size_t i = 0; i < samples.size(); i++)
+			{
+				double time = variants[v].bRxTime ? samples[i].dRxTime : samples[i].dProcTime;
+				est[i] = estimator.update(samples[i].dPos, time - last_time, 0);
+				last_time = time;
+			}
+		}
+		double update_ns = (getTime() - time_start) / (repetitions * samples.size()) * 1e9;
+
+		evaluate(variants[v].pcName, samples, est);
+		std::cout << "  " << update_ns << " ns per update" << std::endl;
+	}
+
+	return 0;
+}
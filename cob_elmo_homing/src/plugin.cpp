@@ -33,21 +33,33 @@ class ElmoMotor402 : public canopen::Motor402 {
     int32_t speed_;
     uint32_t timeout_;
 
+    static const unsigned int max_poll_interval_ms = 10;
+
     uint64_t readResponse(uint64_t command)  {
-        boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
         uint64_t response = response_entry_.get();
         return (response & compare_mask) == (command & compare_mask) ? response : 0;
     }
 
+    // the first retry follows after 1 ms and the interval doubles up to max_poll_interval_ms,
+    // quick answers are picked up immediately while long waits do not flood the bus with SDO requests
+    static void waitForRetry(unsigned int &interval_ms){
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(interval_ms));
+        interval_ms = (2 * interval_ms < max_poll_interval_ms) ? 2 * interval_ms : max_poll_interval_ms;
+    }
+
     bool set(char c1, char c2, uint16_t index, uint32_t val){
         uint64_t response = 0;
         uint64_t command = c1 | (c2 << (1*8)) | ((index & 0x3FFF) << (2*8)) |  static_cast<uint64_t>(val) << (4*8);
         command_entry_.set(command);
 
         canopen::time_point timeout = canopen::get_abs_time(boost::chrono::seconds(1));
-        do{
+        unsigned int interval_ms = 1;
+        // the SDO download has been confirmed by the drive, so the answer is often available already
+        response = readResponse(command);
+        while(response != command && (response & byte_3_bit_6) == 0 && canopen::get_abs_time() < timeout){
+            waitForRetry(interval_ms);
             response = readResponse(command);
-        }while(response != command && (response & byte_3_bit_6) == 0 && canopen::get_abs_time() < timeout);
+        }
 
         bool ok = response == command && (response & byte_3_bit_6) == 0;
         return ok;
@@ -57,10 +69,14 @@ class ElmoMotor402 : public canopen::Motor402 {
         uint64_t command =  c1 | (c2 << (1*8)) | ((index & 0x3FFF) << (2*8)) | byte_3_bit_6;
 
         canopen::time_point timeout = canopen::get_abs_time(dur);
-        do{
+        unsigned int interval_ms = 1;
+        command_entry_.set(command);
+        response = readResponse(command);
+        while( (response >> (4*8)) != val  && canopen::get_abs_time() < timeout){
+            waitForRetry(interval_ms);
             command_entry_.set(command);
             response = readResponse(command);
-        }while( (response >> (4*8)) != val  && canopen::get_abs_time() < timeout);
+        }
 
         return (response & byte_3_bit_6) == 0  && (response >> (4*8)) == val;
     }
@@ -62,6 +62,7 @@ public:
     bool receiveMsgRetry(CanMsg* pCMsg, int iNrOfRetry);
     bool receiveMsg(CanMsg* pCMsg);
     bool receiveMsgTimeout(CanMsg* pCMsg, int nMicroSeconds);
+    int receiveMsgs(CanMsg* pCMsgs, int iMaxMsgs, int nMicroSecTimeout = 0);
     bool isObjectMode() { return m_bObjectMode; }
     bool isTransmitError() { return m_bIsTXError; }
 
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#ifndef CANFDMSG_INCLUDEDEF_H
+#define CANFDMSG_INCLUDEDEF_H
+//-----------------------------------------------
+#include <cstring>
+//-----------------------------------------------
+
+/**
+ * Represents a CAN-FD message with up to 64 data bytes.
+ * Classic frames keep using CanMsg, so the eight byte messages of the drives do not grow.
+ * \ingroup DriversCanModul
+ */
+class CanFdMsg
+{
+public:
+	typedef unsigned char BYTE;
+
+	/// Maximum number of data bytes of a CAN-FD frame.
+	static const int c_iMaxLen = 64;
+
+	/// Identifier, identifiers above 2047 are sent as 29-bit identifiers.
+	int m_iID;
+	/// Number of data bytes, see getFrameLength() for the length actually sent.
+	int m_iLen;
+	/// Send the data phase with the higher bit rate.
+	bool m_bBitRateSwitch;
+
+protected:
+	BYTE m_bDat[c_iMaxLen];
+
+public:
+	CanFdMsg()
+	{
+		m_iID = 0;
+		m_iLen = 0;
+		m_bBitRateSwitch = true;
+		memset(m_bDat, 0, sizeof(m_bDat));
+	}
+
+	/**
+	 * Copies iLen data bytes into the message, iLen is limited to c_iMaxLen.
+	 */
+	void setData(const BYTE* pData, int iLen)
+	{
+		if(iLen < 0)
+			iLen = 0;
+		if(iLen > c_iMaxLen)
+			iLen = c_iMaxLen;
+
+		memcpy(m_bDat, pData, iLen);
+		m_iLen = iLen;
+	}
+
+	/**
+	 * Returns a pointer to the c_iMaxLen data bytes.
+	 */
+	const BYTE* getData() const
+	{
+		return m_bDat;
+	}
+
+	void setAt(BYTE data, int iNr)
+	{
+		m_bDat[iNr] = data;
+	}
+
+	int getAt(int iNr) const
+	{
+		return m_bDat[iNr];
+	}
+
+	/**
+	 * Returns the length of the frame on the bus.
+	 * CAN-FD only supports 0..8, 12, 16, 20, 24, 32, 48 and 64 data bytes, the padding is sent as zero.
+	 */
+	int getFrameLength() const
+	{
+		if(m_iLen <= 8)
+			return m_iLen;
+		if(m_iLen <= 24)
+			return (m_iLen + 3) & ~3;
+		if(m_iLen <= 32)
+			return 32;
+		if(m_iLen <= 48)
+			return 48;
+		return 64;
+	}
+};
+//-----------------------------------------------
+#endif
@@ -18,7 +18,11 @@
 #ifndef CANITF_INCLUDEDEF_H
 #define CANITF_INCLUDEDEF_H
 //-----------------------------------------------
+#include <vector>
+
 #include <cob_generic_can/CanMsg.h>
+#include <cob_generic_can/CanFdMsg.h>
+#include <cob_generic_can/CanStatistics.h>
 //-----------------------------------------------
 
 // for types and baudrates see: https://github.com/ipa320/cob_robots/blob/hydro_dev/cob_hardware_config/raw3-5/config/base/CanCtrl.ini
@@ -77,6 +81,25 @@ public:
 	 */
 	virtual bool transmitMsg(CanMsg CMsg, bool bBlocking = true) = 0;
 
+	/**
+	 * Sends a group of CAN messages, e.g. all setpoints of one control cycle.
+	 * The default implementation sends the messages one by one, interfaces
+	 * with a transmit queue should override it to hand them over at once.
+	 * @param pCMsgs CAN messages
+	 * @param iNumMsgs number of messages
+	 * @param bBlocking specifies whether send should be blocking or non-blocking
+	 * @return number of messages accepted, less than iNumMsgs if the interface is busy
+	 */
+	virtual int transmitMsgs(const CanMsg* pCMsgs, int iNumMsgs, bool bBlocking = true)
+	{
+		int i = 0;
+
+		while( (i < iNumMsgs) && transmitMsg(pCMsgs[i], bBlocking) )
+			i++;
+
+		return i;
+	}
+
 	/**
 	 * Reads a CAN message.
 	 * @return true if a message is available
@@ -100,12 +123,73 @@ public:
 	 */
 	virtual bool receiveMsgTimeout(CanMsg* pCMsg, int nMicroSecTimeout) = 0;
 
+	/**
+	 * Reads all pending CAN messages into a caller provided buffer.
+	 * Waits up to nMicroSecTimeout for the first message and then drains
+	 * the receive queue without blocking.
+	 * The default implementation falls back to single reads, interfaces
+	 * with a bulk read should override it.
+	 * @param pCMsgs buffer of at least iMaxMsgs CAN messages
+	 * @param iMaxMsgs size of the buffer
+	 * @param nMicroSecTimeout timeout in us for the first message, 0 returns immediately
+	 * @return number of messages written to pCMsgs
+	 */
+	virtual int receiveMsgs(CanMsg* pCMsgs, int iMaxMsgs, int nMicroSecTimeout = 0)
+	{
+		int iNumMsgs = 0;
+
+		if(iMaxMsgs <= 0)
+			return 0;
+
+		if(nMicroSecTimeout > 0)
+		{
+			if(!receiveMsgTimeout(&pCMsgs[0], nMicroSecTimeout))
+				return 0;
+			iNumMsgs = 1;
+		}
+
+		while( (iNumMsgs < iMaxMsgs) && receiveMsg(&pCMsgs[iNumMsgs]) )
+			iNumMsgs++;
+
+		return iNumMsgs;
+	}
+
 	/**
 	 * Check if the current CAN interface was opened on OBJECT mode.
 	 * @return true if opened in OBJECT mode, false if not.
 	 */
 	virtual bool isObjectMode() = 0;
 
+	/**
+	 * Restricts the reception to the given identifiers, the driver then discards all other frames
+	 * before they reach the process. Can be called before and after init().
+	 * The default implementation does not filter, so the caller still has to discard unknown identifiers.
+	 * @param viIDs identifiers to receive, an empty list receives all frames
+	 * @return true if the interface filters
+	 */
+	virtual bool setRxFilter(const std::vector<int>& /*viIDs*/) { return false; }
+
+	/**
+	 * Check if the CAN interface can send and receive CAN-FD frames.
+	 * The default implementation supports classic frames only.
+	 */
+	virtual bool isFdCapable() { return false; }
+
+	/**
+	 * Sends a CAN-FD message.
+	 * @param CMsg CAN-FD message
+	 * @return false if the interface is not FD capable or the frame could not be sent
+	 */
+	virtual bool transmitFdMsg(const CanFdMsg& /*CMsg*/) { return false; }
+
+	/**
+	 * Reads a CAN-FD message, classic frames are only returned by the receive functions for CanMsg.
+	 * @param pCMsg CAN-FD message
+	 * @param nMicroSecTimeout timeout in us, 0 returns immediately
+	 * @return true if a message is available
+	 */
+	virtual bool receiveFdMsg(CanFdMsg* /*pCMsg*/, int /*nMicroSecTimeout*/ = 0) { return false; }
+
 	/**
 	 * Set the CAN interface type. This is necessary to implement
 	 * a proper CAN bus simulation.
@@ -120,6 +204,16 @@ public:
 	 */
 	CanItfType getCanItfType() { return m_iCanItfType; }
 
+	/**
+	 * Get the traffic counters of the CAN interface, e.g. to compute the bus load.
+	 * @param pSnapshot copy of the counters
+	 */
+	void getStatistics(CanStatistics::Snapshot* pSnapshot) const { m_Statistics.getSnapshot(pSnapshot); }
+
+protected:
+	/// Traffic counters, updated by the implementations.
+	CanStatistics m_Statistics;
+
 private:
 	/// The CAN interface type.
 	CanItfType m_iCanItfType;
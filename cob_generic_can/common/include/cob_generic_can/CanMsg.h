@@ -19,6 +19,9 @@
 #define CANMSG_INCLUDEDEF_H
 //-----------------------------------------------
 #include <iostream>
+#include <cstring>
+#include <stdint.h>
+#include <time.h>
 //-----------------------------------------------
 
 /**
@@ -43,6 +46,11 @@ protected:
 	 */
 	BYTE m_bDat[8];
 
+	/**
+	 * Receive time in ns of CLOCK_MONOTONIC, 0 if the interface did not stamp the message.
+	 */
+	int64_t m_llRxTimeNs;
+
 public:
 	/**
 	 * Default constructor.
@@ -52,6 +60,7 @@ public:
 		m_iID = 0;
 		m_iLen = 8;
 		m_iType = 0x00;
+		m_llRxTimeNs = 0;
 	}
 
 	/**
@@ -69,6 +78,23 @@ public:
 		m_bDat[7] = Data7;
 	}
 
+	/**
+	 * Copies the payload of a received frame into the telegram.
+	 * @param pData pointer to (at least) eight data bytes
+	 */
+	void setData(const BYTE* pData)
+	{
+		memcpy(m_bDat, pData, sizeof(m_bDat));
+	}
+
+	/**
+	 * Returns a pointer to the eight bytes of the telegram.
+	 */
+	const BYTE* getData() const
+	{
+		return m_bDat;
+	}
+
 	/**
 	 * Set the byte at the given position.
 	 */
@@ -203,6 +229,38 @@ public:
 		m_iType = type;
 	}
 
+	/**
+	 * Set the receive time, taken from the driver if it provides one.
+	 * @param llRxTimeNs time in ns of CLOCK_MONOTONIC
+	 */
+	void setRxTime(int64_t llRxTimeNs)
+	{
+		m_llRxTimeNs = llRxTimeNs;
+	}
+
+	/**
+	 * Stamps the message with the current time, for interfaces without driver time stamps.
+	 */
+	void setRxTimeNow()
+	{
+		m_llRxTimeNs = getMonotonicTimeNs();
+	}
+
+	/**
+	 * Get the receive time in ns of CLOCK_MONOTONIC, 0 if the message was not stamped.
+	 */
+	int64_t getRxTime() const
+	{
+		return m_llRxTimeNs;
+	}
+
+	static int64_t getMonotonicTimeNs()
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	}
+
 
 };
 //-----------------------------------------------
@@ -19,6 +19,7 @@
 #define CANPEAKSYS_INCLUDEDEF_H
 //-----------------------------------------------
 #include <cob_generic_can/CanItf.h>
+#include <cob_generic_can/CanTimeSync.h>
 #include <libpcan/libpcan.h>
 #include <cob_utilities/IniFile.h>
 //-----------------------------------------------
@@ -48,6 +49,11 @@ private:
 
 	static const int c_iInterrupt;
 	static const int c_iPort;
+
+	// converts the receive time stamps of the driver
+	CanTimeSync m_RxTimeSync;
+
+	void setRxTime(CanMsg* pCMsg, const TPCANRdMsg& TPCMsg);
 };
 //-----------------------------------------------
 #endif
@@ -18,7 +18,12 @@
 #ifndef CANPEAKSYSUSB_INCLUDEDEF_H
 #define CANPEAKSYSUSB_INCLUDEDEF_H
 //-----------------------------------------------
+#include <deque>
+#include <vector>
+#include <boost/thread.hpp>
+
 #include <cob_generic_can/CanItf.h>
+#include <cob_generic_can/CanTimeSync.h>
 #include <libpcan/libpcan.h>
 #include <cob_utilities/IniFile.h>
 //-----------------------------------------------
@@ -34,6 +39,7 @@ public:
 	void init();
 	void destroy() {};
 	bool transmitMsg(CanMsg CMsg, bool bBlocking = true);
+	int transmitMsgs(const CanMsg* pCMsgs, int iNumMsgs, bool bBlocking = true);
 	bool receiveMsg(CanMsg* pCMsg);
 	bool receiveMsgRetry(CanMsg* pCMsg, int iNrOfRetry);
 	bool receiveMsgTimeout(CanMsg* pCMsg, int nMicroSeconds);
@@ -52,7 +58,35 @@ private:
 	static const int c_iInterrupt;
 	static const int c_iPort;
 
+	// converts the receive time stamps of the driver
+	CanTimeSync m_RxTimeSync;
+
+	void setRxTime(CanMsg* pCMsg, const TPCANRdMsg& TPCMsg);
+
+	// frames queued by non-blocking transmits, sent in bulk by the transmit thread
+	static const size_t c_iTxQueueSize = 64;
+	// write timeout per frame
+	static const int c_iTxTimeoutUs = 25;
+	// minimum time between two attempts to re-initialize the adapter
+	static const int c_iReinitIntervalMs = 1000;
+	std::deque<TPCANMsg> m_TxQueue;
+	std::vector<TPCANMsg> m_TxBatch;
+	boost::mutex m_TxMutex;
+	boost::condition_variable m_TxQueued;
+	boost::condition_variable m_TxDrained;
+	boost::thread m_TxThread;
+	bool m_bTxBusy;
+	bool m_bTxShutdown;
+	// set by a failed write, the adapter status is only read then
+	boost::atomic<bool> m_bTxError;
+
 	bool initCAN();
+	int initBaudrate();
+	static TPCANMsg toPCANMsg(const CanMsg& CMsg);
+	bool writeMsg(TPCANMsg* pTPCMsg);
+	void waitForTxDrained(boost::unique_lock<boost::mutex>& lock);
+	bool checkTxError();
+	void txThread();
 
 	void outputDetailedStatus();
 };
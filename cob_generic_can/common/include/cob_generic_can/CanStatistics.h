@@ -0,0 +1,141 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CANSTATISTICS_INCLUDEDEF_H
+#define CANSTATISTICS_INCLUDEDEF_H
+//-----------------------------------------------
+#include <boost/atomic.hpp>
+//-----------------------------------------------
+
+/**
+ * Traffic counters of a CAN interface.
+ * The counters are only incremented, rates are computed by the reader from two snapshots.
+ * All functions may be called concurrently from receive, transmit and diagnostics threads.
+ * \ingroup DriversCanModul
+ */
+class CanStatistics
+{
+public:
+	/// Number of bins of the receive latency histogram.
+	static const int c_iNumLatencyBins = 8;
+
+	/**
+	 * Copy of all counters at one point in time.
+	 */
+	struct Snapshot
+	{
+		unsigned long ulRxFrames;
+		unsigned long ulRxBytes;
+		unsigned long ulTxFrames;
+		unsigned long ulTxBytes;
+		/// Error frames, bus status messages and failed transfers.
+		unsigned long ulErrors;
+		/// Transmits rejected because the transmit queue was full.
+		unsigned long ulTxOverruns;
+		/// Frames currently waiting in the transmit queue.
+		int iTxQueueDepth;
+		/// Time frames spent between reception by the driver and hand-out to the application.
+		unsigned long ulRxLatency[c_iNumLatencyBins];
+	};
+
+	CanStatistics()
+	{
+		m_ulRxFrames = 0;
+		m_ulRxBytes = 0;
+		m_ulTxFrames = 0;
+		m_ulTxBytes = 0;
+		m_ulErrors = 0;
+		m_ulTxOverruns = 0;
+		m_iTxQueueDepth = 0;
+		for(int i = 0; i < c_iNumLatencyBins; i++)
+			m_ulRxLatency[i] = 0;
+	}
+
+	void countRx(int iLen)
+	{
+		m_ulRxFrames.fetch_add(1, boost::memory_order_relaxed);
+		m_ulRxBytes.fetch_add(iLen, boost::memory_order_relaxed);
+	}
+
+	void countTx(int iLen)
+	{
+		m_ulTxFrames.fetch_add(1, boost::memory_order_relaxed);
+		m_ulTxBytes.fetch_add(iLen, boost::memory_order_relaxed);
+	}
+
+	void countError()
+	{
+		m_ulErrors.fetch_add(1, boost::memory_order_relaxed);
+	}
+
+	void countTxOverrun()
+	{
+		m_ulTxOverruns.fetch_add(1, boost::memory_order_relaxed);
+	}
+
+	void setTxQueueDepth(int iDepth)
+	{
+		m_iTxQueueDepth.store(iDepth, boost::memory_order_relaxed);
+	}
+
+	/**
+	 * Adds a receive latency to the histogram.
+	 * @param dLatency latency in s
+	 */
+	void addRxLatency(double dLatency)
+	{
+		int iBin = 0;
+		while( (iBin < c_iNumLatencyBins - 1) && (dLatency >= getLatencyBinLimit(iBin)) )
+			iBin++;
+		m_ulRxLatency[iBin].fetch_add(1, boost::memory_order_relaxed);
+	}
+
+	/**
+	 * Upper limit of a latency bin in s, the last bin is unbounded.
+	 * Bins are 0.1, 0.2, 0.5, 1, 2, 5, 10 ms and above.
+	 */
+	static double getLatencyBinLimit(int iBin)
+	{
+		static const double c_dLimits[c_iNumLatencyBins - 1] = { 0.0001, 0.0002, 0.0005, 0.001, 0.002, 0.005, 0.01 };
+		return c_dLimits[iBin];
+	}
+
+	void getSnapshot(Snapshot* pSnapshot) const
+	{
+		pSnapshot->ulRxFrames = m_ulRxFrames.load(boost::memory_order_relaxed);
+		pSnapshot->ulRxBytes = m_ulRxBytes.load(boost::memory_order_relaxed);
+		pSnapshot->ulTxFrames = m_ulTxFrames.load(boost::memory_order_relaxed);
+		pSnapshot->ulTxBytes = m_ulTxBytes.load(boost::memory_order_relaxed);
+		pSnapshot->ulErrors = m_ulErrors.load(boost::memory_order_relaxed);
+		pSnapshot->ulTxOverruns = m_ulTxOverruns.load(boost::memory_order_relaxed);
+		pSnapshot->iTxQueueDepth = m_iTxQueueDepth.load(boost::memory_order_relaxed);
+		for(int i = 0; i < c_iNumLatencyBins; i++)
+			pSnapshot->ulRxLatency[i] = m_ulRxLatency[i].load(boost::memory_order_relaxed);
+	}
+
+private:
+	boost::atomic<unsigned long> m_ulRxFrames;
+	boost::atomic<unsigned long> m_ulRxBytes;
+	boost::atomic<unsigned long> m_ulTxFrames;
+	boost::atomic<unsigned long> m_ulTxBytes;
+	boost::atomic<unsigned long> m_ulErrors;
+	boost::atomic<unsigned long> m_ulTxOverruns;
+	boost::atomic<int> m_iTxQueueDepth;
+	boost::atomic<unsigned long> m_ulRxLatency[c_iNumLatencyBins];
+};
+//-----------------------------------------------
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#ifndef CANTIMESYNC_INCLUDEDEF_H
+#define CANTIMESYNC_INCLUDEDEF_H
+//-----------------------------------------------
+#include <cob_generic_can/CanMsg.h>
+//-----------------------------------------------
+
+/**
+ * Converts receive time stamps of a CAN driver into CLOCK_MONOTONIC.
+ * The driver clock has an unknown offset. A message is read at the earliest when it is stamped,
+ * so the smallest difference between read time and driver time is the best estimate of the offset.
+ * \ingroup DriversCanModul
+ */
+class CanTimeSync
+{
+public:
+	CanTimeSync()
+	{
+		m_bValid = false;
+		m_llOffsetNs = 0;
+	}
+
+	/**
+	 * Returns the driver time as time of CLOCK_MONOTONIC.
+	 * @param llDriverTimeNs receive time of the driver in ns
+	 * @param llReadTimeNs time of CLOCK_MONOTONIC when the message was read
+	 */
+	int64_t toMonotonic(int64_t llDriverTimeNs, int64_t llReadTimeNs)
+	{
+		int64_t llOffsetNs = llReadTimeNs - llDriverTimeNs;
+
+		// a driver restart moves its clock, so a much larger offset starts over
+		if( !m_bValid || (llOffsetNs < m_llOffsetNs) || (llOffsetNs - m_llOffsetNs > c_llResyncNs) )
+		{
+			m_llOffsetNs = llOffsetNs;
+			m_bValid = true;
+		}
+
+		return llDriverTimeNs + m_llOffsetNs;
+	}
+
+private:
+	/// Offsets this much larger than the estimate are taken as a new driver clock.
+	static const int64_t c_llResyncNs = 1000000000LL;
+
+	bool m_bValid;
+	int64_t m_llOffsetNs;
+};
+//-----------------------------------------------
+#endif
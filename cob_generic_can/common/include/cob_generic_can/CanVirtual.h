@@ -0,0 +1,98 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#ifndef CANVIRTUAL_INCLUDEDEF_H
+#define CANVIRTUAL_INCLUDEDEF_H
+//-----------------------------------------------
+#include <deque>
+#include <vector>
+#include <boost/thread.hpp>
+
+#include <cob_generic_can/CanItf.h>
+//-----------------------------------------------
+
+class CanVirtual;
+
+/**
+ * In-process CAN bus connecting several CanVirtual nodes.
+ * A message transmitted by one node is received by all other nodes, like on a real bus.
+ * \ingroup DriversCanModul
+ */
+class CanVirtualBus
+{
+public:
+	/**
+	 * Bus used by the CanVirtual nodes created without an explicit bus.
+	 */
+	static CanVirtualBus& getDefault();
+
+	void attach(CanVirtual* pNode);
+	void detach(CanVirtual* pNode);
+
+	/**
+	 * Hands a message to all nodes except the sender.
+	 */
+	void deliver(const CanVirtual* pSender, const CanMsg& CMsg);
+
+private:
+	boost::mutex m_Mutex;
+	std::vector<CanVirtual*> m_vpNodes;
+};
+
+/**
+ * CAN interface without hardware (CAN type 3 in CanCtrl.ini).
+ * Together with simulated drives it allows to run and benchmark the platform control without a robot.
+ * \ingroup DriversCanModul
+ */
+class CanVirtual : public CanItf
+{
+public:
+	// --------------- Interface
+	CanVirtual(CanVirtualBus& bus = CanVirtualBus::getDefault());
+	/// The ini file has no settings for the virtual bus, the node is attached to the default bus.
+	CanVirtual(const char* cIniFile);
+	~CanVirtual();
+	bool init_ret() { return true; }
+	void init() {}
+	void destroy() {}
+	bool transmitMsg(CanMsg CMsg, bool bBlocking = true);
+	bool receiveMsg(CanMsg* pCMsg);
+	bool receiveMsgRetry(CanMsg* pCMsg, int iNrOfRetry);
+	bool receiveMsgTimeout(CanMsg* pCMsg, int nMicroSeconds);
+	int receiveMsgs(CanMsg* pCMsgs, int iMaxMsgs, int nMicroSecTimeout = 0);
+	bool isObjectMode() { return false; }
+
+	/**
+	 * Called by the bus for each message of the other nodes.
+	 */
+	void deliver(const CanMsg& CMsg);
+
+private:
+	// messages beyond this are dropped and counted as errors, like an overrun of the driver queue
+	static const size_t c_iRxQueueSize = 1024;
+
+	CanVirtualBus& m_Bus;
+	std::deque<CanMsg> m_RxQueue;
+	boost::mutex m_RxMutex;
+	boost::condition_variable m_RxQueued;
+
+	bool waitForMsg(boost::unique_lock<boost::mutex>& lock, int nMicroSeconds);
+	void popMsg(CanMsg* pCMsg);
+};
+//-----------------------------------------------
+#endif
@@ -18,12 +18,15 @@
 #ifndef SOCKETCAN_INCLUDEDEF_H
 #define SOCKETCAN_INCLUDEDEF_H
 //-----------------------------------------------
+#include <deque>
+#include <string>
+#include <vector>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
 
 #include <cob_generic_can/CanItf.h>
 #include <socketcan_interface/socketcan.h>
 #include <socketcan_interface/threading.h>
-#include <socketcan_interface/reader.h>
 //-----------------------------------------------
 
 class SocketCan : public CanItf
@@ -36,21 +39,63 @@ public:
     bool init_ret();
     void init();
     bool transmitMsg ( CanMsg CMsg, bool bBlocking = true );
+    int transmitMsgs ( const CanMsg* pCMsgs, int iNumMsgs, bool bBlocking = true );
     bool receiveMsg ( CanMsg* pCMsg );
     bool receiveMsgRetry ( CanMsg* pCMsg, int iNrOfRetry );
     bool receiveMsgTimeout ( CanMsg* pCMsg, int nMicroSecTimeout );
+    int receiveMsgs ( CanMsg* pCMsgs, int iMaxMsgs, int nMicroSecTimeout = 0 );
     bool isObjectMode() {
         return false;
     }
+    bool setRxFilter ( const std::vector<int>& viIDs );
+    bool isFdCapable() {
+        return m_iFdSocket >= 0;
+    }
+    bool transmitFdMsg ( const CanFdMsg& CMsg );
+    bool receiveFdMsg ( CanFdMsg* pCMsg, int nMicroSecTimeout = 0 );
 
 private:
     // --------------- Types
     boost::shared_ptr<can::ThreadedSocketCANInterface> m_handle;
-    can::BufferedReader m_reader;
+
+    // received frames with their arrival time, filled by the socketcan_interface thread
+    struct RxFrame
+    {
+        can::Frame frame;
+        boost::chrono::steady_clock::time_point stamp;
+    };
+    std::deque<RxFrame> m_RxQueue;
+    boost::mutex m_RxMutex;
+    boost::condition_variable m_RxQueued;
+    can::CommInterface::FrameListener::Ptr m_RxListener;
 
     bool m_bInitialized;
-    const char* p_cDevice;
+    std::string m_sDevice;
+
+    // accept list of the kernel filter, applied to both sockets; empty receives all frames
+    std::vector<int> m_viRxFilter;
+
+    // frames queued by non-blocking transmits, sent in bulk by the transmit thread
+    static const size_t c_iTxQueueSize = 64;
+    std::deque<can::Frame> m_TxQueue;
+    std::vector<can::Frame> m_TxBatch;
+    boost::mutex m_TxMutex;
+    boost::condition_variable m_TxQueued;
+    boost::condition_variable m_TxDrained;
+    boost::thread m_TxThread;
+    bool m_bTxBusy;
+    bool m_bTxShutdown;
+
+    // raw socket with CAN_RAW_FD_FRAMES, socketcan_interface only handles classic frames; -1 if the device is not FD capable
+    int m_iFdSocket;
 
+    void openFdSocket();
+    bool applyRxFilter();
+    void handleFrame ( const can::Frame& frame );
+    bool readFrame ( can::Frame* pFrame, const boost::chrono::microseconds& timeout, int64_t* pllRxTimeNs );
+    static can::Frame toFrame ( const CanMsg& CMsg );
+    void waitForTxDrained ( boost::unique_lock<boost::mutex>& lock );
+    void txThread();
     void print_error ( const can::State& state );
 };
 //-----------------------------------------------
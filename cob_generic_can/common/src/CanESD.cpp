@@ -16,6 +16,7 @@
 
 
 // general includes
+#include <algorithm>
 
 // Headers provided by other cob-packages
 #include <cob_generic_can/CanESD.h>
@@ -129,6 +130,11 @@ bool CanESD::transmitMsg(CanMsg CMsg, bool bBlocking)
 	{
 		std::cout << "error in CANESD::transmitMsg: " << GetErrorStr(ret) << std::endl;
 		bRet = false;
+		m_Statistics.countError();
+	}
+	else
+	{
+		m_Statistics.countTx(NTCANMsg.len);
 	}
 
 	m_LastID = (int)NTCANMsg.data[0];
@@ -175,6 +181,8 @@ bool CanESD::receiveMsgRetry(CanMsg* pCMsg, int iNrOfRetry)
 		pCMsg->m_iLen = NTCANMsg.len;
 		pCMsg->set(NTCANMsg.data[0], NTCANMsg.data[1], NTCANMsg.data[2], NTCANMsg.data[3],
 			NTCANMsg.data[4], NTCANMsg.data[5], NTCANMsg.data[6], NTCANMsg.data[7]);
+		pCMsg->setRxTimeNow();
+		m_Statistics.countRx(NTCANMsg.len);
 	}
 
 	return bRet;
@@ -224,6 +232,8 @@ bool CanESD::receiveMsg(CanMsg* pCMsg)
 			pCMsg->m_iLen = NTCANMsg.len;
 			pCMsg->set(NTCANMsg.data[0], NTCANMsg.data[1], NTCANMsg.data[2], NTCANMsg.data[3],
 				NTCANMsg.data[4], NTCANMsg.data[5], NTCANMsg.data[6], NTCANMsg.data[7]);
+			pCMsg->setRxTimeNow();
+			m_Statistics.countRx(NTCANMsg.len);
 			bRet = true;
 		}
 		else
@@ -251,6 +261,8 @@ bool CanESD::receiveMsg(CanMsg* pCMsg)
 			pCMsg->m_iLen = NTCANMsg.len;
 			pCMsg->set(NTCANMsg.data[0], NTCANMsg.data[1], NTCANMsg.data[2], NTCANMsg.data[3],
 				   NTCANMsg.data[4], NTCANMsg.data[5], NTCANMsg.data[6], NTCANMsg.data[7]);
+			pCMsg->setRxTimeNow();
+			m_Statistics.countRx(NTCANMsg.len);
 			bRet = true;
 		}
 	}
@@ -269,6 +281,53 @@ bool CanESD::receiveMsgTimeout(CanMsg* pCMsg, int nMicroSecTimeout)
     return false;
 }
 
+//-----------------------------------------------
+int CanESD::receiveMsgs(CanMsg* pCMsgs, int iMaxMsgs, int nMicroSecTimeout)
+{
+	// in OBJECT mode every identifier has to be polled on its own
+	if( isObjectMode() )
+		return CanItf::receiveMsgs(pCMsgs, iMaxMsgs, nMicroSecTimeout);
+
+	const int c_iChunkSize = 64;
+	CMSG NTCANMsgs[c_iChunkSize];
+	int iNumMsgs = 0;
+
+	// canTake() hands out as many queued messages as fit into the buffer within a single call
+	while( iNumMsgs < iMaxMsgs )
+	{
+		int32_t len = std::min(iMaxMsgs - iNumMsgs, c_iChunkSize);
+		int32_t iRequested = len;
+		int ret = canTake(m_Handle, NTCANMsgs, &len);
+		int64_t llRxTimeNs = CanMsg::getMonotonicTimeNs();
+
+		if( ret != NTCAN_SUCCESS )
+		{
+			std::cout << "error in CANESD::receiveMsgs: " << GetErrorStr(ret) << std::endl;
+			m_Statistics.countError();
+			break;
+		}
+
+		for( int i = 0; i < len; i++ )
+		{
+			CanMsg& msg = pCMsgs[iNumMsgs++];
+			msg.m_iID = NTCANMsgs[i].id;
+			msg.m_iLen = NTCANMsgs[i].len;
+			msg.setData(NTCANMsgs[i].data);
+			msg.setRxTime(llRxTimeNs);
+			m_Statistics.countRx(NTCANMsgs[i].len);
+
+			if( NTCANMsgs[i].msg_lost != 0 )
+				std::cout << (int)(NTCANMsgs[i].msg_lost) << " messages lost!" << std::endl;
+		}
+
+		// queue is empty
+		if( len < iRequested )
+			break;
+	}
+
+	return iNumMsgs;
+}
+
 /**
  * Add a group of CAN identifier to the handle, so it can be received.
  * The identifiers are generated by inverting the id and adding each value between 0 and 7
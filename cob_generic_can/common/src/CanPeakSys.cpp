@@ -139,6 +139,10 @@ bool CanPeakSys::transmitMsg(CanMsg CMsg, bool bBlocking)
 		bRet = false;
 	}
 
+	if(bRet)
+		m_Statistics.countTx(TPCMsg.LEN);
+	else
+		m_Statistics.countError();
 
 	return bRet;
 }
@@ -164,12 +168,15 @@ bool CanPeakSys::receiveMsg(CanMsg* pCMsg)
 		pCMsg->m_iID = TPCMsg.Msg.ID;
 		pCMsg->set(TPCMsg.Msg.DATA[0], TPCMsg.Msg.DATA[1], TPCMsg.Msg.DATA[2], TPCMsg.Msg.DATA[3],
 			TPCMsg.Msg.DATA[4], TPCMsg.Msg.DATA[5], TPCMsg.Msg.DATA[6], TPCMsg.Msg.DATA[7]);
+		setRxTime(pCMsg, TPCMsg);
+		m_Statistics.countRx(TPCMsg.Msg.LEN);
 		bRet = true;
 	}
 	else if (CAN_Status(m_handle) != CAN_ERR_QRCVEMPTY)
 	{
 		std::cout << "CanPeakSys::receiveMsg ERROR: iRet = " << iRet << std::endl;
 		pCMsg->set(0, 0, 0, 0, 0, 0, 0, 0);
+		m_Statistics.countError();
 	}
 	else
 	{
@@ -220,6 +227,8 @@ bool CanPeakSys::receiveMsgRetry(CanMsg* pCMsg, int iNrOfRetry)
 		pCMsg->m_iID = TPCMsg.Msg.ID;
 		pCMsg->set(TPCMsg.Msg.DATA[0], TPCMsg.Msg.DATA[1], TPCMsg.Msg.DATA[2], TPCMsg.Msg.DATA[3],
 			TPCMsg.Msg.DATA[4], TPCMsg.Msg.DATA[5], TPCMsg.Msg.DATA[6], TPCMsg.Msg.DATA[7]);
+		setRxTime(pCMsg, TPCMsg);
+		m_Statistics.countRx(TPCMsg.Msg.LEN);
 	}
 
 	return bRet;
@@ -254,7 +263,18 @@ bool CanPeakSys::receiveMsgTimeout(CanMsg* pCMsg, int nMicroSecTimeout)
 	pCMsg->setLength(TPCMsg.Msg.LEN);
 	pCMsg->set(TPCMsg.Msg.DATA[0], TPCMsg.Msg.DATA[1], TPCMsg.Msg.DATA[2], TPCMsg.Msg.DATA[3],
 		    TPCMsg.Msg.DATA[4], TPCMsg.Msg.DATA[5], TPCMsg.Msg.DATA[6], TPCMsg.Msg.DATA[7]);
+	setRxTime(pCMsg, TPCMsg);
+	m_Statistics.countRx(TPCMsg.Msg.LEN);
     }
 
     return bRet;
 }
+
+//-------------------------------------------
+void CanPeakSys::setRxTime(CanMsg* pCMsg, const TPCANRdMsg& TPCMsg)
+{
+	// the driver stamps in ms and us since it was loaded
+	int64_t llDriverTimeNs = (int64_t)TPCMsg.dwTime * 1000000LL + (int64_t)TPCMsg.wUsec * 1000LL;
+
+	pCMsg->setRxTime(m_RxTimeSync.toMonotonic(llDriverTimeNs, CanMsg::getMonotonicTimeNs()));
+}
@@ -30,6 +30,9 @@
 CANPeakSysUSB::CANPeakSysUSB(const char* device, int baudrate)
 {
         m_bInitialized = false;
+        m_bTxBusy = false;
+        m_bTxShutdown = false;
+        m_bTxError = false;
 
         p_cDevice = device;
         m_iBaudrateVal = baudrate;
@@ -38,6 +41,9 @@ CANPeakSysUSB::CANPeakSysUSB(const char* device, int baudrate)
 CANPeakSysUSB::CANPeakSysUSB(const char* cIniFile)
 {
         m_bInitialized = false;
+        m_bTxBusy = false;
+        m_bTxShutdown = false;
+        m_bTxError = false;
 
         // read IniFile
         m_IniFile.SetFileName(cIniFile, "CanPeakSysUSB.cpp");
@@ -48,6 +54,16 @@ CANPeakSysUSB::CANPeakSysUSB(const char* cIniFile)
 //-----------------------------------------------
 CANPeakSysUSB::~CANPeakSysUSB()
 {
+        if (m_TxThread.joinable())
+        {
+                {
+                        boost::mutex::scoped_lock lock(m_TxMutex);
+                        m_bTxShutdown = true;
+                }
+                m_TxQueued.notify_all();
+                m_TxThread.join();
+        }
+
         if (m_bInitialized)
         {
                 CAN_Close(m_handle);
@@ -104,56 +120,181 @@ void CANPeakSysUSB::init()
 //-------------------------------------------
 bool CANPeakSysUSB::transmitMsg(CanMsg CMsg, bool bBlocking)
 {
-        TPCANMsg TPCMsg;
-        bool bRet = true;
+        return transmitMsgs(&CMsg, 1, bBlocking) == 1;
+}
 
-        if (m_bInitialized == false) return false;
+//-------------------------------------------
+int CANPeakSysUSB::transmitMsgs(const CanMsg* pCMsgs, int iNumMsgs, bool bBlocking)
+{
+        if (m_bInitialized == false) return 0;
+
+        boost::unique_lock<boost::mutex> lock(m_TxMutex);
+
+        if (bBlocking)
+        {
+                // keep the order of earlier non-blocking frames, then write directly
+                waitForTxDrained(lock);
+
+                int i = 0;
+                TPCANMsg TPCMsg;
+                while (i < iNumMsgs)
+                {
+                        TPCMsg = toPCANMsg(pCMsgs[i]);
+                        if (!writeMsg(&TPCMsg))
+                                break;
+                        i++;
+                }
+
+                // the status is evaluated and the adapter re-initialized by the transmit thread
+                if (m_bTxError)
+                        m_TxQueued.notify_one();
+                return i;
+        }
+
+        // non-blocking: queue as many frames as fit, the caller sees back-pressure in the return value
+        int i = 0;
+        while (i < iNumMsgs && m_TxQueue.size() < c_iTxQueueSize)
+        {
+                m_TxQueue.push_back(toPCANMsg(pCMsgs[i]));
+                i++;
+        }
+        m_Statistics.setTxQueueDepth(m_TxQueue.size());
+        lock.unlock();
+
+        if (i < iNumMsgs)
+                m_Statistics.countTxOverrun();
+
+        if (i > 0)
+                m_TxQueued.notify_one();
+        return i;
+}
+
+//-------------------------------------------
+TPCANMsg CANPeakSysUSB::toPCANMsg(const CanMsg& CMsg)
+{
+        TPCANMsg TPCMsg;
+        const CanMsg::BYTE* pData = CMsg.getData();
 
         // copy CMsg to TPCmsg
-        TPCMsg.LEN = CMsg.getLength();
-        TPCMsg.ID = CMsg.getID();
-        TPCMsg.MSGTYPE = CMsg.getType();
+        TPCMsg.LEN = CMsg.m_iLen;
+        TPCMsg.ID = CMsg.m_iID;
+        TPCMsg.MSGTYPE = CMsg.m_iType;
         for(int i=0; i<8; i++)
-                TPCMsg.DATA[i] = CMsg.getAt(i);
+                TPCMsg.DATA[i] = pData[i];
 
-        //TODO Hier stürtzt die Base ab.. verwende libpcan.h pcan.h um Fehler auszulesen, diagnostizieren, ausgeben und CAN_INIT erneut aufzurufen = neustart can-hardware.
+        return TPCMsg;
+}
 
-        int iRet;
-        //iRet = CAN_Write(m_handle, &TPCMsg);
-        iRet = LINUX_CAN_Write_Timeout(m_handle, &TPCMsg, 25); //Timeout in micrsoseconds
+//-------------------------------------------
+bool CANPeakSysUSB::writeMsg(TPCANMsg* pTPCMsg)
+{
+        int iRet = LINUX_CAN_Write_Timeout(m_handle, pTPCMsg, c_iTxTimeoutUs); //Timeout in micrsoseconds
 
         if(iRet != CAN_ERR_OK) {
 #ifdef __DEBUG__
                 std::cout << "CANPeakSysUSB::transmitMsg An error occured while sending..." << iRet << std::endl;
                 outputDetailedStatus();
 #endif
-                bRet = false;
+                // the adapter status is only read after a failed write
+                m_bTxError = true;
+                m_Statistics.countError();
+                return false;
         }
 
-#ifdef __DEBUG__
-        //is this necessary? try iRet==CAN_Status(m_handle) ?
-        iRet = CAN_Status(m_handle);
+        m_Statistics.countTx(pTPCMsg->LEN);
+        return true;
+}
+
+//-------------------------------------------
+void CANPeakSysUSB::waitForTxDrained(boost::unique_lock<boost::mutex>& lock)
+{
+        while (!m_TxQueue.empty() || m_bTxBusy)
+                m_TxDrained.wait(lock);
+}
+
+//-------------------------------------------
+bool CANPeakSysUSB::checkTxError()
+{
+        int iRet = CAN_Status(m_handle);
 
         if(iRet < 0)
         {
-                std::cout <<  "CANPeakSysUSB::transmitMsg, system error: " << iRet << std::endl;
-                bRet = false;
-        } else if((iRet & CAN_ERR_BUSOFF) != 0) {
-                std::cout <<  "CANPeakSysUSB::transmitMsg, BUSOFF detected" << std::endl;
-                //Try to restart CAN-Device
-                std::cout <<  "Trying to re-init Hardware..." << std::endl;
-                bRet = initCAN();
+                std::cout <<  "CANPeakSysUSB::checkTxError, system error: " << iRet << std::endl;
+                return false;
+        }
+        else if((iRet & CAN_ERR_BUSOFF) != 0)
+        {
+                // restart the CAN hardware, this used to crash the base when the writes just went on
+                std::cout <<  "CANPeakSysUSB::checkTxError, BUSOFF detected, trying to re-init hardware..." << std::endl;
+                if(initBaudrate() != CAN_ERR_OK)
+                {
+                        std::cout <<  "CANPeakSysUSB::checkTxError, re-init failed" << std::endl;
+                        return false;
+                }
+        }
+        else if((iRet & CAN_ERR_ANYBUSERR) != 0)
+        {
+                std::cout <<  "CANPeakSysUSB::checkTxError, ANYBUSERR" << std::endl;
+        }
+        else if( (iRet & (~CAN_ERR_QRCVEMPTY)) != 0)
+        {
+                std::cout << "CANPeakSysUSB::checkTxError, CAN_STATUS: " << iRet << std::endl;
+        }
 
-        } else if((iRet & CAN_ERR_ANYBUSERR) != 0) {
-                std::cout <<  "CANPeakSysUSB::transmitMsg, ANYBUSERR" << std::endl;
+        m_bTxError = false;
+        return true;
+}
 
-        } else if( (iRet & (~CAN_ERR_QRCVEMPTY)) != 0) {
-                std::cout << "CANPeakSysUSB::transmitMsg, CAN_STATUS: " << iRet << std::endl;
-                bRet = false;
-        }
-#endif
+//-------------------------------------------
+void CANPeakSysUSB::txThread()
+{
+        boost::unique_lock<boost::mutex> lock(m_TxMutex);
+        boost::posix_time::ptime lastCheck = boost::posix_time::min_date_time;
 
-        return bRet;
+        while (!m_bTxShutdown)
+        {
+                // evaluate failed writes here, so neither the callers nor the queued frames wait for a re-init
+                if (m_bTxError && boost::posix_time::microsec_clock::universal_time() - lastCheck
+                        >= boost::posix_time::milliseconds(c_iReinitIntervalMs))
+                {
+                        lastCheck = boost::posix_time::microsec_clock::universal_time();
+                        lock.unlock();
+                        checkTxError();
+                        lock.lock();
+                        continue;
+                }
+
+                if (m_TxQueue.empty())
+                {
+                        if (m_bTxError)
+                                m_TxQueued.timed_wait(lock, boost::posix_time::milliseconds(c_iReinitIntervalMs));
+                        else
+                                m_TxQueued.wait(lock);
+                        continue;
+                }
+
+                // take everything queued so far (usually the frames of one control cycle) and send it back-to-back
+                m_TxBatch.assign(m_TxQueue.begin(), m_TxQueue.end());
+                m_TxQueue.clear();
+                m_Statistics.setTxQueueDepth(0);
+                m_bTxBusy = true;
+                lock.unlock();
+
+                size_t iFailed = 0;
+                for (size_t i = 0; i < m_TxBatch.size(); i++)
+                {
+                        if (!writeMsg(&m_TxBatch[i]))
+                                iFailed++;
+                }
+                if (iFailed > 0)
+                {
+                        std::cout << "CANPeakSysUSB::txThread: " << iFailed << " of " << m_TxBatch.size() << " queued frames could not be sent" << std::endl;
+                }
+
+                lock.lock();
+                m_bTxBusy = false;
+                m_TxDrained.notify_all();
+        }
 }
 
 //-------------------------------------------
@@ -178,18 +319,22 @@ bool CANPeakSysUSB::receiveMsg(CanMsg* pCMsg)
                 pCMsg->setLength(TPCMsg.Msg.LEN);
                 pCMsg->set(TPCMsg.Msg.DATA[0], TPCMsg.Msg.DATA[1], TPCMsg.Msg.DATA[2], TPCMsg.Msg.DATA[3],
                         TPCMsg.Msg.DATA[4], TPCMsg.Msg.DATA[5], TPCMsg.Msg.DATA[6], TPCMsg.Msg.DATA[7]);
+                setRxTime(pCMsg, TPCMsg);
+                m_Statistics.countRx(TPCMsg.Msg.LEN);
                 bRet = true;
         }
         else if( (iRet & (~CAN_ERR_QRCVEMPTY)) != 0) //no"empty-queue"-status
         {
                         std::cout << "CANPeakSysUSB::receiveMsg, CAN_STATUS: " << iRet << std::endl;
                         pCMsg->set(0, 0, 0, 0, 0, 0, 0, 0);
+                        m_Statistics.countError();
         }
 
         //catch status messages, these could be further processed in overlying software to identify and handle CAN errors
         if( TPCMsg.Msg.MSGTYPE == MSGTYPE_STATUS ) {
                 std::cout << "CANPeakSysUSB::receiveMsg, status message catched:\nData is (CAN_ERROR_...) " << TPCMsg.Msg.DATA[3] << std::endl;
                 pCMsg->set(0, 0, 0, 0, 0, 0, 0, 0);
+                m_Statistics.countError();
         }
 
         return bRet;
@@ -236,6 +381,8 @@ bool CANPeakSysUSB::receiveMsgRetry(CanMsg* pCMsg, int iNrOfRetry)
                 pCMsg->setLength(TPCMsg.Msg.LEN);
                 pCMsg->set(TPCMsg.Msg.DATA[0], TPCMsg.Msg.DATA[1], TPCMsg.Msg.DATA[2], TPCMsg.Msg.DATA[3],
                         TPCMsg.Msg.DATA[4], TPCMsg.Msg.DATA[5], TPCMsg.Msg.DATA[6], TPCMsg.Msg.DATA[7]);
+                setRxTime(pCMsg, TPCMsg);
+                m_Statistics.countRx(TPCMsg.Msg.LEN);
         }
 
         return bRet;
@@ -270,6 +417,8 @@ bool CANPeakSysUSB::receiveMsgTimeout(CanMsg* pCMsg, int nMicroSecTimeout)
 	pCMsg->setLength(TPCMsg.Msg.LEN);
 	pCMsg->set(TPCMsg.Msg.DATA[0], TPCMsg.Msg.DATA[1], TPCMsg.Msg.DATA[2], TPCMsg.Msg.DATA[3],
 		    TPCMsg.Msg.DATA[4], TPCMsg.Msg.DATA[5], TPCMsg.Msg.DATA[6], TPCMsg.Msg.DATA[7]);
+	setRxTime(pCMsg, TPCMsg);
+	m_Statistics.countRx(TPCMsg.Msg.LEN);
     }
 
     return bRet;
@@ -279,6 +428,33 @@ bool CANPeakSysUSB::initCAN() {
         int ret = CAN_ERR_OK;
         bool bRet = true;
 
+        ret = initBaudrate();
+
+        if(ret)
+        {
+                std::cout << "CANPeakSysUSB::CANPeakSysUSB(), error in init" << std::endl;
+                m_bInitialized = false;
+                bRet = false;
+        }
+        else
+        {
+                std::cout << "CANPeakSysUSB::CanpeakSys(), init ok" << std::endl;
+                m_bInitialized = true;
+                bRet = true;
+
+                if (!m_TxThread.joinable())
+                {
+                        m_TxBatch.reserve(c_iTxQueueSize);
+                        m_TxThread = boost::thread(&CANPeakSysUSB::txThread, this);
+                }
+        }
+
+        return bRet;
+}
+
+int CANPeakSysUSB::initBaudrate() {
+        int ret = CAN_ERR_OK;
+
         switch(m_iBaudrateVal)
         {
         case CANITFBAUD_1M:
@@ -304,20 +480,7 @@ bool CANPeakSysUSB::initCAN() {
                 break;
         }
 
-        if(ret)
-        {
-                std::cout << "CANPeakSysUSB::CANPeakSysUSB(), error in init" << std::endl;
-                m_bInitialized = false;
-                bRet = false;
-        }
-        else
-        {
-                std::cout << "CANPeakSysUSB::CanpeakSys(), init ok" << std::endl;
-                m_bInitialized = true;
-                bRet = true;
-        }
-
-        return bRet;
+        return ret;
 }
 
 void CANPeakSysUSB::outputDetailedStatus() {
@@ -337,3 +500,12 @@ void CANPeakSysUSB::outputDetailedStatus() {
                         << "\nLast error:    " << diag.nLastError
                         << std::endl;
 }
+
+//-------------------------------------------
+void CANPeakSysUSB::setRxTime(CanMsg* pCMsg, const TPCANRdMsg& TPCMsg)
+{
+        // the driver stamps in ms and us since it was loaded
+        int64_t llDriverTimeNs = (int64_t)TPCMsg.dwTime * 1000000LL + (int64_t)TPCMsg.wUsec * 1000LL;
+
+        pCMsg->setRxTime(m_RxTimeSync.toMonotonic(llDriverTimeNs, CanMsg::getMonotonicTimeNs()));
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+// general includes
+#include <algorithm>
+
+// Headers provided by other cob-packages
+#include <cob_generic_can/CanVirtual.h>
+
+//-----------------------------------------------
+CanVirtualBus& CanVirtualBus::getDefault()
+{
+	static CanVirtualBus bus;
+	return bus;
+}
+
+//-----------------------------------------------
+void CanVirtualBus::attach(CanVirtual* pNode)
+{
+	boost::lock_guard<boost::mutex> lock(m_Mutex);
+	m_vpNodes.push_back(pNode);
+}
+
+//-----------------------------------------------
+void CanVirtualBus::detach(CanVirtual* pNode)
+{
+	boost::lock_guard<boost::mutex> lock(m_Mutex);
+	m_vpNodes.erase(std::remove(m_vpNodes.begin(), m_vpNodes.end(), pNode), m_vpNodes.end());
+}
+
+//-----------------------------------------------
+void CanVirtualBus::deliver(const CanVirtual* pSender, const CanMsg& CMsg)
+{
+	// the lock keeps the nodes attached until the message is queued, the nodes never call back into the bus
+	boost::lock_guard<boost::mutex> lock(m_Mutex);
+	for(size_t i = 0; i < m_vpNodes.size(); i++)
+	{
+		if(m_vpNodes[i] != pSender)
+			m_vpNodes[i]->deliver(CMsg);
+	}
+}
+
+//-----------------------------------------------
+CanVirtual::CanVirtual(CanVirtualBus& bus)
+	: m_Bus(bus)
+{
+	setCanItfType(CAN_DUMMY);
+	m_Bus.attach(this);
+}
+
+//-----------------------------------------------
+CanVirtual::CanVirtual(const char* /*cIniFile*/)
+	: m_Bus(CanVirtualBus::getDefault())
+{
+	setCanItfType(CAN_DUMMY);
+	m_Bus.attach(this);
+	std::cout << "Virtual CAN bus, no hardware is accessed" << std::endl;
+}
+
+//-----------------------------------------------
+CanVirtual::~CanVirtual()
+{
+	m_Bus.detach(this);
+}
+
+//-----------------------------------------------
+bool CanVirtual::transmitMsg(CanMsg CMsg, bool /*bBlocking*/)
+{
+	// the bus has no arbitration delay, the message reaches the other nodes right away
+	CMsg.setRxTimeNow();
+	m_Statistics.countTx(CMsg.m_iLen);
+	m_Bus.deliver(this, CMsg);
+
+	return true;
+}
+
+//-----------------------------------------------
+void CanVirtual::deliver(const CanMsg& CMsg)
+{
+	{
+		boost::lock_guard<boost::mutex> lock(m_RxMutex);
+		if(m_RxQueue.size() >= c_iRxQueueSize)
+		{
+			m_Statistics.countError();
+			return;
+		}
+		m_RxQueue.push_back(CMsg);
+	}
+	m_RxQueued.notify_one();
+}
+
+//-----------------------------------------------
+bool CanVirtual::waitForMsg(boost::unique_lock<boost::mutex>& lock, int nMicroSeconds)
+{
+	boost::system_time timeout = boost::get_system_time() + boost::posix_time::microseconds(nMicroSeconds);
+
+	while(m_RxQueue.empty())
+	{
+		if(!m_RxQueued.timed_wait(lock, timeout))
+			return !m_RxQueue.empty();
+	}
+
+	return true;
+}
+
+//-----------------------------------------------
+void CanVirtual::popMsg(CanMsg* pCMsg)
+{
+	*pCMsg = m_RxQueue.front();
+	m_RxQueue.pop_front();
+
+	m_Statistics.countRx(pCMsg->m_iLen);
+	m_Statistics.addRxLatency(1e-9 * (CanMsg::getMonotonicTimeNs() - pCMsg->getRxTime()));
+}
+
+//-----------------------------------------------
+bool CanVirtual::receiveMsg(CanMsg* pCMsg)
+{
+	boost::lock_guard<boost::mutex> lock(m_RxMutex);
+
+	if(m_RxQueue.empty())
+		return false;
+
+	popMsg(pCMsg);
+	return true;
+}
+
+//-----------------------------------------------
+bool CanVirtual::receiveMsgRetry(CanMsg* pCMsg, int iNrOfRetry)
+{
+	// same retry period as the hardware interfaces
+	return receiveMsgTimeout(pCMsg, iNrOfRetry * 10000);
+}
+
+//-----------------------------------------------
+bool CanVirtual::receiveMsgTimeout(CanMsg* pCMsg, int nMicroSeconds)
+{
+	boost::unique_lock<boost::mutex> lock(m_RxMutex);
+
+	if(!waitForMsg(lock, nMicroSeconds))
+		return false;
+
+	popMsg(pCMsg);
+	return true;
+}
+
+//-----------------------------------------------
+int CanVirtual::receiveMsgs(CanMsg* pCMsgs, int iMaxMsgs, int nMicroSecTimeout)
+{
+	int iNumMsgs = 0;
+	boost::unique_lock<boost::mutex> lock(m_RxMutex);
+
+	if( (iMaxMsgs <= 0) || !waitForMsg(lock, nMicroSecTimeout) )
+		return 0;
+
+	while( (iNumMsgs < iMaxMsgs) && !m_RxQueue.empty() )
+	{
+		popMsg(&pCMsgs[iNumMsgs]);
+		iNumMsgs++;
+	}
+
+	return iNumMsgs;
+}
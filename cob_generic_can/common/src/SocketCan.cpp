@@ -24,21 +24,47 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <algorithm>
+#include <poll.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+namespace
+{
+// socketcan_interface does not expose its socket, which is needed to set the kernel filter
+class FilteredSocketCANInterface : public can::ThreadedSocketCANInterface
+{
+public:
+    int getSocket()
+    {
+        return socket_.native_handle();
+    }
+};
+}
 
 SocketCan::SocketCan(const char* device, int baudrate)
 {
     m_bInitialized = false;
+    m_bTxBusy = false;
+    m_bTxShutdown = false;
+    m_iFdSocket = -1;
 
-    p_cDevice = device;
-    m_handle.reset(new can::ThreadedSocketCANInterface());
+    m_sDevice = device;
+    m_handle.reset(new FilteredSocketCANInterface());
 }
 
 SocketCan::SocketCan(const char* device)
 {
     m_bInitialized = false;
+    m_bTxBusy = false;
+    m_bTxShutdown = false;
+    m_iFdSocket = -1;
 
-    p_cDevice = device;
-    m_handle.reset(new can::ThreadedSocketCANInterface());
+    m_sDevice = device;
+    m_handle.reset(new FilteredSocketCANInterface());
 }
 
 //-----------------------------------------------
@@ -46,22 +72,41 @@ SocketCan::~SocketCan()
 {
     if (m_bInitialized)
     {
+        m_RxListener.reset();
+        {
+            boost::mutex::scoped_lock lock(m_TxMutex);
+            m_bTxShutdown = true;
+        }
+        m_TxQueued.notify_all();
+        m_TxThread.join();
         m_handle->shutdown();
     }
+
+    if (m_iFdSocket >= 0)
+    {
+        close(m_iFdSocket);
+    }
 }
 
 //-----------------------------------------------
 bool SocketCan::init_ret()
 {
     bool ret = true;
-    if (!m_handle->init(p_cDevice, false))
+    if (!m_handle->init(m_sDevice, false))
     {
         print_error(m_handle->getState());
         ret = false;
     }
     else
     {
-        m_reader.listen((boost::shared_ptr<can::CommInterface>) m_handle);
+        m_RxListener = m_handle->createMsgListener(can::CommInterface::FrameDelegate(this, &SocketCan::handleFrame));
+        m_TxBatch.reserve(c_iTxQueueSize);
+        m_TxThread = boost::thread(&SocketCan::txThread, this);
+        openFdSocket();
+        if (!m_viRxFilter.empty())
+        {
+            applyRxFilter();
+        }
         m_bInitialized = true;
         bool bRet = true;
         ret = true;
@@ -83,13 +128,118 @@ void SocketCan::init()
 //-------------------------------------------
 bool SocketCan::transmitMsg(CanMsg CMsg, bool bBlocking)
 {
-    can::Header header(CMsg.getID(), false, false, false);
-    can::Frame message(header, CMsg.getLength());
-    for (int i = 0; i < CMsg.getLength(); i++)
+    return transmitMsgs(&CMsg, 1, bBlocking) == 1;
+}
+
+//-------------------------------------------
+int SocketCan::transmitMsgs(const CanMsg* pCMsgs, int iNumMsgs, bool bBlocking)
+{
+    if (!m_bInitialized)
+    {
+        return 0;
+    }
+
+    boost::unique_lock<boost::mutex> lock(m_TxMutex);
+
+    if (bBlocking)
+    {
+        // keep the order of earlier non-blocking frames, then write directly
+        waitForTxDrained(lock);
+
+        int i = 0;
+        while (i < iNumMsgs && m_handle->send(toFrame(pCMsgs[i])))
+        {
+            m_Statistics.countTx(pCMsgs[i].m_iLen);
+            i++;
+        }
+        return i;
+    }
+
+    // non-blocking: queue as many frames as fit, the caller sees back-pressure in the return value
+    int i = 0;
+    while (i < iNumMsgs && m_TxQueue.size() < c_iTxQueueSize)
+    {
+        m_TxQueue.push_back(toFrame(pCMsgs[i]));
+        i++;
+    }
+    m_Statistics.setTxQueueDepth(m_TxQueue.size());
+    lock.unlock();
+
+    if (i < iNumMsgs)
+    {
+        m_Statistics.countTxOverrun();
+    }
+
+    if (i > 0)
+    {
+        m_TxQueued.notify_one();
+    }
+    return i;
+}
+
+//-------------------------------------------
+can::Frame SocketCan::toFrame(const CanMsg& CMsg)
+{
+    can::Header header(CMsg.m_iID, false, false, false);
+    can::Frame message(header, CMsg.m_iLen);
+    const CanMsg::BYTE* pData = CMsg.getData();
+    for (int i = 0; i < CMsg.m_iLen; i++)
     {
-        message.data[i] = CMsg.getAt(i);
+        message.data[i] = pData[i];
+    }
+    return message;
+}
+
+//-------------------------------------------
+void SocketCan::waitForTxDrained(boost::unique_lock<boost::mutex>& lock)
+{
+    while (!m_TxQueue.empty() || m_bTxBusy)
+    {
+        m_TxDrained.wait(lock);
+    }
+}
+
+//-------------------------------------------
+void SocketCan::txThread()
+{
+    boost::unique_lock<boost::mutex> lock(m_TxMutex);
+
+    while (!m_bTxShutdown)
+    {
+        if (m_TxQueue.empty())
+        {
+            m_TxQueued.wait(lock);
+            continue;
+        }
+
+        // take everything queued so far (usually the frames of one control cycle) and send it back-to-back
+        m_TxBatch.assign(m_TxQueue.begin(), m_TxQueue.end());
+        m_TxQueue.clear();
+        m_Statistics.setTxQueueDepth(0);
+        m_bTxBusy = true;
+        lock.unlock();
+
+        size_t iFailed = 0;
+        for (size_t i = 0; i < m_TxBatch.size(); i++)
+        {
+            if (m_handle->send(m_TxBatch[i]))
+            {
+                m_Statistics.countTx(m_TxBatch[i].dlc);
+            }
+            else
+            {
+                iFailed++;
+            }
+        }
+        if (iFailed > 0)
+        {
+            std::cout << "SocketCan::txThread: " << iFailed << " of " << m_TxBatch.size() << " queued frames could not be sent" << std::endl;
+        }
+
+        lock.lock();
+        m_bTxBusy = false;
+        m_TxDrained.notify_all();
     }
-    return m_handle->send(message);
 }
 
 //-------------------------------------------
@@ -102,13 +252,15 @@ bool SocketCan::receiveMsg(CanMsg* pCMsg)
 
     bool bRet = false;
     can::Frame frame;
+    int64_t llRxTimeNs;
 
-    if (m_reader.read(&frame, boost::chrono::seconds(1)))
+    if (readFrame(&frame, boost::chrono::seconds(1), &llRxTimeNs))
     {
         pCMsg->setID(frame.id);
         pCMsg->setLength(frame.dlc);
         pCMsg->set(frame.data[0], frame.data[1], frame.data[2], frame.data[3],
                    frame.data[4], frame.data[5], frame.data[6], frame.data[7]);
+        pCMsg->setRxTime(llRxTimeNs);
         bRet = true;
     }
     return bRet;
@@ -123,17 +275,19 @@ bool SocketCan::receiveMsgRetry(CanMsg* pCMsg, int iNrOfRetry)
     }
 
     can::Frame frame;
+    int64_t llRxTimeNs;
     bool bRet = false;
     int i = 0;
 
     do
     {
-        if (m_reader.read(&frame, boost::chrono::milliseconds(10)))
+        if (readFrame(&frame, boost::chrono::milliseconds(10), &llRxTimeNs))
         { 
             pCMsg->setID(frame.id);
             pCMsg->setLength(frame.dlc);
             pCMsg->set(frame.data[0], frame.data[1], frame.data[2], frame.data[3],
                        frame.data[4], frame.data[5], frame.data[6], frame.data[7]);
+            pCMsg->setRxTime(llRxTimeNs);
             bRet = true;
             break;
         }
@@ -153,17 +307,241 @@ bool SocketCan::receiveMsgTimeout(CanMsg* pCMsg, int nMicroSecTimeout)
 
     bool bRet = false;
     can::Frame frame;
+    int64_t llRxTimeNs;
 
-    if (m_reader.read(&frame, boost::chrono::microseconds(nMicroSecTimeout)))
+    if (readFrame(&frame, boost::chrono::microseconds(nMicroSecTimeout), &llRxTimeNs))
     {
         pCMsg->setID(frame.id);
         pCMsg->setLength(frame.dlc);
         pCMsg->set(frame.data[0], frame.data[1], frame.data[2], frame.data[3], frame.data[4], frame.data[5], frame.data[6], frame.data[7]);
+        pCMsg->setRxTime(llRxTimeNs);
         bRet = true;
     }
     return bRet;
 }
 
+//-------------------------------------------
+int SocketCan::receiveMsgs(CanMsg* pCMsgs, int iMaxMsgs, int nMicroSecTimeout)
+{
+    if (!m_bInitialized || iMaxMsgs <= 0)
+    {
+        return 0;
+    }
+
+    // the socket is drained by the reader thread, so only the first read waits
+    int iNumMsgs = 0;
+    can::Frame frame;
+    int64_t llRxTimeNs;
+    boost::chrono::microseconds timeout(nMicroSecTimeout);
+
+    while (iNumMsgs < iMaxMsgs && readFrame(&frame, timeout, &llRxTimeNs))
+    {
+        CanMsg& msg = pCMsgs[iNumMsgs++];
+        msg.setID(frame.id);
+        msg.setLength(frame.dlc);
+        msg.setData(frame.data.c_array());
+        msg.setRxTime(llRxTimeNs);
+        timeout = boost::chrono::microseconds(0);
+    }
+    return iNumMsgs;
+}
+
+//-------------------------------------------
+void SocketCan::openFdSocket()
+{
+    int s = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (s < 0)
+    {
+        return;
+    }
+
+    // only devices configured with "fd on" have the CAN-FD MTU
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, m_sDevice.c_str(), IFNAMSIZ - 1);
+    int enable = 1;
+    struct sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+
+    if (ioctl(s, SIOCGIFMTU, &ifr) < 0 || ifr.ifr_mtu != CANFD_MTU
+        || setsockopt(s, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable, sizeof(enable)) < 0
+        || ioctl(s, SIOCGIFINDEX, &ifr) < 0)
+    {
+        close(s);
+        return;
+    }
+
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(s, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        close(s);
+        return;
+    }
+
+    std::cout << "SocketCan: " << m_sDevice << " is CAN-FD capable" << std::endl;
+    m_iFdSocket = s;
+}
+
+//-------------------------------------------
+bool SocketCan::setRxFilter(const std::vector<int>& viIDs)
+{
+    m_viRxFilter = viIDs;
+
+    // applied by init_ret() otherwise
+    if (!m_bInitialized)
+    {
+        return true;
+    }
+
+    return applyRxFilter();
+}
+
+//-------------------------------------------
+bool SocketCan::applyRxFilter()
+{
+    int iSocket = static_cast<FilteredSocketCANInterface*>(m_handle.get())->getSocket();
+    std::vector<struct can_filter> filters(m_viRxFilter.size());
+
+    for (size_t i = 0; i < m_viRxFilter.size(); i++)
+    {
+        // exact match of the 11-bit identifier, extended and RTR frames do not pass
+        filters[i].can_id = m_viRxFilter[i] & CAN_SFF_MASK;
+        filters[i].can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+    }
+
+    if (filters.empty())
+    {
+        // the default filter of a new socket
+        struct can_filter all;
+        all.can_id = 0;
+        all.can_mask = 0;
+        filters.push_back(all);
+    }
+
+    // error frames have their own filter and keep reaching the state handling of socketcan_interface
+    bool bRet = setsockopt(iSocket, SOL_CAN_RAW, CAN_RAW_FILTER, &filters[0], filters.size() * sizeof(struct can_filter)) == 0;
+    if (bRet && m_iFdSocket >= 0)
+    {
+        bRet = setsockopt(m_iFdSocket, SOL_CAN_RAW, CAN_RAW_FILTER, &filters[0], filters.size() * sizeof(struct can_filter)) == 0;
+    }
+
+    if (!bRet)
+    {
+        std::cout << "SocketCan: could not set the receive filter of " << m_sDevice << ": " << strerror(errno) << std::endl;
+    }
+    return bRet;
+}
+
+//-------------------------------------------
+bool SocketCan::transmitFdMsg(const CanFdMsg& CMsg)
+{
+    if (!m_bInitialized || m_iFdSocket < 0)
+    {
+        return false;
+    }
+
+    struct canfd_frame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.can_id = CMsg.m_iID;
+    if ((canid_t)CMsg.m_iID > CAN_SFF_MASK)
+    {
+        frame.can_id = (CMsg.m_iID & CAN_EFF_MASK) | CAN_EFF_FLAG;
+    }
+    frame.len = CMsg.getFrameLength();
+    frame.flags = CMsg.m_bBitRateSwitch ? CANFD_BRS : 0;
+    memcpy(frame.data, CMsg.getData(), CMsg.m_iLen);
+
+    if (write(m_iFdSocket, &frame, CANFD_MTU) != CANFD_MTU)
+    {
+        m_Statistics.countError();
+        return false;
+    }
+
+    m_Statistics.countTx(frame.len);
+    return true;
+}
+
+//-------------------------------------------
+bool SocketCan::receiveFdMsg(CanFdMsg* pCMsg, int nMicroSecTimeout)
+{
+    if (!m_bInitialized || m_iFdSocket < 0)
+    {
+        return false;
+    }
+
+    // the socket also receives the classic frames, they are skipped since socketcan_interface delivers them
+    boost::chrono::steady_clock::time_point deadline = boost::chrono::steady_clock::now() + boost::chrono::microseconds(nMicroSecTimeout);
+    struct pollfd pfd;
+    pfd.fd = m_iFdSocket;
+    pfd.events = POLLIN;
+
+    while (true)
+    {
+        int iTimeoutMs = boost::chrono::duration_cast<boost::chrono::milliseconds>(deadline - boost::chrono::steady_clock::now()).count();
+        if (poll(&pfd, 1, std::max(iTimeoutMs, 0)) <= 0)
+        {
+            return false;
+        }
+
+        struct canfd_frame frame;
+        if (read(m_iFdSocket, &frame, CANFD_MTU) == CANFD_MTU)
+        {
+            pCMsg->m_iID = frame.can_id & ((frame.can_id & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK);
+            pCMsg->m_bBitRateSwitch = (frame.flags & CANFD_BRS) != 0;
+            pCMsg->setData(frame.data, frame.len);
+            m_Statistics.countRx(frame.len);
+            return true;
+        }
+    }
+}
+
+//-------------------------------------------
+void SocketCan::handleFrame(const can::Frame& frame)
+{
+    if (frame.is_error)
+    {
+        m_Statistics.countError();
+        return;
+    }
+
+    RxFrame rx;
+    rx.frame = frame;
+    rx.stamp = boost::chrono::steady_clock::now();
+    {
+        boost::mutex::scoped_lock lock(m_RxMutex);
+        m_RxQueue.push_back(rx);
+    }
+    m_RxQueued.notify_one();
+}
+
+//-------------------------------------------
+bool SocketCan::readFrame(can::Frame* pFrame, const boost::chrono::microseconds& timeout, int64_t* pllRxTimeNs)
+{
+    boost::unique_lock<boost::mutex> lock(m_RxMutex);
+
+    boost::chrono::steady_clock::time_point deadline = boost::chrono::steady_clock::now() + timeout;
+    while (m_RxQueue.empty())
+    {
+        if (m_RxQueued.wait_until(lock, deadline) == boost::cv_status::timeout && m_RxQueue.empty())
+        {
+            return false;
+        }
+    }
+
+    *pFrame = m_RxQueue.front().frame;
+    // steady_clock is CLOCK_MONOTONIC, the frame was stamped by the socketcan_interface thread on arrival
+    *pllRxTimeNs = boost::chrono::duration_cast<boost::chrono::nanoseconds>(m_RxQueue.front().stamp.time_since_epoch()).count();
+    boost::chrono::duration<double> latency = boost::chrono::steady_clock::now() - m_RxQueue.front().stamp;
+    m_RxQueue.pop_front();
+    lock.unlock();
+
+    m_Statistics.countRx(pFrame->dlc);
+    m_Statistics.addRxLatency(latency.count());
+    return true;
+}
+
+//-------------------------------------------
 void SocketCan::print_error(const can::State& state)
 {
     std::string err;
@@ -19,54 +19,48 @@
 #define BREATHCOLORMODE_H
 
 #include <mode.h>
+#include <curveCache.h>
 
 class BreathColorMode : public Mode
 {
 public:
 	BreathColorMode(color::rgba color, int priority = 0, double freq = 0.25, int pulses = 0, double timeout = 0)
-		:Mode(priority, freq, pulses, timeout), _timer_inc(0.0)
+		:Mode(priority, freq, pulses, timeout), _pos(0), _hue_pos(0)
 	{
 		_color = color;
-		h = 0.0;
-		_inc = ((M_PI*2) / UPDATE_RATE_HZ) * _freq;
+		double inc = ((M_PI*2) / UPDATE_RATE_HZ) * _freq;
+
+		//alpha of one breath and the hue circle, hue advances by 0.001 per update
+		size_t steps = std::max((size_t)ceil((M_PI*2) / inc), (size_t)1);
+		_curve = CurveCache::breath(CurveCache::BREATH_SIN, steps);
+		_hues = CurveCache::hues(1000, 1.0);
 	}
 
 	void execute()
 	{
-		float r = 0;
-		float g = 0;
-		float b = 0;
-
-		color::Color::hsv2rgb(h, 1.0, 1.0, r, g, b);
+		color::rgba col = (*_hues)[_hue_pos];
+		col.a = (*_curve)[_pos];
 
-		h += 0.001;
-		if(h > 1.0) h = 0.0;
+		_hue_pos++;
+		if(_hue_pos >= _hues->size()) _hue_pos = 0;
 
-		//double fV = (exp(sin(_timer_inc))-1.0/M_E)*(1.000/(M_E-1.0/M_E));
-		double fV = (exp(sin(_timer_inc))-0.36787944)*0.42545906411;
-
-		_timer_inc += _inc;
-		if(_timer_inc >= M_PI*2)
+		_pos++;
+		if(_pos >= _curve->size())
 		{
-		 	_timer_inc = 0.0;
+		 	_pos = 0;
 		 	_pulsed++;
 		}
 
-		color::rgba col;
-		col.r = r;
-		col.g = g;
-		col.b = b;
-		col.a = fV;
-
 		m_sigColorReady(col);
 	}
 
 	std::string getName(){ return std::string("BreathColorMode"); }
 
 private:
-	double _timer_inc;
-	double _inc;
-	float h;
+	CurveCache::Curve _curve;
+	CurveCache::HueTable _hues;
+	size_t _pos;
+	size_t _hue_pos;
 };
 
 #endif
@@ -19,41 +19,44 @@
 #define BREATHMODE_H
 
 #include <mode.h>
+#include <curveCache.h>
 
 class BreathMode : public Mode
 {
 public:
 	BreathMode(color::rgba color, int priority = 0, double freq = 0.25, int pulses = 0, double timeout = 0)
-		:Mode(priority, freq, pulses, timeout), _timer_inc(0.0)
+		:Mode(priority, freq, pulses, timeout), _pos(0)
 	{
 		_color = color;
 		_init_color = color;
-		_inc = ((M_PI*2) / UPDATE_RATE_HZ) * _freq;
+		double inc = ((M_PI*2) / UPDATE_RATE_HZ) * _freq;
+
+		//alpha of one breath, shared with all modes of the same frequency
+		size_t steps = std::max((size_t)ceil((M_PI*2) / inc), (size_t)1);
+		_curve = CurveCache::breath(CurveCache::BREATH_COS, steps);
 	}
 
 	void execute()
 	{
-		//double fV = (exp(sin(_timer_inc))-1.0/M_E)*(1.000/(M_E-1.0/M_E));
-		double fV = (exp(-cos(_timer_inc))-0.36787944)*0.42545906411;
+		const std::vector<float>& curve = *_curve;
+		float a = curve[_pos] * _init_color.a;
+		_color.a = a > 1 ? 1 : a < 0 ? 0 : a;
 
-		_timer_inc += _inc;
-		if(_timer_inc >= M_PI*2)
+		_pos++;
+		if(_pos >= curve.size())
 		{
-		 	_timer_inc = 0.0;
+		 	_pos = 0;
 		 	_pulsed++;
 		}
 
-		_color.a = fV * _init_color.a;
-		_color.a = _color.a > 1 ? 1 : _color.a < 0 ? 0 : _color.a;
-
 		m_sigColorReady(_color);
 	}
 
 	std::string getName(){ return std::string("BreathMode"); }
 
 private:
-	double _timer_inc;
-	double _inc;
+	CurveCache::Curve _curve;
+	size_t _pos;
 };
 
 #endif
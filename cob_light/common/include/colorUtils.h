@@ -19,7 +19,9 @@
 #define COLOR_UTILS_H
 
 #include <algorithm>
+#include <vector>
 #include <math.h>
+#include <stdint.h>
 
 namespace color
 {
@@ -129,6 +131,94 @@ public:
 
       return result;
     }
+
+    /// Fills the table with fully saturated colors around the hue circle, starting at hue 0.
+    static void hueTable(std::vector<color::rgba> &table, size_t steps, float alpha)
+    {
+      table.resize(std::max(steps, (size_t)1));
+      for(size_t i = 0; i < table.size(); i++)
+      {
+        hsv2rgb((float)i / table.size(), 1.0, 1.0, table[i].r, table[i].g, table[i].b);
+        table[i].a = alpha;
+      }
+    }
+};
+
+/// Precomputed HSV blend between two colors.
+/// The blend position is quantized to 8 bit, which is the resolution of the LED controllers.
+class Gradient
+{
+public:
+  static const int STEPS = 256;
+
+  Gradient() {}
+
+  Gradient(color::rgba start, color::rgba goal)
+  {
+    _table.resize(STEPS);
+    for(int i = 0; i < STEPS; i++)
+      _table[i] = Color::interpolateColor(start, goal, (float)i / (STEPS - 1));
+  }
+
+  /// Returns the blended color at t in [0, 1].
+  const color::rgba& at(float t) const
+  {
+    int i = (int)(t * (STEPS - 1) + 0.5f);
+    return _table[std::min(std::max(i, 0), STEPS - 1)];
+  }
+
+private:
+  std::vector<color::rgba> _table;
+};
+
+/// Output values of a light controller which does not support alpha, for the channels multiplied with alpha.
+/// Built once per device with its value range, inversion and gamma.
+class OutputTable
+{
+public:
+  static const int STEPS = 4096;
+
+  OutputTable() {}
+
+  /// @param max_value output value of a fully lit channel
+  /// @param invert the controller shows max_value as dark and 0 as fully lit
+  /// @param gamma exponent of the channel values, 1.0 keeps them linear
+  OutputTable(int max_value, bool invert, double gamma = 1.0)
+  {
+    _table.resize(STEPS);
+    for(int i = 0; i < STEPS; i++)
+    {
+      double v = pow((double)i / (STEPS - 1), gamma);
+      _table[i] = (uint16_t)((invert ? 1.0 - v : v) * max_value);
+    }
+  }
+
+  /// Returns the output value of a channel multiplied with alpha, in [0, 1].
+  uint16_t at(float v) const
+  {
+    int i = (int)(v * (STEPS - 1) + 0.5f);
+    return _table[std::min(std::max(i, 0), STEPS - 1)];
+  }
+
+  /// Writes the r, g and b output values of the color to out.
+  template<typename T>
+  void encode(const color::rgba& color, T* out) const
+  {
+    out[0] = (T)at(color.r * color.a);
+    out[1] = (T)at(color.g * color.a);
+    out[2] = (T)at(color.b * color.a);
+  }
+
+  /// Writes the r, g and b output values of num colors to out, 3 values per color.
+  template<typename T>
+  void encode(const color::rgba* colors, size_t num, T* out) const
+  {
+    for(size_t i = 0; i < num; i++, out += 3)
+      encode(colors[i], out);
+  }
+
+private:
+  std::vector<uint16_t> _table;
 };
 }
 #endif
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#ifndef CURVECACHE_H
+#define CURVECACHE_H
+
+#include <colorUtils.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <vector>
+#include <math.h>
+
+/// Lookup tables shared by all modes with the same parameters.
+/// A table stays valid as long as a mode holds it, even if the cache was cleared in between.
+class CurveCache
+{
+public:
+	typedef boost::shared_ptr<const std::vector<float> > Curve;
+	typedef boost::shared_ptr<const std::vector<color::rgba> > HueTable;
+
+	enum BreathShape
+	{
+		BREATH_COS,	///< exp(-cos(x)), starts dark
+		BREATH_SIN	///< exp(sin(x)), starts half bright
+	};
+
+	/// Alpha of one breath in the given number of steps, normalized to [0, 1].
+	static Curve breath(BreathShape shape, size_t steps)
+	{
+		Cache<std::pair<int, size_t>, std::vector<float> >& cache = breathCache();
+		boost::mutex::scoped_lock lock(cache.mutex);
+		std::pair<int, size_t> key(shape, steps);
+		std::map<std::pair<int, size_t>, Curve>::iterator itr = cache.entries.find(key);
+		if(itr != cache.entries.end())
+			return itr->second;
+
+		boost::shared_ptr<std::vector<float> > curve(new std::vector<float>(steps));
+		double inc = (M_PI*2) / steps;
+		for(size_t i = 0; i < steps; i++)
+		{
+			double x = (shape == BREATH_COS) ? -cos(i * inc) : sin(i * inc);
+			(*curve)[i] = (exp(x)-0.36787944)*0.42545906411;
+		}
+		cache.insert(key, curve);
+		return curve;
+	}
+
+	/// Hue circle as built by color::Color::hueTable.
+	static HueTable hues(size_t steps, float alpha)
+	{
+		Cache<std::pair<size_t, float>, std::vector<color::rgba> >& cache = hueCache();
+		boost::mutex::scoped_lock lock(cache.mutex);
+		std::pair<size_t, float> key(steps, alpha);
+		std::map<std::pair<size_t, float>, HueTable>::iterator itr = cache.entries.find(key);
+		if(itr != cache.entries.end())
+			return itr->second;
+
+		boost::shared_ptr<std::vector<color::rgba> > table(new std::vector<color::rgba>());
+		color::Color::hueTable(*table, steps, alpha);
+		cache.insert(key, table);
+		return table;
+	}
+
+private:
+	/// Modes are requested with arbitrary parameters, so the number of tables is bounded.
+	static const size_t MAX_ENTRIES = 64;
+
+	template<typename K, typename T>
+	struct Cache
+	{
+		boost::mutex mutex;
+		std::map<K, boost::shared_ptr<const T> > entries;
+
+		void insert(const K& key, const boost::shared_ptr<const T>& value)
+		{
+			if(entries.size() >= MAX_ENTRIES)
+				entries.clear();
+			entries[key] = value;
+		}
+	};
+
+	static Cache<std::pair<int, size_t>, std::vector<float> >& breathCache()
+	{
+		static Cache<std::pair<int, size_t>, std::vector<float> > cache;
+		return cache;
+	}
+
+	static Cache<std::pair<size_t, float>, std::vector<color::rgba> >& hueCache()
+	{
+		static Cache<std::pair<size_t, float>, std::vector<color::rgba> > cache;
+		return cache;
+	}
+};
+
+#endif
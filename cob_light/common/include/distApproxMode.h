@@ -41,43 +41,34 @@ public:
         _inc = (1. / UPDATE_RATE_HZ) * UPDATE_FREQ;
 
         _colors.resize(_num_leds);
+        _sectors.assign(_num_leds, std::numeric_limits<float>::max());
 
         c_red.a = 1; c_red.r = 1; c_red.g = 0; c_red.b = 0;
         c_green.a = 1; c_green.r = 0; c_green.g = 1; c_green.b = 0;
         c_off.a = 0; c_off.r = 0; c_off.g = 0; c_off.b = 0;
         c_default.a = 0.1; c_default.r = 0; c_default.g = 1.0; c_default.b = 0;
+        _gradient = color::Gradient(c_red, c_green);
     }
 
     void scan_callback(const sensor_msgs::LaserScanConstPtr& msg)
     {
+        //only keep the message, the sectors are computed by execute() for the scans which are shown
         boost::mutex::scoped_lock lock(mutex);
-        scan = *msg;
+        scan = msg;
     }
 
     void execute()
     {
         if(_timer_inc >= 1.0)
         {
-            //rotate scan array
             mutex.lock();
-            std::vector<float> ranges = scan.ranges;
+            sensor_msgs::LaserScanConstPtr new_scan = scan;
             mutex.unlock();
-            float sector_size = (float)ranges.size() / (float)_num_leds;
-            std::vector<float> sectors;
-            sectors.assign(_num_leds, 0.0);
 
-            //calculate sector values
-            for(int i = 0; i < _num_leds; i++)
+            if(new_scan && new_scan != _last_scan)
             {
-                float sum = std::numeric_limits<float>::max();
-                //float sum = 0;
-                for(int j = i*(int)sector_size; j < (i+1)*(int)sector_size; j++)
-                {
-                    if(ranges.at(j) != 0){
-                        sum = std::min(ranges.at(j), sum);
-                    }
-                }
-                sectors.at(i) = sum;
+                updateSectors(new_scan->ranges);
+                _last_scan = new_scan;
             }
 
             for(int i = 0; i < _num_leds; i++)
@@ -87,11 +78,11 @@ public:
                 float mean = 0;
                 if(i == 0)
                 {
-                    mean = sectors.back()+sectors.at(i)/2.0f;
+                    mean = (_sectors.back()+_sectors[i])/2.0f;
                 }
                 else
                 {
-                    mean = (sectors.at(i)+sectors.at(i-1))/2.0f;
+                    mean = (_sectors[i]+_sectors[i-1])/2.0f;
                 }
                 if(mean > DIST_MAX)
                 {
@@ -100,7 +91,7 @@ public:
                 else
                 {
                     float t = (boost::algorithm::clamp(mean, DIST_MIN, DIST_MAX) - DIST_MIN)/(DIST_MAX - DIST_MIN);
-                    col = color::Color::interpolateColor(c_red, c_green, t);
+                    col = _gradient.at(t);
                 }
 
                 _colors.at(i) = col;
@@ -120,11 +111,34 @@ public:
     static const double UPDATE_FREQ = 50.0;
 
 private:
+    //minimum range per sector of one LED, 0 ranges are invalid
+    void updateSectors(const std::vector<float>& ranges)
+    {
+        const size_t sector_size = ranges.size() / _num_leds;
+        const float* r = ranges.empty() ? NULL : &ranges[0];
+
+        for(size_t i = 0; i < _num_leds; i++)
+        {
+            float m = std::numeric_limits<float>::max();
+            //branch-free, so the compiler can vectorise the sector
+            for(size_t j = 0; j < sector_size; j++)
+            {
+                const float v = (r[j] != 0.0f) ? r[j] : std::numeric_limits<float>::max();
+                m = std::min(m, v);
+            }
+            _sectors[i] = m;
+            r += sector_size;
+        }
+    }
+
     double _timer_inc;
     double _inc;
     size_t _num_leds;
 
-    sensor_msgs::LaserScan scan;
+    sensor_msgs::LaserScanConstPtr scan;
+    //scan the sectors were computed from, only used by execute()
+    sensor_msgs::LaserScanConstPtr _last_scan;
+    std::vector<float> _sectors;
 
     ros::Subscriber sub_scan;
     boost::mutex mutex;
@@ -132,6 +146,7 @@ private:
     color::rgba c_green;
     color::rgba c_off;
     color::rgba c_default;
+    color::Gradient _gradient;
 };
 
 const float DistApproxMode::DIST_MIN;
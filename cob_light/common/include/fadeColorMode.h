@@ -19,68 +19,49 @@
 #define FADECOLORMODE_H
 
 #include <mode.h>
+#include <curveCache.h>
 
 class FadeColorMode : public Mode
 {
 public:
 	FadeColorMode(color::rgba color, int priority = 0, double freq = 0.25, int pulses = 0, double timeout = 0)
-		:Mode(priority, freq, pulses, timeout)
+		:Mode(priority, freq, pulses, timeout), _count(0)
 	{
 		_color = color;
 
-		doOnce = true;
-		h = 0.0;
-		h_s = 0.0;
-		h_t = 0.0;
+		//precompute one cycle around the hue circle, starting at the hue of the color
+		double inc = (1. / UPDATE_RATE_HZ) * _freq;
+		_hues = CurveCache::hues((size_t)(1. / inc + 0.5), _color.a);
 
-		_inc = (1. / UPDATE_RATE_HZ) * _freq;
+		float h, s, v;
+		color::Color::rgb2hsv(_color.r, _color.g, _color.b, h, s, v);
+		_pos = std::min((size_t)(h * _hues->size()), _hues->size() - 1);
 	}
 
 	void execute()
 	{
-		float r = 0;
-		float g = 0;
-		float b = 0;
-		float s, v;
+		const std::vector<color::rgba>& hues = *_hues;
+		color::rgba col = hues[_pos];
 
-		if(doOnce == true)
-		{
-			color::Color::rgb2hsv(_color.r, _color.g, _color.b, h, s, v);
-			h_s = h;
-			h_t = h;
-			h_s += 1;
-			doOnce = false;
-		}
-
-		color::Color::hsv2rgb(h, 1.0, 1.0, r, g, b);
+		_pos++;
+		if(_pos >= hues.size())
+			_pos = 0;
 
-		h += _inc;
-		h_t += _inc;
-		if(h > 1.0)
-			h = 0.0;
-
-		if(h_t >= h_s)
+		_count++;
+		if(_count >= hues.size())
 		{
-			_pulsed++; h_s+=1;
+			_pulsed++; _count = 0;
 		}
 
-		color::rgba col;
-		col.r = r;
-		col.g = g;
-		col.b = b;
-		col.a = _color.a;
-
 		m_sigColorReady(col);
 	}
 
 	std::string getName(){ return std::string("FadeColorMode"); }
 
 private:
-	bool doOnce;
-	float h;
-	float h_s;
-	float h_t;
-	double _inc;
+	CurveCache::HueTable _hues;
+	size_t _pos;
+	size_t _count;
 };
 
 #endif
@@ -24,50 +24,44 @@ class GlowColorMode : public Mode
 {
 public:
     GlowColorMode(color::rgba color, int priority = 0, double freq = 0.25, int pulses = 0, double timeout = 0)
-        :Mode(priority, freq, pulses, timeout), _timer_inc(0.0)
+        :Mode(priority, freq, pulses, timeout), _timer_inc(0.0), _step(0), _sign(1)
     {
         _color = color;
-        h = 0.0;
         _inc = (1. / UPDATE_RATE_HZ) * _freq;
-        h_inc=0;
+
+        //precompute the colors of all hue offsets the glow swings through
+        float h, s, v;
         color::Color::rgb2hsv(color.r, color.g, color.b, h, s, v);
+        _glow.resize(2 * MAX_STEP + 1);
+        for(int i = -MAX_STEP; i <= MAX_STEP; i++)
+        {
+            double h_inc = 0.001 * i;
+            float h_glow = h + h_inc;
+            if( h_glow < 0)
+                h_glow = 1 + h_glow;
+
+            //double fV = (exp(sin(_timer_inc))-1.0/M_E)*(1.000/(M_E-1.0/M_E));
+            double fV = (exp(sin( (M_PI/2)+h_inc*60 ))-0.36787944)*0.42545906411;
+
+            color::rgba& col = _glow[i + MAX_STEP];
+            color::Color::hsv2rgb(h_glow, s, v, col.r, col.g, col.b);
+            col.a = fV;
+        }
     }
 
     void execute()
     {
-        static int sign = 1;
-        float r = 0;
-        float g = 0;
-        float b = 0;
-
         if(_timer_inc >= 1.0)
         {
-            double tmp = h;
-
-            h_inc += 0.001 * sign;
-            if(h_inc >= 0.01 || h_inc <= -0.01)
+            _step += _sign;
+            if(_step >= MAX_STEP || _step <= -MAX_STEP)
             {
-                sign *= -1;
+                _sign *= -1;
                 _pulsed++;
             }
-            h += h_inc;
-            if( h < 0)
-                h = 1 + h;
-            
-            //double fV = (exp(sin(_timer_inc))-1.0/M_E)*(1.000/(M_E-1.0/M_E));
-            double fV = (exp(sin( (M_PI/2)+h_inc*60 ))-0.36787944)*0.42545906411;
-
-            color::Color::hsv2rgb(h, s, v, r, g, b);
-
-            color::rgba col;
-            col.r = r;
-            col.g = g;
-            col.b = b;
-            col.a = fV;
 
             _timer_inc = 0.0;
-            m_sigColorReady(col);
-            h = tmp;
+            m_sigColorReady(_glow[_step + MAX_STEP]);
         }
         else
             _timer_inc += _inc;
@@ -76,10 +70,14 @@ public:
     std::string getName(){ return std::string("GlowColorMode"); }
 
 private:
+    //hue offset swings between -MAX_STEP and MAX_STEP in steps of 0.001
+    static const int MAX_STEP = 10;
+
     double _timer_inc;
     double _inc;
-    float h, s, v;
-    double h_inc;
+    std::vector<color::rgba> _glow;
+    int _step;
+    int _sign;
 };
 
 #endif
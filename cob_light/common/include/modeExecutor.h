@@ -48,14 +48,33 @@ public:
 private:
 	IColorO* _colorO;
 
+	/// Single render thread, updates the active mode with Mode::UPDATE_RATE_HZ
+	boost::thread _renderThread;
+	/// Protects the active modes, held while a mode is updated
+	boost::mutex _mutex;
+	/// Wakes the render thread, when a mode has been started
+	boost::condition_variable _condRender;
+
 	boost::shared_ptr<Mode> _activeMode;
 	std::map<int, boost::shared_ptr<Mode>, std::greater<int> > _mapActiveModes;
 	color::rgba _activeColor;
 
+	/// Last output of the modes, unchanged colors are not sent again
+	color::rgba _lastColor;
+	std::vector<color::rgba> _lastColors;
+	bool _lastColorValid;
+	bool _lastColorsValid;
+
 	bool _stopRequested;
 	int default_priority;
 
-	void onModeFinishedReceived(int prio);
+	void renderLoop();
+	bool isModeRunning();
+	void invalidateOutput();
+
+	void onModeFinished(int prio);
+	void onModeColorReady(color::rgba color);
+	void onModeColorsReady(std::vector<color::rgba> colors);
 	void onColorSetReceived(color::rgba color);
 };
 
@@ -27,127 +27,96 @@ typedef struct sequence
   double crosstime;
 }seq_t;
 
-enum State{INIT_SEQ,CROSSFADE,HOLD,NEXT,BEGIN};
-
 class SequenceMode : public Mode
 {
 public:
   SequenceMode(std::vector<seq_t> sequences, int priority = 0, double freq = 0.25, int pulses = 0, double timeout = 0)
-    :Mode(priority, freq, pulses, timeout), _init(true), _int_inc(0.0), _int_count(0.0)
+    :Mode(priority, freq, pulses, timeout), _tick(0), _key(0), _firstCycle(true)
   {
     _seqences = sequences;
-    _state = INIT_SEQ;
+    compileTimeline();
   }
 
   void execute()
   {
-    switch (_state)
+    if(_keyframes.empty())
+      return;
+
+    //the first crossfade of the first cycle starts from the color shown before the mode
+    if(_firstCycle && _tick == 0)
+      _intro = color::Gradient(_actualColor, _seqences[0].color);
+
+    while(_tick >= _keyframes[_key].end)
     {
-    case INIT_SEQ:
-      //std::cout<<"INIT_SEQ"<<std::endl;
-      _seqidx = 0;
-      _int_inc = 0.0;
-      _int_count = 0.0;
-      //_color_old = getColor();
-      _int_inc = 1.0/(_seqences[_seqidx].crosstime * UPDATE_RATE_HZ);
-      _state = CROSSFADE;
-      //std::cout<<"Setting color: "<<_seqences[_seqidx].color.r<<" "<<_seqences[_seqidx].color.g<<" "<<_seqences[_seqidx].color.b<<" "<<_seqences[_seqidx].color.a<<std::endl;
-      break;
-
-    case CROSSFADE:
-      //std::cout<<"CROSSFADE"<<std::endl;
-      //first execute cross fade between old and new color for current seq
-      if(_int_count <= 1.0001)
-      {
-        //std::cout<<"_int_count "<<_int_count<<std::endl;
-        _color = interpolateColor(_actualColor, _seqences[_seqidx].color, _int_count);
-        _int_count += _int_inc;
-        m_sigColorReady(_color);
-      }
-      else
+      _key++;
+      if(_key == _keyframes.size())
       {
-        _state = HOLD;
-        _int_count = 0.0;
-        _int_inc = 1.0/(_seqences[_seqidx].holdtime * UPDATE_RATE_HZ);
-        _actualColor = _color;
-        m_sigColorReady(_color);
+        _key = 0;
+        _tick = 0;
+        _firstCycle = false;
       }
-      //calculate
-      break;
-
-    case HOLD:
-      if(_int_count < 1)
-        _int_count += _int_inc;
-      else
-        _state = NEXT;
-      break;
-
-    case NEXT:
-      //std::cout<<"NEXT"<<std::endl;
-      _seqidx++;
-      if(_seqidx == _seqences.size())
-        _seqidx = 0;
-      _int_inc = 0.0;
-      _int_count = 0.0;
-      _int_inc = 1.0/(_seqences[_seqidx].crosstime * UPDATE_RATE_HZ);
-      _state = CROSSFADE;
-      //std::cout<<"Setting color: "<<_seqences[_seqidx].color.r<<" "<<_seqences[_seqidx].color.g<<" "<<_seqences[_seqidx].color.b<<" "<<_seqences[_seqidx].color.a<<std::endl;
-      break;
     }
+
+    const Keyframe& key = _keyframes[_key];
+    const color::Gradient& gradient = (_firstCycle && _key == 0) ? _intro : key.gradient;
+    unsigned int t = _tick - key.start;
+    _tick++;
+
+    //the colors of the crossfade, then the target color once at the beginning of the hold time
+    if(t < key.crosstime)
+      _color = gradient.at((float)t / key.crosstime);
+    else if(t == key.crosstime)
+      _color = gradient.at(1.0f);
+    else
+      return;
+    m_sigColorReady(_color);
   }
 
   std::string getName(){ return std::string("SequenceMode"); }
 
 private:
-  std::vector<seq_t> _seqences;
-  int _seqidx;
-  bool _init;
-  float _int_inc;
-  float _int_count;
-  int _state;
-
-  color::rgba _color;
-
-  color::rgba interpolateColor(color::rgba start, color::rgba goal, float t)
+  //one sequence on the render clock, all times in ticks of UPDATE_RATE_HZ
+  struct Keyframe
+  {
+    unsigned int start;
+    unsigned int crosstime;
+    unsigned int end;
+    //crossfade from the color of the previous sequence
+    color::Gradient gradient;
+  };
+
+  //compiles _seqences into the timeline of one cycle, so the playback only counts ticks
+  void compileTimeline()
   {
-    color::hsv ca;
-    color::hsv cb;
-    color::hsv cr;
-    color::rgba a, b;
-    a = start;
-    b = goal;
-
-    a.r *= a.a;
-    a.g *= a.a;
-    a.b *= a.a;
-    b.r *= b.a;
-    b.g *= b.a;
-    b.b *= b.a;
-    color::Color::rgb2hsv(a.r, a.g, a.b, ca.h, ca.s, ca.v);
-    color::Color::rgb2hsv(b.r, b.g, b.b, cb.h, cb.s, cb.v);
-
-    cr.h = linearInterpolate(ca.h, cb.h, t);
-    cr.s = linearInterpolate(ca.s, cb.s, t);
-    cr.v = linearInterpolate(ca.v, cb.v, t);
-
-    color::rgba result;
-    color::Color::hsv2rgb(cr.h, cr.s, cr.v, result.r, result.g, result.b);
-    result.a = 1.0;
-
-//    std::cout<<"Original h:"<<ca.h<<" s:"<<ca.s<<" v:"<<ca.v<<std::endl;
-//    std::cout<<"Original r:"<<a.r<<" g:"<<a.g<<" b:"<<a.b<<std::endl;
-//    std::cout<<"Goal     h:"<<cb.h<<" s:"<<cb.s<<" v:"<<cb.v<<std::endl;
-//    std::cout<<"Goal     r:"<<b.r<<" g:"<<b.g<<" b:"<<b.b<<std::endl;
-//    std::cout<<"New      h:"<<cr.h<<" s:"<<cr.s<<" v:"<<cr.v<<std::endl;
-//    std::cout<<"New      r:"<<result.r<<" g:"<<result.g<<" b:"<<result.b<<std::endl;
-
-    return result;
+    unsigned int start = 0;
+    _keyframes.resize(_seqences.size());
+    for(size_t i = 0; i < _seqences.size(); i++)
+    {
+      Keyframe& key = _keyframes[i];
+      const seq_t& prev = _seqences[(i + _seqences.size() - 1) % _seqences.size()];
+      key.start = start;
+      key.crosstime = toTicks(_seqences[i].crosstime);
+      //every sequence is shown for at least one tick
+      key.end = start + std::max(key.crosstime + toTicks(_seqences[i].holdtime), 1u);
+      key.gradient = color::Gradient(prev.color, _seqences[i].color);
+      start = key.end;
+    }
   }
 
-  float linearInterpolate(float a, float b, float t)
+  static unsigned int toTicks(double time)
   {
-    return a * (1 - t) + b * t;
+    return (time > 0) ? (unsigned int)(time * UPDATE_RATE_HZ + 0.5) : 0;
   }
+
+  std::vector<seq_t> _seqences;
+  std::vector<Keyframe> _keyframes;
+  //tick within the current cycle and its keyframe
+  unsigned int _tick;
+  size_t _key;
+  bool _firstCycle;
+  color::Gradient _intro;
+
+  color::rgba _color;
 };
 
 #endif
@@ -25,24 +25,41 @@
 #include <termios.h>
 #include <time.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 
 #include <string>
+#include <vector>
 
-#include <concurrentQueue.h>
 #include <boost/thread.hpp>
+#include <ros/time.h>
+
+#include <cob_utilities/SerialIO.h>
 
 typedef struct ioData{
 	const char* buf;
 	size_t len;
 } ioData_t;
 
-class SerialIO
+// statistics of the background writer
+typedef struct ioStatistics{
+	unsigned long frames_written;
+	// frames replaced by a newer one before they were written
+	unsigned long frames_dropped;
+	unsigned long write_errors;
+	// time from enqueueing to the end of the write in s
+	double last_latency;
+	double max_latency;
+} ioStatistics_t;
+
+// Serial connection to the light controller with a background writer,
+// the port itself is handled by the SerialIO of cob_utilities
+class SerialLink
 {
 public:
 	// Constructor
-	SerialIO();
+	SerialLink();
 	// Destructor
-	~SerialIO();
+	~SerialLink();
 
 	// Open Serial Port
 	int openPort(std::string devicestring, int baudrate);
@@ -56,10 +73,14 @@ public:
 	// Read Data from Serial Port
 	int readData(std::string &value, size_t nBytes);
 
+	// Queue frame for the background writer, the data is copied.
+	// A frame that has not been written yet is replaced by the new one.
 	void enqueueData(std::vector<ioData_t> data);
 
 	void enqueueData(const char* data, size_t len);
 
+	ioStatistics_t getStatistics();
+
 	// Check if Serial Port is opened
 	bool isOpen();
 
@@ -72,28 +93,27 @@ public:
 	void stop();
 
 private:
-	//ioQueue
-	ConcurrentQueue<std::vector<struct ioData> > _oQueue;
+	//latest frame not written yet, one buffer per enqueued part
+	std::vector<std::vector<char> > _pendingFrame;
+	bool _framePending;
+	ros::WallTime _pendingSince;
+	ioStatistics_t _statistics;
+	boost::mutex _mutexQueue;
 
 	boost::shared_ptr<boost::thread> _thread;
 	boost::mutex _mutex;
 	boost::condition_variable _condition;
 
-	// filedescriptor
-	int _fd;
-	// serial port settings
-	struct termios port_settings;
+	SerialIO _port;
 	// device string
 	std::string _device_string;
 	// baudrate
 	int _baudrate;
 
-	// resolve int to baudrate
-	speed_t getBaudFromInt(int baud);
-
 	static const int maxUpdateRate = 50;
 
 	void run();
+	int writeFrame(const std::vector<std::vector<char> >& frame);
 };
 
 #endif
@@ -19,14 +19,55 @@
 #include <ros/ros.h>
 
 ModeExecutor::ModeExecutor(IColorO* colorO)
-: _stopRequested(false), default_priority(0)
+: _lastColorValid(false), _lastColorsValid(false), _stopRequested(false), default_priority(0)
 {
 	_colorO = colorO;
 	_colorO->signalColorSet()->connect(boost::bind(&ModeExecutor::onColorSetReceived, this, _1));
+	_renderThread = boost::thread(&ModeExecutor::renderLoop, this);
 }
 
 ModeExecutor::~ModeExecutor()
 {
+	{
+		boost::mutex::scoped_lock lock(_mutex);
+		_stopRequested = true;
+	}
+	_condRender.notify_one();
+	_renderThread.join();
+}
+
+// all modes are updated from this thread, it sleeps while no mode is running
+void ModeExecutor::renderLoop()
+{
+	ros::Rate r(Mode::UPDATE_RATE_HZ);
+	while(!ros::isShuttingDown())
+	{
+		{
+			boost::mutex::scoped_lock lock(_mutex);
+			while(!_stopRequested && !isModeRunning())
+				_condRender.wait(lock);
+			if(_stopRequested)
+				break;
+
+			// only the mode with the highest priority is shown
+			boost::shared_ptr<Mode> mode = _mapActiveModes.begin()->second;
+			if(!mode->tick())
+				onModeFinished(mode->getPriority());
+		}
+		r.sleep();
+	}
+}
+
+bool ModeExecutor::isModeRunning()
+{
+	return _mapActiveModes.size() > 0 && _mapActiveModes.begin()->second->isRunning();
+}
+
+// the color may have been changed from outside, so the next mode output is sent in any case
+void ModeExecutor::invalidateOutput()
+{
+	_lastColorValid = false;
+	_lastColorsValid = false;
 }
 
 uint64_t ModeExecutor::execute(cob_light::LightMode requestedMode)
@@ -42,6 +83,7 @@ uint64_t ModeExecutor::execute(cob_light::LightMode requestedMode)
 uint64_t ModeExecutor::execute(boost::shared_ptr<Mode> mode)
 {
 	uint64_t u_id;
+	boost::mutex::scoped_lock lock(_mutex);
 
 	// check if modes allready executing
 	if(_mapActiveModes.size() > 0)
@@ -66,9 +108,8 @@ uint64_t ModeExecutor::execute(boost::shared_ptr<Mode> mode)
 			}
 		}
 	}
-	mode->signalColorReady()->connect(boost::bind(&IColorO::setColor, _colorO, _1));
-	mode->signalColorsReady()->connect(boost::bind(&IColorO::setColorMulti, _colorO, _1));
-	mode->signalModeFinished()->connect(boost::bind(&ModeExecutor::onModeFinishedReceived, this, _1));
+	mode->signalColorReady()->connect(boost::bind(&ModeExecutor::onModeColorReady, this, _1));
+	mode->signalColorsReady()->connect(boost::bind(&ModeExecutor::onModeColorsReady, this, _1));
 	mode->setActualColor(_activeColor);
 	ROS_DEBUG("Attaching Mode %i with prio: %i freq: %f timeout: %f pulses: %i ",
 		ModeFactory::type(mode.get()), mode->getPriority(), mode->getFrequency(), mode->getTimeout(), mode->getPulses());
@@ -78,7 +119,9 @@ uint64_t ModeExecutor::execute(boost::shared_ptr<Mode> mode)
 	{
 		ROS_DEBUG("Executing Mode %i with prio: %i freq: %f timeout: %f pulses: %i ",
 			ModeFactory::type(mode.get()), mode->getPriority(), mode->getFrequency(), mode->getTimeout(), mode->getPulses());
+		invalidateOutput();
 		_mapActiveModes.begin()->second->start();
+		_condRender.notify_one();
 	}
 	Mode* ptr = mode.get();
 	u_id = reinterpret_cast<uint64_t>( ptr );
@@ -87,6 +130,7 @@ uint64_t ModeExecutor::execute(boost::shared_ptr<Mode> mode)
 
 void ModeExecutor::pause()
 {
+	boost::mutex::scoped_lock lock(_mutex);
 	if(_mapActiveModes.size() > 0)
 	{
 		_mapActiveModes.begin()->second->pause();
@@ -95,12 +139,18 @@ void ModeExecutor::pause()
 
 void ModeExecutor::resume()
 {
+	boost::mutex::scoped_lock lock(_mutex);
 	if(_mapActiveModes.size() > 0 && !_mapActiveModes.begin()->second->isRunning())
+	{
+		invalidateOutput();
 		_mapActiveModes.begin()->second->start();
+		_condRender.notify_one();
+	}
 }
 
 void ModeExecutor::stop()
 {
+	boost::mutex::scoped_lock lock(_mutex);
 	if(_mapActiveModes.size() > 0)
 	{
 		std::map<int, boost::shared_ptr<Mode>, std::greater<int> >::iterator itr;
@@ -115,6 +165,7 @@ void ModeExecutor::stop()
 bool ModeExecutor::stop(uint64_t uId)
 {
 	bool ret = false;
+	boost::mutex::scoped_lock lock(_mutex);
 	if(_mapActiveModes.size() > 0)
 	{
 		std::map<int, boost::shared_ptr<Mode>, std::greater<int> >::iterator itr;
@@ -134,7 +185,9 @@ bool ModeExecutor::stop(uint64_t uId)
 					{
 						ROS_DEBUG("Resume mode: %i with prio %i",
 							ModeFactory::type(_mapActiveModes.begin()->second.get()), _mapActiveModes.begin()->second->getPriority());
+						invalidateOutput();
 						_mapActiveModes.begin()->second->start();
+						_condRender.notify_one();
 					}
 				}
 				ret = true;
@@ -144,7 +197,8 @@ bool ModeExecutor::stop(uint64_t uId)
 	}
 	return ret;
 }
-void ModeExecutor::onModeFinishedReceived(int prio)
+// called from the render thread with the lock held
+void ModeExecutor::onModeFinished(int prio)
 {
 	//check if finished mode is the current active
 	if(_mapActiveModes.begin()->first == prio)
@@ -155,6 +209,7 @@ void ModeExecutor::onModeFinishedReceived(int prio)
 		{
 			ROS_DEBUG("Resume mode: %i with prio %i",
 				ModeFactory::type(_mapActiveModes.begin()->second.get()), _mapActiveModes.begin()->second->getPriority());
+			invalidateOutput();
 			_mapActiveModes.begin()->second->start();
 		}
 	}
@@ -166,6 +221,39 @@ void ModeExecutor::onModeFinishedReceived(int prio)
 	}
 }
 
+// called from the render thread with the lock held
+void ModeExecutor::onModeColorReady(color::rgba color)
+{
+	if(_lastColorValid && color.r == _lastColor.r && color.g == _lastColor.g &&
+		color.b == _lastColor.b && color.a == _lastColor.a)
+		return;
+	_lastColor = color;
+	_lastColorValid = true;
+	_lastColorsValid = false;
+	_colorO->setColor(color);
+}
+
+// called from the render thread with the lock held
+void ModeExecutor::onModeColorsReady(std::vector<color::rgba> colors)
+{
+	if(_lastColorsValid && colors.size() == _lastColors.size())
+	{
+		size_t i = 0;
+		for(; i < colors.size(); i++)
+		{
+			if(colors[i].r != _lastColors[i].r || colors[i].g != _lastColors[i].g ||
+				colors[i].b != _lastColors[i].b || colors[i].a != _lastColors[i].a)
+				break;
+		}
+		if(i == colors.size())
+			return;
+	}
+	_lastColors = colors;
+	_lastColorsValid = true;
+	_lastColorValid = false;
+	_colorO->setColorMulti(colors);
+}
+
 void ModeExecutor::onColorSetReceived(color::rgba color)
 {
   _activeColor = color;
@@ -173,6 +261,7 @@ void ModeExecutor::onColorSetReceived(color::rgba color)
 
 int ModeExecutor::getExecutingMode()
 {
+	boost::mutex::scoped_lock lock(_mutex);
 	if(_mapActiveModes.size() > 0)
 		return ModeFactory::type(_mapActiveModes.begin()->second.get());
 	else
@@ -181,6 +270,7 @@ int ModeExecutor::getExecutingMode()
 
 int ModeExecutor::getExecutingPriority()
 {
+	boost::mutex::scoped_lock lock(_mutex);
 	if(_mapActiveModes.size()>0)
 		return _mapActiveModes.begin()->second->getPriority();
 	else
@@ -189,6 +279,7 @@ int ModeExecutor::getExecutingPriority()
 
 uint64_t ModeExecutor::getExecutingUId()
 {
+	boost::mutex::scoped_lock lock(_mutex);
 	if(_mapActiveModes.size()>0)
 		return reinterpret_cast<uint64_t>(_mapActiveModes.begin()->second.get());
 	else
@@ -19,92 +19,84 @@
 #include "sys/select.h"
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 #include <ros/ros.h>
 
-SerialIO::SerialIO() :
-	 _fd(-1), _device_string(""), _baudrate(9600)
+SerialLink::SerialLink() :
+	 _framePending(false), _device_string(""), _baudrate(9600)
 {
+	std::memset(&_statistics, 0, sizeof(_statistics));
 }
 
-SerialIO::~SerialIO()
+SerialLink::~SerialLink()
 {
 	stop();
 	closePort();
 }
 
 // Open Serial Port
-int SerialIO::openPort(std::string devicestring, int baudrate)
+int SerialLink::openPort(std::string devicestring, int baudrate)
 {
-	if(_fd != -1) return _fd;
+	if(_port.isOpen()) return _port.getDescriptor();
 
 	_device_string = devicestring;
 	_baudrate = baudrate;
 
-	speed_t baud = getBaudFromInt(baudrate);
-	std::memset(&port_settings,0,sizeof(port_settings));
-	port_settings.c_iflag = 0;
-	port_settings.c_oflag = 0;
-	port_settings.c_cflag = CS8|CREAD|CLOCAL;
-	port_settings.c_lflag = 0;
-	port_settings.c_cc[VMIN]=1;
-	port_settings.c_cc[VTIME]=5;
+	_port.setDeviceName(devicestring.c_str());
+	_port.setBaudRate(baudrate);
+	_port.SetFormat(8, SerialIO::PA_NONE, SerialIO::SB_ONE);
+	_port.setHandshake(SerialIO::HS_NONE);
+	//the writer waits for the driver itself, see writeFrame
+	_port.setNonBlocking(true);
+	_port.openIO();
 
-	_fd=open(devicestring.c_str(), O_RDWR | O_NONBLOCK);
-	cfsetospeed(&port_settings, baud);
-	cfsetispeed(&port_settings, baud);
-
-	tcsetattr(_fd, TCSANOW, &port_settings);
-
-	return _fd;
+	return _port.getDescriptor();
 }
 
 // Send Data to Serial Port
-int SerialIO::sendData(std::string value)
+int SerialLink::sendData(std::string value)
 {
 	boost::mutex::scoped_lock lock(_mutex);
 	int wrote = -1;
-	if(_fd != -1)
-		wrote = write(_fd, value.c_str(), value.length());
+	if(_port.isOpen())
+		wrote = _port.writeIO(value.c_str(), value.length());
 	return wrote;
 }
 
 // Send Data to Serial Port
-int SerialIO::sendData(const char* data, size_t len)
+int SerialLink::sendData(const char* data, size_t len)
 {
 	boost::mutex::scoped_lock lock(_mutex);
 	int wrote = -1;
-	if(_fd != -1)
-		wrote = write(_fd, data, len);
+	if(_port.isOpen())
+		wrote = _port.writeIO(data, len);
 	return wrote;
 }
 
 // Read Data from Serial Port
-int SerialIO::readData(std::string &value, size_t nBytes)
+int SerialLink::readData(std::string &value, size_t nBytes)
 {
 	boost::mutex::scoped_lock lock(_mutex);
-	fd_set fds;
-	FD_ZERO(&fds);
-	FD_SET(_fd, &fds);
-	struct timeval timeout = {0, 100000};
 	char buffer[32];
-	size_t rec = -1;
-	if(select(_fd+1, &fds, NULL, NULL, &timeout))
+	int rec = -1;
+	if(_port.isOpen() && _port.waitForData(0.1) > 0)
 	{
-		rec = read(_fd, buffer, nBytes);
-		value = std::string(buffer, rec);
+		rec = _port.readNonBlocking(buffer, std::min(nBytes, sizeof(buffer)));
+		if(rec > 0)
+			value = std::string(buffer, rec);
 	}
 
 	return rec;
 }
 
-void SerialIO::start()
+void SerialLink::start()
 {
 	if(_thread == NULL)
-		_thread.reset(new boost::thread(&SerialIO::run, this));
+		_thread.reset(new boost::thread(&SerialLink::run, this));
 }
 
-void SerialIO::stop()
+void SerialLink::stop()
 {
 	if(_thread != NULL)
 	{
@@ -114,90 +106,146 @@ void SerialIO::stop()
 	}
 }
 
-void SerialIO::run()
+void SerialLink::run()
 {
 	ros::Rate r(maxUpdateRate);
-	std::vector<ioData_t> data;
+	std::vector<std::vector<char> > frame;
+	ros::WallTime enqueued;
 	while(true)
 	{
-		_oQueue.wait_pop(data);
-		for(size_t i = 0; i < data.size(); i++)
-			this->sendData(data[i].buf, data[i].len);
+		{
+			boost::mutex::scoped_lock lock(_mutexQueue);
+			while(!_framePending)
+				_condition.wait(lock);
+			frame.swap(_pendingFrame);
+			enqueued = _pendingSince;
+			_framePending = false;
+		}
+
+		int wrote = writeFrame(frame);
+
+		double latency = (ros::WallTime::now() - enqueued).toSec();
+		{
+			boost::mutex::scoped_lock lock(_mutexQueue);
+			if(wrote < 0)
+				_statistics.write_errors++;
+			else
+				_statistics.frames_written++;
+			_statistics.last_latency = latency;
+			_statistics.max_latency = std::max(_statistics.max_latency, latency);
+		}
 		r.sleep();
 	}
 }
 
-void SerialIO::enqueueData(std::vector<ioData_t> data)
+// writes all parts of the frame with as few system calls as possible
+int SerialLink::writeFrame(const std::vector<std::vector<char> >& frame)
+{
+	boost::mutex::scoped_lock lock(_mutex);
+	if(!_port.isOpen())
+		return -1;
+	const int fd = _port.getDescriptor();
+
+	std::vector<struct iovec> iov;
+	size_t total = 0;
+	for(size_t i = 0; i < frame.size(); i++)
+	{
+		if(frame[i].empty())
+			continue;
+		struct iovec part;
+		part.iov_base = const_cast<char*>(&frame[i][0]);
+		part.iov_len = frame[i].size();
+		iov.push_back(part);
+		total += part.iov_len;
+	}
+
+	size_t wrote = 0;
+	size_t first = 0;
+	while(first < iov.size())
+	{
+		ssize_t ret = writev(fd, &iov[first], iov.size() - first);
+		if(ret < 0)
+		{
+			if(errno != EAGAIN && errno != EINTR)
+				return -1;
+			//port is non blocking, wait until the driver accepts more data
+			fd_set fds;
+			FD_ZERO(&fds);
+			FD_SET(fd, &fds);
+			struct timeval timeout = {0, 100000};
+			if(select(fd+1, NULL, &fds, NULL, &timeout) <= 0)
+				return -1;
+			continue;
+		}
+		wrote += ret;
+		//skip written parts and continue inside a partially written one
+		while(first < iov.size() && (size_t)ret >= iov[first].iov_len)
+		{
+			ret -= iov[first].iov_len;
+			first++;
+		}
+		if(first < iov.size())
+		{
+			iov[first].iov_base = (char*)iov[first].iov_base + ret;
+			iov[first].iov_len -= ret;
+		}
+	}
+	return wrote == total ? (int)wrote : -1;
+}
+
+void SerialLink::enqueueData(std::vector<ioData_t> data)
 {
-	_oQueue.push(data);
+	{
+		boost::mutex::scoped_lock lock(_mutexQueue);
+		if(_framePending)
+			_statistics.frames_dropped++;
+		_pendingFrame.resize(data.size());
+		for(size_t i = 0; i < data.size(); i++)
+			_pendingFrame[i].assign(data[i].buf, data[i].buf + data[i].len);
+		_framePending = true;
+		_pendingSince = ros::WallTime::now();
+	}
+	_condition.notify_one();
 }
 
-void SerialIO::enqueueData(const char* buf, size_t len)
+void SerialLink::enqueueData(const char* buf, size_t len)
 {
 	struct ioData data;
 	data.buf=buf;
 	data.len=len;
 	std::vector<ioData_t> vec;
 	vec.push_back(data);
-	_oQueue.push(vec);
+	enqueueData(vec);
+}
+
+ioStatistics_t SerialLink::getStatistics()
+{
+	boost::mutex::scoped_lock lock(_mutexQueue);
+	return _statistics;
 }
 
 // Check if Serial Port is opened
-bool SerialIO::isOpen()
+bool SerialLink::isOpen()
 {
-	return (_fd != -1);
+	return _port.isOpen();
 }
 
 // Close Serial Port
-void SerialIO::closePort()
+void SerialLink::closePort()
 {
-	if(_fd != -1)
-	{
-		close(_fd);
-		_fd = -1;
-	}
+	_port.closeIO();
 }
 
-bool SerialIO::recover()
+bool SerialLink::recover()
 {
   closePort();
-  if(openPort(_device_string, _baudrate))
+  if(openPort(_device_string, _baudrate) != -1)
   {
     usleep(50000);
-    tcflush(_fd, TCIOFLUSH);
+    _port.purge();
     return true;
   }
   else
     return false;
 }
 
-
-speed_t SerialIO::getBaudFromInt(int baud)
-{
-	speed_t ret;
-	switch(baud)
-	{
-		case 0: 	ret=B0;		break;
-		case 50: 	ret=B50; 	break;
-		case 75: 	ret=B75; 	break;
-		case 110: 	ret=B110;	break;
-		case 134: 	ret=B134;	break;
-		case 150: 	ret=B150;	break;
-		case 200: 	ret=B200;	break;
-		case 300: 	ret=B300;	break;
-		case 1200: 	ret=B1200; 	break;
-		case 1800: 	ret=B1800; 	break;
-		case 2400: 	ret=B2400; 	break;
-		case 4800: 	ret=B4800; 	break;
-		case 9600: 	ret=B9600; 	break;
-		case 19200: ret=B19200; break;
-		case 38400: ret=B38400;	break;
-		case 57600: ret=B57600; break;
-		case 115200: ret=B115200; break;
-		case 230400: ret=B230400; break;
-		default:
-			ret=B230400;
-			break;
-	}
-	return ret;
-}
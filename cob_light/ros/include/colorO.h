@@ -22,12 +22,11 @@
 
 #include <serialIO.h>
 #include <colorUtils.h>
-#include <sstream>
 
 class ColorO : public IColorO
 {
 public:
-  ColorO(SerialIO* serialIO);
+  ColorO(SerialLink* serialIO);
   virtual ~ColorO();
 
   bool init();
@@ -35,8 +34,8 @@ public:
   void setColorMulti(std::vector<color::rgba> &colors);
 
 private:
-  SerialIO* _serialIO;
-  std::stringstream _ssOut;
+  SerialLink* _serialIO;
+  color::OutputTable _output;
 };
 
 #endif
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#ifndef COLOROMULTI_H
+#define COLOROMULTI_H
+
+#include <iColorO.h>
+
+#include <colorUtils.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <vector>
+
+// Drives several light controllers from one ModeExecutor. The LEDs of the
+// outputs are concatenated in the order they were added. Every output is
+// written by its own thread, so a slow serial link does not delay the others
+// and all outputs show the same frame of the render loop.
+class ColorOMulti : public IColorO
+{
+public:
+  ColorOMulti();
+  virtual ~ColorOMulti();
+
+  // takes ownership of the output, call before init()
+  void addOutput(IColorO* colorO);
+  size_t getNumOutputs(){ return _outputs.size(); }
+
+  bool init();
+  void setColor(color::rgba color);
+  void setColorMulti(std::vector<color::rgba> &colors);
+
+private:
+  struct Output
+  {
+    IColorO* colorO;
+    size_t first_led;
+    size_t num_leds;
+    boost::thread thread;
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    //latest frame not written yet, replaced if the output falls behind
+    bool pending;
+    bool multi;
+    color::rgba color;
+    std::vector<color::rgba> colors;
+    bool stop;
+  };
+
+  std::vector<boost::shared_ptr<Output> > _outputs;
+
+  void post(Output& output, const color::rgba& color);
+  void post(Output& output, std::vector<color::rgba>::const_iterator begin, std::vector<color::rgba>::const_iterator end);
+  void run(Output* output);
+};
+
+#endif
@@ -23,6 +23,9 @@
 #include <serialIO.h>
 #include <colorUtils.h>
 #include <ros/ros.h>
+#include <std_msgs/ColorRGBA.h>
+#include <cob_light/ColorRGBAArray.h>
+#include <boost/thread/mutex.hpp>
 
 class ColorOSim : public IColorO
 {
@@ -38,6 +41,16 @@ private:
   ros::NodeHandle* p_nh;
   ros::Publisher _pubSimulation;
   ros::Publisher _pubSimulationMulti;
+
+  //only changed colors are published, at most with the rate of the timer
+  ros::Timer _timer;
+  boost::mutex _mutex;
+  bool _changed;
+  bool _multi;
+  std_msgs::ColorRGBA _color;
+  cob_light::ColorRGBAArray _colors;
+
+  void publish_cb(const ros::TimerEvent&);
 };
 
 #endif
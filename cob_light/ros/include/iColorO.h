@@ -24,7 +24,7 @@
 class IColorO
 {
 public:
-  IColorO() : _initialized(false), _invertMask(0), _num_leds(1){;}
+  IColorO() : _initialized(false), _invertMask(0), _num_leds(1), _gamma(1.0){;}
   virtual ~IColorO(){;}
 
   virtual bool init() = 0;
@@ -33,6 +33,8 @@ public:
 
   void setMask(int mask){ _invertMask = mask; }
   void setNumLeds(size_t num_leds){ _num_leds = num_leds; }
+  //gamma of the output values, applied by the drivers from the next init() on
+  void setGamma(double gamma){ _gamma = gamma; }
   int getNumLeds(){ return _num_leds; }
 
   boost::signals2::signal<void (color::rgba color)>* signalColorSet(){ return &m_sigColorSet; }
@@ -42,6 +44,7 @@ protected:
   bool _initialized;
   int _invertMask;
   int _num_leds;
+  double _gamma;
   boost::signals2::signal<void (color::rgba color)> m_sigColorSet;
   boost::signals2::signal<void (std::vector<color::rgba> colors) > m_sigColorsSet;
 };
@@ -27,7 +27,7 @@
 class MS35 : public IColorO
 {
 public:
-  MS35(SerialIO* serialIO);
+  MS35(SerialLink* serialIO);
   virtual ~MS35();
 
   bool init();
@@ -35,10 +35,14 @@ public:
   void setColorMulti(std::vector<color::rgba> &colors);
 
 private:
-  SerialIO* _serialIO;
+  SerialLink* _serialIO;
   std::stringstream _ssOut;
   static const int PACKAGE_SIZE = 9;
   char buffer[PACKAGE_SIZE];
+  //package last written to the controller, only valid if _sent_valid
+  char _sent_buffer[PACKAGE_SIZE];
+  bool _sent_valid;
+  color::OutputTable _output;
 
   int sendData(const char* data, size_t len);
   unsigned short int getChecksum(const char* data, size_t len);
@@ -23,11 +23,12 @@
 #include <serialIO.h>
 #include <colorUtils.h>
 #include <sstream>
+#include <vector>
 
 class StageProfi : public IColorO
 {
 public:
-  StageProfi(SerialIO* serialIO, unsigned int leds, int led_offset);
+  StageProfi(SerialLink* serialIO, unsigned int leds, int led_offset);
   virtual ~StageProfi();
 
   bool init();
@@ -36,13 +37,18 @@ public:
   void setColorMulti(std::vector<color::rgba> &colors);
 
 private:
-  SerialIO* _serialIO;
+  SerialLink* _serialIO;
   std::stringstream _ssOut;
   int _led_offset;
+  color::OutputTable _output;
   static const unsigned int HEADER_SIZE = 4;
   static const unsigned int MAX_CHANNELS = 255;
 
+  //channel values last written to the controller, empty if unknown
+  std::vector<char> _sent_channels;
+
   bool recover();
+  bool sendChannels(const std::vector<char>& channels);
   bool sendDMX(uint16_t start, const char* buf, unsigned int length);
 };
 
@@ -27,6 +27,7 @@
 #include <actionlib/server/simple_action_server.h>
 #include <diagnostic_msgs/DiagnosticArray.h>
 #include <ros/xmlrpc_manager.h>
+#include <boost/lexical_cast.hpp>
 
 // ros message includes
 #include <std_msgs/ColorRGBA.h>
@@ -49,6 +50,7 @@
 #include <modeExecutor.h>
 #include <colorO.h>
 #include <colorOSim.h>
+#include <colorOMulti.h>
 #include <ms35.h>
 #include <stageprofi.h>
 
@@ -123,6 +125,13 @@ public:
       ROS_WARN("Parameter 'marker_frame' is missing. Using default Value: /base_link");
     _nh.param<std::string>("marker_frame",_sMarkerFrame,"base_link");
 
+    _nh.param<double>("marker_max_rate", _dMarkerMaxRate, 10.0);
+    if(_dMarkerMaxRate <= 0.0)
+    {
+      ROS_WARN("Parameter 'marker_max_rate' must be positive. Using default Value: 10");
+      _dMarkerMaxRate = 10.0;
+    }
+
     if(!_nh.hasParam("sim_enabled"))
       ROS_WARN("Parameter 'sim_enabled' is missing. Using default Value: false");
     _nh.param<bool>("sim_enabled", _bSimEnabled, false);
@@ -155,6 +164,14 @@ public:
     int led_offset;
     _nh.param<int>("led_offset", led_offset, 0);
 
+    //gamma of the output values, 1.0 keeps the channels linear
+    _nh.param<double>("gamma", _gamma, 1.0);
+    if(_gamma <= 0.0)
+    {
+      ROS_WARN("Parameter 'gamma' must be positive. Using default Value: 1.0");
+      _gamma = 1.0;
+    }
+
     //Subscribe to LightController Command Topic
     _sub = _nh.subscribe("command", 1, &LightControl::topicCallback, this);
 
@@ -168,10 +185,16 @@ public:
     _as = new ActionServer(_nh, "set_light", boost::bind(&LightControl::actionCallback, this, _1), false);
     _as->start();
 
-    //Advertise visualization marker topic
-    _pubMarker = _nh.advertise<visualization_msgs::Marker>("marker",1);
+    //Advertise visualization marker topic, latched as it is only published on changes
+    _pubMarker = _nh.advertise<visualization_msgs::Marker>("marker",1,true);
+    _bMarkerChanged = true;
 
-    if(!_bSimEnabled)
+    if(!_bSimEnabled && _nh.hasParam("devices"))
+    {
+      //several light controllers driven by one mode executor
+      ret = initDevices(status);
+    }
+    else if(!_bSimEnabled)
     {
       //open serial port
       ROS_INFO("Open Port on %s",_deviceString.c_str());
@@ -181,13 +204,8 @@ public:
         status.level = 0;
         status.message = "light controller running";
 
-        if(_deviceDriver == "cob_ledboard")
-          p_colorO = new ColorO(&_serialIO);
-        else if(_deviceDriver == "ms-35")
-          p_colorO = new MS35(&_serialIO);
-        else if(_deviceDriver == "stageprofi")
-          p_colorO = new StageProfi(&_serialIO, _num_leds, led_offset);
-        else
+        p_colorO = createColorO(_deviceDriver, &_serialIO, _num_leds, led_offset);
+        if(p_colorO == NULL)
         {
           ROS_ERROR_STREAM("Unsupported devicedriver ["<<_deviceDriver<<"], falling back to sim mode");
           p_colorO = new ColorOSim(&_nh);
@@ -195,6 +213,7 @@ public:
           status.message = "Unsupported devicedriver. Running in simulation mode";
         }
         p_colorO->setMask(_invertMask);
+        p_colorO->setGamma(_gamma);
         if(!p_colorO->init())
         {
           status.level = 3;
@@ -229,7 +248,10 @@ public:
       return false;
 
     if(_bPubMarker)
+    {
       p_colorO->signalColorSet()->connect(boost::bind(&LightControl::markerCallback, this, _1));
+      _marker_timer = _nh.createTimer(ros::Duration(1.0/_dMarkerMaxRate), &LightControl::publish_marker_cb, this);
+    }
 
     p_modeExecutor = new ModeExecutor(p_colorO);
 
@@ -255,6 +277,93 @@ public:
     {
       delete p_colorO;
     }
+    for(size_t i = 0; i < _serialLinks.size(); i++)
+      delete _serialLinks[i];
+  }
+
+  IColorO* createColorO(const std::string& driver, SerialLink* serialIO, int num_leds, int led_offset)
+  {
+    if(driver == "cob_ledboard")
+      return new ColorO(serialIO);
+    else if(driver == "ms-35")
+      return new MS35(serialIO);
+    else if(driver == "stageprofi")
+      return new StageProfi(serialIO, num_leds, led_offset);
+    return NULL;
+  }
+
+  bool initDevices(diagnostic_msgs::DiagnosticStatus& status)
+  {
+    XmlRpc::XmlRpcValue devices;
+    _nh.getParam("devices", devices);
+    ROS_ASSERT(devices.getType() == XmlRpc::XmlRpcValue::TypeArray);
+
+    status.level = 0;
+    ColorOMulti* multi = new ColorOMulti();
+    int total_leds = 0;
+    for(int i = 0; i < devices.size(); i++)
+    {
+      XmlRpc::XmlRpcValue& device = devices[i];
+      ROS_ASSERT(device.getType() == XmlRpc::XmlRpcValue::TypeStruct);
+      std::string driver = device.hasMember("devicedriver") ? static_cast<std::string>(device["devicedriver"]) : _deviceDriver;
+      std::string devicestring = device.hasMember("devicestring") ? static_cast<std::string>(device["devicestring"]) : _deviceString;
+      int baudrate = device.hasMember("baudrate") ? static_cast<int>(device["baudrate"]) : _baudrate;
+      int num_leds = device.hasMember("num_leds") ? static_cast<int>(device["num_leds"]) : 1;
+      int led_offset = device.hasMember("led_offset") ? static_cast<int>(device["led_offset"]) : 0;
+      double gamma = device.hasMember("gamma") ? static_cast<double>(device["gamma"]) : _gamma;
+      total_leds += num_leds;
+
+      ROS_INFO("Open Port on %s",devicestring.c_str());
+      SerialLink* serialIO = new SerialLink();
+      if(serialIO->openPort(devicestring, baudrate) == -1)
+      {
+        ROS_WARN("Serial connection on %s failed, skipping device", devicestring.c_str());
+        status.level = 1;
+        status.message = "Serial connection to some light controllers failed";
+        delete serialIO;
+        continue;
+      }
+      IColorO* colorO = createColorO(driver, serialIO, num_leds, led_offset);
+      if(colorO == NULL)
+      {
+        ROS_ERROR_STREAM("Unsupported devicedriver ["<<driver<<"] on "<<devicestring<<", skipping device");
+        status.level = 1;
+        status.message = "Unsupported devicedriver for some light controllers";
+        delete serialIO;
+        continue;
+      }
+      ROS_INFO("Serial connection on %s succeeded.", devicestring.c_str());
+      colorO->setMask(_invertMask);
+      colorO->setNumLeds(num_leds);
+      colorO->setGamma(gamma);
+      multi->addOutput(colorO);
+      _serialLinks.push_back(serialIO);
+      _serialDevices.push_back(devicestring);
+    }
+
+    if(multi->getNumOutputs() == 0)
+    {
+      ROS_WARN("No light controller could be opened");
+      ROS_WARN("Simulation mode enabled");
+      delete multi;
+      p_colorO = new ColorOSim(&_nh);
+      p_colorO->setNumLeds(total_leds);
+      status.level = 2;
+      status.message = "Serial connections failed. Running in simulation mode";
+      return true;
+    }
+
+    p_colorO = multi;
+    if(status.level == 0)
+      status.message = "light controllers running";
+    if(!p_colorO->init())
+    {
+      status.level = 3;
+      status.message = "Initializing connection to driver failed";
+      ROS_ERROR("Initializing connection to driver failed. Exiting");
+      return false;
+    }
+    return true;
   }
 
   void topicCallback(cob_light::ColorRGBAArray color)
@@ -395,12 +504,60 @@ public:
 
   void publish_diagnostics_cb(const ros::TimerEvent&)
   {
+    if(!_diagnostics.status.empty())
+    {
+      //statistics of the queued serial writers
+      std::vector<diagnostic_msgs::KeyValue>& values = _diagnostics.status[0].values;
+      values.clear();
+      if(_serialIO.isOpen())
+        appendStatistics(values, "", _serialIO);
+      for(size_t i = 0; i < _serialLinks.size(); i++)
+        appendStatistics(values, _serialDevices[i] + " ", *_serialLinks[i]);
+    }
     _diagnostics.header.stamp = ros::Time::now();
     _pubDiagnostic.publish(_diagnostics);
   }
 
+  void appendStatistics(std::vector<diagnostic_msgs::KeyValue>& values, const std::string& prefix, SerialLink& serialIO)
+  {
+    ioStatistics_t stats = serialIO.getStatistics();
+    diagnostic_msgs::KeyValue value;
+    value.key = prefix + "frames_written";
+    value.value = boost::lexical_cast<std::string>(stats.frames_written);
+    values.push_back(value);
+    value.key = prefix + "frames_dropped";
+    value.value = boost::lexical_cast<std::string>(stats.frames_dropped);
+    values.push_back(value);
+    value.key = prefix + "write_errors";
+    value.value = boost::lexical_cast<std::string>(stats.write_errors);
+    values.push_back(value);
+    value.key = prefix + "max_write_latency";
+    value.value = boost::lexical_cast<std::string>(stats.max_latency);
+    values.push_back(value);
+  }
+
   void markerCallback(color::rgba color)
   {
+    boost::mutex::scoped_lock lock(_markerMutex);
+    if(_markerColor.r != color.r || _markerColor.g != color.g || _markerColor.b != color.b || _markerColor.a != color.a)
+    {
+      _markerColor = color;
+      _bMarkerChanged = true;
+    }
+  }
+
+  void publish_marker_cb(const ros::TimerEvent&)
+  {
+    color::rgba color;
+    {
+      boost::mutex::scoped_lock lock(_markerMutex);
+      //keep the change pending until somebody listens
+      if(!_bMarkerChanged || _pubMarker.getNumSubscribers() == 0)
+        return;
+      color = _markerColor;
+      _bMarkerChanged = false;
+    }
+
     visualization_msgs::Marker marker;
     marker.header.frame_id = _sMarkerFrame;
     marker.header.stamp = ros::Time();
@@ -432,8 +589,10 @@ private:
   int _invertMask;
   bool _bPubMarker;
   std::string _sMarkerFrame;
+  double _dMarkerMaxRate;
   bool _bSimEnabled;
   int _num_leds;
+  double _gamma;
 
   int _topic_priority;
 
@@ -447,6 +606,12 @@ private:
   diagnostic_msgs::DiagnosticArray _diagnostics;
   ros::Publisher _pubDiagnostic;
   ros::Timer _diagnostics_timer;
+  ros::Timer _marker_timer;
+
+  //last color of the marker and whether it still has to be published
+  boost::mutex _markerMutex;
+  color::rgba _markerColor;
+  bool _bMarkerChanged;
 
   typedef actionlib::SimpleActionServer<cob_light::SetLightModeAction> ActionServer;
   ActionServer *_as;
@@ -454,7 +619,10 @@ private:
   color::rgba _color;
 
   IColorO* p_colorO;
-  SerialIO _serialIO;
+  SerialLink _serialIO;
+  //serial links of the controllers configured in 'devices'
+  std::vector<SerialLink*> _serialLinks;
+  std::vector<std::string> _serialDevices;
   ModeExecutor* p_modeExecutor;
 
   boost::mutex _mutex;
@@ -17,8 +17,9 @@
 
 #include <colorO.h>
 #include <ros/ros.h>
+#include <stdio.h>
 
-ColorO::ColorO(SerialIO* serialIO)
+ColorO::ColorO(SerialLink* serialIO)
 {
   _serialIO = serialIO;
 }
@@ -29,6 +30,9 @@ ColorO::~ColorO()
 
 bool ColorO::init()
 {
+  //led board value spektrum is from 0 - 999.
+  //at r@w's led strip, 0 means fully lighted and 999 light off(_invertMask)
+  _output = color::OutputTable(999, _invertMask != 0, _gamma);
   return true;
 }
 
@@ -41,25 +45,16 @@ void ColorO::setColor(color::rgba color)
 {
   int bytes_wrote = 0;
 
-  color::rgba color_tmp = color;
-
-  //calculate rgb spektrum for spezific alpha value, because
+  //the table holds the rgb spektrum for the alpha value, because
   //led board is not supporting alpha values
-  color.r *= color.a;
-  color.g *= color.a;
-  color.b *= color.a;
-  //led board value spektrum is from 0 - 999.
-  //at r@w's led strip, 0 means fully lighted and 999 light off(_invertMask)
-  color.r = (fabs(_invertMask-color.r) * 999.0);
-  color.g = (fabs(_invertMask-color.g) * 999.0);
-  color.b = (fabs(_invertMask-color.b) * 999.0);
+  uint16_t values[3];
+  _output.encode(color, values);
 
-  _ssOut.clear();
-  _ssOut.str("");
-  _ssOut << (int)color.r << " " << (int)color.g << " " << (int)color.b << "\n\r";
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "%d %d %d\n\r", values[0], values[1], values[2]);
 
   // send data over serial port
-  bytes_wrote = _serialIO->sendData(_ssOut.str());
+  bytes_wrote = _serialIO->sendData(buf, len);
   if(bytes_wrote == -1)
   {
     ROS_WARN("Can not write to serial port. Port closed!");
@@ -67,7 +62,7 @@ void ColorO::setColor(color::rgba color)
   else
   {
     ROS_DEBUG("Wrote [%s] with %i bytes from %i bytes", \
-              _ssOut.str().c_str(), bytes_wrote, (int)_ssOut.str().length());
-    m_sigColorSet(color_tmp);
+              buf, bytes_wrote, len);
+    m_sigColorSet(color);
   }
 }
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#include <colorOMulti.h>
+#include <ros/ros.h>
+#include <algorithm>
+
+ColorOMulti::ColorOMulti()
+{
+  _num_leds = 0;
+}
+
+ColorOMulti::~ColorOMulti()
+{
+  for(size_t i = 0; i < _outputs.size(); i++)
+  {
+    Output& output = *_outputs[i];
+    {
+      boost::mutex::scoped_lock lock(output.mutex);
+      output.stop = true;
+    }
+    output.cond.notify_one();
+    if(output.thread.joinable())
+      output.thread.join();
+    delete output.colorO;
+  }
+}
+
+void ColorOMulti::addOutput(IColorO* colorO)
+{
+  boost::shared_ptr<Output> output(new Output());
+  output->colorO = colorO;
+  output->first_led = _num_leds;
+  output->num_leds = colorO->getNumLeds();
+  output->pending = false;
+  output->multi = false;
+  output->stop = false;
+  _outputs.push_back(output);
+  _num_leds += output->num_leds;
+}
+
+bool ColorOMulti::init()
+{
+  bool ret = true;
+  for(size_t i = 0; i < _outputs.size(); i++)
+  {
+    if(!_outputs[i]->colorO->init())
+    {
+      ROS_ERROR("Initializing light output %lu failed", i);
+      ret = false;
+    }
+  }
+  if(!ret)
+    return false;
+
+  for(size_t i = 0; i < _outputs.size(); i++)
+    _outputs[i]->thread = boost::thread(&ColorOMulti::run, this, _outputs[i].get());
+  _initialized = true;
+  return true;
+}
+
+void ColorOMulti::setColor(color::rgba color)
+{
+  for(size_t i = 0; i < _outputs.size(); i++)
+    post(*_outputs[i], color);
+  m_sigColorSet(color);
+}
+
+void ColorOMulti::setColorMulti(std::vector<color::rgba> &colors)
+{
+  if(colors.empty())
+    return;
+
+  //every output gets its part of the frame
+  for(size_t i = 0; i < _outputs.size(); i++)
+  {
+    Output& output = *_outputs[i];
+    if(output.first_led >= colors.size())
+      break;
+    size_t end = std::min(colors.size(), output.first_led + output.num_leds);
+    post(output, colors.begin() + output.first_led, colors.begin() + end);
+  }
+  m_sigColorSet(colors[0]);
+}
+
+void ColorOMulti::post(Output& output, const color::rgba& color)
+{
+  {
+    boost::mutex::scoped_lock lock(output.mutex);
+    output.color = color;
+    output.multi = false;
+    output.pending = true;
+  }
+  output.cond.notify_one();
+}
+
+void ColorOMulti::post(Output& output, std::vector<color::rgba>::const_iterator begin, std::vector<color::rgba>::const_iterator end)
+{
+  {
+    boost::mutex::scoped_lock lock(output.mutex);
+    //single color controllers only show the first LED of their part
+    if(output.num_leds <= 1)
+    {
+      output.color = *begin;
+      output.multi = false;
+    }
+    else
+    {
+      output.colors.assign(begin, end);
+      output.multi = true;
+    }
+    output.pending = true;
+  }
+  output.cond.notify_one();
+}
+
+void ColorOMulti::run(Output* output)
+{
+  color::rgba color;
+  std::vector<color::rgba> colors;
+  bool multi;
+
+  while(true)
+  {
+    {
+      boost::mutex::scoped_lock lock(output->mutex);
+      while(!output->pending && !output->stop)
+        output->cond.wait(lock);
+      if(output->stop)
+        break;
+      multi = output->multi;
+      if(multi)
+        colors.swap(output->colors);
+      else
+        color = output->color;
+      output->pending = false;
+    }
+
+    //the serial write and the acknowledge of the controller happen outside the lock
+    if(multi)
+      output->colorO->setColorMulti(colors);
+    else
+      output->colorO->setColor(color);
+  }
+}
@@ -15,18 +15,29 @@
  */
 
 #include <colorOSim.h>
-#include <std_msgs/ColorRGBA.h>
-#include <cob_light/ColorRGBAArray.h>
 
 ColorOSim::ColorOSim(ros::NodeHandle* nh)
 {
   p_nh = nh;
-  _pubSimulation = p_nh->advertise<std_msgs::ColorRGBA>("debug",2);
-  _pubSimulationMulti = p_nh->advertise<cob_light::ColorRGBAArray>("debugMulti", 2);
+  _changed = true;
+  _multi = false;
+  //latched, the state is only published on changes
+  _pubSimulation = p_nh->advertise<std_msgs::ColorRGBA>("debug", 2, true);
+  _pubSimulationMulti = p_nh->advertise<cob_light::ColorRGBAArray>("debugMulti", 2, true);
+
+  double max_rate;
+  p_nh->param<double>("debug_max_rate", max_rate, 10.0);
+  if(max_rate <= 0.0)
+  {
+    ROS_WARN("Parameter 'debug_max_rate' must be positive. Using default Value: 10");
+    max_rate = 10.0;
+  }
+  _timer = p_nh->createTimer(ros::Duration(1.0/max_rate), &ColorOSim::publish_cb, this);
 }
 
 ColorOSim::~ColorOSim()
 {
+  _timer.stop();
 }
 
 bool ColorOSim::init()
@@ -36,29 +47,66 @@ bool ColorOSim::init()
 
 void ColorOSim::setColor(color::rgba color)
 {
-  std_msgs::ColorRGBA _color;
-  _color.r = color.r;
-  _color.g = color.g;
-  _color.b = color.b;
-  _color.a = color.a;
-
-  _pubSimulation.publish(_color);
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    if(_multi || _color.r != color.r || _color.g != color.g || _color.b != color.b || _color.a != color.a)
+    {
+      _color.r = color.r;
+      _color.g = color.g;
+      _color.b = color.b;
+      _color.a = color.a;
+      _multi = false;
+      _changed = true;
+    }
+  }
   m_sigColorSet(color);
 }
 
 void ColorOSim::setColorMulti(std::vector<color::rgba> &colors)
 {
-  std_msgs::ColorRGBA color;
-  cob_light::ColorRGBAArray colorMsg;
-  for(size_t i = 0; i < colors.size(); ++i)
+  if(colors.empty())
+    return;
+
   {
-    color.r = colors[i].r;
-    color.g = colors[i].g;
-    color.b = colors[i].b;
-    color.a = colors[i].a;
-    colorMsg.colors.push_back(color);
+    boost::mutex::scoped_lock lock(_mutex);
+    bool changed = !_multi || _colors.colors.size() != colors.size();
+    _colors.colors.resize(colors.size());
+    for(size_t i = 0; i < colors.size(); ++i)
+    {
+      std_msgs::ColorRGBA& color = _colors.colors[i];
+      if(color.r != colors[i].r || color.g != colors[i].g || color.b != colors[i].b || color.a != colors[i].a)
+      {
+        color.r = colors[i].r;
+        color.g = colors[i].g;
+        color.b = colors[i].b;
+        color.a = colors[i].a;
+        changed = true;
+      }
+    }
+    _multi = true;
+    _changed = _changed || changed;
   }
-
-  _pubSimulationMulti.publish(colorMsg);
   m_sigColorSet(colors[0]);
 }
+
+void ColorOSim::publish_cb(const ros::TimerEvent&)
+{
+  boost::mutex::scoped_lock lock(_mutex);
+  if(!_changed)
+    return;
+
+  //keep the change pending until somebody listens
+  if(_multi)
+  {
+    if(_pubSimulationMulti.getNumSubscribers() == 0)
+      return;
+    _pubSimulationMulti.publish(_colors);
+  }
+  else
+  {
+    if(_pubSimulation.getNumSubscribers() == 0)
+      return;
+    _pubSimulation.publish(_color);
+  }
+  _changed = false;
+}
@@ -21,7 +21,8 @@
 #include <boost/cstdint.hpp>
 #include <boost/integer.hpp>
 
-MS35::MS35(SerialIO* serialIO)
+MS35::MS35(SerialLink* serialIO)
+  : _sent_valid(false)
 {
   _serialIO = serialIO;
 }
@@ -33,11 +34,13 @@ MS35::~MS35()
 bool MS35::init()
 {
   bool ret = false;
+  _output = color::OutputTable(255, false, _gamma);
   const char init_data[] = { 0xfd, 0xfd, 0xfd, 0xfd, 0xfd, 0xfd, 0xfd, 0xfd, 0xfd };
   int init_len = sizeof(init_data) / sizeof(init_data[0]);
   const char startup_data[] = { 0xfd, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
   int startup_len = sizeof(startup_data) / sizeof(startup_data[0]);
   char init_buf[18];
+  _sent_valid = false;
 
   //write data until controller is ready to receive valid package
   char tmp = 0xfd;
@@ -91,27 +94,32 @@ void MS35::setColor(color::rgba color)
 {
   color::rgba color_tmp = color;
 
-  //calculate rgb spektrum for spezific alpha value, because
-  //led board is not supporting alpha values
-  color.r *= color.a;
-  color.g *= color.a;
-  color.b *= color.a;
-
-  //shift values into 8 bit rgb space
-  color.r = fabs(color.r * 255);
-  color.g = fabs(color.g * 255);
-  color.b = fabs(color.b * 255);
-
   buffer[0] = 0x01; buffer[1] = 0x00;
-  buffer[2] = (int)color.r; buffer[3]=(int)color.g; buffer[4]=(int)color.b;
+  //8 bit rgb values for the alpha value from the table, because
+  //led board is not supporting alpha values
+  _output.encode(color, (unsigned char*)&buffer[2]);
   buffer[5] = 0x00; buffer[6]=0x00;
 
+  //the led is still showing this color
+  if(_sent_valid && memcmp(buffer, _sent_buffer, 7) == 0)
+  {
+    m_sigColorSet(color_tmp);
+    return;
+  }
+
   unsigned short int crc = getChecksum(buffer, 7);
   buffer[7] = ((char*)&crc)[1];
   buffer[8] = ((char*)&crc)[0];
   
   if(sendData(buffer, PACKAGE_SIZE) == PACKAGE_SIZE)
+  {
+    memcpy(_sent_buffer, buffer, PACKAGE_SIZE);
+    _sent_valid = true;
     m_sigColorSet(color_tmp);
+  }
   else
+  {
+    _sent_valid = false;
     ROS_ERROR("Could not write to serial port");
+  }
 }
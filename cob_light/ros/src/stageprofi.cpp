@@ -21,7 +21,7 @@
 #include <boost/integer.hpp>
 #include <algorithm>
 
-StageProfi::StageProfi(SerialIO* serialIO, unsigned int leds, int led_offset)
+StageProfi::StageProfi(SerialLink* serialIO, unsigned int leds, int led_offset)
 {
   _serialIO = serialIO;
   _num_leds = leds;
@@ -35,12 +35,14 @@ StageProfi::~StageProfi()
 bool StageProfi::init()
 {
   bool ret = false;
+  _output = color::OutputTable(255, false, _gamma);
   const char init_data[] = { 'C', '?' };
   int init_len = sizeof(init_data) / sizeof(init_data[0]);
 
   char init_buf[2];
 
   memcpy(&init_buf, init_data, init_len);
+  _sent_channels.clear();
   if (_serialIO->sendData(init_buf, 2) == 2)
   {
     std::string rec;
@@ -54,89 +56,96 @@ bool StageProfi::init()
 
 void StageProfi::setColor(color::rgba color)
 {
-  color::rgba color_tmp = color;
-
-  color_tmp.r *= color.a;
-  color_tmp.g *= color.a;
-  color_tmp.b *= color.a;
-
-  color_tmp.r = fabs(color_tmp.r * 255);
-  color_tmp.g = fabs(color_tmp.g * 255);
-  color_tmp.b = fabs(color_tmp.b * 255);
+  unsigned char rgb[3];
+  _output.encode(color, rgb);
 
   unsigned int num_channels = _num_leds * 3;
-  char channelbuffer[num_channels];
+  std::vector<char> channelbuffer(num_channels);
 
   for (int i = 0; i < _num_leds; i++)
   {
-    channelbuffer[i * 3] = (int) color_tmp.r;
-    channelbuffer[i * 3 + 1] = (int) color_tmp.g;
-    channelbuffer[i * 3 + 2] = (int) color_tmp.b;
+    channelbuffer[i * 3] = rgb[0];
+    channelbuffer[i * 3 + 1] = rgb[1];
+    channelbuffer[i * 3 + 2] = rgb[2];
   }
 
-  uint16_t index = 0;
-  while (index < num_channels)
+  if (!sendChannels(channelbuffer))
   {
-    unsigned int size = std::min((unsigned int) MAX_CHANNELS,
-        num_channels - index);
-    if (sendDMX(index, channelbuffer + index, size))
-      index += size;
-    else
-    {
-      ROS_ERROR("Sending color to stageprofi failed");
-      this->recover();
-      break;
-    }
+    ROS_ERROR("Sending color to stageprofi failed");
+    this->recover();
   }
   m_sigColorSet(color);
 }
 
 void StageProfi::setColorMulti(std::vector<color::rgba> &colors)
 {
-  color::rgba color_tmp;
   unsigned int num_channels = _num_leds * 3;
-  char channelbuffer[num_channels];
+  std::vector<char> channelbuffer(num_channels, 0);
 
-  std::vector<color::rgba> color_out = colors;
-  //shift lex index by offset
-  if(_led_offset != 0)
+  //led i shows the color at i + _led_offset, so the colors are encoded in two parts
+  //which wrap around at the end of the frame
+  size_t num = std::min(colors.size(), (size_t)_num_leds);
+  if(num > 0)
   {
-    if(_led_offset > 0)
-      std::rotate(color_out.begin(), color_out.begin()+_led_offset, color_out.end());
-    else
-      std::rotate(color_out.begin(), color_out.begin()+color_out.size()+_led_offset, color_out.end());
+    int size = colors.size();
+    size_t first = ((_led_offset % size) + size) % size;
+    size_t num_head = std::min(num, colors.size() - first);
+    char* out = &channelbuffer[0];
+    _output.encode(&colors[first], num_head, out);
+    _output.encode(&colors[0], num - num_head, out + num_head * 3);
   }
 
-  for (int i = 0; i < _num_leds || i < colors.size(); i++)
+  if (!sendChannels(channelbuffer))
   {
-    color_tmp.r = color_out[i].r * color_out[i].a;
-    color_tmp.g = color_out[i].g * color_out[i].a;
-    color_tmp.b = color_out[i].b * color_out[i].a;
-
-    color_tmp.r = fabs(color_tmp.r * 255);
-    color_tmp.g = fabs(color_tmp.g * 255);
-    color_tmp.b = fabs(color_tmp.b * 255);
-
-    channelbuffer[i * 3] = (int) color_tmp.r;
-    channelbuffer[i * 3 + 1] = (int) color_tmp.g;
-    channelbuffer[i * 3 + 2] = (int) color_tmp.b;
+    ROS_ERROR("Sending color to stageprofi failed");
+    this->recover();
   }
+  m_sigColorSet(colors[0]);
+}
 
-  uint16_t index = 0;
+// only writes the channels that changed since the last call, neighbouring
+// changes are sent as one block if that is cheaper than an additional header
+bool StageProfi::sendChannels(const std::vector<char>& channels)
+{
+  bool ret = true;
+  bool all_dirty = _sent_channels.size() != channels.size();
+  unsigned int num_channels = channels.size();
+
+  unsigned int index = 0;
   while (index < num_channels)
   {
-    unsigned int size = std::min((unsigned int) MAX_CHANNELS,
-        num_channels - index);
-    if (sendDMX(index, channelbuffer + index, size))
-      index += size;
-    else
+    //find start of next dirty block
+    while (!all_dirty && index < num_channels && channels[index] == _sent_channels[index])
+      index++;
+    if (index >= num_channels)
+      break;
+
+    //extend block while the gap to the next change is smaller than a header
+    unsigned int end = index + 1;
+    unsigned int last_dirty = index;
+    while (end < num_channels && end - index < MAX_CHANNELS)
+    {
+      if (all_dirty || channels[end] != _sent_channels[end])
+        last_dirty = end;
+      else if (end - last_dirty > HEADER_SIZE)
+        break;
+      end++;
+    }
+
+    unsigned int size = last_dirty + 1 - index;
+    if (!sendDMX(index, &channels[index], size))
     {
-      ROS_ERROR("Sending color to stageprofi failed");
-      this->recover();
+      ret = false;
       break;
     }
+    index += size;
   }
-  m_sigColorSet(colors[0]);
+
+  if (ret)
+    _sent_channels = channels;
+  else
+    _sent_channels.clear();
+  return ret;
 }
 
 bool StageProfi::sendDMX(uint16_t start, const char* buf, unsigned int length)
@@ -29,6 +29,12 @@
 #include <vlc/vlc.h>
 #include <unistd.h>
 
+#include <map>
+#include <list>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+
 #include <boost/thread.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/random/mersenne_twister.hpp>
@@ -40,7 +46,7 @@ class Mimic
 public:
     Mimic():
         as_mimic_(nh_, ros::this_node::getName() + "/set_mimic", boost::bind(&Mimic::as_cb_mimic_, this, _1), false),
-        new_mimic_request_(false), sim_enabled_(false), real_dist_(2,10), int_dist_(0,6)
+        sim_enabled_(false), new_mimic_request_(false), end_reached_(false), real_dist_(2,10), int_dist_(0,6)
     {
         nh_ = ros::NodeHandle("~");
     }
@@ -49,15 +55,19 @@ public:
     {
         libvlc_media_player_stop(vlc_player_);
         libvlc_media_player_release(vlc_player_);
+        for(std::map<std::string, Clip>::iterator it = clips_.begin(); it != clips_.end(); ++it)
+            if(it->second.media != NULL)
+                libvlc_media_release(it->second.media);
         libvlc_release(vlc_inst_);
     }
 
     bool init()
     {
-        if(!copy_mimic_files())
-            return false;
-
         sim_enabled_ = nh_.param<bool>("sim", false);
+        // the player keeps using the previous clip until the next one is set, so at least two clips are cached
+        max_cached_clips_ = std::max(2, nh_.param<int>("max_cached_clips", 8));
+        // hardware decoder for libavcodec: any, vaapi, vdpau or none (software decoding)
+        std::string hw_decoding = "--avcodec-hw=" + nh_.param<std::string>("hw_decoding", "any");
         srvServer_mimic_ = nh_.advertiseService("set_mimic", &Mimic::service_cb_mimic, this);
 
         random_mimics_.push_back("blinking");
@@ -80,7 +90,8 @@ public:
             "--no-video-title-show",
             "--no-skip-frames",
             "--no-audio",
-            "--vout=glx,none"
+            "--vout=glx,none",
+            hw_decoding.c_str()
         };
         int argc = sizeof( argv ) / sizeof( *argv );
 
@@ -88,6 +99,14 @@ public:
         vlc_player_ = libvlc_media_player_new(vlc_inst_);
         if(!sim_enabled_)
             libvlc_set_fullscreen(vlc_player_, 1);
+
+        libvlc_event_manager_t* events = libvlc_media_player_event_manager(vlc_player_);
+        libvlc_event_attach(events, libvlc_MediaPlayerEndReached, &Mimic::vlc_event_cb, this);
+        libvlc_event_attach(events, libvlc_MediaPlayerEncounteredError, &Mimic::vlc_event_cb, this);
+
+        if(!load_mimic_files())
+            return false;
+
         set_mimic("default", 1, 1.0, false);
         blinking_timer_ = nh_.createTimer(ros::Duration(real_dist_(gen_)), &Mimic::blinking_cb, this, true);
         as_mimic_.start();
@@ -103,57 +122,163 @@ private:
 
     libvlc_instance_t* vlc_inst_;
     libvlc_media_player_t* vlc_player_;
-    libvlc_media_t* vlc_media_;
+
+    // mimic clip, loaded into memory on first use. The media is reused for every play
+    struct Clip
+    {
+        std::string path;
+        std::string data;
+        libvlc_media_t* media;  // NULL while the clip is not loaded
+        std::list<std::string>::iterator lru_pos;
+    };
+    std::map<std::string, Clip> clips_;
+    // names of the loaded clips, most recently used first
+    std::list<std::string> lru_clips_;
+    int max_cached_clips_;
+
+    // read position of one open of a clip by vlc
+    struct ClipReader
+    {
+        const Clip* clip;
+        size_t pos;
+    };
 
     bool sim_enabled_;
     bool new_mimic_request_;
     boost::mutex mutex_;
 
+    // set by the vlc event thread when the current clip is over
+    bool end_reached_;
+    boost::mutex event_mutex_;
+    boost::condition_variable event_cond_;
+
     boost::random::mt19937 gen_;
     boost::random::uniform_real_distribution<> real_dist_;
     boost::random::uniform_int_distribution<> int_dist_;
     std::vector<std::string> random_mimics_;
 
-    bool copy_mimic_files()
+    bool load_mimic_files()
     {
-        char *lgn;
-        if((lgn = getlogin()) == NULL)
+        namespace fs = boost::filesystem;
+        // the files are used in place, the folder may also contain symlinks to the clips
+        mimic_folder_ = nh_.param<std::string>("mimic_folder", ros::package::getPath("cob_mimic") + "/common");
+        ROS_INFO("indexing mimic files in %s...", mimic_folder_.c_str());
+
+        try
         {
-            lgn = getenv("USER");
-            if(lgn == NULL || std::string(lgn) == "")
+            if(!fs::exists(mimic_folder_) || !fs::is_directory(mimic_folder_))
             {
-                ROS_ERROR("unable to get user name");
+                ROS_ERROR_STREAM("Mimic directory " << mimic_folder_ << " does not exist or is not a directory.");
                 return false;
             }
-        }
-        std::string username(lgn);
-        mimic_folder_ = "/tmp/mimic_" + username;
-        ROS_INFO("copying all mimic files to %s...", mimic_folder_.c_str());
-        std::string pkg_path = ros::package::getPath("cob_mimic");
-        std::string mimics_path = pkg_path + "/common";
-
-        try{
-            if(boost::filesystem::exists(mimic_folder_))
+            for(fs::directory_iterator file(mimic_folder_); file != fs::directory_iterator(); ++file)
             {
-                boost::filesystem::remove_all(mimic_folder_);
+                fs::path current(file->path());
+                if(fs::is_directory(current) || current.extension().string() != ".mp4")
+                    continue;
+
+                Clip& clip = clips_[current.stem().string()];
+                clip.path = current.string();
+                clip.media = NULL;
             }
         }
-        catch(boost::filesystem::filesystem_error const & e)
+        catch(fs::filesystem_error const & e)
         {
             ROS_ERROR_STREAM(std::string(e.what()));
             return false;
         }
 
-        if(copy_dir(boost::filesystem::path(mimics_path), boost::filesystem::path(mimic_folder_)) )
+        ROS_INFO("...found %zu mimic files", clips_.size());
+        return !clips_.empty();
+    }
+
+    // loads the clip if needed and marks it as most recently used.
+    // Evicts the least recently used clips beyond max_cached_clips_
+    bool load_clip(std::map<std::string, Clip>::iterator clip)
+    {
+        if(clip->second.media != NULL)
         {
-            ROS_INFO("...copied all mimic files to %s", mimic_folder_.c_str());
+            lru_clips_.splice(lru_clips_.begin(), lru_clips_, clip->second.lru_pos);
             return true;
         }
-        else
+
+#if LIBVLC_VERSION_INT >= LIBVLC_VERSION(3, 0, 0, 0)
+        std::ifstream in(clip->second.path.c_str(), std::ios::binary);
+        if(!in)
         {
-            ROS_ERROR("...could not copy mimic files to %s", mimic_folder_.c_str());
+            ROS_ERROR("Could not read %s", clip->second.path.c_str());
             return false;
         }
+        clip->second.data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        clip->second.media = libvlc_media_new_callbacks(vlc_inst_, &Mimic::clip_open_cb, &Mimic::clip_read_cb,
+                                                        &Mimic::clip_seek_cb, &Mimic::clip_close_cb, &clip->second);
+#else
+        // no memory input before libvlc 3, keep at least the parsed media
+        clip->second.media = libvlc_media_new_path(vlc_inst_, clip->second.path.c_str());
+#endif
+        if(clip->second.media == NULL)
+        {
+            ROS_ERROR("Could not create media for %s", clip->second.path.c_str());
+            std::string().swap(clip->second.data);
+            return false;
+        }
+        lru_clips_.push_front(clip->first);
+        clip->second.lru_pos = lru_clips_.begin();
+
+        // the clip played before is the second most recently used one and stays loaded
+        while(lru_clips_.size() > static_cast<size_t>(max_cached_clips_))
+        {
+            Clip& evicted = clips_[lru_clips_.back()];
+            ROS_DEBUG("unloading mimic %s", lru_clips_.back().c_str());
+            libvlc_media_release(evicted.media);
+            evicted.media = NULL;
+            std::string().swap(evicted.data);
+            lru_clips_.pop_back();
+        }
+        return true;
+    }
+
+    static int clip_open_cb(void* opaque, void** datap, uint64_t* sizep)
+    {
+        ClipReader* reader = new ClipReader;
+        reader->clip = static_cast<const Clip*>(opaque);
+        reader->pos = 0;
+        *datap = reader;
+        *sizep = reader->clip->data.size();
+        return 0;
+    }
+
+    static ssize_t clip_read_cb(void* opaque, unsigned char* buf, size_t len)
+    {
+        ClipReader* reader = static_cast<ClipReader*>(opaque);
+        size_t n = std::min(len, reader->clip->data.size() - reader->pos);
+        memcpy(buf, reader->clip->data.data() + reader->pos, n);
+        reader->pos += n;
+        return n;
+    }
+
+    static int clip_seek_cb(void* opaque, uint64_t offset)
+    {
+        ClipReader* reader = static_cast<ClipReader*>(opaque);
+        if(offset > reader->clip->data.size())
+            return -1;
+        reader->pos = offset;
+        return 0;
+    }
+
+    static void clip_close_cb(void* opaque)
+    {
+        delete static_cast<ClipReader*>(opaque);
+    }
+
+    static void vlc_event_cb(const libvlc_event_t* event, void* userdata)
+    {
+        Mimic* mimic = static_cast<Mimic*>(userdata);
+        {
+            boost::mutex::scoped_lock lock(mimic->event_mutex_);
+            mimic->end_reached_ = true;
+        }
+        mimic->event_cond_.notify_all();
     }
 
     void as_cb_mimic_(const cob_mimic::SetMimicGoalConstPtr &goal)
@@ -184,19 +309,29 @@ private:
 
     bool set_mimic(std::string mimic, int repeat, float speed, bool blocking=true)
     {
-        bool ret = false;
-        new_mimic_request_=true;
+        {
+            boost::mutex::scoped_lock lock(event_mutex_);
+            new_mimic_request_=true;
+        }
+        event_cond_.notify_all();
         ROS_INFO("New mimic request with: %s", mimic.c_str());
         mutex_.lock();
-        new_mimic_request_=false;
+        {
+            boost::mutex::scoped_lock lock(event_mutex_);
+            new_mimic_request_=false;
+        }
         ROS_INFO("Mimic: %s (speed: %f, repeat: %d)", mimic.c_str(), speed, repeat);
 
-        std::string filename = mimic_folder_ + "/" + mimic + ".mp4";
-
         // check if mimic exists
-        if ( !boost::filesystem::exists(filename) )
+        std::map<std::string, Clip>::iterator clip = clips_.find(mimic);
+        if (clip == clips_.end())
+        {
+            ROS_ERROR("File not found: %s", (mimic_folder_ + "/" + mimic + ".mp4").c_str());
+            mutex_.unlock();
+            return false;
+        }
+        if (!load_clip(clip))
         {
-            ROS_ERROR("File not found: %s", filename.c_str());
             mutex_.unlock();
             return false;
         }
@@ -215,27 +350,27 @@ private:
 
         while(repeat > 0)
         {
-            vlc_media_ = libvlc_media_new_path(vlc_inst_, filename.c_str());
+            {
+                boost::mutex::scoped_lock lock(event_mutex_);
+                end_reached_ = false;
+            }
+            libvlc_media_player_set_media(vlc_player_, clip->second.media);
+            libvlc_media_player_play(vlc_player_);
 
-            if (vlc_media_ != NULL)
+            if(blocking)
             {
-                libvlc_media_player_set_media(vlc_player_, vlc_media_);
-                libvlc_media_release(vlc_media_);
-                libvlc_media_player_play(vlc_player_);
-                ros::Duration(0.1).sleep();
-                while(blocking && (libvlc_media_player_is_playing(vlc_player_) == 1))
+                boost::mutex::scoped_lock lock(event_mutex_);
+                while(!end_reached_ && !new_mimic_request_)
+                    event_cond_.wait(lock);
+                if(new_mimic_request_)
                 {
-                    ros::Duration(0.1).sleep();
-                    ROS_DEBUG("still playing %s", mimic.c_str());
-                    if(new_mimic_request_)
-                    {
-                        ROS_WARN("mimic %s preempted", mimic.c_str());
-                        mutex_.unlock();
-                        return false;
-                    }
+                    ROS_WARN("mimic %s preempted", mimic.c_str());
+                    lock.unlock();
+                    mutex_.unlock();
+                    return false;
                 }
-                repeat --;
             }
+            repeat --;
         }
         mutex_.unlock();
         return true;
@@ -247,62 +382,6 @@ private:
         set_mimic(random_mimics_[rand], 1, 1.5);
         blinking_timer_ = nh_.createTimer(ros::Duration(real_dist_(gen_)), &Mimic::blinking_cb, this, true);
     }
-
-    bool copy_dir( boost::filesystem::path const & source,
-            boost::filesystem::path const & mimic_folder )
-    {
-        namespace fs = boost::filesystem;
-        try
-        {
-            // Check whether the function call is valid
-            if(!fs::exists(source) || !fs::is_directory(source))
-            {
-                ROS_ERROR_STREAM("Source directory " << source.string() << " does not exist or is not a directory.");
-                             ;
-                return false;
-            }
-            if(fs::exists(mimic_folder))
-            {
-                ROS_INFO_STREAM("Destination directory " << mimic_folder.string() << " already exists.");
-                return false;
-            }
-            // Create the mimic_folder directory
-            if(!fs::create_directory(mimic_folder))
-            {
-                ROS_ERROR_STREAM( "Unable to create mimic_folder directory" << mimic_folder.string());
-                return false;
-            }
-        }
-        catch(fs::filesystem_error const & e)
-        {
-            ROS_ERROR_STREAM(std::string(e.what()));
-            return false;
-        }
-        // Iterate through the source directory
-        for(fs::directory_iterator file(source); file != fs::directory_iterator(); ++file)
-        {
-            try
-            {
-                fs::path current(file->path());
-                if(fs::is_directory(current))
-                {
-                    // Found directory: Recursion
-                    if( !copy_dir(current, mimic_folder / current.filename()) )
-                        return false;
-                }
-                else
-                {
-                    // Found file: Copy
-                    fs::copy_file(current, mimic_folder / current.filename() );
-                }
-            }
-            catch(fs::filesystem_error const & e)
-            {
-                ROS_ERROR_STREAM(std::string(e.what()));
-            }
-        }
-        return true;
-    }
 };
 
 
@@ -38,7 +38,7 @@ class Mimic:
 
   def set_mimic(self, mimic, speed, repeat):
       rospy.loginfo("Mimic: %s", mimic)
-      file_location = '/tmp/mimic/' + mimic + '.mp4'
+      file_location = self.mimic_folder + '/' + mimic + '.mp4'
       if(not os.path.isfile(file_location)):
         rospy.logerror("File not found: %s", file_location)
         return False
@@ -48,19 +48,19 @@ class Mimic:
 
       for i in range(0, repeat):
         rospy.loginfo("Repeat: %s, Mimic: %s", repeat, mimic)
-        command = "export DISPLAY=:0 && vlc --video-wallpaper --video-filter 'rotate{angle=%d}' --vout glx --one-instance --playlist-enqueue --no-video-title-show --rate %f  %s  vlc://quit"  % (self.rotation, speed, file_location)
+        command = "export DISPLAY=:0 && vlc --video-wallpaper --video-filter 'rotate{angle=%d}' --vout glx --avcodec-hw %s --one-instance --playlist-enqueue --no-video-title-show --rate %f  %s  vlc://quit"  % (self.rotation, self.hw_decoding, speed, file_location)
         os.system(command)
 
       return True
 
   def defaultMimic(self):
-    file_location = '/tmp/mimic/' + self.default_mimic + '.mp4'
+    file_location = self.mimic_folder + '/' + self.default_mimic + '.mp4'
     if not os.path.isfile(file_location):
       rospy.logerror("File not found: %s", file_location)
       return
 
     while not rospy.is_shutdown():
-      command = "export DISPLAY=:0 && vlc --video-wallpaper --video-filter 'rotate{angle=%d}' --vout glx --loop --one-instance --playlist-enqueue --no-video-title-show --rate %f  %s  vlc://quit"  % (self.rotation, self.default_speed, file_location)
+      command = "export DISPLAY=:0 && vlc --video-wallpaper --video-filter 'rotate{angle=%d}' --vout glx --avcodec-hw %s --loop --one-instance --playlist-enqueue --no-video-title-show --rate %f  %s  vlc://quit"  % (self.rotation, self.hw_decoding, self.default_speed, file_location)
       os.system(command)
 
   def main(self):
@@ -68,12 +68,11 @@ class Mimic:
     self.default_mimic = "default"
     self.rotation = rospy.get_param('~rotation', 0)
 
-    # copy all videos to /tmp
-    rospy.loginfo("copying all mimic files to /tmp/mimic...")
-    file_location = roslib.packages.get_pkg_dir('cob_mimic') + '/common/*.mp4'
-    os.system("mkdir -p /tmp/mimic")
-    os.system("cp " + file_location + " /tmp/mimic")
-    rospy.loginfo("...copied all mimic files to /tmp/mimic")
+    # hardware decoder for libavcodec: any, vaapi, vdpau or none (software decoding)
+    self.hw_decoding = rospy.get_param('~hw_decoding', 'any')
+    # the videos are played in place, the folder may also contain symlinks to the videos
+    self.mimic_folder = rospy.get_param('~mimic_folder', roslib.packages.get_pkg_dir('cob_mimic') + '/common')
+    rospy.loginfo("playing mimic files from %s", self.mimic_folder)
 
     self._ss = rospy.Service('~set_mimic', SetMimic, self.service_cb)
     self._as = actionlib.SimpleActionServer('~set_mimic', cob_mimic.msg.SetMimicAction, execute_cb=self.action_cb, auto_start = False)
@@ -28,7 +28,9 @@
 
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <map>
+#include <vector>
 
 class PhidgetIKROS: public PhidgetIK
 {
@@ -36,6 +38,10 @@ public:
 	PhidgetIKROS(ros::NodeHandle nh, int serial_num, std::string board_name, XmlRpc::XmlRpcValue* sensor_params, SensingMode mode);
 	~PhidgetIKROS();
 
+	// waits for the board opened by the constructor and reads its configuration, false if it did not attach in time
+	auto start(int timeout) -> bool;
+	auto update() -> void;
+
 private:
 	ros::NodeHandle _nh;
 	ros::Publisher _pubAnalog;
@@ -47,6 +53,8 @@ private:
 
 	int _serial_num;
 	std::string _board_name;
+	XmlRpc::XmlRpcValue _sensorParams;
+	bool _hasSensorParams;
 
 	struct OutputCompare
 	{
@@ -58,6 +66,18 @@ private:
 	OutputCompare _outputChanged;
 	std::mutex _mutex;
 
+	// per channel sampling settings, reapplied when the board reattaches (-1 keeps the board default)
+	struct SensorConfig
+	{
+		int data_rate;
+		int change_trigger;
+	};
+	std::map<int, SensorConfig> _sensorConfig;
+	std::mutex _configMutex;
+
+	// change handlers run in the Phidget thread, they publish only once the name maps are complete
+	std::atomic<bool> _ready;
+
 	std::map<int, std::string> _indexNameMapAnalog;
 	std::map<std::string, int> _indexNameMapAnalogRev;
 	std::map<int, std::string> _indexNameMapDigitalIn;
@@ -67,9 +87,23 @@ private:
 	std::map<int, std::string>::iterator _indexNameMapItr;
 	std::map<std::string, int>::iterator _indexNameMapRevItr;
 
-	auto readParams(XmlRpc::XmlRpcValue* sensor_params) -> void;
+	// uri of each channel index, built once by readParams
+	std::vector<std::string> _urisAnalog;
+	std::vector<std::string> _urisDigitalIn;
+	std::vector<std::string> _urisDigitalOut;
 
-	auto update() -> void;
+	// messages reused by update, only states, values and stamps change
+	cob_phidgets::DigitalSensor _msgDigital;	// inputs followed by outputs
+	cob_phidgets::AnalogSensor _msgAnalog;
+	// single channel messages reused by the change handlers (Phidget thread)
+	cob_phidgets::DigitalSensor _msgDigitalEvent;
+	cob_phidgets::DigitalSensor _msgDigitalOutEvent;
+	cob_phidgets::AnalogSensor _msgAnalogEvent;
+
+	auto readParams(XmlRpc::XmlRpcValue* sensor_params) -> void;
+	auto buildMessages() -> void;
+	auto applySensorConfig(int index, const SensorConfig& config) -> void;
+	auto lookupName(const std::vector<std::string>& uris, int index) const -> const std::string&;
 
 	auto attachHandler() -> int;
 	auto detachHandler() -> int;
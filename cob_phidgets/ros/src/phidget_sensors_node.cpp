@@ -19,6 +19,9 @@
 #include <cob_phidgets/phidget_manager.h>
 #include <cob_phidgets/phidgetik_ros.h>
 
+#include <algorithm>
+#include <chrono>
+
 int main(int argc, char **argv)
 {
 	//init ros
@@ -26,7 +29,9 @@ int main(int argc, char **argv)
 
 	int freq;
 	std::string update_mode;
-	std::vector<std::shared_ptr<Phidget>> phidgets;
+	int attach_timeout;
+	bool warm_start;
+	std::vector<std::shared_ptr<PhidgetIKROS>> phidgets;
 	ros::NodeHandle nodeHandle;
 	ros::NodeHandle nh("~");
 	std::map<int, std::pair<std::string, XmlRpc::XmlRpcValue> > phidget_params_map;
@@ -35,6 +40,8 @@ int main(int argc, char **argv)
 	//get default params from server
 	nh.param<int>("frequency",freq, 30);
 	nh.param<std::string>("update_mode", update_mode, "polling");
+	nh.param<int>("attach_timeout", attach_timeout, 10000);
+	nh.param<bool>("warm_start", warm_start, true);
 
 	//get board params from server
 	XmlRpc::XmlRpcValue phidget_params;
@@ -67,10 +74,23 @@ int main(int argc, char **argv)
 		ROS_WARN("No params for the phidget boards on the Paramserver using default name/port values");
 	}
 
-	//look for attached devices
-	PhidgetManager* manager = new PhidgetManager();
-	auto devices = manager->getAttachedDevices();
-	delete manager;
+	//serials of the last successful start, restarts open them directly instead of enumerating all devices
+	std::vector<int> serials;
+	std::vector<int> cached_serials;
+	if(warm_start && nh.getParam("attached_serials", cached_serials) && !cached_serials.empty())
+	{
+		ROS_INFO("Warm start with %zu cached boards, skipping device enumeration", cached_serials.size());
+		serials = cached_serials;
+	}
+	else
+	{
+		//look for attached devices
+		PhidgetManager* manager = new PhidgetManager();
+		auto devices = manager->getAttachedDevices();
+		delete manager;
+		for(auto& device : devices)
+			serials.push_back(device.serial_num);
+	}
 
 	//set the update method
 	PhidgetIK::SensingMode sensMode;
@@ -85,26 +105,42 @@ int main(int argc, char **argv)
 	}
 
 	//if no devices attached exit
-	if(devices.size() > 0)
+	if(serials.size() > 0)
 	{
-		//loop over all found devices and init them
-		for(auto& device : devices)
+		//open all devices at once, they attach in parallel
+		for(int serial_num : serials)
 		{
-			phidget_params_map_itr = phidget_params_map.find(device.serial_num);
+			phidget_params_map_itr = phidget_params_map.find(serial_num);
 			XmlRpc::XmlRpcValue *sensors_param = (phidget_params_map_itr != phidget_params_map.end()) ? &((*phidget_params_map_itr).second.second) : nullptr;
 			std::string name;
 			if(sensors_param != nullptr)
 				name = (*phidget_params_map_itr).second.first;
 			else
 			{
-				ROS_WARN("Could not find parameters for Board with serial: %d. Using default params!", device.serial_num);
-				std::stringstream ss; ss << device.serial_num;
+				ROS_WARN("Could not find parameters for Board with serial: %d. Using default params!", serial_num);
+				std::stringstream ss; ss << serial_num;
 				name = ss.str();
 			}
 			phidgets.push_back(
-				std::make_shared<PhidgetIKROS>(nodeHandle, device.serial_num, name, sensors_param, sensMode));
+				std::make_shared<PhidgetIKROS>(nodeHandle, serial_num, name, sensors_param, sensMode));
+		}
+
+		//wait for all of them with one common deadline
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(attach_timeout);
+		bool all_attached = true;
+		for(auto& phidget : phidgets)
+		{
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if(!phidget->start(std::max<int>(remaining, 1)))
+				all_attached = false;
 		}
 
+		//a board missing from the cache is only found by a full enumeration, so the cache is dropped on failure
+		if(all_attached)
+			nh.setParam("attached_serials", serials);
+		else
+			nh.deleteParam("attached_serials");
+
 		ros::Rate loop_rate(freq);
 		while (ros::ok())
 		{
@@ -18,7 +18,7 @@
 #include <cob_phidgets/phidgetik_ros.h>
 
 PhidgetIKROS::PhidgetIKROS(ros::NodeHandle nh, int serial_num, std::string board_name, XmlRpc::XmlRpcValue* sensor_params, SensingMode mode)
-	:PhidgetIK(mode), _nh(nh), _serial_num(serial_num), _board_name(board_name)
+	:PhidgetIK(mode), _nh(nh), _serial_num(serial_num), _board_name(board_name), _hasSensorParams(false), _ready(false)
 {
 	ros::NodeHandle tmpHandle("~");
 	ros::NodeHandle nodeHandle(tmpHandle, board_name);
@@ -34,15 +34,35 @@ PhidgetIKROS::PhidgetIKROS(ros::NodeHandle nh, int serial_num, std::string board
 	_srvDataRate = nodeHandle.advertiseService("set_data_rate", &PhidgetIKROS::setDataRateCallback, this);
 	_srvTriggerValue = nodeHandle.advertiseService("set_trigger_value", &PhidgetIKROS::setTriggerValueCallback, this);
 
+	if(sensor_params != nullptr)
+	{
+		_sensorParams = *sensor_params;
+		_hasSensorParams = true;
+	}
+
+	//the board attaches in the background, start() waits for it
 	if(init(_serial_num) != EPHIDGET_OK)
 	{
 		ROS_ERROR("Error open Phidget Board on serial %d. Message: %s",_serial_num, this->getErrorDescription(this->getError()).c_str());
 	}
-	if(waitForAttachment(10000) != EPHIDGET_OK)
+}
+
+auto PhidgetIKROS::start(int timeout) -> bool
+{
+	bool attached = true;
+	if(waitForAttachment(timeout) != EPHIDGET_OK)
 	{
-		ROS_ERROR("Error waiting for Attachment. Message: %s",this->getErrorDescription(this->getError()).c_str());
+		ROS_ERROR("Error waiting for Attachment of board %s. Message: %s", _board_name.c_str(), this->getErrorDescription(this->getError()).c_str());
+		attached = false;
 	}
-	readParams(sensor_params);
+	readParams(_hasSensorParams ? &_sensorParams : nullptr);
+	buildMessages();
+	_ready = true;
+
+	//in event mode only changes are published, send the complete state once
+	if(_sensMode == SensingMode::EVENT)
+		update();
+	return attached;
 }
 
 PhidgetIKROS::~PhidgetIKROS()
@@ -81,19 +101,24 @@ auto PhidgetIKROS::readParams(XmlRpc::XmlRpcValue* sensor_params) -> void
 			else
 				ROS_ERROR("Type '%s' in sensor param '%s' is unkown", type.c_str(), name.c_str());
 
+			SensorConfig config = {-1, -1};
+			if(value.hasMember("data_rate"))
+			{
+				XmlRpc::XmlRpcValue value_data_rate = value["data_rate"];
+				config.data_rate = value_data_rate;
+				ROS_INFO("Setting data rate to %d for sensor %s with index %d ",config.data_rate, name.c_str(), index);
+			}
 			if(value.hasMember("change_trigger"))
 			{
 				XmlRpc::XmlRpcValue value_change_trigger = value["change_trigger"];
-				int change_trigger = value_change_trigger;
-				ROS_WARN("Setting change trigger to %d for sensor %s with index %d ",change_trigger, name.c_str(), index);
-				setSensorChangeTrigger(index, change_trigger);
+				config.change_trigger = value_change_trigger;
+				ROS_INFO("Setting change trigger to %d for sensor %s with index %d ",config.change_trigger, name.c_str(), index);
 			}
-			if(value.hasMember("data_rate"))
+			if(config.data_rate != -1 || config.change_trigger != -1)
 			{
-				XmlRpc::XmlRpcValue value_data_rate = value["data_rate"];
-				int data_rate = value_data_rate;
-				ROS_WARN("Setting data rate to %d for sensor %s with index %d ",data_rate, name.c_str(), index);
-				setDataRate(index, data_rate);
+				std::lock_guard<std::mutex> lock{_configMutex};
+				_sensorConfig[index] = config;
+				applySensorConfig(index, config);
 			}
 		}
 	}
@@ -165,88 +190,85 @@ auto PhidgetIKROS::readParams(XmlRpc::XmlRpcValue* sensor_params) -> void
 	}
 }
 
-auto PhidgetIKROS::update() -> void
+auto PhidgetIKROS::applySensorConfig(int index, const SensorConfig& config) -> void
 {
-	int count = this->getInputCount();
-	cob_phidgets::DigitalSensor msg_digit;
-	std::vector<std::string> names;
-	std::vector<signed char> states;
+	//the data rate is applied first, a change trigger of 0 makes the board send every sample at this rate
+	if(config.data_rate != -1 && setDataRate(index, config.data_rate) != EPHIDGET_OK)
+		ROS_ERROR("Board %s: could not set data rate %d for sensor %d: %s", _board_name.c_str(), config.data_rate, index,
+			this->getErrorDescription(this->getError()).c_str());
+	if(config.change_trigger != -1 && setSensorChangeTrigger(index, config.change_trigger) != EPHIDGET_OK)
+		ROS_ERROR("Board %s: could not set change trigger %d for sensor %d: %s", _board_name.c_str(), config.change_trigger, index,
+			this->getErrorDescription(this->getError()).c_str());
+}
 
-	//------- publish digital input states ----------//
-	for(int i = 0; i < count; i++)
+auto PhidgetIKROS::buildMessages() -> void
+{
+	auto toVector = [](const std::map<int, std::string>& map, int count)
 	{
-		std::string name;
-		_indexNameMapItr = _indexNameMapDigitalIn.find(i);
-		if(_indexNameMapItr != _indexNameMapDigitalIn.end())
-			name = (*_indexNameMapItr).second;
-		names.push_back(name);
-		states.push_back(this->getInputState(i));
-	}
-	msg_digit.header.stamp = ros::Time::now();
-	msg_digit.uri = names;
-	msg_digit.state = states;
-
-	_pubDigital.publish(msg_digit);
+		std::vector<std::string> uris(count);
+		for(int i = 0; i < count; i++)
+		{
+			std::map<int, std::string>::const_iterator it = map.find(i);
+			if(it != map.end())
+				uris[i] = it->second;
+		}
+		return uris;
+	};
+	_urisDigitalIn = toVector(_indexNameMapDigitalIn, this->getInputCount());
+	_urisDigitalOut = toVector(_indexNameMapDigitalOut, this->getOutputCount());
+	_urisAnalog = toVector(_indexNameMapAnalog, this->getSensorCount());
+
+	_msgDigital.uri = _urisDigitalIn;
+	_msgDigital.uri.insert(_msgDigital.uri.end(), _urisDigitalOut.begin(), _urisDigitalOut.end());
+	_msgDigital.state.assign(_msgDigital.uri.size(), 0);
+	_msgAnalog.uri = _urisAnalog;
+	_msgAnalog.value.assign(_msgAnalog.uri.size(), 0);
+
+	_msgDigitalEvent.uri.resize(1);
+	_msgDigitalEvent.state.resize(1);
+	_msgDigitalOutEvent.uri.resize(1);
+	_msgDigitalOutEvent.state.resize(1);
+	_msgAnalogEvent.uri.resize(1);
+	_msgAnalogEvent.value.resize(1);
+}
 
-	//------- publish digital output states ----------//
-	names.clear();
-	states.clear();
-	count = this->getOutputCount();
-	for(int i = 0; i < count; i++)
-	{
-		std::string name;
-		_indexNameMapItr = _indexNameMapDigitalOut.find(i);
-		if(_indexNameMapItr != _indexNameMapDigitalOut.end())
-			name = (*_indexNameMapItr).second;
-		names.push_back(name);
-		states.push_back(this->getOutputState(i));
-	}
-	msg_digit.header.stamp = ros::Time::now();
-	msg_digit.uri = names;
-	msg_digit.state = states;
+auto PhidgetIKROS::lookupName(const std::vector<std::string>& uris, int index) const -> const std::string&
+{
+	static const std::string empty;
+	return (index >= 0 && index < (int)uris.size()) ? uris[index] : empty;
+}
 
-	_pubDigital.publish(msg_digit);
+auto PhidgetIKROS::update() -> void
+{
+	ros::Time stamp = ros::Time::now();
 
+	//------- publish digital input and output states in one message ----------//
+	size_t inputs = _urisDigitalIn.size();
+	for(size_t i = 0; i < inputs; i++)
+		_msgDigital.state[i] = this->getInputState(i);
+	for(size_t i = 0; i < _urisDigitalOut.size(); i++)
+		_msgDigital.state[inputs + i] = this->getOutputState(i);
+	_msgDigital.header.stamp = stamp;
+	_pubDigital.publish(_msgDigital);
 
 	//------- publish analog input states ----------//
-	cob_phidgets::AnalogSensor msg_analog;
-	names.clear();
-	std::vector<short int> values;
-	count = this->getSensorCount();
-	for(int i = 0; i < count; i++)
-	{
-		std::string name;
-		_indexNameMapItr = _indexNameMapAnalog.find(i);
-		if(_indexNameMapItr != _indexNameMapAnalog.end())
-			name = (*_indexNameMapItr).second;
-		names.push_back(name);
-		values.push_back(this->getSensorValue(i));
-	}
-	msg_analog.header.stamp = ros::Time::now();
-	msg_analog.uri = names;
-	msg_analog.value = values;
-
-	_pubAnalog.publish(msg_analog);
+	for(size_t i = 0; i < _urisAnalog.size(); i++)
+		_msgAnalog.value[i] = this->getSensorValue(i);
+	_msgAnalog.header.stamp = stamp;
+	_pubAnalog.publish(_msgAnalog);
 }
 
 auto PhidgetIKROS::inputChangeHandler(int index, int inputState) -> int
 {
+	ros::Time stamp = ros::Time::now();
 	ROS_DEBUG("Board %s: Digital Input %d changed to State: %d", _board_name.c_str(), index, inputState);
-	cob_phidgets::DigitalSensor msg;
-	std::vector<std::string> names;
-	std::vector<signed char> states;
-
-	std::string name;
-	_indexNameMapItr = _indexNameMapAnalog.find(index);
-	if(_indexNameMapItr != _indexNameMapAnalog.end())
-		name = (*_indexNameMapItr).second;
-	names.push_back(name);
-	states.push_back(inputState);
-
-	msg.header.stamp = ros::Time::now();
-	msg.uri = names;
-	msg.state = states;
-	_pubDigital.publish(msg);
+	if(!_ready)
+		return 0;
+
+	_msgDigitalEvent.header.stamp = stamp;
+	_msgDigitalEvent.uri[0] = lookupName(_urisDigitalIn, index);
+	_msgDigitalEvent.state[0] = inputState;
+	_pubDigital.publish(_msgDigitalEvent);
 
 	return 0;
 }
@@ -254,31 +276,34 @@ auto PhidgetIKROS::inputChangeHandler(int index, int inputState) -> int
 auto PhidgetIKROS::outputChangeHandler(int index, int outputState) -> int
 {
 	ROS_DEBUG("Board %s: Digital Output %d changed to State: %d", _board_name.c_str(), index, outputState);
-	std::lock_guard<std::mutex> lock{_mutex};
-	_outputChanged.updated = true;
-	_outputChanged.index = index;
-	_outputChanged.state = outputState;
+	ros::Time stamp = ros::Time::now();
+	{
+		std::lock_guard<std::mutex> lock{_mutex};
+		_outputChanged.updated = true;
+		_outputChanged.index = index;
+		_outputChanged.state = outputState;
+	}
+
+	if(_sensMode == SensingMode::EVENT && _ready)
+	{
+		_msgDigitalOutEvent.header.stamp = stamp;
+		_msgDigitalOutEvent.uri[0] = lookupName(_urisDigitalOut, index);
+		_msgDigitalOutEvent.state[0] = outputState;
+		_pubDigital.publish(_msgDigitalOutEvent);
+	}
 	return 0;
 }
 auto PhidgetIKROS::sensorChangeHandler(int index, int sensorValue) -> int
 {
+	ros::Time stamp = ros::Time::now();
 	ROS_DEBUG("Board %s: Analog Input %d changed to Value: %d", _board_name.c_str(), index, sensorValue);
-	cob_phidgets::AnalogSensor msg;
-	std::vector<std::string> names;
-	std::vector<short int> values;
+	if(!_ready)
+		return 0;
 
-	std::string name;
-	_indexNameMapItr = _indexNameMapAnalog.find(index);
-	if(_indexNameMapItr != _indexNameMapAnalog.end())
-		name = (*_indexNameMapItr).second;
-	names.push_back(name);
-	values.push_back(sensorValue);
-
-	msg.header.stamp = ros::Time::now();
-	msg.uri = names;
-	msg.value = values;
-
-	_pubAnalog.publish(msg);
+	_msgAnalogEvent.header.stamp = stamp;
+	_msgAnalogEvent.uri[0] = lookupName(_urisAnalog, index);
+	_msgAnalogEvent.value[0] = sensorValue;
+	_pubAnalog.publish(_msgAnalogEvent);
 
 	return 0;
 }
@@ -357,14 +382,18 @@ auto PhidgetIKROS::onDigitalOutCallback(const cob_phidgets::DigitalSensorConstPt
 auto PhidgetIKROS::setDataRateCallback(cob_phidgets::SetDataRate::Request &req,
 										cob_phidgets::SetDataRate::Response &res) -> bool
 {
-	this->setDataRate(req.index, req.data_rate);
-	return true;
+	std::lock_guard<std::mutex> lock{_configMutex};
+	SensorConfig& config = _sensorConfig.insert(std::make_pair((int)req.index, SensorConfig{-1, -1})).first->second;
+	config.data_rate = req.data_rate;
+	return (this->setDataRate(req.index, req.data_rate) == EPHIDGET_OK);
 }
 auto PhidgetIKROS::setTriggerValueCallback(cob_phidgets::SetTriggerValue::Request &req,
 										cob_phidgets::SetTriggerValue::Response &res) -> bool
 {
-	this->setSensorChangeTrigger(req.index, req.trigger_value);
-	return true;
+	std::lock_guard<std::mutex> lock{_configMutex};
+	SensorConfig& config = _sensorConfig.insert(std::make_pair((int)req.index, SensorConfig{-1, -1})).first->second;
+	config.change_trigger = req.trigger_value;
+	return (this->setSensorChangeTrigger(req.index, req.trigger_value) == EPHIDGET_OK);
 }
 
 auto PhidgetIKROS::attachHandler() -> int
@@ -400,6 +429,11 @@ auto PhidgetIKROS::attachHandler() -> int
 		ROS_DEBUG("Sensor#: %d > Data Rate: %d", i, millis);
 	}
 
+	//the board forgets its sampling settings when it is reattached
+	std::lock_guard<std::mutex> lock{_configMutex};
+	for(auto& config : _sensorConfig)
+		applySensorConfig(config.first, config.second);
+
 	return 0;
 }
 
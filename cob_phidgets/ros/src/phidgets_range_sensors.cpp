@@ -25,27 +25,90 @@
 
 #include <libphidgets/phidget21.h>
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+// sensor values of the interface kit are scaled to 0..1000
+static const int SENSOR_VALUE_MAX = 1000;
+
+// range in m for every sensor value, outside of the valid interval of the formula the range is NaN
+class RangeTable
+{
+	std::vector<float> ranges_;
+public:
+	RangeTable() : ranges_(SENSOR_VALUE_MAX + 1, std::numeric_limits<float>::quiet_NaN())
+	{
+		for (int v = 80; v <= 530; v++)
+			ranges_[v] = 20.76 / (v - 11.);
+	}
+
+	float operator()(const double value) const
+	{
+		int v = (int)(value + 0.5);
+		if (v < 0 || v > SENSOR_VALUE_MAX)
+			return std::numeric_limits<float>::quiet_NaN();
+		return ranges_[v];
+	}
+};
 
 class Sensor
 {
+public:
+	enum Filter {MEAN, MEDIAN};
+
+private:
 	ros::NodeHandle n_;
 	ros::Publisher pub_range_;
 	int id_, filter_size_;
-	std::list<int> vals_;
+	Filter filter_;
+	// samples deviating more than this from the filtered value are dropped, 0 disables the check
+	int max_jump_;
 	std::string frame_id_;
-public:
+	const RangeTable& table_;
+
+	// ring buffer of the last filter_size_ samples with running sum
+	std::vector<int> vals_;
+	mutable std::vector<int> sorted_;
+	int head_, num_, sum_;
+	int rejected_;
+	mutable std::mutex mutex_;
 
-	Sensor(const std::string &fr_id, const int id, const int filter_size = 10) :
-			id_(id), filter_size_(filter_size), frame_id_(fr_id)
+	double filtered() const
+	{
+		if (filter_ == MEDIAN)
+		{
+			std::copy(vals_.begin(), vals_.begin() + num_, sorted_.begin());
+			std::nth_element(sorted_.begin(), sorted_.begin() + num_ / 2, sorted_.begin() + num_);
+			return sorted_[num_ / 2];
+		}
+		return sum_ / (double) num_;
+	}
+
+public:
+	Sensor(const std::string &fr_id, const int id, const RangeTable& table, const int filter_size = 10,
+			const Filter filter = MEAN, const int max_jump = 0) :
+			id_(id), filter_size_(std::max(filter_size, 1)), filter_(filter), max_jump_(max_jump),
+			frame_id_(fr_id), table_(table), vals_(filter_size_, 0), sorted_(filter_size_, 0),
+			head_(0), num_(0), sum_(0), rejected_(0)
 	{
 		pub_range_ = n_.advertise<sensor_msgs::Range>(frame_id_, 0);
 	}
 
 	void publish()
 	{
-		pub_range_.publish((sensor_msgs::Range) *this);
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (num_ == 0)
+			return;
+		sensor_msgs::Range msg = (sensor_msgs::Range) *this;
+		lock.unlock();
+		pub_range_.publish(msg);
 	}
 
+	// has to be called with mutex_ locked
 	operator sensor_msgs::Range() const
 	{
 		sensor_msgs::Range msg;
@@ -55,15 +118,7 @@ public:
 		msg.min_range = 0.04;
 		msg.max_range = 0.3;
 		msg.field_of_view = 0; //not given!
-
-		int sum = 0, num = 0;
-		for (std::list<int>::const_iterator it = vals_.begin();
-				it != vals_.end(); it++)
-		{
-			sum += *it;
-			++num;
-		}
-		msg.range = 20.76 / (sum / (double) num - 11.);
+		msg.range = table_(filtered());
 
 		return msg;
 	}
@@ -75,13 +130,23 @@ public:
 
 	void update(const int v)
 	{
-		if ((int)vals_.size() < filter_size_)
-			vals_.push_back(v);
-		else
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (max_jump_ > 0 && num_ > 0 && std::fabs(v - filtered()) > max_jump_)
 		{
-			vals_.push_back(v);
-			vals_.pop_front();
+			if (++rejected_ <= filter_size_)
+				return;
+			// a persistent jump is a real change, restart the filter at the new level
+			head_ = num_ = sum_ = 0;
 		}
+		rejected_ = 0;
+
+		if (num_ < filter_size_)
+			num_++;
+		else
+			sum_ -= vals_[head_];
+		vals_[head_] = v;
+		sum_ += v;
+		head_ = (head_ + 1) % filter_size_;
 	}
 
 };
@@ -111,10 +176,10 @@ int IFK_AttachHandler(CPhidgetHandle IFK, void *userptr)
 int IFK_SensorChangeHandler(CPhidgetInterfaceKitHandle IFK, void *userptr,
 		int Index, int Value)
 {
-	std::vector<Sensor>* g_sensors = (std::vector<Sensor>*) userptr;
+	std::vector<std::shared_ptr<Sensor> >* g_sensors = (std::vector<std::shared_ptr<Sensor> >*) userptr;
 	for (size_t i = 0; i < g_sensors->size(); i++)
-		if ((*g_sensors)[i].getId() == Index)
-			(*g_sensors)[i].update(Value);
+		if ((*g_sensors)[i]->getId() == Index)
+			(*g_sensors)[i]->update(Value);
 	return 0;
 }
 
@@ -123,7 +188,19 @@ int main(int argc, char **argv)
 	ros::init(argc, argv, "cob_phidgets");
 
 	ros::NodeHandle nh_("~");
-	std::vector<Sensor> g_sensors;
+	RangeTable table;
+	std::vector<std::shared_ptr<Sensor> > g_sensors;
+
+	std::string filter_name;
+	int max_jump;
+	nh_.param<std::string>("filter", filter_name, "mean");
+	nh_.param("max_jump", max_jump, 0);
+	Sensor::Filter filter_type = Sensor::MEAN;
+	if (filter_name == "median")
+		filter_type = Sensor::MEDIAN;
+	else if (filter_name != "mean")
+		ROS_WARN("Unknown filter '%s', using mean instead", filter_name.c_str());
+
 	if (nh_.hasParam("sensors"))
 	{
 		XmlRpc::XmlRpcValue v;
@@ -134,9 +211,9 @@ int main(int argc, char **argv)
 
 			int id = v[i][0];
 			std::string fr_id = v[i][1];
-			int filter = v.size() > 2 ? (int) v[i][2] : 10;
+			int filter = v[i].size() > 2 ? (int) v[i][2] : 10;
 
-			g_sensors.push_back(Sensor(fr_id, id, filter));
+			g_sensors.push_back(std::make_shared<Sensor>(fr_id, id, table, filter, filter_type, max_jump));
 		}
 	}
 	else
@@ -189,7 +266,7 @@ int main(int argc, char **argv)
 	while (ros::ok())
 	{
 		for (size_t i = 0; i < g_sensors.size(); i++)
-			g_sensors[i].publish();
+			g_sensors[i]->publish();
 		ros::spinOnce();
 		loop_rate.sleep();
 	}
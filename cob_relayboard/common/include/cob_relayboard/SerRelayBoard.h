@@ -19,8 +19,8 @@
 #define SerRelayBoard_INCLUDEDEF_H
 
 //-----------------------------------------------
-#include <cob_relayboard/SerialIO.h>
-#include <cob_relayboard/Mutex.h>
+#include <cob_utilities/SerialIO.h>
+#include <cob_utilities/Mutex.h>
 #include <cob_relayboard/CmdRelaisBoard.h>
 
 //-----------------------------------------------
@@ -33,6 +33,21 @@ class SerRelayBoard
 {
 public:
 
+	/**
+	 * Data of one received message, copied as a whole.
+	 */
+	struct RelBoardState
+	{
+		int iStatus; // EM-Stop (bit 0) and Scanner-Stop (bit 1)
+		int iChargeCurrent;
+		int iBattVoltage;
+		int iKeyPad;
+		int iAnalogIn[4];
+		int iTempSensor;
+		int iDigIn;
+		unsigned int uiMsgCount; // number of messages received since init
+	};
+
 	SerRelayBoard(std::string ComPort, int ProtocolVersion = 1);
 
 	~SerRelayBoard();
@@ -43,7 +58,22 @@ public:
 	bool shutdown();
 
 	int evalRxBuffer(); //needs to be calles to read new data from relayboard
-	int sendRequest(); //sends collected data and requests response
+
+	/**
+	 * Sends the collected data and requests a response.
+	 * The request is only packed again if a field changed since the last request, otherwise the last one is repeated.
+	 */
+	int sendRequest();
+
+	/**
+	 * Waits up to dTimeout seconds for data from the relayboard and decodes every complete message
+	 * as soon as its last byte arrived. Incomplete messages are kept for the next call.
+	 * @return NO_ERROR if a message was decoded, TOO_LESS_BYTES_IN_QUEUE if no message is complete yet
+	 */
+	int waitForRxData(double dTimeout);
+
+	// copy of the data of the last received message
+	void getState(RelBoardState* pState);
 
 	//Services by relayboard
 	int setDigOut(int iChannel, bool bOn);
@@ -53,11 +83,15 @@ public:
 	bool isScannerStop();
 	int getBatteryVoltage()
 	{
-		return m_iRelBoardBattVoltage;
+		RelBoardState state;
+		getState(&state);
+		return state.iBattVoltage;
 	}
 	int getChargeCurrent()
 	{
-		return m_iChargeCurrent;
+		RelBoardState state;
+		getState(&state);
+		return state.iChargeCurrent;
 	}
 
 
@@ -111,7 +145,13 @@ protected:
 	void rxCharArray();
 
 	void convDataToSendMsg(unsigned char cMsg[]);
-	bool convRecMsgToData(unsigned char cMsg[]);
+	bool convRecMsgToData(const unsigned char cMsg[]);
+
+	// reads what is available into m_cRxBuffer and decodes it in place
+	int readRxBuffer();
+
+	// sets or clears bits of m_iCmdRelayBoard, the request is packed again if they changed
+	void setCmdBits(int iBits, bool bOn);
 
 	Mutex m_Mutex;
 
@@ -152,16 +192,22 @@ protected:
 	// USBoard
 	int m_iUSBoardSensorActive;
 
+	// last packed request, protected by m_Mutex. Setters of the send data set m_bTxMsgDirty if they change a field
+	enum { TX_MSG_SIZE_MAX = 88 };
+	unsigned char m_cTxMsg[TX_MSG_SIZE_MAX];
+	bool m_bTxMsgDirty;
+
 	//-----------------------
-	// rec data
-	int m_iRelBoardStatus;
-	int m_iChargeCurrent;
-	int m_iRelBoardBattVoltage;
-	int m_iRelBoardKeyPad;
-	int m_iRelBoardAnalogIn[4];
-	int m_iRelBoardTempSensor;
-
-	int m_iDigIn;
+	// rec data, protected by m_Mutex
+	RelBoardState m_State;
+
+	// received bytes, at most one incomplete message is kept between two reads
+	enum { RX_BUFFER_SIZE = 1024 };
+	unsigned char m_cRxBuffer[RX_BUFFER_SIZE];
+	int m_iRxLength;
+	int m_iNumByteRec;
+	int m_iNoMsgCnt;
+
 	int m_iProtocolVersion;
 	int m_NUM_BYTE_SEND;
 
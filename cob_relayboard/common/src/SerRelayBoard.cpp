@@ -16,6 +16,7 @@
 
 
 #include <math.h>
+#include <string.h>
 #include <cob_relayboard/SerRelayBoard.h>
 #include <iostream>
 
@@ -43,6 +44,7 @@
 SerRelayBoard::SerRelayBoard(std::string ComPort, int ProtocolVersion)
 {
 	m_iProtocolVersion = ProtocolVersion;
+	m_iTypeLCD = LCD_20CHAR_TEXT;
 	if(m_iProtocolVersion == 1)
 		m_NUM_BYTE_SEND = 50;
 	else if(m_iProtocolVersion == 2)
@@ -57,13 +59,26 @@ SerRelayBoard::SerRelayBoard(std::string ComPort, int ProtocolVersion)
 	m_bComInit = false;
 	m_sNumComPort = ComPort;
 
-	m_iRelBoardBattVoltage = 0;
+	m_iNumByteRec = (m_iTypeLCD == RELAY_BOARD_1_4) ? NUM_BYTE_REC_RELAYBOARD_14 : NUM_BYTE_REC;
+	m_iRxLength = 0;
+	m_iNoMsgCnt = 0;
+
+	memset(&m_State, 0, sizeof(m_State));
+	m_State.iKeyPad = 0xFFFF;
 	m_iConfigRelayBoard = 0;
-	m_iRelBoardKeyPad = 0xFFFF;
 	m_iCmdRelayBoard = 0;
-	m_iDigIn = 0;
 	m_cSoftEMStop = 0;
 
+	// fields without setter are sent as 0
+	m_iIOBoardDigOut = 0;
+	m_iVelCmdMotRightEncS = 0;
+	m_iVelCmdMotLeftEncS = 0;
+	m_iVelCmdMotRearRightEncS = 0;
+	m_iVelCmdMotRearLeftEncS = 0;
+	m_iUSBoardSensorActive = 0;
+	memset(m_cTextDisplay, 0, sizeof(m_cTextDisplay));
+	m_bTxMsgDirty = true;
+
 }
 
 //-----------------------------------------------
@@ -75,68 +90,81 @@ SerRelayBoard::~SerRelayBoard()
 //-----------------------------------------------
 int SerRelayBoard::evalRxBuffer()
 {
-	static int siNoMsgCnt = 0;
-
-	int iNumByteRec = NUM_BYTE_REC;
-	if(m_iTypeLCD == RELAY_BOARD_1_4)
-	{
-		iNumByteRec = NUM_BYTE_REC_RELAYBOARD_14;
-	}
-
-	const int c_iNrBytesMin = NUM_BYTE_REC_HEADER + iNumByteRec + NUM_BYTE_REC_CHECKSUM;
-	const int c_iSizeBuffer = 4096;
-
-	int i;
-	int errorFlag = NO_ERROR;
-	int iNrBytesInQueue, iNrBytesRead, iDataStart;
-	unsigned char cDat[c_iSizeBuffer];
-	unsigned char cTest[4] = {0x02, 0x80, 0xD6, 0x02};
-
 	if( !m_bComInit ) return NOT_INITIALIZED;
 
-	//enough data in queue?
-	iNrBytesInQueue = m_SerIO.getSizeRXQueue();
-	if(iNrBytesInQueue < c_iNrBytesMin)
+	int errorFlag = readRxBuffer();
+	if(errorFlag == TOO_LESS_BYTES_IN_QUEUE)
 	{
 		//there are too less bytes in queue
-		siNoMsgCnt++;
-		if(siNoMsgCnt > 29)
+		m_iNoMsgCnt++;
+		if(m_iNoMsgCnt > 29)
 		{
-			//std::cerr << "Relayboard: " << siNoMsgCnt << " cycles no msg received";
-			siNoMsgCnt = 0;
+			//std::cerr << "Relayboard: " << m_iNoMsgCnt << " cycles no msg received";
+			m_iNoMsgCnt = 0;
 			errorFlag = NO_MESSAGES;
-		} else errorFlag = TOO_LESS_BYTES_IN_QUEUE;
-
-		return errorFlag;
+		}
 	}
 	else
 	{
-		siNoMsgCnt = 0;
+		m_iNoMsgCnt = 0;
 	}
 
-	// search most recent data from back of queue
-	iNrBytesRead = m_SerIO.readBlocking((char*)&cDat[0], iNrBytesInQueue);
-	for(i = (iNrBytesRead - c_iNrBytesMin); i >= 0 ; i--)
+	return errorFlag;
+}
+
+//-----------------------------------------------
+int SerRelayBoard::waitForRxData(double dTimeout)
+{
+	if( !m_bComInit ) return NOT_INITIALIZED;
+
+	if(m_SerIO.waitForData(dTimeout) <= 0) return TOO_LESS_BYTES_IN_QUEUE;
+
+	return readRxBuffer();
+}
+
+//-----------------------------------------------
+int SerRelayBoard::readRxBuffer()
+{
+	const int c_iMsgSize = NUM_BYTE_REC_HEADER + m_iNumByteRec + NUM_BYTE_REC_CHECKSUM;
+	const unsigned char cHeader[NUM_BYTE_REC_HEADER] = {0x02, 0x80, 0xD6, 0x02};
+
+	int iNrBytesRead = m_SerIO.readNonBlocking((char*)&m_cRxBuffer[m_iRxLength], RX_BUFFER_SIZE - m_iRxLength);
+	if(iNrBytesRead > 0) m_iRxLength += iNrBytesRead;
+
+	// decode all complete messages in place, the last one is the most recent
+	int errorFlag = TOO_LESS_BYTES_IN_QUEUE;
+	int iPos = 0;
+	while(m_iRxLength - iPos >= c_iMsgSize)
 	{
-		//try to find start bytes
-		if((cDat[i] == cTest[0]) && (cDat[i+1] == cTest[1]) && (cDat[i+2] == cTest[2]) && (cDat[i+3] == cTest[3]))
+		const unsigned char* pStart = (const unsigned char*)memchr(&m_cRxBuffer[iPos], cHeader[0], m_iRxLength - iPos - c_iMsgSize + 1);
+		if(pStart == NULL)
 		{
-			iDataStart = i + 4;
-
-			// checksum ok?
-			if( convRecMsgToData(&cDat[iDataStart]) )
-			{
-				return errorFlag;
-			}
-			else
-			{
-				//std::cerr << "Relayboard: checksum error";
-				errorFlag = CHECKSUM_ERROR;
-				return errorFlag;
-			}
+			iPos = m_iRxLength - c_iMsgSize + 1;
+			break;
+		}
+		iPos = pStart - m_cRxBuffer;
+
+		if(memcmp(pStart, cHeader, NUM_BYTE_REC_HEADER) != 0)
+		{
+			iPos++;
+		}
+		else if(convRecMsgToData(pStart + NUM_BYTE_REC_HEADER))
+		{
+			errorFlag = NO_ERROR;
+			iPos += c_iMsgSize;
+		}
+		else
+		{
+			//std::cerr << "Relayboard: checksum error";
+			if(errorFlag != NO_ERROR) errorFlag = CHECKSUM_ERROR;
+			iPos++;
 		}
 	}
 
+	// keep the incomplete rest for the next read
+	m_iRxLength -= iPos;
+	memmove(m_cRxBuffer, &m_cRxBuffer[iPos], m_iRxLength);
+
 	return errorFlag;
 }
 
@@ -147,9 +175,12 @@ bool SerRelayBoard::init()
 	m_SerIO.setDeviceName( m_sNumComPort.c_str() );
 	m_SerIO.setBufferSize(RS422_RX_BUFFERSIZE, RS422_TX_BUFFERSIZE);
 	m_SerIO.setTimeout(RS422_TIMEOUT);
+	m_SerIO.setNonBlocking(true);
+	m_SerIO.setLowLatency(true);
 
 	m_SerIO.openIO();
 
+	m_iRxLength = 0;
 	m_bComInit = true;
 
 	return true;
@@ -180,7 +211,9 @@ bool SerRelayBoard::shutdown()
 //-----------------------------------------------
 bool SerRelayBoard::isEMStop()
 {
-	if( (m_iRelBoardStatus & 0x0001) != 0)
+	RelBoardState state;
+	getState(&state);
+	if( (state.iStatus & 0x0001) != 0)
 	{
 		return true;
 	}
@@ -193,7 +226,9 @@ bool SerRelayBoard::isEMStop()
 //-----------------------------------------------
 bool SerRelayBoard::isScannerStop()
 {
-	if( (m_iRelBoardStatus & 0x0002) != 0)
+	RelBoardState state;
+	getState(&state);
+	if( (state.iStatus & 0x0002) != 0)
 	{
 		return true;
 	}
@@ -208,15 +243,17 @@ int SerRelayBoard::sendRequest() {
 	int errorFlag = NO_ERROR;
 	int iNrBytesWritten;
 
-	unsigned char cMsg[m_NUM_BYTE_SEND];
-
 	m_Mutex.lock();
 
-		convDataToSendMsg(cMsg);
+		// an unchanged request is sent again as it is
+		if(m_bTxMsgDirty)
+		{
+			convDataToSendMsg(m_cTxMsg);
+		}
 
 		m_SerIO.purgeTx();
 
-		iNrBytesWritten = m_SerIO.writeIO((char*)cMsg, m_NUM_BYTE_SEND);
+		iNrBytesWritten = m_SerIO.writeIO((char*)m_cTxMsg, m_NUM_BYTE_SEND);
 
 		if(iNrBytesWritten < m_NUM_BYTE_SEND) {
 			//std::cerr << "Error in sending message to Relayboard over SerialIO, lost bytes during writing" << std::endl;
@@ -234,50 +271,43 @@ int SerRelayBoard::setDigOut(int iChannel, bool bOn)
 	{
 	case 0:
 
-		if(bOn) { m_iCmdRelayBoard |= CMD_SET_CHARGE_RELAY; }
-		else { m_iCmdRelayBoard &= ~CMD_SET_CHARGE_RELAY; }
+		setCmdBits(CMD_SET_CHARGE_RELAY, bOn);
 
 		break;
 
 	case 1:
 
-		if(bOn) { m_iCmdRelayBoard |= CMD_SET_RELAY1; }
-		else { m_iCmdRelayBoard &= ~CMD_SET_RELAY1; }
+		setCmdBits(CMD_SET_RELAY1, bOn);
 
 		break;
 
 	case 2:
 
-		if(bOn) { m_iCmdRelayBoard |= CMD_SET_RELAY2; }
-		else { m_iCmdRelayBoard &= ~CMD_SET_RELAY2; }
+		setCmdBits(CMD_SET_RELAY2, bOn);
 
 		break;
 
 	case 3:
 
-		if(bOn) { m_iCmdRelayBoard |= CMD_SET_RELAY3; }
-		else { m_iCmdRelayBoard &= ~CMD_SET_RELAY3; }
+		setCmdBits(CMD_SET_RELAY3, bOn);
 
 		break;
 
 	case 4:
 
-		if(bOn) { m_iCmdRelayBoard |= CMD_SET_RELAY4; }
-		else { m_iCmdRelayBoard &= ~CMD_SET_RELAY4; }
+		setCmdBits(CMD_SET_RELAY4, bOn);
 
 		break;
 
 	case 5:
 
-		if(bOn) { m_iCmdRelayBoard |= CMD_SET_RELAY5; }
-		else { m_iCmdRelayBoard &= ~CMD_SET_RELAY5; }
+		setCmdBits(CMD_SET_RELAY5, bOn);
 
 		break;
 
 	case 6:
 
-		if(bOn) { m_iCmdRelayBoard |= CMD_SET_RELAY6; }
-		else { m_iCmdRelayBoard &= ~CMD_SET_RELAY6; }
+		setCmdBits(CMD_SET_RELAY6, bOn);
 
 		break;
 
@@ -288,17 +318,36 @@ int SerRelayBoard::setDigOut(int iChannel, bool bOn)
 
 	return 0;
 }
+
+//-----------------------------------------------
+void SerRelayBoard::setCmdBits(int iBits, bool bOn)
+{
+	m_Mutex.lock();
+
+	int iCmd = bOn ? (m_iCmdRelayBoard | iBits) : (m_iCmdRelayBoard & ~iBits);
+	if(iCmd != m_iCmdRelayBoard)
+	{
+		m_iCmdRelayBoard = iCmd;
+		m_bTxMsgDirty = true;
+	}
+
+	m_Mutex.unlock();
+}
+
 //-----------------------------------------------
 int SerRelayBoard::getAnalogIn(int* piAnalogIn)
 {
-	piAnalogIn[0] = m_iChargeCurrent;
-	piAnalogIn[1] = m_iRelBoardBattVoltage;
-	piAnalogIn[2] = m_iRelBoardTempSensor;
-	piAnalogIn[3] = m_iRelBoardKeyPad;
-	piAnalogIn[4] = m_iRelBoardAnalogIn[0];
-	piAnalogIn[5] = m_iRelBoardAnalogIn[1];
-	piAnalogIn[6] = m_iRelBoardAnalogIn[2];
-	piAnalogIn[7] = m_iRelBoardAnalogIn[3];
+	RelBoardState state;
+	getState(&state);
+
+	piAnalogIn[0] = state.iChargeCurrent;
+	piAnalogIn[1] = state.iBattVoltage;
+	piAnalogIn[2] = state.iTempSensor;
+	piAnalogIn[3] = state.iKeyPad;
+	piAnalogIn[4] = state.iAnalogIn[0];
+	piAnalogIn[5] = state.iAnalogIn[1];
+	piAnalogIn[6] = state.iAnalogIn[2];
+	piAnalogIn[7] = state.iAnalogIn[3];
 
 	return 0;
 }
@@ -306,7 +355,17 @@ int SerRelayBoard::getAnalogIn(int* piAnalogIn)
 //-----------------------------------------------
 int SerRelayBoard::getDigIn()
 {
-	return m_iDigIn;
+	RelBoardState state;
+	getState(&state);
+	return state.iDigIn;
+}
+
+//-----------------------------------------------
+void SerRelayBoard::getState(RelBoardState* pState)
+{
+	m_Mutex.lock();
+	*pState = m_State;
+	m_Mutex.unlock();
 }
 
 void SerRelayBoard::convDataToSendMsg(unsigned char cMsg[])
@@ -402,6 +461,9 @@ void SerRelayBoard::convDataToSendMsg(unsigned char cMsg[])
 	cMsg[m_NUM_BYTE_SEND - 2] = iChkSum >> 8;
 	cMsg[m_NUM_BYTE_SEND - 1] = iChkSum;
 
+	// the next request differs if a one-shot flag is reset or the soft EM-Stop pulse is not finished yet
+	m_bTxMsgDirty = ((m_iCmdRelayBoard & CMD_RESET_POS_CNT) != 0) || ((m_cSoftEMStop & 0x02) != 0);
+
 	// reset flags
 	m_iCmdRelayBoard &= ~CMD_RESET_POS_CNT;
 
@@ -444,31 +506,14 @@ void SerRelayBoard::convDataToSendMsg(unsigned char cMsg[])
 }
 */
 //-----------------------------------------------
-bool SerRelayBoard::convRecMsgToData(unsigned char cMsg[])
+bool SerRelayBoard::convRecMsgToData(const unsigned char cMsg[])
 {
-
-	int iNumByteRec = NUM_BYTE_REC;
-	if(m_iTypeLCD == LCD_20CHAR_TEXT)
-	{
-		iNumByteRec = NUM_BYTE_REC;
-	}
-	if(m_iTypeLCD == LCD_60CHAR_TEXT)
-	{
-		iNumByteRec = NUM_BYTE_REC;
-	}
-	if(m_iTypeLCD == RELAY_BOARD_1_4)
-	{
-		iNumByteRec = NUM_BYTE_REC_RELAYBOARD_14;
-	}
-
-	const int c_iStartCheckSum = iNumByteRec;
+	const int c_iStartCheckSum = m_iNumByteRec;
 
 	int i;
 	unsigned int iTxCheckSum;
 	unsigned int iCheckSum;
 
-	m_Mutex.lock();
-
 	// test checksum: checksum should be sum of all bytes
 	iTxCheckSum = (cMsg[c_iStartCheckSum + 1] << 8) | cMsg[c_iStartCheckSum];
 
@@ -484,43 +529,47 @@ bool SerRelayBoard::convRecMsgToData(unsigned char cMsg[])
 		return false;
 	}
 
-	// convert data
+	// convert data, the state is only updated as a whole
+	RelBoardState state;
 	int iCnt = 0;
 
 	//RelayboardStatus bytes contain EM-Stop and Scanner-Stop bits
-	m_iRelBoardStatus = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
+	state.iStatus = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
 	iCnt += 2;
 
 	//unused at the moment
-	m_iChargeCurrent = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
+	state.iChargeCurrent = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
 	iCnt += 2;
 
 	//unused at the moment
-	m_iRelBoardBattVoltage = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
+	state.iBattVoltage = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
 	iCnt += 2;
 
 	//unused at the moment
-	m_iRelBoardKeyPad = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
+	state.iKeyPad = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
 	iCnt += 2;
 
 	//unused at the moment
 	for(i = 0; i < 4; i++)
 	{
-		m_iRelBoardAnalogIn[i] = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
+		state.iAnalogIn[i] = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
 		iCnt += 2;
 	}
 
 	//unused at the moment
-	m_iRelBoardTempSensor = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
+	state.iTempSensor = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
 	iCnt += 2;
 
 	//Digital Inputs
 	//unused at the moment
-	m_iDigIn = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
+	state.iDigIn = (cMsg[iCnt + 1] << 8) | cMsg[iCnt];
 	iCnt += 2;
 
 	//Throw away rest of the message, it was used for earlier purposes
 
+	m_Mutex.lock();
+	state.uiMsgCount = m_State.uiMsgCount + 1;
+	m_State = state;
 	m_Mutex.unlock();
 	return true;
 }
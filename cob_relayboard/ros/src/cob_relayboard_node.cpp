@@ -19,11 +19,17 @@
 //#### includes ####
 
 // standard includes
-//--
+#include <algorithm>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
 
 // ROS includes
 #include <ros/ros.h>
 #include <cob_relayboard/SerRelayBoard.h>
+#include <cob_utilities/RobotStateBlackboard.h>
 
 // ROS message includes
 #include <std_msgs/Bool.h>
@@ -53,7 +59,7 @@ public:
   // --
 
   // Constructor
-  NodeClass()
+  NodeClass() : state_mutex_(Mutex::PROTOCOL_INHERIT)
   {
     n = ros::NodeHandle();
     n_priv = ros::NodeHandle("~");
@@ -68,19 +74,37 @@ public:
     relayboard_timeout_ = 2.0;
     protocol_version_ = 1;
     duration_for_EM_free_ = ros::Duration(1);
+    last_published_state_ = -1;
+    em_thread_priority_ = 0;
+    request_rate_ = 20.0;
+    stop_ = false;
   }
 
   // Destructor
   ~NodeClass()
   {
+    stop_ = true;
+    if(receive_thread_.joinable()) receive_thread_.join();
     delete m_SerRelayBoard;
   }
 
-  void sendEmergencyStopStates();
+  // publishes the EM-Stop state, with only_transitions only if it differs from the last published one
+  void sendEmergencyStopStates(bool only_transitions);
   void sendBatteryVoltage();
   int init();
 
+  // starts the thread that requests data from the relayboard and receives the answers
+  void startReceiving();
+
+  // sends a request to the relayboard
+  int requestBoardStatus();
+  // decodes the answer as soon as it is complete, returns true if new data was received
+  bool receiveBoardStatus(double timeout);
+
 private:
+  // sends the requests, waits for answers and publishes EM-Stop transitions as soon as they are decoded
+  void receiveThread();
+
   std::string sComPort;
   SerRelayBoard * m_SerRelayBoard;
 
@@ -94,6 +118,26 @@ private:
   bool relayboard_online; //the relayboard is sending messages at regular time
   bool relayboard_available; //the relayboard has sent at least one message -> publish topic
 
+  // data of the last message, all values are taken from the same message
+  SerRelayBoard::RelBoardState board_state_;
+
+  // protects the EM-Stop state machine and the data above, shared by the receive thread and the main loop
+  Mutex state_mutex_;
+  // emergency_state, button and scanner bits of the last published message
+  int last_published_state_;
+  bool last_published_button_;
+  bool last_published_scanner_;
+
+  // SCHED_FIFO priority of the receive thread, 0 keeps the default scheduling
+  int em_thread_priority_;
+  // maximum rate of requests, the next request is sent as soon as the answer to the last one was decoded
+  double request_rate_;
+  boost::thread receive_thread_;
+  boost::atomic<bool> stop_;
+
+  // EM-Stop state for the other drivers, written with state_mutex_ held before the topic is published
+  RobotStateBlackboard blackboard_;
+
   // possible states of emergency stop
   enum
     {
@@ -101,8 +145,6 @@ private:
       ST_EM_ACTIVE = 1,
       ST_EM_CONFIRMED = 2
     };
-
-  int requestBoardStatus();
 };
 
 //#######################
@@ -115,13 +157,18 @@ int main(int argc, char** argv)
   NodeClass node;
   if(node.init() != 0) return 1;
 
-  ros::Rate r(20); //Cycle-Rate: Frequency of publishing EMStopStates
+  // the receive thread polls the relayboard and publishes EM-Stop transitions, the main loop only publishes the periodic messages
+  node.startReceiving();
+
+  ros::Rate loop_rate(20); //Cycle-Rate: Frequency of publishing EMStopStates
   while(node.n.ok())
     {
-      node.sendEmergencyStopStates();
+      // keep publishing (EMSTOP when offline) even if the state does not change
+      node.sendEmergencyStopStates(false);
+      node.sendBatteryVoltage();
 
       ros::spinOnce();
-      r.sleep();
+      loop_rate.sleep();
     }
 
   return 0;
@@ -145,6 +192,18 @@ int NodeClass::init()
 
   n_priv.param("relayboard_timeout", relayboard_timeout_, 2.0);
   n_priv.param("protocol_version", protocol_version_, 1);
+  n_priv.param("em_thread_priority", em_thread_priority_, 0);
+  n_priv.param("request_rate", request_rate_, 20.0);
+  if(request_rate_ <= 0.0)
+    {
+      ROS_WARN("Parameter request_rate has to be positive, using 20 Hz");
+      request_rate_ = 20.0;
+    }
+
+  std::string blackboard_name;
+  n_priv.param<std::string>("blackboard", blackboard_name, "cob_robot_state");
+  if(!blackboard_name.empty() && !blackboard_.open(blackboard_name))
+    ROS_WARN("Could not open the robot state blackboard '%s', the EM-Stop state is only published", blackboard_name.c_str());
 
   m_SerRelayBoard = new SerRelayBoard(sComPort, protocol_version_);
   ROS_INFO("Opened Relayboard at ComPort = %s", sComPort.c_str());
@@ -167,49 +226,106 @@ int NodeClass::requestBoardStatus() {
     ROS_ERROR("Error in sending message to Relayboard over SerialIO, lost bytes during writing");
   }
 
-  ret = m_SerRelayBoard->evalRxBuffer();
+  return 0;
+}
+
+void NodeClass::startReceiving()
+{
+  receive_thread_ = boost::thread(&NodeClass::receiveThread, this);
+}
+
+void NodeClass::receiveThread()
+{
+  // real-time priority needs the according rtprio limit, run without it otherwise
+  if(em_thread_priority_ > 0)
+    {
+      sched_param schedParam;
+      schedParam.sched_priority = em_thread_priority_;
+      int iRet = pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedParam);
+      if(iRet != 0)
+        ROS_WARN("Could not switch relayboard receive thread to SCHED_FIFO priority %d: %s", em_thread_priority_, strerror(iRet));
+    }
+
+  // the request is sent right after the answer to the previous one was decoded if it is due,
+  // without an answer it is repeated one period later
+  const ros::WallDuration period(1.0 / request_rate_);
+  ros::WallTime last_request;
+  bool answer_pending = false;
+  while(!stop_ && n.ok())
+    {
+      ros::WallTime now = ros::WallTime::now();
+      ros::WallDuration since_request = now - last_request;
+      if(since_request >= period && (!answer_pending || since_request >= period * 2.0))
+        {
+          requestBoardStatus();
+          last_request = now;
+          since_request = ros::WallDuration(0);
+          answer_pending = true;
+        }
+
+      // wait for the answer or until the next request is due, but short enough to detect a lost connection and notice stop_
+      double timeout = 0.05;
+      if(!answer_pending)
+        timeout = std::max(0.0, std::min(timeout, (period - since_request).toSec()));
+      if(receiveBoardStatus(timeout))
+        answer_pending = false;
+      sendEmergencyStopStates(true);
+    }
+}
+
+bool NodeClass::receiveBoardStatus(double timeout) {
+  int ret = m_SerRelayBoard->waitForRxData(timeout);
+
+  state_mutex_.lock();
+  bool received = false;
   if(ret==SerRelayBoard::NOT_INITIALIZED) {
     ROS_ERROR("Failed to read relayboard data over Serial, the device is not initialized");
     relayboard_online = false;
-  } else if(ret==SerRelayBoard::NO_MESSAGES) {
-    ROS_ERROR("For a long time, no messages from RelayBoard have been received, check com port!");
-    if(time_last_message_received_.toSec() - ros::Time::now().toSec() > relayboard_timeout_) {relayboard_online = false;}
-  } else if(ret==SerRelayBoard::TOO_LESS_BYTES_IN_QUEUE) {
-    //ROS_ERROR("Relayboard: Too less bytes in queue");
   } else if(ret==SerRelayBoard::CHECKSUM_ERROR) {
     ROS_ERROR("A checksum error occurred while reading from relayboard data");
   } else if(ret==SerRelayBoard::NO_ERROR) {
     relayboard_online = true;
     relayboard_available = true;
     time_last_message_received_ = ros::Time::now();
+    m_SerRelayBoard->getState(&board_state_);
+    received = true;
   }
 
-  return 0;
+  if(!received && relayboard_available && relayboard_online && (ros::Time::now() - time_last_message_received_).toSec() > relayboard_timeout_) {
+    ROS_ERROR("For a long time, no messages from RelayBoard have been received, check com port!");
+    relayboard_online = false;
+  }
+  state_mutex_.unlock();
+  return received;
 }
 
 void NodeClass::sendBatteryVoltage()
 {
+  state_mutex_.lock();
+  bool available = relayboard_available;
   std_msgs::Float64 voltage;
-  voltage.data = m_SerRelayBoard->getBatteryVoltage()/1000.0; //normalize from mV to V
-  topicPub_Voltage.publish(voltage);
+  voltage.data = board_state_.iBattVoltage/1000.0; //normalize from mV to V
+  state_mutex_.unlock();
+
+  if(available) topicPub_Voltage.publish(voltage);
 }
 
-void NodeClass::sendEmergencyStopStates()
+void NodeClass::sendEmergencyStopStates(bool only_transitions)
 {
-  requestBoardStatus();
-
-  if(!relayboard_available) return;
-
-  sendBatteryVoltage();
-
-
   bool EM_signal;
   ros::Duration duration_since_EM_confirmed;
   cob_msgs::EmergencyStopState EM_msg;
 
+  state_mutex_.lock();
+  if(!relayboard_available)
+    {
+      state_mutex_.unlock();
+      return;
+    }
+
   // assign input (laser, button) specific EM state TODO: Laser and Scanner stop can't be read independently (e.g. if button is stop --> no informtion about scanner, if scanner ist stop --> no informtion about button stop)
-  EM_msg.emergency_button_stop = m_SerRelayBoard->isEMStop();
-  EM_msg.scanner_stop = m_SerRelayBoard->isScannerStop();
+  EM_msg.emergency_button_stop = (board_state_.iStatus & 0x0001) != 0;
+  EM_msg.scanner_stop = (board_state_.iStatus & 0x0002) != 0;
 
   // determine current EMStopState
   EM_signal = (EM_msg.emergency_button_stop || EM_msg.scanner_stop);
@@ -262,5 +378,26 @@ void NodeClass::sendEmergencyStopStates()
   if(relayboard_online == false) {
     EM_msg.emergency_state = EM_msg.EMSTOP;
   }
+
+  bool changed = (EM_msg.emergency_state != last_published_state_) ||
+    (EM_msg.emergency_button_stop != last_published_button_) ||
+    (EM_msg.scanner_stop != last_published_scanner_);
+  last_published_state_ = EM_msg.emergency_state;
+  last_published_button_ = EM_msg.emergency_button_stop;
+  last_published_scanner_ = EM_msg.scanner_stop;
+
+  if(blackboard_.isOpen())
+    {
+      RobotStateBlackboard::EmergencyStopData data;
+      data.iState = EM_msg.emergency_state;
+      data.bButtonStop = EM_msg.emergency_button_stop;
+      data.bScannerStop = EM_msg.scanner_stop;
+      data.bOnline = relayboard_online;
+      data.dStampS = RobotStateBlackboard::getMonotonicTime();
+      blackboard_.writeEmergencyStop(data);
+    }
+  state_mutex_.unlock();
+
+  if(only_transitions && !changed) return;
   topicPub_isEmergencyStop.publish(EM_msg);
 }
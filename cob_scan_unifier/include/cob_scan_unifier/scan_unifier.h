@@ -0,0 +1,201 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SCAN_UNIFIER_H
+#define SCAN_UNIFIER_H
+
+//##################
+//#### includes ####
+
+// standard includes
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+// ROS includes
+#include <tf/transform_datatypes.h>
+
+// ROS message includes
+#include <geometry_msgs/Twist.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+
+
+//######################
+//#### fusion class ####
+
+/**
+ * Unifies laser scans with known transforms into one scan, without ROS communication.
+ * Used by ScanUnifierNode and by the scan_unifier_benchmark.
+ */
+class ScanUnifier
+{
+  public:
+    /** @struct Config
+     *  @brief This structure holds the geometry of the unified scan
+     *  @var Config::angle_min
+     *  Member 'angle_min' contains the first angle of the unified scan
+     *  @var Config::angle_max
+     *  Member 'angle_max' contains the last angle of the unified scan
+     *  @var Config::angle_increment
+     *  Member 'angle_increment' contains the angular resolution of the unified scan
+     *  @var Config::num_threads
+     *  Member 'num_threads' contains the number of threads used for unifying
+     *  @var Config::keep_points
+     *  Member 'keep_points' defines whether the point of the nearest hit per bin is kept for fillCloud
+     */
+    struct Config{
+      double angle_min;
+      double angle_max;
+      double angle_increment;
+      int num_threads;
+      bool keep_points;
+    };
+
+    ScanUnifier();
+    ~ScanUnifier();
+
+    /**
+     * @function setConfig
+     * @brief sets the geometry and restarts the worker threads if num_threads changed, not while unify() runs
+     */
+    void setConfig(const Config &config);
+    const Config &getConfig() const { return config_; }
+
+    /**
+     * @function setNumInputs
+     * @brief sets the number of scans that are unified, their transforms have to be set again
+     */
+    void setNumInputs(const size_t num_inputs);
+
+    /**
+     * @function setTransform
+     * @brief sets the transform from the frame of an input to the unified frame
+     */
+    void setTransform(const size_t input, const tf::Transform &transform);
+
+    /**
+     * @function unify
+     * @brief unifies one scan of every input into unified_scan, stamped with the first scan and the given frame
+     *
+     * Every beam is transformed directly into the unified frame and binned, no intermediate point cloud is created.
+     * The inputs are binned separately and then reduced to the nearest hit per bin, both steps run on num_threads threads.
+     * If twist is not zero, every beam is moved to the stamp of the unified scan assuming a constant velocity of the base.
+     * unified_scan keeps its capacity, so a reused message is filled without allocations.
+     */
+    void unify(const std::vector<sensor_msgs::LaserScan::ConstPtr>& scans, const std::string &frame, const geometry_msgs::Twist &twist, sensor_msgs::LaserScan &unified_scan);
+
+    /**
+     * @function fillCloud
+     * @brief writes the points of all bins with a hit of the last unify() to cloud, in the order of the bins
+     *
+     * Needs keep_points, the points were computed while binning.
+     */
+    void fillCloud(const sensor_msgs::LaserScan &unified_scan, sensor_msgs::PointCloud2 &cloud) const;
+
+  private:
+    /** @struct input_cache_struct
+     *  @brief This structure holds the precomputed data of one input scan
+     *  @var input_cache_struct::transform
+     *  Member 'transform' contains the transform from the scanner frame to the unified frame
+     *  @var input_cache_struct::cos_table
+     *  Member 'cos_table' contains the cosine of each beam angle in the scanner frame
+     *  @var input_cache_struct::sin_table
+     *  Member 'sin_table' contains the sine of each beam angle in the scanner frame
+     *  @var input_cache_struct::bin_ranges
+     *  Member 'bin_ranges' contains the nearest hit of this input per bin of the unified scan
+     *  @var input_cache_struct::bin_intensities
+     *  Member 'bin_intensities' contains the intensity of the nearest hit per bin
+     *  @var input_cache_struct::bin_x
+     *  Member 'bin_x' (and 'bin_y', 'bin_z') contains the point of the nearest hit per bin, only if keep_points is set
+     */
+    struct input_cache_struct{
+      tf::Transform transform;
+      float angle_min;
+      float angle_increment;
+      std::vector<float> cos_table;
+      std::vector<float> sin_table;
+      std::vector<float> bin_ranges;
+      std::vector<float> bin_intensities;
+      std::vector<float> bin_x;
+      std::vector<float> bin_y;
+      std::vector<float> bin_z;
+    };
+
+    Config config_;
+    std::vector<input_cache_struct> input_cache_;
+
+    // points of the bins of the unified scan, reduced like its ranges, only used if keep_points is set
+    std::vector<float> bin_x_, bin_y_, bin_z_;
+
+    // num_threads - 1 workers of runParallel, started by setConfig and waiting for a job between the scans
+    std::vector<boost::shared_ptr<boost::thread> > workers_;
+    boost::mutex pool_mutex_;
+    // signals a new job (or stop_) to the workers and the end of the last chunk to runParallel
+    boost::condition_variable work_cond_;
+    boost::condition_variable done_cond_;
+    // current job of runParallel, worker i runs chunk i of job_chunks_, protected by pool_mutex_
+    const boost::function<void (size_t, size_t)> *job_;
+    size_t job_count_;
+    size_t job_chunks_;
+    size_t chunks_pending_;
+    unsigned long job_generation_;
+    bool stop_;
+
+    /**
+     * @function updateBeamTables
+     * @brief recomputes the sin/cos tables of an input if its scan geometry changed
+     */
+    void updateBeamTables(const sensor_msgs::LaserScan &scan, input_cache_struct &cache);
+
+    /**
+     * @function binScan
+     * @brief transforms every beam of one input into the unified frame and keeps the nearest hit per bin
+     */
+    void binScan(const sensor_msgs::LaserScan &scan, input_cache_struct &cache, const sensor_msgs::LaserScan &unified_scan, const geometry_msgs::Twist &twist);
+
+    /**
+     * @function binScans
+     * @brief calls binScan for the inputs [first, last)
+     */
+    void binScans(const std::vector<sensor_msgs::LaserScan::ConstPtr>& scans, const sensor_msgs::LaserScan &unified_scan, const geometry_msgs::Twist &twist, const size_t first, const size_t last);
+
+    /**
+     * @function reduceBins
+     * @brief takes the nearest hit of all inputs for the bins [first, last) of the unified scan
+     */
+    void reduceBins(sensor_msgs::LaserScan &unified_scan, const size_t first, const size_t last);
+
+    /**
+     * @function runParallel
+     * @brief splits [0, count) into num_threads chunks and runs job on each
+     */
+    void runParallel(const boost::function<void (size_t, size_t)> &job, const size_t count);
+
+    void startWorkers(const size_t num_workers);
+    void stopWorkers();
+    void workerThread(const size_t index, unsigned long generation);
+
+    // not copyable
+    ScanUnifier(const ScanUnifier&);
+    ScanUnifier& operator=(const ScanUnifier&);
+};
+#endif
@@ -31,14 +31,13 @@
 #include <tf/transform_listener.h>
 #include <tf/tf.h>
 #include <tf/transform_datatypes.h>
-#include <sensor_msgs/PointCloud.h>
-#include <laser_geometry/laser_geometry.h>
-#include <message_filters/subscriber.h>
-#include <message_filters/synchronizer.h>
-#include <message_filters/sync_policies/approximate_time.h>
 
 // ROS message includes
 #include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <nav_msgs/Odometry.h>
+
+#include <cob_scan_unifier/scan_unifier.h>
 
 
 //####################
@@ -54,28 +53,84 @@ class ScanUnifierNode
      *  Member 'loop_rate' contains the loop rate of the ros node
      *  @var config_struct::input_scan_topics
      *  Member 'input_scan_topics' contains the names of the input scan topics
+     *  @var config_struct::sync_window
+     *  Member 'sync_window' contains the maximal time difference between the scans which are unified
+     *  @var config_struct::cache_transforms
+     *  Member 'cache_transforms' defines whether the transforms of the scanners are looked up only once
+     *  @var config_struct::angle_min
+     *  Member 'angle_min' contains the first angle of the unified scan
+     *  @var config_struct::angle_max
+     *  Member 'angle_max' contains the last angle of the unified scan
+     *  @var config_struct::angle_increment
+     *  Member 'angle_increment' contains the angular resolution of the unified scan
+     *  @var config_struct::num_threads
+     *  Member 'num_threads' contains the number of threads used for unifying
+     *  @var config_struct::deskew
+     *  Member 'deskew' defines whether each beam is motion compensated with the odometry before binning
+     *  @var config_struct::publish_cloud
+     *  Member 'publish_cloud' defines whether the points of the unified scan are published as point cloud
      */
     struct config_struct{
       int number_input_scans;
       std::vector<std::string> input_scan_topics;
+      double sync_window;
+      bool cache_transforms;
+      double angle_min;
+      double angle_max;
+      double angle_increment;
+      int num_threads;
+      bool deskew;
+      bool publish_cloud;
     };
 
     config_struct config_;
 
+    /** @struct input_cache_struct
+     *  @brief This structure holds the transform of one input scan
+     *  @var input_cache_struct::transform_valid
+     *  Member 'transform_valid' is true if 'transform' holds the cached transform of the scanner frame
+     */
+    struct input_cache_struct{
+      bool transform_valid;
+      tf::StampedTransform transform;
+    };
+
+    std::vector<input_cache_struct> input_cache_;
+
+    // binning and reduction of the scans, the node only looks up the transforms
+    ScanUnifier unifier_;
+
+    // reused for every unified scan (and point cloud) while no subscriber holds it
+    sensor_msgs::LaserScan::Ptr unified_scan_;
+    sensor_msgs::PointCloud2::Ptr unified_cloud_;
+
+    // latest velocity of the base, used for deskewing
+    ros::Subscriber odometry_subscriber_;
+    geometry_msgs::Twist base_twist_;
+
+    /**
+     * @function odometryCallback
+     * @brief stores the current velocity of the base
+     */
+    void odometryCallback(const nav_msgs::Odometry::ConstPtr& odometry);
+
     std::string frame_;
 
-    std::vector<message_filters::Subscriber<sensor_msgs::LaserScan>* > message_filter_subscribers_;
+    std::vector<ros::Subscriber> scan_subscribers_;
 
-    message_filters::Synchronizer<message_filters::sync_policies::ApproximateTime<sensor_msgs::LaserScan, sensor_msgs::LaserScan> >* synchronizer2_;
-    message_filters::Synchronizer<message_filters::sync_policies::ApproximateTime<sensor_msgs::LaserScan, sensor_msgs::LaserScan, sensor_msgs::LaserScan> >* synchronizer3_;
+    // latest scan of each input, reset after it was unified
+    std::vector<sensor_msgs::LaserScan::ConstPtr> current_scans_;
 
-    void messageFilterCallback(const sensor_msgs::LaserScan::ConstPtr& first_scanner, const sensor_msgs::LaserScan::ConstPtr& second_scanner);
-    void messageFilterCallback(const sensor_msgs::LaserScan::ConstPtr& first_scanner, const sensor_msgs::LaserScan::ConstPtr& second_scanner, const sensor_msgs::LaserScan::ConstPtr& third_scanner);
+    /**
+     * @function scanCallback
+     * @brief stores the scan of one input and unifies as soon as all inputs have a scan within the sync window
+     */
+    void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan, const size_t index);
 
   public:
 
-    // constructor
-    ScanUnifierNode();
+    // constructor, used by the scan_unifier_node with the global and private node handle and by the cob_scan_unifier/ScanUnifierNodelet
+    ScanUnifierNode(const ros::NodeHandle &nh, const ros::NodeHandle &pnh);
 
     // destructor
     ~ScanUnifierNode();
@@ -89,13 +144,11 @@ class ScanUnifierNode
 
     // declaration of ros publishers
     ros::Publisher topicPub_LaserUnified_;
+    ros::Publisher topicPub_CloudUnified_;
 
     // tf listener
     tf::TransformListener listener_;
 
-    // laser geometry projector
-    laser_geometry::LaserProjection projector_;
-
     /* ----------------------------------- */
     /* ----------- functions ------------- */
     /* ----------------------------------- */
@@ -109,6 +162,12 @@ class ScanUnifierNode
      */
     void getParams();
 
+    /**
+     * @function getTransform
+     * @brief updates the transform from the scanner to the unified frame in cache, if it is not cached already
+     */
+    bool getTransform(const sensor_msgs::LaserScan &scan, input_cache_struct &cache);
+
     /**
      * @function unifieLaserScans
      * @brief unifie the scan information from all laser scans in vec_laser_struct_
@@ -117,7 +176,7 @@ class ScanUnifierNode
      * output:
      * @param: a laser scan message containing unified information from all scanners
      */
-    bool unifyLaserScans(std::vector<sensor_msgs::LaserScan::ConstPtr> current_scans, sensor_msgs::LaserScan &unified_scan);
+    bool unifyLaserScans(const std::vector<sensor_msgs::LaserScan::ConstPtr>& current_scans, sensor_msgs::LaserScan &unified_scan);
 
 };
 #endif
@@ -0,0 +1,392 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cob_scan_unifier/scan_unifier.h>
+#include <cob_utilities/Trace.h>
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+ScanUnifier::ScanUnifier() : job_(NULL), job_count_(0), job_chunks_(0), chunks_pending_(0), job_generation_(0), stop_(false)
+{
+  config_.angle_increment = M_PI/180.0/2.0;
+  config_.angle_min = -M_PI + config_.angle_increment*0.01;
+  config_.angle_max =  M_PI - config_.angle_increment*0.01;
+  config_.num_threads = 1;
+  config_.keep_points = false;
+}
+
+ScanUnifier::~ScanUnifier()
+{
+  stopWorkers();
+}
+
+void ScanUnifier::setConfig(const Config &config)
+{
+  config_ = config;
+  if(config_.num_threads < 1)
+    config_.num_threads = 1;
+  if(workers_.size() != (size_t)config_.num_threads - 1)
+  {
+    stopWorkers();
+    startWorkers(config_.num_threads - 1);
+  }
+}
+
+void ScanUnifier::setNumInputs(const size_t num_inputs)
+{
+  input_cache_.resize(num_inputs);
+  for(size_t i = 0; i < num_inputs; i++)
+  {
+    input_cache_[i].transform.setIdentity();
+    input_cache_[i].angle_min = 0.0;
+    input_cache_[i].angle_increment = 0.0;
+    input_cache_[i].cos_table.clear();
+    input_cache_[i].sin_table.clear();
+  }
+}
+
+void ScanUnifier::setTransform(const size_t input, const tf::Transform &transform)
+{
+  input_cache_.at(input).transform = transform;
+}
+
+/**
+ * @function unify
+ * @brief unifies one scan of every input into unified_scan
+ */
+void ScanUnifier::unify(const std::vector<sensor_msgs::LaserScan::ConstPtr>& scans, const std::string &frame, const geometry_msgs::Twist &twist, sensor_msgs::LaserScan &unified_scan)
+{
+  TRACE_SCOPE("ScanUnifier::unify");
+
+  unified_scan.header = scans.at(0)->header;
+  unified_scan.header.frame_id = frame;
+  unified_scan.angle_increment = config_.angle_increment;
+  unified_scan.angle_min = config_.angle_min;
+  unified_scan.angle_max = config_.angle_max;
+  unified_scan.time_increment = 0.0;
+  unified_scan.scan_time = scans.at(0)->scan_time;
+  unified_scan.range_min = scans.at(0)->range_min;
+  unified_scan.range_max = scans.at(0)->range_max;
+
+  // assign keeps the capacity of the reused message
+  const size_t num_bins = round((unified_scan.angle_max - unified_scan.angle_min) / unified_scan.angle_increment) + 1;
+  unified_scan.ranges.assign(num_bins, 0.0f);
+  unified_scan.intensities.assign(num_bins, 0.0f);
+  if(config_.keep_points)
+  {
+    bin_x_.resize(num_bins);
+    bin_y_.resize(num_bins);
+    bin_z_.resize(num_bins);
+  }
+
+  for(size_t j = 0; j < scans.size(); j++)
+    updateBeamTables(*scans[j], input_cache_.at(j));
+
+  runParallel(boost::bind(&ScanUnifier::binScans, this, boost::cref(scans), boost::cref(unified_scan), boost::cref(twist), _1, _2), scans.size());
+  runParallel(boost::bind(&ScanUnifier::reduceBins, this, boost::ref(unified_scan), _1, _2), num_bins);
+}
+
+/**
+ * @function updateBeamTables
+ * @brief recomputes the sin/cos tables of an input if its scan geometry changed
+ */
+void ScanUnifier::updateBeamTables(const sensor_msgs::LaserScan &scan, input_cache_struct &cache)
+{
+  if(cache.cos_table.size() == scan.ranges.size() &&
+     cache.angle_min == scan.angle_min && cache.angle_increment == scan.angle_increment)
+    return;
+
+  cache.angle_min = scan.angle_min;
+  cache.angle_increment = scan.angle_increment;
+  cache.cos_table.resize(scan.ranges.size());
+  cache.sin_table.resize(scan.ranges.size());
+  for(size_t i = 0; i < scan.ranges.size(); i++)
+  {
+    const double angle = scan.angle_min + i * scan.angle_increment;
+    cache.cos_table[i] = cos(angle);
+    cache.sin_table[i] = sin(angle);
+  }
+}
+
+/**
+ * @function binScan
+ * @brief transforms every beam of one input into the unified frame and keeps the nearest hit per bin
+ */
+void ScanUnifier::binScan(const sensor_msgs::LaserScan &scan, input_cache_struct &cache, const sensor_msgs::LaserScan &unified_scan, const geometry_msgs::Twist &twist)
+{
+  const size_t num_bins = unified_scan.ranges.size();
+  cache.bin_ranges.assign(num_bins, 0.0f);
+  cache.bin_intensities.assign(num_bins, 0.0f);
+
+  // the points are only kept for the point cloud, they are valid where bin_ranges is not 0
+  const bool cloud = config_.keep_points;
+  if(cloud)
+  {
+    cache.bin_x.resize(num_bins);
+    cache.bin_y.resize(num_bins);
+    cache.bin_z.resize(num_bins);
+  }
+
+  float *ranges = &cache.bin_ranges[0];
+  float *intensities = &cache.bin_intensities[0];
+  const double angle_min = unified_scan.angle_min;
+  const double angle_max = unified_scan.angle_max;
+  const double inv_increment = 1.0 / unified_scan.angle_increment;
+
+  // only the x and y components of the transformed beams are used for binning, z only for the point cloud
+  const tf::Matrix3x3 &basis = cache.transform.getBasis();
+  const tf::Vector3 &origin = cache.transform.getOrigin();
+  const float r00 = basis[0][0], r01 = basis[0][1], r10 = basis[1][0], r11 = basis[1][1];
+  const float r20 = basis[2][0], r21 = basis[2][1];
+  const float tx = origin.x(), ty = origin.y(), tz = origin.z();
+  const bool has_intensities = (scan.intensities.size() == scan.ranges.size());
+  const float range_min = scan.range_min, range_max = scan.range_max;
+  const float *cos_table = scan.ranges.empty() ? NULL : &cache.cos_table[0];
+  const float *sin_table = scan.ranges.empty() ? NULL : &cache.sin_table[0];
+
+  // motion of the base from the unified stamp to the first beam and per beam
+  const bool deskew = (twist.linear.x != 0.0 || twist.linear.y != 0.0 || twist.angular.z != 0.0);
+  const float dt_first = (scan.header.stamp - unified_scan.header.stamp).toSec();
+  const float dt_beam = scan.time_increment;
+  const float vx = twist.linear.x, vy = twist.linear.y, wz = twist.angular.z;
+
+  for (size_t i = 0; i < scan.ranges.size(); i++)
+  {
+    const float r = scan.ranges[i];
+    // same filtering as laser_geometry's projection (this also rejects nan)
+    if (!(r >= range_min && r <= range_max))
+      continue;
+
+    float x = tx + r * (r00 * cos_table[i] + r01 * sin_table[i]);
+    float y = ty + r * (r10 * cos_table[i] + r11 * sin_table[i]);
+
+    if (deskew)
+    {
+      // the base moved by (vx, vy, wz)*dt since the unified stamp, move the point into the base frame at that stamp
+      // (the rotation during one scan is small, so cos/sin are approximated by their taylor series)
+      const float dt = dt_first + i * dt_beam;
+      const float a = wz * dt;
+      const float c = 1.0f - 0.5f * a * a, s = a - a * a * a / 6.0f;
+      const float xr = c * x - s * y + vx * dt;
+      const float yr = s * x + c * y + vy * dt;
+      x = xr;
+      y = yr;
+    }
+
+    const double angle = atan2(y, x);
+    if (angle < angle_min || angle > angle_max)
+      continue;
+
+    const int index = std::floor(0.5 + (angle - angle_min) * inv_increment);
+    if(index < 0 || index >= (int)num_bins) continue;
+
+    const float range = sqrtf(x*x + y*y);
+    if( (ranges[index] == 0) || (range <= ranges[index]) )
+    {
+      // use the nearest reflection point of the scan
+      ranges[index] = range;
+      intensities[index] = has_intensities ? scan.intensities[i] : 0.0f;
+      if(cloud)
+      {
+        cache.bin_x[index] = x;
+        cache.bin_y[index] = y;
+        cache.bin_z[index] = tz + r * (r20 * cos_table[i] + r21 * sin_table[i]);
+      }
+    }
+  }
+}
+
+/**
+ * @function binScans
+ * @brief calls binScan for the inputs [first, last)
+ */
+void ScanUnifier::binScans(const std::vector<sensor_msgs::LaserScan::ConstPtr>& scans, const sensor_msgs::LaserScan &unified_scan, const geometry_msgs::Twist &twist, const size_t first, const size_t last)
+{
+  for(size_t j = first; j < last; j++)
+    binScan(*scans[j], input_cache_[j], unified_scan, twist);
+}
+
+/**
+ * @function reduceBins
+ * @brief takes the nearest hit of all inputs for the bins [first, last) of the unified scan
+ */
+void ScanUnifier::reduceBins(sensor_msgs::LaserScan &unified_scan, const size_t first, const size_t last)
+{
+  float *ranges = &unified_scan.ranges[0];
+  float *intensities = &unified_scan.intensities[0];
+  const bool cloud = config_.keep_points;
+
+  // later inputs win on equal ranges, like binning all inputs into one scan would do
+  for(size_t j = 0; j < input_cache_.size(); j++)
+  {
+    const input_cache_struct &cache = input_cache_[j];
+    const float *bin_ranges = &cache.bin_ranges[0];
+    const float *bin_intensities = &cache.bin_intensities[0];
+    for(size_t i = first; i < last; i++)
+    {
+      if(bin_ranges[i] != 0 && (ranges[i] == 0 || bin_ranges[i] <= ranges[i]))
+      {
+        ranges[i] = bin_ranges[i];
+        intensities[i] = bin_intensities[i];
+        if(cloud)
+        {
+          bin_x_[i] = cache.bin_x[i];
+          bin_y_[i] = cache.bin_y[i];
+          bin_z_[i] = cache.bin_z[i];
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @function fillCloud
+ * @brief writes the points of all bins with a hit to cloud, the points were computed while binning
+ */
+void ScanUnifier::fillCloud(const sensor_msgs::LaserScan &unified_scan, sensor_msgs::PointCloud2 &cloud) const
+{
+  const size_t num_bins = unified_scan.ranges.size();
+  size_t num_points = 0;
+  for(size_t i = 0; i < num_bins; i++)
+  {
+    if(unified_scan.ranges[i] != 0)
+      num_points++;
+  }
+
+  cloud.header = unified_scan.header;
+  cloud.height = 1;
+  cloud.width = num_points;
+  cloud.is_bigendian = false;
+  cloud.is_dense = true;
+  if(cloud.fields.size() != 4)
+  {
+    const char *names[4] = {"x", "y", "z", "intensity"};
+    cloud.fields.resize(4);
+    for(size_t f = 0; f < 4; f++)
+    {
+      cloud.fields[f].name = names[f];
+      cloud.fields[f].offset = f * sizeof(float);
+      cloud.fields[f].datatype = sensor_msgs::PointField::FLOAT32;
+      cloud.fields[f].count = 1;
+    }
+  }
+  cloud.point_step = 4 * sizeof(float);
+  cloud.row_step = cloud.point_step * num_points;
+  // resize keeps the capacity of the reused message
+  cloud.data.resize(cloud.row_step);
+
+  float *point = num_points ? reinterpret_cast<float*>(&cloud.data[0]) : NULL;
+  for(size_t i = 0; i < num_bins; i++)
+  {
+    if(unified_scan.ranges[i] == 0)
+      continue;
+    point[0] = bin_x_[i];
+    point[1] = bin_y_[i];
+    point[2] = bin_z_[i];
+    point[3] = unified_scan.intensities[i];
+    point += 4;
+  }
+}
+
+/**
+ * @function runParallel
+ * @brief splits [0, count) into num_threads chunks and runs job on each, the first chunk in the calling thread
+ */
+void ScanUnifier::runParallel(const boost::function<void (size_t, size_t)> &job, const size_t count)
+{
+  const size_t num_jobs = std::max<size_t>(1, std::min<size_t>(workers_.size() + 1, count));
+  if(num_jobs == 1)
+  {
+    job(0, count);
+    return;
+  }
+
+  {
+    boost::mutex::scoped_lock lock(pool_mutex_);
+    job_ = &job;
+    job_count_ = count;
+    job_chunks_ = num_jobs;
+    chunks_pending_ = num_jobs - 1;
+    job_generation_++;
+  }
+  work_cond_.notify_all();
+
+  job(0, count / num_jobs);
+
+  boost::mutex::scoped_lock lock(pool_mutex_);
+  while(chunks_pending_ > 0)
+    done_cond_.wait(lock);
+  job_ = NULL;
+}
+
+/**
+ * @function startWorkers
+ * @brief starts the worker threads of runParallel, worker i takes chunk i
+ */
+void ScanUnifier::startWorkers(const size_t num_workers)
+{
+  boost::mutex::scoped_lock lock(pool_mutex_);
+  stop_ = false;
+  for(size_t i = 1; i <= num_workers; i++)
+    workers_.push_back(boost::shared_ptr<boost::thread>(new boost::thread(&ScanUnifier::workerThread, this, i, job_generation_)));
+}
+
+/**
+ * @function stopWorkers
+ * @brief ends and joins the worker threads
+ */
+void ScanUnifier::stopWorkers()
+{
+  {
+    boost::mutex::scoped_lock lock(pool_mutex_);
+    stop_ = true;
+  }
+  work_cond_.notify_all();
+  for(size_t i = 0; i < workers_.size(); i++)
+    workers_[i]->join();
+  workers_.clear();
+}
+
+/**
+ * @function workerThread
+ * @brief runs its chunk of every job with a generation after the given one until stop_ is set
+ */
+void ScanUnifier::workerThread(const size_t index, unsigned long generation)
+{
+  boost::mutex::scoped_lock lock(pool_mutex_);
+  while(true)
+  {
+    while(!stop_ && job_generation_ == generation)
+      work_cond_.wait(lock);
+    if(stop_)
+      return;
+    generation = job_generation_;
+    if(index >= job_chunks_)
+      continue;
+
+    const boost::function<void (size_t, size_t)> &job = *job_;
+    const size_t first = index * job_count_ / job_chunks_;
+    const size_t last = (index + 1) * job_count_ / job_chunks_;
+    lock.unlock();
+    job(first, last);
+    lock.lock();
+    if(--chunks_pending_ == 0)
+      done_cond_.notify_one();
+  }
+}
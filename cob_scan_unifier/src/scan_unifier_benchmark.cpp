@@ -0,0 +1,378 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Measures ScanUnifier on scan sets with static transforms, without ROS transport and tf.
+ *
+ * usage: scan_unifier_benchmark [recorded.bag frame input_scan_1 input_scan_2 ...]
+ *
+ * Without arguments, scans of a rectangular room are synthesized for 2 to 6 scanners mounted on a
+ * platform, at 0.25, 0.5 and 1 degree resolution of the scanners and the unified scan.
+ * With a bag, the scans of the given topics are grouped into sets (the next scan of every input)
+ * and unified with the transforms of /tf_static and /tf from the scanner frames to frame, at the
+ * same three resolutions of the unified scan.
+ *
+ * Reports the time and the heap allocations per fusion with a reused message, the bins that differ
+ * from a straightforward projection in double precision, and the time with 4 threads together with
+ * whether the result is identical to the single-threaded one.
+ */
+
+//##################
+//#### includes ####
+
+// standard includes
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+// ROS includes
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <tf/tf.h>
+
+// ROS message includes
+#include <sensor_msgs/LaserScan.h>
+#include <tf2_msgs/TFMessage.h>
+
+#include <cob_scan_unifier/scan_unifier.h>
+#include <cob_utilities/MicroBenchmark.h>
+
+typedef std::vector<sensor_msgs::LaserScan::ConstPtr> ScanSet;
+
+MICRO_BENCHMARK_ALLOCATION_COUNTER()
+
+static double uniform()
+{
+  return rand() / (RAND_MAX + 1.0);
+}
+
+/**
+ * @function unifyReference
+ * @brief projects every beam like laser_geometry in double precision and bins it into one scan
+ */
+static void unifyReference(const ScanSet &scans, const std::vector<tf::Transform> &transforms, const ScanUnifier::Config &config,
+                           std::vector<float> &ranges)
+{
+  const size_t num_bins = round((config.angle_max - config.angle_min) / config.angle_increment) + 1;
+  ranges.assign(num_bins, 0.0f);
+  for(size_t j = 0; j < scans.size(); j++)
+  {
+    const sensor_msgs::LaserScan &scan = *scans[j];
+    for(size_t i = 0; i < scan.ranges.size(); i++)
+    {
+      const double r = scan.ranges[i];
+      if(!(r >= scan.range_min && r <= scan.range_max))
+        continue;
+      const double beam = scan.angle_min + i * scan.angle_increment;
+      const tf::Vector3 p = transforms[j] * tf::Vector3(r * cos(beam), r * sin(beam), 0.0);
+      const double angle = atan2(p.y(), p.x());
+      if(angle < config.angle_min || angle > config.angle_max)
+        continue;
+      const int index = floor(0.5 + (angle - config.angle_min) / config.angle_increment);
+      if(index < 0 || index >= (int)num_bins)
+        continue;
+      const float range = sqrt(p.x() * p.x() + p.y() * p.y());
+      if(ranges[index] == 0 || range <= ranges[index])
+        ranges[index] = range;
+    }
+  }
+}
+
+/**
+ * @function castRay
+ * @brief distance from (x, y) in direction angle to the walls of a 10 x 8 m room with a pillar
+ */
+static double castRay(const double x, const double y, const double angle)
+{
+  const double dx = cos(angle), dy = sin(angle);
+  double t = 1e9;
+  if(dx > 1e-9) t = std::min(t, (5.0 - x) / dx);
+  if(dx < -1e-9) t = std::min(t, (-5.0 - x) / dx);
+  if(dy > 1e-9) t = std::min(t, (4.0 - y) / dy);
+  if(dy < -1e-9) t = std::min(t, (-4.0 - y) / dy);
+
+  // pillar with radius 0.3 m at (-2, 1)
+  const double ox = x + 2.0, oy = y - 1.0;
+  const double b = ox * dx + oy * dy;
+  const double c = ox * ox + oy * oy - 0.09;
+  const double d = b * b - c;
+  if(d >= 0 && -b - sqrt(d) > 0)
+    t = std::min(t, -b - sqrt(d));
+  return t;
+}
+
+/**
+ * @function synthesize
+ * @brief creates num_sets scan sets of num_inputs scanners on a moving platform, and the transforms of the scanners
+ */
+static void synthesize(const size_t num_inputs, const double increment, const size_t num_sets,
+                       std::vector<ScanSet> &sets, std::vector<tf::Transform> &transforms)
+{
+  // corners and sides of a 0.6 x 0.4 m platform, facing outwards
+  const double mounts[6][3] = {
+    { 0.3,  0.2,  M_PI/4}, {-0.3, -0.2, -3*M_PI/4},
+    { 0.3, -0.2, -M_PI/4}, {-0.3,  0.2,  3*M_PI/4},
+    { 0.0,  0.2,  M_PI/2}, { 0.0, -0.2, -M_PI/2} };
+
+  transforms.resize(num_inputs);
+  for(size_t j = 0; j < num_inputs; j++)
+    transforms[j] = tf::Transform(tf::createQuaternionFromYaw(mounts[j][2]), tf::Vector3(mounts[j][0], mounts[j][1], 0.2));
+
+  const double fov = 270.0 / 180.0 * M_PI;
+  const size_t num_beams = round(fov / increment) + 1;
+  sets.resize(num_sets);
+  for(size_t s = 0; s < num_sets; s++)
+  {
+    // the platform drives through the room
+    const tf::Transform platform(tf::createQuaternionFromYaw(0.01 * s), tf::Vector3(-1.0 + 0.02 * s, 0.5, 0.0));
+    sets[s].resize(num_inputs);
+    for(size_t j = 0; j < num_inputs; j++)
+    {
+      sensor_msgs::LaserScan::Ptr scan(new sensor_msgs::LaserScan);
+      scan->header.stamp = ros::Time(1000.0 + 0.04 * s);
+      scan->header.frame_id = "laser";
+      scan->angle_min = -fov / 2;
+      scan->angle_max = fov / 2;
+      scan->angle_increment = increment;
+      scan->time_increment = 0.04 / (2 * M_PI / increment);
+      scan->scan_time = 0.04;
+      scan->range_min = 0.05;
+      scan->range_max = 29.5;
+      scan->ranges.resize(num_beams);
+      scan->intensities.resize(num_beams);
+
+      const tf::Transform pose = platform * transforms[j];
+      const double yaw = tf::getYaw(pose.getRotation());
+      for(size_t i = 0; i < num_beams; i++)
+      {
+        // 1 % invalid beams, centimeter noise on the others
+        if(uniform() < 0.01)
+          scan->ranges[i] = std::numeric_limits<float>::quiet_NaN();
+        else
+          scan->ranges[i] = castRay(pose.getOrigin().x(), pose.getOrigin().y(), yaw + scan->angle_min + i * increment) + 0.01 * (uniform() - 0.5);
+        scan->intensities[i] = 1000 * uniform();
+      }
+      sets[s][j] = scan;
+    }
+  }
+}
+
+/**
+ * @function loadBag
+ * @brief groups the scans of the topics into sets and looks up the transforms of their frames
+ */
+static bool loadBag(const std::string &file, const std::string &frame, const std::vector<std::string> &topics,
+                    std::vector<ScanSet> &sets, std::vector<tf::Transform> &transforms)
+{
+  rosbag::Bag bag;
+  try
+  {
+    bag.open(file, rosbag::bagmode::Read);
+  }
+  catch(rosbag::BagException &e)
+  {
+    std::cerr << e.what() << std::endl;
+    return false;
+  }
+
+  // the whole bag fits into the cache of the transformer, the scanners are expected not to move
+  tf::Transformer transformer(true, ros::Duration(1e6));
+  ScanSet current(topics.size());
+  std::vector<std::string> query;
+  query.push_back("/tf");
+  query.push_back("/tf_static");
+  query.insert(query.end(), topics.begin(), topics.end());
+  rosbag::View view(bag, rosbag::TopicQuery(query));
+  for(rosbag::View::iterator it = view.begin(); it != view.end(); ++it)
+  {
+    tf2_msgs::TFMessage::ConstPtr tf_msg = it->instantiate<tf2_msgs::TFMessage>();
+    if(tf_msg)
+    {
+      for(size_t k = 0; k < tf_msg->transforms.size(); k++)
+      {
+        tf::StampedTransform transform;
+        tf::transformStampedMsgToTF(tf_msg->transforms[k], transform);
+        transformer.setTransform(transform);
+      }
+      continue;
+    }
+
+    sensor_msgs::LaserScan::ConstPtr scan = it->instantiate<sensor_msgs::LaserScan>();
+    if(!scan)
+      continue;
+    const size_t j = std::find(topics.begin(), topics.end(), it->getTopic()) - topics.begin();
+    if(j == topics.size())
+      continue;
+    current[j] = scan;
+
+    bool complete = true;
+    for(size_t k = 0; k < current.size(); k++)
+      complete = complete && current[k];
+    if(complete)
+    {
+      sets.push_back(current);
+      current.assign(topics.size(), sensor_msgs::LaserScan::ConstPtr());
+    }
+  }
+
+  if(sets.empty())
+  {
+    std::cerr << "no complete scan set in " << file << std::endl;
+    return false;
+  }
+
+  transforms.resize(topics.size());
+  for(size_t j = 0; j < topics.size(); j++)
+  {
+    try
+    {
+      tf::StampedTransform transform;
+      transformer.lookupTransform(frame, sets[0][j]->header.frame_id, ros::Time(0), transform);
+      transforms[j] = transform;
+    }
+    catch(tf::TransformException &ex)
+    {
+      std::cerr << ex.what() << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @function runFusions
+ * @brief unifies all sets repetitions times, returns the time per fusion in us
+ */
+static double runFusions(ScanUnifier &unifier, const std::vector<ScanSet> &sets, const size_t repetitions,
+                         sensor_msgs::LaserScan &unified, unsigned long &allocations_per_fusion)
+{
+  const geometry_msgs::Twist twist;
+
+  // the first fusion sizes the message and the bins
+  unifier.unify(sets[0], "base_link", twist, unified);
+
+  const unsigned long allocations_start = MicroBenchmark::allocations();
+  const double start = MicroBenchmark::getRealTime();
+  for(size_t r = 0; r < repetitions; r++)
+    for(size_t s = 0; s < sets.size(); s++)
+      unifier.unify(sets[s], "base_link", twist, unified);
+  const double duration = MicroBenchmark::getRealTime() - start;
+
+  allocations_per_fusion = (MicroBenchmark::allocations() - allocations_start) / (repetitions * sets.size());
+  return duration / (repetitions * sets.size()) * 1e6;
+}
+
+/**
+ * @function benchmark
+ * @brief measures the fusion of the sets at one resolution of the unified scan and prints one line
+ */
+static void benchmark(const std::vector<ScanSet> &sets, const std::vector<tf::Transform> &transforms, const double increment)
+{
+  ScanUnifier::Config config;
+  config.angle_increment = increment;
+  config.angle_min = -M_PI + increment * 0.01;
+  config.angle_max =  M_PI - increment * 0.01;
+  config.num_threads = 1;
+  config.keep_points = false;
+
+  ScanUnifier unifier;
+  unifier.setConfig(config);
+  unifier.setNumInputs(transforms.size());
+  for(size_t j = 0; j < transforms.size(); j++)
+    unifier.setTransform(j, transforms[j]);
+
+  // about 2 s per measurement on a desktop
+  size_t beams = 0;
+  for(size_t j = 0; j < sets[0].size(); j++)
+    beams += sets[0][j]->ranges.size();
+  const size_t repetitions = std::max<size_t>(1, 20000000 / (beams * sets.size()));
+
+  sensor_msgs::LaserScan unified;
+  unsigned long allocations_single = 0;
+  const double us_single = runFusions(unifier, sets, repetitions, unified, allocations_single);
+
+  // equivalence with the reference on all sets, bins next to a bin border may flip between float and double
+  size_t num_bins = 0, differing = 0;
+  std::vector<float> reference;
+  for(size_t s = 0; s < sets.size(); s++)
+  {
+    unifier.unify(sets[s], "base_link", geometry_msgs::Twist(), unified);
+    unifyReference(sets[s], transforms, config, reference);
+    num_bins += reference.size();
+    for(size_t i = 0; i < reference.size(); i++)
+      if(fabs(unified.ranges[i] - reference[i]) > 1e-3)
+        differing++;
+  }
+
+  // the parallel binning has to give the same result as the single-threaded one
+  sensor_msgs::LaserScan single = unified;
+  config.num_threads = 4;
+  unifier.setConfig(config);
+  sensor_msgs::LaserScan parallel;
+  unsigned long allocations_parallel = 0;
+  const double us_parallel = runFusions(unifier, sets, repetitions, parallel, allocations_parallel);
+  unifier.unify(sets.back(), "base_link", geometry_msgs::Twist(), parallel);
+
+  printf("%zu inputs, %5.2f deg: %8.1f us/fusion, %lu allocations/fusion, %zu of %zu bins differ from reference,"
+         " 4 threads %8.1f us/fusion (%s)\n",
+         transforms.size(), increment * 180.0 / M_PI, us_single, allocations_single, differing, num_bins,
+         us_parallel, (parallel.ranges == single.ranges && parallel.intensities == single.intensities) ? "identical" : "DIFFERENT");
+}
+
+int main(int argc, char** argv)
+{
+  const double resolutions[] = {0.25, 0.5, 1.0};
+  const size_t num_resolutions = sizeof(resolutions)/sizeof(resolutions[0]);
+
+  if(argc > 1)
+  {
+    if(argc < 4)
+    {
+      std::cerr << "usage: " << argv[0] << " [recorded.bag frame input_scan_1 input_scan_2 ...]" << std::endl;
+      return 1;
+    }
+    std::vector<std::string> topics(argv + 3, argv + argc);
+    std::vector<ScanSet> sets;
+    std::vector<tf::Transform> transforms;
+    if(!loadBag(argv[1], argv[2], topics, sets, transforms))
+      return 1;
+    std::cout << sets.size() << " scan sets from " << argv[1] << std::endl;
+    for(size_t r = 0; r < num_resolutions; r++)
+      benchmark(sets, transforms, resolutions[r] / 180.0 * M_PI);
+    return 0;
+  }
+
+  srand(1);
+  for(size_t r = 0; r < num_resolutions; r++)
+  {
+    for(size_t num_inputs = 2; num_inputs <= 6; num_inputs++)
+    {
+      const double increment = resolutions[r] / 180.0 * M_PI;
+      std::vector<ScanSet> sets;
+      std::vector<tf::Transform> transforms;
+      synthesize(num_inputs, increment, 50, sets, transforms);
+      benchmark(sets, transforms, increment);
+    }
+  }
+  return 0;
+}
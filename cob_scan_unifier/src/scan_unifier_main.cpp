@@ -0,0 +1,30 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+ 
+
+#include <cob_scan_unifier/scan_unifier_node.h>
+
+int main(int argc, char** argv)
+{
+  ROS_DEBUG("scan unifier: start scan unifier node");
+  ros::init(argc, argv, "cob_scan_unifier_node");
+
+  ScanUnifierNode scan_unifier_node(ros::NodeHandle(), ros::NodeHandle("~"));
+
+  ros::spin();
+
+  return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Micro-benchmark of ScanUnifier::unify on synthesized scans, without ROS transport and tf.
+ *
+ * usage: scan_unifier_micro_benchmark [--filter=regex] [--format=console|json] [--out=file.json], see MicroBenchmark.h
+ *
+ * The argument is the number of scanners, mounted at the corners and sides of a platform in a
+ * round room with 541 beams each (270 deg at 0.5 deg), unified into one scan at 0.5 deg.
+ */
+
+//##################
+//#### includes ####
+
+// standard includes
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+// ROS message includes
+#include <sensor_msgs/LaserScan.h>
+
+#include <cob_scan_unifier/scan_unifier.h>
+#include <cob_utilities/MicroBenchmark.h>
+
+/**
+ * @function setupInputs
+ * @brief creates one scan per input and sets up the unifier with the transforms of the inputs
+ */
+static void setupInputs(const size_t num_inputs, const double increment, ScanUnifier &unifier,
+                        std::vector<sensor_msgs::LaserScan::ConstPtr> &scans)
+{
+  // corners and sides of a 0.6 x 0.4 m platform, facing outwards
+  const double mounts[6][3] = {
+    { 0.3,  0.2,  M_PI/4}, {-0.3, -0.2, -3*M_PI/4},
+    { 0.3, -0.2, -M_PI/4}, {-0.3,  0.2,  3*M_PI/4},
+    { 0.0,  0.2,  M_PI/2}, { 0.0, -0.2, -M_PI/2} };
+
+  ScanUnifier::Config config;
+  config.angle_increment = increment;
+  config.angle_min = -M_PI + increment * 0.01;
+  config.angle_max =  M_PI - increment * 0.01;
+  config.num_threads = 1;
+  config.keep_points = false;
+  unifier.setConfig(config);
+  unifier.setNumInputs(num_inputs);
+
+  const double fov = 270.0 / 180.0 * M_PI;
+  const size_t num_beams = round(fov / increment) + 1;
+  scans.clear();
+  for(size_t j = 0; j < num_inputs; j++)
+  {
+    const size_t m = j % 6;
+    unifier.setTransform(j, tf::Transform(tf::createQuaternionFromYaw(mounts[m][2]), tf::Vector3(mounts[m][0], mounts[m][1], 0.2)));
+
+    sensor_msgs::LaserScan::Ptr scan(new sensor_msgs::LaserScan);
+    scan->header.stamp = ros::Time(1000.0);
+    scan->header.frame_id = "laser";
+    scan->angle_min = -fov / 2;
+    scan->angle_max = fov / 2;
+    scan->angle_increment = increment;
+    scan->time_increment = 0.04 / (2 * M_PI / increment);
+    scan->scan_time = 0.04;
+    scan->range_min = 0.05;
+    scan->range_max = 29.5;
+    scan->ranges.resize(num_beams);
+    scan->intensities.resize(num_beams);
+    for(size_t i = 0; i < num_beams; i++)
+    {
+      // wall of a room with a radius of about 4 m, seen from the mount of the scanner
+      scan->ranges[i] = 4.0 + 0.5 * sin(3.0 * i * increment + j) + 0.01 * (rand() / (RAND_MAX + 1.0));
+      scan->intensities[i] = rand() % 1000;
+    }
+    scans.push_back(scan);
+  }
+}
+
+/**
+ * @function ScanUnifier_Unify
+ * @brief unifies one scan of every input into a reused message, like the node does for each scan set
+ */
+static void ScanUnifier_Unify(MicroBenchmark::State &state)
+{
+  ScanUnifier unifier;
+  std::vector<sensor_msgs::LaserScan::ConstPtr> scans;
+  setupInputs(state.range(), 0.5 / 180.0 * M_PI, unifier, scans);
+
+  const geometry_msgs::Twist twist;
+  sensor_msgs::LaserScan unified;
+  // the first fusion sizes the message and the bins
+  unifier.unify(scans, "base_link", twist, unified);
+
+  while(state.keepRunning())
+    unifier.unify(scans, "base_link", twist, unified);
+
+  state.setItemsProcessed(state.iterations() * state.range() * scans[0]->ranges.size());
+}
+MICRO_BENCHMARK_ARG(ScanUnifier_Unify, 2);
+MICRO_BENCHMARK_ARG(ScanUnifier_Unify, 4);
+MICRO_BENCHMARK_ARG(ScanUnifier_Unify, 6);
+
+MICRO_BENCHMARK_MAIN()
@@ -16,56 +16,41 @@
  
 
 #include <cob_scan_unifier/scan_unifier_node.h>
+#include <cob_utilities/Trace.h>
+
+#include <algorithm>
 
 // Constructor
-ScanUnifierNode::ScanUnifierNode()
+ScanUnifierNode::ScanUnifierNode(const ros::NodeHandle &nh, const ros::NodeHandle &pnh)
+  : nh_(nh), pnh_(pnh)
 {
   ROS_DEBUG("Init scan_unifier");
 
-  // Create node handles
-  nh_ = ros::NodeHandle();
-  pnh_ = ros::NodeHandle("~");
-
   // Publisher
   topicPub_LaserUnified_ = nh_.advertise<sensor_msgs::LaserScan>("scan_unified", 1);
 
   getParams();
 
-  // Subscribe to Laserscan topics
-
-  for(int i = 0; i < config_.number_input_scans; i++)
+  if(config_.publish_cloud)
   {
-    message_filter_subscribers_.push_back(new message_filters::Subscriber<sensor_msgs::LaserScan>(nh_, config_.input_scan_topics.at(i), 1));
+    topicPub_CloudUnified_ = nh_.advertise<sensor_msgs::PointCloud2>("scan_unified_cloud", 1);
   }
 
+  // Subscribe to Laserscan topics
+  current_scans_.resize(config_.number_input_scans);
+  input_cache_.resize(config_.number_input_scans);
+  unifier_.setNumInputs(config_.number_input_scans);
+  for(int i = 0; i < config_.number_input_scans; i++)
+  {
+    input_cache_[i].transform_valid = false;
 
-  // Initialize message_filters::Synchronizer with the right constructor for the choosen number of inputs.
+    scan_subscribers_.push_back(nh_.subscribe<sensor_msgs::LaserScan>(config_.input_scan_topics.at(i), 1,
+                                boost::bind(&ScanUnifierNode::scanCallback, this, _1, i)));
+  }
 
-  switch (config_.number_input_scans)
+  if(config_.deskew)
   {
-    case 2:
-    {
-      typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::LaserScan, sensor_msgs::LaserScan> SyncPolicy;
-      synchronizer2_ = new message_filters::Synchronizer<SyncPolicy>(SyncPolicy(2), *message_filter_subscribers_.at(0), *message_filter_subscribers_.at(1));
-      // Set the InterMessageLowerBound to double the period of the laser scans publishing ( 1/{(1/2)*f_laserscans} ).
-      synchronizer2_->setInterMessageLowerBound(0, ros::Duration(0.167));
-      synchronizer2_->setInterMessageLowerBound(1, ros::Duration(0.167));
-      synchronizer2_->registerCallback(boost::bind(&ScanUnifierNode::messageFilterCallback, this, _1, _2));
-      break;
-    }
-    case 3:
-    {
-      typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::LaserScan, sensor_msgs::LaserScan, sensor_msgs::LaserScan> SyncPolicy;
-      synchronizer3_ = new message_filters::Synchronizer<SyncPolicy>(SyncPolicy(3), *message_filter_subscribers_.at(0), *message_filter_subscribers_.at(1), *message_filter_subscribers_.at(2));
-      synchronizer3_->setInterMessageLowerBound(0, ros::Duration(0.167));
-      synchronizer3_->setInterMessageLowerBound(1, ros::Duration(0.167));
-      synchronizer3_->setInterMessageLowerBound(2, ros::Duration(0.167));
-      synchronizer3_->registerCallback(boost::bind(&ScanUnifierNode::messageFilterCallback, this, _1, _2, _3));
-      break;
-    }
-    default:
-      ROS_ERROR_STREAM(config_.number_input_scans << " topics have been set as input, but scan_unifier doesn't support this.");
-      return;
+    odometry_subscriber_ = nh_.subscribe("odometry", 1, &ScanUnifierNode::odometryCallback, this);
   }
 
   ros::Duration(1.0).sleep();
@@ -75,8 +60,6 @@ ScanUnifierNode::ScanUnifierNode()
 
 ScanUnifierNode::~ScanUnifierNode()
 {
-  delete(synchronizer2_);
-  delete(synchronizer3_);
 }
 
 /**
@@ -106,139 +89,173 @@ void ScanUnifierNode::getParams()
     ROS_WARN("No parameter frame on parameter server. Using default value [base_link].");
   }
   pnh_.param<std::string>("frame", frame_, "base_link");
+
+  if(!pnh_.hasParam("sync_window"))
+  {
+    ROS_WARN("No parameter sync_window on parameter server. Using default value [0.1].");
+  }
+  pnh_.param<double>("sync_window", config_.sync_window, 0.1);
+
+  if(!pnh_.hasParam("cache_transforms"))
+  {
+    ROS_WARN("No parameter cache_transforms on parameter server. Using default value [true].");
+  }
+  pnh_.param<bool>("cache_transforms", config_.cache_transforms, true);
+
+  pnh_.param<double>("angle_increment", config_.angle_increment, M_PI/180.0/2.0);
+  if(config_.angle_increment <= 0.0)
+  {
+    ROS_WARN("Parameter angle_increment has to be positive. Using default value [%f].", M_PI/180.0/2.0);
+    config_.angle_increment = M_PI/180.0/2.0;
+  }
+  pnh_.param<double>("angle_min", config_.angle_min, -M_PI + config_.angle_increment*0.01);
+  pnh_.param<double>("angle_max", config_.angle_max,  M_PI - config_.angle_increment*0.01);
+  if(config_.angle_max <= config_.angle_min)
+  {
+    ROS_WARN("Parameter angle_max has to be greater than angle_min. Using the full field of view.");
+    config_.angle_min = -M_PI + config_.angle_increment*0.01;
+    config_.angle_max =  M_PI - config_.angle_increment*0.01;
+  }
+
+  pnh_.param<int>("num_threads", config_.num_threads, 1);
+  if(config_.num_threads < 1)
+    config_.num_threads = 1;
+
+  pnh_.param<bool>("deskew", config_.deskew, false);
+
+  pnh_.param<bool>("publish_cloud", config_.publish_cloud, false);
+
+  ScanUnifier::Config unifier_config;
+  unifier_config.angle_min = config_.angle_min;
+  unifier_config.angle_max = config_.angle_max;
+  unifier_config.angle_increment = config_.angle_increment;
+  unifier_config.num_threads = config_.num_threads;
+  unifier_config.keep_points = config_.publish_cloud;
+  unifier_.setConfig(unifier_config);
+}
+
+void ScanUnifierNode::odometryCallback(const nav_msgs::Odometry::ConstPtr& odometry)
+{
+  base_twist_ = odometry->twist.twist;
 }
 
 
-void ScanUnifierNode::messageFilterCallback(const sensor_msgs::LaserScan::ConstPtr& scan1, const sensor_msgs::LaserScan::ConstPtr& scan2)
+void ScanUnifierNode::scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan, const size_t index)
 {
-  std::vector<sensor_msgs::LaserScan::ConstPtr> current_scans;
-  current_scans.push_back(scan1);
-  current_scans.push_back(scan2);
+  current_scans_.at(index) = scan;
+
+  // wait until every input delivered a scan
+  ros::Time oldest = scan->header.stamp, newest = scan->header.stamp;
+  for(size_t i = 0; i < current_scans_.size(); i++)
+  {
+    if(!current_scans_[i])
+      return;
+    oldest = std::min(oldest, current_scans_[i]->header.stamp);
+    newest = std::max(newest, current_scans_[i]->header.stamp);
+  }
 
-  sensor_msgs::LaserScan unified_scan = sensor_msgs::LaserScan();
-  if (!unifyLaserScans(current_scans, unified_scan))
+  // drop scans which are too old to be unified with the newest one, their inputs will deliver a fresher scan
+  if((newest - oldest).toSec() > config_.sync_window)
   {
+    for(size_t i = 0; i < current_scans_.size(); i++)
+    {
+      if((newest - current_scans_[i]->header.stamp).toSec() > config_.sync_window)
+        current_scans_[i].reset();
+    }
     return;
   }
 
-  ROS_DEBUG("Publishing unified scan.");
-  topicPub_LaserUnified_.publish(unified_scan);
-}
+  // the last unified scan is reused unless a subscriber in this process or the publisher still holds it
+  if(!unified_scan_ || !unified_scan_.unique())
+    unified_scan_.reset(new sensor_msgs::LaserScan);
 
-void ScanUnifierNode::messageFilterCallback(const sensor_msgs::LaserScan::ConstPtr& scan1, const sensor_msgs::LaserScan::ConstPtr& scan2, const sensor_msgs::LaserScan::ConstPtr& scan3)
-{
-  std::vector<sensor_msgs::LaserScan::ConstPtr> current_scans;
-  current_scans.push_back(scan1);
-  current_scans.push_back(scan2);
-  current_scans.push_back(scan3);
+  bool unified = unifyLaserScans(current_scans_, *unified_scan_);
+
+  for(size_t i = 0; i < current_scans_.size(); i++)
+    current_scans_[i].reset();
 
-  sensor_msgs::LaserScan unified_scan = sensor_msgs::LaserScan();
-  if (!unifyLaserScans(current_scans, unified_scan))
+  if (!unified)
   {
     return;
   }
 
   ROS_DEBUG("Publishing unified scan.");
-  topicPub_LaserUnified_.publish(unified_scan);
+  topicPub_LaserUnified_.publish(unified_scan_);
+
+  if(config_.publish_cloud)
+  {
+    if(!unified_cloud_ || !unified_cloud_.unique())
+      unified_cloud_.reset(new sensor_msgs::PointCloud2);
+    unifier_.fillCloud(*unified_scan_, *unified_cloud_);
+    topicPub_CloudUnified_.publish(unified_cloud_);
+  }
 }
 
 /**
- * @function unifyLaserScans
- * @brief unifie the scan information from all laser scans in vec_laser_struct_
- *
- * input: -
- * output:
- * @param: a laser scan message containing unified information from all scanners
+ * @function getTransform
+ * @brief gets the transform from the scanner to the unified frame, cached if configured
  */
-bool ScanUnifierNode::unifyLaserScans(std::vector<sensor_msgs::LaserScan::ConstPtr> current_scans, sensor_msgs::LaserScan &unified_scan)
+bool ScanUnifierNode::getTransform(const sensor_msgs::LaserScan &scan, input_cache_struct &cache)
 {
-  std::vector<sensor_msgs::PointCloud> vec_cloud;
-  vec_cloud.assign(config_.number_input_scans, sensor_msgs::PointCloud());
+  if(config_.cache_transforms && cache.transform_valid && cache.transform.child_frame_id_ == scan.header.frame_id)
+  {
+    return true;
+  }
 
-  if(!current_scans.empty())
+  tf::StampedTransform transform;
+  try
   {
-    ROS_DEBUG("start converting");
-    for(int i=0; i < config_.number_input_scans; i++)
+    if (!listener_.waitForTransform(frame_, scan.header.frame_id, scan.header.stamp, ros::Duration(1.0)))
     {
-      vec_cloud.at(i).header.stamp = current_scans.at(i)->header.stamp;
-      ROS_DEBUG_STREAM("Converting scans to point clouds at index: " << i << ", at time: " << current_scans.at(i)->header.stamp << " now: " << ros::Time::now());
-      try
-      {
-        if (!listener_.waitForTransform(frame_, current_scans.at(i)->header.frame_id,
-                                        current_scans.at(i)->header.stamp, ros::Duration(1.0)))
-        {
-          ROS_WARN_STREAM("Scan unifier skipped scan with " << current_scans.at(i)->header.stamp << " stamp, because of missing tf transform.");
-          return false;
-        }
-
-        ROS_DEBUG("now project to point_cloud");
-        projector_.transformLaserScanToPointCloud(frame_,*current_scans.at(i), vec_cloud.at(i), listener_);
-      }
-      catch(tf::TransformException &ex){
-        ROS_ERROR("%s",ex.what());
-      }
-    }
-    ROS_DEBUG("Creating message header");
-    unified_scan.header = current_scans.at(0)->header;
-    unified_scan.header.frame_id = frame_;
-    unified_scan.angle_increment = M_PI/180.0/2.0;
-    unified_scan.angle_min = -M_PI + unified_scan.angle_increment*0.01;
-    unified_scan.angle_max =  M_PI - unified_scan.angle_increment*0.01;
-    unified_scan.time_increment = 0.0;
-    unified_scan.scan_time = current_scans.at(0)->scan_time;
-    unified_scan.range_min = current_scans.at(0)->range_min;
-    unified_scan.range_max = current_scans.at(0)->range_max;
-    unified_scan.ranges.resize(round((unified_scan.angle_max - unified_scan.angle_min) / unified_scan.angle_increment) + 1);
-    unified_scan.intensities.resize(round((unified_scan.angle_max - unified_scan.angle_min) / unified_scan.angle_increment) + 1);
-
-    // now unify all Scans
-    ROS_DEBUG("unify scans");
-    for(int j = 0; j < config_.number_input_scans; j++)
-    {
-      for (unsigned int i = 0; i < vec_cloud.at(j).points.size(); i++)
-      {
-        const float &x = vec_cloud.at(j).points[i].x;
-        const float &y = vec_cloud.at(j).points[i].y;
-        const float &z = vec_cloud.at(j).points[i].z;
-        //ROS_INFO("Point %f %f %f", x, y, z);
-        if ( std::isnan(x) || std::isnan(y) || std::isnan(z) )
-        {
-          ROS_DEBUG("rejected for nan in point(%f, %f, %f)\n", x, y, z);
-          continue;
-        }
-        double angle = atan2(y, x);// + M_PI/2;
-        if (angle < unified_scan.angle_min || angle > unified_scan.angle_max)
-        {
-          ROS_DEBUG("rejected for angle %f not in range (%f, %f)\n", angle, unified_scan.angle_min, unified_scan.angle_max);
-          continue;
-        }
-        int index = std::floor(0.5 + (angle - unified_scan.angle_min) / unified_scan.angle_increment);
-        if(index<0 || index>=unified_scan.ranges.size()) continue;
-
-        double range_sq = y*y+x*x;
-        //printf ("index xyz( %f %f %f) angle %f index %d range %f\n", x, y, z, angle, index, sqrt(range_sq));
-        if( (unified_scan.ranges.at(index) == 0) || (sqrt(range_sq) <= unified_scan.ranges.at(index)) )
-        {
-          // use the nearest reflection point of all scans for unified scan
-          unified_scan.ranges.at(index) = sqrt(range_sq);
-          // get respective intensity from point cloud intensity-channel (index 0)
-          unified_scan.intensities.at(index) = vec_cloud.at(j).channels.at(0).values.at(i);
-        }
-      }
+      ROS_WARN_STREAM("Scan unifier skipped scan with " << scan.header.stamp << " stamp, because of missing tf transform.");
+      return false;
     }
+    listener_.lookupTransform(frame_, scan.header.frame_id, scan.header.stamp, transform);
+  }
+  catch(tf::TransformException &ex){
+    ROS_ERROR("%s",ex.what());
+    return false;
   }
 
+  cache.transform = transform;
+  cache.transform_valid = true;
   return true;
 }
 
-int main(int argc, char** argv)
+/**
+ * @function unifyLaserScans
+ * @brief unifie the scan information from all laser scans in vec_laser_struct_
+ *
+ * Every beam is transformed directly into the unified frame and binned, no intermediate point cloud is created.
+ * The inputs are binned separately and then reduced to the nearest hit per bin, both steps run on num_threads threads.
+ *
+ * input: -
+ * output:
+ * @param: a laser scan message containing unified information from all scanners
+ */
+bool ScanUnifierNode::unifyLaserScans(const std::vector<sensor_msgs::LaserScan::ConstPtr>& current_scans, sensor_msgs::LaserScan &unified_scan)
 {
-  ROS_DEBUG("scan unifier: start scan unifier node");
-  ros::init(argc, argv, "cob_scan_unifier_node");
+  TRACE_SCOPE("ScanUnifierNode::unifyLaserScans");
+
+  if(current_scans.empty())
+    return true;
 
-  ScanUnifierNode scan_unifier_node;
+  // tf is queried sequentially, the binning only uses the cached data
+  for(size_t j = 0; j < current_scans.size(); j++)
+  {
+    if(!getTransform(*current_scans[j], input_cache_[j]))
+      return false;
+    unifier_.setTransform(j, input_cache_[j].transform);
+  }
 
-  ros::spin();
+  // a zero twist disables the deskewing
+  geometry_msgs::Twist twist;
+  if(config_.deskew)
+    twist = base_twist_;
 
-  return 0;
+  // now unify all Scans
+  ROS_DEBUG("unify scans");
+  unifier_.unify(current_scans, frame_, twist, unified_scan);
+
+  return true;
 }
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#include <cob_scan_unifier/scan_unifier_node.h>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/scoped_ptr.hpp>
+
+namespace cob_scan_unifier
+{
+
+/**
+ * ScanUnifierNode in a nodelet manager.
+ * Scans of drivers and filters in the same manager are unified by reference, without deserializing them.
+ */
+class ScanUnifierNodelet : public nodelet::Nodelet
+{
+private:
+  virtual void onInit()
+  {
+    node_.reset(new ScanUnifierNode(getNodeHandle(), getPrivateNodeHandle()));
+  }
+
+  boost::scoped_ptr<ScanUnifierNode> node_;
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(cob_scan_unifier::ScanUnifierNodelet, nodelet::Nodelet)
@@ -21,6 +21,8 @@
 #include <string>
 #include <stdint.h>
 
+class RawLog;
+
 /*!
 * @class scanCfg
 * @brief Structure containing scan configuration.
@@ -168,6 +170,56 @@ typedef struct _scanData {
 	uint16_t rssi2[1082];
 } scanData;
 
+/*!
+* @class scanOutput
+* @brief Destination of the first pulse of a scan message, e.g. the arrays of a sensor_msgs::LaserScan.
+* The values are converted while they are decoded, without an intermediate scanData.
+*/
+typedef struct _scanOutput {
+
+	/*!
+	 * @brief Radial distances of the first reflected pulse, multiplied by rangeScale.
+	 *
+	 */
+	float* ranges;
+
+	/*!
+	 * @brief Remission values of the first reflected pulse, NULL if not needed.
+	 *
+	 */
+	float* intensities;
+
+	/*!
+	 * @brief Number of values ranges and intensities can hold, further values are dropped.
+	 *
+	 */
+	int size;
+
+	/*!
+	 * @brief Factor from mm to the unit of ranges, e.g. 0.001 for m.
+	 *
+	 */
+	float rangeScale;
+
+	/*!
+	 * @brief Write the values in reverse order, the last value of the scan first.
+	 *
+	 */
+	bool reverse;
+
+	/*!
+	 * @brief Set to the number of values written to ranges.
+	 *
+	 */
+	int rangesLen;
+
+	/*!
+	 * @brief Set to the number of values written to intensities.
+	 *
+	 */
+	int intensitiesLen;
+} scanOutput;
+
 typedef enum {
 	undefined = 0,
 	initialisation = 1,
@@ -179,6 +231,16 @@ typedef enum {
 	ready_for_measurement = 7
 } status_t;
 
+/*!
+* @brief Telegram format of the scan data stream.
+* cola_a : ASCII telegrams, values as hex strings\n
+* cola_b : binary telegrams, values as big endian integers
+*/
+typedef enum {
+	cola_a = 0,
+	cola_b = 1
+} protocol_t;
+
 /*!
 * @class LMS1xx
 * @brief Class responsible for communicating with LMS1xx device.
@@ -262,6 +324,16 @@ public:
 	*/
 	void setScanDataCfg(const scanDataCfg &cfg);
 
+	/*!
+	* @brief Set the angular sector of the scan data output.
+	* Only the measurements from startAngle to stopAngle are sent, both in the
+	* frame of scanCfg (-450000 to 2250000). Needs login().
+	* @param angleResolution 1/10000 degree, as in scanCfg.
+	* @param startAngle 1/10000 degree.
+	* @param stopAngle 1/10000 degree.
+	*/
+	void setOutputRange(int angleResolution, int startAngle, int stopAngle);
+
 	/*!
 	* @brief Start or stop continuous data acquisition.
 	* After reception of this command device start or stop continuous data stream containing scan messages.
@@ -269,6 +341,15 @@ public:
 	*/
 	void scanContinous(int start);
 
+	/*!
+	* @brief Set telegram format of the scan data stream.
+	* Has to be set before the continuous data stream is started with scanContinous.
+	* Configuration commands are always sent as CoLa-A, the device answers each
+	* request in the format of the request.
+	* @param protocol cola_a (default) or cola_b.
+	*/
+	void setProtocol(protocol_t protocol);
+
 	/*!
 	* @brief Receive single scan message.
 	*
@@ -276,6 +357,54 @@ public:
 	*/
 	bool getData(scanData& data);
 
+	/*!
+	* @brief Receive single scan message and write the first pulse to output.
+	*
+	* @param output arrays to write the converted values to.
+	*/
+	bool getData(scanOutput& output);
+
+	/*!
+	* @brief Get socket of the connection, e.g. to wait for data in an event loop.
+	*/
+	int getSocket() const;
+
+	/*!
+	* @brief Append the data available on the socket to the receive buffer without blocking.
+	* @returns false if the connection failed or was closed.
+	*/
+	bool receiveAvailable();
+
+	/*!
+	* @brief Parse the next complete scan message of the receive buffer without reading from the socket.
+	* Call repeatedly after receiveAvailable until it returns false.
+	*
+	* @param data pointer to scanData buffer structure.
+	* @returns false if the receive buffer holds no complete scan message.
+	*/
+	bool getBufferedData(scanData& data);
+
+	/*!
+	* @brief Parse the next complete scan message of the receive buffer and write the first pulse to output.
+	*
+	* @param output arrays to write the converted values to.
+	* @returns false if the receive buffer holds no complete scan message.
+	*/
+	bool getBufferedData(scanOutput& output);
+
+	/*!
+	* @brief Log every chunk received from the socket, e.g. for the analysis of incidents.
+	* @param log an open RawLog or NULL to stop logging, it has to outlive the LMS1xx.
+	*/
+	void setRawLog(RawLog* log);
+
+	/*!
+	* @brief Append data to the receive buffer as if it had been received from the socket, e.g. to replay a RawLog.
+	* Call getBufferedData until it returns false before appending the rest.
+	* @returns number of bytes appended, less than length if the receive buffer is full.
+	*/
+	int appendData(const uint8_t* data, int length);
+
 	/*!
 	* @brief Save data permanently.
 	* Parameters are saved in the EEPROM of the LMS and will also be available after the device is switched off and on again.
@@ -290,10 +419,74 @@ public:
 	void startDevice();
 
 private:
+	/*!
+	* @brief Destination of one channel of a scan message (DIST1, DIST2, RSSI1, RSSI2).
+	*/
+	struct channelDest;
+
+	/*!
+	* @brief Set up the destinations of the four channels for data or output.
+	*/
+	static void setChannelDest(channelDest* dests, scanData& data);
+	static void setChannelDest(channelDest* dests, scanOutput& output);
+
+	/*!
+	* @brief Drop the telegram handed out last from the receive buffer.
+	*/
+	void dropConsumed();
+
+	/*!
+	* @brief Append all data available on the socket to the receive buffer.
+	* @returns false on timeout or error.
+	*/
+	bool receive();
+
+	/*!
+	* @brief Receive the next CoLa-A telegram.
+	* @param telegram set to the first byte after STX in the receive buffer, valid until the next call.
+	* @param length set to the number of bytes between STX and ETX.
+	* @param wait receive from the socket until a telegram is complete.
+	*/
+	bool readAsciiTelegram(const char*& telegram, uint32_t& length, bool wait);
+
+	/*!
+	* @brief Receive the payload of the next CoLa-B telegram.
+	* Telegrams are framed as 4 x STX, payload length (uint32), payload, XOR checksum.
+	* @param payload set to the start of the payload in the receive buffer, valid until the next call.
+	* @param length set to the payload length.
+	* @param wait receive from the socket until a telegram is complete.
+	*/
+	bool readBinaryTelegram(const uint8_t*& payload, uint32_t& length, bool wait = true);
+
+	/*!
+	* @brief Receive single scan message in CoLa-A format.
+	* @param dests destinations of DIST1, DIST2, RSSI1 and RSSI2.
+	*/
+	bool getAsciiData(const channelDest* dests, bool wait);
+
+	/*!
+	* @brief Receive single scan message in CoLa-B format.
+	* @param dests destinations of DIST1, DIST2, RSSI1 and RSSI2.
+	*/
+	bool getBinaryData(const channelDest* dests, bool wait);
+
+	/*!
+	* @brief Receive single scan message in the format of protocol.
+	*/
+	bool getScan(const channelDest* dests, bool wait);
+
 	bool connected;
 	bool debug;
+	protocol_t protocol;
 
 	int sockDesc;
+	RawLog* rawLog;
+
+	static const int RX_BUFFER_SIZE = 20000;
+	uint8_t rxBuffer[RX_BUFFER_SIZE];
+	/// Receive buffer of the data stream, partial telegrams are kept across calls
+	int rxLength; ///< bytes received into rxBuffer
+	int rxConsumed; ///< bytes of rxBuffer already handed out
 };
 
 #endif /* LMS1XX_H_ */
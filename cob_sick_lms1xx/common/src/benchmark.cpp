@@ -0,0 +1,178 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+ 
+
+/*
+ * Replays a recorded TCP stream of a LMS1xx through the LMS1xx parser at maximum speed.
+ *
+ * usage: lms1xx_benchmark recorded_stream.bin [-b] [-o]
+ *
+ * The recording is the raw data sent by the scanner after "sEN LMDscandata 1",
+ * e.g. "nc 192.168.1.2 2111 > recorded_stream.bin". Use -b for CoLa-B recordings.
+ * With -o the scans are decoded into float ranges in m and intensities in reverse
+ * order (scanOutput), like lms1xx_node does, instead of scanData.
+ * A child process serves the recording on a loopback socket, so the complete
+ * receive path of LMS1xx is measured. Reports scans/s, the latency of getData()
+ * and the number of heap allocations per scan.
+ */
+
+#include "lms1xx.h"
+#include <cob_utilities/MicroBenchmark.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <vector>
+
+MICRO_BENCHMARK_ALLOCATION_COUNTER()
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+	return sorted[std::min(sorted.size()-1, size_t(p*sorted.size()))];
+}
+
+static void serve(int listener, const std::vector<char> &data)
+{
+	int client = accept(listener, NULL, NULL);
+	if (client < 0)
+		_exit(1);
+	size_t sent = 0;
+	while (sent < data.size())
+	{
+		ssize_t n = send(client, &data[sent], data.size()-sent, 0);
+		if (n <= 0)
+			_exit(1);
+		sent += n;
+	}
+	close(client);
+	_exit(0);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "usage: lms1xx_benchmark recorded_stream.bin [-b] [-o]" << std::endl;
+		return 1;
+	}
+
+	std::vector<char> data;
+	{
+		std::ifstream file(argv[1], std::ios::binary);
+		if (!file)
+		{
+			std::cout << "could not open " << argv[1] << std::endl;
+			return 1;
+		}
+		data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	bool binary = false;
+	bool output = false;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-b") == 0)
+			binary = true;
+		else if (strcmp(argv[i], "-o") == 0)
+			output = true;
+	}
+
+	int listener = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof addr);
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t addr_len = sizeof addr;
+	if (bind(listener, (struct sockaddr *) &addr, sizeof addr) != 0 || listen(listener, 1) != 0
+			|| getsockname(listener, (struct sockaddr *) &addr, &addr_len) != 0)
+	{
+		std::cout << "could not open loopback socket" << std::endl;
+		return 1;
+	}
+
+	pid_t child = fork();
+	if (child == 0)
+		serve(listener, data);
+	close(listener);
+
+	LMS1xx laser;
+	laser.connect("127.0.0.1", ntohs(addr.sin_port));
+	if (!laser.isConnected())
+	{
+		std::cout << "connection failed" << std::endl;
+		return 1;
+	}
+	laser.setProtocol(binary ? cola_b : cola_a);
+
+	scanData scan;
+	std::vector<float> ranges(1082);
+	std::vector<float> intensities(1082);
+	scanOutput out;
+	out.ranges = &ranges[0];
+	out.intensities = &intensities[0];
+	out.size = ranges.size();
+	out.rangeScale = 0.001f;
+	out.reverse = true;
+	double checksum = 0;
+	std::vector<double> latency;
+	latency.reserve(data.size()/1000 + 1);
+
+	const unsigned long allocations_start = MicroBenchmark::allocations();
+	const double start = MicroBenchmark::getRealTime();
+	double last = start;
+	while (true)
+	{
+		const double t = MicroBenchmark::getRealTime();
+		if (output ? !laser.getData(out) : !laser.getData(scan))
+			break;
+		last = MicroBenchmark::getRealTime();
+		latency.push_back(last - t);
+		// the same sum for both destinations, to compare their results
+		if (output)
+			checksum += ranges[out.rangesLen - 1] + intensities[0];
+		else
+			checksum += scan.dist1[0] * 0.001f + scan.rssi1[scan.rssi_len1 - 1];
+	}
+	const unsigned long allocations_total = MicroBenchmark::allocations() - allocations_start;
+
+	laser.disconnect();
+	waitpid(child, NULL, 0);
+
+	if (latency.empty())
+	{
+		std::cout << "no scans found in recording" << std::endl;
+		return 1;
+	}
+
+	std::sort(latency.begin(), latency.end());
+	std::cout << "scans:    " << latency.size() << " (" << (binary ? "CoLa-B" : "CoLa-A") << (output ? ", scanOutput" : ", scanData")
+			<< ", checksum " << checksum << ")" << std::endl;
+	std::cout << "scans/s:  " << latency.size()/(last - start) << std::endl;
+	std::cout << "latency:  p50 " << 1e6*percentile(latency, 0.5) << " us, p99 " << 1e6*percentile(latency, 0.99)
+			<< " us, max " << 1e6*latency.back() << " us" << std::endl;
+	std::cout << "allocations/scan: " << double(allocations_total)/latency.size() << std::endl;
+	return 0;
+}
@@ -27,12 +27,76 @@
 #include <errno.h>
 
 #include "lms1xx.h"
+#include <cob_utilities/RawLog.h>
 
 LMS1xx::LMS1xx() :
-	connected(false) {
+	connected(false), protocol(cola_a), rawLog(NULL), rxLength(0), rxConsumed(0) {
 	debug = false;
 }
 
+// big endian values of CoLa-B telegrams
+static inline uint16_t readUInt16(const uint8_t* p) {
+	return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t readUInt32(const uint8_t* p) {
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+struct LMS1xx::channelDest {
+	uint16_t* raw; ///< raw values, or NULL
+	float* scaled; ///< values multiplied by scale, or NULL
+	float scale;
+	bool reverse; ///< value j of n is written to index n-1-j
+	int capacity;
+	int* len; ///< set to the number of values written
+
+	void set(uint16_t* r, float* f, float s, bool rev, int cap, int* l) {
+		raw = r;
+		scaled = f;
+		scale = s;
+		reverse = rev;
+		capacity = cap;
+		len = l;
+	}
+
+	// stores value j of n, the conversion is done here so the decoded value goes straight to its destination
+	void store(int j, int n, int value) const {
+		int i = reverse ? n - 1 - j : j;
+		if (raw != NULL)
+			raw[i] = value;
+		else
+			scaled[i] = value * scale;
+	}
+
+	// returns the destination of the channel name (not terminated), NULL if it is not needed
+	static const channelDest* find(const channelDest* dests, const char* name) {
+		static const char* const names[4] = { "DIST1", "DIST2", "RSSI1", "RSSI2" };
+		for (int i = 0; i < 4; i++) {
+			if (!memcmp(name, names[i], 5))
+				return (dests[i].raw != NULL || dests[i].scaled != NULL) ? &dests[i] : NULL;
+		}
+		return NULL;
+	}
+};
+
+void LMS1xx::setChannelDest(channelDest* dests, scanData& data) {
+	const int capacity = sizeof(data.dist1) / sizeof(data.dist1[0]);
+	dests[0].set(data.dist1, NULL, 1, false, capacity, &data.dist_len1);
+	dests[1].set(data.dist2, NULL, 1, false, capacity, &data.dist_len2);
+	dests[2].set(data.rssi1, NULL, 1, false, capacity, &data.rssi_len1);
+	dests[3].set(data.rssi2, NULL, 1, false, capacity, &data.rssi_len2);
+}
+
+void LMS1xx::setChannelDest(channelDest* dests, scanOutput& output) {
+	output.rangesLen = 0;
+	output.intensitiesLen = 0;
+	dests[0].set(NULL, output.ranges, output.rangeScale, output.reverse, output.size, &output.rangesLen);
+	dests[1].set(NULL, NULL, 0, false, 0, NULL);
+	dests[2].set(NULL, output.intensities, 1, output.reverse, output.size, &output.intensitiesLen);
+	dests[3].set(NULL, NULL, 0, false, 0, NULL);
+}
+
 LMS1xx::~LMS1xx() {
 
 }
@@ -61,6 +125,8 @@ void LMS1xx::disconnect() {
 		close(sockDesc);
 		connected = false;
 	}
+	rxLength = 0;
+	rxConsumed = 0;
 }
 
 bool LMS1xx::isConnected() {
@@ -178,7 +244,55 @@ void LMS1xx::setScanDataCfg(const scanDataCfg &cfg) {
 	buf[len - 1] = 0;
 }
 
+void LMS1xx::setOutputRange(int angleResolution, int startAngle, int stopAngle) {
+	char buf[100];
+	sprintf(buf, "%c%s 1 %X %X %X%c", 0x02, "sWN LMPoutputRange",
+			angleResolution, startAngle, stopAngle, 0x03);
+	if(debug)
+		printf("%s\n", buf);
+	write(sockDesc, buf, strlen(buf));
+
+	int len = read(sockDesc, buf, 100);
+	buf[len - 1] = 0;
+}
+
+void LMS1xx::setProtocol(protocol_t protocol) {
+	this->protocol = protocol;
+}
+
 void LMS1xx::scanContinous(int start) {
+	if (protocol == cola_b) {
+		// the data stream is sent in the format of this request
+		const char command[] = "sEN LMDscandata ";
+		const uint32_t command_len = sizeof(command) - 1;
+		uint8_t msg[8 + sizeof(command) + 1];
+		memset(msg, 0x02, 4);
+		uint32_t payload_len = command_len + 1;
+		msg[4] = (payload_len >> 24) & 0xFF;
+		msg[5] = (payload_len >> 16) & 0xFF;
+		msg[6] = (payload_len >> 8) & 0xFF;
+		msg[7] = payload_len & 0xFF;
+		memcpy(msg + 8, command, command_len);
+		msg[8 + command_len] = start ? 1 : 0;
+		uint8_t checksum = 0;
+		for (uint32_t i = 0; i < payload_len; i++)
+			checksum ^= msg[8 + i];
+		msg[8 + payload_len] = checksum;
+
+		write(sockDesc, msg, 8 + payload_len + 1);
+
+		// scan telegrams may already be queued before the answer when stopping
+		const uint8_t* payload;
+		uint32_t length;
+		for (int i = 0; i < 10; i++) {
+			if (!readBinaryTelegram(payload, length))
+				break;
+			if (length >= 3 && payload[0] == 's' && payload[1] == 'E' && payload[2] == 'A')
+				break;
+		}
+		return;
+	}
+
 	char buf[100];
 	sprintf(buf, "%c%s %d%c", 0x02, "sEN LMDscandata", start, 0x03);
 
@@ -200,238 +314,354 @@ void LMS1xx::scanContinous(int start) {
 	}
 }
 
-bool LMS1xx::getData(scanData& data) {
-	char buf[20000];
+void LMS1xx::dropConsumed() {
+	// bytes behind the telegram handed out last are kept for the next one
+	if (rxConsumed > 0) {
+		memmove(rxBuffer, rxBuffer + rxConsumed, rxLength - rxConsumed);
+		rxLength -= rxConsumed;
+		rxConsumed = 0;
+	}
+}
+
+bool LMS1xx::receive() {
+	// wait for more data, read all that is available at once
 	fd_set rfds;
 	struct timeval tv;
-	int retval, len = 0;
-	int bytes_read = 0;
-	int inc = 0;
-	int r_off = 0;
-
-	do{
-		FD_ZERO(&rfds);
-		FD_SET(sockDesc, &rfds);
-		tv.tv_sec = 1;
-		tv.tv_usec = 0;
-		bytes_read = 0; inc = 0;
-		retval = select(sockDesc + 1, &rfds, NULL, NULL, &tv);
-		if(retval)
-		{
-			bytes_read = read(sockDesc, buf, 1);
-			if(bytes_read > 1)
-			{
-				//std::cerr<<"Error in getData: received "<< bytes_read <<" bytes"<<std::endl;
-				inc = bytes_read;
-				inc --;
-			}
-			else if(bytes_read < 1)
-			{
-				//std::cerr<<"Error in getData: received "<< bytes_read <<" bytes"<<std::endl;
-			}
+	FD_ZERO(&rfds);
+	FD_SET(sockDesc, &rfds);
+	tv.tv_sec = 1;
+	tv.tv_usec = 0;
+	if (select(sockDesc + 1, &rfds, NULL, NULL, &tv) <= 0)
+		return false;
+	int bytes_read = recv(sockDesc, rxBuffer + rxLength, RX_BUFFER_SIZE - rxLength, 0);
+	if (bytes_read < 1)
+		return false;
+	if (rawLog != NULL)
+		rawLog->write(rxBuffer + rxLength, bytes_read, RawLog::now());
+	rxLength += bytes_read;
+	return true;
+}
+
+bool LMS1xx::readAsciiTelegram(const char*& telegram, uint32_t& length, bool wait) {
+	dropConsumed();
+
+	while (true) {
+		// resynchronize on STX
+		int start = 0;
+		while (start < rxLength && rxBuffer[start] != 0x02)
+			start++;
+		if (start > 0) {
+			memmove(rxBuffer, rxBuffer + start, rxLength - start);
+			rxLength -= start;
 		}
-		else
-		{
-			//std::cerr<<"select failed during find start: "<<strerror(errno)<<std::endl;
+
+		uint8_t* etx = rxLength > 0 ? (uint8_t*) memchr(rxBuffer + 1, 0x03, rxLength - 1) : NULL;
+		if (etx != NULL) {
+			telegram = (const char*) rxBuffer + 1;
+			length = etx - rxBuffer - 1;
+			rxConsumed = etx - rxBuffer + 1;
+			return true;
 		}
 
-	}while(buf[0+inc] != 0x02);
-	len += bytes_read;
+		if (rxLength == RX_BUFFER_SIZE) {
+			// the telegram does not fit, skip it and search for the next STX
+			if (debug)
+				printf("telegram exceeds receive buffer\n");
+			memmove(rxBuffer, rxBuffer + 1, rxLength - 1);
+			rxLength -= 1;
+			continue;
+		}
 
+		if (!wait || !receive())
+			return false;
+	}
+}
 
-	do {
-		bool bFoundEnd = false;
-		bool bFoundStart = false;
-		if(len >= 20000)
-		{
-			int i;
-			for(i = 0; i < len; i++)
-			{
-				if(buf[i] == 0x03)
-				{
-					len = i+1;
-					bFoundEnd = true;
-					//std::cerr<<"Found end!\n";
-				}
-				if(bFoundEnd && buf[i] == 0x02)
-				{
-					//std::cerr<<"Found start!\n";
-					bFoundStart = true;
-				}
-			}
-			if(!bFoundEnd)
-			{
-				char flushBuffer[100000];
-				int bytesFlushed = recv(sockDesc, flushBuffer, 100000, 0);
-				//std::cerr<<"Flushed read buffer"<<std::endl;
-				return false;
-			}
+bool LMS1xx::readBinaryTelegram(const uint8_t*& payload, uint32_t& length, bool wait) {
+	dropConsumed();
+
+	while (true) {
+		// resynchronize on the start sequence
+		int start = 0;
+		while (start + 4 <= rxLength && readUInt32(rxBuffer + start) != 0x02020202)
+			start++;
+		if (start > 0) {
+			memmove(rxBuffer, rxBuffer + start, rxLength - start);
+			rxLength -= start;
 		}
-		if(!bFoundEnd)
-		{
-			FD_ZERO(&rfds);
-			FD_SET(sockDesc, &rfds);
-
-			tv.tv_sec = 0;
-			tv.tv_usec = 100000;
-			bytes_read = 0;
-			retval = select(sockDesc + 1, &rfds, NULL, NULL, &tv);
-			if (retval)
-			{
-				bytes_read = read(sockDesc, buf + len, 20000 - len);
-				if(bytes_read < 1)
-				{
-					//std::cerr<<"Error in getData: received "<< bytes_read <<" bytes"<<std::endl;
-				}
-				else
-					len += bytes_read;
+
+		if (rxLength >= 8) {
+			length = readUInt32(rxBuffer + 4);
+			if (length == 0 || length + 9 > (uint32_t) RX_BUFFER_SIZE) {
+				// no valid header, search next start sequence
+				memmove(rxBuffer, rxBuffer + 1, rxLength - 1);
+				rxLength -= 1;
+				continue;
 			}
-			else
-			{
-				//std::cerr<<"select failed during get data: "<<strerror(errno)<<std::endl;
+			if ((uint32_t) rxLength >= length + 9) {
+				uint8_t checksum = 0;
+				for (uint32_t i = 0; i < length; i++)
+					checksum ^= rxBuffer[8 + i];
+				if (checksum != rxBuffer[8 + length]) {
+					if (debug)
+						printf("invalid checksum in binary telegram\n");
+					memmove(rxBuffer, rxBuffer + 4, rxLength - 4);
+					rxLength -= 4;
+					continue;
+				}
+				payload = rxBuffer + 8;
+				rxConsumed = length + 9;
+				return true;
 			}
 		}
-	} while ((buf[len - 1] != 0x03));
 
-	//	if (debug)
-	//		std::cout << "scan data recieved" << std::endl;
-	buf[len - 1] = 0;
-	char* tok = strtok(buf, " "); //Type of command
-	tok = strtok(NULL, " "); //Command
-	tok = strtok(NULL, " "); //VersionNumber
-	tok = strtok(NULL, " "); //DeviceNumber
-	tok = strtok(NULL, " "); //Serial number
-	tok = strtok(NULL, " "); //DeviceStatus
-	tok = strtok(NULL, " "); //MessageCounter
-	tok = strtok(NULL, " "); //ScanCounter
-	tok = strtok(NULL, " "); //PowerUpDuration
-	tok = strtok(NULL, " "); //TransmissionDuration
-	tok = strtok(NULL, " "); //InputStatus
-	tok = strtok(NULL, " "); //OutputStatus
-	tok = strtok(NULL, " "); //ReservedByteA
-	tok = strtok(NULL, " "); //ScanningFrequency
-	tok = strtok(NULL, " "); //MeasurementFrequency
-	tok = strtok(NULL, " ");
-	tok = strtok(NULL, " ");
-	tok = strtok(NULL, " ");
-	tok = strtok(NULL, " "); //NumberEncoders
-	int NumberEncoders;
-	sscanf(tok, "%d", &NumberEncoders);
-	for (int i = 0; i < NumberEncoders; i++) {
-		tok = strtok(NULL, " "); //EncoderPosition
-		tok = strtok(NULL, " "); //EncoderSpeed
+		if (!wait || !receive())
+			return false;
 	}
+}
 
-	tok = strtok(NULL, " "); //NumberChannels16Bit
-	int NumberChannels16Bit;
-	sscanf(tok, "%d", &NumberChannels16Bit);
-	if (debug)
-		printf("NumberChannels16Bit : %d\n", NumberChannels16Bit);
-	for (int i = 0; i < NumberChannels16Bit; i++) {
-		int type = -1; // 0 DIST1 1 DIST2 2 RSSI1 3 RSSI2
-		char content[6];
-		tok = strtok(NULL, " "); //MeasuredDataContent
-		sscanf(tok, "%s", content);
-		if (!strcmp(content, "DIST1")) {
-			type = 0;
-		} else if (!strcmp(content, "DIST2")) {
-			type = 1;
-		} else if (!strcmp(content, "RSSI1")) {
-			type = 2;
-		} else if (!strcmp(content, "RSSI2")) {
-			type = 3;
-		}
-		tok = strtok(NULL, " "); //ScalingFactor
-		tok = strtok(NULL, " "); //ScalingOffset
-		tok = strtok(NULL, " "); //Starting angle
-		tok = strtok(NULL, " "); //Angular step width
-		tok = strtok(NULL, " "); //NumberData
-		int NumberData;
-		sscanf(tok, "%X", &NumberData);
+bool LMS1xx::getBinaryData(const channelDest* dests, bool wait) {
+	const uint8_t* payload;
+	uint32_t length;
 
+	// skip answers to other requests
+	const char command[] = "sSN LMDscandata ";
+	const uint32_t command_len = sizeof(command) - 1;
+	do {
+		if (!readBinaryTelegram(payload, length, wait))
+			return false;
+	} while (length < command_len || memcmp(payload, command, command_len) != 0);
+
+	const uint8_t* p = payload + command_len;
+	const uint8_t* end = payload + length;
+
+	// VersionNumber 2, DeviceNumber 2, SerialNumber 4, DeviceStatus 2, MessageCounter 2,
+	// ScanCounter 2, PowerUpDuration 4, TransmissionDuration 4, InputStatus 2,
+	// OutputStatus 2, ReservedByteA 2, ScanningFrequency 4, MeasurementFrequency 4
+	p += 36;
+	if (p + 2 > end)
+		return false;
+	int NumberEncoders = readUInt16(p);
+	p += 2 + NumberEncoders * 6; // EncoderPosition 4, EncoderSpeed 2
+
+	for (int bits = 16; bits >= 8; bits -= 8) {
+		if (p + 2 > end)
+			return false;
+		int NumberChannels = readUInt16(p);
+		p += 2;
 		if (debug)
-			printf("NumberData : %d\n", NumberData);
-
-		if (type == 0) {
-			data.dist_len1 = NumberData;
-		} else if (type == 1) {
-			data.dist_len2 = NumberData;
-		} else if (type == 2) {
-			data.rssi_len1 = NumberData;
-		} else if (type == 3) {
-			data.rssi_len2 = NumberData;
-		}
+			printf("NumberChannels%dBit : %d\n", bits, NumberChannels);
 
-		for (int i = 0; i < NumberData; i++) {
-			int dat;
-			tok = strtok(NULL, " "); //data
-			sscanf(tok, "%X", &dat);
-
-			if (type == 0) {
-				data.dist1[i] = dat;
-			} else if (type == 1) {
-				data.dist2[i] = dat;
-			} else if (type == 2) {
-				data.rssi1[i] = dat;
-			} else if (type == 3) {
-				data.rssi2[i] = dat;
-			}
+		for (int i = 0; i < NumberChannels; i++) {
+			// MeasuredDataContent 5, ScalingFactor 4, ScalingOffset 4,
+			// Starting angle 4, Angular step width 2, NumberData 2
+			if (p + 21 > end)
+				return false;
+			int NumberData = readUInt16(p + 19);
+			int bytes = NumberData * bits / 8;
+			if (p + 21 + bytes > end)
+				return false;
 
+			const channelDest* dest = channelDest::find(dests, (const char*) p);
+			p += 21;
+
+			if (debug)
+				printf("NumberData : %d\n", NumberData);
+
+			if (dest != NULL) {
+				int n = NumberData < dest->capacity ? NumberData : dest->capacity;
+				*dest->len = n;
+				if (bits == 16) {
+					for (int j = 0; j < n; j++)
+						dest->store(j, n, readUInt16(p + 2 * j));
+				} else {
+					for (int j = 0; j < n; j++)
+						dest->store(j, n, p[j]);
+				}
+			}
+			p += bytes;
 		}
 	}
+	return true;
+}
 
-	tok = strtok(NULL, " "); //NumberChannels8Bit
-	int NumberChannels8Bit;
-	sscanf(tok, "%d", &NumberChannels8Bit);
-	if (debug)
-		printf("NumberChannels8Bit : %d\n", NumberChannels8Bit);
-	for (int i = 0; i < NumberChannels8Bit; i++) {
-		int type = -1;
-		char content[6];
-		tok = strtok(NULL, " "); //MeasuredDataContent
-		sscanf(tok, "%s", content);
-		if (!strcmp(content, "DIST1")) {
-			type = 0;
-		} else if (!strcmp(content, "DIST2")) {
-			type = 1;
-		} else if (!strcmp(content, "RSSI1")) {
-			type = 2;
-		} else if (!strcmp(content, "RSSI2")) {
-			type = 3;
-		}
-		tok = strtok(NULL, " "); //ScalingFactor
-		tok = strtok(NULL, " "); //ScalingOffset
-		tok = strtok(NULL, " "); //Starting angle
-		tok = strtok(NULL, " "); //Angular step width
-		tok = strtok(NULL, " "); //NumberData
-		int NumberData;
-		sscanf(tok, "%X", &NumberData);
+// CoLa-A fields are separated by single spaces
+static inline void skipToken(const char*& p, const char* end) {
+	while (p < end && *p == ' ')
+		p++;
+	while (p < end && *p != ' ')
+		p++;
+}
+
+static inline void skipTokens(const char*& p, const char* end, int n) {
+	for (int i = 0; i < n; i++)
+		skipToken(p, end);
+}
+
+// parses the next field as hex number, returns false at the end of the telegram
+static inline bool parseHex(const char*& p, const char* end, int& value) {
+	while (p < end && *p == ' ')
+		p++;
+	if (p >= end)
+		return false;
+	bool negative = false;
+	if (*p == '+' || *p == '-') {
+		negative = *p == '-';
+		p++;
+	}
+	value = 0;
+	const char* start = p;
+	while (p < end && *p != ' ') {
+		char c = *p;
+		int digit;
+		if (c >= '0' && c <= '9')
+			digit = c - '0';
+		else if (c >= 'A' && c <= 'F')
+			digit = c - 'A' + 10;
+		else if (c >= 'a' && c <= 'f')
+			digit = c - 'a' + 10;
+		else
+			return false;
+		value = (value << 4) | digit;
+		p++;
+	}
+	if (negative)
+		value = -value;
+	return p > start;
+}
+
+// returns the next field, which is not terminated
+static inline const char* nextToken(const char*& p, const char* end, int& len) {
+	while (p < end && *p == ' ')
+		p++;
+	const char* start = p;
+	while (p < end && *p != ' ')
+		p++;
+	len = p - start;
+	return start;
+}
+
+bool LMS1xx::getScan(const channelDest* dests, bool wait) {
+	if (protocol == cola_b)
+		return getBinaryData(dests, wait);
+	return getAsciiData(dests, wait);
+}
+
+bool LMS1xx::getData(scanData& data) {
+	channelDest dests[4];
+	setChannelDest(dests, data);
+	return getScan(dests, true);
+}
 
+bool LMS1xx::getData(scanOutput& output) {
+	channelDest dests[4];
+	setChannelDest(dests, output);
+	return getScan(dests, true);
+}
+
+int LMS1xx::getSocket() const {
+	return sockDesc;
+}
+
+bool LMS1xx::receiveAvailable() {
+	dropConsumed();
+	if (rxLength == RX_BUFFER_SIZE)
+		rxLength = 0; // only an incomplete telegram, which is too long
+	int bytes_read = recv(sockDesc, rxBuffer + rxLength, RX_BUFFER_SIZE - rxLength, MSG_DONTWAIT);
+	if (bytes_read > 0) {
+		if (rawLog != NULL)
+			rawLog->write(rxBuffer + rxLength, bytes_read, RawLog::now());
+		rxLength += bytes_read;
+		return true;
+	}
+	return bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
+bool LMS1xx::getBufferedData(scanData& data) {
+	channelDest dests[4];
+	setChannelDest(dests, data);
+	return getScan(dests, false);
+}
+
+bool LMS1xx::getBufferedData(scanOutput& output) {
+	channelDest dests[4];
+	setChannelDest(dests, output);
+	return getScan(dests, false);
+}
+
+void LMS1xx::setRawLog(RawLog* log) {
+	rawLog = log;
+}
+
+int LMS1xx::appendData(const uint8_t* data, int length) {
+	dropConsumed();
+	if (rxLength == RX_BUFFER_SIZE)
+		rxLength = 0; // only an incomplete telegram, which is too long
+	if (length > RX_BUFFER_SIZE - rxLength)
+		length = RX_BUFFER_SIZE - rxLength;
+	memcpy(rxBuffer + rxLength, data, length);
+	rxLength += length;
+	return length;
+}
+
+bool LMS1xx::getAsciiData(const channelDest* dests, bool wait) {
+	const char* telegram;
+	uint32_t length;
+	// skip answers to other requests
+	do {
+		if (!readAsciiTelegram(telegram, length, wait))
+			return false;
+	} while (length < 15 || memcmp(telegram, "sSN LMDscandata", 15) != 0);
+
+	const char* p = telegram;
+	const char* end = telegram + length;
+
+	// Type of command, Command, VersionNumber, DeviceNumber, Serial number,
+	// DeviceStatus (2), MessageCounter, ScanCounter, PowerUpDuration,
+	// TransmissionDuration, InputStatus (2), OutputStatus (2), ReservedByteA,
+	// ScanningFrequency, MeasurementFrequency
+	skipTokens(p, end, 18);
+
+	int NumberEncoders;
+	if (!parseHex(p, end, NumberEncoders))
+		return false;
+	skipTokens(p, end, 2 * NumberEncoders); // EncoderPosition, EncoderSpeed
+
+	// 16 bit channels first, then 8 bit channels, both as hex
+	for (int k = 0; k < 2; k++) {
+		int NumberChannels;
+		if (!parseHex(p, end, NumberChannels))
+			return false;
 		if (debug)
-			printf("NumberData : %d\n", NumberData);
-
-		if (type == 0) {
-			data.dist_len1 = NumberData;
-		} else if (type == 1) {
-			data.dist_len2 = NumberData;
-		} else if (type == 2) {
-			data.rssi_len1 = NumberData;
-		} else if (type == 3) {
-			data.rssi_len2 = NumberData;
-		}
-		for (int i = 0; i < NumberData; i++) {
-			int dat;
-			tok = strtok(NULL, " "); //data
-			sscanf(tok, "%X", &dat);
-
-			if (type == 0) {
-				data.dist1[i] = dat;
-			} else if (type == 1) {
-				data.dist2[i] = dat;
-			} else if (type == 2) {
-				data.rssi1[i] = dat;
-			} else if (type == 3) {
-				data.rssi2[i] = dat;
+			printf("NumberChannels%dBit : %d\n", k == 0 ? 16 : 8, NumberChannels);
+
+		for (int i = 0; i < NumberChannels; i++) {
+			int content_len;
+			const char* content = nextToken(p, end, content_len); //MeasuredDataContent
+			const channelDest* dest = NULL;
+			if (content_len == 5)
+				dest = channelDest::find(dests, content);
+			// ScalingFactor, ScalingOffset, Starting angle, Angular step width
+			skipTokens(p, end, 4);
+			int NumberData;
+			if (!parseHex(p, end, NumberData))
+				return false;
+
+			if (debug)
+				printf("NumberData : %d\n", NumberData);
+
+			int n = 0;
+			if (dest != NULL) {
+				n = NumberData < dest->capacity ? NumberData : dest->capacity;
+				*dest->len = n;
+			}
+
+			for (int j = 0; j < NumberData; j++) {
+				int dat;
+				if (!parseHex(p, end, dat))
+					return false;
+				if (j < n)
+					dest->store(j, n, dat);
 			}
 		}
 	}
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Micro-benchmarks of the LMS1xx scan telegram parser on a synthesized CoLa-A telegram.
+ *
+ * usage: lms1xx_micro_benchmark [--filter=regex] [--format=console|json] [--out=file.json], see MicroBenchmark.h
+ *
+ * The telegram holds the DIST1 and RSSI1 channels like the default output of a LMS1xx at 0.5 deg.
+ * Each iteration appends it to the receive buffer and parses it, without a socket.
+ * The argument of each benchmark is the number of values per channel.
+ */
+
+#include "lms1xx.h"
+
+#include <cob_utilities/MicroBenchmark.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static std::vector<uint8_t> createTelegram(int numValues)
+{
+	std::string telegram = "\x02sSN LMDscandata 1 1 89A27F 0 0 343 347 27477BA9 2747813B 0 0 7 0 0 1388 168 0 1 ";
+	const char* contents[2] = { "DIST1 3F800000 00000000 FFF92230 1388 ", "RSSI1 3F800000 00000000 FFF92230 1388 " };
+	char value[16];
+	for (int k = 0; k < 2; k++) {
+		telegram += contents[k];
+		sprintf(value, "%X", numValues);
+		telegram += value;
+		for (int i = 0; i < numValues; i++) {
+			sprintf(value, " %X", k == 0 ? 500 + rand() % 20000 : rand() % 256);
+			telegram += value;
+		}
+		// 8 bit channels follow the 16 bit channels
+		telegram += (k == 0) ? " 1 " : " 0 0 0 0 0";
+	}
+	telegram += "\x03";
+	return std::vector<uint8_t>(telegram.begin(), telegram.end());
+}
+
+// decoding into scanData as lms1xx_test does
+static void Lms1xx_ParseScanData(MicroBenchmark::State &state)
+{
+	const std::vector<uint8_t> telegram = createTelegram(state.range());
+	LMS1xx laser;
+	scanData scan;
+	while (state.keepRunning()) {
+		laser.appendData(&telegram[0], telegram.size());
+		if (!laser.getBufferedData(scan)) {
+			state.skip("telegram rejected by the parser");
+			return;
+		}
+	}
+	state.setItemsProcessed(state.iterations() * state.range());
+}
+MICRO_BENCHMARK_ARG(Lms1xx_ParseScanData, 541);
+MICRO_BENCHMARK_ARG(Lms1xx_ParseScanData, 1082);
+
+// decoding directly into the float arrays of a laser scan message as lms1xx_node does
+static void Lms1xx_ParseScanOutput(MicroBenchmark::State &state)
+{
+	const std::vector<uint8_t> telegram = createTelegram(state.range());
+	LMS1xx laser;
+	std::vector<float> ranges(1082);
+	std::vector<float> intensities(1082);
+	scanOutput out;
+	out.ranges = &ranges[0];
+	out.intensities = &intensities[0];
+	out.size = ranges.size();
+	out.rangeScale = 0.001f;
+	out.reverse = true;
+	while (state.keepRunning()) {
+		laser.appendData(&telegram[0], telegram.size());
+		if (!laser.getBufferedData(out)) {
+			state.skip("telegram rejected by the parser");
+			return;
+		}
+	}
+	state.setItemsProcessed(state.iterations() * state.range());
+}
+MICRO_BENCHMARK_ARG(Lms1xx_ParseScanOutput, 541);
+MICRO_BENCHMARK_ARG(Lms1xx_ParseScanOutput, 1082);
+
+MICRO_BENCHMARK_MAIN()
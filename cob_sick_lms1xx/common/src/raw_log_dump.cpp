@@ -0,0 +1,107 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Replays a raw log of the LMS1xx driver (parameter raw_log_file) through the LMS1xx parser.
+ *
+ * usage: lms1xx_raw_log_dump raw_log_file [-r]
+ *
+ * Prints one line per scan with the wall time of the chunk which completed it, the number
+ * of ranges and the closest range, -r also prints all ranges in m. The protocol is taken
+ * from the description in the log.
+ */
+
+#include "lms1xx.h"
+
+#include <cob_utilities/RawLog.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <boost/bind.hpp>
+
+struct Replay {
+	LMS1xx laser;
+	scanData data;
+	bool print_ranges;
+	int64_t realtime_offset_ns;
+	unsigned long chunks;
+	unsigned long bytes;
+	unsigned long scans;
+
+	void chunk(int64_t time_ns, const uint8_t* buf, size_t size) {
+		chunks++;
+		bytes += size;
+
+		const int64_t wall_ns = time_ns + realtime_offset_ns;
+		const time_t sec = wall_ns / 1000000000;
+		struct tm tm;
+		localtime_r(&sec, &tm);
+		char stamp[32];
+		strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+
+		while (size > 0) {
+			int appended = laser.appendData(buf, size);
+			buf += appended;
+			size -= appended;
+
+			while (laser.getBufferedData(data)) {
+				scans++;
+				int closest = 0;
+				for (int i = 0; i < data.dist_len1; i++) {
+					if (data.dist1[i] > 0 && (closest == 0 || data.dist1[i] < closest))
+						closest = data.dist1[i];
+				}
+				printf("%s.%03d scan: %d ranges, closest %.3f m\n", stamp, (int) (wall_ns / 1000000 % 1000),
+						data.dist_len1, closest * 0.001);
+				if (print_ranges) {
+					for (int i = 0; i < data.dist_len1; i++)
+						printf("%.3f%c", data.dist1[i] * 0.001, (i + 1 < data.dist_len1) ? ' ' : '\n');
+				}
+			}
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s raw_log_file [-r]\n", argv[0]);
+		return 1;
+	}
+
+	static Replay replay;
+	replay.print_ranges = (argc > 2 && strcmp(argv[2], "-r") == 0);
+	replay.chunks = replay.bytes = replay.scans = 0;
+
+	RawLog::Info info;
+	if (!RawLog::replay(argv[1], &info, RawLog::RecordCallback()))
+		return 1;
+	if (info.uiSource != RawLog::SOURCE_SICK_LMS1XX) {
+		fprintf(stderr, "%s is no log of a LMS1xx (source %u)\n", argv[1], info.uiSource);
+		return 1;
+	}
+	printf("%s: %s, %llu chunks, %llu dropped\n", argv[1], info.sDescription.c_str(),
+			(unsigned long long) info.ullRecords, (unsigned long long) info.ullDropped);
+	replay.realtime_offset_ns = info.llRealtimeOffsetNs;
+	replay.laser.setProtocol(info.sDescription.find("protocol=cola_b") != std::string::npos ? cola_b : cola_a);
+
+	if (!RawLog::replay(argv[1], NULL, boost::bind(&Replay::chunk, &replay, _1, _2, _3)))
+		return 1;
+
+	printf("%lu chunks, %lu bytes, %lu scans\n", replay.chunks, replay.bytes, replay.scans);
+	return 0;
+}
@@ -16,8 +16,15 @@
  
 
 // standard includes
+#include <cmath>
 #include <csignal>
 #include <cstdio>
+#include <vector>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
 
 // ROS includes
 #include "ros/ros.h"
@@ -28,6 +35,7 @@
 
 // external includes
 #include <lms1xx.h>
+#include <cob_utilities/RawLog.h>
 
 #define DEG2RAD M_PI/180.0
 
@@ -36,7 +44,7 @@ class SickLMS1xxNode
 {
 public:
 
-    SickLMS1xxNode();
+    SickLMS1xxNode(const ros::NodeHandle& node_handle = ros::NodeHandle());
 
     bool initalize();
 
@@ -44,27 +52,41 @@ public:
     void publish();
     void stopScanner();
 
+    /// socket of the scanner connection for the event loop
+    int getSocket();
+    /// reads the data available on the socket and publishes all complete scans,
+    /// returns false if the connection failed
+    bool receiveAndPublish();
+
     ros::NodeHandle nh;
 
 private:
 
     bool initalizeLaser();
     bool initalizeMessage();
+    void setOutputRange();
     void setScanDataConfig();
     void publishError(std::string error_str);
+    void publishScan(const ros::Time& stamp);
+    scanOutput& prepareOutput();
 
     ros::Publisher scan_pub;
     ros::Publisher diagnostic_pub;
 
+    // raw data of the connection for post-mortem analysis, see lms1xx_raw_log_dump
+    RawLog raw_log;
     // laser data
     LMS1xx laser;
     scanCfg cfg;
     scanDataCfg dataCfg;
-    scanData data;
-    // published data
-    sensor_msgs::LaserScan scan_msg;
+    // the parser writes the scans directly into scan_msg
+    scanOutput output;
+    // published data, published as shared pointer without copy
+    sensor_msgs::LaserScanPtr scan_msg;
     // parameters
     std::string host;
+    int port;
+    bool binary_protocol;
     std::string frame_id;
     bool inverted;
     double resolution;
@@ -72,17 +94,28 @@ private:
     bool set_config;
     double min_range;
     double max_range;
+    // data reduction on the scanner
+    bool publish_intensities;
+    int output_interval;
+    double angle_min;
+    double angle_max;
+    // sector sent by the scanner, 1/10000 degree in the frame of cfg
+    int output_start;
+    int output_stop;
 };
 
-SickLMS1xxNode::SickLMS1xxNode()
+SickLMS1xxNode::SickLMS1xxNode(const ros::NodeHandle& node_handle)
+    : nh(node_handle), scan_msg(boost::make_shared<sensor_msgs::LaserScan>())
 {
-    ros::NodeHandle nh;
-
     scan_pub = nh.advertise<sensor_msgs::LaserScan>("scan", 1);
     diagnostic_pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
 
     if(!nh.hasParam("host")) ROS_WARN("Used default parameter for host");
     nh.param<std::string>("host", host, "192.168.1.2");
+    if(!nh.hasParam("port")) ROS_WARN("Used default parameter for port");
+    nh.param<int>("port", port, 2111);
+    if(!nh.hasParam("binary_protocol")) ROS_WARN("Used default parameter for binary_protocol");
+    nh.param<bool>("binary_protocol", binary_protocol, false);
     if(!nh.hasParam("frame_id")) ROS_WARN("Used default parameter for frame_id");
     nh.param<std::string>("frame_id", frame_id, "base_laser_link");
     if(!nh.hasParam("inverted")) ROS_WARN("Used default parameter for inverted");
@@ -98,11 +131,42 @@ SickLMS1xxNode::SickLMS1xxNode()
     if(!nh.hasParam("max_range")) ROS_WARN("Used default parameter for max_range");
     nh.param<double>("max_range", max_range, 20.0);
 
+    // the scanner only sends what is published: remission (8 bit) if intensities are published,
+    // every output_interval-th scan and the sector from angle_min to angle_max (rad, frame of the scan message)
+    nh.param<bool>("publish_intensities", publish_intensities, true);
+    nh.param<int>("output_interval", output_interval, 1);
+    if(output_interval < 1)
+    {
+      ROS_WARN("output_interval has to be at least 1, using 1");
+      output_interval = 1;
+    }
+    nh.param<double>("angle_min", angle_min, -M_PI);
+    nh.param<double>("angle_max", angle_max, M_PI);
+    output_start = output_stop = 0;
+
+    // the last minutes of raw telegrams, 64 MB hold about 4 minutes of CoLa-A scans at 50 Hz with remission
+    std::string raw_log_file;
+    nh.param<std::string>("raw_log_file", raw_log_file, "");
+    if(!raw_log_file.empty())
+    {
+      int raw_log_size_mb;
+      nh.param<int>("raw_log_size_mb", raw_log_size_mb, 64);
+      std::string description = "host=" + host + (binary_protocol ? " protocol=cola_b" : " protocol=cola_a");
+      if(raw_log.open(raw_log_file, (size_t)raw_log_size_mb << 20, RawLog::SOURCE_SICK_LMS1XX, description))
+        laser.setRawLog(&raw_log);
+      else
+        ROS_ERROR("Could not open raw log %s, raw data is not logged", raw_log_file.c_str());
+    }
+
     ROS_INFO("connecting to laser at : %s", host.c_str());
+    ROS_INFO("using port : %d", port);
+    ROS_INFO("using binary protocol : %s", (binary_protocol)?"true":"false");
     ROS_INFO("using frame_id : %s", frame_id.c_str());
     ROS_INFO("inverted : %s", (inverted)?"true":"false");
     ROS_INFO("using res : %f", resolution);
     ROS_INFO("using freq : %f", frequency);
+    ROS_INFO("publish intensities : %s", (publish_intensities)?"true":"false");
+    ROS_INFO("using output interval : %d", output_interval);
 }
 
 bool SickLMS1xxNode::initalize()
@@ -122,7 +186,8 @@ bool SickLMS1xxNode::initalizeLaser()
 {
     bool ret = false;
 
-    laser.connect(host);
+    laser.connect(host, port);
+    laser.setProtocol(binary_protocol ? cola_b : cola_a);
 
     if (laser.isConnected()) {
 
@@ -151,6 +216,8 @@ bool SickLMS1xxNode::initalizeLaser()
     if(cfg.scaningFrequency != (int)(frequency * 100))
       ROS_ERROR("Setting scan frequency failed: Current scan frequency is %f.", cfg.scaningFrequency/100.0);
 
+    setOutputRange();
+
     } else {
       ROS_ERROR("Connection to device failed");
       publishError("Connection to device failed");
@@ -158,30 +225,78 @@ bool SickLMS1xxNode::initalizeLaser()
     return ret;
 }
 
+void SickLMS1xxNode::setOutputRange()
+{
+    output_start = cfg.startAngle;
+    output_stop = cfg.stopAngle;
+    const int res = cfg.angleResolution;
+    if(res <= 0)
+      return;
+
+    // 0 deg of the scanner is -90 deg of the message, the values are reversed if not inverted
+    double first_deg, last_deg;
+    if(inverted) {
+      first_deg = angle_min * 180.0 / M_PI + 90.0;
+      last_deg = angle_max * 180.0 / M_PI + 90.0;
+    } else {
+      first_deg = 90.0 - angle_max * 180.0 / M_PI;
+      last_deg = 90.0 - angle_min * 180.0 / M_PI;
+    }
+
+    // the scanner measures every res from cfg.startAngle on, the sector is rounded inwards
+    int first = (int)ceil((first_deg * 10000.0 - cfg.startAngle) / res - 1e-6);
+    int last = (int)floor((last_deg * 10000.0 - cfg.startAngle) / res + 1e-6);
+    const int num_steps = (cfg.stopAngle - cfg.startAngle) / res;
+    if(first < 0)
+      first = 0;
+    if(last > num_steps)
+      last = num_steps;
+    if(last < first)
+    {
+      ROS_ERROR("No measurement between angle_min %f and angle_max %f, using the full range", angle_min, angle_max);
+      first = 0;
+      last = num_steps;
+    }
+
+    output_start = cfg.startAngle + first * res;
+    output_stop = cfg.startAngle + last * res;
+    ROS_INFO("scanner sends %d of %d values", last - first + 1, num_steps + 1);
+    laser.setOutputRange(res, output_start, output_stop);
+}
+
 bool SickLMS1xxNode::initalizeMessage()
 {
     bool ret = true;
 
     //init scan msg
-    scan_msg.header.frame_id = frame_id;
+    scan_msg->header.frame_id = frame_id;
 
-    scan_msg.range_min = min_range;
-    scan_msg.range_max = max_range;
+    scan_msg->range_min = min_range;
+    scan_msg->range_max = max_range;
 
-    scan_msg.scan_time = 100.0/cfg.scaningFrequency;
+    scan_msg->scan_time = 100.0/cfg.scaningFrequency * output_interval;
 
-    scan_msg.angle_increment = (double)cfg.angleResolution/10000.0 * DEG2RAD;
-    scan_msg.angle_min = (double)cfg.startAngle/10000.0 * DEG2RAD - M_PI/2;
-    scan_msg.angle_max = (double)cfg.stopAngle/10000.0 * DEG2RAD - M_PI/2;
+    scan_msg->angle_increment = (double)cfg.angleResolution/10000.0 * DEG2RAD;
+    if(inverted) {
+      scan_msg->angle_min = (double)output_start/10000.0 * DEG2RAD - M_PI/2;
+      scan_msg->angle_max = (double)output_stop/10000.0 * DEG2RAD - M_PI/2;
+    } else {
+      scan_msg->angle_min = M_PI/2 - (double)output_stop/10000.0 * DEG2RAD;
+      scan_msg->angle_max = M_PI/2 - (double)output_start/10000.0 * DEG2RAD;
+    }
 
-    int num_values;
+    // values of the full range and of the sector sent by the scanner
+    int num_values_full = 0;
+    int num_values = 0;
     if (cfg.angleResolution == 2500)
     {
-      num_values = 1081;
+      num_values_full = 1081;
+      num_values = (output_stop - output_start)/cfg.angleResolution + 1;
     }
     else if (cfg.angleResolution == 5000)
     {
-      num_values = 541;
+      num_values_full = 541;
+      num_values = (output_stop - output_start)/cfg.angleResolution + 1;
     }
     else
     {
@@ -190,13 +305,15 @@ bool SickLMS1xxNode::initalizeMessage()
       ret = false;
     }
 
-    scan_msg.time_increment = scan_msg.scan_time/num_values;
+    // time between two measurements of one scan, independent of the output interval
+    if(num_values_full > 0)
+      scan_msg->time_increment = 100.0/cfg.scaningFrequency/num_values_full;
 
-    scan_msg.ranges.resize(num_values);
-    scan_msg.intensities.resize(num_values);
+    scan_msg->ranges.resize(num_values);
+    scan_msg->intensities.resize(publish_intensities ? num_values : 0);
 
     if(not inverted)
-      scan_msg.time_increment *= -1.;
+      scan_msg->time_increment *= -1.;
 
     return ret;
 }
@@ -205,12 +322,13 @@ void SickLMS1xxNode::setScanDataConfig()
 {
     //set scandata config
     dataCfg.outputChannel = 1;
-    dataCfg.remission = true;
-    dataCfg.resolution = 1;
+    dataCfg.remission = publish_intensities;
+    dataCfg.resolution = 0; // 8 bit remission
     dataCfg.encoder = 0;
     dataCfg.position = false;
     dataCfg.deviceName = false;
-    dataCfg.outputInterval = 1;
+    dataCfg.timestamp = false;
+    dataCfg.outputInterval = output_interval;
 
     laser.setScanDataCfg(dataCfg);
     ROS_DEBUG("setScanDataCfg");
@@ -238,21 +356,52 @@ void SickLMS1xxNode::startScanner()
 
 void SickLMS1xxNode::publish()
 {
-    scan_msg.header.stamp = ros::Time::now();
-    ++scan_msg.header.seq;
+    ros::Time stamp = ros::Time::now();
 
-    if(laser.getData(data))
-    {
-    for (int i = 0; i < data.dist_len1; i++)
+    if(laser.getData(prepareOutput()))
+      publishScan(stamp);
+}
+
+int SickLMS1xxNode::getSocket()
+{
+    return laser.getSocket();
+}
+
+bool SickLMS1xxNode::receiveAndPublish()
+{
+    if(!laser.receiveAvailable())
     {
-      if(not inverted) {
-      scan_msg.ranges[i] = data.dist1[data.dist_len1-1-i] * 0.001;
-      scan_msg.intensities[i] = data.rssi1[data.rssi_len1-1-i];
-      } else {
-      scan_msg.ranges[i] = data.dist1[i] * 0.001;
-      scan_msg.intensities[i] = data.rssi1[i];
-      }
+      ROS_ERROR("Connection to device lost");
+      publishError("Connection to device lost");
+      return false;
     }
+
+    // scans are complete when they are parsed
+    while(laser.getBufferedData(prepareOutput()))
+      publishScan(ros::Time::now());
+    return true;
+}
+
+scanOutput& SickLMS1xxNode::prepareOutput()
+{
+    // the published message may still be held by the publisher (latched or intraprocess subscribers),
+    // the next scan goes to a new one then
+    if(!scan_msg.unique())
+      scan_msg = boost::make_shared<sensor_msgs::LaserScan>(*scan_msg);
+
+    output.ranges = &scan_msg->ranges[0];
+    output.intensities = publish_intensities ? &scan_msg->intensities[0] : NULL;
+    output.size = scan_msg->ranges.size();
+    output.rangeScale = 0.001f;
+    output.reverse = not inverted;
+    return output;
+}
+
+void SickLMS1xxNode::publishScan(const ros::Time& stamp)
+{
+    scan_msg->header.stamp = stamp;
+    ++scan_msg->header.seq;
+
     scan_pub.publish(scan_msg);
 
     //Diagnostics
@@ -262,7 +411,6 @@ void SickLMS1xxNode::publish()
     diagnostics.status[0].name = nh.getNamespace();
     diagnostics.status[0].message = "sick scanner running";
     diagnostic_pub.publish(diagnostics);
-    }
 }
 
 void SickLMS1xxNode::stopScanner()
@@ -288,10 +436,73 @@ void SickLMS1xxNode::publishError(std::string error_str)
 
 //#######################
 //#### main programm ####
+
+/// Serves several scanners from one event loop, each scanner has its parameters and
+/// topics in the namespace given by its name in the 'scanners' parameter.
+int runMultipleScanners(const std::vector<std::string>& scanner_names)
+{
+    std::vector<boost::shared_ptr<SickLMS1xxNode> > nodes;
+    for(size_t i = 0; i < scanner_names.size(); i++)
+    {
+      boost::shared_ptr<SickLMS1xxNode> node(new SickLMS1xxNode(ros::NodeHandle(scanner_names[i])));
+      if (!node->initalize()) {
+        return 1;
+      }
+      nodes.push_back(node);
+    }
+
+    int epoll_fd = epoll_create(nodes.size());
+    if(epoll_fd < 0)
+    {
+      ROS_ERROR("Could not create event loop");
+      return 1;
+    }
+    for(size_t i = 0; i < nodes.size(); i++)
+    {
+      nodes[i]->startScanner();
+
+      struct epoll_event event;
+      event.events = EPOLLIN;
+      event.data.u32 = i;
+      if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, nodes[i]->getSocket(), &event) < 0)
+      {
+        ROS_ERROR("Could not add scanner %s to event loop", scanner_names[i].c_str());
+        return 1;
+      }
+    }
+
+    std::vector<struct epoll_event> events(nodes.size());
+    int ret = 0;
+    while(ros::ok() && ret == 0)
+    {
+      // wake up regularly for ROS callbacks
+      int num_events = epoll_wait(epoll_fd, &events[0], events.size(), 100);
+      for(int i = 0; i < num_events; i++)
+      {
+        if(!nodes[events[i].data.u32]->receiveAndPublish())
+          ret = 1;
+      }
+
+      ros::spinOnce();
+    }
+
+    close(epoll_fd);
+    for(size_t i = 0; i < nodes.size(); i++)
+      nodes[i]->stopScanner();
+
+    return ret;
+}
+
 int main(int argc, char** argv)
 {
     ros::init(argc, argv, "sick_lms1xx_node");
 
+    std::vector<std::string> scanner_names;
+    if(ros::NodeHandle().getParam("scanners", scanner_names) && !scanner_names.empty())
+    {
+      return runMultipleScanners(scanner_names);
+    }
+
     SickLMS1xxNode node;
 
     if (!node.initalize()) {
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+ 
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Estimates the capture time of S300 scans.
+ *
+ * The scanner increments its internal scan number every cycle. Relating it to the arrival time
+ * of the first byte of each telegram gives arrival = offset + counter*cycle_time + delay, where
+ * the delay (serial driver, scheduling) is always positive. The offset is therefore tracked as
+ * the lower envelope of the measured offsets, which is allowed to rise slowly to follow a clock drift.
+ */
+class ScanTimeEstimator
+{
+public:
+	/**
+	 * @param dCycleTime nominal scan cycle time of the scanner in seconds
+	 * @param dMaxDrift maximal relative clock drift between scanner and PC
+	 * @param dMaxJump offset change in seconds after which the estimator is reinitialized
+	 */
+	ScanTimeEstimator(const double dCycleTime = 0.04, const double dMaxDrift = 1e-4, const double dMaxJump = 0.5) :
+		m_dCycleTime(dCycleTime),
+		m_dMaxDrift(dMaxDrift),
+		m_dMaxJump(dMaxJump)
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		m_bInit = false;
+		m_uiLastScanNumber = 0;
+		m_llCounter = 0;
+		m_dOffset = 0;
+		m_dLastArrival = 0;
+	}
+
+	void setCycleTime(const double dCycleTime)
+	{
+		m_dCycleTime = dCycleTime;
+		reset();
+	}
+
+	/**
+	 * Adds a telegram and returns the estimated capture time of its scan.
+	 * @param uiScanNumber scan number from the telegram header
+	 * @param dArrivalTime monotonic time (getMonotonicTime) the first byte of the telegram was received
+	 */
+	double update(const uint32_t uiScanNumber, const double dArrivalTime)
+	{
+		// the counter wraps around, so only its difference is used
+		const int32_t iStep = (int32_t)(uiScanNumber - m_uiLastScanNumber);
+
+		if(m_bInit && iStep > 0)
+		{
+			m_llCounter += iStep;
+			const double dOffset = dArrivalTime - m_llCounter*m_dCycleTime;
+			const double dRelaxed = m_dOffset + m_dMaxDrift*(dArrivalTime - m_dLastArrival);
+
+			if(dOffset - dRelaxed > m_dMaxJump)
+				m_bInit = false; // scanner restarted or telegrams were lost for a long time
+			else
+				m_dOffset = (dOffset < dRelaxed) ? dOffset : dRelaxed;
+		}
+		else
+			m_bInit = false;
+
+		if(!m_bInit)
+		{
+			m_bInit = true;
+			m_llCounter = 0;
+			m_dOffset = dArrivalTime;
+		}
+
+		m_uiLastScanNumber = uiScanNumber;
+		m_dLastArrival = dArrivalTime;
+
+		return m_dOffset + m_llCounter*m_dCycleTime;
+	}
+
+	static double getMonotonicTime()
+	{
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec + ts.tv_nsec*1e-9;
+	}
+
+private:
+	double m_dCycleTime;
+	double m_dMaxDrift;
+	double m_dMaxJump;
+
+	bool m_bInit;
+	uint32_t m_uiLastScanNumber;
+	long long m_llCounter;
+	double m_dOffset;
+	double m_dLastArrival;
+};
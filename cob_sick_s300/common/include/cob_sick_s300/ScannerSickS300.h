@@ -27,8 +27,13 @@
 #include <math.h>
 #include <stdio.h>
 
-#include <cob_sick_s300/SerialIO.h>
+#include <boost/function.hpp>
+#include <boost/atomic.hpp>
+
+#include <cob_utilities/RawLog.h>
+#include <cob_utilities/SerialIO.h>
 #include <cob_sick_s300/TelegramS300.h>
+#include <cob_sick_s300/ScanTimeEstimator.h>
 
 /**
  * Driver class for the laser scanner SICK S300 Professional.
@@ -61,6 +66,9 @@ public:
 	enum
 	{
 		SCANNER_S300_READ_BUF_SIZE = 10000,
+		// upper bound of one telegram, a candidate header which claims more is junk
+		SCANNER_S300_MAX_TELEGRAM_SIZE = 2000,
+		SCANNER_S300_MAX_POINTS = SCANNER_S300_MAX_TELEGRAM_SIZE/2,
 		READ_BUF_SIZE = 10000,
 		WRITE_BUF_SIZE = 10000
 	};
@@ -79,6 +87,47 @@ public:
 	 */
 	bool open(const char* pcPort, int iBaudRate, int iScanId);
 
+	/**
+	 * Registers another scanner head on the same line, e.g. a slave scanner with device address 8.
+	 * Every telegram is parsed once. With more than one head it is dispatched by its device address
+	 * and telegrams of other addresses are dropped, a single head accepts every address.
+	 * @return index of the head for the per-head accessors, the head given to open() has index 0
+	 */
+	int addHead(int iScanId);
+
+	size_t getNumHeads() const {return m_Heads.size();}
+
+	// device address of a head
+	int getScanId(const int iHead = 0) const {return m_Heads[iHead].iScanId;}
+
+	// number of telegrams dropped because their device address belongs to no head, may be called from any thread
+	unsigned long getForeignTelegrams() const {return m_ulForeignTelegrams.load(boost::memory_order_relaxed);}
+
+	// number of telegrams dropped because of a wrong CRC, may be called from any thread
+	unsigned long getCrcErrors() const {return m_ulCrcErrors.load(boost::memory_order_relaxed);}
+
+	/**
+	 * Closes and reopens the serial port with the parameters of the last open(), for real disconnects.
+	 */
+	bool reconnect();
+
+	/**
+	 * Cheap recovery from a corrupted stream: drops the framer state and searches for the next header
+	 * from the following byte on. The port stays open and the scan time estimation is kept.
+	 */
+	void resync();
+
+	/**
+	 * True if the port reported an error or a hangup since the last open(), the scanner then needs a reconnect().
+	 */
+	bool hasPortError() const {return m_bPortError;}
+
+	/// Monotonic time (ScanTimeEstimator::getMonotonicTime) of the last received byte, or of the last open().
+	double getLastDataTime() const {return m_dLastDataTime;}
+
+	/// Monotonic time of the last complete telegram, or of the last open() or resync().
+	double getLastTelegramTime() const {return m_dLastTelegramTime;}
+
 	// not implemented
 	void resetStartup();
 
@@ -90,13 +139,83 @@ public:
 	//sick_lms.Uninitialize();
 
 	// whether the scanner is currently in Standby or not
-	bool isInStandby() {return m_bInStandby;}
+	bool isInStandby(const int iHead = 0) const {return m_Heads[iHead].bInStandby;}
+
+	// whether the head received a scan which was not yet taken with getLastScan
+	bool hasNewScan(const int iHead) const {return m_Heads[iHead].bNewScan;}
 
 	void purgeScanBuf();
 
 	bool getScan(std::vector<double> &vdDistanceM, std::vector<double> &vdAngleRAD, std::vector<double> &vdIntensityAU, unsigned int &iTimestamp, unsigned int &iTimeNow, const bool debug);
 
-	void setRangeField(const int field, const ParamType &param) {m_Params[field] = param;}
+	/**
+	 * Same as above, but writes into caller-owned arrays, so no memory is allocated per scan.
+	 * @param uiMaxPoints capacity of each of the three arrays
+	 * @param uiNumPoints number of points written into the arrays
+	 */
+	bool getScan(double *pdDistanceM, double *pdAngleRAD, double *pdIntensityAU, const size_t uiMaxPoints, size_t &uiNumPoints, unsigned int &iTimestamp, unsigned int &iTimeNow, const bool debug);
+
+	/**
+	 * Single precision variant, which can write directly into the ranges/intensities of a laser scan message.
+	 * The angles are equidistant, so only the first angle and the step are returned.
+	 */
+	bool getScan(float *pfDistanceM, float *pfIntensityAU, const size_t uiMaxPoints, size_t &uiNumPoints, double &dAngleMinRAD, double &dAngleStepRAD, unsigned int &iTimestamp, unsigned int &iTimeNow, const bool debug);
+
+	/**
+	 * Reads from the serial port and frames the received data.
+	 * @return true if a new scan was received by any head, it can be retrieved with getLastScan
+	 */
+	bool readScan(const bool debug);
+
+	/**
+	 * Converts the last received scan of a head, see the single precision getScan for the parameters.
+	 */
+	bool getLastScan(float *pfDistanceM, float *pfIntensityAU, const size_t uiMaxPoints, size_t &uiNumPoints, double &dAngleMinRAD, double &dAngleStepRAD, const bool debug, const int iHead = 0);
+
+	typedef boost::function<void ()> ScanCallback;
+
+	/**
+	 * Event driven alternative to readScan.
+	 * Waits until the serial port delivers data, frames everything available and calls the callback
+	 * if a complete telegram was received (of any head, see hasNewScan).
+	 * @param dTimeout maximum time to wait in seconds
+	 * @return false on timeout or error
+	 */
+	bool waitForScan(const double dTimeout, const ScanCallback &callback, const bool debug);
+
+	/**
+	 * Estimated capture time of the last scan in seconds of the monotonic clock (ScanTimeEstimator::getMonotonicTime),
+	 * based on the arrival time of the first byte of each telegram and the internal scan number.
+	 */
+	double getLastScanTime(const int iHead = 0) const {return m_Heads[iHead].dLastScanTime;}
+
+	// internal scan number of the last scan
+	unsigned int getLastScanNumber(const int iHead = 0) const {return m_Heads[iHead].uiLastScanNumber;}
+
+	// traffic and read latency counters of the serial port
+	void getSerialStatistics(SerialIO::Statistics* pStatistics) const {m_SerialIO.getStatistics(pStatistics);}
+
+	/**
+	 * Logs every chunk read from the serial port, including garbage between the telegrams.
+	 * @param pLog an open log, or NULL to stop logging. It has to outlive the scanner.
+	 */
+	void setRawLog(RawLog *pLog) {m_pRawLog = pLog;}
+
+	/**
+	 * Frames a chunk of data as if it had been read from the serial port, e.g. to replay a RawLog.
+	 * @param dReadTime monotonic time when the last byte of the chunk was received
+	 * @return true if a new scan was received by any head, it can be retrieved with getLastScan
+	 */
+	bool parseData(const unsigned char *pData, int iSize, const double dReadTime, const bool debug);
+
+	// nominal cycle time used to relate scan numbers to time (40ms for the S300), for all heads
+	void setScanCycleTime(const double dCycleTime);
+
+	void setRangeField(const int field, const ParamType &param, const int iHead = 0)
+	{
+		m_Heads[iHead].Params[field].param = param;
+		m_Heads[iHead].Params[field].vdAngleRAD.clear();
+	}
 
 private:
 
@@ -104,27 +223,83 @@ private:
 	static const double c_dPi;
 
 	// Parameters
-	typedef std::map<int, ParamType> PARAM_MAP;
-	PARAM_MAP m_Params;
+	struct FieldType
+	{
+		ParamType param;
+		// angle of each beam, computed once for the number of beams of this field
+		std::vector<double> vdAngleRAD;
+	};
+	typedef std::map<int, FieldType> PARAM_MAP;
 	double m_dBaudMult;
 
+	// state of one scanner head
+	struct HeadType
+	{
+		// device address in the telegram header
+		int iScanId;
+		PARAM_MAP Params;
+		std::vector<int> viScanRaw;
+		// field of the last complete telegram
+		int iField;
+		double dLastScanTime;
+		unsigned int uiLastScanNumber;
+		ScanTimeEstimator TimeEstimator;
+		bool bInStandby;
+		bool bNewScan;
+	};
+	std::vector<HeadType> m_Heads;
+	boost::atomic<unsigned long> m_ulForeignTelegrams;
+	boost::atomic<unsigned long> m_ulCrcErrors;
+
 	// Variables
 	unsigned char m_ReadBuf[READ_BUF_SIZE+10];
 	unsigned char m_ReadBuf2[READ_BUF_SIZE+10];
 	unsigned int m_uiSumReadBytes;
-	std::vector<int> m_viScanRaw;
 	int m_iPosReadBuf2;
-	static unsigned char m_iScanId;
 	int m_actualBufferSize;
-	bool m_bInStandby;
+	// first byte in m_ReadBuf which was not yet consumed by the framer
+	int m_iBufStart;
+	// transmission time of one byte (start + 8 data + stop bit)
+	double m_dBytePeriod;
+	// port settings of the last open(), for reconnect()
+	std::string m_sPort;
+	int m_iBaudRate;
+	bool m_bPortError;
+	double m_dLastDataTime;
+	double m_dLastTelegramTime;
 
 	// Components
 	SerialIO m_SerialIO;
 	TelegramParser tp_;
+	RawLog *m_pRawLog;
 
 	// Functions
-	void convertScanToPolar(const PARAM_MAP::const_iterator param, std::vector<int> viScanRaw,
-							std::vector<ScanPolarType>& vecScanPolar);
+	/**
+	 * Reads from the serial port and frames the received bytes.
+	 * The framer state is kept between calls, so bytes are searched only once.
+	 * @return true if at least one complete telegram was found, viScanRaw of its head then holds the newest one
+	 */
+	bool readTelegram(const bool debug, const bool bBlocking = true);
+
+	// makes room for the next chunk in m_ReadBuf, returns the free space
+	int prepareReadBuf();
+
+	// searches the iNumRead bytes appended to m_ReadBuf for telegrams
+	bool frameTelegrams(const int iNumRead, const double dReadTime, const bool debug);
+
+	// head of a device address, -1 if the telegram belongs to no head
+	int findHead(const int iScanId) const;
+
+	// returns the angle table of the field, it is recomputed only if the number of beams changed
+	const std::vector<double>& getAngleTable(const PARAM_MAP::iterator param, const size_t uiNumPoints);
+
+	// returns true if the scan shows the standby pattern
+	bool convertScanToPolar(const PARAM_MAP::iterator param, const std::vector<int>& viScanRaw,
+							double *pdDistanceM, double *pdAngleRAD, double *pdIntensityAU);
+
+	// converts distances and intensities, returns true if the scan shows the standby pattern
+	template<typename T>
+	bool convertRanges(const double dScale, const std::vector<int>& viScanRaw, T *pDistanceM, T *pIntensityAU);
 
 };
 
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <arpa/inet.h>
+#include <endian.h>
 
 /*
 * S300 header format in continuous mode:
@@ -175,8 +176,6 @@ class TelegramParser {
 		std::cout<<std::dec<<std::endl;
 	}
 
-	//-------------------------------------------
-	static unsigned int createCRC(uint8_t *ptrData, int Size);
 
 	//supports versions: 0301, 0201
 	static bool check(const TELEGRAM_COMMON1 &tc, const uint8_t DEVICE_ADDR) {
@@ -193,22 +192,62 @@ class TelegramParser {
 		return true;
 	}
 
+	// the tail must not be read beyond the received data, a too small buffer means the telegram is not yet complete
+	bool checkSize(const int full_data_size, const size_t max_size, const bool debug) {
+		if(full_data_size < (int)getMinHeaderSize()) {
+			if(debug) std::cout<<"invalid header size"<<std::endl;
+			return false;
+		}
+		if(full_data_size > (int)max_size) {
+			if(debug) std::cout<<"incomplete telegram"<<std::endl;
+			incomplete_ = true;
+			return false;
+		}
+		return true;
+	}
+
 	TELEGRAM_COMMON1 tc1_;
 	TELEGRAM_COMMON2 tc2_;
 	TELEGRAM_COMMON3 tc3_;
 	TELEGRAM_DISTANCE td_;
 	int size_field_start_byte_, crc_bytes_in_size_, user_data_size_;
+	bool incomplete_;
+	bool crc_error_;
 public:
 
+	/**
+	 * CRC16-CCITT over the telegram (without the first JUNK_SIZE bytes).
+	 * Uses createCRCSliceBy8 unless S300_CRC_BYTEWISE is defined at compile time.
+	 */
+	static unsigned int createCRC(const uint8_t *ptrData, int Size);
+
+	// reference implementation, one table lookup per byte
+	static unsigned int createCRCBytewise(const uint8_t *ptrData, int Size);
+
+	// processes eight bytes per iteration with eight lookup tables
+	static unsigned int createCRCSliceBy8(const uint8_t *ptrData, int Size);
+
 	TelegramParser() :
 		size_field_start_byte_(0),
 		crc_bytes_in_size_(0),
-		user_data_size_(0)
+		user_data_size_(0),
+		incomplete_(false),
+		crc_error_(false)
 	{}
 
+	// size of the header part which has to be available before parseHeader can decide anything
+	static size_t getMinHeaderSize() {
+		return sizeof(TELEGRAM_COMMON1)+sizeof(TELEGRAM_COMMON2)+sizeof(TELEGRAM_COMMON3)+sizeof(TELEGRAM_DISTANCE);
+	}
+
 	bool parseHeader(const unsigned char *buffer, const size_t max_size, const uint8_t DEVICE_ADDR, const bool debug)
 	{
-		if(sizeof(tc1_)>max_size) return false;
+		incomplete_ = false;
+		crc_error_ = false;
+		if(sizeof(tc1_)>max_size) {
+			incomplete_ = true;
+			return false;
+		}
 		tc1_ = *((TELEGRAM_COMMON1*)buffer);
 
 		if(!check(tc1_, DEVICE_ADDR)) {
@@ -216,6 +255,11 @@ public:
 			return false;
 		}
 
+		if(getMinHeaderSize()>max_size) {
+			incomplete_ = true;
+			return false;
+		}
+
 		ntoh(tc1_);
 		if(debug) print(tc1_);
 
@@ -246,6 +290,7 @@ public:
 				2*tc1_.size -
 				(sizeof(TELEGRAM_COMMON1) + sizeof(TELEGRAM_COMMON2) - size_field_start_byte_ + crc_bytes_in_size_);
 			full_data_size = sizeof(TELEGRAM_COMMON1)+sizeof(TELEGRAM_COMMON2)+user_data_size_+sizeof(TELEGRAM_TAIL);
+			if(!checkSize(full_data_size, max_size, debug)) return false;
 
 			tt = *((TELEGRAM_TAIL*) (buffer+(sizeof(TELEGRAM_COMMON1)+sizeof(TELEGRAM_COMMON2)+user_data_size_)) );
 			ntoh(tt);
@@ -263,6 +308,7 @@ public:
 				2*tc1_.size -
 				(sizeof(TELEGRAM_COMMON1) + sizeof(TELEGRAM_COMMON2) - size_field_start_byte_ + crc_bytes_in_size_);
 			full_data_size = sizeof(TELEGRAM_COMMON1)+sizeof(TELEGRAM_COMMON2)+user_data_size_+sizeof(TELEGRAM_TAIL);
+			if(!checkSize(full_data_size, max_size, debug)) return false;
 
 			tt = *((TELEGRAM_TAIL*) (buffer+(sizeof(TELEGRAM_COMMON1)+sizeof(TELEGRAM_COMMON2)+user_data_size_)) );
 			ntoh(tt);
@@ -280,6 +326,7 @@ public:
 					(sizeof(TELEGRAM_COMMON1) + sizeof(TELEGRAM_COMMON2) - size_field_start_byte_ + crc_bytes_in_size_);
 				full_data_size =
 					sizeof(TELEGRAM_COMMON1)+sizeof(TELEGRAM_COMMON2)+user_data_size_+sizeof(TELEGRAM_TAIL);
+				if(!checkSize(full_data_size, max_size, debug)) return false;
 
 				tt = *((TELEGRAM_TAIL*) (buffer+(sizeof(TELEGRAM_COMMON1)+sizeof(TELEGRAM_COMMON2)+user_data_size_)) );
 				ntoh(tt);
@@ -287,13 +334,6 @@ public:
 			}
 		}
 
-		if( (sizeof(TELEGRAM_COMMON1)+sizeof(TELEGRAM_COMMON2)+user_data_size_+sizeof(TELEGRAM_TAIL)) > (int)max_size)
-		{
-			if(debug) std::cout<<"invalid header size"<<std::endl;
-			return false;
-		}
-
-
 		if(tt.crc!=crc) {
 			if(debug) {
 				print(tc2_);
@@ -302,6 +342,7 @@ public:
 				std::cout<<"at "<<std::dec<<(sizeof(TELEGRAM_COMMON1)+sizeof(TELEGRAM_COMMON2)+user_data_size_)<<std::hex<<std::endl;
 				std::cout<<"invalid CRC: "<<crc<<" ("<<tt.crc<<")"<<std::endl;
 			}
+			crc_error_ = true;
 			return false;
 		}
 
@@ -324,7 +365,19 @@ public:
 		return true;
 	}
 
+	// whether the last call to parseHeader failed only because the telegram was not completely received yet
+	bool isIncomplete() const {return incomplete_;}
+
+	// whether the last call to parseHeader found a complete telegram of the scanner with a wrong CRC
+	bool isCrcError() const {return crc_error_;}
+
 	bool isDist() const {return tc3_.type==DISTANCE;}
+	// device address of the scanner head (7, 8 for slave scanners)
+	int getDeviceAddress() const {return tc1_.device_addresss;}
+	// internal scan counter of the scanner, incremented every scan cycle.
+	// Little endian like the protocol version, the distances and the CRC (ntoh is not applied to tc2_)
+	uint32_t getScanNumber() const {return le32toh(tc2_.scan_number);}
+
 	int getField() const {
 		switch(td_.type) {
 			case _1: return 1;
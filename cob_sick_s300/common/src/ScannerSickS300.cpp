@@ -16,15 +16,18 @@
  
 
 #include <cob_sick_s300/ScannerSickS300.h>
+#include <cob_utilities/Trace.h>
 
+#include <algorithm>
+#include <errno.h>
 #include <stdint.h>
+#include <string.h>
 
 //-----------------------------------------------
 
 typedef unsigned char BYTE;
 
 const double ScannerSickS300::c_dPi = 3.14159265358979323846;
-unsigned char ScannerSickS300::m_iScanId = 7;
 
 const unsigned short crc_LookUpTable[256]
 	   = {
@@ -62,7 +65,26 @@ const unsigned short crc_LookUpTable[256]
 	   0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
 	 };
 
-unsigned int TelegramParser::createCRC(uint8_t *ptrData, int Size)
+// crc_SliceTable[k][b] is the crc contribution of byte b followed by k zero bytes
+class CrcSliceTable
+{
+public:
+	unsigned short table[8][256];
+
+	CrcSliceTable()
+	{
+		for(int b=0; b<256; b++)
+		{
+			table[0][b] = crc_LookUpTable[b];
+			for(int k=1; k<8; k++)
+				table[k][b] = (unsigned short)(table[k-1][b] << 8) ^ crc_LookUpTable[table[k-1][b] >> 8];
+		}
+	}
+};
+
+static const CrcSliceTable crc_SliceTable;
+
+unsigned int TelegramParser::createCRCBytewise(const uint8_t *ptrData, int Size)
 {
 	int CounterWord;
 	unsigned short CrcValue=0xFFFF;
@@ -76,6 +98,35 @@ unsigned int TelegramParser::createCRC(uint8_t *ptrData, int Size)
 	return (CrcValue);
 }
 
+unsigned int TelegramParser::createCRCSliceBy8(const uint8_t *ptrData, int Size)
+{
+	const unsigned short (*T)[256] = crc_SliceTable.table;
+	unsigned short CrcValue=0xFFFF;
+
+	// the crc register only overlaps with the first two bytes of each block
+	for (; Size >= 8; Size -= 8, ptrData += 8)
+	{
+		CrcValue =
+			T[7][ptrData[0] ^ (CrcValue >> 8)] ^ T[6][ptrData[1] ^ (CrcValue & 0xFF)] ^
+			T[5][ptrData[2]] ^ T[4][ptrData[3]] ^ T[3][ptrData[4]] ^
+			T[2][ptrData[5]] ^ T[1][ptrData[6]] ^ T[0][ptrData[7]];
+	}
+
+	for (; Size > 0; Size--, ptrData++)
+		CrcValue = (CrcValue << 8) ^ crc_LookUpTable[ (((uint8_t)(CrcValue >> 8)) ^ *ptrData) ];
+
+	return (CrcValue);
+}
+
+unsigned int TelegramParser::createCRC(const uint8_t *ptrData, int Size)
+{
+#ifdef S300_CRC_BYTEWISE
+	return createCRCBytewise(ptrData, Size);
+#else
+	return createCRCSliceBy8(ptrData, Size);
+#endif
+}
+
 //-----------------------------------------------
 ScannerSickS300::ScannerSickS300()
 {
@@ -86,9 +137,19 @@ ScannerSickS300::ScannerSickS300()
 	m_iPosReadBuf2 = 0;
 
 	m_actualBufferSize = 0;
+	m_iBufStart = 0;
 
-	m_bInStandby = true;
+	m_dBytePeriod = 0;
 
+	m_iBaudRate = 0;
+	m_bPortError = false;
+	m_dLastDataTime = 0;
+	m_dLastTelegramTime = 0;
+
+	m_ulForeignTelegrams = 0;
+	m_ulCrcErrors = 0;
+	m_pRawLog = NULL;
+	addHead(7);
 }
 
 
@@ -105,7 +166,18 @@ bool ScannerSickS300::open(const char* pcPort, int iBaudRate, int iScanId=7)
     int bRetSerial;
 
 	// update scan id (id=8 for slave scanner, else 7)
-	m_iScanId = iScanId;
+	m_Heads[0].iScanId = iScanId;
+	m_sPort = pcPort;
+	m_iBaudRate = iBaudRate;
+	m_bPortError = false;
+	m_dLastDataTime = m_dLastTelegramTime = ScanTimeEstimator::getMonotonicTime();
+
+	m_dBytePeriod = (iBaudRate > 0) ? 10.0/iBaudRate : 0.0;
+	for(size_t i=0; i<m_Heads.size(); i++)
+	{
+		m_Heads[i].TimeEstimator.reset();
+		m_Heads[i].bNewScan = false;
+	}
 
 	// initialize Serial Interface
 	m_SerialIO.setBaudRate(iBaudRate);
@@ -113,6 +185,9 @@ bool ScannerSickS300::open(const char* pcPort, int iBaudRate, int iScanId=7)
 	m_SerialIO.setBufferSize(READ_BUF_SIZE - 10 , WRITE_BUF_SIZE -10 );
 	m_SerialIO.setHandshake(SerialIO::HS_NONE);
 	m_SerialIO.setMultiplier(m_dBaudMult);
+	m_SerialIO.setLowLatency(true);
+	// a reopen must not leak the descriptor of the lost device
+	m_SerialIO.closeIO();
 	bRetSerial = m_SerialIO.openIO();
 	m_SerialIO.setTimeout(0.0);
 	m_SerialIO.SetFormat(8, SerialIO::PA_NONE, SerialIO::SB_ONE);
@@ -121,6 +196,8 @@ bool ScannerSickS300::open(const char* pcPort, int iBaudRate, int iScanId=7)
     {
 	    // Clears the read and transmit buffer.
 	    m_iPosReadBuf2 = 0;
+	    m_actualBufferSize = 0;
+	    m_iBufStart = 0;
 	    m_SerialIO.purge();
 	    return true;
     }
@@ -131,10 +208,70 @@ bool ScannerSickS300::open(const char* pcPort, int iBaudRate, int iScanId=7)
 }
 
 
+//-------------------------------------------
+bool ScannerSickS300::reconnect()
+{
+	if(m_sPort.empty())
+		return false;
+	return open(m_sPort.c_str(), m_iBaudRate, m_Heads[0].iScanId);
+}
+
+
+//-------------------------------------------
+int ScannerSickS300::addHead(int iScanId)
+{
+	HeadType head;
+	head.iScanId = iScanId;
+	head.iField = -1;
+	head.dLastScanTime = 0;
+	head.uiLastScanNumber = 0;
+	head.bInStandby = true;
+	head.bNewScan = false;
+	if(!m_Heads.empty())
+		head.TimeEstimator = m_Heads[0].TimeEstimator;
+	m_Heads.push_back(head);
+	return m_Heads.size()-1;
+}
+
+
+//-------------------------------------------
+int ScannerSickS300::findHead(const int iScanId) const
+{
+	if(m_Heads.size()==1)
+		return 0;
+	for(size_t i=0; i<m_Heads.size(); i++)
+	{
+		if(m_Heads[i].iScanId==iScanId)
+			return i;
+	}
+	return -1;
+}
+
+
+//-------------------------------------------
+void ScannerSickS300::setScanCycleTime(const double dCycleTime)
+{
+	for(size_t i=0; i<m_Heads.size(); i++)
+		m_Heads[i].TimeEstimator.setCycleTime(dCycleTime);
+}
+
+
+//-------------------------------------------
+void ScannerSickS300::resync()
+{
+	// give up the candidate the framer waits for, the search continues at the next sync byte
+	if(m_iBufStart < m_actualBufferSize)
+		m_iBufStart++;
+	m_dLastTelegramTime = ScanTimeEstimator::getMonotonicTime();
+}
+
+
 //-------------------------------------------
 void ScannerSickS300::purgeScanBuf()
 {
 	m_iPosReadBuf2 = 0;
+	m_actualBufferSize = 0;
+	m_iBufStart = 0;
 	m_SerialIO.purge();
 }
 
@@ -157,92 +294,294 @@ void ScannerSickS300::stopScanner()
 }
 
 //-----------------------------------------------
-bool ScannerSickS300::getScan(std::vector<double> &vdDistanceM, std::vector<double> &vdAngleRAD, std::vector<double> &vdIntensityAU, unsigned int &iTimestamp, unsigned int &iTimeNow, const bool debug)
+int ScannerSickS300::prepareReadBuf()
 {
-	bool bRet = false;
-	int i;
-	int iNumRead2 = 0;
-	std::vector<ScanPolarType> vecScanPolar;
-
-	iTimeNow=0;
+	// only move the unconsumed rest to the front if the free space gets short
+	if(SCANNER_S300_READ_BUF_SIZE-m_actualBufferSize < SCANNER_S300_MAX_TELEGRAM_SIZE)
+	{
+		m_actualBufferSize -= m_iBufStart;
+		memmove(m_ReadBuf, m_ReadBuf+m_iBufStart, m_actualBufferSize);
+		m_iBufStart = 0;
+	}
 
 	if(SCANNER_S300_READ_BUF_SIZE-2-m_actualBufferSize<=0)
-		m_actualBufferSize=0;
+		m_actualBufferSize = m_iBufStart = 0;
+
+	return SCANNER_S300_READ_BUF_SIZE-2-m_actualBufferSize;
+}
+
+//-----------------------------------------------
+bool ScannerSickS300::readTelegram(const bool debug, const bool bBlocking)
+{
+	int iNumRead = 0;
+	const int iFree = prepareReadBuf();
+
+	if(bBlocking)
+		iNumRead = m_SerialIO.readBlocking((char*)m_ReadBuf+m_actualBufferSize, iFree);
+	else
+		iNumRead = m_SerialIO.readNonBlocking((char*)m_ReadBuf+m_actualBufferSize, iFree);
+	if(iNumRead<=0)
+	{
+		if(iNumRead<0 && errno!=EAGAIN && errno!=EINTR)
+			m_bPortError = true;
+		return false;
+	}
+	const double dReadTime = ScanTimeEstimator::getMonotonicTime();
+	m_dLastDataTime = dReadTime;
+
+	if(m_pRawLog!=NULL)
+		m_pRawLog->write(m_ReadBuf+m_actualBufferSize, iNumRead, (int64_t)(dReadTime*1e9));
+
+	return frameTelegrams(iNumRead, dReadTime, debug);
+}
+
+//-----------------------------------------------
+bool ScannerSickS300::parseData(const unsigned char *pData, int iSize, const double dReadTime, const bool debug)
+{
+	bool bRet = false;
+	while(iSize>0)
+	{
+		const int iNum = std::min(iSize, prepareReadBuf());
+		memcpy(m_ReadBuf+m_actualBufferSize, pData, iNum);
+		m_dLastDataTime = dReadTime;
+		bRet |= frameTelegrams(iNum, dReadTime, debug);
+		pData += iNum;
+		iSize -= iNum;
+	}
+	return bRet;
+}
 
-	iNumRead2 = m_SerialIO.readBlocking((char*)m_ReadBuf+m_actualBufferSize, SCANNER_S300_READ_BUF_SIZE-2-m_actualBufferSize);
-	if(iNumRead2<=0) return false;
+//-----------------------------------------------
+bool ScannerSickS300::frameTelegrams(const int iNumRead, const double dReadTime, const bool debug)
+{
+	// offset of the coordination flag (0xFF) within the header, used as sync pattern
+	const int iSyncOffset = 8;
+	bool bRet = false;
 
-	m_actualBufferSize = m_actualBufferSize + iNumRead2;
+	m_actualBufferSize += iNumRead;
 
-	// Try to find scan. Searching backwards in the receive queue.
-	for(i=m_actualBufferSize; i>=0; i--)
+	// Search forward for telegrams, everything before a complete telegram is consumed.
+	// If several telegrams are in the buffer, the newest one is kept.
+	int iPos = m_iBufStart;
+	while(iPos+iSyncOffset < m_actualBufferSize)
 	{
-		// parse through the telegram until header with correct scan id is found
-		if(tp_.parseHeader(m_ReadBuf+i, m_actualBufferSize-i, m_iScanId, debug))
+		const unsigned char *pSync = (const unsigned char*)memchr(m_ReadBuf+iPos+iSyncOffset, 0xFF, m_actualBufferSize-iPos-iSyncOffset);
+		if(pSync==NULL)
 		{
-			tp_.readDistRaw(m_ReadBuf+i, m_viScanRaw, debug);
-			if(m_viScanRaw.size()>0) {
+			iPos = m_actualBufferSize-iSyncOffset;
+			break;
+		}
+
+		const int iCand = (pSync-m_ReadBuf)-iSyncOffset;
+		if(tp_.parseHeader(m_ReadBuf+iCand, m_actualBufferSize-iCand, m_Heads[0].iScanId, debug))
+		{
+			m_dLastTelegramTime = dReadTime;
+			const int iHead = findHead(tp_.getDeviceAddress());
+			if(iHead<0)
+			{
+				m_ulForeignTelegrams.fetch_add(1, boost::memory_order_relaxed);
+			}
+			else if(tp_.isDist())
+			{
+				HeadType &head = m_Heads[iHead];
+				tp_.readDistRaw(m_ReadBuf+iCand, head.viScanRaw, debug);
 				// Scan was succesfully read from buffer
-				bRet = true;
-				int old = m_actualBufferSize;
-				m_actualBufferSize -= tp_.getCompletePacketSize()+i;
-				for(int i=0; i<old-m_actualBufferSize; i++)
-				    m_ReadBuf[i] = m_ReadBuf[i+old-m_actualBufferSize];
-				break;
+				if(!head.viScanRaw.empty())
+				{
+					head.bNewScan = true;
+					bRet = true;
+				}
+				head.iField = tp_.getField();
+
+				// the last received byte arrived at dReadTime, go back to the first byte of the telegram
+				head.uiLastScanNumber = tp_.getScanNumber();
+				head.dLastScanTime = head.TimeEstimator.update(head.uiLastScanNumber,
+					dReadTime - (m_actualBufferSize-iCand)*m_dBytePeriod);
 			}
+			iPos = iCand+tp_.getCompletePacketSize();
+		}
+		else if(tp_.isIncomplete() && m_actualBufferSize-iCand < SCANNER_S300_MAX_TELEGRAM_SIZE)
+		{
+			// wait for the rest of the telegram
+			iPos = iCand;
+			break;
+		}
+		else
+		{
+			if(tp_.isCrcError())
+				m_ulCrcErrors.fetch_add(1, boost::memory_order_relaxed);
+			iPos = iCand+1;
 		}
 	}
+	m_iBufStart = iPos;
+
+	return bRet;
+}
+
+//-----------------------------------------------
+bool ScannerSickS300::getScan(std::vector<double> &vdDistanceM, std::vector<double> &vdAngleRAD, std::vector<double> &vdIntensityAU, unsigned int &iTimestamp, unsigned int &iTimeNow, const bool debug)
+{
+	TRACE_SCOPE("ScannerSickS300::getScan");
+	iTimeNow=0;
 
-	PARAM_MAP::const_iterator param = m_Params.find(tp_.getField());
-	if(bRet && param!=m_Params.end())
+	if(!readTelegram(debug)) return false;
+	HeadType &head = m_Heads[0];
+	head.bNewScan = false;
+	iTimestamp = head.uiLastScanNumber;
+
+	PARAM_MAP::iterator param = head.Params.find(head.iField);
+	if(param!=head.Params.end())
 	{
+		// resize vectors to size of Scan, this does not reallocate as long as the size stays the same
+		vdDistanceM.resize(head.viScanRaw.size());
+		vdAngleRAD.resize(head.viScanRaw.size());
+		vdIntensityAU.resize(head.viScanRaw.size());
+
 		// convert data into range and intensity information
-		convertScanToPolar(param, m_viScanRaw, vecScanPolar);
-
-		// resize vectors to size of Scan
-		vdDistanceM.resize(vecScanPolar.size());
-		vdAngleRAD.resize(vecScanPolar.size());
-		vdIntensityAU.resize(vecScanPolar.size());
-		// assign outputs
-		for(unsigned int i=0; i < vecScanPolar.size(); i++)
+		head.bInStandby = convertScanToPolar(param, head.viScanRaw, &vdDistanceM[0], &vdAngleRAD[0], &vdIntensityAU[0]);
+	}
+
+	return true;
+}
+
+//-----------------------------------------------
+bool ScannerSickS300::getScan(double *pdDistanceM, double *pdAngleRAD, double *pdIntensityAU, const size_t uiMaxPoints, size_t &uiNumPoints, unsigned int &iTimestamp, unsigned int &iTimeNow, const bool debug)
+{
+	TRACE_SCOPE("ScannerSickS300::getScan");
+	iTimeNow=0;
+	uiNumPoints=0;
+
+	if(!readTelegram(debug)) return false;
+	HeadType &head = m_Heads[0];
+	head.bNewScan = false;
+	iTimestamp = head.uiLastScanNumber;
+
+	PARAM_MAP::iterator param = head.Params.find(head.iField);
+	if(param!=head.Params.end())
+	{
+		if(head.viScanRaw.size()>uiMaxPoints)
 		{
-			vdDistanceM[i] = vecScanPolar[i].dr;
-			vdAngleRAD[i] = vecScanPolar[i].da;
-			vdIntensityAU[i] = vecScanPolar[i].di;
+			if(debug) std::cout<<"scan with "<<head.viScanRaw.size()<<" points does not fit into "<<uiMaxPoints<<std::endl;
+			return false;
 		}
+
+		head.bInStandby = convertScanToPolar(param, head.viScanRaw, pdDistanceM, pdAngleRAD, pdIntensityAU);
+		uiNumPoints = head.viScanRaw.size();
 	}
 
-	return bRet;
+	return true;
 }
 
-//-------------------------------------------
-void ScannerSickS300::convertScanToPolar(const PARAM_MAP::const_iterator param, std::vector<int> viScanRaw,
-							std::vector<ScanPolarType>& vecScanPolar )
+//-----------------------------------------------
+bool ScannerSickS300::getScan(float *pfDistanceM, float *pfIntensityAU, const size_t uiMaxPoints, size_t &uiNumPoints, double &dAngleMinRAD, double &dAngleStepRAD, unsigned int &iTimestamp, unsigned int &iTimeNow, const bool debug)
 {
-	double dDist;
-	double dAngle, dAngleStep;
-	double dIntens;
-	bool bInStandby = true;
+	TRACE_SCOPE("ScannerSickS300::getScan");
+	iTimeNow=0;
+	uiNumPoints=0;
+
+	if(!readTelegram(debug)) return false;
+	iTimestamp = m_Heads[0].uiLastScanNumber;
 
-	vecScanPolar.resize(viScanRaw.size());
-	dAngleStep = fabs(param->second.dStopAngle - param->second.dStartAngle) / double(viScanRaw.size() - 1) ;
+	return getLastScan(pfDistanceM, pfIntensityAU, uiMaxPoints, uiNumPoints, dAngleMinRAD, dAngleStepRAD, debug);
+}
+
+//-----------------------------------------------
+bool ScannerSickS300::readScan(const bool debug)
+{
+	TRACE_SCOPE("ScannerSickS300::readScan");
+	return readTelegram(debug);
+}
 
+//-----------------------------------------------
+bool ScannerSickS300::getLastScan(float *pfDistanceM, float *pfIntensityAU, const size_t uiMaxPoints, size_t &uiNumPoints, double &dAngleMinRAD, double &dAngleStepRAD, const bool debug, const int iHead)
+{
+	TRACE_SCOPE("ScannerSickS300::getLastScan");
+	uiNumPoints=0;
 
-	for(size_t i=0; i<viScanRaw.size(); i++)
+	HeadType &head = m_Heads[iHead];
+	head.bNewScan = false;
+	PARAM_MAP::iterator param = head.Params.find(head.iField);
+	if(param!=head.Params.end())
 	{
-		dDist = double ((viScanRaw[i] & 0x1FFF) * param->second.dScale);
+		if(head.viScanRaw.size()>uiMaxPoints || head.viScanRaw.size()<2)
+		{
+			if(debug) std::cout<<"scan with "<<head.viScanRaw.size()<<" points does not fit into "<<uiMaxPoints<<std::endl;
+			return false;
+		}
 
-		// if not all values are 0x4004 , we are not in standby
-		if ( !(viScanRaw[i] == 0x4004) )
-			bInStandby = false;
+		const std::vector<double> &vdAngles = getAngleTable(param, head.viScanRaw.size());
+		dAngleMinRAD = vdAngles[0];
+		dAngleStepRAD = vdAngles[1]-vdAngles[0];
 
-		dAngle = param->second.dStartAngle + i*dAngleStep;
-		dIntens = double(viScanRaw[i] & 0x2000);
+		head.bInStandby = convertRanges(param->second.param.dScale, head.viScanRaw, pfDistanceM, pfIntensityAU);
+		uiNumPoints = head.viScanRaw.size();
+	}
 
-		vecScanPolar[i].dr = dDist;
-		vecScanPolar[i].da = dAngle;
-		vecScanPolar[i].di = dIntens;
+	return true;
+}
+
+//-----------------------------------------------
+bool ScannerSickS300::waitForScan(const double dTimeout, const ScanCallback &callback, const bool debug)
+{
+	const int iRet = m_SerialIO.waitForData(dTimeout);
+	if(iRet<0)
+		m_bPortError = true;
+	if(iRet<=0)
+		return false;
+
+	// only read what is available, so the framer sees the telegram as soon as its last byte arrived
+	if(readTelegram(debug, false))
+		callback();
+
+	return true;
+}
+
+//-------------------------------------------
+const std::vector<double>& ScannerSickS300::getAngleTable(const PARAM_MAP::iterator param, const size_t uiNumPoints)
+{
+	std::vector<double> &vdAngles = param->second.vdAngleRAD;
+	if(vdAngles.size()!=uiNumPoints)
+	{
+		const ParamType &p = param->second.param;
+		const double dAngleStep = fabs(p.dStopAngle - p.dStartAngle) / double(uiNumPoints - 1);
+
+		vdAngles.resize(uiNumPoints);
+		for(size_t i=0; i<uiNumPoints; i++)
+			vdAngles[i] = p.dStartAngle + i*dAngleStep;
+	}
+	return vdAngles;
+}
+
+//-------------------------------------------
+template<typename T>
+bool ScannerSickS300::convertRanges(const double dScale, const std::vector<int>& viScanRaw, T *pDistanceM, T *pIntensityAU)
+{
+	const T tScale = (T)dScale;
+	const int *piRaw = viScanRaw.empty() ? NULL : &viScanRaw[0];
+	const size_t uiNumPoints = viScanRaw.size();
+
+	// if not all values are 0x4004 , we are not in standby
+	// (accumulated without branching, so the loop can be vectorized)
+	int iNotStandby = 0;
+
+	for(size_t i=0; i<uiNumPoints; i++)
+	{
+		const int iRaw = piRaw[i];
+		pDistanceM[i] = (T)(iRaw & 0x1FFF) * tScale;
+		pIntensityAU[i] = (T)(iRaw & 0x2000);
+		iNotStandby |= iRaw ^ 0x4004;
 	}
 
-	m_bInStandby = bInStandby;
+	return (iNotStandby == 0);
+}
+
+//-------------------------------------------
+bool ScannerSickS300::convertScanToPolar(const PARAM_MAP::iterator param, const std::vector<int>& viScanRaw,
+							double *pdDistanceM, double *pdAngleRAD, double *pdIntensityAU)
+{
+	const std::vector<double> &vdAngles = getAngleTable(param, viScanRaw.size());
+	if(!vdAngles.empty())
+		memcpy(pdAngleRAD, &vdAngles[0], vdAngles.size()*sizeof(double));
+
+	return convertRanges(param->second.param.dScale, viScanRaw, pdDistanceM, pdIntensityAU);
 }
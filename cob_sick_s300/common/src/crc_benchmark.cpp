@@ -0,0 +1,102 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+ 
+
+/*
+ * Compares the CRC implementations of TelegramParser.
+ *
+ * usage: s300_crc_benchmark [recorded_stream.bin] [iterations]
+ *
+ * The recorded stream is a raw dump of the serial port (e.g. "cat /dev/ttyUSB0 > recorded_stream.bin"),
+ * it is cut into telegram sized blocks. Without a recording, random data is used.
+ */
+
+#include <cob_sick_s300/ScannerSickS300.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <fstream>
+#include <iterator>
+
+// payload of one telegram with 541 distance values
+static const size_t TELEGRAM_CRC_SIZE = 1100;
+
+static double getTime()
+{
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+template<typename Func>
+static double benchmark(Func crc, const std::vector<uint8_t> &data, const int iterations, unsigned int &checksum)
+{
+	checksum = 0;
+	const double start = getTime();
+	for(int it=0; it<iterations; it++)
+		for(size_t i=0; i+TELEGRAM_CRC_SIZE<=data.size(); i+=TELEGRAM_CRC_SIZE)
+			checksum ^= crc(&data[i], TELEGRAM_CRC_SIZE);
+	return getTime()-start;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<uint8_t> data;
+	int iterations = 1000;
+
+	if(argc>1)
+	{
+		std::ifstream file(argv[1], std::ios::binary);
+		if(!file)
+		{
+			std::cout << "could not open " << argv[1] << std::endl;
+			return 1;
+		}
+		data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	else
+	{
+		data.resize(100*TELEGRAM_CRC_SIZE);
+		for(size_t i=0; i<data.size(); i++)
+			data[i] = rand()&0xFF;
+	}
+	if(argc>2)
+		iterations = atoi(argv[2]);
+
+	const size_t num_telegrams = data.size()/TELEGRAM_CRC_SIZE;
+	if(num_telegrams==0)
+	{
+		std::cout << "recording is shorter than one telegram" << std::endl;
+		return 1;
+	}
+
+	unsigned int crc_bytewise, crc_slice8;
+	const double t_bytewise = benchmark(TelegramParser::createCRCBytewise, data, iterations, crc_bytewise);
+	const double t_slice8 = benchmark(TelegramParser::createCRCSliceBy8, data, iterations, crc_slice8);
+
+	const double num = double(num_telegrams)*iterations;
+	std::cout << "telegrams: " << num << std::endl;
+	std::cout << "bytewise:   " << 1e6*t_bytewise/num << " us/telegram" << std::endl;
+	std::cout << "slice-by-8: " << 1e6*t_slice8/num << " us/telegram" << std::endl;
+
+	if(crc_bytewise!=crc_slice8)
+	{
+		std::cout << "ERROR: results differ" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Micro-benchmarks of the S300 telegram parsing and scan conversion on synthesized telegrams.
+ *
+ * usage: s300_micro_benchmark [--filter=regex] [--format=console|json] [--out=file.json], see MicroBenchmark.h
+ *
+ * The telegrams have the layout of protocol 1.02 with distance data of field 1, a CRC and increasing
+ * scan numbers. The argument of each benchmark is the number of beams per telegram.
+ */
+
+#include <cob_sick_s300/ScannerSickS300.h>
+#include <cob_utilities/MicroBenchmark.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// appends a telegram of head iScanId with uiNumPoints beams, distances in cm with the 3 flag bits set at random
+static void appendTelegram(std::vector<uint8_t> &data, int iScanId, uint32_t uiScanNumber, size_t uiNumPoints)
+{
+	std::vector<uint8_t> telegram(24 + 2*uiNumPoints + 2, 0);
+	const size_t size = (telegram.size() - 4)/2;
+	telegram[6] = size >> 8;
+	telegram[7] = size & 0xFF;
+	telegram[8] = 0xFF;
+	telegram[9] = iScanId;
+	telegram[10] = 0x02; // protocol 1.02
+	telegram[11] = 0x01;
+	telegram[14] = uiScanNumber;
+	telegram[15] = uiScanNumber >> 8;
+	telegram[16] = uiScanNumber >> 16;
+	telegram[17] = uiScanNumber >> 24;
+	telegram[20] = 0xBB; // distance data
+	telegram[21] = 0xBB;
+	telegram[22] = 0x11; // field 1
+	telegram[23] = 0x11;
+	for(size_t i=0; i<uiNumPoints; i++)
+	{
+		const int dist = (100 + 400*i/uiNumPoints + rand()%8) | ((rand()%8) << 13);
+		telegram[24 + 2*i] = dist & 0xFF;
+		telegram[25 + 2*i] = dist >> 8;
+	}
+	const uint16_t crc = TelegramParser::createCRC(&telegram[4], telegram.size() - 4 - 2);
+	memcpy(&telegram[telegram.size() - 2], &crc, 2);
+	data.insert(data.end(), telegram.begin(), telegram.end());
+}
+
+static void setupScanner(ScannerSickS300 &scanner)
+{
+	ScannerSickS300::ParamType param;
+	param.range_field = 1;
+	param.dScale = 0.01;
+	param.dStartAngle = -135.0/180.0*M_PI;
+	param.dStopAngle = 135.0/180.0*M_PI;
+	scanner.setRangeField(1, param);
+}
+
+// TelegramParser::parseHeader including the CRC and readDistRaw of one telegram
+static void S300_ParseTelegram(MicroBenchmark::State &state)
+{
+	std::vector<uint8_t> data;
+	appendTelegram(data, 7, 1, state.range());
+
+	TelegramParser parser;
+	std::vector<int> raw;
+	raw.reserve(state.range());
+	while(state.keepRunning())
+	{
+		if(!parser.parseHeader(&data[0], data.size(), 7, false))
+		{
+			state.skip("telegram rejected by the parser");
+			return;
+		}
+		parser.readDistRaw(&data[0], raw, false);
+	}
+	state.setItemsProcessed(state.iterations()*state.range());
+}
+MICRO_BENCHMARK_ARG(S300_ParseTelegram, 541);
+
+// ScannerSickS300::parseData of one telegram, i.e. the framing of the serial stream and the parser
+static void S300_ParseData(MicroBenchmark::State &state)
+{
+	const size_t uiNumTelegrams = 256;
+	std::vector<uint8_t> data;
+	for(size_t i=0; i<uiNumTelegrams; i++)
+		appendTelegram(data, 7, i, state.range());
+	const size_t uiTelegramSize = data.size()/uiNumTelegrams;
+
+	ScannerSickS300 scanner;
+	setupScanner(scanner);
+	size_t uiNext = 0;
+	double dReadTime = 0;
+	while(state.keepRunning())
+	{
+		scanner.parseData(&data[uiNext*uiTelegramSize], uiTelegramSize, dReadTime, false);
+		uiNext = (uiNext + 1) % uiNumTelegrams;
+		dReadTime += 0.04;
+	}
+	if(!scanner.hasNewScan(0))
+		state.skip("no scan received");
+	// the scan time estimation relies on consecutive scan numbers
+	else if(scanner.getLastScanNumber() != (uiNext + uiNumTelegrams - 1) % uiNumTelegrams)
+		state.skip("scan number decoded wrongly");
+	state.setItemsProcessed(state.iterations()*state.range());
+}
+MICRO_BENCHMARK_ARG(S300_ParseData, 541);
+
+// ScannerSickS300::getLastScan, the conversion of the raw distances into a laser scan message
+static void S300_GetLastScan(MicroBenchmark::State &state)
+{
+	std::vector<uint8_t> data;
+	appendTelegram(data, 7, 1, state.range());
+
+	ScannerSickS300 scanner;
+	setupScanner(scanner);
+	if(!scanner.parseData(&data[0], data.size(), 0.0, false))
+	{
+		state.skip("no scan received");
+		return;
+	}
+
+	float distance[ScannerSickS300::SCANNER_S300_MAX_POINTS];
+	float intensity[ScannerSickS300::SCANNER_S300_MAX_POINTS];
+	size_t num_points;
+	double angle_min, angle_step;
+	while(state.keepRunning())
+		scanner.getLastScan(distance, intensity, ScannerSickS300::SCANNER_S300_MAX_POINTS, num_points, angle_min, angle_step, false);
+	state.setItemsProcessed(state.iterations()*state.range());
+}
+MICRO_BENCHMARK_ARG(S300_GetLastScan, 541);
+
+MICRO_BENCHMARK_MAIN()
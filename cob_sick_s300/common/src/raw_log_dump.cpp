@@ -0,0 +1,141 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+/*
+ * Replays a raw log of the cob_sick_s300 driver (parameter raw_log_file) through ScannerSickS300.
+ *
+ * usage: s300_raw_log_dump raw_log_file [-r] [slave_scan_id ...]
+ *
+ * Prints one line per scan with its wall time, head, scan number, field, number of points,
+ * standby flag and closest range, -r also prints all ranges in m. Without slave scan ids every
+ * telegram is taken as scan of one head, otherwise the telegrams are dispatched to the master (7)
+ * and the given slaves like with the "heads" parameter of the driver.
+ * The chunks are framed exactly as they were read from the port, so the output shows what the
+ * driver has seen, including corrupted or missing telegrams.
+ */
+
+#include <cob_sick_s300/ScannerSickS300.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <boost/bind.hpp>
+
+struct Replay
+{
+	ScannerSickS300 scanner;
+	bool print_ranges;
+	int64_t realtime_offset_ns;
+	unsigned long chunks;
+	unsigned long bytes;
+	unsigned long scans;
+	float distance[ScannerSickS300::SCANNER_S300_MAX_POINTS];
+	float intensity[ScannerSickS300::SCANNER_S300_MAX_POINTS];
+
+	void chunk(int64_t time_ns, const uint8_t* data, size_t size)
+	{
+		chunks++;
+		bytes += size;
+		if(!scanner.parseData(data, size, time_ns * 1e-9, false))
+			return;
+
+		// wall time of the chunk which completed the scan
+		const int64_t wall_ns = time_ns + realtime_offset_ns;
+		const time_t sec = wall_ns / 1000000000;
+		struct tm tm;
+		localtime_r(&sec, &tm);
+		char stamp[32];
+		strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+
+		for(size_t h = 0; h < scanner.getNumHeads(); h++)
+		{
+			if(!scanner.hasNewScan(h))
+				continue;
+			size_t num_points = 0;
+			double angle_min, angle_step;
+			scanner.getLastScan(distance, intensity, ScannerSickS300::SCANNER_S300_MAX_POINTS, num_points, angle_min, angle_step, false, h);
+			scans++;
+
+			float closest = 0;
+			for(size_t i = 0; i < num_points; i++)
+			{
+				if(distance[i] > 0 && (closest == 0 || distance[i] < closest))
+					closest = distance[i];
+			}
+			printf("%s.%03d head %d scan %u: %zu points, %s, closest %.2f m\n", stamp, (int)(wall_ns / 1000000 % 1000),
+				scanner.getScanId(h), scanner.getLastScanNumber(h), num_points,
+				scanner.isInStandby(h) ? "standby" : "measuring", closest);
+			if(print_ranges)
+			{
+				for(size_t i = 0; i < num_points; i++)
+					printf("%.2f%c", distance[i], (i+1 < num_points) ? ' ' : '\n');
+			}
+		}
+	}
+};
+
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		fprintf(stderr, "usage: %s raw_log_file [-r] [slave_scan_id ...]\n", argv[0]);
+		return 1;
+	}
+
+	static Replay replay;
+	replay.print_ranges = false;
+	replay.chunks = replay.bytes = replay.scans = 0;
+
+	for(int i = 2; i < argc; i++)
+	{
+		if(strcmp(argv[i], "-r") == 0)
+			replay.print_ranges = true;
+		else
+			replay.scanner.addHead(atoi(argv[i]));
+	}
+
+	RawLog::Info info;
+	if(!RawLog::replay(argv[1], &info, RawLog::RecordCallback()))
+		return 1;
+	if(info.uiSource != RawLog::SOURCE_SICK_S300)
+	{
+		fprintf(stderr, "%s is no log of a S300 (source %u)\n", argv[1], info.uiSource);
+		return 1;
+	}
+	printf("%s: %s, %llu chunks, %llu dropped\n", argv[1], info.sDescription.c_str(),
+		(unsigned long long)info.ullRecords, (unsigned long long)info.ullDropped);
+	replay.realtime_offset_ns = info.llRealtimeOffsetNs;
+
+	// default field of the driver, ranges of other fields are reported with the same scale
+	ScannerSickS300::ParamType param;
+	param.range_field = 1;
+	param.dScale = 0.01;
+	param.dStartAngle = -135.0/180.0*M_PI;
+	param.dStopAngle = 135.0/180.0*M_PI;
+	for(size_t h = 0; h < replay.scanner.getNumHeads(); h++)
+		for(int field = 1; field <= 5; field++)
+			replay.scanner.setRangeField(field, param, h);
+
+	if(!RawLog::replay(argv[1], NULL, boost::bind(&Replay::chunk, &replay, _1, _2, _3)))
+		return 1;
+
+	printf("%lu chunks, %lu bytes, %lu scans, %lu telegrams of other scanners\n",
+		replay.chunks, replay.bytes, replay.scans, replay.scanner.getForeignTelegrams());
+	return 0;
+}
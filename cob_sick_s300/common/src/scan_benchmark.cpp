@@ -0,0 +1,179 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+/*
+ * Replays a recorded serial stream of a S300 through ScannerSickS300 at maximum speed.
+ *
+ * usage: s300_scan_benchmark recorded_stream.bin [scan_id]
+ *
+ * The recorded stream is a raw dump of the serial port (e.g. "cat /dev/ttyUSB0 > recorded_stream.bin").
+ * A child process writes the recording into a pseudo terminal, so the scanner is opened and read
+ * exactly like a real serial port. Reports scans/s, the latency of waitForScan() including the
+ * conversion of the scan and the number of heap allocations per scan.
+ *
+ * If the parser falls behind, readTelegram keeps only the newest of several buffered telegrams,
+ * like on a real port. The skipped telegrams are reported separately.
+ */
+
+#include <cob_sick_s300/ScannerSickS300.h>
+#include <cob_utilities/MicroBenchmark.h>
+
+#include <boost/bind.hpp>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <new>
+
+MICRO_BENCHMARK_ALLOCATION_COUNTER()
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+	return sorted[std::min(sorted.size()-1, size_t(p*sorted.size()))];
+}
+
+struct ScanReceiver
+{
+	ScannerSickS300 *scanner;
+	float distance[ScannerSickS300::SCANNER_S300_MAX_POINTS];
+	float intensity[ScannerSickS300::SCANNER_S300_MAX_POINTS];
+	unsigned int scans;
+
+	void onScan()
+	{
+		size_t num_points;
+		double angle_min, angle_step;
+		if(scanner->getLastScan(distance, intensity, ScannerSickS300::SCANNER_S300_MAX_POINTS, num_points, angle_min, angle_step, false))
+			scans++;
+	}
+};
+
+static void replay(int master, const std::vector<char> &data)
+{
+	size_t written = 0;
+	while(written < data.size())
+	{
+		ssize_t n = write(master, &data[written], data.size()-written);
+		if(n <= 0)
+			_exit(1);
+		written += n;
+	}
+	// keep the pseudo terminal open until the parent has read everything
+	pause();
+	_exit(0);
+}
+
+int main(int argc, char** argv)
+{
+	if(argc<2)
+	{
+		std::cout << "usage: s300_scan_benchmark recorded_stream.bin [scan_id]" << std::endl;
+		return 1;
+	}
+
+	std::vector<char> data;
+	{
+		std::ifstream file(argv[1], std::ios::binary);
+		if(!file)
+		{
+			std::cout << "could not open " << argv[1] << std::endl;
+			return 1;
+		}
+		data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	const int scan_id = (argc>2) ? atoi(argv[2]) : 7;
+
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if(master<0 || grantpt(master)!=0 || unlockpt(master)!=0)
+	{
+		std::cout << "could not create pseudo terminal" << std::endl;
+		return 1;
+	}
+
+	ScannerSickS300 scanner;
+	ScannerSickS300::ParamType param;
+	param.range_field = 1;
+	param.dScale = 0.01;
+	param.dStartAngle = -135.0/180.0*M_PI;
+	param.dStopAngle = 135.0/180.0*M_PI;
+	scanner.setRangeField(1, param);
+
+	// the port has to be raw before the first byte arrives
+	if(!scanner.open(ptsname(master), 500000, scan_id))
+	{
+		std::cout << "could not open " << ptsname(master) << std::endl;
+		return 1;
+	}
+
+	pid_t child = fork();
+	if(child==0)
+		replay(master, data);
+	close(master);
+
+	ScanReceiver receiver;
+	receiver.scanner = &scanner;
+	receiver.scans = 0;
+	const ScannerSickS300::ScanCallback callback = boost::bind(&ScanReceiver::onScan, &receiver);
+
+	std::vector<double> latency;
+	latency.reserve(data.size()/1000 + 1);
+	unsigned int first_scan_number = 0, last_scan_number = 0;
+
+	const unsigned long allocations_start = MicroBenchmark::allocations();
+	const double start = MicroBenchmark::getRealTime();
+	double last = start;
+	while(true)
+	{
+		const unsigned int scans = receiver.scans;
+		const double t = MicroBenchmark::getRealTime();
+		if(!scanner.waitForScan(0.5, callback, false))
+			break;
+		if(receiver.scans==scans)
+			continue;
+		last = MicroBenchmark::getRealTime();
+		latency.push_back(last - t);
+		if(latency.size()==1)
+			first_scan_number = scanner.getLastScanNumber();
+		last_scan_number = scanner.getLastScanNumber();
+	}
+	const unsigned long allocations_total = MicroBenchmark::allocations() - allocations_start;
+
+	kill(child, SIGTERM);
+	waitpid(child, NULL, 0);
+
+	if(latency.empty())
+	{
+		std::cout << "no scans found in recording" << std::endl;
+		return 1;
+	}
+
+	std::sort(latency.begin(), latency.end());
+	std::cout << "scans:    " << latency.size() << " (" << (last_scan_number - first_scan_number + 1 - latency.size())
+			<< " skipped by the parser)" << std::endl;
+	std::cout << "scans/s:  " << latency.size()/(last - start) << std::endl;
+	std::cout << "latency:  p50 " << 1e6*percentile(latency, 0.5) << " us, p99 " << 1e6*percentile(latency, 0.99)
+			<< " us, max " << 1e6*latency.back() << " us" << std::endl;
+	std::cout << "allocations/scan: " << double(allocations_total)/latency.size() << std::endl;
+	return 0;
+}
@@ -0,0 +1,325 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+ 
+
+#ifndef COB_SCAN_FILTER_NODE_H
+#define COB_SCAN_FILTER_NODE_H
+
+//##################
+//#### includes ####
+
+// standard includes
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <stdexcept>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <cctype>
+
+// ROS includes
+#include <ros/ros.h>
+#include <XmlRpc.h>
+#include <boost/bind.hpp>
+#include <dynamic_reconfigure/server.h>
+#include <cob_sick_s300/ScanFilterConfig.h>
+
+// ROS message includes
+#include <sensor_msgs/LaserScan.h>
+
+
+//####################
+//#### node class ####
+/**
+ * Clears the ranges outside of the configured scan intervals, used by the cob_scan_filter node and the cob_sick_s300/ScanFilterNodelet.
+ */
+class ScanFilterNode
+{
+public:
+	// sorted, non-overlapping intervals, see mergeIntervals()
+	std::vector<std::vector<double> > scan_intervals;
+	// intervals of the parameter "scan_intervals", used while the reconfigurable "intervals" are empty
+	std::vector<std::vector<double> > param_intervals;
+
+	// runs of range indices to clear and the scan geometry they were computed for
+	std::vector<std::pair<int, int> > mask_runs;
+	float mask_angle_min, mask_angle_max, mask_angle_increment;
+	size_t mask_num_scans;
+
+	ros::NodeHandle nh;
+	// topics to publish
+	ros::Subscriber topicSub_laser_scan_raw;
+	ros::Publisher topicPub_laser_scan;
+
+	// runtime changes of the intervals, in the namespace "scan_filter" to keep "scan_intervals" a list
+	dynamic_reconfigure::Server<cob_sick_s300::ScanFilterConfig> reconfigure_server;
+
+	ScanFilterNode(const ros::NodeHandle &node_handle) : mask_angle_min(0.0f), mask_angle_max(0.0f), mask_angle_increment(0.0f), mask_num_scans(0),
+		nh(node_handle), reconfigure_server(ros::NodeHandle(node_handle, "scan_filter")) {
+		// loading config
+		param_intervals = loadScanRanges();
+		scan_intervals = param_intervals;
+		reconfigure_server.setCallback(boost::bind(&ScanFilterNode::reconfigureCallback, this, _1, _2));
+
+		// implementation of topics to publish
+		topicPub_laser_scan = nh.advertise<sensor_msgs::LaserScan>("scan_out", 1);
+		topicSub_laser_scan_raw = nh.subscribe("scan_in", 1, &ScanFilterNode::scanCallback, this);
+	}
+
+	/**
+	 * Replaces the intervals, the runs are rebuilt right away for the geometry of the last scan.
+	 * Called from the callback queue of the node handle, like scanCallback.
+	 */
+	void reconfigureCallback(cob_sick_s300::ScanFilterConfig &config, uint32_t level) {
+		std::vector<std::vector<double> > intervals;
+		if(config.intervals.empty())
+			intervals = param_intervals;
+		else if(!parseIntervals(config.intervals, &intervals)) {
+			ROS_ERROR("The intervals must be specified as a list of lists [[x1, y1], [x2, y2], ..., [xn, yn]], keeping the previous ones");
+			return;
+		}
+		else
+			intervals = mergeIntervals(intervals);
+
+		if(intervals == scan_intervals)
+			return;
+		scan_intervals = intervals;
+		ROS_INFO("Scan filter uses %u intervals", (unsigned int)scan_intervals.size());
+		if(mask_num_scans > 0)
+			buildMask(mask_angle_min, mask_angle_max, mask_angle_increment, mask_num_scans);
+	}
+
+	void scanCallback(const sensor_msgs::LaserScan::ConstPtr& msg) {
+		//if no filter intervals specified
+		if(scan_intervals.size()==0 || msg->ranges.empty()) {
+			topicPub_laser_scan.publish(msg);
+			return;
+		}
+
+		// the runs to clear only depend on the scan geometry, so they are computed once per geometry
+		if( msg->angle_min != mask_angle_min || msg->angle_max != mask_angle_max ||
+			msg->angle_increment != mask_angle_increment || msg->ranges.size() != mask_num_scans ) {
+			buildMask(msg->angle_min, msg->angle_max, msg->angle_increment, msg->ranges.size());
+		}
+
+		// use hole received message, later only clear some ranges
+		sensor_msgs::LaserScan::Ptr laser_scan(new sensor_msgs::LaserScan(*msg));
+
+		float * ranges = &laser_scan->ranges[0];
+		for ( unsigned int i=0; i<mask_runs.size(); i++) {
+			std::fill(ranges + mask_runs[i].first, ranges + mask_runs[i].second, 0.0f); //laser_scan.range_min;
+		}
+
+		// publish message, passed on without another copy to subscribers in the same process
+		topicPub_laser_scan.publish(laser_scan);
+	}
+
+	/**
+	 * Computes the index runs [first, second) outside of the scan intervals which are cleared for each scan.
+	 */
+	void buildMask(float angle_min, float angle_max, float angle_increment, size_t num_ranges) {
+		int start_scan, stop_scan, num_scans;
+		num_scans = num_ranges;
+
+		mask_runs.clear();
+		mask_angle_min = angle_min;
+		mask_angle_max = angle_max;
+		mask_angle_increment = angle_increment;
+		mask_num_scans = num_ranges;
+
+		stop_scan = 0;
+		for ( unsigned int i=0; i<scan_intervals.size(); i++) {
+			std::vector<double> * it = & scan_intervals[i];
+
+			if( (*it)[1] <= angle_min ) {
+				ROS_WARN("Found an interval that lies below min scan range, skip!");
+				continue;
+			}
+			if( (*it)[0] >= angle_max ) {
+				ROS_WARN("Found an interval that lies beyond max scan range, skip!");
+				continue;
+			}
+
+			if( (*it)[0] <= angle_min ) start_scan = 0;
+			else {
+				start_scan = (int)( ((*it)[0] - angle_min) / angle_increment);
+			}
+			addMaskRun(stop_scan, start_scan, num_scans);
+
+			if( (*it)[1] >= angle_max ) stop_scan = num_scans-1;
+			else {
+				stop_scan = (int)( ((*it)[1] - angle_min) / angle_increment);
+			}
+
+		}
+
+		addMaskRun(stop_scan, num_scans, num_scans);
+	}
+
+	void addMaskRun(int first, int last, int num_scans) {
+		first = std::max(first, 0);
+		last = std::min(last, num_scans);
+		if(first < last)
+			mask_runs.push_back(std::make_pair(first, last));
+	}
+
+	std::vector<std::vector<double> > loadScanRanges();
+
+	/**
+	 * Checks an interval [x, y] in rad and swaps its bounds if x > y.
+	 * @return false if the interval lies outside of [-PI, PI]
+	 */
+	static bool checkInterval(std::vector<double> &interval) {
+		//basic checking validity
+		if(interval.at(0)< -M_PI || interval.at(1)< -M_PI) {
+			ROS_WARN("Found a scan interval < -PI, skip!");
+			return false;
+		}
+		//basic checking validity
+		if(interval.at(0)>M_PI || interval.at(1)>M_PI) {
+			ROS_WARN("Found a scan interval > PI, skip!");
+			return false;
+		}
+
+		if(interval.at(0) >= interval.at(1)) {
+			ROS_WARN("Found a scan interval with i1 > i2, switched order!");
+			std::swap(interval[0], interval[1]);
+		}
+		return true;
+	}
+
+	/**
+	 * Sorts the intervals and merges the overlapping and adjacent ones, so each angle is in at most one interval.
+	 */
+	static std::vector<std::vector<double> > mergeIntervals(std::vector<std::vector<double> > intervals) {
+		std::vector<std::vector<double> > merged;
+		sort(intervals.begin(), intervals.end(), compareIntervals);
+		for(unsigned int i = 0; i<intervals.size(); i++) {
+			if(!merged.empty() && intervals[i][0] <= merged.back()[1]) {
+				if(intervals[i][0] < merged.back()[1])
+					ROS_WARN("Merged overlapping scan intervals [%f, %f] and [%f, %f]",
+						merged.back()[0], merged.back()[1], intervals[i][0], intervals[i][1]);
+				merged.back()[1] = std::max(merged.back()[1], intervals[i][1]);
+			}
+			else
+				merged.push_back(intervals[i]);
+		}
+		return merged;
+	}
+
+	/**
+	 * Parses the reconfigurable intervals "[[x1, y1], [x2, y2], ..., [xn, yn]]".
+	 * The invalid intervals are skipped like in loadScanRanges().
+	 * @return false if the string is no list of pairs of numbers
+	 */
+	static bool parseIntervals(const std::string &str, std::vector<std::vector<double> > *intervals) {
+		std::vector<double> values;
+		const char *pos = str.c_str();
+		int depth = 0, pair_size = 0;
+		while(*pos) {
+			if(*pos == '[') {
+				if(++depth > 2) return false;
+				pair_size = 0;
+				pos++;
+			}
+			else if(*pos == ']') {
+				if(depth == 2 && pair_size != 2) return false;
+				if(--depth < 0) return false;
+				pos++;
+			}
+			else if(*pos == ',' || std::isspace((unsigned char)*pos))
+				pos++;
+			else {
+				char *end;
+				double value = strtod(pos, &end);
+				if(end == pos || depth != 2 || ++pair_size > 2) return false;
+				values.push_back(value);
+				pos = end;
+			}
+		}
+		if(depth != 0) return false;
+
+		intervals->clear();
+		for(unsigned int i = 0; i+1<values.size(); i+=2) {
+			std::vector<double> interval(values.begin()+i, values.begin()+i+2);
+			if(checkInterval(interval))
+				intervals->push_back(interval);
+		}
+		return true;
+	}
+
+	static bool compareIntervals(const std::vector<double> &a, const std::vector<double> &b) {
+		return a.at(0) < b.at(0);
+	}
+};
+
+inline std::vector<std::vector<double> > ScanFilterNode::loadScanRanges() {
+	std::string scan_intervals_param = "scan_intervals";
+	std::vector<std::vector<double> > vd_interval_set;
+	std::vector<double> vd_interval;
+
+	//grab the range-list from the parameter server if possible
+	XmlRpc::XmlRpcValue intervals_list;
+	if(nh.hasParam(scan_intervals_param)){
+		nh.getParam(scan_intervals_param, intervals_list);
+		//make sure we have a list of lists
+		if(!(intervals_list.getType() == XmlRpc::XmlRpcValue::TypeArray)){
+			ROS_FATAL("The scan intervals must be specified as a list of lists [[x1, y1], [x2, y2], ..., [xn, yn]]");
+			throw std::runtime_error("The scan intervals must be specified as a list of lists [[x1, y1], [x2, y2], ..., [xn, yn]]");
+		}
+
+		for(int i = 0; i < intervals_list.size(); ++i){
+			vd_interval.clear();
+
+			//make sure we have a list of lists of size 2
+			XmlRpc::XmlRpcValue interval = intervals_list[i];
+			if(!(interval.getType() == XmlRpc::XmlRpcValue::TypeArray && interval.size() == 2)){
+				ROS_FATAL("The scan intervals must be specified as a list of lists [[x1, y1], [x2, y2], ..., [xn, yn]]");
+				throw std::runtime_error("The scan intervals must be specified as a list of lists [[x1, y1], [x2, y2], ..., [xn, yn]]");
+			}
+
+			//make sure that the value we're looking at is either a double or an int
+			if(!(interval[0].getType() == XmlRpc::XmlRpcValue::TypeInt || interval[0].getType() == XmlRpc::XmlRpcValue::TypeDouble)){
+				ROS_FATAL("Values in the scan intervals specification must be numbers");
+				throw std::runtime_error("Values in the scan intervals specification must be numbers");
+			}
+			vd_interval.push_back( interval[0].getType() == XmlRpc::XmlRpcValue::TypeInt ? (int)(interval[0]) : (double)(interval[0]) );
+
+			//make sure that the value we're looking at is either a double or an int
+			if(!(interval[1].getType() == XmlRpc::XmlRpcValue::TypeInt || interval[1].getType() == XmlRpc::XmlRpcValue::TypeDouble)){
+				ROS_FATAL("Values in the scan intervals specification must be numbers");
+				throw std::runtime_error("Values in the scan intervals specification must be numbers");
+			}
+			vd_interval.push_back( interval[1].getType() == XmlRpc::XmlRpcValue::TypeInt ? (int)(interval[1]) : (double)(interval[1]) );
+
+			if(checkInterval(vd_interval))
+				vd_interval_set.push_back(vd_interval);
+		}
+	} else ROS_WARN("Scan filter has not found any scan interval parameters.");
+
+	//now we want to sort the intervals and merge the overlapping ones
+	vd_interval_set = mergeIntervals(vd_interval_set);
+
+	/* DEBUG out:
+	for(unsigned int i = 0; i<vd_interval_set.size(); i++) {
+		std::cout << "Interval " << i << " is " << vd_interval_set.at(i).at(0) << " | " << vd_interval_set.at(i).at(1) << std::endl;
+	} */
+
+	return vd_interval_set;
+}
+
+#endif
@@ -0,0 +1,650 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+ 
+
+#ifndef COB_SICK_S300_NODE_H
+#define COB_SICK_S300_NODE_H
+
+//##################
+//#### includes ####
+
+// standard includes
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+// ROS includes
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <XmlRpcException.h>
+
+// ROS message includes
+#include <std_msgs/Bool.h>
+#include <sensor_msgs/LaserScan.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+// ROS service includes
+//--
+
+// external includes
+#include <cob_sick_s300/ScannerSickS300.h>
+#include <cob_utilities/LatencyHistogram.h>
+#include <cob_utilities/RawLog.h>
+#include <cob_utilities/RealTime.h>
+#include <cob_utilities/Trace.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#define ROS_LOG_FOUND
+
+//####################
+//#### node class ####
+/**
+ * Driver of one S300, used by the cob_sick_s300 node and the cob_sick_s300/SickS300Nodelet.
+ * Scans are published as shared pointers, so subscribers in the same process receive them without a copy.
+ */
+class SickS300Node
+{
+	//
+	public:
+
+		ros::NodeHandle nh;
+		// topics to publish
+		ros::Publisher topicPub_LaserScan;
+		ros::Publisher topicPub_InStandby;
+		ros::Publisher topicPub_Diagnostic_;
+
+		// topics to subscribe, callback is called for new messages arriving
+		//--
+
+		// service servers
+		//--
+
+		// service clients
+		//--
+
+		// global variables
+		std::string port;
+		std::string node_name;
+		int baud, scan_id, publish_frequency;
+		double diagnostics_frequency;
+		bool inverted;
+		bool async_read;
+		double scan_duration, scan_cycle_time;
+		std::string frame_id;
+		bool debug_;
+		ScannerSickS300 scanner_;
+		ros::Time loop_rate_;
+		ros::Time last_diagnostics_;
+		std_msgs::Bool inStandby_;
+		// one scanner head on the port, heads_[0] is configured by the parameters of the node itself,
+		// further heads (e.g. slave scanners on the same line) by the "heads" parameter
+		struct Head
+		{
+			int index; // index of the head in scanner_
+			std::string frame_id;
+			bool inverted;
+			ros::Publisher scan_pub;
+			ros::Publisher standby_pub;
+			// kept between scans while no subscriber holds it, the scanner writes directly into ranges and intensities
+			sensor_msgs::LaserScan::Ptr msg;
+		};
+		std::vector<Head> heads_;
+		// set by shutdown() to end run()
+		boost::atomic<bool> shutdown_;
+
+		/**
+		 * The diagnostics are published by a timer on their own callback queue and spinner thread,
+		 * the read loop only updates the status and counters below.
+		 */
+		enum Status { STATUS_OK, STATUS_NOT_AVAILABLE, STATUS_DISCONNECTED };
+		boost::atomic<int> status_;
+		// bit i is set while head i is in standby
+		boost::atomic<uint32_t> standby_heads_;
+		// scans of the first head, for the scan rate
+		boost::atomic<unsigned long> scans_;
+		ros::CallbackQueue diagnostics_queue_;
+		boost::scoped_ptr<ros::AsyncSpinner> diagnostics_spinner_;
+		ros::Timer diagnostics_timer_;
+		// only used by the diagnostics thread
+		diagnostic_msgs::DiagnosticArray diagnostics_;
+		unsigned long last_scans_;
+		// time between two scans and age of a scan when it is published, exported with the diagnostics
+		LatencyHistogram scan_period_hist_;
+		LatencyHistogram scan_latency_hist_;
+		PageFaultCounter read_page_faults_;
+		// real-time setup of the read loop, lock_memory applies to the whole process (e.g. the nodelet manager)
+		bool lock_memory_;
+		int prefault_heap_mb_;
+		int read_thread_priority_;
+		int read_thread_cpu_;
+		double last_scan_time_;
+		// start of the wait for the first scan after opening, 0 once it arrived
+		int64_t first_scan_wait_start_;
+		// recovery: resync after resync_timeout without telegram, reconnect after reconnect_timeout without data
+		double resync_timeout_, reconnect_timeout_;
+		double reconnect_backoff_min_, reconnect_backoff_max_;
+		// wait before the next reconnect attempt, doubled while the scanner stays silent
+		double reconnect_backoff_;
+		boost::atomic<unsigned long> resyncs_, reconnects_;
+		// raw data of the serial port for post-mortem analysis, see s300_raw_log_dump
+		RawLog raw_log_;
+
+		// Constructor
+		SickS300Node(const ros::NodeHandle &node_handle) : nh(node_handle), shutdown_(false), status_(STATUS_OK), standby_heads_(0), scans_(0),
+			last_scans_(0), last_scan_time_(0.0), first_scan_wait_start_(0), resyncs_(0), reconnects_(0)
+		{
+			// create a handle for this node, initialize node
+			//nh = ros::NodeHandle("~");
+
+			if(!nh.hasParam("port")) ROS_WARN("Used default parameter for port");
+			nh.param("port", port, std::string("/dev/ttyUSB0"));
+
+			if(!nh.hasParam("baud")) ROS_WARN("Used default parameter for baud");
+			nh.param("baud", baud, 500000);
+
+			if(!nh.hasParam("scan_id")) ROS_WARN("Used default parameter for scan_id");
+			nh.param("scan_id", scan_id, 7);
+
+			if(!nh.hasParam("inverted")) ROS_WARN("Used default parameter for inverted");
+			nh.param("inverted", inverted, false);
+
+			if(!nh.hasParam("frame_id")) ROS_WARN("Used default parameter for frame_id");
+			nh.param("frame_id", frame_id, std::string("/base_laser_link"));
+
+			if(!nh.hasParam("scan_duration")) ROS_WARN("Used default parameter for scan_duration");
+			nh.param("scan_duration", scan_duration, 0.025); //no info about that in SICK-docu, but 0.025 is believable and looks good in rviz
+
+			if(!nh.hasParam("scan_cycle_time")) ROS_WARN("Used default parameter for scan_cycle_time");
+			nh.param("scan_cycle_time", scan_cycle_time, 0.040); //SICK-docu says S300 scans every 40ms
+
+			if (!nh.hasParam("publish_frequency")) ROS_WARN("Used default parameter for publish_frequency");
+			nh.param("publish_frequency", publish_frequency, 12); //Hz
+
+			if (!nh.hasParam("diagnostics_frequency")) ROS_WARN("Used default parameter for diagnostics_frequency");
+			nh.param("diagnostics_frequency", diagnostics_frequency, 1.0); //Hz
+
+			if (!nh.hasParam("async_read")) ROS_WARN("Used default parameter for async_read");
+			nh.param("async_read", async_read, false); // wait for data with epoll instead of blocking reads
+
+			if(nh.hasParam("debug")) nh.param("debug", debug_, false);
+
+			nh.param("resync_timeout", resync_timeout_, 3 * scan_cycle_time);
+			nh.param("reconnect_timeout", reconnect_timeout_, 1.0);
+			nh.param("reconnect_backoff_min", reconnect_backoff_min_, 0.1);
+			nh.param("reconnect_backoff_max", reconnect_backoff_max_, 5.0);
+
+			nh.param("lock_memory", lock_memory_, false);
+			nh.param("prefault_heap_mb", prefault_heap_mb_, 16);
+			nh.param("read_thread_priority", read_thread_priority_, 0);
+			nh.param("read_thread_cpu", read_thread_cpu_, -1);
+			reconnect_backoff_ = reconnect_backoff_min_;
+
+			XmlRpc::XmlRpcValue field_params;
+			if(!nh.getParam("fields", field_params))
+				field_params = XmlRpc::XmlRpcValue();
+			setFields(field_params, 0);
+
+			Head head;
+			head.index = 0;
+			head.frame_id = frame_id;
+			head.inverted = inverted;
+			heads_.push_back(head);
+
+			// further heads on the same port, name: {scan_id, frame_id, inverted, fields}
+			XmlRpc::XmlRpcValue head_params;
+			if(nh.getParam("heads", head_params) && head_params.getType() == XmlRpc::XmlRpcValue::TypeStruct)
+			{
+				try
+				{
+					for(XmlRpc::XmlRpcValue::iterator it=head_params.begin(); it!=head_params.end(); it++)
+					{
+						XmlRpc::XmlRpcValue &p = it->second;
+						if(!p.hasMember("scan_id"))
+						{
+							ROS_ERROR("Missing parameter scan_id of head %s", it->first.c_str());
+							continue;
+						}
+						head.index = scanner_.addHead(static_cast<int>(p["scan_id"]));
+						head.frame_id = p.hasMember("frame_id") ? static_cast<std::string>(p["frame_id"]) : it->first + "_link";
+						head.inverted = p.hasMember("inverted") ? static_cast<bool>(p["inverted"]) : false;
+						head.scan_pub = nh.advertise<sensor_msgs::LaserScan>(it->first + "/scan", 1);
+						head.standby_pub = nh.advertise<std_msgs::Bool>(it->first + "/scan_standby", 1);
+						XmlRpc::XmlRpcValue head_fields;
+						if(p.hasMember("fields"))
+							head_fields = p["fields"];
+						setFields(head_fields, head.index);
+						heads_.push_back(head);
+						ROS_INFO("Head %s with scan_id %d publishes on %s", it->first.c_str(), static_cast<int>(p["scan_id"]),
+						         head.scan_pub.getTopic().c_str());
+					}
+				} catch(XmlRpc::XmlRpcException e)
+				{
+					ROS_ERROR_STREAM("Not all params of the heads could be read: " << e.getMessage() << "! Error code: " << e.getCode());
+					ROS_ERROR("Node is going to shut down.");
+					exit(-1);
+				}
+			}
+
+			scanner_.setScanCycleTime(scan_cycle_time);
+
+			// the last minutes of raw telegrams, 16 MB hold about 5 minutes at 500 kBaud
+			std::string raw_log_file;
+			nh.param("raw_log_file", raw_log_file, std::string(""));
+			if(!raw_log_file.empty())
+			{
+				int raw_log_size_mb;
+				nh.param("raw_log_size_mb", raw_log_size_mb, 16);
+				std::ostringstream description;
+				description << "port=" << port << " baud=" << baud << " scan_id=" << scan_id;
+				for(size_t i = 1; i < heads_.size(); i++)
+					description << " head=" << scanner_.getScanId(heads_[i].index);
+				if(raw_log_.open(raw_log_file, (size_t)raw_log_size_mb << 20, RawLog::SOURCE_SICK_S300, description.str()))
+					scanner_.setRawLog(&raw_log_);
+				else
+					ROS_ERROR("Could not open raw log %s, raw data is not logged", raw_log_file.c_str());
+			}
+
+			node_name = ros::this_node::getName();
+
+			// implementation of topics to publish
+			topicPub_LaserScan = nh.advertise<sensor_msgs::LaserScan>("scan", 1);
+			topicPub_InStandby = nh.advertise<std_msgs::Bool>("scan_standby", 1);
+			topicPub_Diagnostic_ = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+			heads_[0].scan_pub = topicPub_LaserScan;
+			heads_[0].standby_pub = topicPub_InStandby;
+
+			loop_rate_ = ros::Time::now(); // Hz
+			last_diagnostics_ = ros::Time(0);
+
+			for(size_t i = 0; i < heads_.size(); i++)
+				prepareScanMessage(heads_[i]);
+
+			diagnostics_.status.resize(1);
+			diagnostics_.status[0].level = 0;
+			diagnostics_.status[0].name = nh.getNamespace();
+			diagnostics_.status[0].message = "sick scanner running";
+
+			// diagnostics_frequency <= 0 publishes once per scan cycle
+			ros::TimerOptions diagnostics_options(ros::Duration(diagnostics_frequency > 0.0 ? 1./diagnostics_frequency : scan_cycle_time),
+				boost::bind(&SickS300Node::publishDiagnostics, this, _1), &diagnostics_queue_);
+			diagnostics_timer_ = nh.createTimer(diagnostics_options);
+			diagnostics_spinner_.reset(new ros::AsyncSpinner(1, &diagnostics_queue_));
+			diagnostics_spinner_->start();
+		}
+
+		// sets the measurement fields of a head, the default field if field_params is no struct
+		void setFields(XmlRpc::XmlRpcValue &field_params, int head) {
+			try
+			{
+				//get params for each measurement
+				if(field_params.getType() == XmlRpc::XmlRpcValue::TypeStruct)
+				{
+					for(XmlRpc::XmlRpcValue::iterator field=field_params.begin(); field!=field_params.
+					end(); field++)
+					{
+						int field_number = boost::lexical_cast<int>(field->first);
+						ROS_DEBUG("Found field %d in params", field_number);
+
+						if(!field->second.hasMember("scale"))
+						{
+							ROS_ERROR("Missing parameter scale");
+							continue;
+						}
+
+						if(!field->second.hasMember("start_angle"))
+						{
+							ROS_ERROR("Missing parameter start_angle");
+							continue;
+						}
+
+						if(!field->second.hasMember("stop_angle"))
+						{
+							ROS_ERROR("Missing parameter stop_angle");
+							continue;
+						}
+
+						ScannerSickS300::ParamType param;
+						param.dScale = field->second["scale"];
+						param.dStartAngle = field->second["start_angle"];
+						param.dStopAngle = field->second["stop_angle"];
+						scanner_.setRangeField(field_number, param, head);
+
+						ROS_DEBUG("params %f %f %f", param.dScale, param.dStartAngle, param.dStopAngle);
+					}
+				}
+				else
+				{
+					//ROS_WARN("No params for the Sick S300 fieldset were specified --> will using default, but it's deprecated now, please adjust parameters!!!");
+
+					//setting defaults to be backwards compatible
+					ScannerSickS300::ParamType param;
+					param.dScale = 0.01;
+					param.dStartAngle = -135.0/180.0*M_PI;
+					param.dStopAngle = 135.0/180.0*M_PI;
+					scanner_.setRangeField(1, param, head);
+				}
+			} catch(XmlRpc::XmlRpcException e)
+			{
+				ROS_ERROR_STREAM("Not all params for the Sick S300 fieldset could be read: " << e.getMessage() << "! Error code: " << e.getCode());
+				ROS_ERROR("Node is going to shut down.");
+				exit(-1);
+			}
+		}
+
+		bool open() {
+			return scanner_.open(port.c_str(), baud, scan_id);
+		}
+
+		bool ok() const {
+			return ros::ok() && !shutdown_;
+		}
+
+		// ends run(), may be called from any thread
+		void shutdown() {
+			shutdown_ = true;
+		}
+
+		// opens the scanner, retrying as soon as the port is plugged in (at least every second),
+		// and publishes its scans until ok() is false
+		void run(bool spin_once) {
+			std::string error;
+			if (lock_memory_) {
+				if (RealTime::lockMemory((size_t)std::max(prefault_heap_mb_, 0) << 20, &error))
+					ROS_INFO("Memory locked, %d MB heap prefaulted", prefault_heap_mb_);
+				else
+					ROS_WARN("Could not lock memory: %s", error.c_str());
+				error.clear();
+			}
+			if (!RealTime::setupThread(read_thread_priority_, read_thread_cpu_, 256 * 1024, &error))
+				ROS_WARN("Could not set up read thread: %s", error.c_str());
+
+			bool bOpenScan = false;
+			{
+				TRACE_PHASE("SickS300Node::open");
+				while (!bOpenScan && ok()) {
+					ROS_INFO("Opening scanner... (port:%s)", port.c_str());
+
+					bOpenScan = open();
+
+					if (!bOpenScan) {
+						ROS_ERROR("...scanner not available on port %s. Will retry when it is plugged in.", port.c_str());
+						status_ = STATUS_NOT_AVAILABLE;
+						// udev creates the node or changes its permissions on hotplug, the timeout covers other errors
+						SerialIO::waitForDevice(port.c_str(), 1.0);
+					}
+				}
+			}
+			if (!bOpenScan)
+				return;
+			ROS_INFO("...scanner opened successfully on port %s", port.c_str());
+			status_ = STATUS_OK;
+			// the scanner streams continuously, the first telegram completes the startup
+			first_scan_wait_start_ = Trace::now();
+
+			// main loop
+			while (ok()) {
+				// read scan
+				receiveScan();
+				checkConnection();
+				read_page_faults_.update();
+				if (spin_once)
+					ros::spinOnce();
+			}
+		}
+
+		// recovers from a corrupted stream by resynchronizing the framer, and from disconnects by reopening the port
+		void checkConnection() {
+			const double now = ScanTimeEstimator::getMonotonicTime();
+			if (scanner_.hasPortError() || now - scanner_.getLastDataTime() > reconnect_timeout_) {
+				ROS_WARN("scanner on port %s lost, reconnecting in %.1f s", port.c_str(), reconnect_backoff_);
+				status_ = STATUS_DISCONNECTED;
+				// returns early when udev reports the device again
+				SerialIO::waitForDevice(port.c_str(), reconnect_backoff_);
+				reconnect_backoff_ = std::min(2.0 * reconnect_backoff_, reconnect_backoff_max_);
+				reconnects_++;
+				if (scanner_.reconnect())
+					ROS_INFO("...scanner reopened on port %s", port.c_str());
+				last_scan_time_ = 0.0;
+			} else if (now - scanner_.getLastTelegramTime() > resync_timeout_) {
+				ROS_DEBUG("no telegram from scanner on port %s for %.3f s, resynchronizing", port.c_str(), now - scanner_.getLastTelegramTime());
+				scanner_.resync();
+				resyncs_++;
+			} else if (last_scan_time_ > 0.0) {
+				// scans are published again since the last reconnect
+				reconnect_backoff_ = reconnect_backoff_min_;
+			}
+		}
+
+		// reuses the scan message unless a subscriber or the publisher still holds the last one
+		void prepareScanMessage(Head &head) {
+			if(head.msg && head.msg.unique())
+				return;
+
+			head.msg.reset(new sensor_msgs::LaserScan);
+
+			// constant parts of the messages
+			head.msg->header.frame_id = head.frame_id;
+			head.msg->range_min = 0.001;
+			head.msg->range_max = 30.0;
+			head.msg->ranges.reserve(ScannerSickS300::SCANNER_S300_MAX_POINTS);
+			head.msg->intensities.reserve(ScannerSickS300::SCANNER_S300_MAX_POINTS);
+		}
+
+		void receiveScan() {
+			if(async_read)
+			{
+				// processScan is called as soon as a complete telegram arrived,
+				// the timeout keeps ros::spinOnce serviced while the scanner is silent
+				scanner_.waitForScan(0.1, boost::bind(&NodeClass::processScan, this), debug_);
+			}
+			else if(scanner_.readScan(debug_))
+				processScan();
+		}
+
+		// publishes the new scans of all heads, every telegram was parsed once by the scanner
+		void processScan() {
+			for(size_t i = 0; i < heads_.size(); i++)
+			{
+				if(scanner_.hasNewScan(heads_[i].index))
+					processScan(heads_[i]);
+			}
+		}
+
+		void processScan(Head &head) {
+			size_t num_readings;
+			double angle_min, angle_increment;
+
+			prepareScanMessage(head);
+
+			// make room for the largest possible scan, this only allocates once per message
+			head.msg->ranges.resize(ScannerSickS300::SCANNER_S300_MAX_POINTS);
+			head.msg->intensities.resize(ScannerSickS300::SCANNER_S300_MAX_POINTS);
+
+			if(scanner_.getLastScan(&head.msg->ranges[0], &head.msg->intensities[0], head.msg->ranges.size(), num_readings,
+			                        angle_min, angle_increment, debug_, head.index))
+			{
+				const uint32_t standby_bit = head.index < 32 ? 1u << head.index : 0u;
+				if(scanner_.isInStandby(head.index))
+				{
+					standby_heads_.fetch_or(standby_bit, boost::memory_order_relaxed);
+					ROS_WARN_THROTTLE(30, "scanner %s (head %s) on port %s in standby", node_name.c_str(), head.frame_id.c_str(), port.c_str());
+					publishStandby(head, true);
+				}
+				else if(num_readings>0)
+				{
+					standby_heads_.fetch_and(~standby_bit, boost::memory_order_relaxed);
+					publishStandby(head, false);
+					// the capture time is estimated on the monotonic clock, convert it by its age
+					const double now = ScanTimeEstimator::getMonotonicTime();
+					const double age = now - scanner_.getLastScanTime(head.index);
+					// the timing histograms and the recovery follow the first head
+					if(head.index == 0) {
+						status_.store(STATUS_OK, boost::memory_order_relaxed);
+						scans_.fetch_add(1, boost::memory_order_relaxed);
+						if(last_scan_time_ > 0.0)
+							scan_period_hist_.recordSeconds(now - last_scan_time_);
+						last_scan_time_ = now;
+						scan_latency_hist_.recordSeconds(age);
+					}
+					publishLaserScan(head, num_readings, angle_min, angle_increment, ros::Time::now() - ros::Duration(age));
+					if(first_scan_wait_start_ > 0) {
+						Trace::recordPhase("SickS300Node::firstScan", first_scan_wait_start_, Trace::now());
+						first_scan_wait_start_ = 0;
+						ROS_INFO_STREAM("startup phases:\n" << Trace::getPhaseSummary());
+					}
+				}
+			}
+		}
+
+		// Destructor
+		~SickS300Node()
+		{
+			diagnostics_timer_.stop();
+			diagnostics_spinner_->stop();
+		}
+
+		void publishStandby(Head &head, bool inStandby)
+		{
+			this->inStandby_.data = inStandby;
+			head.standby_pub.publish(this->inStandby_);
+		}
+
+		// other function declarations
+		void publishLaserScan(Head &head, const size_t num_readings, const double angle_min, const double angle_increment, const ros::Time &capture_time)
+		{
+			if(ros::Time::now()-loop_rate_.now()>=ros::Duration(1./publish_frequency))
+				return;
+			loop_rate_ = ros::Time::now();
+
+			// fill LaserScan message
+			sensor_msgs::LaserScan &laserScan = *head.msg;
+			laserScan.header.stamp = capture_time;
+			ROS_DEBUG("Time::now() - calculated sick time stamp = %f",(ros::Time::now() - laserScan.header.stamp).toSec());
+
+			// fill message
+			laserScan.angle_increment = angle_increment;
+			laserScan.time_increment = (scan_duration) / (num_readings);
+
+			// rescale scan
+			laserScan.angle_min = angle_min; // first ScanAngle
+			laserScan.angle_max = angle_min + (num_readings - 1) * angle_increment; // last ScanAngle
+			laserScan.ranges.resize(num_readings);
+			laserScan.intensities.resize(num_readings);
+
+
+			// check for inverted laser
+			if(head.inverted) {
+				// to be really accurate, we now invert time_increment
+				// laserScan.header.stamp = laserScan.header.stamp + ros::Duration(scan_duration); //adding of the sum over all negative increments would be mathematically correct, but looks worse.
+				laserScan.time_increment = - laserScan.time_increment;
+
+				// the scanner wrote the readings in its own order, reverse them in place
+				std::reverse(laserScan.ranges.begin(), laserScan.ranges.end());
+				std::reverse(laserScan.intensities.begin(), laserScan.intensities.end());
+			} else {
+				laserScan.header.stamp = laserScan.header.stamp - ros::Duration(scan_duration); //to be consistent with the omission of the addition above
+			}
+
+			// publish Laserscan-message
+			head.scan_pub.publish(head.msg);
+		}
+
+		// aggregates the status and counters of the read loop, called on the diagnostics thread
+		void publishDiagnostics(const ros::TimerEvent &event)
+		{
+			const ros::Time now = ros::Time::now();
+			diagnostic_msgs::DiagnosticStatus &status = diagnostics_.status[0];
+			diagnostics_.header.stamp = now;
+
+			switch(status_.load(boost::memory_order_relaxed))
+			{
+				case STATUS_NOT_AVAILABLE:
+					status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+					status.message = "...scanner not available on port";
+					break;
+				case STATUS_DISCONNECTED:
+					status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+					status.message = "scanner disconnected";
+					break;
+				default:
+					if(standby_heads_.load(boost::memory_order_relaxed) != 0) {
+						status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+						status.message = "scanner in standby";
+					} else {
+						status.level = diagnostic_msgs::DiagnosticStatus::OK;
+						status.message = "sick scanner running";
+					}
+			}
+
+			// scans of the first head since the last call
+			const unsigned long scans = scans_.load(boost::memory_order_relaxed);
+			const double dt = (now - last_diagnostics_).toSec();
+			std::ostringstream scan_rate;
+			scan_rate << std::fixed << std::setprecision(1) << (last_diagnostics_.isZero() || dt <= 0.0 ? 0.0 : (scans - last_scans_) / dt);
+			last_diagnostics_ = now;
+			last_scans_ = scans;
+
+			SerialIO::Statistics serial;
+			scanner_.getSerialStatistics(&serial);
+			status.values.resize(9);
+			status.values[0].key = "scan rate [Hz]";
+			status.values[0].value = scan_rate.str();
+			status.values[1].key = "bytes received";
+			status.values[1].value = boost::lexical_cast<std::string>(serial.ulBytesRead);
+			status.values[2].key = "serial errors";
+			status.values[2].value = boost::lexical_cast<std::string>(serial.ulErrors);
+			status.values[3].key = "max read latency [us]";
+			status.values[3].value = boost::lexical_cast<std::string>(serial.ulMaxReadLatencyUs);
+			status.values[4].key = "CRC errors";
+			status.values[4].value = boost::lexical_cast<std::string>(scanner_.getCrcErrors());
+			status.values[5].key = "resyncs";
+			status.values[5].value = boost::lexical_cast<std::string>(resyncs_.load(boost::memory_order_relaxed));
+			status.values[6].key = "reconnects";
+			status.values[6].value = boost::lexical_cast<std::string>(reconnects_.load(boost::memory_order_relaxed));
+			status.values[7].key = "telegrams of other scanners";
+			status.values[7].value = boost::lexical_cast<std::string>(scanner_.getForeignTelegrams());
+			status.values[8].key = "raw log chunks dropped";
+			status.values[8].value = boost::lexical_cast<std::string>(raw_log_.getDropped());
+
+			// a scan missed by more than half a cycle is an overrun
+			std::vector<std::pair<std::string, std::string> > timing;
+			LatencyHistogram::Summary summary;
+			scan_period_hist_.getSummary(&summary, 1.5e6 * scan_cycle_time, true);
+			LatencyHistogram::appendKeyValues("scan period", summary, &timing);
+			scan_latency_hist_.getSummary(&summary, 1e6 * scan_cycle_time, true);
+			LatencyHistogram::appendKeyValues("scan latency", summary, &timing);
+			uint64_t minor_faults, major_faults;
+			read_page_faults_.get(&minor_faults, &major_faults, true);
+			timing.push_back(std::make_pair("read loop minor page faults", boost::lexical_cast<std::string>(minor_faults)));
+			timing.push_back(std::make_pair("read loop major page faults", boost::lexical_cast<std::string>(major_faults)));
+			for(size_t i = 0; i < timing.size(); i++)
+			{
+				diagnostic_msgs::KeyValue kv;
+				kv.key = timing[i].first;
+				kv.value = timing[i].second;
+				status.values.push_back(kv);
+			}
+			topicPub_Diagnostic_.publish(diagnostics_);
+		}
+};
+
+#endif
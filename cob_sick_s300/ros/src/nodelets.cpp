@@ -0,0 +1,75 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#include <cob_sick_s300/sick_s300_node.h>
+#include <cob_sick_s300/scan_filter_node.h>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/scoped_ptr.hpp>
+
+namespace cob_sick_s300
+{
+
+/**
+ * SickS300Node in a nodelet manager, the scanner is read in its own thread.
+ * Together with ScanFilterNodelet and the cob_scan_unifier nodelet in the same manager
+ * the scans are passed on by pointer instead of being serialized at every hop.
+ */
+class SickS300Nodelet : public nodelet::Nodelet
+{
+public:
+	~SickS300Nodelet()
+	{
+		if(node_)
+		{
+			node_->shutdown();
+			thread_.join();
+		}
+	}
+
+private:
+	virtual void onInit()
+	{
+		node_.reset(new SickS300Node(getNodeHandle()));
+		node_->node_name = getName();
+		thread_ = boost::thread(boost::bind(&SickS300Node::run, node_.get(), false));
+	}
+
+	boost::scoped_ptr<SickS300Node> node_;
+	boost::thread thread_;
+};
+
+/**
+ * ScanFilterNode in a nodelet manager.
+ */
+class ScanFilterNodelet : public nodelet::Nodelet
+{
+private:
+	virtual void onInit()
+	{
+		node_.reset(new ScanFilterNode(getNodeHandle()));
+	}
+
+	boost::scoped_ptr<ScanFilterNode> node_;
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(cob_sick_s300::SickS300Nodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(cob_sick_s300::ScanFilterNodelet, nodelet::Nodelet)
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#ifndef COB_SOUND_FESTIVAL_ENGINE_H
+#define COB_SOUND_FESTIVAL_ENGINE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <sys/types.h>
+
+#include <cob_sound/pcm_player.h>
+
+// festival process that is kept running between utterances, so it starts and loads its voice only once
+class FestivalEngine
+{
+public:
+  FestivalEngine();
+  ~FestivalEngine();
+
+  bool start();
+  bool isRunning() const { return pid_ > 0; }
+  bool synthesize(const std::string& text, Waveform& wave, std::string& error);
+
+private:
+  pid_t pid_;
+  int to_festival_;
+  int from_festival_;
+  std::string tmp_dir_;
+  std::string output_;
+  unsigned int counter_;
+
+  void terminate();
+  // sends a command followed by a marker and waits until festival printed the marker
+  bool send(const std::string& command, double timeout);
+  bool waitForMarker(const std::string& marker, double timeout);
+};
+
+// synthesized waveforms of the last phrases, the least recently used one is dropped first
+class WaveformCache
+{
+public:
+  WaveformCache(size_t capacity) : capacity_(capacity) {}
+
+  WaveformConstPtr get(const std::string& key)
+  {
+    std::map<std::string, List::iterator>::iterator it = index_.find(key);
+    if(it == index_.end())
+      return WaveformConstPtr();
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->second;
+  }
+
+  void put(const std::string& key, const WaveformConstPtr& wave)
+  {
+    if(capacity_ == 0)
+      return;
+    std::map<std::string, List::iterator>::iterator it = index_.find(key);
+    if(it != index_.end())
+      lru_.erase(it->second);
+    else if(lru_.size() >= capacity_)
+    {
+      index_.erase(lru_.back().first);
+      lru_.pop_back();
+    }
+    lru_.push_front(std::make_pair(key, wave));
+    index_[key] = lru_.begin();
+  }
+
+private:
+  typedef std::list<std::pair<std::string, WaveformConstPtr> > List;
+  List lru_;
+  std::map<std::string, List::iterator> index_;
+  size_t capacity_;
+};
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#ifndef COB_SOUND_PCM_PLAYER_H
+#define COB_SOUND_PCM_PLAYER_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+
+#include <alsa/asoundlib.h>
+
+// interleaved signed 16 bit samples
+struct Waveform
+{
+  unsigned int sample_rate;
+  unsigned int channels;
+  std::vector<int16_t> samples;
+
+  size_t frames() const { return channels ? samples.size() / channels : 0; }
+  double duration() const { return sample_rate ? (double)frames() / sample_rate : 0.0; }
+};
+typedef boost::shared_ptr<const Waveform> WaveformConstPtr;
+
+// reads an uncompressed RIFF wave file with 8 or 16 bit samples
+bool loadWave(const std::string& filename, Waveform& wave, std::string& error);
+
+class PcmPlayer;
+
+// mixes the voices of all its PcmPlayers into one ALSA device.
+// The device is opened once with a fixed format and a fixed latency and stays running,
+// silence is written while no voice plays, so sounds start and overlap without reopening it.
+class PcmMixer
+{
+public:
+  // latency: size of the device buffer in seconds
+  PcmMixer(const std::string& device, unsigned int rate, unsigned int channels, double latency);
+  ~PcmMixer();
+
+  unsigned int getRate() const { return rate_; }
+  unsigned int getChannels() const { return channels_; }
+
+private:
+  friend class PcmPlayer;
+
+  std::string device_;
+  unsigned int rate_;
+  unsigned int channels_;
+  double latency_;
+  snd_pcm_t* pcm_;
+  size_t period_frames_;
+  size_t buffer_frames_;
+
+  boost::thread thread_;
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+  std::vector<PcmPlayer*> voices_;
+  bool shutdown_;
+
+  void add(PcmPlayer* voice);
+  void remove(PcmPlayer* voice);
+  void run();
+  bool open();
+};
+typedef boost::shared_ptr<PcmMixer> PcmMixerPtr;
+
+// one voice of a PcmMixer, plays one waveform at a time.
+// The waveform is converted to the format of the mixer while it is mixed.
+class PcmPlayer
+{
+public:
+  PcmPlayer(const PcmMixerPtr& mixer);
+  ~PcmPlayer();
+
+  // starts playing with the next period of the mixer, a running sound is stopped.
+  // With fade_in > 0 the gain ramps from 0 to the volume over fade_in seconds.
+  bool play(const WaveformConstPtr& wave, double fade_in = 0.0);
+  // with fade_out > 0 the gain ramps to 0 over fade_out seconds before the sound stops, the call does not wait for it
+  void stop(double fade_out = 0.0);
+  // blocks until the sound has been played or stop was called, false if the device failed
+  bool wait();
+
+  bool isPlaying() const { return playing_; }
+  // progress of the current sound, 0..1
+  float getPosition() const;
+  // played time of the current sound in ms
+  int64_t getTime() const;
+
+  // 0..100, applied to the samples
+  void setVolume(int volume) { fadeTo(volume, 0.0); }
+  int getVolume() const { return volume_; }
+  // ramps the gain linearly to volume over duration seconds, sample by sample
+  void fadeTo(int volume, double duration);
+
+private:
+  friend class PcmMixer;
+
+  PcmMixerPtr mixer_;
+
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+  WaveformConstPtr wave_;
+  double pos_;              // position in the frames of wave_
+  size_t tail_frames_;      // frames mixed after the end of wave_, until they have left the device buffer
+  bool failed_;
+  float gain_;
+  size_t fade_frames_;      // frames left of the running ramp to the target gain
+  bool stop_after_fade_;
+
+  boost::atomic<bool> playing_;
+  boost::atomic<int> volume_;
+  boost::atomic<size_t> frames_played_;
+  boost::atomic<size_t> frames_total_;
+  boost::atomic<unsigned int> sample_rate_;
+
+  // called by the mixer thread: adds the next frames of the voice to mix (interleaved, in the format of the mixer)
+  void mix(int32_t* mix, size_t frames);
+  // called by the mixer thread if the device could not be opened or written
+  void fail();
+  void finish();
+};
+
+#endif
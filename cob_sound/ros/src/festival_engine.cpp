@@ -0,0 +1,190 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#include <cob_sound/festival_engine.h>
+
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/select.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <sstream>
+#include <ros/console.h>
+
+// printed by festival after each command, numbered so a late answer is not taken for the current one
+static const char* DONE_MARKER = "cob_sound_done_";
+
+FestivalEngine::FestivalEngine()
+  : pid_(-1), to_festival_(-1), from_festival_(-1), counter_(0)
+{
+}
+
+FestivalEngine::~FestivalEngine()
+{
+  terminate();
+  if(!tmp_dir_.empty())
+    rmdir(tmp_dir_.c_str());
+}
+
+bool FestivalEngine::start()
+{
+  if(pid_ > 0)
+    return true;
+
+  if(tmp_dir_.empty())
+  {
+    char dir[] = "/tmp/cob_sound_XXXXXX";
+    if(mkdtemp(dir) == NULL)
+    {
+      ROS_ERROR("Could not create directory for festival output: %s", strerror(errno));
+      return false;
+    }
+    tmp_dir_ = dir;
+  }
+
+  int in[2], out[2];
+  if(pipe(in) != 0)
+    return false;
+  if(pipe(out) != 0)
+  {
+    close(in[0]);
+    close(in[1]);
+    return false;
+  }
+
+  pid_ = fork();
+  if(pid_ == 0)
+  {
+    dup2(in[0], STDIN_FILENO);
+    dup2(out[1], STDOUT_FILENO);
+    close(in[0]); close(in[1]);
+    close(out[0]); close(out[1]);
+    //festival buffers its output when writing to a pipe, stdbuf makes the marker arrive right away
+    execlp("stdbuf", "stdbuf", "-oL", "festival", "--pipe", (char*)NULL);
+    _exit(127);
+  }
+  close(in[0]);
+  close(out[1]);
+  if(pid_ < 0)
+  {
+    close(in[1]);
+    close(out[0]);
+    return false;
+  }
+  to_festival_ = in[1];
+  from_festival_ = out[0];
+  output_.clear();
+
+  //festival loads its voice before answering the first command
+  if(!send("", 30.0))
+  {
+    ROS_WARN("festival did not start");
+    terminate();
+    return false;
+  }
+  return true;
+}
+
+void FestivalEngine::terminate()
+{
+  if(to_festival_ != -1)
+    close(to_festival_);
+  if(from_festival_ != -1)
+    close(from_festival_);
+  to_festival_ = from_festival_ = -1;
+  if(pid_ > 0)
+  {
+    kill(pid_, SIGTERM);
+    waitpid(pid_, NULL, 0);
+  }
+  pid_ = -1;
+}
+
+bool FestivalEngine::send(const std::string& command, double timeout)
+{
+  std::ostringstream marker;
+  marker << DONE_MARKER << ++counter_;
+  std::string line = command + "(print \"" + marker.str() + "\")\n";
+  if(::write(to_festival_, line.c_str(), line.size()) != (ssize_t)line.size())
+    return false;
+  return waitForMarker(marker.str(), timeout);
+}
+
+bool FestivalEngine::waitForMarker(const std::string& marker, double timeout)
+{
+  while(true)
+  {
+    size_t found = output_.find(marker);
+    if(found != std::string::npos)
+    {
+      size_t end = output_.find('\n', found);
+      output_.erase(0, end == std::string::npos ? output_.size() : end + 1);
+      return true;
+    }
+
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(from_festival_, &fds);
+    struct timeval tv;
+    tv.tv_sec = (long)timeout;
+    tv.tv_usec = (long)((timeout - tv.tv_sec) * 1e6);
+    if(select(from_festival_ + 1, &fds, NULL, NULL, &tv) <= 0)
+      return false;
+
+    char buf[256];
+    ssize_t n = read(from_festival_, buf, sizeof(buf));
+    if(n <= 0)
+      return false;
+    output_.append(buf, n);
+  }
+}
+
+bool FestivalEngine::synthesize(const std::string& text, Waveform& wave, std::string& error)
+{
+  if(!start())
+  {
+    error = "festival is not running";
+    return false;
+  }
+
+  std::string escaped;
+  for(size_t i = 0; i < text.size(); i++)
+  {
+    if(text[i] == '"' || text[i] == '\\')
+      escaped += '\\';
+    escaped += text[i];
+  }
+
+  std::string filename = tmp_dir_ + "/utterance.wav";
+  unlink(filename.c_str());
+  std::string command = "(utt.save.wave (utt.synth (eval (list 'Utterance 'Text \"" + escaped + "\"))) \""
+      + filename + "\" 'riff)\n";
+  if(!send(command, 10.0 + 0.1 * text.size()))
+  {
+    error = "festival did not answer, restarting it";
+    terminate();
+    return false;
+  }
+
+  bool ret = loadWave(filename, wave, error);
+  unlink(filename.c_str());
+  return ret;
+}
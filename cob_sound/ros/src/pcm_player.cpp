@@ -0,0 +1,347 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#include <cob_sound/pcm_player.h>
+
+#include <fstream>
+#include <cstring>
+#include <ros/console.h>
+
+static uint32_t readLE(const unsigned char* p, int bytes)
+{
+  uint32_t v = 0;
+  for(int i = bytes - 1; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+bool loadWave(const std::string& filename, Waveform& wave, std::string& error)
+{
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  if(!file)
+  {
+    error = "could not open " + filename;
+    return false;
+  }
+  std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if(data.size() < 12 || memcmp(&data[0], "RIFF", 4) != 0 || memcmp(&data[8], "WAVE", 4) != 0)
+  {
+    error = filename + " is not a RIFF wave file";
+    return false;
+  }
+
+  unsigned int format = 0, bits = 0;
+  wave.channels = 0;
+  wave.sample_rate = 0;
+  size_t pos = 12;
+  while(pos + 8 <= data.size())
+  {
+    uint32_t size = readLE(&data[pos + 4], 4);
+    const unsigned char* chunk = &data[pos + 8];
+    size_t available = std::min<size_t>(size, data.size() - pos - 8);
+    if(memcmp(&data[pos], "fmt ", 4) == 0 && available >= 16)
+    {
+      format = readLE(chunk, 2);
+      wave.channels = readLE(chunk + 2, 2);
+      wave.sample_rate = readLE(chunk + 4, 4);
+      bits = readLE(chunk + 14, 2);
+    }
+    else if(memcmp(&data[pos], "data", 4) == 0)
+    {
+      if(format != 1 || (bits != 8 && bits != 16) || wave.channels == 0 || wave.sample_rate == 0)
+      {
+        error = filename + " is not 8 or 16 bit PCM";
+        return false;
+      }
+      size_t count = available / (bits / 8);
+      wave.samples.resize(count);
+      for(size_t i = 0; i < count; i++)
+      {
+        if(bits == 16)
+          wave.samples[i] = (int16_t)readLE(chunk + 2 * i, 2);
+        else
+          wave.samples[i] = ((int)chunk[i] - 128) << 8;
+      }
+      return true;
+    }
+    pos += 8 + size + (size & 1);
+  }
+  error = filename + " has no data chunk";
+  return false;
+}
+
+PcmMixer::PcmMixer(const std::string& device, unsigned int rate, unsigned int channels, double latency)
+  : device_(device), rate_(rate), channels_(channels), latency_(latency), pcm_(NULL), period_frames_(0), buffer_frames_(0), shutdown_(false)
+{
+  thread_ = boost::thread(&PcmMixer::run, this);
+}
+
+PcmMixer::~PcmMixer()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    shutdown_ = true;
+  }
+  cond_.notify_all();
+  thread_.join();
+  if(pcm_)
+    snd_pcm_close(pcm_);
+}
+
+void PcmMixer::add(PcmPlayer* voice)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  voices_.push_back(voice);
+}
+
+void PcmMixer::remove(PcmPlayer* voice)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  voices_.erase(std::remove(voices_.begin(), voices_.end(), voice), voices_.end());
+}
+
+bool PcmMixer::open()
+{
+  int err = snd_pcm_open(&pcm_, device_.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
+  if(err < 0)
+  {
+    ROS_ERROR_THROTTLE(10.0, "Could not open ALSA device %s: %s", device_.c_str(), snd_strerror(err));
+    pcm_ = NULL;
+    return false;
+  }
+  err = snd_pcm_set_params(pcm_, SND_PCM_FORMAT_S16, SND_PCM_ACCESS_RW_INTERLEAVED,
+                           channels_, rate_, 1, (unsigned int)(latency_ * 1e6));
+  if(err < 0)
+  {
+    ROS_ERROR_THROTTLE(10.0, "Could not set %u Hz, %u channels on %s: %s", rate_, channels_, device_.c_str(), snd_strerror(err));
+    snd_pcm_close(pcm_);
+    pcm_ = NULL;
+    return false;
+  }
+  snd_pcm_uframes_t buffer_size = 0, period_size = 0;
+  if(snd_pcm_get_params(pcm_, &buffer_size, &period_size) < 0 || period_size == 0)
+  {
+    period_size = rate_ / 100;
+    buffer_size = (snd_pcm_uframes_t)(latency_ * rate_);
+  }
+  period_frames_ = period_size;
+  buffer_frames_ = buffer_size;
+  ROS_INFO("Opened ALSA device %s: %u Hz, %u channels, %.1f ms buffer, %.1f ms period", device_.c_str(), rate_, channels_,
+           buffer_frames_ * 1000.0 / rate_, period_frames_ * 1000.0 / rate_);
+  return true;
+}
+
+void PcmMixer::run()
+{
+  std::vector<int32_t> mix;
+  std::vector<int16_t> out;
+  while(true)
+  {
+    if(pcm_ == NULL && !open())
+    {
+      //nothing can be played, the waiting voices are released and the device is opened again later
+      boost::mutex::scoped_lock lock(mutex_);
+      for(size_t i = 0; i < voices_.size(); i++)
+        voices_[i]->fail();
+      if(!shutdown_)
+        cond_.timed_wait(lock, boost::posix_time::seconds(1));
+      if(shutdown_)
+        return;
+      continue;
+    }
+
+    mix.assign(period_frames_ * channels_, 0);
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if(shutdown_)
+        return;
+      for(size_t i = 0; i < voices_.size(); i++)
+        voices_[i]->mix(&mix[0], period_frames_);
+    }
+    out.resize(mix.size());
+    for(size_t i = 0; i < mix.size(); i++)
+      out[i] = (int16_t)std::max(-32768, std::min(mix[i], 32767));
+
+    //blocks until the device has room for the period, this paces the mixer
+    size_t written = 0;
+    while(written < period_frames_)
+    {
+      snd_pcm_sframes_t ret = snd_pcm_writei(pcm_, &out[written * channels_], period_frames_ - written);
+      if(ret < 0)
+      {
+        ret = snd_pcm_recover(pcm_, ret, 1);
+        if(ret < 0)
+        {
+          ROS_ERROR("Writing to ALSA device %s failed: %s", device_.c_str(), snd_strerror(ret));
+          snd_pcm_close(pcm_);
+          pcm_ = NULL;
+          break;
+        }
+        continue;
+      }
+      written += ret;
+    }
+  }
+}
+
+PcmPlayer::PcmPlayer(const PcmMixerPtr& mixer)
+  : mixer_(mixer), pos_(0.0), tail_frames_(0), failed_(false), gain_(1.0f), fade_frames_(0), stop_after_fade_(false),
+    playing_(false), volume_(100), frames_played_(0), frames_total_(0), sample_rate_(0)
+{
+  mixer_->add(this);
+}
+
+PcmPlayer::~PcmPlayer()
+{
+  mixer_->remove(this);
+}
+
+bool PcmPlayer::play(const WaveformConstPtr& wave, double fade_in)
+{
+  if(!wave || wave->frames() == 0)
+    return false;
+  boost::mutex::scoped_lock lock(mutex_);
+  if(wave_)
+    finish();
+  wave_ = wave;
+  pos_ = 0.0;
+  tail_frames_ = 0;
+  failed_ = false;
+  gain_ = (fade_in > 0.0) ? 0.0f : volume_ / 100.0f;
+  fade_frames_ = (size_t)(fade_in * mixer_->getRate());
+  stop_after_fade_ = false;
+  frames_total_ = wave->frames();
+  frames_played_ = 0;
+  sample_rate_ = wave->sample_rate;
+  playing_ = true;
+  return true;
+}
+
+void PcmPlayer::stop(double fade_out)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if(!wave_)
+    return;
+  if(fade_out > 0.0 && pos_ < wave_->frames())
+  {
+    //the voice ends once the gain reached 0
+    fade_frames_ = (size_t)(fade_out * mixer_->getRate());
+    stop_after_fade_ = true;
+  }
+  else
+    finish();
+}
+
+void PcmPlayer::fadeTo(int volume, double duration)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  volume_ = std::max(0, std::min(volume, 100));
+  fade_frames_ = (size_t)(duration * mixer_->getRate());
+}
+
+bool PcmPlayer::wait()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  while(playing_)
+    cond_.wait(lock);
+  return !failed_;
+}
+
+float PcmPlayer::getPosition() const
+{
+  size_t total = frames_total_;
+  return total ? (float)frames_played_ / total : 0.0f;
+}
+
+int64_t PcmPlayer::getTime() const
+{
+  unsigned int rate = sample_rate_;
+  return rate ? (int64_t)frames_played_ * 1000 / rate : 0;
+}
+
+void PcmPlayer::finish()
+{
+  wave_.reset();
+  playing_ = false;
+  cond_.notify_all();
+}
+
+void PcmPlayer::fail()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if(wave_)
+  {
+    failed_ = true;
+    finish();
+  }
+}
+
+void PcmPlayer::mix(int32_t* mix, size_t frames)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if(!wave_)
+    return;
+
+  const Waveform& wave = *wave_;
+  const size_t total = wave.frames();
+  if(pos_ >= total)
+  {
+    //the end has been mixed, the voice is done when it has been played from the device buffer
+    if(tail_frames_ <= frames)
+      finish();
+    else
+      tail_frames_ -= frames;
+    return;
+  }
+
+  //linear interpolation to the rate of the mixer, missing channels repeat the last one, surplus ones are dropped
+  const unsigned int channels = mixer_->channels_;
+  const double step = (double)wave.sample_rate / mixer_->rate_;
+  //the gain follows the volume, during a fade it moves one step per frame
+  const float target = stop_after_fade_ ? 0.0f : volume_ / 100.0f;
+  for(size_t f = 0; f < frames; f++, mix += channels)
+  {
+    const size_t i = (size_t)pos_;
+    if(i >= total)
+      break;
+    if(fade_frames_ > 0)
+    {
+      gain_ += (target - gain_) / fade_frames_;
+      fade_frames_--;
+    }
+    else
+      gain_ = target;
+
+    const float frac = (float)(pos_ - i);
+    const int16_t* a = &wave.samples[i * wave.channels];
+    const int16_t* b = (i + 1 < total) ? a + wave.channels : a;
+    for(unsigned int c = 0; c < channels; c++)
+    {
+      const unsigned int src = std::min(c, wave.channels - 1);
+      mix[c] += (int32_t)((a[src] + (b[src] - a[src]) * frac) * gain_);
+    }
+    pos_ += step;
+
+    //the ramp to 0 has been mixed
+    if(stop_after_fade_ && fade_frames_ == 0)
+      pos_ = total;
+  }
+  frames_played_ = std::min((size_t)pos_, total);
+  if(pos_ >= total)
+    tail_frames_ = mixer_->buffer_frames_;
+}
@@ -27,6 +27,13 @@
 
 #include <vlc/vlc.h>
 
+#include <boost/thread.hpp>
+#include <boost/lexical_cast.hpp>
+#include <unistd.h>
+
+#include <cob_sound/pcm_player.h>
+#include <cob_sound/festival_engine.h>
+
 class SoundAction
 {
 protected:
@@ -50,6 +57,33 @@ protected:
   libvlc_media_player_t* vlc_player_;
   libvlc_media_t* vlc_media_;
 
+  // vlc only offers the player volume, it is ramped by this thread so that fades do not block the callbacks
+  boost::thread vlc_fader_;
+  boost::mutex vlc_fade_mutex_;
+  boost::condition_variable vlc_fade_cond_;
+  bool vlc_fade_active_;
+  bool vlc_stop_after_fade_;
+  bool vlc_fader_shutdown_;
+  int vlc_fade_from_;
+  int vlc_fade_to_;
+  ros::WallTime vlc_fade_start_;
+
+  // all synthesized and preloaded sounds are voices of one mixer that keeps the audio device open,
+  // so say and play can overlap
+  PcmMixerPtr mixer_;
+
+  // festival stays open between say requests
+  FestivalEngine festival_;
+  WaveformCache say_cache_;
+  boost::shared_ptr<PcmPlayer> say_player_;
+  // output of text2wave and cepstral, played through say_player_
+  std::string say_file_;
+
+  // decoded sounds from the preload list, played without touching the disk
+  std::map<std::string, WaveformConstPtr> preloaded_;
+  boost::shared_ptr<PcmPlayer> play_player_;
+  bool play_from_cache_;
+
 public:
   diagnostic_msgs::DiagnosticArray diagnostics_;
   ros::Publisher diagnostics_pub_;
@@ -58,7 +92,8 @@ public:
 
   SoundAction():
     as_say_(nh_, ros::this_node::getName() + "/say", boost::bind(&SoundAction::as_cb_say_, this, _1), false),
-    as_play_(nh_, ros::this_node::getName() + "/play", false)
+    as_play_(nh_, ros::this_node::getName() + "/play", false),
+    say_cache_(ros::NodeHandle("~").param<int>("say_cache_size", 20))
   {
     nh_ = ros::NodeHandle("~");
     as_play_.registerGoalCallback(boost::bind(&SoundAction::as_goal_cb_play_, this));
@@ -81,6 +116,22 @@ public:
 
     vlc_inst_ = libvlc_new(0,NULL);
     vlc_player_ = libvlc_media_player_new(vlc_inst_);
+    vlc_fade_active_ = false;
+    vlc_stop_after_fade_ = false;
+    vlc_fader_shutdown_ = false;
+    vlc_fade_from_ = vlc_fade_to_ = 100;
+    vlc_fader_ = boost::thread(&SoundAction::vlc_fader_thread, this);
+
+    std::string audio_device = nh_.param<std::string>("audio_device", "default");
+    mixer_.reset(new PcmMixer(audio_device, nh_.param<int>("mixer_rate", 48000), nh_.param<int>("mixer_channels", 2),
+                              nh_.param<double>("mixer_latency", 0.05)));
+    say_player_.reset(new PcmPlayer(mixer_));
+    play_player_.reset(new PcmPlayer(mixer_));
+    say_file_ = "/tmp/cob_sound_say_" + boost::lexical_cast<std::string>(getpid()) + ".wav";
+    play_from_cache_ = false;
+    preload();
+    if(nh_.param<std::string>("mode", "festival") == "festival" && !festival_.start())
+      ROS_WARN("Could not start festival, falling back to text2wave for every say request");
 
     as_say_.start();
     as_play_.start();
@@ -88,9 +139,17 @@ public:
 
   ~SoundAction(void)
   {
+    play_player_->stop();
+    {
+      boost::mutex::scoped_lock lock(vlc_fade_mutex_);
+      vlc_fader_shutdown_ = true;
+    }
+    vlc_fade_cond_.notify_all();
+    vlc_fader_.join();
     libvlc_media_player_stop(vlc_player_);
     libvlc_media_player_release(vlc_player_);
     libvlc_release(vlc_inst_);
+    unlink(say_file_.c_str());
   }
 
   void as_goal_cb_play_()
@@ -114,9 +173,8 @@ public:
   {
     if(as_play_.isActive())
     {
-      fade_out();
       play_feedback_timer_.stop();
-      libvlc_media_player_stop(vlc_player_);
+      stop_playback(true);
     }
     cob_sound::PlayResult result;
     result.success = false;
@@ -159,7 +217,6 @@ public:
   bool service_cb_stop(std_srvs::Trigger::Request &req,
                        std_srvs::Trigger::Response &res )
   {
-    fade_out();
     if(as_play_.isActive())
     {
       play_feedback_timer_.stop();
@@ -167,15 +224,15 @@ public:
       result.success = false;
       result.message = "Action has been aborted";
       as_play_.setAborted(result, result.message);
-      libvlc_media_player_stop(vlc_player_);
+      stop_playback(true);
       res.success = true;
       res.message = "aborted running action";
     }
     else
     {
-      if(libvlc_media_player_is_playing(vlc_player_) == 1)
+      if(is_playing())
       {
-        libvlc_media_player_stop(vlc_player_);
+        stop_playback(true);
         res.success = true;
         res.message = "stopped sound play";
       }
@@ -240,13 +297,17 @@ public:
     nh_.param<std::string>("cepstral_settings",cepstral_conf,"\"speech/rate=170\"");
     if (mode == "cepstral")
     {
-      command = "aoss swift -p " + cepstral_conf + " -n " + cepstral_voice + " " + data;
+      command = "swift -p " + cepstral_conf + " -n " + cepstral_voice + " -o " + say_file_ + " " + data;
     }
     else
     {
-      command = "echo " + data + " | text2wave | aplay -q";
+      if (say_festival(data, message))
+        return true;
+      ROS_WARN_STREAM(message);
+      command = "echo " + data + " | text2wave -o " + say_file_;
     }
-    if (system(command.c_str()) != 0)
+    // the speech is written to a file and played through the mixer, so it does not need the audio device
+    if (system(command.c_str()) != 0 || !say_file(message))
     {
       message = "Command say failed to play sound using mode " + mode;
       ROS_ERROR_STREAM(message);
@@ -266,6 +327,52 @@ public:
     return true;
   }
 
+  // synthesizes with the running festival process, repeated phrases are played from the cache, blocks until played
+  bool say_festival(const std::string& data, std::string& message)
+  {
+    WaveformConstPtr wave = say_cache_.get(data);
+    if (!wave)
+    {
+      if (!festival_.isRunning() && !festival_.start())
+      {
+        message = "festival is not running";
+        return false;
+      }
+      boost::shared_ptr<Waveform> synthesized(new Waveform);
+      if (!festival_.synthesize(data, *synthesized, message))
+        return false;
+      wave = synthesized;
+      say_cache_.put(data, wave);
+    }
+    return say_wave(wave, message);
+  }
+
+  // plays the output of text2wave or cepstral, blocks until played
+  bool say_file(std::string& message)
+  {
+    boost::shared_ptr<Waveform> wave(new Waveform);
+    std::string error;
+    bool ret = loadWave(say_file_, *wave, error) && say_wave(wave, message);
+    unlink(say_file_.c_str());
+    return ret;
+  }
+
+  // plays a synthesized waveform on the say voice, blocks until played
+  bool say_wave(const WaveformConstPtr& wave, std::string& message)
+  {
+    if (!say_player_->play(wave))
+    {
+      message = "could not play synthesized text";
+      return false;
+    }
+    if (!say_player_->wait())
+    {
+      message = "could not play synthesized text on the audio device";
+      return false;
+    }
+    return true;
+  }
+
   bool play(std::string filename, std::string message)
   {
     bool ret = false;
@@ -277,19 +384,29 @@ public:
     }
 
     ROS_INFO("Playing: %s", filename.c_str());
-    vlc_media_ = libvlc_media_new_path(vlc_inst_, filename.c_str());
-
-    if (vlc_media_ != NULL)
+    std::map<std::string, WaveformConstPtr>::const_iterator cached = preloaded_.find(filename);
+    if (cached != preloaded_.end())
     {
-        libvlc_media_player_set_media(vlc_player_, vlc_media_);
-        libvlc_media_release(vlc_media_);
-        fade_out();
-        if(fade_in())
+        // the new sound starts right away, a running vlc sound is cut
+        stop_vlc(false);
+        play_from_cache_ = true;
+        if(play_player_->play(cached->second, fade_volume_ ? fade_duration_ : 0.0))
         {
           ret = true;
           message = "Play successfull";
         }
     }
+    else if ((vlc_media_ = libvlc_media_new_path(vlc_inst_, filename.c_str())) != NULL)
+    {
+        play_player_->stop();
+        play_from_cache_ = false;
+        if(play_vlc(vlc_media_))
+        {
+          ret = true;
+          message = "Play successfull";
+        }
+        libvlc_media_release(vlc_media_);
+    }
     if(ret == false)
     {
       message = "Could not play file %s" + filename;
@@ -330,10 +447,10 @@ public:
   {
     if(as_play_.isActive())
     {
-      if (libvlc_media_player_is_playing(vlc_player_) == 1)
+      if (is_playing())
       {
-        float perc_done = libvlc_media_player_get_position(vlc_player_);
-        int64_t t = libvlc_media_player_get_time(vlc_player_);
+        float perc_done = play_from_cache_ ? play_player_->getPosition() : libvlc_media_player_get_position(vlc_player_);
+        int64_t t = play_from_cache_ ? play_player_->getTime() : libvlc_media_player_get_time(vlc_player_);
         cob_sound::PlayFeedback feedback;
         feedback.position = perc_done;
         feedback.time = t;
@@ -378,47 +495,119 @@ public:
     pubMarker_.publish(marker);
   }
 
-  bool fade_in()
+  // decodes the wave files of the preload parameter, other formats are played through vlc
+  void preload()
   {
-    if(libvlc_media_player_play(vlc_player_) >= 0)
+    XmlRpc::XmlRpcValue files;
+    if (!nh_.getParam("preload", files))
+      return;
+    if (files.getType() != XmlRpc::XmlRpcValue::TypeArray)
     {
-      if(fade_volume_)
+      ROS_ERROR("Parameter preload has to be a list of file names");
+      return;
+    }
+    for (int i = 0; i < files.size(); i++)
+    {
+      if (files[i].getType() != XmlRpc::XmlRpcValue::TypeString)
+        continue;
+      std::string filename = files[i];
+      boost::shared_ptr<Waveform> wave(new Waveform);
+      std::string error;
+      if (loadWave(filename, *wave, error))
       {
-        while(libvlc_audio_set_volume(vlc_player_,0) != 0)
-          ros::Duration(0.05).sleep();
-        for(int i = 0; i < 100; i+=5)
-        {
-          libvlc_audio_set_volume(vlc_player_,i);
-          ros::Duration(fade_duration_/20.0).sleep();
-        }
+        ROS_INFO("Preloaded %s (%.1f s)", filename.c_str(), wave->duration());
+        preloaded_[filename] = wave;
       }
       else
-      {
-        while(libvlc_audio_set_volume(vlc_player_,100) != 0)
-          ros::Duration(0.05).sleep();
-
-      }
+        ROS_WARN("Could not preload %s, it is played from disk: %s", filename.c_str(), error.c_str());
     }
-    else
+  }
+
+  bool is_playing()
+  {
+    if (play_from_cache_)
+      return play_player_->isPlaying();
+    return libvlc_media_player_is_playing(vlc_player_) == 1;
+  }
+
+  // with fade the sound is faded out and stopped in the background
+  void stop_playback(bool fade)
+  {
+    play_player_->stop(fade && fade_volume_ ? fade_duration_ : 0.0);
+    stop_vlc(fade && fade_volume_);
+  }
+
+  // starts the media on the vlc player, faded in by the fader thread
+  bool play_vlc(libvlc_media_t* media)
+  {
+    boost::mutex::scoped_lock lock(vlc_fade_mutex_);
+    libvlc_media_player_stop(vlc_player_);
+    libvlc_media_player_set_media(vlc_player_, media);
+    if (libvlc_media_player_play(vlc_player_) < 0)
+    {
+      vlc_fade_active_ = false;
       return false;
+    }
+    vlc_fade_from_ = fade_volume_ ? 0 : 100;
+    vlc_fade_to_ = 100;
+    vlc_stop_after_fade_ = false;
+    vlc_fade_start_ = ros::WallTime::now();
+    vlc_fade_active_ = true;
+    vlc_fade_cond_.notify_all();
     return true;
   }
 
-  bool fade_out()
+  void stop_vlc(bool fade)
+  {
+    boost::mutex::scoped_lock lock(vlc_fade_mutex_);
+    if (fade && libvlc_media_player_is_playing(vlc_player_) == 1)
+    {
+      int volume = libvlc_audio_get_volume(vlc_player_);
+      vlc_fade_from_ = volume < 0 ? 100 : volume;
+      vlc_fade_to_ = 0;
+      vlc_stop_after_fade_ = true;
+      vlc_fade_start_ = ros::WallTime::now();
+      vlc_fade_active_ = true;
+      vlc_fade_cond_.notify_all();
+    }
+    else
+    {
+      vlc_fade_active_ = false;
+      libvlc_media_player_stop(vlc_player_);
+    }
+  }
+
+  // sets the interpolated vlc volume every 10 ms while a fade is active.
+  // Until vlc has set up its audio output, setting the volume fails and is repeated.
+  void vlc_fader_thread()
   {
-    int volume  = libvlc_audio_get_volume(vlc_player_);
-    if(libvlc_media_player_is_playing(vlc_player_))
+    boost::mutex::scoped_lock lock(vlc_fade_mutex_);
+    while (!vlc_fader_shutdown_)
     {
-      if(fade_volume_)
+      if (!vlc_fade_active_)
       {
-        for(int i = volume - (volume%5); i >=0; i-=5)
-        {
-          libvlc_audio_set_volume(vlc_player_,i);
-          ros::Duration(fade_duration_/20.0).sleep();
-        }
+        vlc_fade_cond_.wait(lock);
+        continue;
       }
+
+      double progress = (fade_duration_ > 0.0) ? (ros::WallTime::now() - vlc_fade_start_).toSec() / fade_duration_ : 1.0;
+      if (!fade_volume_)
+        progress = 1.0;
+      int volume = vlc_fade_from_ + (int)((vlc_fade_to_ - vlc_fade_from_) * std::min(progress, 1.0));
+      if (libvlc_audio_set_volume(vlc_player_, volume) != 0)
+      {
+        // the fade starts once the audio output exists
+        vlc_fade_start_ = ros::WallTime::now();
+      }
+      else if (progress >= 1.0)
+      {
+        vlc_fade_active_ = false;
+        if (vlc_stop_after_fade_)
+          libvlc_media_player_stop(vlc_player_);
+        continue;
+      }
+      vlc_fade_cond_.timed_wait(lock, boost::posix_time::milliseconds(10));
     }
-    return true;
   }
 
 };
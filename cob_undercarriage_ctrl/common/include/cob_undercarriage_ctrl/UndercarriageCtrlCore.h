@@ -0,0 +1,605 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef UndercarriageCtrlCore_INCLUDEDEF_H
+#define UndercarriageCtrlCore_INCLUDEDEF_H
+
+#include <cob_utilities/MathSup.h>
+
+#include <cmath>
+
+// conversion of the scalar types into each other, FixedPoint.h adds its own overload
+inline double toDouble(double d) { return d; }
+inline double toDouble(float f) { return f; }
+
+/**
+ * Parameters of the undercarriage controller, read from the ini files by UndercarriageCtrlGeom.
+ */
+struct UndercarriageCtrlParams
+{
+	int iNumberOfDrives;
+	double dRadiusWheelMM;
+	double dDistSteerAxisToDriveWheelMM;
+
+	// position of the steering axes in robot coordinates
+	double vdWheelXPosMM[4];
+	double vdWheelYPosMM[4];
+	double vdWheelNeutralPosRad[4];
+	/** Factor between steering motion and steering induced motion of drive wheels
+	 *  subtract from Drive-Wheel Vel to get effective Drive Velocity (Direct Kinematics)
+	 *  add to Drive-Wheel Vel (Inverse Kinematics) to account for coupling when commanding velos
+	 */
+	double vdFactorVel[4];
+
+	double dMaxSteerRateRadpS;
+	double dCmdRateS;
+
+	// Impedance-Ctrlr of the steering angles, see UndercarriageCtrlCore
+	double dSpring;
+	double dDamp;
+	double dVirtM;
+	double dDPhiMax;
+	double dDDPhiMax;
+};
+
+/**
+ * Angle functions of MathSup for any scalar type, with the constants converted once.
+ */
+template <typename T>
+class UndercarriageAngles
+{
+public:
+	UndercarriageAngles() :
+		m_Zero(0.0), m_Pi(MathSup::PI), m_TwoPi(MathSup::TWO_PI), m_HalfPi(MathSup::HALF_PI), m_InvTwoPi(1.0 / MathSup::TWO_PI)
+	{
+	}
+
+	// normalizes to ]-pi,pi], see MathSup::normalizePi()
+	void normalizePi(T& angle) const
+	{
+		using std::ceil;
+		angle -= m_TwoPi * ceil((angle - m_Pi) * m_InvTwoPi);
+	}
+
+	// see MathSup::calcDeltaAng()
+	void calcDeltaAng(const T* pA, const T* pB, T* pDelta, int iNum) const
+	{
+		for (int i = 0; i < iNum; i++)
+		{
+			pDelta[i] = pA[i] - pB[i];
+			normalizePi(pDelta[i]);
+		}
+	}
+
+	// see MathSup::atan4quad()
+	T atan4quad(T y, T x) const
+	{
+		using std::atan;
+		T result;
+
+		if((x == m_Zero) && (y == m_Zero))
+			result = m_Zero;
+		else if((x == m_Zero) && (y > m_Zero))
+			result = m_HalfPi;
+		else if((x == m_Zero) && (y < m_Zero))
+			result = -m_HalfPi;
+		else if((y == m_Zero) && (x > m_Zero))
+			result = m_Zero;
+		else if((y == m_Zero) && (x < m_Zero))
+			result = m_Pi;
+		else
+		{
+			result = atan(y / x);
+			if(x < m_Zero)
+			{
+				if(y > m_Zero)		// Quadrant 2 -> correct
+					result += m_Pi;
+				else			// Quadrant 3 -> correct
+					result -= m_Pi;
+			}
+		}
+		return result;
+	}
+
+	T m_Zero;
+	T m_Pi;
+	T m_TwoPi;
+	T m_HalfPi;
+	T m_InvTwoPi;
+};
+
+/**
+ * Kinematics and steering controller of UndercarriageCtrlGeom for a configurable scalar type.
+ * T is used for the kinematics, which need trigonometric functions and the range of mm and mm/s:
+ * float or double. TCtrl is used for the impedance controller of the steering angles, which only
+ * adds, multiplies and divides bounded angles and rates: float, double or a Q-format FixedPoint
+ * (cob_utilities/FixedPoint.h) with at least 10 integer bits, e.g. FixedPoint<16>.
+ * UndercarriageCtrlGeom runs UndercarriageCtrlCore<double>, the order of the operations is kept so
+ * that it calculates exactly the same values as before.
+ * All state is held in fixed size arrays, no call allocates memory.
+ */
+template <typename T, typename TCtrl = T>
+class UndercarriageCtrlCore
+{
+public:
+	UndercarriageCtrlCore()
+	{
+		m_iNumberOfDrives = 4;
+		m_bEMStopActive = false;
+		m_RadiusWheelMM = T(1.0);
+		m_DistSteerAxisToDriveWheelMM = T(0.0);
+		m_MaxSteerRateRadpS = T(0.0);
+		m_CmdLatencyS = T(0.0);
+
+		// init Prms of Impedance-Ctrlr
+		m_CmdRateS = TCtrl(0.0);
+		m_Spring = TCtrl(10.0);
+		m_Damp = TCtrl(2.5);
+		m_VirtM = TCtrl(0.1);
+		m_DPhiMax = TCtrl(12.0);
+		m_DDPhiMax = TCtrl(100.0);
+
+		m_CmdVelLongMMS = m_CmdVelLatMMS = m_CmdRotRobRadS = m_CmdRotVelRadS = T(0.0);
+		m_VelLongMMS = m_VelLatMMS = m_RotRobRadS = m_RotVelRadS = T(0.0);
+
+		for(int i = 0; i < 4; i++)
+		{
+			m_WheelXPosMM[i] = m_WheelYPosMM[i] = m_FactorVel[i] = T(0.0);
+			m_VelGearDriveRadS[i] = m_VelGearSteerRadS[i] = m_AngGearSteerRad[i] = T(0.0);
+			m_SinAngGearSteer[i] = T(0.0);
+			m_CosAngGearSteer[i] = T(1.0);
+			m_ExWheelXPosMM[i] = m_ExWheelYPosMM[i] = T(0.0);
+			m_VelGearDriveCmdRadS[i] = m_VelGearSteerCmdRadS[i] = m_AngGearSteerCmdRad[i] = T(0.0);
+			m_AngGearSteerTarget1Rad[i] = m_VelGearDriveTarget1RadS[i] = T(0.0);
+			m_AngGearSteerTarget2Rad[i] = m_VelGearDriveTarget2RadS[i] = T(0.0);
+			m_AngGearSteerTargetRad[i] = m_VelGearDriveTargetRadS[i] = T(0.0);
+			m_CtrlVal[i][0] = m_CtrlVal[i][1] = TCtrl(0.0);
+		}
+	}
+
+	/**
+	 * Takes over the parameters, the steering targets start at the neutral positions.
+	 */
+	void init(const UndercarriageCtrlParams& params)
+	{
+		m_iNumberOfDrives = params.iNumberOfDrives;
+		m_RadiusWheelMM = T(params.dRadiusWheelMM);
+		m_DistSteerAxisToDriveWheelMM = T(params.dDistSteerAxisToDriveWheelMM);
+		m_MaxSteerRateRadpS = T(params.dMaxSteerRateRadpS);
+		m_CmdRateS = TCtrl(params.dCmdRateS);
+		m_Spring = TCtrl(params.dSpring);
+		m_Damp = TCtrl(params.dDamp);
+		m_VirtM = TCtrl(params.dVirtM);
+		m_DPhiMax = TCtrl(params.dDPhiMax);
+		m_DDPhiMax = TCtrl(params.dDDPhiMax);
+
+		for(int i = 0; i < 4; i++)
+		{
+			m_WheelXPosMM[i] = T(params.vdWheelXPosMM[i]);
+			m_WheelYPosMM[i] = T(params.vdWheelYPosMM[i]);
+			m_FactorVel[i] = T(params.vdFactorVel[i]);
+
+			// provisorial --> skip interpolation
+			m_AngGearSteerCmdRad[i] = T(params.vdWheelNeutralPosRad[i]);
+			// also Init choosen Target angle
+			m_AngGearSteerTargetRad[i] = T(params.vdWheelNeutralPosRad[i]);
+		}
+
+		// Calculate exact position of wheels in cart. coords in robot coordinate frame
+		calcSteerSinCos();
+		calcExWheelPos();
+	}
+
+	/**
+	 * Sets the desired platform velocity and chooses the steering angle of each wheel (Sollwertvorgabe).
+	 */
+	void setDesiredPltfVelocity(T cmdVelLongMMS, T cmdVelLatMMS, T cmdRotRobRadS, T cmdRotVelRadS)
+	{
+		// declare auxiliary variables
+		T deltaPhi1RAD[4], deltaPhi2RAD[4];	// difference between possible steering angels and current steering angle
+		T deltaPhiCmd1RAD[4], deltaPhiCmd2RAD[4];	// difference between possible steering angels and last target steering angle
+		T weightedDelta1RAD, weightedDelta2RAD; // weighted Summ of the two distance values
+		using std::fabs;
+
+		// copy function parameters to member variables
+		m_CmdVelLongMMS = cmdVelLongMMS;
+		m_CmdVelLatMMS = cmdVelLatMMS;
+		m_CmdRotRobRadS = cmdRotRobRadS;
+		m_CmdRotVelRadS = cmdRotVelRadS;
+
+		calcInverse();
+
+		// Calculate differences between current config to possible set-points for all wheels,
+		// the differences are normalized, so the actual wheel position needs no normalization
+		m_Ang.calcDeltaAng(m_AngGearSteerTarget1Rad, m_AngGearSteerRad, deltaPhi1RAD, 4);
+		m_Ang.calcDeltaAng(m_AngGearSteerTarget2Rad, m_AngGearSteerRad, deltaPhi2RAD, 4);
+		// Calculate differences between last steering target to possible set-points
+		m_Ang.calcDeltaAng(m_AngGearSteerTarget1Rad, m_AngGearSteerTargetRad, deltaPhiCmd1RAD, 4);
+		m_Ang.calcDeltaAng(m_AngGearSteerTarget2Rad, m_AngGearSteerTargetRad, deltaPhiCmd2RAD, 4);
+
+		// determine optimal Pltf-Configuration
+		for (int i = 0; i<4; i++)
+		{
+			// "fitness criteria" to choose optimal set point:
+			// accumulated (+ weighted) difference to the current config. and to the last target,
+			// so the wheels don't switch permanently if the next target is about PI/2 from the current config.
+			// The wheels are independent, so this per wheel choice also settles the platform fastest. Weighting
+			// the steering velocity of a turning wheel (momentum of the impedance controller) chose worse set
+			// points in the quick direction changes of undercarriage_benchmark.
+			weightedDelta1RAD = T(0.6)*fabs(deltaPhi1RAD[i]) + T(0.4)*fabs(deltaPhiCmd1RAD[i]);
+			weightedDelta2RAD = T(0.6)*fabs(deltaPhi2RAD[i]) + T(0.4)*fabs(deltaPhiCmd2RAD[i]);
+
+			// check which set point "minimizes fitness criteria"
+			if (weightedDelta1RAD <= weightedDelta2RAD)
+			{
+				// Target1 is "optimal"
+				m_VelGearDriveTargetRadS[i] = m_VelGearDriveTarget1RadS[i];
+				m_AngGearSteerTargetRad[i] = m_AngGearSteerTarget1Rad[i];
+			}
+			else
+			{
+				// Target2 is "optimal"
+				m_VelGearDriveTargetRadS[i] = m_VelGearDriveTarget2RadS[i];
+				m_AngGearSteerTargetRad[i] = m_AngGearSteerTarget2Rad[i];
+			}
+		}
+	}
+
+	/**
+	 * Sets the measured wheel states (Istwerte) and calculates the direct kinematics.
+	 */
+	void setActualWheelValues(const T* pVelGearDriveRadS, const T* pVelGearSteerRadS, const T* pAngGearSteerRad)
+	{
+		for(int i = 0; i < 4; i++)
+		{
+			m_VelGearDriveRadS[i] = pVelGearDriveRadS[i];
+			m_VelGearSteerRadS[i] = pVelGearSteerRadS[i];
+			m_AngGearSteerRad[i] = pAngGearSteerRad[i];
+		}
+
+		// evaluate trigonometry of the steering angles once for all following calculations
+		calcSteerSinCos();
+
+		// calc exact Wheel Positions (taking into account lever arm)
+		calcExWheelPos();
+
+		// Peform calculation of direct kinematics (approx.) based on corrected Wheel Positions
+		calcDirect();
+	}
+
+	/**
+	 * Performs one discrete control step of the steering angles, unless the EM-Stop is active.
+	 */
+	void calcControlStep()
+	{
+		if(m_bEMStopActive)
+			return;
+
+		// check if zero movement commanded -> keep orientation of wheels, set steer velocity to zero
+		if ((m_CmdVelLongMMS == T(0.0)) && (m_CmdVelLatMMS == T(0.0)) && (m_CmdRotRobRadS == T(0.0)) && (m_CmdRotVelRadS == T(0.0)))
+		{
+			for(int i=0; i<4; i++)
+			{
+				m_VelGearDriveCmdRadS[i] = T(0.0);		// set velocity for drives to zero
+				m_VelGearSteerCmdRadS[i] = T(0.0);		// set velocity for steers to zero
+
+				// set internal states of controller to zero
+				m_CtrlVal[i][0] = TCtrl(0.0);
+				m_CtrlVal[i][1] = TCtrl(0.0);
+			}
+			return;
+		}
+
+		// declare auxilliary variables
+		TCtrl angCmdRAD[4];
+		TCtrl predPosWheelRAD[4];
+		TCtrl deltaPhiRAD[4];
+		TCtrl forceDamp, forceProp, accCmd, velCmdInt; // PI- and Impedance-Ctrl
+		using std::fabs;
+
+		for (int i=0; i<4; i++)
+		{
+			// provisorial --> skip interpolation and always take Target
+			m_VelGearDriveCmdRadS[i] = m_VelGearDriveTargetRadS[i];
+			m_AngGearSteerCmdRad[i] = m_AngGearSteerTargetRad[i];
+
+			// Predict Wheel Position at the time the commands take effect (measured steering rate times latency)
+			angCmdRAD[i] = TCtrl(toDouble(m_AngGearSteerCmdRad[i]));
+			predPosWheelRAD[i] = TCtrl(toDouble(m_AngGearSteerRad[i] + m_VelGearSteerRadS[i] * m_CmdLatencyS));
+		}
+		// the normalized difference to the command is calculated for all wheels at once
+		m_AngCtrl.calcDeltaAng(angCmdRAD, predPosWheelRAD, deltaPhiRAD, 4);
+
+		for (int i = 0; i<4; i++)
+		{
+			// Impedance-Ctrl
+			// Calculate resulting desired forces, velocities
+			forceDamp = - m_Damp * m_CtrlVal[i][1];
+			forceProp = m_Spring * deltaPhiRAD[i];
+			accCmd = (forceDamp + forceProp) / m_VirtM;
+			if (accCmd > m_DDPhiMax)
+			{
+				accCmd = m_DDPhiMax;
+			}
+			else if (accCmd < -m_DDPhiMax)
+			{
+				accCmd = -m_DDPhiMax;
+			}
+			velCmdInt = m_CtrlVal[i][1] + m_CmdRateS * accCmd;
+			if (velCmdInt > m_DPhiMax)
+			{
+				velCmdInt = m_DPhiMax;
+			}
+			else if (velCmdInt < -m_DPhiMax)
+			{
+				velCmdInt = -m_DPhiMax;
+			}
+			// Store internal ctrlr-states
+			m_CtrlVal[i][0] = deltaPhiRAD[i];
+			m_CtrlVal[i][1] = velCmdInt;
+			// set outputs
+			m_VelGearSteerCmdRadS[i] = T(toDouble(velCmdInt));
+
+			// Check if Steeringvelocity overgo maximum allowed rates.
+			if(fabs(m_VelGearSteerCmdRadS[i]) > m_MaxSteerRateRadpS)
+			{
+				if (m_VelGearSteerCmdRadS[i] > T(0.0))
+					m_VelGearSteerCmdRadS[i] = m_MaxSteerRateRadpS;
+				else
+					m_VelGearSteerCmdRadS[i] = -m_MaxSteerRateRadpS;
+			}
+		}
+
+		// Correct Driving-Wheel-Velocity, because of coupling and axis-offset
+		for (int i = 0; i<4; i++)
+		{
+			m_VelGearDriveCmdRadS[i] += m_VelGearSteerCmdRadS[i] * m_FactorVel[i];
+		}
+	}
+
+	/**
+	 * Sets the EM-Stop flag, an active EM-Stop resets the controller and its outputs to zero.
+	 */
+	void setEMStopActive(bool bEMStopActive)
+	{
+		m_bEMStopActive = bEMStopActive;
+
+		if(m_bEMStopActive)
+		{
+			for(int i=0; i<4; i++)
+			{
+				m_CtrlVal[i][0] = TCtrl(0.0);
+				m_CtrlVal[i][1] = TCtrl(0.0);
+				m_VelGearDriveCmdRadS[i] = T(0.0);
+				m_VelGearSteerCmdRadS[i] = T(0.0);
+			}
+		}
+	}
+
+	/**
+	 * Sets the delay between measurement and actuation for the prediction of the steering angles (0 = off).
+	 */
+	void setCmdLatency(T cmdLatencyS)
+	{
+		m_CmdLatencyS = (cmdLatencyS < T(0.0)) ? T(0.0) : cmdLatencyS;
+	}
+
+	// calculates the inverse kinematics (Target1/2) without controller
+	void calcInverse()
+	{
+		// help variable to store velocities of the steering axis in mm/s
+		T axVelXRobMMS, axVelYRobMMS;
+		using std::sqrt;
+
+		// check if zero movement commanded -> keep orientation of wheels, set wheel velocity to zero
+		if((m_CmdVelLongMMS == T(0.0)) && (m_CmdVelLatMMS == T(0.0)) && (m_CmdRotRobRadS == T(0.0)) && (m_CmdRotVelRadS == T(0.0)))
+		{
+			for(int i = 0; i<4; i++)
+			{
+				m_AngGearSteerTarget1Rad[i] = m_AngGearSteerRad[i];
+				m_VelGearDriveTarget1RadS[i] = T(0.0);
+				m_AngGearSteerTarget2Rad[i] = m_AngGearSteerRad[i];
+				m_VelGearDriveTarget2RadS[i] = T(0.0);
+			}
+			return;
+		}
+
+		// calculate sets of possible Steering Angle // Drive-Velocity combinations
+		for (int i = 0; i<4; i++)
+		{
+			// calculate velocity and direction of single wheel motion
+			// Translational Portion
+			axVelXRobMMS = m_CmdVelLongMMS;
+			axVelYRobMMS = m_CmdVelLatMMS;
+			// Rotational Portion (cross product of rotation and wheel position)
+			axVelXRobMMS += m_CmdRotRobRadS * -m_ExWheelYPosMM[i];
+			axVelYRobMMS += m_CmdRotRobRadS * m_ExWheelXPosMM[i];
+
+			// Wheel has to move in direction of resulting velocity vector of steering axis
+			m_AngGearSteerTarget1Rad[i] = m_Ang.atan4quad(axVelYRobMMS, axVelXRobMMS);
+			// calculate corresponding angle in opposite direction (+180 degree)
+			m_AngGearSteerTarget2Rad[i] = m_AngGearSteerTarget1Rad[i] + m_Ang.m_Pi;
+			m_Ang.normalizePi(m_AngGearSteerTarget2Rad[i]);
+
+			// calculate absolute value of rotational rate of driving wheels in rad/s
+			m_VelGearDriveTarget1RadS[i] = sqrt( (axVelXRobMMS * axVelXRobMMS) +
+								   (axVelYRobMMS * axVelYRobMMS) ) / m_RadiusWheelMM;
+			// now adapt to direction (forward/backward) of wheel
+			m_VelGearDriveTarget2RadS[i] = - m_VelGearDriveTarget1RadS[i];
+		}
+	}
+
+	// results of the direct kinematics
+	T getVelLongMMS() const { return m_VelLongMMS; }
+	T getVelLatMMS() const { return m_VelLatMMS; }
+	T getRotRobRadS() const { return m_RotRobRadS; }
+	T getRotVelRadS() const { return m_RotVelRadS; }
+
+	// commanded platform velocity
+	T getCmdVelLongMMS() const { return m_CmdVelLongMMS; }
+	T getCmdVelLatMMS() const { return m_CmdVelLatMMS; }
+	T getCmdRotRobRadS() const { return m_CmdRotRobRadS; }
+	T getCmdRotVelRadS() const { return m_CmdRotVelRadS; }
+
+	// set points of the wheels (including controller), 4 values each
+	const T* getVelGearDriveCmdRadS() const { return m_VelGearDriveCmdRadS; }
+	const T* getVelGearSteerCmdRadS() const { return m_VelGearSteerCmdRadS; }
+	const T* getAngGearSteerCmdRad() const { return m_AngGearSteerCmdRad; }
+
+	// result of calcInverse() for the first alternative, 4 values each
+	const T* getVelGearDriveTarget1RadS() const { return m_VelGearDriveTarget1RadS; }
+	const T* getAngGearSteerTarget1Rad() const { return m_AngGearSteerTarget1Rad; }
+
+private:
+	UndercarriageAngles<T> m_Ang;
+	UndercarriageAngles<TCtrl> m_AngCtrl;
+
+	int m_iNumberOfDrives;
+	bool m_bEMStopActive;
+
+	T m_RadiusWheelMM;
+	T m_DistSteerAxisToDriveWheelMM;
+	T m_MaxSteerRateRadpS;
+	T m_WheelXPosMM[4];
+	T m_WheelYPosMM[4];
+	T m_FactorVel[4];
+	T m_CmdLatencyS;
+
+	/** Impedance-Ctrlr Prms
+	 *  -> model Stiffness via Spring-Damper-Modell
+	 *  m_Spring	Spring-constant (elasticity)
+	 *  m_Damp		Damping coefficient (also prop. for Velocity Feedforward)
+	 *  m_VirtM		Virtual Mass of Spring-Damper System
+	 *  m_DPhiMax	maximum angular velocity (cut-off)
+	 *  m_DDPhiMax	maximum angular acceleration (cut-off)
+	 */
+	TCtrl m_CmdRateS;
+	TCtrl m_Spring, m_Damp, m_VirtM, m_DPhiMax, m_DDPhiMax;
+	/** internal controller states of all wheels
+	 *  m_CtrlVal[iWheelNr][0]: previous deltaPhi e(k-1)
+	 *  m_CtrlVal[iWheelNr][1]: previous Commanded Velocity u(k-1)
+	 */
+	TCtrl m_CtrlVal[4][2];
+
+	// Actual Values for PltfMovement (calculated from Actual Wheelspeeds)
+	T m_VelLongMMS, m_VelLatMMS, m_RotRobRadS, m_RotVelRadS;
+
+	// Actual Wheelspeed (read from Motor-Ctrls) and trigonometry of the steering angles
+	T m_VelGearDriveRadS[4];
+	T m_VelGearSteerRadS[4];
+	T m_AngGearSteerRad[4];
+	T m_SinAngGearSteer[4];
+	T m_CosAngGearSteer[4];
+
+	// Exact Position of the Wheels' itself in robot coordinates
+	T m_ExWheelXPosMM[4];
+	T m_ExWheelYPosMM[4];
+
+	// Desired Pltf-Movement
+	T m_CmdVelLongMMS, m_CmdVelLatMMS, m_CmdRotRobRadS, m_CmdRotVelRadS;
+
+	// Desired Wheelspeeds set to ELMO-Ctrl's
+	T m_VelGearDriveCmdRadS[4];
+	T m_VelGearSteerCmdRadS[4];
+	T m_AngGearSteerCmdRad[4];
+
+	// Target Wheelspeed and -angle (Inverse without controle), alternative 1, 2 (+/- PI) and the choosen one
+	T m_AngGearSteerTarget1Rad[4];
+	T m_VelGearDriveTarget1RadS[4];
+	T m_AngGearSteerTarget2Rad[4];
+	T m_VelGearDriveTarget2RadS[4];
+	T m_AngGearSteerTargetRad[4];
+	T m_VelGearDriveTargetRadS[4];
+
+	// calculate sine and cosine of all steering angles
+	void calcSteerSinCos()
+	{
+		using std::sin;
+		using std::cos;
+
+		// sin and cos of the same angle are computed together (sincos) by the compiler
+		for(int i = 0; i<4; i++)
+		{
+			m_SinAngGearSteer[i] = sin(m_AngGearSteerRad[i]);
+			m_CosAngGearSteer[i] = cos(m_AngGearSteerRad[i]);
+		}
+	}
+
+	// calculate Exact Wheel Position in robot coordinates (taking into account steering offset of wheels)
+	void calcExWheelPos()
+	{
+		for(int i = 0; i<4; i++)
+		{
+			m_ExWheelXPosMM[i] = m_WheelXPosMM[i] + m_DistSteerAxisToDriveWheelMM * m_SinAngGearSteer[i];
+			m_ExWheelYPosMM[i] = m_WheelYPosMM[i] - m_DistSteerAxisToDriveWheelMM * m_CosAngGearSteer[i];
+		}
+	}
+
+	// calculate direct kinematics
+	void calcDirect()
+	{
+		T velXRobMMS = T(0.0);		// Robot-Velocity in x-Direction (longitudinal) in mm/s (in Robot-Coordinateframe)
+		T velYRobMMS = T(0.0);		// Robot-Velocity in y-Direction (lateral) in mm/s (in Robot-Coordinateframe)
+		T rotRobRADPS = T(0.0);		// Robot-Rotation-Rate in rad/s (in Robot-Coordinateframe)
+		T diffXMM, diffYMM;			// Difference in X/Y-Coordinate of two wheels in mm
+		T relDistWheelsSqrMM;		// squared distance of two wheels in mm^2
+		T relVelWheel1MMS, relVelWheel2MMS;	// Velocity of the wheels perpendicular to the linking axis, times the distance of the wheels
+		T velWheelMMS[4];			// Wheel-Velocities (all Wheels) in mm/s
+
+		// calculate corrected wheel velocities
+		for(int i = 0; i<m_iNumberOfDrives; i++)
+		{
+			// calc effective Driving-Velocity
+			velWheelMMS[i] = m_RadiusWheelMM * (m_VelGearDriveRadS[i] - m_FactorVel[i]* m_VelGearSteerRadS[i]);
+		}
+
+		// calculate rotational rate of robot and current "virtual" axis between all wheels
+		// the velocity component of each wheel perpendicular to the linking axis is
+		// v * sin(PhiWheel - PhiAxis) = v * (sin(PhiWheel) * DiffX - cos(PhiWheel) * DiffY) / Dist,
+		// so no angle of the linking axis is needed; the last axis links the last and the first wheel
+		for(int i = 0; i < m_iNumberOfDrives; i++)
+		{
+			int j = (i + 1) % m_iNumberOfDrives;
+
+			diffXMM = m_ExWheelXPosMM[j] - m_ExWheelXPosMM[i];
+			diffYMM = m_ExWheelYPosMM[j] - m_ExWheelYPosMM[i];
+			relDistWheelsSqrMM = diffXMM*diffXMM + diffYMM*diffYMM;
+
+			relVelWheel1MMS = velWheelMMS[i] * (m_SinAngGearSteer[i] * diffXMM - m_CosAngGearSteer[i] * diffYMM);
+			relVelWheel2MMS = velWheelMMS[j] * (m_SinAngGearSteer[j] * diffXMM - m_CosAngGearSteer[j] * diffYMM);
+
+			rotRobRADPS += (relVelWheel2MMS - relVelWheel1MMS) / relDistWheelsSqrMM;
+		}
+
+		// calculate linear velocity of robot
+		for(int i = 0; i<m_iNumberOfDrives; i++)
+		{
+			velXRobMMS += velWheelMMS[i]*m_CosAngGearSteer[i];
+			velYRobMMS += velWheelMMS[i]*m_SinAngGearSteer[i];
+		}
+
+		// assign rotational velocities for output
+		m_RotRobRadS = rotRobRADPS / T(m_iNumberOfDrives);
+		m_RotVelRadS = T(0.0); // currently not used to represent 3rd degree of freedom -> set to zero
+
+		// assign linear velocity of robot for output
+		m_VelLongMMS = velXRobMMS / T(m_iNumberOfDrives);
+		m_VelLatMMS = velYRobMMS / T(m_iNumberOfDrives);
+	}
+};
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Micro-benchmarks of one control step of the undercarriage controller.
+ *
+ * usage: undercarriage_micro_benchmark [--ini_directory=dir] [--filter=regex] [--format=console|json] [--out=file.json],
+ *        see MicroBenchmark.h
+ *
+ * The platform commands and wheel states are a closed-loop drive with ideal wheels over translations,
+ * rotations and changes of direction, computed beforehand. The ini directory holds Platform.ini and
+ * MotionCtrl.ini of the robot, without it a 4 wheel platform with the default controller parameters
+ * is used and the benchmark of UndercarriageCtrlGeom, which reads the ini files itself, is skipped.
+ */
+
+#include <cob_undercarriage_ctrl/UndercarriageCtrlGeom.h>
+#include <cob_utilities/FixedPoint.h>
+#include <cob_utilities/MicroBenchmark.h>
+
+#include <math.h>
+#include <string>
+#include <vector>
+
+static const int NUM_WHEELS = 4;
+static const int NUM_STEPS = 2000;
+static const double CYCLE_TIME = 0.02;
+
+// inputs of one step: vx_mms vy_mms w_rads, drive velocities, steering velocities, steering angles
+static const int NUM_INPUTS = 3 + 3*NUM_WHEELS;
+
+static std::string getIniDirectory(const MicroBenchmark::State &state)
+{
+	std::string ini_directory = state.getArg("ini_directory", "");
+	if(!ini_directory.empty() && ini_directory[ini_directory.size()-1] != '/')
+		ini_directory += "/";
+	return ini_directory;
+}
+
+static UndercarriageCtrlParams getParams(const std::string &ini_directory)
+{
+	if(!ini_directory.empty())
+	{
+		UndercarriageCtrlGeom ctrl(ini_directory);
+		ctrl.InitUndercarriageCtrl();
+		return ctrl.getParams();
+	}
+
+	UndercarriageCtrlParams params;
+	params.iNumberOfDrives = NUM_WHEELS;
+	params.dRadiusWheelMM = 73;
+	params.dDistSteerAxisToDriveWheelMM = 15;
+	const double x[NUM_WHEELS] = { 260, -260, -260, 260 };
+	const double y[NUM_WHEELS] = { 225, 225, -225, -225 };
+	for(int i=0; i<NUM_WHEELS; i++)
+	{
+		params.vdWheelXPosMM[i] = x[i];
+		params.vdWheelYPosMM[i] = y[i];
+		params.vdWheelNeutralPosRad[i] = 0.0;
+		params.vdFactorVel[i] = params.dDistSteerAxisToDriveWheelMM / params.dRadiusWheelMM;
+	}
+	params.dMaxSteerRateRadpS = 10.0;
+	params.dCmdRateS = CYCLE_TIME;
+	params.dSpring = 10.0;
+	params.dDamp = 2.5;
+	params.dVirtM = 0.1;
+	params.dDPhiMax = 12.0;
+	params.dDDPhiMax = 100.0;
+	return params;
+}
+
+// closed loop with ideal wheels, the steering angles integrate the commanded steering velocities
+static std::vector<double> createTrace(const UndercarriageCtrlParams &params)
+{
+	std::vector<double> trace(NUM_STEPS * NUM_INPUTS, 0.0);
+	UndercarriageCtrlCore<double> ctrl;
+	ctrl.init(params);
+
+	double wheels[3*NUM_WHEELS] = { 0 };
+	for(int s=0; s<NUM_STEPS; s++)
+	{
+		double *in = &trace[s * NUM_INPUTS];
+		const double t = s * CYCLE_TIME;
+		in[0] = 400 * cos(0.3 * t);
+		in[1] = 300 * sin(0.7 * t);
+		in[2] = 0.4 * sin(0.2 * t);
+		for(int i=0; i<3*NUM_WHEELS; i++)
+			in[3 + i] = wheels[i];
+
+		ctrl.setActualWheelValues(in + 3, in + 3 + NUM_WHEELS, in + 3 + 2*NUM_WHEELS);
+		ctrl.setDesiredPltfVelocity(in[0], in[1], in[2], 0.0);
+		ctrl.calcControlStep();
+		for(int i=0; i<NUM_WHEELS; i++)
+		{
+			wheels[i] = ctrl.getVelGearDriveCmdRadS()[i];
+			wheels[NUM_WHEELS + i] = ctrl.getVelGearSteerCmdRadS()[i];
+			wheels[2*NUM_WHEELS + i] += ctrl.getVelGearSteerCmdRadS()[i] * CYCLE_TIME;
+		}
+	}
+	return trace;
+}
+
+// UndercarriageCtrlCore<T, TCtrl>::calcControlStep with the inputs of the node
+template <typename T, typename TCtrl>
+static void runCore(MicroBenchmark::State &state)
+{
+	const UndercarriageCtrlParams params = getParams(getIniDirectory(state));
+	const std::vector<double> trace = createTrace(params);
+	// inputs converted beforehand, so only the controller is measured
+	const std::vector<T> inputs(trace.begin(), trace.end());
+
+	UndercarriageCtrlCore<T, TCtrl> ctrl;
+	ctrl.init(params);
+	size_t s = 0;
+	while(state.keepRunning())
+	{
+		const T *in = &inputs[s * NUM_INPUTS];
+		ctrl.setActualWheelValues(in + 3, in + 3 + NUM_WHEELS, in + 3 + 2*NUM_WHEELS);
+		ctrl.setDesiredPltfVelocity(in[0], in[1], in[2], T(0.0));
+		ctrl.calcControlStep();
+		s = (s + 1) % NUM_STEPS;
+	}
+}
+
+static void Undercarriage_CalcControlStepDouble(MicroBenchmark::State &state)
+{
+	runCore<double, double>(state);
+}
+MICRO_BENCHMARK(Undercarriage_CalcControlStepDouble);
+
+static void Undercarriage_CalcControlStepFloat(MicroBenchmark::State &state)
+{
+	runCore<float, float>(state);
+}
+MICRO_BENCHMARK(Undercarriage_CalcControlStepFloat);
+
+static void Undercarriage_CalcControlStepFloatQ16(MicroBenchmark::State &state)
+{
+	runCore<float, FixedPoint<16> >(state);
+}
+MICRO_BENCHMARK(Undercarriage_CalcControlStepFloatQ16);
+
+// the complete step of the node through UndercarriageCtrlGeom, including the direct kinematics
+static void Undercarriage_GeomStep(MicroBenchmark::State &state)
+{
+	const std::string ini_directory = getIniDirectory(state);
+	if(ini_directory.empty())
+	{
+		state.skip("needs --ini_directory");
+		return;
+	}
+	const std::vector<double> trace = createTrace(getParams(ini_directory));
+
+	UndercarriageCtrlGeom ctrl(ini_directory);
+	ctrl.InitUndercarriageCtrl();
+	std::vector<double> vel_drive(NUM_WHEELS), vel_steer(NUM_WHEELS), dlt_ang_drive(NUM_WHEELS, 0.0), ang_steer(NUM_WHEELS);
+	std::vector<double> cmd_drive(NUM_WHEELS), cmd_steer(NUM_WHEELS), cmd_ang(NUM_WHEELS);
+	double vx, vy, w, dummy, delta_x, delta_y, delta_w;
+	size_t s = 0;
+	while(state.keepRunning())
+	{
+		const double *in = &trace[s * NUM_INPUTS];
+		vel_drive.assign(in + 3, in + 3 + NUM_WHEELS);
+		vel_steer.assign(in + 3 + NUM_WHEELS, in + 3 + 2*NUM_WHEELS);
+		ang_steer.assign(in + 3 + 2*NUM_WHEELS, in + 3 + 3*NUM_WHEELS);
+		ctrl.SetActualWheelValues(vel_drive, vel_steer, dlt_ang_drive, ang_steer);
+		ctrl.SetDesiredPltfVelocity(in[0], in[1], in[2], 0.0);
+		ctrl.GetNewCtrlStateSteerDriveSetValues(cmd_drive, cmd_steer, cmd_ang, vx, vy, w, dummy);
+		ctrl.GetActualPltfVelocity(delta_x, delta_y, delta_w, dummy, vx, vy, w, dummy);
+		s = (s + 1) % NUM_STEPS;
+	}
+}
+MICRO_BENCHMARK(Undercarriage_GeomStep);
+
+MICRO_BENCHMARK_MAIN()
@@ -0,0 +1,417 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Runs UndercarriageCtrlGeom offline on a trace of platform commands and wheel states.
+ *
+ * usage: undercarriage_benchmark ini_directory [-t trace.txt] [-r golden.txt | -c golden.txt] [-e tolerance] [-l latency_s]
+ *
+ * The ini directory holds Platform.ini and MotionCtrl.ini of the robot. Each line of the trace is one
+ * control step: vx_mms vy_mms w_rads, then the drive velocities, steering velocities, drive angle
+ * increments and steering angles of the 4 wheels as passed to SetActualWheelValues (19 columns,
+ * '#' starts a comment). Without a trace, a closed-loop drive over translations, rotations, a
+ * reversal and quick changes of direction is simulated, with wheels that follow the commands ideally.
+ * The mean deviation of the platform velocity from the command is reported for it.
+ *
+ * Every step calls SetActualWheelValues, SetDesiredPltfVelocity, GetNewCtrlStateSteerDriveSetValues
+ * and GetActualPltfVelocity, like the node. Reports the time and the heap allocations per step.
+ * The outputs of each step (drive velocities, steering velocities, steering angles and the platform
+ * velocity of the direct kinematics) are written to a golden file with -r, or compared with one
+ * with -c. A deviation larger than tolerance * (1 + |golden value|) is reported, the exit code is 2.
+ *
+ * The same trace is run through UndercarriageCtrlCore with single precision kinematics and a single
+ * precision or Q15.16 fixed point steering controller, their time per step and largest deviation
+ * from the double precision results are reported.
+ */
+
+#include <cob_undercarriage_ctrl/UndercarriageCtrlGeom.h>
+#include <cob_utilities/FixedPoint.h>
+#include <cob_utilities/IniFile.h>
+#include <cob_utilities/MicroBenchmark.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <vector>
+
+MICRO_BENCHMARK_ALLOCATION_COUNTER()
+
+static const int NUM_WHEELS = 4;
+
+struct Step
+{
+	double cmd[3];
+	std::vector<double> vel_drive;
+	std::vector<double> vel_steer;
+	std::vector<double> dlt_ang_drive;
+	std::vector<double> ang_steer;
+
+	Step() : vel_drive(NUM_WHEELS, 0.0), vel_steer(NUM_WHEELS, 0.0), dlt_ang_drive(NUM_WHEELS, 0.0), ang_steer(NUM_WHEELS, 0.0)
+	{
+		cmd[0] = cmd[1] = cmd[2] = 0.0;
+	}
+};
+
+// outputs of one step: drive velocities, steering velocities, steering angles, vx, vy, w
+static const int NUM_OUTPUTS = 3*NUM_WHEELS + 3;
+
+struct Outputs
+{
+	std::vector<double> vel_drive;
+	std::vector<double> vel_steer;
+	std::vector<double> ang_steer;
+
+	Outputs() : vel_drive(NUM_WHEELS, 0.0), vel_steer(NUM_WHEELS, 0.0), ang_steer(NUM_WHEELS, 0.0) {}
+};
+
+// runs one step like the node, the results are stored in out[0..NUM_OUTPUTS-1]
+static void runStep(UndercarriageCtrlGeom &ctrl, const Step &step, Outputs &outputs, double *out)
+{
+	double vx, vy, w, dummy;
+	double delta_x, delta_y, delta_w;
+
+	ctrl.SetActualWheelValues(step.vel_drive, step.vel_steer, step.dlt_ang_drive, step.ang_steer);
+	ctrl.SetDesiredPltfVelocity(step.cmd[0], step.cmd[1], step.cmd[2], 0.0);
+	ctrl.GetNewCtrlStateSteerDriveSetValues(outputs.vel_drive, outputs.vel_steer, outputs.ang_steer, vx, vy, w, dummy);
+	ctrl.GetActualPltfVelocity(delta_x, delta_y, delta_w, dummy, vx, vy, w, dummy);
+
+	for(int i=0; i<NUM_WHEELS; i++)
+	{
+		out[i] = outputs.vel_drive[i];
+		out[NUM_WHEELS + i] = outputs.vel_steer[i];
+		out[2*NUM_WHEELS + i] = outputs.ang_steer[i];
+	}
+	out[3*NUM_WHEELS] = vx;
+	out[3*NUM_WHEELS + 1] = vy;
+	out[3*NUM_WHEELS + 2] = w;
+}
+
+// platform command of the simulated drive at time t, in mm/s and rad/s
+static void simulatedCmd(double t, double *cmd)
+{
+	cmd[0] = cmd[1] = cmd[2] = 0.0;
+	if(t < 1.0)
+		return;
+	if(t < 4.0)
+		cmd[0] = 500;
+	else if(t < 7.0)
+		cmd[1] = 300;
+	else if(t < 10.0)
+		cmd[2] = 0.5;
+	else if(t < 14.0)
+	{
+		cmd[0] = 400;
+		cmd[2] = 0.4;
+	}
+	else if(t < 17.0)
+		// reversal, the wheels turn to the opposite angle or drive backwards
+		cmd[0] = -400;
+	else if(t < 20.0)
+	{
+		cmd[0] = 200;
+		cmd[1] = 300 * sin(2 * M_PI * 0.5 * (t - 17.0));
+	}
+	else if(t < 23.0)
+	{
+		// the direction jumps by 100 deg while the wheels are still turning, each wheel can turn on
+		// or turn back to the opposite angle
+		const double direction = 1.75 * floor((t - 20.0) / 0.25);
+		cmd[0] = 300 * cos(direction);
+		cmd[1] = 300 * sin(direction);
+	}
+}
+
+// closed loop with ideal wheels: steering angles integrate the commanded steering velocities.
+// Reports the mean deviation of the platform velocity from the command.
+static void simulateTrace(const std::string &ini_directory, double cycle_time, double latency, std::vector<Step> &trace)
+{
+	double error_trans = 0;
+	double error_rot = 0;
+
+	UndercarriageCtrlGeom ctrl(ini_directory);
+	ctrl.InitUndercarriageCtrl();
+	ctrl.setCmdLatency(latency);
+
+	Outputs outputs;
+	double out[NUM_OUTPUTS];
+	Step step;
+	for(double t = 0; t < 24.0; t += cycle_time)
+	{
+		simulatedCmd(t, step.cmd);
+		trace.push_back(step);
+		runStep(ctrl, step, outputs, out);
+		error_trans += sqrt(pow(out[3*NUM_WHEELS] - step.cmd[0], 2) + pow(out[3*NUM_WHEELS + 1] - step.cmd[1], 2));
+		error_rot += fabs(out[3*NUM_WHEELS + 2] - step.cmd[2]);
+
+		for(int i=0; i<NUM_WHEELS; i++)
+		{
+			step.vel_drive[i] = outputs.vel_drive[i];
+			step.vel_steer[i] = outputs.vel_steer[i];
+			step.dlt_ang_drive[i] = outputs.vel_drive[i] * cycle_time;
+			step.ang_steer[i] += outputs.vel_steer[i] * cycle_time;
+		}
+	}
+
+	std::cout << "tracking:    mean platform velocity error " << error_trans / trace.size() << " mm/s, "
+			<< error_rot / trace.size() << " rad/s" << std::endl;
+}
+
+// runs the trace through UndercarriageCtrlCore<T, TCtrl> and compares the outputs with the double precision results
+template <typename T, typename TCtrl>
+static void compareScalarType(const char *name, const UndercarriageCtrlParams &params, double latency,
+		const std::vector<Step> &trace, const std::vector<double> &reference)
+{
+	// inputs converted beforehand, so only the controller is timed
+	std::vector<T> inputs(trace.size() * 15);
+	for(size_t s=0; s<trace.size(); s++)
+	{
+		T *in = &inputs[s * 15];
+		for(int i=0; i<3; i++)
+			in[i] = T(trace[s].cmd[i]);
+		for(int i=0; i<NUM_WHEELS; i++)
+		{
+			in[3 + i] = T(trace[s].vel_drive[i]);
+			in[3 + NUM_WHEELS + i] = T(trace[s].vel_steer[i]);
+			in[3 + 2*NUM_WHEELS + i] = T(trace[s].ang_steer[i]);
+		}
+	}
+
+	std::vector<double> results(trace.size() * NUM_OUTPUTS);
+	const int repetitions = 100;
+	double elapsed = 0;
+	for(int r=0; r<repetitions; r++)
+	{
+		UndercarriageCtrlCore<T, TCtrl> ctrl;
+		ctrl.init(params);
+		ctrl.setCmdLatency(T(latency));
+
+		const double start = MicroBenchmark::getRealTime();
+		for(size_t s=0; s<trace.size(); s++)
+		{
+			const T *in = &inputs[s * 15];
+			ctrl.setActualWheelValues(in + 3, in + 3 + NUM_WHEELS, in + 3 + 2*NUM_WHEELS);
+			ctrl.setDesiredPltfVelocity(in[0], in[1], in[2], T(0.0));
+			ctrl.calcControlStep();
+
+			double *out = &results[s * NUM_OUTPUTS];
+			for(int i=0; i<NUM_WHEELS; i++)
+			{
+				out[i] = ctrl.getVelGearDriveCmdRadS()[i];
+				out[NUM_WHEELS + i] = ctrl.getVelGearSteerCmdRadS()[i];
+				out[2*NUM_WHEELS + i] = ctrl.getAngGearSteerCmdRad()[i];
+			}
+			out[3*NUM_WHEELS] = ctrl.getVelLongMMS();
+			out[3*NUM_WHEELS + 1] = ctrl.getVelLatMMS();
+			out[3*NUM_WHEELS + 2] = ctrl.getRotRobRadS();
+		}
+		elapsed += MicroBenchmark::getRealTime() - start;
+	}
+
+	// largest deviation of the drive velocities, steering velocities, steering angles and platform velocity
+	double max_error[4] = { 0, 0, 0, 0 };
+	for(size_t i=0; i<results.size(); i++)
+	{
+		const int group = std::min(int(i % NUM_OUTPUTS) / NUM_WHEELS, 3);
+		double error = results[i] - reference[i];
+		if(group == 2)
+			MathSup::normalizePi(error);
+		max_error[group] = std::max(max_error[group], fabs(error));
+	}
+
+	std::cout << name << 1e9*elapsed/(double(repetitions) * trace.size()) << " ns per step, max deviation: drive "
+			<< max_error[0] << " rad/s, steer " << max_error[1] << " rad/s, angle " << max_error[2] << " rad, platform "
+			<< max_error[3] << " mm/s" << std::endl;
+}
+
+static bool readTrace(const char *file_name, std::vector<Step> &trace)
+{
+	std::ifstream file(file_name);
+	if(!file)
+	{
+		std::cout << "could not open " << file_name << std::endl;
+		return false;
+	}
+
+	std::string line;
+	int line_nr = 0;
+	while(std::getline(file, line))
+	{
+		line_nr++;
+		line = line.substr(0, line.find('#'));
+		if(line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+
+		std::istringstream values(line);
+		Step step;
+		std::vector<double>* wheel_values[4] = { &step.vel_drive, &step.vel_steer, &step.dlt_ang_drive, &step.ang_steer };
+		for(int i=0; i<3; i++)
+			values >> step.cmd[i];
+		for(int j=0; j<4; j++)
+			for(int i=0; i<NUM_WHEELS; i++)
+				values >> (*wheel_values[j])[i];
+		if(!values)
+		{
+			std::cout << file_name << ":" << line_nr << ": expected 19 values" << std::endl;
+			return false;
+		}
+		trace.push_back(step);
+	}
+	return !trace.empty();
+}
+
+int main(int argc, char** argv)
+{
+	if(argc<2)
+	{
+		std::cout << "usage: undercarriage_benchmark ini_directory [-t trace.txt] [-r golden.txt | -c golden.txt] [-e tolerance] [-l latency_s]" << std::endl;
+		return 1;
+	}
+
+	std::string ini_directory = argv[1];
+	if(ini_directory[ini_directory.size()-1] != '/')
+		ini_directory += "/";
+	const char *trace_file = NULL;
+	const char *record_file = NULL;
+	const char *compare_file = NULL;
+	double tolerance = 1e-9;
+	double latency = 0.0;
+	for(int i=2; i+1<argc; i+=2)
+	{
+		if(!strcmp(argv[i], "-t"))
+			trace_file = argv[i+1];
+		else if(!strcmp(argv[i], "-r"))
+			record_file = argv[i+1];
+		else if(!strcmp(argv[i], "-c"))
+			compare_file = argv[i+1];
+		else if(!strcmp(argv[i], "-e"))
+			tolerance = atof(argv[i+1]);
+		else if(!strcmp(argv[i], "-l"))
+			latency = atof(argv[i+1]);
+		else
+		{
+			std::cout << "unknown option " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	IniFile ini_file;
+	double cycle_time = 0.02;
+	ini_file.SetFileName(ini_directory + "Platform.ini", "undercarriage_benchmark.cpp");
+	ini_file.GetKeyDouble("Thread", "ThrUCarrCycleTimeS", &cycle_time, true);
+
+	std::vector<Step> trace;
+	if(trace_file)
+	{
+		if(!readTrace(trace_file, trace))
+			return 1;
+	}
+	else
+		simulateTrace(ini_directory, cycle_time, latency, trace);
+
+	// replay the trace on fresh controllers, the outputs of the last run are kept
+	std::vector<double> results(trace.size() * NUM_OUTPUTS);
+	Outputs outputs;
+	UndercarriageCtrlParams params;
+	const int repetitions = 100;
+	double elapsed = 0;
+	unsigned long step_allocations = 0;
+	for(int r=0; r<repetitions; r++)
+	{
+		UndercarriageCtrlGeom ctrl(ini_directory);
+		ctrl.InitUndercarriageCtrl();
+		ctrl.setCmdLatency(latency);
+		params = ctrl.getParams();
+
+		const unsigned long allocations_start = MicroBenchmark::allocations();
+		const double start = MicroBenchmark::getRealTime();
+		for(size_t s=0; s<trace.size(); s++)
+			runStep(ctrl, trace[s], outputs, &results[s * NUM_OUTPUTS]);
+		elapsed += MicroBenchmark::getRealTime() - start;
+		step_allocations += MicroBenchmark::allocations() - allocations_start;
+	}
+
+	const double steps = double(repetitions) * trace.size();
+	std::cout << "steps:       " << trace.size() << (trace_file ? " from " : " simulated") << (trace_file ? trace_file : "") << std::endl;
+	std::cout << "step:        " << 1e9*elapsed/steps << " ns" << std::endl;
+	std::cout << "allocations: " << step_allocations/steps << " per step" << std::endl;
+
+	compareScalarType<float, float>("float:       ", params, latency, trace, results);
+	compareScalarType<float, FixedPoint<16> >("float/Q16:   ", params, latency, trace, results);
+
+	if(record_file)
+	{
+		std::ofstream file(record_file);
+		file.precision(17);
+		for(size_t s=0; s<trace.size(); s++)
+		{
+			for(int i=0; i<NUM_OUTPUTS; i++)
+				file << (i ? " " : "") << results[s * NUM_OUTPUTS + i];
+			file << "\n";
+		}
+		if(!file)
+		{
+			std::cout << "could not write " << record_file << std::endl;
+			return 1;
+		}
+		std::cout << "golden:      written to " << record_file << std::endl;
+	}
+
+	if(compare_file)
+	{
+		std::ifstream file(compare_file);
+		std::vector<double> golden;
+		double value;
+		while(file >> value)
+			golden.push_back(value);
+		if(golden.size() != results.size())
+		{
+			std::cout << "golden:      " << compare_file << " has " << golden.size()/NUM_OUTPUTS << " steps, expected "
+					<< trace.size() << std::endl;
+			return 2;
+		}
+
+		double max_error = 0;
+		size_t mismatches = 0;
+		size_t first_mismatch = 0;
+		for(size_t i=0; i<results.size(); i++)
+		{
+			const double error = fabs(results[i] - golden[i]);
+			if(error > max_error)
+				max_error = error;
+			if(!(error <= tolerance * (1 + fabs(golden[i]))))
+			{
+				if(!mismatches)
+					first_mismatch = i;
+				mismatches++;
+			}
+		}
+		std::cout << "golden:      max deviation " << max_error << ", " << mismatches << " values off" << std::endl;
+		if(mismatches)
+		{
+			std::cout << "             first at step " << first_mismatch/NUM_OUTPUTS << ", output " << first_mismatch%NUM_OUTPUTS
+					<< ": " << results[first_mismatch] << " instead of " << golden[first_mismatch] << std::endl;
+			return 2;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,792 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+ 
+
+
+#ifndef UNDERCARRIAGE_CTRL_NODE_INCLUDEDEF_H
+#define UNDERCARRIAGE_CTRL_NODE_INCLUDEDEF_H
+
+//##################
+//#### includes ####
+
+// standard includes
+#include <math.h>
+
+// ROS includes
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+
+// ROS message includes
+#include <diagnostic_msgs/DiagnosticStatus.h>
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <geometry_msgs/Twist.h>
+#include <nav_msgs/Odometry.h>
+#include <tf/transform_broadcaster.h>
+#include <cob_msgs/EmergencyStopState.h>
+#include <control_msgs/JointTrajectoryControllerState.h>
+
+// external includes
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <cob_undercarriage_ctrl/UndercarriageCtrlGeom.h>
+#include <cob_utilities/IniFile.h>
+#include <cob_utilities/TripleBuffer.h>
+#include <cob_utilities/LatencyHistogram.h>
+#include <cob_utilities/RealTime.h>
+//#include <cob_utilities/MathSup.h>
+
+//####################
+//#### node class ####
+/**
+ * Undercarriage controller of the omnidirectional base.
+ * Runs as a node on its own, or in fused mode inside the process of the base drive chain, which
+ * then hands the joint states in and takes the joint commands out directly (see setJointCmdSink()).
+ */
+class UndercarriageCtrlNode
+{
+  //
+  public:
+    // create a handle for this node, initialize node
+    ros::NodeHandle n;
+
+    // topics to publish
+    ros::Publisher topic_pub_joint_state_cmd_;	// cmd issued for single joints of undercarriage
+    ros::Publisher topic_pub_controller_joint_command_;
+    ros::Publisher topic_pub_odometry_;			// calculated (measured) velocity, rotation and pose (odometry-based) for the robot
+    tf::TransformBroadcaster tf_broadcast_odometry_;	// according transformation for the tf broadcaster
+
+    // topics to subscribe, callback is called for new messages arriving
+    ros::Subscriber topic_sub_CMD_pltf_twist_;	// issued command to be achieved by the platform
+    ros::Subscriber topic_sub_EM_stop_state_;	// current emergency stop state (free, active, confirmed)
+    ros::Subscriber topic_sub_drive_diagnostic_;// status of drive chain (initializing, error, normal)
+
+    //subscribe to JointStates topic
+    //ros::Subscriber topic_sub_joint_states_;
+    ros::Subscriber topic_sub_joint_controller_states_;
+
+    // diagnostic stuff
+    diagnostic_updater::Updater updater_;
+
+    // controller Timer, runs on its own callback queue and thread
+    ros::CallbackQueue ctrl_queue_;
+    ros::Timer timer_ctrl_step_;
+    ros::Timer timer_diagnostics_;
+
+    // fed by the control step: its period and duration, and the age of the wheel states it uses
+    LatencyHistogram ctrl_period_hist_;
+    LatencyHistogram ctrl_duration_hist_;
+    LatencyHistogram measurement_age_hist_;
+    ros::WallTime last_ctrl_step_wall_;
+    PageFaultCounter ctrl_page_faults_;
+
+    // scheduling of the thread running the control step, applied by its first step (not in fused mode)
+    int ctrl_thread_priority_;
+    int ctrl_thread_cpu_;
+    bool ctrl_thread_setup_;
+
+    /**
+     * Setpoint of the platform as composed by the command, emergency stop and diagnostic callbacks.
+     * These callbacks are serviced by the single threaded global queue, so there is exactly one writer.
+     */
+    struct PltfCmdType
+    {
+      double vx_cmd_mms, vy_cmd_mms, w_cmd_rads;
+      bool em_stop_active;
+      int drive_chain_diagnostic;
+      unsigned int twist_count;	// incremented for every received twist, resets the watchdog
+    };
+
+    /**
+     * Measured wheel values of one joint controller state message.
+     */
+    struct WheelStateType
+    {
+      ros::Time stamp;
+      std::vector<double> drive_joint_ang_rad, drive_joint_vel_rads;
+      std::vector<double> steer_joint_ang_rad, steer_joint_vel_rads;
+    };
+
+    // handoff from the topic callbacks to the control step, the control step is the only reader
+    boost::scoped_ptr<TripleBuffer<PltfCmdType> > pltf_cmd_buffer_;
+    boost::scoped_ptr<TripleBuffer<WheelStateType> > wheel_state_buffer_;
+    PltfCmdType pltf_cmd_;				// last setpoint, owned by the topic callbacks
+    unsigned int ctrl_twist_count_;		// twist_count of the last setpoint seen by the control step
+    int ctrl_drive_chain_diagnostic_;	// drive chain status as seen by the control step
+
+    // prediction of the wheel states to the time of actuation
+    bool latency_compensation_;			// flag whether to extrapolate the measured steering angles
+    double cmd_latency_offset_;			// delay from publishing joint_command until the drives act on it in s
+    double max_cmd_latency_;			// upper limit for the predicted latency in s
+    double measurement_age_;			// filtered age of the wheel states at the control step in s
+
+    // member variables
+    UndercarriageCtrlGeom * ucar_ctrl_;	// instantiate undercarriage controller, owned by the control step
+    UndercarriageCtrlGeom * ucar_odom_;	// direct kinematics for odometry, owned by the joint state callback
+    std::string sIniDirectory;
+    bool is_initialized_bool_;			// flag wether node is already up and running
+    bool broadcast_tf_;			// flag wether to broadcast the tf from odom to base_link
+    int drive_chain_diagnostic_;		// flag whether base drive chain is operating normal
+    ros::Time last_time_;				// time Stamp for last odometry measurement
+    ros::Time joint_state_odom_stamp_;	// time stamp of joint states used for current odometry calc
+    double sample_time_, timeout_;
+    double x_rob_m_, y_rob_m_, theta_rob_rad_; // accumulated motion of robot since startup
+    int iwatchdog_;
+    double 	vel_x_rob_last_, vel_y_rob_last_, vel_theta_rob_last_; //save velocities for better odom calculation
+    ros::Time last_odom_stamp_;			// time stamp of joint states used for the last odometry calc
+    double odom_rate_;					// output rate of odometry and tf in Hz, 0 = for every joint state
+    bool tf_batch_;						// flag whether to send all poses since the last output in one tf message
+    ros::Time last_odom_pub_time_;		// time stamp of the last odometry output
+    std::vector<geometry_msgs::TransformStamped> odom_tf_batch_;	// poses integrated since the last output (tf_batch only)
+    nav_msgs::Odometry odom_msg_;				// reused for every output, the constant fields are set once
+    geometry_msgs::TransformStamped odom_tf_;	// reused for every output, filled from the same pose and stamp as odom_msg_
+    double cov_trans_per_m_, cov_rot_per_rad_;	// growth of pose variance per travelled m / rad, 0 = fixed variance
+    double pose_cov_[3][3];				// propagated covariance of x, y, theta
+    double max_vel_trans_, max_vel_rot_;
+
+    int m_iNumJoints;
+
+    // fused mode: joint states, drive chain status and joint commands are exchanged by function calls
+    bool fused_;
+    boost::function<void (const control_msgs::JointTrajectoryControllerState&)> joint_cmd_sink_;
+    ros::Time last_ctrl_step_time_;	// time of the last control step triggered by updateCtrl()
+
+    // lock-step mode: the control step is triggered by the joint states (in simulation driven by /clock)
+    bool lock_step_;
+
+    diagnostic_msgs::DiagnosticStatus diagnostic_status_lookup_; // used to access defines for warning levels
+
+    // Constructor
+    UndercarriageCtrlNode(bool fused = false)
+    {
+      // initialization of variables
+      fused_ = fused;
+      is_initialized_bool_ = false;
+      broadcast_tf_ = true;
+      iwatchdog_ = 0;
+      last_time_ = ros::Time::now();
+      sample_time_ = 0.020;
+      x_rob_m_ = 0.0;
+      y_rob_m_ = 0.0;
+      theta_rob_rad_ = 0.0;
+      vel_x_rob_last_ = 0.0;
+      vel_y_rob_last_ = 0.0;
+      vel_theta_rob_last_ = 0.0;
+      for(int i = 0; i < 3; i++)
+        for(int j = 0; j < 3; j++)
+          pose_cov_[i][j] = 0.0;
+      // set status of drive chain to WARN by default
+      drive_chain_diagnostic_ = diagnostic_status_lookup_.OK; //WARN; <- THATS FOR DEBUGGING ONLY!
+
+      // Parameters are set within the launch file
+      // read in timeout for watchdog stopping the controller.
+      if (n.hasParam("timeout"))
+      {
+        n.getParam("timeout", timeout_);
+        ROS_INFO("Timeout loaded from Parameter-Server is: %fs", timeout_);
+      }
+      else
+      {
+        ROS_WARN("No parameter timeout on Parameter-Server. Using default: 1.0s");
+        timeout_ = 1.0;
+      }
+      if ( timeout_ < sample_time_ )
+      {
+        ROS_WARN("Specified timeout < sample_time. Setting timeout to sample_time = %fs", sample_time_);
+        timeout_ = sample_time_;
+      }
+
+      // Read number of drives from iniFile and pass IniDirectory to CobPlatfCtrl.
+      if (n.hasParam("IniDirectory"))
+      {
+        n.getParam("IniDirectory", sIniDirectory);
+        ROS_INFO("IniDirectory loaded from Parameter-Server is: %s", sIniDirectory.c_str());
+      }
+      else
+      {
+        sIniDirectory = "Platform/IniFiles/";
+        ROS_WARN("IniDirectory not found on Parameter-Server, using default value: %s", sIniDirectory.c_str());
+      }
+
+      if (n.hasParam("max_trans_velocity"))
+      {
+        n.getParam("max_trans_velocity", max_vel_trans_);
+        ROS_INFO("Max translational velocity loaded from Parameter-Server is: %fs", max_vel_trans_);
+      }
+      else
+      {
+        ROS_WARN("No parameter max_trans_velocity on Parameter-Server. Using default: 1.1 m/s");
+        max_vel_trans_ = 1.1;
+      }
+      if (n.hasParam("max_rot_velocity"))
+      {
+        n.getParam("max_rot_velocity", max_vel_rot_);
+        ROS_INFO("Max rotational velocity loaded from Parameter-Server is: %fs", max_vel_rot_);
+      }
+      else
+      {
+        ROS_WARN("No parameter max_rot_velocity on Parameter-Server. Using default: 1.8 rad/s");
+        max_vel_rot_ = 1.8;
+      }
+      if (n.hasParam("broadcast_tf"))
+      {
+        n.getParam("broadcast_tf", broadcast_tf_);
+      }
+
+      // odometry is integrated with every joint state, but published at odometry_rate only
+      n.param<double>("odometry_rate", odom_rate_, 0.0);
+      n.param<bool>("tf_batch", tf_batch_, false);
+      n.param<double>("odometry_cov_trans_per_m", cov_trans_per_m_, 0.0);
+      n.param<double>("odometry_cov_rot_per_rad", cov_rot_per_rad_, 0.0);
+      if (odom_rate_ > 0.0)
+      {
+        ROS_INFO("Odometry is published at %f Hz%s", odom_rate_, tf_batch_ ? ", tf with all intermediate poses" : "");
+      }
+
+      // frames and the fixed variances do not change between the outputs
+      odom_msg_.header.frame_id = "/odom_combined";
+      odom_msg_.child_frame_id = "/base_footprint";
+      for(int i = 0; i < 6; i++)
+      {
+        odom_msg_.pose.covariance[i*6+i] = 0.1;
+        odom_msg_.twist.covariance[6*i+i] = 0.1;
+      }
+      odom_tf_.header.frame_id = odom_msg_.header.frame_id;
+      odom_tf_.child_frame_id = odom_msg_.child_frame_id;
+
+      // latency compensation: the measured age of the wheel states plus the (fixed) command path delay
+      // is used to extrapolate the steering angles to the time the commands take effect
+      n.param<bool>("latency_compensation", latency_compensation_, false);
+      n.param<double>("cmd_latency_offset", cmd_latency_offset_, 0.01);
+      n.param<double>("max_cmd_latency", max_cmd_latency_, 0.1);
+      measurement_age_ = 0.0;
+      if (latency_compensation_)
+      {
+        ROS_INFO("Latency compensation enabled, command path delay: %fs, max. latency: %fs", cmd_latency_offset_, max_cmd_latency_);
+      }
+
+      // lock-step: a control step every sample_time_ of the joint state stamps instead of a timer
+      n.param<bool>("lock_step", lock_step_, false);
+      if (lock_step_ && !fused_)
+      {
+        ROS_INFO("Control steps are triggered by the joint states");
+      }
+
+      // real-time setup, in fused mode the drive chain takes care of it
+      n.param<int>("ctrl_thread_priority", ctrl_thread_priority_, 0);
+      n.param<int>("ctrl_thread_cpu", ctrl_thread_cpu_, -1);
+      ctrl_thread_setup_ = fused_;
+      bool lock_memory;
+      int prefault_heap_mb;
+      n.param<bool>("lock_memory", lock_memory, false);
+      n.param<int>("prefault_heap_mb", prefault_heap_mb, 16);
+      if (lock_memory && !fused_)
+      {
+        std::string error;
+        if (RealTime::lockMemory((size_t)std::max(prefault_heap_mb, 0) << 20, &error))
+          ROS_INFO("Memory locked, %d MB heap prefaulted", prefault_heap_mb);
+        else
+          ROS_WARN("Could not lock memory: %s", error.c_str());
+      }
+
+      IniFile iniFile;
+      iniFile.SetFileName(sIniDirectory + "Platform.ini", "PltfHardwareCoB3.h");
+      iniFile.GetKeyInt("Config", "NumberOfMotors", &m_iNumJoints, true);
+
+      ucar_ctrl_ = new UndercarriageCtrlGeom(sIniDirectory);
+      ucar_odom_ = new UndercarriageCtrlGeom(sIniDirectory);
+
+      // setpoint and wheel state handoff to the control step, vectors are preallocated
+      pltf_cmd_.vx_cmd_mms = 0.0;
+      pltf_cmd_.vy_cmd_mms = 0.0;
+      pltf_cmd_.w_cmd_rads = 0.0;
+      pltf_cmd_.em_stop_active = false;
+      pltf_cmd_.drive_chain_diagnostic = drive_chain_diagnostic_;
+      pltf_cmd_.twist_count = 0;
+      pltf_cmd_buffer_.reset(new TripleBuffer<PltfCmdType>(pltf_cmd_));
+      ctrl_twist_count_ = 0;
+      ctrl_drive_chain_diagnostic_ = drive_chain_diagnostic_;
+
+      WheelStateType wheel_state;
+      wheel_state.drive_joint_ang_rad.assign(m_iNumJoints, 0.0);
+      wheel_state.drive_joint_vel_rads.assign(m_iNumJoints, 0.0);
+      wheel_state.steer_joint_ang_rad.assign(m_iNumJoints, 0.0);
+      wheel_state.steer_joint_vel_rads.assign(m_iNumJoints, 0.0);
+      wheel_state_buffer_.reset(new TripleBuffer<WheelStateType>(wheel_state));
+
+
+      // implementation of topics
+      // published topics
+      //topic_pub_joint_state_cmd_ = n.advertise<sensor_msgs::JointState>("joint_command", 1);
+      if (!fused_)
+        topic_pub_controller_joint_command_ = n.advertise<control_msgs::JointTrajectoryControllerState> ("joint_command", 1);
+
+      topic_pub_odometry_ = n.advertise<nav_msgs::Odometry>("odometry", 1);
+
+      // subscribed topics
+      topic_sub_CMD_pltf_twist_ = n.subscribe("command", 1, &UndercarriageCtrlNode::topicCallbackTwistCmd, this);
+      topic_sub_EM_stop_state_ = n.subscribe("/emergency_stop_state", 1, &UndercarriageCtrlNode::topicCallbackEMStop, this);
+      if (!fused_)
+        topic_sub_drive_diagnostic_ = n.subscribe("diagnostic", 1, &UndercarriageCtrlNode::topicCallbackDiagnostic, this);
+
+
+
+      //topic_sub_joint_states_ = n.subscribe("/joint_states", 1, &UndercarriageCtrlNode::topicCallbackJointStates, this);
+      if (!fused_)
+        topic_sub_joint_controller_states_ = n.subscribe("state", 1, &UndercarriageCtrlNode::topicCallbackJointControllerStates, this);
+
+      // diagnostics
+      updater_.setHardwareID(ros::this_node::getName());
+      updater_.add("initialization", this, &UndercarriageCtrlNode::diag_init);
+      updater_.add("timing", this, &UndercarriageCtrlNode::diag_timing);
+      timer_diagnostics_ = n.createTimer(ros::Duration(1.0), boost::bind(&diagnostic_updater::Updater::update, &updater_));
+
+      //set up timer to cyclically call controller-step
+      // (on a separate queue, so bursts of commands or states do not delay the control step)
+      // in fused mode the drive chain calls updateCtrl() right after reading the drives instead,
+      // in lock-step mode topicCallbackJointControllerStates() does
+      if (!fused_ && !lock_step_)
+      {
+        ros::TimerOptions timer_ops(ros::Duration(sample_time_), boost::bind(&UndercarriageCtrlNode::timerCallbackCtrlStep, this, _1), &ctrl_queue_);
+        timer_ctrl_step_ = n.createTimer(timer_ops);
+      }
+
+    }
+
+    // Destructor
+    ~UndercarriageCtrlNode()
+    {
+    }
+
+    void diag_init(diagnostic_updater::DiagnosticStatusWrapper &stat)
+    {
+      if(is_initialized_bool_)
+        stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "");
+      else
+        stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "");
+      stat.add("Initialized", is_initialized_bool_);
+    }
+
+    // percentiles since the last update, a control step missing its period by half is an overrun
+    void diag_timing(diagnostic_updater::DiagnosticStatusWrapper &stat)
+    {
+      std::vector<std::pair<std::string, std::string> > values;
+      LatencyHistogram::Summary summary;
+      ctrl_period_hist_.getSummary(&summary, 1.5e6 * sample_time_, true);
+      LatencyHistogram::appendKeyValues("control period", summary, &values);
+      uint64_t overruns = summary.uiOverruns;
+      ctrl_duration_hist_.getSummary(&summary, 1e6 * sample_time_, true);
+      LatencyHistogram::appendKeyValues("control step duration", summary, &values);
+      overruns += summary.uiOverruns;
+      measurement_age_hist_.getSummary(&summary, 1e6 * max_cmd_latency_, true);
+      LatencyHistogram::appendKeyValues("wheel state age", summary, &values);
+      uint64_t minor_faults, major_faults;
+      ctrl_page_faults_.get(&minor_faults, &major_faults, true);
+
+      if (overruns > 0)
+        stat.summaryf(diagnostic_msgs::DiagnosticStatus::WARN, "%lu overruns", (unsigned long)overruns);
+      else if (major_faults > 0)
+        stat.summaryf(diagnostic_msgs::DiagnosticStatus::WARN, "%lu major page faults", (unsigned long)major_faults);
+      else
+        stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "no overruns");
+      for (size_t i = 0; i < values.size(); i++)
+        stat.add(values[i].first, values[i].second);
+      stat.add("control step minor page faults", minor_faults);
+      stat.add("control step major page faults", major_faults);
+    }
+
+    // Listen for Pltf Cmds
+    void topicCallbackTwistCmd(const geometry_msgs::Twist::ConstPtr& msg)
+    {
+      double vx_cmd_mms, vy_cmd_mms, w_cmd_rads;
+
+      // check for NaN value in Twist message
+      if(isnan(msg->linear.x) || isnan(msg->linear.y) || isnan(msg->angular.z)) {
+        ROS_FATAL("Received NaN-value in Twist message. Stopping the robot.");
+        // force platform velocity commands to zero;
+        setPltfVelocity(0.0, 0.0, 0.0);
+        pltf_cmd_.twist_count++;
+        pltf_cmd_buffer_->write(pltf_cmd_);
+        ROS_DEBUG("Forced platform velocity commands to zero");
+        return;
+      }
+
+      if( (fabs(msg->linear.x) > max_vel_trans_) || (fabs(msg->linear.y) > max_vel_trans_) || (fabs(msg->angular.z) > max_vel_rot_))
+      {
+        if(fabs(msg->linear.x) > max_vel_trans_)
+        {
+          ROS_DEBUG_STREAM("Recevied cmdVelX: " << msg->linear.x <<
+              ", which is bigger than the maximal allowed translational velocity: " <<  max_vel_trans_ << " so stop the robot");
+        }
+        if(fabs(msg->linear.y) > max_vel_trans_)
+        {
+          ROS_DEBUG_STREAM("Recevied cmdVelY: " << msg->linear.x <<
+              ", which is bigger than the maximal allowed translational velocity: " <<  max_vel_trans_ << " so stop the robot");
+        }
+
+        if(fabs(msg->angular.z) > max_vel_rot_)
+        {
+          ROS_DEBUG_STREAM("Recevied cmdVelTh: " << msg->angular.z <<
+              ", which is bigger than the maximal allowed rotational velocity: " << max_vel_rot_ << " so stop the robot");
+        }
+        vx_cmd_mms = 0.0;
+        vy_cmd_mms = 0.0;
+        w_cmd_rads = 0.0;
+      }
+      else
+      {
+        // controller expects velocities in mm/s, ROS works with SI-Units -> convert
+        // ToDo: rework Controller Class to work with SI-Units
+        vx_cmd_mms = msg->linear.x*1000.0;
+        vy_cmd_mms = msg->linear.y*1000.0;
+        w_cmd_rads = msg->angular.z;
+      }
+
+      // reset watchdog of the control step
+      pltf_cmd_.twist_count++;
+
+      // only process if controller is already initialized
+      if (is_initialized_bool_ && drive_chain_diagnostic_==diagnostic_status_lookup_.OK)
+      {
+        ROS_DEBUG("received new velocity command [cmdVelX=%3.5f,cmdVelY=%3.5f,cmdVelTh=%3.5f]",
+            msg->linear.x, msg->linear.y, msg->angular.z);
+
+        // Set desired value for Plattform Velocity to UndercarriageCtrl (setpoint setting)
+        setPltfVelocity(vx_cmd_mms, vy_cmd_mms, w_cmd_rads);
+      }
+      else
+      {
+        // Set desired value for Plattform Velocity to zero (setpoint setting)
+        setPltfVelocity(0.0, 0.0, 0.0);
+        ROS_DEBUG("Forced platform-velocity cmds to zero");
+      }
+
+      pltf_cmd_buffer_->write(pltf_cmd_);
+    }
+
+    // Set desired value for Plattform Velocity, takes effect with the next write to pltf_cmd_buffer_
+    void setPltfVelocity(double vx_cmd_mms, double vy_cmd_mms, double w_cmd_rads)
+    {
+      pltf_cmd_.vx_cmd_mms = vx_cmd_mms;
+      pltf_cmd_.vy_cmd_mms = vy_cmd_mms;
+      pltf_cmd_.w_cmd_rads = w_cmd_rads;
+    }
+
+    // Listen for Emergency Stop
+    void topicCallbackEMStop(const cob_msgs::EmergencyStopState::ConstPtr& msg)
+    {
+      int EM_state;
+      EM_state = msg->emergency_state;
+
+      if (EM_state == msg->EMFREE)
+      {
+        // Reset EM flag in Ctrlr
+        if (is_initialized_bool_)
+        {
+          pltf_cmd_.em_stop_active = false;
+          ROS_DEBUG("Undercarriage Controller EM-Stop released");
+          // reset only done, when system initialized
+          // -> allows to stop ctrlr during init, reset and shutdown
+        }
+      }
+      else
+      {
+        ROS_DEBUG("Undercarriage Controller stopped due to EM-Stop");
+
+        // Set desired value for Plattform Velocity to zero (setpoint setting)
+        setPltfVelocity(0.0, 0.0, 0.0);
+        ROS_DEBUG("Forced platform-velocity cmds to zero");
+
+        // Set EM flag and stop Ctrlr
+        pltf_cmd_.em_stop_active = true;
+      }
+
+      pltf_cmd_buffer_->write(pltf_cmd_);
+    }
+
+    // Listens for status of underlying hardware (base drive chain)
+    void topicCallbackDiagnostic(const diagnostic_msgs::DiagnosticStatus::ConstPtr& msg)
+    {
+      setDriveChainDiagnostic(*msg);
+    }
+
+    // Sets status of underlying hardware (base drive chain)
+    void setDriveChainDiagnostic(const diagnostic_msgs::DiagnosticStatus& msg)
+    {
+      control_msgs::JointTrajectoryControllerState joint_state_cmd;
+
+      // prepare joint_cmds for heartbeat (compose header)
+      joint_state_cmd.header.stamp = ros::Time::now();
+      //joint_state_cmd.header.frame_id = frame_id; //Where to get this id from?
+      // ToDo: configure over Config-File (number of motors) and Msg
+      // assign right size to JointState data containers
+      //joint_state_cmd.set_name_size(m_iNumMotors);
+      joint_state_cmd.desired.positions.resize(m_iNumJoints);
+      joint_state_cmd.desired.velocities.resize(m_iNumJoints);
+      //joint_state_cmd.desired.effort.resize(m_iNumJoints);
+      joint_state_cmd.joint_names.push_back("fl_caster_r_wheel_joint");
+      joint_state_cmd.joint_names.push_back("fl_caster_rotation_joint");
+      joint_state_cmd.joint_names.push_back("bl_caster_r_wheel_joint");
+      joint_state_cmd.joint_names.push_back("bl_caster_rotation_joint");
+      joint_state_cmd.joint_names.push_back("br_caster_r_wheel_joint");
+      joint_state_cmd.joint_names.push_back("br_caster_rotation_joint");
+      joint_state_cmd.joint_names.push_back("fr_caster_r_wheel_joint");
+      joint_state_cmd.joint_names.push_back("fr_caster_rotation_joint");
+      joint_state_cmd.joint_names.resize(m_iNumJoints);
+
+      // compose jointcmds
+      for(int i=0; i<m_iNumJoints; i++)
+      {
+        joint_state_cmd.desired.positions[i] = 0.0;
+        joint_state_cmd.desired.velocities[i] = 0.0;
+        //joint_state_cmd.desired.effort[i] = 0.0;
+      }
+
+      // set status of underlying drive chain to member variable
+      drive_chain_diagnostic_ = msg.level;
+      pltf_cmd_.drive_chain_diagnostic = drive_chain_diagnostic_;
+
+      // if controller is already started up ...
+      if (is_initialized_bool_)
+      {
+        // ... but underlying drive chain is not yet operating normal
+        if (drive_chain_diagnostic_ != diagnostic_status_lookup_.OK)
+        {
+          // halt controller
+          ROS_DEBUG("drive chain not availlable: halt Controller");
+
+          // Set EM flag to Ctrlr (resets internal states)
+          pltf_cmd_.em_stop_active = true;
+
+          // Set desired value for Plattform Velocity to zero (setpoint setting)
+          setPltfVelocity(0.0, 0.0, 0.0);
+          ROS_DEBUG("Forced platform-velocity cmds to zero");
+
+          // if is not Initializing
+          if (drive_chain_diagnostic_ != diagnostic_status_lookup_.WARN)
+          {
+            // publish zero-vel. jointcmds to avoid Watchdogs stopping ctrlr
+            // this is already done in CalcControlStep
+          }
+        }
+      }
+      // ... while controller is not initialized send heartbeats to keep motors alive
+      else
+      {
+        // ... as soon as base drive chain is initialized
+        if(drive_chain_diagnostic_ != diagnostic_status_lookup_.WARN)
+        {
+          // publish zero-vel. jointcmds to avoid Watchdogs stopping ctrlr
+          sendJointCmd(joint_state_cmd);
+        }
+      }
+
+      pltf_cmd_buffer_->write(pltf_cmd_);
+    }
+
+    void topicCallbackJointControllerStates(const control_msgs::JointTrajectoryControllerState::ConstPtr& msg) {
+      setJointControllerState(*msg);
+      if (lock_step_)
+        updateCtrl(msg->header.stamp);
+    }
+
+    // Sets measured joint states, computes odometry and hands them to the control step
+    void setJointControllerState(const control_msgs::JointTrajectoryControllerState& msg) {
+      int num_joints;
+
+      joint_state_odom_stamp_ = msg.header.stamp;
+
+      // copy configuration directly into the preallocated slot of the handoff buffer
+      num_joints = msg.joint_names.size();
+      WheelStateType & wheel_state = wheel_state_buffer_->writeSlot();
+      wheel_state.stamp = msg.header.stamp;
+      std::vector<double> & drive_joint_ang_rad = wheel_state.drive_joint_ang_rad;
+      std::vector<double> & drive_joint_vel_rads = wheel_state.drive_joint_vel_rads;
+      std::vector<double> & steer_joint_ang_rad = wheel_state.steer_joint_ang_rad;
+      std::vector<double> & steer_joint_vel_rads = wheel_state.steer_joint_vel_rads;
+      // drive joints
+      drive_joint_ang_rad.assign(m_iNumJoints, 0.0);
+      drive_joint_vel_rads.assign(m_iNumJoints, 0.0);
+      // steer joints
+      steer_joint_ang_rad.assign(m_iNumJoints, 0.0);
+      steer_joint_vel_rads.assign(m_iNumJoints, 0.0);
+
+      for(int i = 0; i < num_joints; i++)
+      {
+        // associate inputs to according steer and drive joints
+        // ToDo: specify this globally (Prms-File or config-File or via msg-def.)
+        if(msg.joint_names[i] ==  "fl_caster_r_wheel_joint")
+        {
+          drive_joint_ang_rad[0] = msg.actual.positions[i];
+          drive_joint_vel_rads[0] = msg.actual.velocities[i];
+          //drive_joint_effort_NM[0] = msg.effort[i];
+        }
+        if(msg.joint_names[i] ==  "bl_caster_r_wheel_joint")
+        {
+          drive_joint_ang_rad[1] = msg.actual.positions[i];
+          drive_joint_vel_rads[1] = msg.actual.velocities[i];
+          //drive_joint_effort_NM[1] = msg.effort[i];
+        }
+        if(msg.joint_names[i] ==  "br_caster_r_wheel_joint")
+        {
+          drive_joint_ang_rad[2] = msg.actual.positions[i];
+          drive_joint_vel_rads[2] = msg.actual.velocities[i];
+          //drive_joint_effort_NM[2] = msg.effort[i];
+        }
+        if(msg.joint_names[i] ==  "fr_caster_r_wheel_joint")
+        {
+          drive_joint_ang_rad[3] = msg.actual.positions[i];
+          drive_joint_vel_rads[3] = msg.actual.velocities[i];
+          //drive_joint_effort_NM[3] = msg.effort[i];
+        }
+        if(msg.joint_names[i] ==  "fl_caster_rotation_joint")
+        {
+          steer_joint_ang_rad[0] = msg.actual.positions[i];
+          steer_joint_vel_rads[0] = msg.actual.velocities[i];
+          //steer_joint_effort_NM[0] = msg.effort[i];
+        }
+        if(msg.joint_names[i] ==  "bl_caster_rotation_joint")
+        {
+          steer_joint_ang_rad[1] = msg.actual.positions[i];
+          steer_joint_vel_rads[1] = msg.actual.velocities[i];
+          //steer_joint_effort_NM[1] = msg.effort[i];
+        }
+        if(msg.joint_names[i] ==  "br_caster_rotation_joint")
+        {
+          steer_joint_ang_rad[2] = msg.actual.positions[i];
+          steer_joint_vel_rads[2] = msg.actual.velocities[i];
+          //steer_joint_effort_NM[2] = msg.effort[i];
+        }
+        if(msg.joint_names[i] ==  "fr_caster_rotation_joint")
+        {
+          steer_joint_ang_rad[3] = msg.actual.positions[i];
+          steer_joint_vel_rads[3] = msg.actual.velocities[i];
+          //steer_joint_effort_NM[3] = msg.effort[i];
+        }
+      }
+
+      // Set measured Wheel Velocities and Angles to the odometry instance of the Controler Class (implements direct kinematic)
+      ucar_odom_->SetActualWheelValues(drive_joint_vel_rads, steer_joint_vel_rads,
+          drive_joint_ang_rad, steer_joint_ang_rad);
+
+      // hand them to the control step, the slot must not be touched afterwards
+      wheel_state_buffer_->publish();
+
+
+      // calculate odometry every time
+      UpdateOdometry();
+
+    }
+
+    void timerCallbackCtrlStep(const ros::TimerEvent& e) {
+      ctrlStep();
+    }
+
+    // fused and lock-step mode: performs a control step if sample_time_ has passed since the last one
+    void updateCtrl(const ros::Time& now) {
+      // the drive chain cycle is not a divisor of sample_time_ in general, allow for its jitter,
+      // a time going backwards is a restarted simulation
+      if ((now >= last_ctrl_step_time_) && ((now - last_ctrl_step_time_).toSec() < 0.9 * sample_time_))
+        return;
+
+      last_ctrl_step_time_ = now;
+      ctrlStep();
+    }
+
+    // fused mode: sets the function receiving the joint commands instead of the joint_command topic
+    void setJointCmdSink(const boost::function<void (const control_msgs::JointTrajectoryControllerState&)>& sink) {
+      joint_cmd_sink_ = sink;
+    }
+
+    // publishes joint commands, or passes them to the drive chain in fused mode
+    void sendJointCmd(const control_msgs::JointTrajectoryControllerState& cmd) {
+      if (fused_)
+      {
+        if (joint_cmd_sink_)
+          joint_cmd_sink_(cmd);
+      }
+      else
+        topic_pub_controller_joint_command_.publish(cmd);
+    }
+
+    // fetches the latest setpoint and measurement and performs one control step
+    void ctrlStep() {
+      if (!ctrl_thread_setup_)
+      {
+        ctrl_thread_setup_ = true;
+        std::string error;
+        if (!RealTime::setupThread(ctrl_thread_priority_, ctrl_thread_cpu_, 256 * 1024, &error))
+          ROS_WARN("Could not set up control thread: %s", error.c_str());
+      }
+      ctrl_page_faults_.update();
+
+      const ros::WallTime start = ros::WallTime::now();
+      if (!last_ctrl_step_wall_.isZero())
+        ctrl_period_hist_.recordSeconds((start - last_ctrl_step_wall_).toSec());
+      last_ctrl_step_wall_ = start;
+
+      // fetch latest setpoint
+      if (pltf_cmd_buffer_->update())
+      {
+        const PltfCmdType & cmd = pltf_cmd_buffer_->readSlot();
+        if (cmd.twist_count != ctrl_twist_count_)
+        {
+          ctrl_twist_count_ = cmd.twist_count;
+          iwatchdog_ = 0;
+        }
+        ctrl_drive_chain_diagnostic_ = cmd.drive_chain_diagnostic;
+
+        // Set EM flag to Ctrlr (resets internal states if active)
+        ucar_ctrl_->setEMStopActive(cmd.em_stop_active);
+
+        // Set desired value for Plattform Velocity to UndercarriageCtrl (setpoint setting)
+        ucar_ctrl_->SetDesiredPltfVelocity(cmd.vx_cmd_mms, cmd.vy_cmd_mms, cmd.w_cmd_rads, 0.0);
+        // ToDo: last value (0.0) is not used anymore --> remove from interface
+      }
+
+      // fetch latest measurement
+      if (wheel_state_buffer_->update())
+      {
+        const WheelStateType & wheel_state = wheel_state_buffer_->readSlot();
+
+        // Set measured Wheel Velocities and Angles to Controler Class
+        ucar_ctrl_->SetActualWheelValues(wheel_state.drive_joint_vel_rads, wheel_state.steer_joint_vel_rads,
+            wheel_state.drive_joint_ang_rad, wheel_state.steer_joint_ang_rad);
+
+        if (!wheel_state.stamp.isZero())
+          measurement_age_hist_.recordSeconds((ros::Time::now() - wheel_state.stamp).toSec());
+        if (latency_compensation_ && !wheel_state.stamp.isZero())
+          UpdateCmdLatency(wheel_state.stamp);
+      }
+
+      CalcCtrlStep();
+      ctrl_duration_hist_.recordSeconds((ros::WallTime::now() - start).toSec());
+    }
+
+    // other function declarations
+    // Initializes controller
+    bool InitCtrl();
+    // perform one control step, calculate inverse kinematics and publish updated joint cmd's (if no EMStop occurred)
+    void CalcCtrlStep();
+    // tracks the age of the wheel states and passes the predicted latency until actuation to the controller
+    void UpdateCmdLatency(const ros::Time& measurement_stamp);
+    // acquires the current undercarriage configuration from base_drive_chain
+    // calculates odometry from current measurement values and publishes it via an odometry topic and the tf broadcaster
+    void UpdateOdometry();
+    // integrates a constant platform twist over dt on SE(2) and propagates the pose covariance
+    void IntegrateOdometry(double vel_x_rob_ms, double vel_y_rob_ms, double rot_rob_rads, double dt);
+};
+
+#endif
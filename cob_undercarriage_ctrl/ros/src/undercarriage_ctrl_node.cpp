@@ -0,0 +1,331 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+ 
+
+
+#include <cob_undercarriage_ctrl/undercarriage_ctrl_node.h>
+
+//##################################
+//#### function implementations ####
+
+// Initializes controller
+bool UndercarriageCtrlNode::InitCtrl()
+{
+  // automatically do initializing of controller, because it's not directly depending any hardware components
+  ucar_ctrl_->InitUndercarriageCtrl();
+  ucar_odom_->InitUndercarriageCtrl();
+  is_initialized_bool_ = true;
+
+  if( is_initialized_bool_ ) {
+    last_time_ = ros::Time::now();
+    last_ctrl_step_time_ = last_time_;
+    ROS_INFO("Undercarriage control successfully initialized.");
+  } else {
+    ROS_FATAL("Undercarriage control initialization failed!");
+  }
+
+  return is_initialized_bool_;
+}
+
+// perform one control step, calculate inverse kinematics and publish updated joint cmd's (if no EMStop occurred)
+void UndercarriageCtrlNode::CalcCtrlStep()
+{
+  double vx_cmd_ms, vy_cmd_ms, w_cmd_rads, dummy;
+  std::vector<double> drive_jointvel_cmds_rads, steer_jointvel_cmds_rads, steer_jointang_cmds_rad;
+  control_msgs::JointTrajectoryControllerState joint_state_cmd;
+  int j, k;
+  iwatchdog_ += 1;
+
+  // if controller is initialized and underlying hardware is operating normal
+  if (is_initialized_bool_) //&& (drive_chain_diagnostic_ != diagnostic_status_lookup_.OK))
+  {
+    // as soon as (but only as soon as) platform drive chain is initialized start to send velocity commands
+    // Note: topicCallbackDiagnostic checks whether drives are operating nominal.
+    //       -> if warning or errors are issued target velocity is set to zero
+
+    // perform one control step,
+    // get the resulting cmd's for the wheel velocities and -angles from the controller class
+    // and output the achievable pltf velocity-cmds (if velocity limits where exceeded)
+    ucar_ctrl_->GetNewCtrlStateSteerDriveSetValues(drive_jointvel_cmds_rads,  steer_jointvel_cmds_rads, steer_jointang_cmds_rad, vx_cmd_ms, vy_cmd_ms, w_cmd_rads, dummy);
+    // ToDo: adapt interface of controller class --> remove last values (not used anymore)
+
+    // if drives not operating nominal -> force commands to zero
+    if(ctrl_drive_chain_diagnostic_ != diagnostic_status_lookup_.OK)
+    {
+      steer_jointang_cmds_rad.assign(m_iNumJoints, 0.0);
+      steer_jointvel_cmds_rads.assign(m_iNumJoints, 0.0);
+    }
+
+    // convert variables to SI-Units
+    vx_cmd_ms = vx_cmd_ms/1000.0;
+    vy_cmd_ms = vy_cmd_ms/1000.0;
+
+    // compose jointcmds
+    // compose header
+    joint_state_cmd.header.stamp = ros::Time::now();
+    //joint_state_cmd.header.frame_id = frame_id; //Where to get this id from?
+    // ToDo: configure over Config-File (number of motors) and Msg
+    // assign right size to JointState data containers
+    //joint_state_cmd.set_name_size(m_iNumMotors);
+    joint_state_cmd.desired.positions.resize(m_iNumJoints);
+    joint_state_cmd.desired.velocities.resize(m_iNumJoints);
+    //joint_state_cmd.effort.resize(m_iNumJoints);
+    joint_state_cmd.joint_names.push_back("fl_caster_r_wheel_joint");
+    joint_state_cmd.joint_names.push_back("fl_caster_rotation_joint");
+    joint_state_cmd.joint_names.push_back("bl_caster_r_wheel_joint");
+    joint_state_cmd.joint_names.push_back("bl_caster_rotation_joint");
+    joint_state_cmd.joint_names.push_back("br_caster_r_wheel_joint");
+    joint_state_cmd.joint_names.push_back("br_caster_rotation_joint");
+    joint_state_cmd.joint_names.push_back("fr_caster_r_wheel_joint");
+    joint_state_cmd.joint_names.push_back("fr_caster_rotation_joint");
+    joint_state_cmd.joint_names.resize(m_iNumJoints);
+
+    // compose data body
+    j = 0;
+    k = 0;
+    for(int i = 0; i<m_iNumJoints; i++)
+    {
+      if(iwatchdog_ < (int) std::floor(timeout_/sample_time_) )
+      {
+        // for steering motors
+        if( i == 1 || i == 3 || i == 5 || i == 7) // ToDo: specify this via the Msg
+        {
+          joint_state_cmd.desired.positions[i] = steer_jointang_cmds_rad[j];
+          joint_state_cmd.desired.velocities[i] = steer_jointvel_cmds_rads[j];
+          //joint_state_cmd.effort[i] = 0.0;
+          j = j + 1;
+        }
+        else
+        {
+          joint_state_cmd.desired.positions[i] = 0.0;
+          joint_state_cmd.desired.velocities[i] = drive_jointvel_cmds_rads[k];
+          //joint_state_cmd.effort[i] = 0.0;
+          k = k + 1;
+        }
+      }
+      else
+      {
+        joint_state_cmd.desired.positions[i] = 0.0;
+        joint_state_cmd.desired.velocities[i] = 0.0;
+        //joint_state_cmd.effort[i] = 0.0;
+      }
+    }
+
+    // publish jointcmds
+    sendJointCmd(joint_state_cmd);
+  }
+
+}
+
+// tracks the age of the wheel states and passes the predicted latency until actuation to the controller
+void UndercarriageCtrlNode::UpdateCmdLatency(const ros::Time& measurement_stamp)
+{
+  double age, latency;
+
+  age = (ros::Time::now() - measurement_stamp).toSec();
+  if (age < 0.0 || age > max_cmd_latency_)
+  {
+    // clock jump or stale measurement, don't let it disturb the estimate
+    ROS_DEBUG("Discarding wheel state age of %fs for latency compensation", age);
+    return;
+  }
+
+  // low pass filter, the age jitters with the phase between joint states and control timer
+  measurement_age_ += 0.1 * (age - measurement_age_);
+
+  latency = measurement_age_ + cmd_latency_offset_;
+  if (latency > max_cmd_latency_)
+    latency = max_cmd_latency_;
+
+  ucar_ctrl_->setCmdLatency(latency);
+}
+
+// calculates odometry from current measurement values
+// and publishes it via an odometry topic and the tf broadcaster
+void UndercarriageCtrlNode::UpdateOdometry()
+{
+  double vel_x_rob_ms, vel_y_rob_ms, rot_rob_rads, delta_x_rob_m, delta_y_rob_m, delta_theta_rob_rad;
+  double dummy1, dummy2;
+  double dt;
+  ros::Time current_time;
+
+  // if drive chain already initialized process joint data
+  //if (drive_chain_diagnostic_ != diagnostic_status_lookup_.OK)
+  if (is_initialized_bool_)
+  {
+    // Get resulting Pltf Velocities from Ctrl-Class (result of forward kinematics)
+    // !Careful! Controller internally calculates with mm instead of m
+    // ToDo: change internal calculation to SI-Units
+    // ToDo: last values are not used anymore --> remove from interface
+    ucar_odom_->GetActualPltfVelocity(delta_x_rob_m, delta_y_rob_m, delta_theta_rob_rad, dummy1,
+        vel_x_rob_ms, vel_y_rob_ms, rot_rob_rads, dummy2);
+
+    // convert variables to SI-Units
+    vel_x_rob_ms = vel_x_rob_ms/1000.0;
+    vel_y_rob_ms = vel_y_rob_ms/1000.0;
+    delta_x_rob_m = delta_x_rob_m/1000.0;
+    delta_y_rob_m = delta_y_rob_m/1000.0;
+
+    ROS_DEBUG("Odmonetry delta is: x=%f, y=%f, th=%f", delta_x_rob_m, delta_y_rob_m, rot_rob_rads);
+  }
+  else
+  {
+    // otherwise set data (velocity and pose-delta) to zero
+    vel_x_rob_ms = 0.0;
+    vel_y_rob_ms = 0.0;
+    delta_x_rob_m = 0.0;
+    delta_y_rob_m = 0.0;
+  }
+
+  // calc odometry (from startup)
+  // get time since last odometry-measurement, from the measurement stamps if available
+  current_time = ros::Time::now();
+  if (!joint_state_odom_stamp_.isZero() && !last_odom_stamp_.isZero() && joint_state_odom_stamp_ > last_odom_stamp_)
+    dt = (joint_state_odom_stamp_ - last_odom_stamp_).toSec();
+  else
+    dt = current_time.toSec() - last_time_.toSec();
+  last_time_ = current_time;
+  last_odom_stamp_ = joint_state_odom_stamp_;
+
+  // trapezoidal velocities of the interval, integrated exactly along the resulting arc
+  IntegrateOdometry((vel_x_rob_ms+vel_x_rob_last_)/2.0, (vel_y_rob_ms+vel_y_rob_last_)/2.0,
+      (rot_rob_rads+vel_theta_rob_last_)/2.0, dt);
+
+  vel_x_rob_last_ = vel_x_rob_ms;
+  vel_y_rob_last_ = vel_y_rob_ms;
+  vel_theta_rob_last_ = rot_rob_rads;
+
+
+  // format data for compatibility with tf-package and standard odometry msg
+  // generate quaternion for rotation
+  geometry_msgs::Quaternion odom_quat = tf::createQuaternionMsgFromYaw(theta_rob_rad_);
+
+  if (broadcast_tf_ && tf_batch_)
+  {
+    // every integrated pose is kept until the next output
+    odom_tf_.header.stamp = joint_state_odom_stamp_;
+    odom_tf_.transform.translation.x = x_rob_m_;
+    odom_tf_.transform.translation.y = y_rob_m_;
+    odom_tf_.transform.translation.z = 0.0;
+    odom_tf_.transform.rotation = odom_quat;
+    odom_tf_batch_.push_back(odom_tf_);
+  }
+
+  // decimate output
+  if (odom_rate_ > 0.0 && (current_time - last_odom_pub_time_).toSec() < 1.0 / odom_rate_)
+    return;
+  last_odom_pub_time_ = current_time;
+
+  // transform and odometry message are composed from the same pose and stamp
+  if (broadcast_tf_)
+  {
+    // publish the transform(s) in one message (for debugging, conflicts with robot-pose-ekf)
+    if (tf_batch_)
+    {
+      tf_broadcast_odometry_.sendTransform(odom_tf_batch_);
+      odom_tf_batch_.clear();
+    }
+    else
+    {
+      odom_tf_.header.stamp = joint_state_odom_stamp_;
+      odom_tf_.transform.translation.x = x_rob_m_;
+      odom_tf_.transform.translation.y = y_rob_m_;
+      odom_tf_.transform.translation.z = 0.0;
+      odom_tf_.transform.rotation = odom_quat;
+      tf_broadcast_odometry_.sendTransform(odom_tf_);
+    }
+  }
+
+  // compose and publish odometry message as topic, frames and fixed variances are set in the constructor
+  odom_msg_.header.stamp = joint_state_odom_stamp_;
+  // compose pose of robot
+  odom_msg_.pose.pose.position.x = x_rob_m_;
+  odom_msg_.pose.pose.position.y = y_rob_m_;
+  odom_msg_.pose.pose.position.z = 0.0;
+  odom_msg_.pose.pose.orientation = odom_quat;
+  if (cov_trans_per_m_ > 0.0 || cov_rot_per_rad_ > 0.0)
+  {
+    // propagated covariance of the planar pose, z and roll/pitch are not observed
+    int idx[3] = {0, 1, 5};
+    for(int i = 0; i < 3; i++)
+      for(int j = 0; j < 3; j++)
+        odom_msg_.pose.covariance[idx[i]*6+idx[j]] = pose_cov_[i][j];
+  }
+
+  // compose twist of robot
+  odom_msg_.twist.twist.linear.x = vel_x_rob_ms;
+  odom_msg_.twist.twist.linear.y = vel_y_rob_ms;
+  odom_msg_.twist.twist.linear.z = 0.0;
+  odom_msg_.twist.twist.angular.x = 0.0;
+  odom_msg_.twist.twist.angular.y = 0.0;
+  odom_msg_.twist.twist.angular.z = rot_rob_rads;
+
+  // publish odometry msg
+  topic_pub_odometry_.publish(odom_msg_);
+}
+
+// integrates a constant platform twist over dt on SE(2) and propagates the pose covariance
+void UndercarriageCtrlNode::IntegrateOdometry(double vel_x_rob_ms, double vel_y_rob_ms, double rot_rob_rads, double dt)
+{
+  double delta_theta, delta_x_m, delta_y_m, delta_x_odom_m, delta_y_odom_m;
+  double sin_theta, cos_theta, sin_delta, cos_delta;
+
+  // displacement in the robot frame at the start of the interval
+  delta_theta = rot_rob_rads * dt;
+  if (fabs(delta_theta) > 1e-6)
+  {
+    sin_delta = sin(delta_theta);
+    cos_delta = cos(delta_theta);
+    delta_x_m = (vel_x_rob_ms * sin_delta + vel_y_rob_ms * (cos_delta - 1.0)) / rot_rob_rads;
+    delta_y_m = (vel_x_rob_ms * (1.0 - cos_delta) + vel_y_rob_ms * sin_delta) / rot_rob_rads;
+  }
+  else
+  {
+    // second order expansion, avoids division by (almost) zero
+    delta_x_m = (vel_x_rob_ms - vel_y_rob_ms * delta_theta / 2.0) * dt;
+    delta_y_m = (vel_y_rob_ms + vel_x_rob_ms * delta_theta / 2.0) * dt;
+  }
+
+  // rotate into odometry frame
+  sin_theta = sin(theta_rob_rad_);
+  cos_theta = cos(theta_rob_rad_);
+  delta_x_odom_m = delta_x_m * cos_theta - delta_y_m * sin_theta;
+  delta_y_odom_m = delta_x_m * sin_theta + delta_y_m * cos_theta;
+
+  x_rob_m_ += delta_x_odom_m;
+  y_rob_m_ += delta_y_odom_m;
+  theta_rob_rad_ += delta_theta;
+
+  if (cov_trans_per_m_ <= 0.0 && cov_rot_per_rad_ <= 0.0)
+    return;
+
+  // P = F * P * F^T + Q, F is the jacobian of the pose update w.r.t. the previous pose
+  // Q grows with travelled distance (xy) and rotation (theta)
+  double F[3][3] = { {1.0, 0.0, -delta_y_odom_m}, {0.0, 1.0, delta_x_odom_m}, {0.0, 0.0, 1.0} };
+  double FP[3][3];
+  double dist_m = sqrt(delta_x_m * delta_x_m + delta_y_m * delta_y_m);
+
+  for(int i = 0; i < 3; i++)
+    for(int j = 0; j < 3; j++)
+      FP[i][j] = F[i][0] * pose_cov_[0][j] + F[i][1] * pose_cov_[1][j] + F[i][2] * pose_cov_[2][j];
+  for(int i = 0; i < 3; i++)
+    for(int j = 0; j < 3; j++)
+      pose_cov_[i][j] = FP[i][0] * F[j][0] + FP[i][1] * F[j][1] + FP[i][2] * F[j][2];
+
+  pose_cov_[0][0] += cov_trans_per_m_ * dist_m;
+  pose_cov_[1][1] += cov_trans_per_m_ * dist_m;
+  pose_cov_[2][2] += cov_rot_per_rad_ * fabs(delta_theta);
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef FIXEDPOINT_INCLUDEDEF_H
+#define FIXEDPOINT_INCLUDEDEF_H
+
+//-----------------------------------------------
+#include <stdint.h>
+//-----------------------------------------------
+
+/**
+ * Signed Q-format fixed point number with iFracBits fractional bits in 32 bits, e.g. Q15.16 for
+ * FixedPoint<16>. For processors without (double precision) floating point unit.
+ * Products and quotients are calculated with 64 bit intermediates and rounded to the nearest value,
+ * there is no saturation: the range of all intermediate values is up to the user.
+ */
+template <int iFracBits>
+class FixedPoint
+{
+public:
+	FixedPoint() : m_iRaw(0) {}
+
+	explicit FixedPoint(int i) : m_iRaw(i * c_iOne) {}
+	explicit FixedPoint(float f) : m_iRaw(int32_t(f * c_iOne + (f < 0 ? -0.5f : 0.5f))) {}
+	explicit FixedPoint(double d) : m_iRaw(int32_t(d * c_iOne + (d < 0 ? -0.5 : 0.5))) {}
+
+	/**
+	 * Creates a number from its representation, the value is iRaw / 2^iFracBits.
+	 */
+	static FixedPoint fromRaw(int32_t iRaw)
+	{
+		FixedPoint x;
+		x.m_iRaw = iRaw;
+		return x;
+	}
+
+	int32_t raw() const { return m_iRaw; }
+	float toFloat() const { return m_iRaw * (1.0f / c_iOne); }
+	double toDouble() const { return m_iRaw * (1.0 / c_iOne); }
+
+	FixedPoint operator-() const { return fromRaw(-m_iRaw); }
+
+	FixedPoint& operator+=(FixedPoint x) { m_iRaw += x.m_iRaw; return *this; }
+	FixedPoint& operator-=(FixedPoint x) { m_iRaw -= x.m_iRaw; return *this; }
+	FixedPoint& operator*=(FixedPoint x)
+	{
+		m_iRaw = int32_t((int64_t(m_iRaw) * x.m_iRaw + c_iHalf) >> iFracBits);
+		return *this;
+	}
+	FixedPoint& operator/=(FixedPoint x)
+	{
+		// round half away from zero, the sign of the quotient decides the direction
+		int64_t iNum = int64_t(m_iRaw) * c_iOne;
+		int64_t iHalfDen = (x.m_iRaw < 0 ? -x.m_iRaw : x.m_iRaw) / 2;
+		m_iRaw = int32_t(((iNum < 0) != (x.m_iRaw < 0) ? iNum - iHalfDen : iNum + iHalfDen) / x.m_iRaw);
+		return *this;
+	}
+
+	FixedPoint operator+(FixedPoint x) const { return FixedPoint(*this) += x; }
+	FixedPoint operator-(FixedPoint x) const { return FixedPoint(*this) -= x; }
+	FixedPoint operator*(FixedPoint x) const { return FixedPoint(*this) *= x; }
+	FixedPoint operator/(FixedPoint x) const { return FixedPoint(*this) /= x; }
+
+	bool operator==(FixedPoint x) const { return m_iRaw == x.m_iRaw; }
+	bool operator!=(FixedPoint x) const { return m_iRaw != x.m_iRaw; }
+	bool operator<(FixedPoint x) const { return m_iRaw < x.m_iRaw; }
+	bool operator<=(FixedPoint x) const { return m_iRaw <= x.m_iRaw; }
+	bool operator>(FixedPoint x) const { return m_iRaw > x.m_iRaw; }
+	bool operator>=(FixedPoint x) const { return m_iRaw >= x.m_iRaw; }
+
+private:
+	static const int32_t c_iOne = int32_t(1) << iFracBits;
+	static const int64_t c_iHalf = int64_t(1) << (iFracBits - 1);
+
+	int32_t m_iRaw;
+};
+
+//-----------------------------------------------
+// Counterparts of the <cmath> functions, found by argument dependent lookup in templates
+
+template <int iFracBits>
+inline FixedPoint<iFracBits> fabs(FixedPoint<iFracBits> x)
+{
+	return (x.raw() < 0) ? -x : x;
+}
+
+template <int iFracBits>
+inline FixedPoint<iFracBits> ceil(FixedPoint<iFracBits> x)
+{
+	const int32_t iMask = (int32_t(1) << iFracBits) - 1;
+	return FixedPoint<iFracBits>::fromRaw((x.raw() + iMask) & ~iMask);
+}
+
+template <int iFracBits>
+inline double toDouble(FixedPoint<iFracBits> x)
+{
+	return x.toDouble();
+}
+
+//-----------------------------------------------
+#endif
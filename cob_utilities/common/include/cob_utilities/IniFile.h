@@ -22,6 +22,7 @@
 #include <vector>
 #include <string>
 #include <stdio.h>
+#include <boost/unordered_map.hpp>
 
 //-------------------------------------------------------------------
 
@@ -30,8 +31,10 @@
  * Used to store persistend program configuration in INI-Files.
  * The INI-File is organized into sections and Keys (variables) like
  * ordinary Windows INI-Files.
- * The write functions create a temporary file in the root directory.
- * If there is no write permission in this directory, they don't work.
+ * The file is read once by SetFileName() and indexed by section and key,
+ * all read functions are served from memory.
+ * The write functions only modify the copy in memory, it is written back
+ * to the file by Flush() or when the object is destroyed.
  * @par sections:
  * identifcator between '[' and ']', a section headline must not have blanks
  * at the beginning neither right after or before the '[ ]'.
@@ -85,6 +88,13 @@ public:
 	 */
 	int SetFileName(std::string fileName, std::string strIniFileUsedBy = "", bool bCreate = false);
 
+	/**
+	 * Writes all modifications made by the write functions back to the file.
+	 * Lines which have not been modified keep their original content.
+	 * @return 0 if the file has been written or there was nothing to write, -1 otherwise
+	 */
+	int Flush();
+
 
 	/**
 	 * Write character string to INI-File.
@@ -236,9 +246,36 @@ public:
 
 private:
 
-	int FindSection(const char* sect, bool bWarnIfNotfound = true);
-	int FindKey(const char* skey,	bool bWarnIfNotfound = true);
-	int FindNextLine(std::vector<char>& NewLine, int& CharInd);
+	/**
+	 * Line indices of one section.
+	 */
+	struct Section
+	{
+		/// Line of the section headline.
+		int iHeader;
+		/// Last non-empty line of the section, new keys are inserted after it.
+		int iLast;
+		/// Line of each key.
+		boost::unordered_map<std::string, int> keys;
+	};
+
+	/**
+	 * Reads the file into m_vLines and builds the index.
+	 */
+	int ReadFile(bool bCreate);
+
+	/**
+	 * Rebuilds m_sections and m_vSectionOrder from m_vLines.
+	 * Only the first occurrence of a section and of a key within it is indexed.
+	 */
+	void BuildIndex();
+
+	/**
+	 * Looks up the value of a key.
+	 * @return pointer to the line containing the key, the value starts at *pValuePos; NULL if not found
+	 */
+	const std::string* FindValue(const char* pSect, const char* pKey, size_t* pValuePos,
+							bool bWarnIfNotfound = true);
 
 	/**
 	 * Write character string to INI-File.
@@ -264,41 +301,35 @@ private:
 	int GetKeyValue(const char* pSect,const char* pKey, char* pBuf, int lenBuf,
 							bool bWarnIfNotfound = true);
 
+	bool m_bFileOK;
+
 	/**
-	 * Skips chars in line until Endchar.
-	 * return:	- Nr of chars skipped if successful
-	 * 			- RF_E if end of line (\n) or end of file before Endchar is found
+	 * True if m_vLines has been modified since it was read or flushed.
 	 */
-	int SkipLineUntil(FILE* pFile, const char EndChar);
+	bool m_bDirty;
 
 	/**
-	 * Reads chars in line until Endchar into string.
-	 * return:	- Nr of chars read if successful
-	 * 			- RF_E if end of line (\n) or end of file before Endchar is found.
-	 * In this case, the string will contain the chars read so far.
+	 * True if the last line of the file was terminated by a newline.
 	 */
-	int ReadLineUntil(FILE* pFile, const char EndChar, std::string& ReadIntoStr);
-
-	bool m_bFileOK;
+	bool m_bEndsWithNewline;
 
 	/**
-	 * Vector to store the chars of the most recently read line.
+	 * Content of the file, one entry per line without the line break.
 	 */
-	std::vector<char> m_CurLine;
+	std::vector<std::string> m_vLines;
 
 	/**
-	 * Size of the vector CurLine.
+	 * Index of the sections in m_vLines.
 	 */
-	const int m_vectorSize;
+	boost::unordered_map<std::string, Section> m_sections;
 
 	/**
-	 * Index of the current character in the current line.
+	 * Section names in the order of their headlines, used by FindNextSection().
 	 */
-    int m_CurCharInd;
+	std::vector<std::string> m_vSectionOrder;
 
 	std::string m_fileName;
 	std::string m_strIniFileUsedBy;	//used for debug to inidcate user class of ini-file
-	FILE* f;
 };
 
 #endif
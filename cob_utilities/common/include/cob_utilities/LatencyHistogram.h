@@ -0,0 +1,202 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef LATENCYHISTOGRAM_INCLUDEDEF_H
+#define LATENCYHISTOGRAM_INCLUDEDEF_H
+
+//-----------------------------------------------
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <boost/atomic.hpp>
+//-----------------------------------------------
+
+/**
+ * Histogram of durations in microseconds with logarithmic buckets, like an HDR histogram.
+ * Each power of two is split into 32 linear buckets, so percentiles are accurate to about 3 %
+ * from 1 us up to days, with a fixed table of a few kB.
+ * record() costs a few atomic increments and never blocks, so it can be called from real-time loops
+ * while another thread takes summaries.
+ */
+class LatencyHistogram
+{
+public:
+	/**
+	 * Percentiles and extremes of the recorded durations in us, all 0 if nothing was recorded.
+	 */
+	struct Summary
+	{
+		uint64_t uiCount;
+		/// durations above the overrun threshold given to getSummary()
+		uint64_t uiOverruns;
+		double dMin;
+		double dMean;
+		double dP50;
+		double dP90;
+		double dP99;
+		double dP999;
+		double dMax;
+	};
+
+	LatencyHistogram()
+	{
+		reset();
+	}
+
+	void record(uint64_t uiValueUs)
+	{
+		m_uiCounts[getBucket(uiValueUs)].fetch_add(1, boost::memory_order_relaxed);
+		m_uiSumUs.fetch_add(uiValueUs, boost::memory_order_relaxed);
+
+		uint64_t uiMin = m_uiMinUs.load(boost::memory_order_relaxed);
+		while(uiValueUs < uiMin && !m_uiMinUs.compare_exchange_weak(uiMin, uiValueUs, boost::memory_order_relaxed)) {}
+		uint64_t uiMax = m_uiMaxUs.load(boost::memory_order_relaxed);
+		while(uiValueUs > uiMax && !m_uiMaxUs.compare_exchange_weak(uiMax, uiValueUs, boost::memory_order_relaxed)) {}
+	}
+
+	/// Records a duration given in s, negative durations count as 0.
+	void recordSeconds(double dValueS)
+	{
+		record(dValueS > 0 ? (uint64_t)(dValueS * 1e6 + 0.5) : 0);
+	}
+
+	/**
+	 * Evaluates the recorded durations.
+	 * @param dOverrunUs durations above this limit are counted as overruns, e.g. 1.5 times the nominal period
+	 * @param bReset starts a new period, durations recorded meanwhile may end up in either period
+	 */
+	void getSummary(Summary* pSummary, double dOverrunUs, bool bReset)
+	{
+		uint32_t uiCounts[NUM_BUCKETS];
+		uint64_t uiCount = 0;
+		uint64_t uiOverruns = 0;
+		for(int i = 0; i < NUM_BUCKETS; i++)
+		{
+			uiCounts[i] = bReset ? m_uiCounts[i].exchange(0, boost::memory_order_relaxed) : m_uiCounts[i].load(boost::memory_order_relaxed);
+			uiCount += uiCounts[i];
+			if(getBucketLower(i) > dOverrunUs)
+				uiOverruns += uiCounts[i];
+		}
+		uint64_t uiSumUs = bReset ? m_uiSumUs.exchange(0, boost::memory_order_relaxed) : m_uiSumUs.load(boost::memory_order_relaxed);
+		uint64_t uiMinUs = bReset ? m_uiMinUs.exchange(UINT64_MAX, boost::memory_order_relaxed) : m_uiMinUs.load(boost::memory_order_relaxed);
+		uint64_t uiMaxUs = bReset ? m_uiMaxUs.exchange(0, boost::memory_order_relaxed) : m_uiMaxUs.load(boost::memory_order_relaxed);
+
+		pSummary->uiCount = uiCount;
+		pSummary->uiOverruns = uiOverruns;
+		if(uiCount == 0)
+		{
+			pSummary->dMin = pSummary->dMean = pSummary->dMax = 0;
+			pSummary->dP50 = pSummary->dP90 = pSummary->dP99 = pSummary->dP999 = 0;
+			return;
+		}
+		pSummary->dMin = (double)uiMinUs;
+		pSummary->dMax = (double)uiMaxUs;
+		pSummary->dMean = (double)uiSumUs / uiCount;
+
+		// one pass over the buckets for all percentiles, each reported as the middle of its bucket
+		const double dRanks[4] = { 0.5, 0.9, 0.99, 0.999 };
+		double* pdResults[4] = { &pSummary->dP50, &pSummary->dP90, &pSummary->dP99, &pSummary->dP999 };
+		uint64_t uiSeen = 0;
+		int iRank = 0;
+		for(int i = 0; i < NUM_BUCKETS && iRank < 4; i++)
+		{
+			uiSeen += uiCounts[i];
+			while(iRank < 4 && uiSeen >= dRanks[iRank] * uiCount && uiSeen > 0)
+			{
+				double dValue = 0.5 * (getBucketLower(i) + getBucketLower(i + 1));
+				// the extremes are known exactly
+				if(dValue < pSummary->dMin) dValue = pSummary->dMin;
+				if(dValue > pSummary->dMax) dValue = pSummary->dMax;
+				*pdResults[iRank++] = dValue;
+			}
+		}
+	}
+
+	/**
+	 * Appends the summary as key value pairs for diagnostics, e.g. "<sName> p99 [us]".
+	 */
+	static void appendKeyValues(const std::string& sName, const Summary& summary,
+		std::vector<std::pair<std::string, std::string> >* pvKeyValues)
+	{
+		const char* pcKeys[] = { "min", "mean", "p50", "p90", "p99", "p99.9", "max" };
+		const double dValues[] = { summary.dMin, summary.dMean, summary.dP50, summary.dP90, summary.dP99, summary.dP999, summary.dMax };
+		for(unsigned int i = 0; i < sizeof(dValues) / sizeof(dValues[0]); i++)
+		{
+			std::ostringstream ss;
+			ss.precision(0);
+			ss << std::fixed << dValues[i];
+			pvKeyValues->push_back(std::make_pair(sName + " " + pcKeys[i] + " [us]", ss.str()));
+		}
+		std::ostringstream ssCount, ssOverruns;
+		ssCount << summary.uiCount;
+		ssOverruns << summary.uiOverruns;
+		pvKeyValues->push_back(std::make_pair(sName + " samples", ssCount.str()));
+		pvKeyValues->push_back(std::make_pair(sName + " overruns", ssOverruns.str()));
+	}
+
+	void reset()
+	{
+		for(int i = 0; i < NUM_BUCKETS; i++)
+			m_uiCounts[i].store(0, boost::memory_order_relaxed);
+		m_uiSumUs.store(0, boost::memory_order_relaxed);
+		m_uiMinUs.store(UINT64_MAX, boost::memory_order_relaxed);
+		m_uiMaxUs.store(0, boost::memory_order_relaxed);
+	}
+
+private:
+	enum
+	{
+		SUB_BUCKET_BITS = 5,
+		SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+		// values up to 2^40 us (12 days), larger ones are counted in the last bucket
+		MAX_VALUE_BITS = 40,
+		NUM_BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS
+	};
+
+	static int getBucket(uint64_t uiValue)
+	{
+		if(uiValue < SUB_BUCKETS)
+			return (int)uiValue;
+		int iMsb = 63 - __builtin_clzll(uiValue);
+		if(iMsb >= MAX_VALUE_BITS)
+			return NUM_BUCKETS - 1;
+		int iShift = iMsb - SUB_BUCKET_BITS;
+		return (iShift + 1) * SUB_BUCKETS + (int)(uiValue >> iShift) - SUB_BUCKETS;
+	}
+
+	static double getBucketLower(int iBucket)
+	{
+		if(iBucket < SUB_BUCKETS)
+			return iBucket;
+		int iShift = iBucket / SUB_BUCKETS - 1;
+		return (double)((uint64_t)(iBucket % SUB_BUCKETS + SUB_BUCKETS) << iShift);
+	}
+
+	boost::atomic<uint32_t> m_uiCounts[NUM_BUCKETS];
+	boost::atomic<uint64_t> m_uiSumUs;
+	boost::atomic<uint64_t> m_uiMinUs;
+	boost::atomic<uint64_t> m_uiMaxUs;
+
+	// not copyable
+	LatencyHistogram(const LatencyHistogram&);
+	LatencyHistogram& operator=(const LatencyHistogram&);
+};
+
+//-----------------------------------------------
+#endif
@@ -66,11 +66,11 @@ public:
 
 	/**
 	 * Normalizes angle to the interval ]-pi,pi].
+	 * Branchless, the number of turns to subtract is rounded up from (angle-pi)/2pi.
 	 */
 	static void normalizePi(double& angle)
 	{
-		normalize2Pi(angle);
-		if ( angle> PI ) angle-=2 * PI;
+		angle -= TWO_PI * ceil((angle - PI) * (1.0 / TWO_PI));
 	}
 
 	/**
@@ -129,6 +129,59 @@ public:
 	}
 
 
+	// -------- Array versions
+	// The loops have no branches or dependencies between the elements, so the compiler
+	// can vectorize them. In-place operation (pdIn == pdOut) is allowed.
+
+	/**
+	 * Converts iNum angles from radian to degree.
+	 */
+	static void convRadToDeg(const double* pdAngRad, double* pdAngDeg, int iNum)
+	{
+		for (int i = 0; i < iNum; i++)
+			pdAngDeg[i] = pdAngRad[i] * (180.0 / PI);
+	}
+
+	/**
+	 * Converts iNum angles from degree to radian.
+	 */
+	static void convDegToRad(const double* pdAngDeg, double* pdAngRad, int iNum)
+	{
+		for (int i = 0; i < iNum; i++)
+			pdAngRad[i] = pdAngDeg[i] * (PI / 180.0);
+	}
+
+	/**
+	 * Normalizes iNum angles to the interval [0,2pi[.
+	 */
+	static void normalize2Pi(double* pdAngles, int iNum)
+	{
+		for (int i = 0; i < iNum; i++)
+			pdAngles[i] -= TWO_PI * floor(pdAngles[i] * (1.0 / TWO_PI));
+	}
+
+	/**
+	 * Normalizes iNum angles to the interval ]-pi,pi].
+	 */
+	static void normalizePi(double* pdAngles, int iNum)
+	{
+		for (int i = 0; i < iNum; i++)
+			pdAngles[i] -= TWO_PI * ceil((pdAngles[i] - PI) * (1.0 / TWO_PI));
+	}
+
+	/**
+	 * Calculates the difference angles pdA[i]-pdB[i] of iNum angles.
+	 * The difference angles are normalized to the interval ]-pi,pi].
+	 */
+	static void calcDeltaAng(const double* pdA, const double* pdB, double* pdDelta, int iNum)
+	{
+		for (int i = 0; i < iNum; i++)
+		{
+			double c = pdA[i] - pdB[i];
+			pdDelta[i] = c - TWO_PI * ceil((c - PI) * (1.0 / TWO_PI));
+		}
+	}
+
 	/**
 	 * Calculates the arcus tangens and removes ambiguity in quadrant.
 	 */
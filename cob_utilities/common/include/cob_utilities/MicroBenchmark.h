@@ -0,0 +1,454 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef MICROBENCHMARK_INCLUDEDEF_H
+#define MICROBENCHMARK_INCLUDEDEF_H
+
+//-----------------------------------------------
+#include <regex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+//-----------------------------------------------
+
+/**
+ * Harness for micro-benchmarks of single functions, in the style of Google Benchmark.
+ *
+ * A benchmark is a function which prepares its data and then runs the measured code in
+ * while(state.keepRunning()). It is called with growing iteration counts until one run takes at least
+ * --min_time seconds, this run is reported. Data which can not be synthesized, like the ini files of a
+ * robot, are passed as --key=value and read with State::getArg(). Without them the benchmark calls
+ * State::skip() and is reported as skipped.
+ *
+ * usage: <executable> [--filter=regex] [--min_time=s] [--format=console|json] [--out=file.json] [--key=value ...]
+ *
+ * The JSON output has the layout of Google Benchmark (context, benchmarks with real_time and cpu_time in ns,
+ * items_per_second, error_occurred), so results of both can be tracked with the same tools.
+ * allocations_per_iteration is counted by the operator new of MICRO_BENCHMARK_MAIN().
+ */
+class MicroBenchmark
+{
+public:
+	class State
+	{
+	public:
+		State(uint64_t uiIterations, int64_t iArg, const std::map<std::string, std::string>* pmArgs) :
+			m_uiIterations(uiIterations), m_uiRemaining(uiIterations), m_iArg(iArg), m_pmArgs(pmArgs),
+			m_bStarted(false), m_bFinished(false), m_bSkipped(false), m_bPaused(false),
+			m_dRealTime(0), m_dCpuTime(0), m_ulAllocations(0), m_uiItemsProcessed(0)
+		{
+		}
+
+		/// Returns true once per iteration, the time between the first and the last call is measured.
+		bool keepRunning()
+		{
+			if(!m_bStarted)
+			{
+				m_bStarted = true;
+				startTiming();
+			}
+			if(m_uiRemaining > 0)
+			{
+				m_uiRemaining--;
+				return true;
+			}
+			if(!m_bFinished)
+			{
+				m_bFinished = true;
+				if(!m_bPaused)
+					stopTiming();
+			}
+			return false;
+		}
+
+		/// Excludes work inside the loop from the measurement, e.g. refilling a consumed buffer.
+		void pauseTiming()
+		{
+			if(m_bPaused)
+				return;
+			stopTiming();
+			m_bPaused = true;
+		}
+
+		void resumeTiming()
+		{
+			if(!m_bPaused)
+				return;
+			m_bPaused = false;
+			startTiming();
+		}
+
+		/// Ends the benchmark without a result, call it before the loop.
+		void skip(const std::string& sReason)
+		{
+			m_bSkipped = true;
+			m_sSkipReason = sReason;
+			m_uiRemaining = 0;
+		}
+
+		/// Items (e.g. beams or frames) processed by all iterations, reported as items_per_second.
+		void setItemsProcessed(uint64_t uiItems) {m_uiItemsProcessed = uiItems;}
+
+		uint64_t iterations() const {return m_uiIterations;}
+
+		/// Argument of a benchmark registered with MICRO_BENCHMARK_ARG, 0 otherwise.
+		int64_t range() const {return m_iArg;}
+
+		/// Value of the command line option --sKey=value, or sDefault.
+		std::string getArg(const std::string& sKey, const std::string& sDefault) const
+		{
+			std::map<std::string, std::string>::const_iterator it = m_pmArgs->find(sKey);
+			return (it == m_pmArgs->end()) ? sDefault : it->second;
+		}
+
+	private:
+		friend class MicroBenchmark;
+
+		void startTiming()
+		{
+			m_dRealStart = getRealTime();
+			m_dCpuStart = getCpuTime();
+			m_ulAllocationsStart = allocations();
+		}
+
+		void stopTiming()
+		{
+			m_dRealTime += getRealTime() - m_dRealStart;
+			m_dCpuTime += getCpuTime() - m_dCpuStart;
+			m_ulAllocations += allocations() - m_ulAllocationsStart;
+		}
+
+		uint64_t m_uiIterations;
+		uint64_t m_uiRemaining;
+		int64_t m_iArg;
+		const std::map<std::string, std::string>* m_pmArgs;
+		bool m_bStarted;
+		bool m_bFinished;
+		bool m_bSkipped;
+		bool m_bPaused;
+		std::string m_sSkipReason;
+		double m_dRealStart, m_dCpuStart;
+		unsigned long m_ulAllocationsStart;
+		double m_dRealTime, m_dCpuTime;
+		unsigned long m_ulAllocations;
+		uint64_t m_uiItemsProcessed;
+	};
+
+	typedef void (*Function)(State& state);
+
+	/// Adds a benchmark to the executable, use MICRO_BENCHMARK or MICRO_BENCHMARK_ARG.
+	static int registerBenchmark(const std::string& sName, Function pFunction, int64_t iArg)
+	{
+		Entry entry;
+		entry.sName = sName;
+		entry.pFunction = pFunction;
+		entry.iArg = iArg;
+		registry().push_back(entry);
+		return (int)registry().size();
+	}
+
+	/// Heap allocations of the process, incremented by the operator new of MICRO_BENCHMARK_ALLOCATION_COUNTER().
+	static unsigned long& allocations()
+	{
+		static unsigned long ulAllocations = 0;
+		return ulAllocations;
+	}
+
+	/// Monotonic time in seconds, also for benchmarks with their own main().
+	static double getRealTime()
+	{
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec + ts.tv_nsec*1e-9;
+	}
+
+	/// Runs the benchmarks selected by the command line, see the class description.
+	static int run(int argc, char** argv)
+	{
+		std::map<std::string, std::string> mArgs;
+		for(int i = 1; i < argc; i++)
+		{
+			const char* pcEqual = strchr(argv[i], '=');
+			if(strncmp(argv[i], "--", 2) != 0 || pcEqual == NULL)
+			{
+				std::cerr << "usage: " << argv[0]
+					<< " [--filter=regex] [--min_time=s] [--format=console|json] [--out=file.json] [--key=value ...]" << std::endl;
+				return 1;
+			}
+			mArgs[std::string(argv[i] + 2, pcEqual - argv[i] - 2)] = pcEqual + 1;
+		}
+
+		const std::string sFilter = mArgs.count("filter") ? mArgs["filter"] : ".";
+		const double dMinTime = mArgs.count("min_time") ? atof(mArgs["min_time"].c_str()) : 0.5;
+		const bool bJson = mArgs.count("format") && mArgs["format"] == "json";
+		regex_t filter;
+		if(regcomp(&filter, sFilter.c_str(), REG_EXTENDED | REG_NOSUB) != 0)
+		{
+			std::cerr << "invalid filter " << sFilter << std::endl;
+			return 1;
+		}
+
+		std::vector<Result> vResults;
+		for(size_t i = 0; i < registry().size(); i++)
+		{
+			const Entry& entry = registry()[i];
+			const std::string sName = entry.getName();
+			if(regexec(&filter, sName.c_str(), 0, NULL, 0) != 0)
+				continue;
+			vResults.push_back(measure(entry, dMinTime, mArgs));
+			if(!bJson)
+				printConsole(vResults.back());
+		}
+		regfree(&filter);
+
+		if(bJson)
+			writeJson(std::cout, argv[0], vResults);
+		if(mArgs.count("out"))
+		{
+			std::ofstream file(mArgs["out"].c_str());
+			writeJson(file, argv[0], vResults);
+			if(!file)
+			{
+				std::cerr << "could not write " << mArgs["out"] << std::endl;
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+private:
+	struct Entry
+	{
+		std::string sName;
+		Function pFunction;
+		int64_t iArg;
+
+		std::string getName() const
+		{
+			if(iArg == 0)
+				return sName;
+			std::ostringstream ss;
+			ss << sName << "/" << iArg;
+			return ss.str();
+		}
+	};
+
+	struct Result
+	{
+		std::string sName;
+		uint64_t uiIterations;
+		double dRealNs;
+		double dCpuNs;
+		double dItemsPerSecond;
+		double dAllocations;
+		bool bSkipped;
+		std::string sSkipReason;
+	};
+
+	static std::vector<Entry>& registry()
+	{
+		static std::vector<Entry> vEntries;
+		return vEntries;
+	}
+
+	static double getCpuTime()
+	{
+		timespec ts;
+		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+		return ts.tv_sec + ts.tv_nsec*1e-9;
+	}
+
+	static Result measure(const Entry& entry, double dMinTime, const std::map<std::string, std::string>& mArgs)
+	{
+		const uint64_t uiMaxIterations = 1000000000;
+		Result result;
+		result.sName = entry.getName();
+		result.bSkipped = false;
+
+		uint64_t uiIterations = 1;
+		while(true)
+		{
+			State state(uiIterations, entry.iArg, &mArgs);
+			entry.pFunction(state);
+			if(!state.m_bSkipped && !state.m_bFinished)
+				state.skip("keepRunning() was not called until it returned false");
+			if(state.m_bSkipped)
+			{
+				result.uiIterations = 0;
+				result.dRealNs = result.dCpuNs = result.dItemsPerSecond = result.dAllocations = 0;
+				result.bSkipped = true;
+				result.sSkipReason = state.m_sSkipReason;
+				return result;
+			}
+
+			if(state.m_dRealTime >= dMinTime || uiIterations >= uiMaxIterations)
+			{
+				result.uiIterations = uiIterations;
+				result.dRealNs = 1e9 * state.m_dRealTime / uiIterations;
+				result.dCpuNs = 1e9 * state.m_dCpuTime / uiIterations;
+				result.dItemsPerSecond = (state.m_dRealTime > 0) ? state.m_uiItemsProcessed / state.m_dRealTime : 0;
+				result.dAllocations = double(state.m_ulAllocations) / uiIterations;
+				return result;
+			}
+
+			// like Google Benchmark: aim 40 % above the minimum time, grow at most 10 times per run
+			double dMultiplier = 10.0;
+			if(state.m_dRealTime > 0.1 * dMinTime)
+				dMultiplier = 1.4 * dMinTime / state.m_dRealTime;
+			uint64_t uiNext = (uint64_t)(uiIterations * dMultiplier);
+			if(uiNext <= uiIterations)
+				uiNext = uiIterations + 1;
+			uiIterations = (uiNext < uiMaxIterations) ? uiNext : uiMaxIterations;
+		}
+	}
+
+	static void printConsole(const Result& result)
+	{
+		if(result.bSkipped)
+		{
+			printf("%-48s skipped: %s\n", result.sName.c_str(), result.sSkipReason.c_str());
+			return;
+		}
+		printf("%-48s %12.0f ns %12.0f ns %11llu", result.sName.c_str(), result.dRealNs, result.dCpuNs,
+			(unsigned long long)result.uiIterations);
+		if(result.dItemsPerSecond > 0)
+			printf(" %12.4g items/s", result.dItemsPerSecond);
+		printf(" %8.2f allocs\n", result.dAllocations);
+		fflush(stdout);
+	}
+
+	static std::string quote(const std::string& s)
+	{
+		std::string sQuoted = "\"";
+		for(size_t i = 0; i < s.size(); i++)
+		{
+			const unsigned char c = s[i];
+			if(c == '"' || c == '\\')
+				sQuoted += std::string("\\") + (char)c;
+			else if(c < 0x20)
+			{
+				char pcEscape[8];
+				snprintf(pcEscape, sizeof(pcEscape), "\\u%04x", c);
+				sQuoted += pcEscape;
+			}
+			else
+				sQuoted += (char)c;
+		}
+		return sQuoted + "\"";
+	}
+
+	static void writeJson(std::ostream& os, const char* pcExecutable, const std::vector<Result>& vResults)
+	{
+		char pcDate[64];
+		const time_t now = time(NULL);
+		strftime(pcDate, sizeof(pcDate), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+		char pcHost[256] = "";
+		gethostname(pcHost, sizeof(pcHost) - 1);
+
+		os.precision(10);
+		os << "{\n  \"context\": {\n"
+			<< "    \"date\": " << quote(pcDate) << ",\n"
+			<< "    \"host_name\": " << quote(pcHost) << ",\n"
+			<< "    \"executable\": " << quote(pcExecutable) << ",\n"
+			<< "    \"num_cpus\": " << sysconf(_SC_NPROCESSORS_ONLN) << "\n"
+			<< "  },\n  \"benchmarks\": [";
+		for(size_t i = 0; i < vResults.size(); i++)
+		{
+			const Result& result = vResults[i];
+			os << (i ? ",\n" : "\n") << "    {\n"
+				<< "      \"name\": " << quote(result.sName) << ",\n"
+				<< "      \"run_name\": " << quote(result.sName) << ",\n"
+				<< "      \"run_type\": \"iteration\",\n";
+			if(result.bSkipped)
+				os << "      \"error_occurred\": true,\n"
+					<< "      \"error_message\": " << quote(result.sSkipReason) << ",\n";
+			os << "      \"iterations\": " << result.uiIterations << ",\n"
+				<< "      \"real_time\": " << result.dRealNs << ",\n"
+				<< "      \"cpu_time\": " << result.dCpuNs << ",\n"
+				<< "      \"time_unit\": \"ns\",\n";
+			if(result.dItemsPerSecond > 0)
+				os << "      \"items_per_second\": " << result.dItemsPerSecond << ",\n";
+			os << "      \"allocations_per_iteration\": " << result.dAllocations << "\n    }";
+		}
+		os << "\n  ]\n}\n";
+	}
+};
+
+#define MICRO_BENCHMARK_CONCAT2(a, b) a##b
+#define MICRO_BENCHMARK_CONCAT(a, b) MICRO_BENCHMARK_CONCAT2(a, b)
+
+/// Registers void function(MicroBenchmark::State&) under its name.
+#define MICRO_BENCHMARK(function) \
+	static const int MICRO_BENCHMARK_CONCAT(s_iMicroBenchmark, __LINE__) = MicroBenchmark::registerBenchmark(#function, function, 0)
+
+/// Registers the function as "function/arg", the argument is State::range().
+#define MICRO_BENCHMARK_ARG(function, arg) \
+	static const int MICRO_BENCHMARK_CONCAT(s_iMicroBenchmark, __LINE__) = MicroBenchmark::registerBenchmark(#function, function, arg)
+
+// dynamic exception specifications are ill-formed since C++17
+#if __cplusplus >= 201103L
+#define MICRO_BENCHMARK_NOEXCEPT noexcept
+#else
+#define MICRO_BENCHMARK_NOEXCEPT throw()
+#endif
+
+// the sized delete of C++14 would bypass the replaced operator delete
+#if __cplusplus >= 201402L
+#define MICRO_BENCHMARK_SIZED_DELETE() \
+	void operator delete(void* p, std::size_t) noexcept \
+	{ \
+		free(p); \
+	}
+#else
+#define MICRO_BENCHMARK_SIZED_DELETE()
+#endif
+
+/// Defines the operator new which counts the allocations in MicroBenchmark::allocations(), once per executable.
+#define MICRO_BENCHMARK_ALLOCATION_COUNTER() \
+	void* operator new(std::size_t size) \
+	{ \
+		MicroBenchmark::allocations()++; \
+		void* p = malloc(size ? size : 1); \
+		if(!p) \
+			throw std::bad_alloc(); \
+		return p; \
+	} \
+	void operator delete(void* p) MICRO_BENCHMARK_NOEXCEPT \
+	{ \
+		free(p); \
+	} \
+	MICRO_BENCHMARK_SIZED_DELETE()
+
+/// Defines main() and the allocation counter, once per executable.
+#define MICRO_BENCHMARK_MAIN() \
+	MICRO_BENCHMARK_ALLOCATION_COUNTER() \
+	int main(int argc, char** argv) \
+	{ \
+		return MicroBenchmark::run(argc, argv); \
+	}
+
+#endif
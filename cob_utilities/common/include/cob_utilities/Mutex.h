@@ -19,25 +19,100 @@
 #define MUTEX_INCLUDEDEF_H
 //-----------------------------------------------
 #include <pthread.h>
+#include <time.h>
+#include <string>
+#include <boost/atomic.hpp>
 
 const unsigned int INFINITE = 0;
 
 
+/**
+ * Mutex with optional priority inheritance and spin phase.
+ * Priority inheritance lets a low priority owner run at the priority of a
+ * real-time thread waiting for the mutex, so it cannot be preempted by medium priority threads.
+ * With a spin count, lock() retries for a short while before the thread is put to sleep,
+ * which avoids the context switches for short critical sections.
+ */
 class Mutex
 {
+public:
+	/// Protocol of the mutex, see pthread_mutexattr_setprotocol().
+	enum Protocol
+	{
+		PROTOCOL_NONE,
+		PROTOCOL_INHERIT
+	};
+
+	/**
+	 * Contention counters since construction.
+	 */
+	struct Statistics
+	{
+		/// Successful calls of lock().
+		unsigned long ulLocks;
+		/// Locks which found the mutex owned by another thread.
+		unsigned long ulContended;
+		/// Contended locks which were acquired during the spin phase.
+		unsigned long ulSpinAcquired;
+		/// Timed locks which gave up.
+		unsigned long ulTimeouts;
+	};
+
 private:
 	pthread_mutex_t m_hMutex;
+	int m_iSpinCount;
+
+	boost::atomic<unsigned long> m_ulLocks;
+	boost::atomic<unsigned long> m_ulContended;
+	boost::atomic<unsigned long> m_ulSpinAcquired;
+	boost::atomic<unsigned long> m_ulTimeouts;
+
+	void init(Protocol protocol, int iSpinCount)
+	{
+		m_iSpinCount = iSpinCount;
+		m_ulLocks = 0;
+		m_ulContended = 0;
+		m_ulSpinAcquired = 0;
+		m_ulTimeouts = 0;
+
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+		if (protocol == PROTOCOL_INHERIT)
+			pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+		pthread_mutex_init(&m_hMutex, &attr);
+		pthread_mutexattr_destroy(&attr);
+	}
+
+	static void relax()
+	{
+#if defined(__i386__) || defined(__x86_64__)
+		__asm__ __volatile__("pause");
+#endif
+	}
+
+	// not copyable
+	Mutex(const Mutex&);
+	Mutex& operator=(const Mutex&);
 
 public:
 	Mutex()
 	{
-		pthread_mutex_init(&m_hMutex, 0);
+		init(PROTOCOL_NONE, 0);
 	}
 
 	Mutex( std::string sName)
 	{
 // no named Mutexes for POSIX
-		pthread_mutex_init(&m_hMutex, 0);
+		init(PROTOCOL_NONE, 0);
+	}
+
+	/**
+	 * @param protocol PROTOCOL_INHERIT for mutexes shared with real-time threads
+	 * @param iSpinCount number of lock attempts before blocking, 0 to block immediately
+	 */
+	Mutex( Protocol protocol, int iSpinCount = 0)
+	{
+		init(protocol, iSpinCount);
 	}
 
 	~Mutex()
@@ -49,7 +124,25 @@ public:
 	 */
 	bool lock( unsigned int uiTimeOut = INFINITE )
 	{
-		int ret;
+		int ret = pthread_mutex_trylock(&m_hMutex);
+		if (ret == 0)
+		{
+			m_ulLocks.fetch_add(1, boost::memory_order_relaxed);
+			return true;
+		}
+
+		m_ulContended.fetch_add(1, boost::memory_order_relaxed);
+
+		for (int i = 0; i < m_iSpinCount; i++)
+		{
+			relax();
+			if (pthread_mutex_trylock(&m_hMutex) == 0)
+			{
+				m_ulSpinAcquired.fetch_add(1, boost::memory_order_relaxed);
+				m_ulLocks.fetch_add(1, boost::memory_order_relaxed);
+				return true;
+			}
+		}
 
 		if (uiTimeOut == INFINITE)
 		{
@@ -59,8 +152,12 @@ public:
 		{
 			timespec abstime = { time(0) + uiTimeOut, 0 };
 			ret = pthread_mutex_timedlock(&m_hMutex, &abstime);
+			if (ret != 0)
+				m_ulTimeouts.fetch_add(1, boost::memory_order_relaxed);
 		}
 
+		if (ret == 0)
+			m_ulLocks.fetch_add(1, boost::memory_order_relaxed);
 		return ! ret;
 	}
 
@@ -68,7 +165,14 @@ public:
 	{
 		pthread_mutex_unlock(&m_hMutex);
 	}
+
+	void getStatistics(Statistics* pStatistics) const
+	{
+		pStatistics->ulLocks = m_ulLocks.load(boost::memory_order_relaxed);
+		pStatistics->ulContended = m_ulContended.load(boost::memory_order_relaxed);
+		pStatistics->ulSpinAcquired = m_ulSpinAcquired.load(boost::memory_order_relaxed);
+		pStatistics->ulTimeouts = m_ulTimeouts.load(boost::memory_order_relaxed);
+	}
 };
 //-----------------------------------------------
 #endif
-
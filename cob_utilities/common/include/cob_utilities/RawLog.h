@@ -0,0 +1,171 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef RAWLOG_INCLUDEDEF_H
+#define RAWLOG_INCLUDEDEF_H
+
+//-----------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <string>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+//-----------------------------------------------
+
+/**
+ * Fixed-size ring log of the raw data stream of a sensor, for the analysis of incidents.
+ * The received chunks are kept with their capture time in a memory mapped file, so the last
+ * minutes survive a crash of the driver and can be replayed through the parser later.
+ *
+ * write() is called on the hot path of the driver. It copies the chunk into a preallocated
+ * queue in memory and never blocks, allocates or enters the kernel. A background thread moves the
+ * chunks into the file, overwrites the oldest ones when the file is full and flushes it once per second.
+ * If the queue overflows, chunks are dropped and counted instead of stalling the driver.
+ *
+ * open() keeps the file of the previous run as "<file>.prev", so a restart of the driver
+ * does not overwrite the log of the incident which made it restart.
+ *
+ * @par example:
+ * @code
+ * 	RawLog log;
+ * 	log.open("/var/log/scanner_front.rawlog", 16 << 20, RawLog::SOURCE_SICK_S300, "/dev/ttyUSB0");
+ * 	...
+ * 	int n = read(fd, buf, sizeof(buf));
+ * 	log.write(buf, n, RawLog::now());
+ * @endcode
+ *
+ * \ingroup UtilitiesModul
+ */
+class RawLog
+{
+public:
+	/// Protocol of the logged stream, selects the parser for the replay.
+	enum Source
+	{
+		SOURCE_UNKNOWN = 0,
+		SOURCE_SICK_S300 = 1,
+		SOURCE_SICK_LMS1XX = 2
+	};
+
+	/// Header information of a log file.
+	struct Info
+	{
+		uint32_t uiSource;
+		/// size of the ring in the file
+		uint64_t ullCapacity;
+		/// number of chunks in the file
+		uint64_t ullRecords;
+		/// chunks lost because the queue was full, over the whole run
+		uint64_t ullDropped;
+		/// CLOCK_REALTIME - CLOCK_MONOTONIC in ns when the log was opened, converts capture times to wall time
+		int64_t llRealtimeOffsetNs;
+		/// free text given to open(), e.g. device and parser settings
+		std::string sDescription;
+	};
+
+	/// Called for each logged chunk, in capture order.
+	typedef boost::function<void (int64_t llTimeNs, const uint8_t* pData, size_t uiSize)> RecordCallback;
+
+	RawLog();
+	~RawLog();
+
+	/**
+	 * Creates the log file and starts the writer thread.
+	 * @param sFileName path of the log, an existing file is renamed to "<sFileName>.prev"
+	 * @param uiCapacity size of the ring in bytes, the file is allocated completely on open
+	 * @param uiSource one of Source
+	 * @param sDescription stored in the header for the replay
+	 * @param uiQueueSize size of the queue between write() and the writer thread, rounded up to a power of two
+	 * @return false if the file could not be created or mapped
+	 */
+	bool open(const std::string& sFileName, size_t uiCapacity, uint32_t uiSource,
+		const std::string& sDescription = "", size_t uiQueueSize = 1 << 20);
+
+	/// Writes the queued chunks, stops the writer thread and unmaps the file.
+	void close();
+
+	bool isOpen() const { return m_pFile != NULL; }
+
+	/**
+	 * Queues a chunk of received data. Only one thread may call write().
+	 * @param llTimeNs capture time on CLOCK_MONOTONIC in ns, see now()
+	 * @return false if the log is not open or the queue is full, the chunk is dropped then
+	 */
+	bool write(const void* pData, size_t uiSize, int64_t llTimeNs);
+
+	/// Chunks dropped since open() because the writer thread did not keep up.
+	uint64_t getDropped() const { return m_ullDropped.load(boost::memory_order_relaxed); }
+
+	/// Current time of CLOCK_MONOTONIC in ns.
+	static int64_t now();
+
+	/**
+	 * Reads a log file, which may also be the file of a running driver.
+	 * @param pInfo receives the header, may be NULL
+	 * @param callback called for each chunk from the oldest to the newest one, may be empty
+	 * @return false if the file is no valid log
+	 */
+	static bool replay(const std::string& sFileName, Info* pInfo, const RecordCallback& callback);
+
+private:
+	struct FileHeader;
+
+	// header of each chunk in queue and file, the data follows and is padded to c_uiAlign
+	struct RecordHeader
+	{
+		uint32_t uiSize;
+		uint32_t uiReserved;
+		int64_t llTimeNs;
+	};
+
+	static const size_t c_uiAlign = sizeof(RecordHeader);
+	// size of a record that only fills the rest of the ring up to its end
+	static const uint32_t c_uiWrap = 0xFFFFFFFF;
+
+	static size_t recordSize(size_t uiDataSize)
+	{
+		return (sizeof(RecordHeader) + uiDataSize + c_uiAlign - 1) & ~(c_uiAlign - 1);
+	}
+
+	static void* writerThread(void* pArg);
+	// moves the queued records into the file, returns false if the queue was empty
+	bool drainQueue();
+	void appendToFile(const RecordHeader& header, const uint8_t* pData);
+
+	FileHeader* m_pFile;
+	size_t m_uiFileSize;
+	uint8_t* m_pRing;
+
+	// single producer, single consumer queue, the positions count bytes and wrap at 2^64
+	uint8_t* m_pQueue;
+	size_t m_uiQueueSize;
+	boost::atomic<uint64_t> m_ullQueueHead;
+	boost::atomic<uint64_t> m_ullQueueTail;
+	boost::atomic<uint64_t> m_ullDropped;
+
+	pthread_t m_Thread;
+	boost::atomic<bool> m_bStop;
+
+	// not copyable
+	RawLog(const RawLog&);
+	RawLog& operator=(const RawLog&);
+};
+
+//-----------------------------------------------
+#endif
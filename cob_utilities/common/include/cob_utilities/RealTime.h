@@ -0,0 +1,80 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef REALTIME_INCLUDEDEF_H
+#define REALTIME_INCLUDEDEF_H
+
+//-----------------------------------------------
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <boost/atomic.hpp>
+//-----------------------------------------------
+
+/**
+ * Setup of a process and its loop threads for real-time operation.
+ * Locked memory, priorities and CPU pinning need the according limits (memlock, rtprio),
+ * the functions report what failed and the loop runs without it.
+ */
+class RealTime
+{
+public:
+	/**
+	 * Locks all current and future pages of the process into RAM (mlockall) and keeps freed heap memory
+	 * in the process, so allocations in the loops neither fault nor return memory to the system.
+	 * Affects the whole process, e.g. all nodelets of a manager.
+	 * @param uiHeapBytes heap that is allocated and touched once, so later allocations up to this size do not fault
+	 * @param psError reason if the memory could not be locked
+	 */
+	static bool lockMemory(size_t uiHeapBytes, std::string* psError);
+
+	/**
+	 * Prepares the calling thread, call it once at the start of the loop.
+	 * @param iPriority SCHED_FIFO priority, 0 keeps the default scheduling
+	 * @param iCpu CPU the thread is pinned to, -1 for any
+	 * @param uiStackBytes stack that is touched once, so the loop does not fault on it
+	 * @param psError reasons of the settings that failed, the others are applied anyway
+	 */
+	static bool setupThread(int iPriority, int iCpu, size_t uiStackBytes, std::string* psError);
+};
+
+/**
+ * Page faults of one thread, e.g. a control loop.
+ * update() is called by the thread itself, e.g. once per cycle, the totals can be read by any thread.
+ */
+class PageFaultCounter
+{
+public:
+	PageFaultCounter();
+
+	/// Adds the faults of the calling thread since the previous update, the first call only takes the start values.
+	void update();
+
+	/// Faults since the previous call, with bReset, or since the start.
+	void get(uint64_t* puiMinor, uint64_t* puiMajor, bool bReset);
+
+private:
+	boost::atomic<uint64_t> m_uiMinor;
+	boost::atomic<uint64_t> m_uiMajor;
+	// counters of the thread at the previous update, only used by the updating thread
+	bool m_bStarted;
+	uint64_t m_uiLastMinor;
+	uint64_t m_uiLastMajor;
+};
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef ROBOTSTATEBLACKBOARD_INCLUDEDEF_H
+#define ROBOTSTATEBLACKBOARD_INCLUDEDEF_H
+
+//-----------------------------------------------
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <boost/atomic.hpp>
+//-----------------------------------------------
+
+/**
+ * One value in shared memory, protected by a sequence lock.
+ * The sequence number is odd while the value is written, a reader copies the value
+ * and retries if the sequence number changed meanwhile. Readers never block writers.
+ * Concurrent writers (e.g. two processes that both provide the power state) are serialized
+ * by a robust process-shared mutex, a writer that died while holding it is detected by the next one.
+ * T has to be a plain struct without pointers, it is copied bytewise between processes.
+ */
+template <class T>
+struct SeqLockField
+{
+	/// 0 if the field has never been written.
+	boost::atomic<uint32_t> uiSeq;
+	pthread_mutex_t writeMutex;
+	T data;
+
+	/// Called once by the process that creates the shared memory, before any other process uses the field.
+	bool init()
+	{
+		pthread_mutexattr_t attr;
+		if(pthread_mutexattr_init(&attr) != 0)
+			return false;
+		bool bOk = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0
+			&& pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) == 0
+			&& pthread_mutex_init(&writeMutex, &attr) == 0;
+		pthread_mutexattr_destroy(&attr);
+		return bOk;
+	}
+
+	void write(const T& value)
+	{
+		if(pthread_mutex_lock(&writeMutex) == EOWNERDEAD)
+			pthread_mutex_consistent(&writeMutex);
+		uint32_t uiSeqOld = uiSeq.load(boost::memory_order_relaxed);
+		// the previous writer died while writing, its value is overwritten now
+		if(uiSeqOld & 1)
+			uiSeqOld++;
+		uiSeq.store(uiSeqOld + 1, boost::memory_order_relaxed);
+		boost::atomic_thread_fence(boost::memory_order_release);
+		memcpy(&data, &value, sizeof(T));
+		uiSeq.store(uiSeqOld + 2, boost::memory_order_release);
+		pthread_mutex_unlock(&writeMutex);
+	}
+
+	/**
+	 * @return sequence number of the copied value, even and increasing with every write,
+	 * 0 if the field was never written or a writer did not finish (e.g. it was killed while writing)
+	 */
+	uint32_t read(T* pValue) const
+	{
+		for(int i = 0; i < c_iMaxRetries; i++)
+		{
+			uint32_t uiSeqStart = uiSeq.load(boost::memory_order_acquire);
+			if(uiSeqStart & 1)
+				continue;
+			memcpy(pValue, (const void*)&data, sizeof(T));
+			boost::atomic_thread_fence(boost::memory_order_acquire);
+			if(uiSeq.load(boost::memory_order_relaxed) == uiSeqStart)
+				return uiSeqStart;
+		}
+		return 0;
+	}
+
+	// a write takes well below a microsecond, a field that stays locked for this many retries is dead
+	static const int c_iMaxRetries = 100000;
+};
+
+/**
+ * Latest state of the robot's power and safety hardware, shared between the driver processes
+ * of one machine through POSIX shared memory. Every driver writes the fields it owns and reads the
+ * others directly instead of subscribing to their topics, the topics are kept for everything else.
+ * All time stamps are CLOCK_MONOTONIC seconds, see getMonotonicTime().
+ */
+class RobotStateBlackboard
+{
+public:
+	/// Emergency stop as seen by the relayboard.
+	struct EmergencyStopData
+	{
+		/// EMFREE, EMSTOP or EMCONFIRMED of cob_msgs/EmergencyStopState
+		int32_t iState;
+		uint8_t bButtonStop;
+		uint8_t bScannerStop;
+		/// false if the relayboard does not answer, iState is EMSTOP then
+		uint8_t bOnline;
+		double dStampS;
+	};
+
+	/// Battery and charging state.
+	struct PowerData
+	{
+		double dVoltage;
+		/// negative while discharging
+		double dCurrent;
+		/// 0..100, negative if unknown
+		double dRelativeCapacity;
+		uint8_t bCharging;
+		double dStampS;
+	};
+
+	enum { MAX_MOTORS = 8 };
+
+	/// State of the base drives.
+	struct DriveData
+	{
+		int32_t iNumMotors;
+		uint8_t bInitialized;
+		uint8_t bError;
+		double dVelGearRadS[MAX_MOTORS];
+		int32_t iStatus[MAX_MOTORS];
+		double dStampS;
+	};
+
+	RobotStateBlackboard();
+	~RobotStateBlackboard();
+
+	/**
+	 * Maps the blackboard, it is created if no other process did so yet.
+	 * @param sName name of the shared memory object, all processes of one robot have to use the same
+	 * @return false if the object could not be mapped or was created by an incompatible version
+	 */
+	bool open(const std::string& sName = "cob_robot_state");
+	void close();
+	bool isOpen() const { return m_pLayout != NULL; }
+
+	/// Written by the relayboard driver.
+	void writeEmergencyStop(const EmergencyStopData& data) { m_pLayout->emergencyStop.write(data); }
+	/// @return sequence number of the value, 0 if it was never written
+	uint32_t readEmergencyStop(EmergencyStopData* pData) const { return m_pLayout->emergencyStop.read(pData); }
+
+	/// Written by the battery driver or the voltage control.
+	void writePower(const PowerData& data) { m_pLayout->power.write(data); }
+	uint32_t readPower(PowerData* pData) const { return m_pLayout->power.read(pData); }
+
+	/// Written by the base drive chain.
+	void writeDrives(const DriveData& data) { m_pLayout->drives.write(data); }
+	uint32_t readDrives(DriveData* pData) const { return m_pLayout->drives.read(pData); }
+
+	/// Time base of all stamps.
+	static double getMonotonicTime();
+
+private:
+	static const uint32_t c_uiMagic = 0x43424232;	// "CBB2"
+	// uiMagic while the creating process initializes the layout, the others wait for c_uiMagic
+	static const uint32_t c_uiInitializing = 0x43424230;	// "CBB0"
+
+	struct Layout
+	{
+		/// 0 in a new object, c_uiInitializing, then c_uiMagic once uiSize and the mutexes are set
+		boost::atomic<uint32_t> uiMagic;
+		uint32_t uiSize;
+		SeqLockField<EmergencyStopData> emergencyStop;
+		SeqLockField<PowerData> power;
+		SeqLockField<DriveData> drives;
+	};
+
+	Layout* m_pLayout;
+
+	// not copyable
+	RobotStateBlackboard(const RobotStateBlackboard&);
+	RobotStateBlackboard& operator=(const RobotStateBlackboard&);
+};
+
+//-----------------------------------------------
+#endif
@@ -24,8 +24,11 @@
 #include <string>
 #include <string.h>
 
+#include <boost/atomic.hpp>
+
 /**
  * Wrapper class for serial communication.
+ * Shared by the serial drivers (S300 laser scanner, relayboard, light controllers).
  */
 class SerialIO
 {
@@ -58,6 +61,22 @@ public:
 		SB_TWO
 	};
 
+	/**
+	 * Copy of the traffic counters at one point in time.
+	 */
+	struct Statistics
+	{
+		unsigned long ulBytesRead;
+		unsigned long ulBytesWritten;
+		unsigned long ulReads;
+		unsigned long ulWrites;
+		/// Failed reads and writes.
+		unsigned long ulErrors;
+		/// Time from waitForData reporting data until the next read, in us.
+		unsigned long ulMaxReadLatencyUs;
+		unsigned long ulSumReadLatencyUs;
+	};
+
 	/// Default constructor
 	SerialIO();
 
@@ -109,6 +128,19 @@ public:
 	void setBufferSize(int ReadBufSize, int WriteBufSize)
 		{ m_ReadBufSize = ReadBufSize; m_WriteBufSize = WriteBufSize; }
 
+	/**
+	 * Opens the port with O_NONBLOCK, reads and writes return immediately.
+	 * Has to be set before openIO.
+	 */
+	void setNonBlocking(bool NonBlocking) { m_NonBlocking = NonBlocking; }
+
+	/**
+	 * Requests ASYNC_LOW_LATENCY from the driver, so received bytes are handed out immediately
+	 * instead of after the driver's flush timer (up to 16 ms on many USB adapters).
+	 * Has to be set before openIO, drivers without support keep their default.
+	 */
+	void setLowLatency(bool LowLatency) { m_LowLatency = LowLatency; }
+
 	/**
 	 * Sets the timeout.
 	 * @param Timeout in seconds
@@ -152,6 +184,25 @@ public:
 	 */
 	int readNonBlocking(char *Buffer, int Length);
 
+	/**
+	 * Waits until data is available on the serial port.
+	 * Uses epoll, so the caller wakes up as soon as the driver delivers bytes.
+	 * @param Timeout in seconds, negative values wait forever
+	 * @return 1 if data is available, 0 on timeout, -1 on error
+	 */
+	int waitForData(double Timeout);
+
+	/**
+	 * Waits until a device node is plugged in or becomes accessible.
+	 * Returns as soon as udev creates or changes the node or a directory on its path
+	 * (e.g. /dev/serial/by-id/), so a driver can retry openIO immediately instead of polling.
+	 * Other changes in these directories wake the caller as well.
+	 * @param DeviceName path of the device node
+	 * @param Timeout in seconds, negative values wait forever
+	 * @return 1 on a change, 0 on timeout, -1 on error
+	 */
+	static int waitForDevice(const char *DeviceName, double Timeout);
+
 	/**
 	 * Writes bytes to the serial port.
 	 * @param Buffer buffer of the message
@@ -164,6 +215,22 @@ public:
 	 */
 	int getSizeRXQueue();
 
+	/**
+	 * Returns true if the port is open.
+	 */
+	bool isOpen() const { return m_Device != -1; }
+
+	/**
+	 * Returns the file descriptor of the open port, -1 if it is closed.
+	 * For callers which have to wait on several descriptors at once.
+	 */
+	int getDescriptor() const { return m_Device; }
+
+	/**
+	 * Copies the traffic counters, may be called from any thread.
+	 */
+	void getStatistics(Statistics* pStatistics) const;
+
 
 	/** Clears the read and transmit buffer.
 	 */
@@ -198,6 +265,7 @@ protected:
 	::termios m_tio;
 	std::string m_DeviceName;
 	int m_Device;
+	int m_Epoll;
 	int m_BaudRate;
 	double m_Multiplier;
 	int m_ByteSize, m_StopBits;
@@ -207,6 +275,23 @@ protected:
 	double m_Timeout;
 	::timeval m_BytePeriod;
 	bool m_ShortBytePeriod;
+	bool m_NonBlocking;
+	bool m_LowLatency;
+
+	/// Counts a read or write, negative results are errors.
+	void countRead(int BytesRead);
+	void countWrite(int BytesWritten);
+
+	// monotonic time in us when waitForData last reported data, 0 if it was consumed
+	long long m_DataReadyUs;
+
+	boost::atomic<unsigned long> m_BytesRead;
+	boost::atomic<unsigned long> m_BytesWritten;
+	boost::atomic<unsigned long> m_Reads;
+	boost::atomic<unsigned long> m_Writes;
+	boost::atomic<unsigned long> m_Errors;
+	boost::atomic<unsigned long> m_MaxReadLatencyUs;
+	boost::atomic<unsigned long> m_SumReadLatencyUs;
 };
 
 
@@ -19,20 +19,32 @@
 #define _TimeStamp_H
 
 #include <time.h>
+#include <stdint.h>
 #include <cob_utilities/StrUtil.h>
 
 //-------------------------------------------------------------------
 
 /** Measure system time.
- * Use this class for measure system time accurately. Under Windows, it uses
- * QueryPerformanceCounter(), which has a resolution of approx. one micro-second.
- * The difference between two time stamps can be calculated.
+ * Use this class for measure system time accurately.
+ * The time is stored as integer nanoseconds of the selected clock. The default
+ * clock is CLOCK_MONOTONIC, which is not affected by changes of the system time
+ * and is read through the vDSO without a system call.
+ * The difference between two time stamps can be calculated, both must use the same clock.
  */
 class TimeStamp
 {
 	public:
+		/// Clock read by SetNow().
+		enum ClockType
+		{
+			/// Steady clock for measuring time differences.
+			CLOCK_TYPE_MONOTONIC,
+			/// Wall clock in seconds since the epoch, needed for ToString() and absolute times.
+			CLOCK_TYPE_REALTIME
+		};
+
 		/// Constructor.
-		TimeStamp();
+		TimeStamp(ClockType Clock = CLOCK_TYPE_MONOTONIC);
 
 		/// Destructor.
 		virtual ~TimeStamp() {};
@@ -43,6 +55,9 @@ class TimeStamp
 		/// Retrieves time difference in seconds.
 		double operator- ( const TimeStamp& EarlierTime ) const;
 
+		/// Retrieves time difference in nanoseconds.
+		int64_t NanoSecondsSince ( const TimeStamp& EarlierTime ) const;
+
 		/// Increase the timestamp by TimeS seconds.
 		/** @param TimeS must be >0!.
 		 */
@@ -75,20 +90,24 @@ class TimeStamp
 		 */
 		std::string CurrentToString();
 
+		/**
+		 * return the time stamp as string, in long format YYYY-MM-DD HH:MM:SS.ssssss
+		 * Only meaningful for CLOCK_TYPE_REALTIME.
+		 */
 		std::string ToString();
 
 	protected:
 
-		/// Internal time stamp data.
-		timespec m_TimeStamp;
+		/// Internal time stamp data in nanoseconds.
+		int64_t m_llNanoSec;
 
-	private:
+		/// Clock of the time stamp.
+		ClockType m_Clock;
 
-		/// Conversion timespec -> double
-		static double TimespecToDouble ( const ::timespec& LargeInt );
+	private:
 
-		/// Conversion double -> timespec
-		static ::timespec DoubleToTimespec ( double TimeS );
+		/// Conversion seconds -> nanoseconds
+		static int64_t SecondsToNanoSec ( double TimeS );
 
 };
 
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#ifndef TRACE_INCLUDEDEF_H
+#define TRACE_INCLUDEDEF_H
+//-----------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <boost/atomic.hpp>
+//-----------------------------------------------
+
+/**
+ * Scoped trace spans for the hot paths of the drivers.
+ * Every thread records its spans into its own ring buffer without locking, the buffers can be
+ * written as Chrome trace event file, which chrome://tracing and ui.perfetto.dev display.
+ * The spans are stamped with CLOCK_MONOTONIC, so files of several nodes on one host can be
+ * loaded together to follow a sensor reading up to the motor command.
+ *
+ * Startup phases (TRACE_PHASE) are always recorded, they show where the time until a driver is
+ * ready goes and are written to the same file.
+ *
+ * Tracing is disabled by default and a span then costs a single relaxed load.
+ * If the environment variable COB_TRACE_FILE is set, tracing is enabled at startup and the
+ * trace is written to "$COB_TRACE_FILE.<pid>.json" when the process exits.
+ *
+ * @par example:
+ * @code
+ * 	void CalcControlStep()
+ * 	{
+ * 		TRACE_SCOPE("UndercarriageCtrlGeom::CalcControlStep");
+ * 		...
+ * 	}
+ * @endcode
+ *
+ * \ingroup UtilitiesModul
+ */
+class Trace
+{
+public:
+	/// Default number of spans kept per thread.
+	static const size_t c_uiDefaultEventsPerThread = 16384;
+
+	/**
+	 * Starts recording spans.
+	 * @param uiEventsPerThread size of the ring buffers, only used for threads which did not record yet
+	 */
+	static void enable(size_t uiEventsPerThread = c_uiDefaultEventsPerThread);
+
+	/// Stops recording spans, the recorded spans are kept.
+	static void disable();
+
+	static bool isEnabled()
+	{
+		return s_bEnabled.load(boost::memory_order_relaxed);
+	}
+
+	/// Current time of CLOCK_MONOTONIC in ns.
+	static int64_t now();
+
+	/**
+	 * Records a span in the ring buffer of the calling thread.
+	 * @param pName name of the span, must stay valid until the trace is written (use string literals)
+	 */
+	static void record(const char* pName, int64_t llStartNs, int64_t llEndNs);
+
+	/**
+	 * Writes the spans of all threads in Chrome trace event format.
+	 * May be called while other threads are recording, spans overwritten during the dump are skipped.
+	 * @return false if the file could not be written
+	 */
+	static bool dump(const std::string& sFileName);
+
+	/**
+	 * Records a startup phase, use TRACE_PHASE instead of calling it directly.
+	 * Phases are recorded even if tracing is disabled and are never overwritten by spans,
+	 * they are meant for the few long steps until a driver is ready (parsing, opening devices, homing).
+	 * @param pName name of the phase, must stay valid until the trace is written (use string literals)
+	 */
+	static void recordPhase(const char* pName, int64_t llStartNs, int64_t llEndNs);
+
+	/**
+	 * Returns one line per recorded phase with its start since the process start and its duration,
+	 * for the log of the driver once it is ready.
+	 */
+	static std::string getPhaseSummary();
+
+private:
+	static boost::atomic<bool> s_bEnabled;
+};
+
+/**
+ * Records the time between construction and destruction as span.
+ * Use TRACE_SCOPE instead of constructing it directly.
+ */
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char* pName)
+		: m_pName(pName), m_llStartNs(Trace::isEnabled() ? Trace::now() : -1)
+	{
+	}
+
+	~TraceSpan()
+	{
+		if(m_llStartNs >= 0)
+			Trace::record(m_pName, m_llStartNs, Trace::now());
+	}
+
+private:
+	const char* m_pName;
+	int64_t m_llStartNs;
+
+	// not copyable
+	TraceSpan(const TraceSpan&);
+	TraceSpan& operator=(const TraceSpan&);
+};
+
+/**
+ * Records the time between construction and destruction as startup phase.
+ * Use TRACE_PHASE instead of constructing it directly.
+ */
+class TracePhase
+{
+public:
+	explicit TracePhase(const char* pName)
+		: m_pName(pName), m_llStartNs(Trace::now())
+	{
+	}
+
+	~TracePhase()
+	{
+		Trace::recordPhase(m_pName, m_llStartNs, Trace::now());
+	}
+
+private:
+	const char* m_pName;
+	int64_t m_llStartNs;
+
+	// not copyable
+	TracePhase(const TracePhase&);
+	TracePhase& operator=(const TracePhase&);
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+/// Traces the enclosing scope under the given name.
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+/// Records the enclosing scope as startup phase under the given name.
+#define TRACE_PHASE(name) TracePhase TRACE_CONCAT(tracePhase, __LINE__)(name)
+
+//-----------------------------------------------
+#endif
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef TRIPLEBUFFER_INCLUDEDEF_H
+#define TRIPLEBUFFER_INCLUDEDEF_H
+
+//-----------------------------------------------
+#include <boost/atomic.hpp>
+//-----------------------------------------------
+
+/**
+ * Wait-free handoff of the latest value from one writer thread to one reader thread.
+ * Writer and reader each own a slot, the third slot is swapped atomically between them,
+ * so neither side ever blocks or sees a half written value.
+ * Intermediate values are dropped if the writer is faster than the reader.
+ */
+template <class T>
+class TripleBuffer
+{
+public:
+	/**
+	 * Initializes all slots with the given value, e.g. to preallocate vectors.
+	 */
+	TripleBuffer(const T& init = T())
+	{
+		m_Slots[0] = init;
+		m_Slots[1] = init;
+		m_Slots[2] = init;
+		m_iWriteSlot = 0;
+		m_iReadSlot = 1;
+		m_iShared = 2;
+	}
+
+	/**
+	 * Returns the slot owned by the writer. Fill it and call publish().
+	 */
+	T& writeSlot()
+	{
+		return m_Slots[m_iWriteSlot];
+	}
+
+	/**
+	 * Hands the write slot over to the reader.
+	 */
+	void publish()
+	{
+		m_iWriteSlot = m_iShared.exchange(m_iWriteSlot | c_iNewData, boost::memory_order_acq_rel) & c_iSlotMask;
+	}
+
+	/**
+	 * Copies a value into the write slot and publishes it.
+	 */
+	void write(const T& value)
+	{
+		writeSlot() = value;
+		publish();
+	}
+
+	/**
+	 * Fetches the most recently published value, if there is one.
+	 * @return true if a new value was published since the last call
+	 */
+	bool update()
+	{
+		if( (m_iShared.load(boost::memory_order_relaxed) & c_iNewData) == 0 )
+			return false;
+
+		m_iReadSlot = m_iShared.exchange(m_iReadSlot, boost::memory_order_acq_rel) & c_iSlotMask;
+		return true;
+	}
+
+	/**
+	 * Returns the value fetched by the last update().
+	 */
+	const T& readSlot() const
+	{
+		return m_Slots[m_iReadSlot];
+	}
+
+private:
+	static const int c_iSlotMask = 0x3;
+	static const int c_iNewData = 0x4;
+
+	T m_Slots[3];
+	int m_iWriteSlot;
+	int m_iReadSlot;
+	// index of the spare slot, c_iNewData set if it holds an unread value
+	boost::atomic<int> m_iShared;
+};
+//-----------------------------------------------
+#endif
@@ -25,147 +25,184 @@
 using namespace std;
 
 //-------------------------------------------------------------------
-IniFile::IniFile(): m_vectorSize(500), m_CurCharInd(0)
+IniFile::IniFile()
 {
 	m_bFileOK=false;
-	m_CurLine.resize(m_vectorSize);
+	m_bDirty=false;
+	m_bEndsWithNewline=true;
 }
 //--------------------------------------------------------------------------------
 
-IniFile::IniFile(std::string fileName): m_vectorSize(500), m_CurCharInd(0)
+IniFile::IniFile(std::string fileName)
 {
 	m_bFileOK=false;
-	m_CurLine.resize(m_vectorSize);
+	m_bDirty=false;
+	m_bEndsWithNewline=true;
 	if(fileName != "")
 		SetFileName(fileName);
 }
 //--------------------------------------------------------------------------------
 IniFile::~IniFile()
 {
+	Flush();
 }
 //--------------------------------------------------------------------------------
 int IniFile::SetFileName(std::string fileName, std::string strIniFileUsedBy, bool bCreate)
 {
+	// write back modifications of the previous file before switching
+	Flush();
+
 	m_fileName = fileName;
 	m_strIniFileUsedBy = strIniFileUsedBy;
+	m_bFileOK = false;
+
+	if (ReadFile(bCreate) != 0)
+		return -1;
 
-	if ((f = fopen(m_fileName.c_str(),"r")) == NULL)
+	m_bFileOK = true;
+	return 0;
+}
+//--------------------------------------------------------------------------------
+int IniFile::ReadFile(bool bCreate)
+{
+	m_vLines.clear();
+	m_bEndsWithNewline = true;
+
+	FILE* f = fopen(m_fileName.c_str(),"r");
+	if (f == NULL)
 	{
 		if (bCreate == true)
 		{
 			f = fopen(m_fileName.c_str(),"w");	// create new file
 			std::cout << "Creating new INI-File " << m_fileName.c_str() << std::endl;
-			fclose(f);
+			if (f != NULL)
+				fclose(f);
+			BuildIndex();
+			return 0;
 		}
 		else
 		{
 			std::cout << "INI-File not found " << m_fileName.c_str() << std::endl;
+			BuildIndex();
 			return -1;
 		}
 	}
-	else fclose(f);
-	m_bFileOK = true;
+
+	std::string strLine;
+	char buf[512];
+	while (fgets(buf, sizeof(buf), f) != NULL)
+	{
+		size_t len = strlen(buf);
+		if (len > 0 && buf[len-1] == '\n')
+		{
+			strLine.append(buf, len-1);
+			m_vLines.push_back(strLine);
+			strLine.clear();
+		}
+		else
+		{
+			strLine.append(buf, len);	// line longer than buf or last line without newline
+		}
+	}
+	if (!strLine.empty())
+	{
+		m_vLines.push_back(strLine);
+		m_bEndsWithNewline = false;
+	}
+	fclose(f);
+
+	BuildIndex();
 	return 0;
 }
 //--------------------------------------------------------------------------------
-int IniFile::WriteKeyString(const char* pSect, const char* pKey, const std::string* pStrToWrite, bool bWarnIfNotfound)
+void IniFile::BuildIndex()
 {
-	std::string StrWithDelimeters = '"' + *pStrToWrite + '"';
-	return WriteKeyValue(pSect, pKey, StrWithDelimeters.c_str(), bWarnIfNotfound);
-}
-//--------------------------------------------------------------------------------
-int IniFile::WriteKeyValue(const char* szSect,const char* szKey,const char* szValue, bool bWarnIfNotfound)
-{
-	if (!m_bFileOK) return -1;
-
-	FILE* ftemp;
-	int   lS,lK,i,bEoff;
-	int   bFoundSect,bFoundKey;
-	char  c;
-	long fpos;
+	m_sections.clear();
+	m_vSectionOrder.clear();
 
+	Section* pCurSect = NULL;
+	for (int i = 0; i < (int)m_vLines.size(); i++)
+	{
+		const std::string& line = m_vLines[i];
 
-/*------------------------verifications*/
+		size_t first = line.find_first_not_of(' ');
+		if (first == std::string::npos)
+			continue;	// empty line
 
-	bFoundSect = 1 /* true*/;
-	bFoundKey = 0 /* */;
-	bEoff = 0;
-	lS = strlen(szSect);
-	lK = strlen(szKey);
-	if ((lS * lK) == 0) return -1;
+		if (line[first] == '[')
+		{
+			// any bracket ends the keys of the current section
+			pCurSect = NULL;
 
-/*--------------------- file opening */
+			size_t end = line.find(']');
+			if (first == 0 && end != std::string::npos)
+			{
+				std::string name = line.substr(1, end-1);
+				m_vSectionOrder.push_back(name);
+				if (m_sections.find(name) == m_sections.end())
+				{
+					pCurSect = &m_sections[name];
+					pCurSect->iHeader = i;
+					pCurSect->iLast = i;
+				}
+			}
+			continue;
+		}
 
-	f = fopen(m_fileName.c_str(),"r");
-	if (f == NULL)
-	{
-		std::cout << "INI-File not found " << m_fileName.c_str() << std::endl;
-		return -1;
-	}
-	if ((ftemp = tmpfile()) == NULL)
-	{
-		std::cout << "tmpfile() did not work!" << std::endl;
-		return -1;
-	}
+		if (pCurSect == NULL)
+			continue;
+		pCurSect->iLast = i;
 
+		size_t eq = line.find('=', first);
+		if (eq == std::string::npos)
+			continue;
+		size_t keyEnd = line.find_last_not_of(' ', eq-1);
+		if (keyEnd == std::string::npos || keyEnd < first)
+			continue;
 
-/* ---------------------- search section and key */
-	if (FindSection(szSect, bWarnIfNotfound) != 0)
-	{
-		bFoundSect = 0;
-	}
-	fpos = ftell(f);
-	if (bFoundSect)
-	{
-		if (!FindKey(szKey, false))	bFoundKey = 1;
-		fpos = ftell(f);
+		// the first definition of a key wins
+		pCurSect->keys.insert(std::make_pair(line.substr(first, keyEnd-first+1), i));
 	}
-	if (feof(f)) bEoff = 1;
-
-/* --------------------- updating the file */
-	fseek(f,0,SEEK_SET);
-	for (i=0;i<fpos;i++)
-	{
-		fscanf(f,"%c",&c);
-		fprintf(ftemp,"%c",c);
-		// MMB/23.02.2006: The counter i must not be incremented here on Linux machines!
-#ifdef WIN32
-		if (c=='\n')
-			i++;
-#endif
-	};
+}
+//--------------------------------------------------------------------------------
+const std::string* IniFile::FindValue(const char* szSect, const char* szKey, size_t* pValuePos,
+									bool bWarnIfNotfound)
+{
+	if (!m_bFileOK) return NULL;
+	if ((szSect[0] == '\0') || (szKey[0] == '\0')) return NULL;
 
-	if (!bFoundSect) {
-		fprintf(ftemp,"\n\n[%s]\n",szSect);
-	}
-	if (bFoundSect && (!bFoundKey) && (bEoff))
+	boost::unordered_map<std::string, Section>::const_iterator itSect = m_sections.find(szSect);
+	if (itSect == m_sections.end())
 	{
-		fprintf(ftemp,"\n");
+		if(bWarnIfNotfound)
+		{
+			std::cout << "Section [" << szSect << "] in IniFile " << m_fileName.c_str() << " used by "
+				<< m_strIniFileUsedBy << " not found" << std::endl;
+		}
+		return NULL;
 	}
 
-
-	if (!bFoundKey)
+	boost::unordered_map<std::string, int>::const_iterator itKey = itSect->second.keys.find(szKey);
+	if (itKey == itSect->second.keys.end())
 	{
-		fprintf(ftemp,"%s=",szKey);
-	}
-
-	fprintf(ftemp,"%s",szValue);
-
-	if (bFoundKey) FindNextLine(m_CurLine, m_CurCharInd);
-	if (!(bEoff || feof(f)))
-	{	fprintf(ftemp,"\n");
-		while (!feof(f))
+		if(bWarnIfNotfound)
 		{
-			fscanf(f,"%c",&c);
-			if (!feof(f))
-			{
-				fprintf(ftemp,"%c",c);
-			}
+			std::cout << "Key " << szKey << " in IniFile '" << m_fileName.c_str() << "' used by "
+				<< m_strIniFileUsedBy << " not found" << std::endl;
 		}
+		return NULL;
 	}
-	fpos = ftell(ftemp);
-	fclose(f);
 
+	const std::string& line = m_vLines[itKey->second];
+	*pValuePos = line.find('=') + 1;
+	return &line;
+}
+//--------------------------------------------------------------------------------
+int IniFile::Flush()
+{
+	if (!m_bFileOK || !m_bDirty) return 0;
+
+	FILE* f;
 	if ((f = fopen(m_fileName.c_str(),"w")) == NULL)
 	{
 		if ((f = fopen(m_fileName.c_str(),"r")) != NULL)
@@ -178,16 +215,67 @@ int IniFile::WriteKeyValue(const char* szSect,const char* szKey,const char* szVa
 		std::cout << "INI-File not found " << m_fileName.c_str() << std::endl;
 		return -1;
 	}
-	fseek(ftemp,0,SEEK_SET);
-	for (i=0;i<fpos;i++)
+	for (size_t i = 0; i < m_vLines.size(); i++)
 	{
-		fscanf(ftemp,"%c",&c);
-		fprintf(f,"%c",c);
-	};
+		fputs(m_vLines[i].c_str(), f);
+		if (i + 1 < m_vLines.size() || m_bEndsWithNewline)
+			fputc('\n', f);
+	}
 	fclose(f);
-	fclose(ftemp);
+
+	m_bDirty = false;
 	return 0;
+}
+//--------------------------------------------------------------------------------
+int IniFile::WriteKeyString(const char* pSect, const char* pKey, const std::string* pStrToWrite, bool bWarnIfNotfound)
+{
+	std::string StrWithDelimeters = '"' + *pStrToWrite + '"';
+	return WriteKeyValue(pSect, pKey, StrWithDelimeters.c_str(), bWarnIfNotfound);
+}
+//--------------------------------------------------------------------------------
+int IniFile::WriteKeyValue(const char* szSect,const char* szKey,const char* szValue, bool bWarnIfNotfound)
+{
+	if (!m_bFileOK) return -1;
+	if ((szSect[0] == '\0') || (szKey[0] == '\0')) return -1;
 
+	std::string strKeyLine = std::string(szKey) + "=" + szValue;
+
+	boost::unordered_map<std::string, Section>::iterator itSect = m_sections.find(szSect);
+	if (itSect == m_sections.end())
+	{
+		if(bWarnIfNotfound)
+		{
+			std::cout << "Section [" << szSect << "] in IniFile " << m_fileName.c_str() << " used by "
+				<< m_strIniFileUsedBy << " not found" << std::endl;
+		}
+
+		// append new section at the end of the file
+		if (!m_vLines.empty())
+			m_vLines.push_back("");
+		m_vLines.push_back(std::string("[") + szSect + "]");
+		m_vLines.push_back(strKeyLine);
+		m_bEndsWithNewline = true;
+		BuildIndex();
+	}
+	else
+	{
+		boost::unordered_map<std::string, int>::iterator itKey = itSect->second.keys.find(szKey);
+		if (itKey != itSect->second.keys.end())
+		{
+			// replace the value, comments in the same line are deleted
+			std::string& line = m_vLines[itKey->second];
+			line = line.substr(0, line.find('=') + 1) + szValue;
+		}
+		else
+		{
+			// append new key at the end of the section
+			m_vLines.insert(m_vLines.begin() + itSect->second.iLast + 1, strKeyLine);
+			BuildIndex();
+		}
+	}
+
+	m_bDirty = true;
+	return 0;
 }
 //--------------------------------------------------------------------------------
 int IniFile::WriteKeyBool(const char* pSect, const char* pKey, bool bValue, bool bWarnIfNotfound)
@@ -320,307 +408,76 @@ int IniFile::GetKeyDouble(const char* pSect,const char* pKey,double* pValue,
 int IniFile::GetKeyValue(const char* szSect,const char* szKey,char* szBuf,
 						int lenBuf,	bool bWarnIfNotfound)
 {
-	if (!m_bFileOK) return -1;
-
-	int   lS,lK;
-
-	lS = strlen(szSect);
-	lK = strlen(szKey);
-	if ((lS * lK) == 0) return -1;
-	if ((f = fopen(m_fileName.c_str(),"r")) == NULL)
-	{
-		std::cout << "INI-File not found " << m_fileName.c_str() << std::endl;
-		return -1;
-	}
-	if ( FindSection(szSect, bWarnIfNotfound) )
-	{	fclose(f);
-		return -1;
-	}
-	if ( FindKey(szKey, bWarnIfNotfound) )
-	{	fclose(f);
-		return -1;
-	}
-
-	if (feof(f))
-	{
-		fclose(f);
+	size_t valuePos;
+	const std::string* pLine = FindValue(szSect, szKey, &valuePos, bWarnIfNotfound);
+	if (pLine == NULL)
 		return -1;
-	}
-
-	//----------- read szBuf bytes from file into szKey
-	int BytesRead = fread( szBuf, 1, lenBuf, f );
 
-	// terminate string
-	int StrLen;
-	if(BytesRead < lenBuf)
-	{
-		if( BytesRead == 0 && (!feof(f)) )
-		{
-			std::cout << "file read" << std::endl;
-		}
-		StrLen = BytesRead;
-	}
-	else
-	{
-		StrLen = lenBuf-1;
-	}
+	//----------- copy at most lenBuf-1 chars of the value into szBuf
+	int StrLen = pLine->copy(szBuf, lenBuf-1, valuePos);
 	szBuf[StrLen] = '\0';
-
-	fclose(f);
 	return StrLen;
 }
 //--------------------------------------------------------------------------------
 int IniFile::GetKeyString(const char* szSect,const char* szKey, std::string* pStrToRead,
 							bool bWarnIfNotfound)
 {
-	if (!m_bFileOK) return -1;
-
-	int   lS,lK;
-
-	lS = strlen(szSect);
-	lK = strlen(szKey);
-	if ((lS * lK) == 0) return -1;
-	if ((f = fopen(m_fileName.c_str(),"r")) == NULL)
-	{
-		std::cout << "INI-File not found " << m_fileName.c_str() << std::endl;
-		return -1;
-	}
-	if ( FindSection(szSect, bWarnIfNotfound) )
-	{	fclose(f);
-		return -1;
-	}
-	if ( FindKey(szKey, bWarnIfNotfound) )
-	{	fclose(f);
+	size_t valuePos;
+	const std::string* pLine = FindValue(szSect, szKey, &valuePos, bWarnIfNotfound);
+	if (pLine == NULL)
 		return -1;
-	}
 
-	if (feof(f))
-	{
-		fclose(f);
-		return -1;
-	}
-
-	//----------- read szBuf bytes from file into szKey
-	int res = SkipLineUntil(f, '"'); // find begin of string
-	if(res == -1)
+	size_t begin = pLine->find('"', valuePos); // find begin of string
+	if(begin == std::string::npos)
 	{	if(bWarnIfNotfound)
 		{
 			std::cout << "GetKeyString section " << szSect << " key " << szKey << " first \" not found" << std::endl;
 		}
-		fclose(f);
 		return -1;
 	}
 
-	std::string strRead;
-	res = ReadLineUntil(f, '"', strRead); // read string
-	if(res == -1)
+	size_t end = pLine->find('"', begin+1); // read string
+	if(end == std::string::npos)
 	{
 		if(bWarnIfNotfound)
 		{
 			std::cout << "GetKeyString section " << szSect << " key " << szKey << " string not found" << std::endl;
 		}
-		fclose(f);
 		return -1;
 	}
 
 	// success
-	*pStrToRead = strRead;
-	fclose(f);
+	*pStrToRead = pLine->substr(begin+1, end-begin-1);
 	return 0;
 }
 //--------------------------------------------------------------------------------
-int IniFile::SkipLineUntil(FILE* pFile, const char EndChar)
-{
-	int CharsRead = 0;
-	while (1)
-	{
-		int Char = fgetc(pFile);
-
-		if (Char == EndChar)			// end found?
-			return CharsRead;			// read finished
-
-		if (Char == EOF || Char == '\n')
-			return -1;				// end not found
-
-		CharsRead++;
-	}
-}
-//--------------------------------------------------------------------------------
-int IniFile::ReadLineUntil(FILE* pFile, const char EndChar, std::string& ReadIntoStr)
-{
-	int CharsRead = 0;
-	while (1)
-	{
-		int Char = fgetc(pFile);
-
-		if (Char == EndChar)			// end found?
-			return CharsRead;			// read finished
-
-		if (Char == EOF || Char == '\n')
-			return -1;				// end not found
-
-		ReadIntoStr.append(1, char(Char));
-
-		CharsRead++;
-	}
-}
-//--------------------------------------------------------------------------------
-int IniFile::FindNextLine(std::vector<char>& NewLine, int& CharInd)
-{
-	if (!feof(f))
-	{
-		fgets(&NewLine[0], NewLine.size(), f); // store next line in NewLine
-		CharInd=0;        // makes CharInd reference the first char of the line
-		return 0;
-	}
-	return -1;
-}
-//--------------------------------------------------------------------------------
 int IniFile::FindNextSection(std::string* pSect, std::string prevSect, bool bWarnIfNotfound)
 {
-	std::vector<char> line;
-	//int charInd = 0;
-	//int res = -1;
-
 	if (!m_bFileOK) return -1;
 
 	// Make sure that there is no old data.
 	pSect->erase();
 
-/*--------------------- file opening */
-	f = fopen(m_fileName.c_str(),"r");
-	if (f == NULL)
-	{
-		std::cout << "INI-File not found " << m_fileName.c_str() << std::endl;
-		return -1;
-	}
-	if (feof(f)) return -1;
-
-/*--------------------- search the section */
+	size_t i = 0;
 	if( prevSect != "" ) {
-		FindSection( prevSect.c_str(), bWarnIfNotfound );
-	} else {
-		fseek(f,0,SEEK_SET);
-	}
-
-	FindNextLine(m_CurLine, m_CurCharInd); //read first line of file
-	do
-	{
-		if (m_CurLine[0] == '[')
-		{
-			while( m_CurCharInd < (int)m_CurLine.size() ) {
-				m_CurCharInd++;
-				if (m_CurLine[m_CurCharInd] == ']') // if found section name equals searched one
-				{
-					for( int i=1; i<m_CurCharInd; ++i )
-						pSect->append(1, char(m_CurLine[i]));
-					return 0;
-				}
-			}
-		}
-		else
-		{
-			FindNextLine(m_CurLine, m_CurCharInd);
-		}
-	}while (!feof(f));
-
-/*--------------------- file closing */
-	fclose(f);
-
-	return 0;
-}
-//--------------------------------------------------------------------------------
-int IniFile::FindSection(const char* sect,
-							bool bWarnIfNotfound)
-{
-	int   lS;
-	lS = strlen(sect);
-	if (feof(f)) return -1;
-
-	FindNextLine(m_CurLine, m_CurCharInd); //read first line of file
-	do
-	{
-		if (m_CurLine[0] == '[')
+		while( (i < m_vSectionOrder.size()) && (m_vSectionOrder[i] != prevSect) )
+			i++;
+		if( i == m_vSectionOrder.size() )
 		{
-			m_CurCharInd++;
-			if ((strncmp(&m_CurLine[m_CurCharInd], sect, lS) == 0) && (m_CurLine[m_CurCharInd+lS] == ']')) // if found section name equals searched one
-	        {
-				return 0;
-			}
-			else
+			if(bWarnIfNotfound)
 			{
-				FindNextLine(m_CurLine, m_CurCharInd);
+				std::cout << "Section [" << prevSect << "] in IniFile " << m_fileName.c_str() << " used by "
+					<< m_strIniFileUsedBy << " not found" << std::endl;
 			}
+			return 0;
 		}
-		else if (m_CurLine[m_CurCharInd] == ' ') // if a blank is found
-		{
-			m_CurCharInd++;
-		}
-		else
-		{
-			FindNextLine(m_CurLine, m_CurCharInd);
-		}
-	}while (!feof(f));
-
-	// not found
-	if(bWarnIfNotfound)
-	{
-		std::cout << "Section [" << sect << "] in IniFile " << m_fileName.c_str() << " used by "
-			<< m_strIniFileUsedBy << " not found" << std::endl;
+		i++;
 	}
 
-	return -1;
-}
-//--------------------------------------------------------------------------------
-int IniFile::FindKey(const char* skey,
-							bool bWarnIfNotfound)
-{
-	int   lS;
-	long  fpos = 0l;
-	lS = strlen(skey);
-	if (feof(f)) return -1;
-
-	do
-	{
-		fpos=ftell(f);// pointer to the begin of the last read line
-		FindNextLine(m_CurLine, m_CurCharInd);
-
-		while ( m_CurLine[m_CurCharInd] == ' ' ) // skip blanks
-			{
-				m_CurCharInd++;
-				fpos++;
-			}
-
-		if (m_CurLine[m_CurCharInd] == '[') // next section?
-			break; // not found
-
-		if (strncmp(&m_CurLine[m_CurCharInd], skey, lS) == 0) //Found
-		{
-			m_CurCharInd+=lS;
-			fpos+=lS; // set file pointer to end of found key
-            while ( m_CurLine[m_CurCharInd] == ' ' ) // skip blanks
-			{
-				m_CurCharInd++;
-				fpos++;
-			}
-			if ( m_CurLine[m_CurCharInd] == '=' )
-			{
-				m_CurCharInd++; // set index to first char after the =
-				fpos++;
-				fseek(f,fpos,SEEK_SET);// set file pointer to first char after the =
-				return 0;
-			}
-
-		}
-
-	}while (!feof(f));
+	if( i < m_vSectionOrder.size() )
+		*pSect = m_vSectionOrder[i];
 
-	if(bWarnIfNotfound)
-	{
-		std::cout << "Key " << skey << " in IniFile '" << m_fileName.c_str() << "' used by "
-			<< m_strIniFileUsedBy << " not found" << std::endl;
-	}
-	return -1;
+	return 0;
 }
 //-----------------------------------------------
 int IniFile::GetKey(const char* pSect,const char* pKey, std::string* pStrToRead, bool bWarnIfNotfound)
@@ -0,0 +1,408 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#include <cob_utilities/RawLog.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// the positions in the file header are atomics, they have to be plain 64 bit values in the file
+#if BOOST_ATOMIC_INT64_LOCK_FREE != 2
+#error "RawLog needs lock-free 64 bit atomics"
+#endif
+
+struct RawLog::FileHeader
+{
+	char acMagic[8];
+	uint32_t uiVersion;
+	uint32_t uiSource;
+	uint64_t ullCapacity;
+	int64_t llRealtimeOffsetNs;
+	// Positions of the oldest record and behind the newest one, counted in bytes since the start of the log.
+	// The offset in the ring is the position modulo ullCapacity. ullBegin is advanced before a record is
+	// overwritten and ullEnd after a record is complete, so the records in between are always valid.
+	boost::atomic<uint64_t> ullBegin;
+	boost::atomic<uint64_t> ullEnd;
+	boost::atomic<uint64_t> ullRecords;
+	boost::atomic<uint64_t> ullDropped;
+	char acDescription[256];
+};
+
+static const char c_acMagic[8] = { 'C', 'O', 'B', 'R', 'A', 'W', 'L', 'G' };
+static const uint32_t c_uiVersion = 1;
+// the ring starts on the first page behind the header
+static const size_t c_uiHeaderSize = 4096;
+
+// the writer thread polls the queue, a chunk waits at most this long before it is in the page cache
+static const long c_lPollPeriodNs = 10000000;
+static const int64_t c_llFlushPeriodNs = 1000000000;
+
+//-----------------------------------------------
+RawLog::RawLog()
+{
+	m_pFile = NULL;
+	m_uiFileSize = 0;
+	m_pRing = NULL;
+	m_pQueue = NULL;
+	m_uiQueueSize = 0;
+	m_ullQueueHead = 0;
+	m_ullQueueTail = 0;
+	m_ullDropped = 0;
+	m_bStop = false;
+}
+
+//-----------------------------------------------
+RawLog::~RawLog()
+{
+	close();
+}
+
+//-----------------------------------------------
+bool RawLog::open(const std::string& sFileName, size_t uiCapacity, uint32_t uiSource,
+	const std::string& sDescription, size_t uiQueueSize)
+{
+	close();
+
+	// a chunk has to fit into half of the queue, the largest read of a driver is a few 10 KB
+	size_t uiQueue = 4096;
+	while(uiQueue < uiQueueSize)
+		uiQueue <<= 1;
+	uiCapacity = std::max((uiCapacity + c_uiHeaderSize - 1) & ~(c_uiHeaderSize - 1), uiQueue);
+
+	if(rename(sFileName.c_str(), (sFileName + ".prev").c_str()) != 0 && errno != ENOENT)
+		std::cerr << "RawLog: could not keep the previous log " << sFileName << ": " << strerror(errno) << std::endl;
+
+	int iFd = ::open(sFileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(iFd < 0)
+	{
+		std::cerr << "RawLog: could not create " << sFileName << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	// allocate the blocks now, a full disk would otherwise kill the writer thread with SIGBUS later
+	const size_t uiFileSize = c_uiHeaderSize + uiCapacity;
+	int iErr = posix_fallocate(iFd, 0, uiFileSize);
+	if(iErr != 0)
+	{
+		std::cerr << "RawLog: could not allocate " << uiFileSize << " bytes for " << sFileName << ": " << strerror(iErr) << std::endl;
+		::close(iFd);
+		return false;
+	}
+
+	void* pMem = mmap(NULL, uiFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, iFd, 0);
+	::close(iFd);
+	if(pMem == MAP_FAILED)
+	{
+		std::cerr << "RawLog: could not map " << sFileName << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	timespec mono, real;
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	clock_gettime(CLOCK_REALTIME, &real);
+
+	FileHeader* pFile = (FileHeader*)pMem;
+	pFile->uiVersion = c_uiVersion;
+	pFile->uiSource = uiSource;
+	pFile->ullCapacity = uiCapacity;
+	pFile->llRealtimeOffsetNs = (real.tv_sec - mono.tv_sec) * 1000000000LL + (real.tv_nsec - mono.tv_nsec);
+	pFile->ullBegin = 0;
+	pFile->ullEnd = 0;
+	pFile->ullRecords = 0;
+	pFile->ullDropped = 0;
+	strncpy(pFile->acDescription, sDescription.c_str(), sizeof(pFile->acDescription) - 1);
+	pFile->acDescription[sizeof(pFile->acDescription) - 1] = 0;
+	// the magic marks a complete header
+	memcpy(pFile->acMagic, c_acMagic, sizeof(c_acMagic));
+
+	// touch the queue once, so write() does not page fault on the first round
+	m_pQueue = new uint8_t[uiQueue];
+	memset(m_pQueue, 0, uiQueue);
+	m_uiQueueSize = uiQueue;
+	m_ullQueueHead = 0;
+	m_ullQueueTail = 0;
+	m_ullDropped = 0;
+
+	m_pFile = pFile;
+	m_uiFileSize = uiFileSize;
+	m_pRing = (uint8_t*)pMem + c_uiHeaderSize;
+
+	m_bStop = false;
+	if(pthread_create(&m_Thread, NULL, writerThread, this) != 0)
+	{
+		std::cerr << "RawLog: could not start the writer thread" << std::endl;
+		munmap(pMem, uiFileSize);
+		delete[] m_pQueue;
+		m_pQueue = NULL;
+		m_pFile = NULL;
+		m_pRing = NULL;
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------
+void RawLog::close()
+{
+	if(m_pFile == NULL)
+		return;
+
+	m_bStop = true;
+	pthread_join(m_Thread, NULL);
+
+	msync(m_pFile, m_uiFileSize, MS_SYNC);
+	munmap(m_pFile, m_uiFileSize);
+	m_pFile = NULL;
+	m_pRing = NULL;
+
+	delete[] m_pQueue;
+	m_pQueue = NULL;
+}
+
+//-----------------------------------------------
+bool RawLog::write(const void* pData, size_t uiSize, int64_t llTimeNs)
+{
+	if(m_pQueue == NULL)
+		return false;
+
+	const size_t uiRecSize = recordSize(uiSize);
+	uint64_t ullHead = m_ullQueueHead.load(boost::memory_order_relaxed);
+	size_t uiPos = ullHead & (m_uiQueueSize - 1);
+	const size_t uiToEnd = m_uiQueueSize - uiPos;
+	// a record that does not fit up to the end of the queue starts at its beginning
+	const size_t uiNeeded = (uiRecSize <= uiToEnd) ? uiRecSize : uiToEnd + uiRecSize;
+	if(uiRecSize > m_uiQueueSize / 2 ||
+		ullHead + uiNeeded - m_ullQueueTail.load(boost::memory_order_acquire) > m_uiQueueSize)
+	{
+		m_ullDropped.fetch_add(1, boost::memory_order_relaxed);
+		return false;
+	}
+
+	if(uiRecSize > uiToEnd)
+	{
+		((RecordHeader*)(m_pQueue + uiPos))->uiSize = c_uiWrap;
+		ullHead += uiToEnd;
+		uiPos = 0;
+	}
+
+	RecordHeader* pRec = (RecordHeader*)(m_pQueue + uiPos);
+	pRec->uiSize = uiSize;
+	pRec->uiReserved = 0;
+	pRec->llTimeNs = llTimeNs;
+	memcpy(pRec + 1, pData, uiSize);
+	m_ullQueueHead.store(ullHead + uiRecSize, boost::memory_order_release);
+	return true;
+}
+
+//-----------------------------------------------
+void* RawLog::writerThread(void* pArg)
+{
+	RawLog* pLog = (RawLog*)pArg;
+	int64_t llLastFlush = now();
+
+	while(true)
+	{
+		// the last round after the stop request writes what was queued before close()
+		const bool bStop = pLog->m_bStop.load(boost::memory_order_acquire);
+		if(!pLog->drainQueue() && !bStop)
+		{
+			timespec ts = { 0, c_lPollPeriodNs };
+			nanosleep(&ts, NULL);
+		}
+		pLog->m_pFile->ullDropped.store(pLog->getDropped(), boost::memory_order_relaxed);
+		if(bStop)
+			break;
+
+		// the mapping survives a crash of the process in the page cache, this is for power loss
+		if(now() - llLastFlush > c_llFlushPeriodNs)
+		{
+			msync(pLog->m_pFile, pLog->m_uiFileSize, MS_SYNC);
+			llLastFlush = now();
+		}
+	}
+	return NULL;
+}
+
+//-----------------------------------------------
+bool RawLog::drainQueue()
+{
+	uint64_t ullTail = m_ullQueueTail.load(boost::memory_order_relaxed);
+	const uint64_t ullHead = m_ullQueueHead.load(boost::memory_order_acquire);
+	if(ullTail == ullHead)
+		return false;
+
+	while(ullTail != ullHead)
+	{
+		const size_t uiPos = ullTail & (m_uiQueueSize - 1);
+		const RecordHeader* pRec = (const RecordHeader*)(m_pQueue + uiPos);
+		if(pRec->uiSize == c_uiWrap)
+			ullTail += m_uiQueueSize - uiPos;
+		else
+		{
+			appendToFile(*pRec, (const uint8_t*)(pRec + 1));
+			ullTail += recordSize(pRec->uiSize);
+		}
+		// free the space for write() as early as possible
+		m_ullQueueTail.store(ullTail, boost::memory_order_release);
+	}
+	return true;
+}
+
+//-----------------------------------------------
+void RawLog::appendToFile(const RecordHeader& header, const uint8_t* pData)
+{
+	const uint64_t ullCapacity = m_pFile->ullCapacity;
+	const size_t uiRecSize = recordSize(header.uiSize);
+
+	const uint64_t ullEnd = m_pFile->ullEnd.load(boost::memory_order_relaxed);
+	size_t uiPos = ullEnd % ullCapacity;
+	const size_t uiPad = (uiPos + uiRecSize > ullCapacity) ? ullCapacity - uiPos : 0;
+	const uint64_t ullNewEnd = ullEnd + uiPad + uiRecSize;
+
+	// drop the oldest records which are overwritten
+	uint64_t ullBegin = m_pFile->ullBegin.load(boost::memory_order_relaxed);
+	uint64_t ullRecords = m_pFile->ullRecords.load(boost::memory_order_relaxed);
+	while(ullNewEnd - ullBegin > ullCapacity)
+	{
+		const size_t uiOld = ullBegin % ullCapacity;
+		const RecordHeader* pOld = (const RecordHeader*)(m_pRing + uiOld);
+		if(pOld->uiSize == c_uiWrap)
+			ullBegin += ullCapacity - uiOld;
+		else
+		{
+			ullBegin += recordSize(pOld->uiSize);
+			ullRecords--;
+		}
+	}
+	m_pFile->ullBegin.store(ullBegin, boost::memory_order_release);
+	boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+	if(uiPad > 0)
+	{
+		((RecordHeader*)(m_pRing + uiPos))->uiSize = c_uiWrap;
+		uiPos = 0;
+	}
+	RecordHeader* pRec = (RecordHeader*)(m_pRing + uiPos);
+	*pRec = header;
+	memcpy(pRec + 1, pData, header.uiSize);
+
+	m_pFile->ullRecords.store(ullRecords + 1, boost::memory_order_relaxed);
+	m_pFile->ullEnd.store(ullNewEnd, boost::memory_order_release);
+}
+
+//-----------------------------------------------
+int64_t RawLog::now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//-----------------------------------------------
+bool RawLog::replay(const std::string& sFileName, Info* pInfo, const RecordCallback& callback)
+{
+	int iFd = ::open(sFileName.c_str(), O_RDONLY);
+	if(iFd < 0)
+	{
+		std::cerr << "RawLog: could not open " << sFileName << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+	struct stat st;
+	if(fstat(iFd, &st) != 0 || st.st_size < (off_t)c_uiHeaderSize)
+	{
+		std::cerr << "RawLog: " << sFileName << " is no raw log" << std::endl;
+		::close(iFd);
+		return false;
+	}
+	void* pMem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, iFd, 0);
+	::close(iFd);
+	if(pMem == MAP_FAILED)
+	{
+		std::cerr << "RawLog: could not map " << sFileName << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	const FileHeader* pFile = (const FileHeader*)pMem;
+	const uint64_t ullCapacity = pFile->ullCapacity;
+	if(memcmp(pFile->acMagic, c_acMagic, sizeof(c_acMagic)) != 0 || pFile->uiVersion != c_uiVersion ||
+		ullCapacity == 0 || (off_t)(c_uiHeaderSize + ullCapacity) != st.st_size)
+	{
+		std::cerr << "RawLog: " << sFileName << " is no raw log of version " << c_uiVersion << std::endl;
+		munmap(pMem, st.st_size);
+		return false;
+	}
+
+	if(pInfo != NULL)
+	{
+		pInfo->uiSource = pFile->uiSource;
+		pInfo->ullCapacity = ullCapacity;
+		pInfo->ullRecords = pFile->ullRecords.load(boost::memory_order_relaxed);
+		pInfo->ullDropped = pFile->ullDropped.load(boost::memory_order_relaxed);
+		pInfo->llRealtimeOffsetNs = pFile->llRealtimeOffsetNs;
+		pInfo->sDescription = std::string(pFile->acDescription, strnlen(pFile->acDescription, sizeof(pFile->acDescription)));
+	}
+
+	const uint8_t* pRing = (const uint8_t*)pMem + c_uiHeaderSize;
+	const uint64_t ullEnd = pFile->ullEnd.load(boost::memory_order_acquire);
+	uint64_t ullPos = pFile->ullBegin.load(boost::memory_order_acquire);
+	std::vector<uint8_t> vData;
+	bool bRet = true;
+	while(callback && ullPos < ullEnd)
+	{
+		const size_t uiPos = ullPos % ullCapacity;
+		RecordHeader rec;
+		memcpy(&rec, pRing + uiPos, sizeof(rec));
+		if(rec.uiSize == c_uiWrap)
+		{
+			ullPos += ullCapacity - uiPos;
+			continue;
+		}
+		const size_t uiRecSize = recordSize(rec.uiSize);
+		if(uiPos + uiRecSize > ullCapacity)
+		{
+			std::cerr << "RawLog: " << sFileName << " is corrupt at position " << ullPos << std::endl;
+			bRet = false;
+			break;
+		}
+		vData.assign(pRing + uiPos + sizeof(rec), pRing + uiPos + sizeof(rec) + rec.uiSize);
+
+		// the file of a running driver: the record may have been overwritten while it was copied
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		const uint64_t ullBegin = pFile->ullBegin.load(boost::memory_order_relaxed);
+		if(ullBegin > ullPos)
+		{
+			ullPos = ullBegin;
+			continue;
+		}
+
+		callback(rec.llTimeNs, vData.empty() ? NULL : &vData[0], vData.size());
+		ullPos += uiRecSize;
+	}
+
+	munmap(pMem, st.st_size);
+	return bRet;
+}
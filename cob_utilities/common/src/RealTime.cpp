@@ -0,0 +1,152 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#include <cob_utilities/RealTime.h>
+
+#include <alloca.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <sstream>
+
+//-----------------------------------------------
+static void appendError(std::string* psError, const std::string& sError)
+{
+	if(psError == NULL)
+		return;
+	if(!psError->empty())
+		*psError += ", ";
+	*psError += sError;
+}
+
+//-----------------------------------------------
+bool RealTime::lockMemory(size_t uiHeapBytes, std::string* psError)
+{
+	// freed memory stays in the heap instead of being trimmed or unmapped, large blocks come from the heap as well
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+
+	if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+	{
+		appendError(psError, std::string("mlockall failed: ") + strerror(errno));
+		return false;
+	}
+
+	if(uiHeapBytes > 0)
+	{
+		// touching the pages maps them, they stay in the process after free() as trimming is disabled
+		const long lPageSize = sysconf(_SC_PAGESIZE);
+		char* pcHeap = (char*)malloc(uiHeapBytes);
+		if(pcHeap == NULL)
+		{
+			appendError(psError, "could not allocate the heap to prefault");
+			return false;
+		}
+		for(size_t i = 0; i < uiHeapBytes; i += lPageSize)
+			pcHeap[i] = 0;
+		free(pcHeap);
+	}
+	return true;
+}
+
+//-----------------------------------------------
+// not inlined, so the stack frame is really allocated
+static void __attribute__((noinline)) prefaultStack(size_t uiStackBytes)
+{
+	volatile char* pcStack = (volatile char*)alloca(uiStackBytes);
+	const long lPageSize = sysconf(_SC_PAGESIZE);
+	for(size_t i = 0; i < uiStackBytes; i += lPageSize)
+		pcStack[i] = 0;
+}
+
+//-----------------------------------------------
+bool RealTime::setupThread(int iPriority, int iCpu, size_t uiStackBytes, std::string* psError)
+{
+	bool bOk = true;
+	if(uiStackBytes > 0)
+		prefaultStack(uiStackBytes);
+
+	if(iPriority > 0)
+	{
+		sched_param schedParam;
+		schedParam.sched_priority = iPriority;
+		int iRet = pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedParam);
+		if(iRet != 0)
+		{
+			std::ostringstream ss;
+			ss << "SCHED_FIFO priority " << iPriority << " failed: " << strerror(iRet);
+			appendError(psError, ss.str());
+			bOk = false;
+		}
+	}
+
+	if(iCpu >= 0)
+	{
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		CPU_SET(iCpu, &cpuSet);
+		int iRet = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+		if(iRet != 0)
+		{
+			std::ostringstream ss;
+			ss << "pinning to CPU " << iCpu << " failed: " << strerror(iRet);
+			appendError(psError, ss.str());
+			bOk = false;
+		}
+	}
+	return bOk;
+}
+
+//-----------------------------------------------
+PageFaultCounter::PageFaultCounter()
+{
+	m_uiMinor = 0;
+	m_uiMajor = 0;
+	m_bStarted = false;
+	m_uiLastMinor = 0;
+	m_uiLastMajor = 0;
+}
+
+//-----------------------------------------------
+void PageFaultCounter::update()
+{
+	rusage usage;
+	if(getrusage(RUSAGE_THREAD, &usage) != 0)
+		return;
+	if(m_bStarted)
+	{
+		m_uiMinor.fetch_add(usage.ru_minflt - m_uiLastMinor, boost::memory_order_relaxed);
+		m_uiMajor.fetch_add(usage.ru_majflt - m_uiLastMajor, boost::memory_order_relaxed);
+	}
+	m_bStarted = true;
+	m_uiLastMinor = usage.ru_minflt;
+	m_uiLastMajor = usage.ru_majflt;
+}
+
+//-----------------------------------------------
+void PageFaultCounter::get(uint64_t* puiMinor, uint64_t* puiMajor, bool bReset)
+{
+	*puiMinor = bReset ? m_uiMinor.exchange(0, boost::memory_order_relaxed) : m_uiMinor.load(boost::memory_order_relaxed);
+	*puiMajor = bReset ? m_uiMajor.exchange(0, boost::memory_order_relaxed) : m_uiMajor.load(boost::memory_order_relaxed);
+}
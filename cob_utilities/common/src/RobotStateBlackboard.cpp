@@ -0,0 +1,143 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#include <cob_utilities/RobotStateBlackboard.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <iostream>
+
+// the fields are shared between processes, this only works if the atomics need no lock
+#if BOOST_ATOMIC_INT32_LOCK_FREE != 2
+#error "RobotStateBlackboard needs lock-free 32 bit atomics"
+#endif
+
+//-----------------------------------------------
+RobotStateBlackboard::RobotStateBlackboard()
+{
+	m_pLayout = NULL;
+}
+
+//-----------------------------------------------
+RobotStateBlackboard::~RobotStateBlackboard()
+{
+	close();
+}
+
+//-----------------------------------------------
+bool RobotStateBlackboard::open(const std::string& sName)
+{
+	close();
+
+	std::string sPath = "/" + sName;
+	int iFd = shm_open(sPath.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+	if(iFd >= 0)
+	{
+		// all driver users have to be able to write, the mode of shm_open is reduced by the umask
+		if(fchmod(iFd, 0666) != 0)
+			std::cerr << "RobotStateBlackboard: could not make shared memory " << sPath << " writable for all users" << std::endl;
+	}
+	else if(errno == EEXIST)
+		iFd = shm_open(sPath.c_str(), O_RDWR, 0);
+	if(iFd < 0)
+	{
+		std::cerr << "RobotStateBlackboard: could not open shared memory " << sPath << std::endl;
+		return false;
+	}
+
+	// a new object is zero filled, which is the state of fields that were never written
+	struct stat st;
+	if(fstat(iFd, &st) != 0 || (st.st_size < (off_t)sizeof(Layout) && ftruncate(iFd, sizeof(Layout)) != 0))
+	{
+		std::cerr << "RobotStateBlackboard: could not resize shared memory " << sPath << std::endl;
+		::close(iFd);
+		return false;
+	}
+
+	void* pMem = mmap(NULL, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, iFd, 0);
+	::close(iFd);
+	if(pMem == MAP_FAILED)
+	{
+		std::cerr << "RobotStateBlackboard: could not map shared memory " << sPath << std::endl;
+		return false;
+	}
+
+	Layout* pLayout = (Layout*)pMem;
+	uint32_t uiMagic = 0;
+	if(pLayout->uiMagic.compare_exchange_strong(uiMagic, c_uiInitializing, boost::memory_order_acquire))
+	{
+		// this process creates the layout, it is published with the magic
+		pLayout->uiSize = sizeof(Layout);
+		if(!pLayout->emergencyStop.init() || !pLayout->power.init() || !pLayout->drives.init())
+		{
+			std::cerr << "RobotStateBlackboard: could not initialize the mutexes of " << sPath << std::endl;
+			munmap(pMem, sizeof(Layout));
+			return false;
+		}
+		pLayout->uiMagic.store(c_uiMagic, boost::memory_order_release);
+		uiMagic = c_uiMagic;
+	}
+	else
+	{
+		// another process is creating the layout, which takes microseconds
+		for(int i = 0; i < 1000 && uiMagic == c_uiInitializing; i++)
+		{
+			const timespec pause = {0, 1000000};
+			nanosleep(&pause, NULL);
+			uiMagic = pLayout->uiMagic.load(boost::memory_order_acquire);
+		}
+	}
+
+	if(uiMagic == c_uiInitializing)
+	{
+		std::cerr << "RobotStateBlackboard: " << sPath << " was not initialized by its creator, remove it from /dev/shm" << std::endl;
+		munmap(pMem, sizeof(Layout));
+		return false;
+	}
+	if(uiMagic != c_uiMagic || pLayout->uiSize != sizeof(Layout))
+	{
+		std::cerr << "RobotStateBlackboard: " << sPath << " was created by an incompatible version, remove it from /dev/shm" << std::endl;
+		munmap(pMem, sizeof(Layout));
+		return false;
+	}
+
+	m_pLayout = pLayout;
+	return true;
+}
+
+//-----------------------------------------------
+void RobotStateBlackboard::close()
+{
+	if(m_pLayout != NULL)
+	{
+		munmap(m_pLayout, sizeof(Layout));
+		m_pLayout = NULL;
+	}
+}
+
+//-----------------------------------------------
+double RobotStateBlackboard::getMonotonicTime()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + 1e-9 * now.tv_nsec;
+}
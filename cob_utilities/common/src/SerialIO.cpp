@@ -16,7 +16,7 @@
  
 
 //#include "stdafx.h"
-#include "cob_sick_s300/SerialIO.h"
+#include <cob_utilities/SerialIO.h>
 #include <math.h>
 #include <iostream>
 #include <unistd.h>
@@ -26,7 +26,11 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <poll.h>
 #include <linux/serial.h>
+#include <time.h>
 
 
 //#define _PRINT_BYTES
@@ -40,7 +44,7 @@ static char THIS_FILE[] = __FILE__;
 */
 
 
-bool getBaudrateCode(int iBaudrate, int* iBaudrateCode)
+static bool getBaudrateCode(int iBaudrate, int* iBaudrateCode)
 {
 	// baudrate codes are defined in termios.h
 	// currently upto B1000000
@@ -102,6 +106,7 @@ bool getBaudrateCode(int iBaudrate, int* iBaudrateCode)
 SerialIO::SerialIO()
 	: m_DeviceName(""),
 	  m_Device(-1),
+	  m_Epoll(-1),
 	  m_BaudRate(9600),
 	  m_Multiplier(1.0),
 	  m_ByteSize(8),
@@ -111,12 +116,29 @@ SerialIO::SerialIO()
 	  m_ReadBufSize(1024),
 	  m_WriteBufSize(m_ReadBufSize),
 	  m_Timeout(0),
-	  m_ShortBytePeriod(false)
+	  m_ShortBytePeriod(false),
+	  m_NonBlocking(false),
+	  m_LowLatency(false),
+	  m_DataReadyUs(0),
+	  m_BytesRead(0),
+	  m_BytesWritten(0),
+	  m_Reads(0),
+	  m_Writes(0),
+	  m_Errors(0),
+	  m_MaxReadLatencyUs(0),
+	  m_SumReadLatencyUs(0)
 {
 	m_BytePeriod.tv_sec = 0;
 	m_BytePeriod.tv_usec = 0;
 }
 
+static long long getMonotonicUs()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 SerialIO::~SerialIO()
 {
 	closeIO();
@@ -127,7 +149,7 @@ int SerialIO::openIO()
 	int Res;
 
 	// open device
-	m_Device = open(m_DeviceName.c_str(), O_RDWR | O_NOCTTY /*| O_NONBLOCK*/);
+	m_Device = open(m_DeviceName.c_str(), O_RDWR | O_NOCTTY | (m_NonBlocking ? O_NONBLOCK : 0));
 
 	if(m_Device < 0)
 	{
@@ -188,13 +210,21 @@ int SerialIO::openIO()
 	cfsetispeed(&m_tio, iBaudrateCode);
 	cfsetospeed(&m_tio, iBaudrateCode);
 
-	if( !bBaudrateValid ) {
-		std::cout << "Baudrate code not available - setting baudrate directly" << std::endl;
+	if( !bBaudrateValid || m_LowLatency ) {
 		struct serial_struct ss;
-		ioctl( m_Device, TIOCGSERIAL, &ss );
-		ss.flags |= ASYNC_SPD_CUST;
-		ss.custom_divisor = ss.baud_base / iNewBaudrate;
-		ioctl( m_Device, TIOCSSERIAL, &ss );
+		if( ioctl( m_Device, TIOCGSERIAL, &ss ) == 0 ) {
+			if( !bBaudrateValid ) {
+				std::cout << "Baudrate code not available - setting baudrate directly" << std::endl;
+				ss.flags |= ASYNC_SPD_CUST;
+				ss.custom_divisor = ss.baud_base / iNewBaudrate;
+			}
+			if( m_LowLatency )
+				ss.flags |= ASYNC_LOW_LATENCY;
+			if( ioctl( m_Device, TIOCSSERIAL, &ss ) != 0 )
+				std::cout << "TIOCSSERIAL of " << m_DeviceName << " failed: " << strerror(errno) << std::endl;
+		}
+		else
+			std::cout << m_DeviceName << " does not support custom baudrates or low latency mode" << std::endl;
 	}
 
 
@@ -283,11 +313,36 @@ int SerialIO::openIO()
 	// set timeout
 	setTimeout(m_Timeout);
 
+	// register for read events
+	m_Epoll = epoll_create(1);
+	if (m_Epoll != -1)
+	{
+		epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = m_Device;
+		if (epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_Device, &ev) == -1)
+		{
+			close(m_Epoll);
+			m_Epoll = -1;
+		}
+	}
+	if (m_Epoll == -1)
+	{
+		std::cout << "epoll setup for " << m_DeviceName << " failed: "
+			<< strerror(errno) << " (Error code " << errno << ")" << std::endl;
+	}
+
 	return 0;
 }
 
 void SerialIO::closeIO()
 {
+	if (m_Epoll != -1)
+	{
+		close(m_Epoll);
+		m_Epoll = -1;
+	}
 	if (m_Device != -1)
 	{
 		close(m_Device);
@@ -337,10 +392,55 @@ void SerialIO::changeBaudRate(int iBaudRate)
 }
 
 
+void SerialIO::countRead(int BytesRead)
+{
+	if (BytesRead < 0)
+	{
+		if (errno != EAGAIN)
+			m_Errors.fetch_add(1, boost::memory_order_relaxed);
+		return;
+	}
+	m_Reads.fetch_add(1, boost::memory_order_relaxed);
+	m_BytesRead.fetch_add(BytesRead, boost::memory_order_relaxed);
+
+	if (m_DataReadyUs != 0)
+	{
+		unsigned long Latency = (unsigned long)(getMonotonicUs() - m_DataReadyUs);
+		m_DataReadyUs = 0;
+		m_SumReadLatencyUs.fetch_add(Latency, boost::memory_order_relaxed);
+		// only the reading thread raises the maximum
+		if (Latency > m_MaxReadLatencyUs.load(boost::memory_order_relaxed))
+			m_MaxReadLatencyUs.store(Latency, boost::memory_order_relaxed);
+	}
+}
+
+void SerialIO::countWrite(int BytesWritten)
+{
+	if (BytesWritten < 0)
+	{
+		m_Errors.fetch_add(1, boost::memory_order_relaxed);
+		return;
+	}
+	m_Writes.fetch_add(1, boost::memory_order_relaxed);
+	m_BytesWritten.fetch_add(BytesWritten, boost::memory_order_relaxed);
+}
+
+void SerialIO::getStatistics(Statistics* pStatistics) const
+{
+	pStatistics->ulBytesRead = m_BytesRead.load(boost::memory_order_relaxed);
+	pStatistics->ulBytesWritten = m_BytesWritten.load(boost::memory_order_relaxed);
+	pStatistics->ulReads = m_Reads.load(boost::memory_order_relaxed);
+	pStatistics->ulWrites = m_Writes.load(boost::memory_order_relaxed);
+	pStatistics->ulErrors = m_Errors.load(boost::memory_order_relaxed);
+	pStatistics->ulMaxReadLatencyUs = m_MaxReadLatencyUs.load(boost::memory_order_relaxed);
+	pStatistics->ulSumReadLatencyUs = m_SumReadLatencyUs.load(boost::memory_order_relaxed);
+}
+
 int SerialIO::readBlocking(char *Buffer, int Length)
 {
 	ssize_t BytesRead;
 	BytesRead = read(m_Device, Buffer, Length);
+	countRead(BytesRead);
 #ifdef PRINT_BYTES
 	printf("%2d Bytes read:", BytesRead);
 	for(int i=0; i<BytesRead; i++)
@@ -358,7 +458,7 @@ int SerialIO::readNonBlocking(char *Buffer, int Length)
 
 
 	BytesRead = read(m_Device, Buffer, iBytesToRead);
-
+	countRead(BytesRead);
 
 	// Debug
 //	printf("%2d Bytes read:", BytesRead);
@@ -373,6 +473,61 @@ int SerialIO::readNonBlocking(char *Buffer, int Length)
 	return BytesRead;
 }
 
+int SerialIO::waitForData(double Timeout)
+{
+	if (m_Epoll == -1)
+		return -1;
+
+	int iTimeoutMs = (Timeout < 0) ? -1 : int(Timeout * 1000.0 + 0.5);
+	epoll_event ev;
+	int Res = epoll_wait(m_Epoll, &ev, 1, iTimeoutMs);
+
+	if (Res < 0 && errno == EINTR)
+		return 0;
+	if (Res > 0 && (ev.events & (EPOLLERR | EPOLLHUP)))
+		return -1;
+
+	if (Res > 0 && m_DataReadyUs == 0)
+		m_DataReadyUs = getMonotonicUs();
+	return (Res > 0) ? 1 : Res;
+}
+
+int SerialIO::waitForDevice(const char *DeviceName, double Timeout)
+{
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	// the node itself changes its permissions when udev has set it up,
+	// symlinks like /dev/serial/by-id/... and their directories are created on the first hotplug
+	std::string Path(DeviceName);
+	int Watches = 0;
+	if (inotify_add_watch(fd, Path.c_str(), IN_ATTRIB | IN_DELETE_SELF) >= 0)
+		Watches++;
+	for (size_t Pos = Path.rfind('/'); Pos != std::string::npos && Pos > 0; Pos = Path.rfind('/', Pos - 1))
+	{
+		if (inotify_add_watch(fd, Path.substr(0, Pos).c_str(), IN_CREATE | IN_MOVED_TO | IN_ATTRIB) >= 0)
+			Watches++;
+	}
+	if (Watches == 0)
+	{
+		::close(fd);
+		return -1;
+	}
+
+	pollfd Pfd;
+	Pfd.fd = fd;
+	Pfd.events = POLLIN;
+	Pfd.revents = 0;
+	int iTimeoutMs = (Timeout < 0) ? -1 : int(Timeout * 1000.0 + 0.5);
+	int Res = ::poll(&Pfd, 1, iTimeoutMs);
+	::close(fd);
+
+	if (Res < 0 && errno == EINTR)
+		return 0;
+	return (Res > 0) ? 1 : Res;
+}
+
 int SerialIO::writeIO(const char *Buffer, int Length)
 {
 	ssize_t BytesWritten;
@@ -391,6 +546,7 @@ int SerialIO::writeIO(const char *Buffer, int Length)
 	}
 	else
 		BytesWritten = write(m_Device, Buffer, Length);
+	countWrite(BytesWritten);
 #ifdef PRINT_BYTES
 	printf("%2d Bytes sent:", BytesWritten);
 	for(int i=0; i<BytesWritten; i++)
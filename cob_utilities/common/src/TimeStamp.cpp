@@ -19,104 +19,64 @@
 
 //-----------------------------------------------------------------------------
 
-TimeStamp::TimeStamp()
+TimeStamp::TimeStamp(ClockType Clock)
 {
-	m_TimeStamp.tv_sec = 0;
-	m_TimeStamp.tv_nsec = 0;
+	m_llNanoSec = 0;
+	m_Clock = Clock;
 }
 
 void TimeStamp::SetNow()
 {
-	::clock_gettime(CLOCK_REALTIME, &m_TimeStamp);
+	::timespec Now;
+	::clock_gettime((m_Clock == CLOCK_TYPE_REALTIME) ? CLOCK_REALTIME : CLOCK_MONOTONIC, &Now);
+	m_llNanoSec = int64_t(Now.tv_sec) * 1000000000 + Now.tv_nsec;
 }
 
-double TimeStamp::TimespecToDouble(const ::timespec& LargeInt)
+int64_t TimeStamp::SecondsToNanoSec(double TimeS)
 {
-	return double(LargeInt.tv_sec) + double(LargeInt.tv_nsec) / 1e9;
+	// round to the nearest nanosecond
+	return int64_t(TimeS * 1e9 + ((TimeS < 0.0) ? -0.5 : 0.5));
 }
 
-::timespec TimeStamp::DoubleToTimespec(double TimeS)
+double TimeStamp::operator-(const TimeStamp& EarlierTime) const
 {
-	::timespec DeltaTime;
-	if (! ( TimeS < 4e9 && TimeS > 0.0 ))
-	{
-		DeltaTime.tv_sec = 0;
-		DeltaTime.tv_nsec = 0;
-		return DeltaTime;
-    	}
-
-	DeltaTime.tv_sec = ::time_t(TimeS);
-	DeltaTime.tv_nsec
-		= static_cast<long int>((TimeS - double(DeltaTime.tv_sec)) * 1e9);
-
-	return DeltaTime;
+	return double(m_llNanoSec - EarlierTime.m_llNanoSec) * 1e-9;
 }
 
-double TimeStamp::operator-(const TimeStamp& EarlierTime) const
+int64_t TimeStamp::NanoSecondsSince(const TimeStamp& EarlierTime) const
 {
-	::timespec Res;
-
-	Res.tv_sec = m_TimeStamp.tv_sec - EarlierTime.m_TimeStamp.tv_sec;
-	Res.tv_nsec = m_TimeStamp.tv_nsec - EarlierTime.m_TimeStamp.tv_nsec;
-
-	if (Res.tv_nsec < 0) {
-		Res.tv_sec--;
-		Res.tv_nsec += 1000000000;
-	}
-
-	return TimespecToDouble(Res);
+	return m_llNanoSec - EarlierTime.m_llNanoSec;
 }
 
 void TimeStamp::operator+=(double TimeS)
 {
-	::timespec Dbl = DoubleToTimespec(TimeS);
-	m_TimeStamp.tv_sec += Dbl.tv_sec;
-	m_TimeStamp.tv_nsec += Dbl.tv_nsec;
-	if (m_TimeStamp.tv_nsec > 1000000000)
-	{
-		m_TimeStamp.tv_sec++;
-		m_TimeStamp.tv_nsec -= 1000000000;
-	}
+	m_llNanoSec += SecondsToNanoSec(TimeS);
 }
 
 void TimeStamp::operator-=(double TimeS)
 {
-	::timespec Dbl = DoubleToTimespec(TimeS);
-	m_TimeStamp.tv_sec -= Dbl.tv_sec;
-	m_TimeStamp.tv_nsec -= Dbl.tv_nsec;
-	if (m_TimeStamp.tv_nsec < 0.0)
-	{
-		m_TimeStamp.tv_sec--;
-		m_TimeStamp.tv_nsec += 1000000000;
-	}
+	m_llNanoSec -= SecondsToNanoSec(TimeS);
 }
 
 bool TimeStamp::operator>(const TimeStamp& Time)
 {
-	if (m_TimeStamp.tv_sec > Time.m_TimeStamp.tv_sec) return true;
-	if ((m_TimeStamp.tv_sec == Time.m_TimeStamp.tv_sec) &&
-		(m_TimeStamp.tv_nsec > Time.m_TimeStamp.tv_nsec)) return true;
-	return false;
+	return m_llNanoSec > Time.m_llNanoSec;
 }
 
 bool TimeStamp::operator<(const TimeStamp& Time)
 {
-	if (m_TimeStamp.tv_sec < Time.m_TimeStamp.tv_sec) return true;
-	if ((m_TimeStamp.tv_sec == Time.m_TimeStamp.tv_sec) &&
-		(m_TimeStamp.tv_nsec < Time.m_TimeStamp.tv_nsec)) return true;
-	return false;
+	return m_llNanoSec < Time.m_llNanoSec;
 }
 
 void TimeStamp::getTimeStamp(long& lSeconds, long& lNanoSeconds)
 {
-	lSeconds = m_TimeStamp.tv_sec;
-	lNanoSeconds = m_TimeStamp.tv_nsec;
+	lSeconds = long(m_llNanoSec / 1000000000);
+	lNanoSeconds = long(m_llNanoSec % 1000000000);
 };
 
 void TimeStamp::setTimeStamp(const long& lSeconds, const long& lNanoSeconds)
 {
-	m_TimeStamp.tv_sec = lSeconds;
-	m_TimeStamp.tv_nsec = lNanoSeconds;
+	m_llNanoSec = int64_t(lSeconds) * 1000000000 + lNanoSeconds;
 };
 
 std::string TimeStamp::CurrentToString()
@@ -133,7 +93,7 @@ std::string TimeStamp::CurrentToString()
 	tm = localtime ( &now );
 	len = strftime ( pres, TIME_SIZE, "%Y-%m-%d %H:%M:%S.", tm );
 
-	s = (std::string)pres + NumToString(m_TimeStamp.tv_nsec / 1000);
+	s = (std::string)pres + NumToString(long(m_llNanoSec % 1000000000) / 1000);
 
 	return s;
 # undef TIME_SIZE
@@ -149,10 +109,11 @@ std::string TimeStamp::ToString()
 	char pres[TIME_SIZE];
 	std::string s;
 
-	tm = localtime ( &m_TimeStamp.tv_sec );
+	time_t sec = time_t(m_llNanoSec / 1000000000);
+	tm = localtime ( &sec );
 	len = strftime ( pres, TIME_SIZE, "%Y-%m-%d %H:%M:%S.", tm );
 
-	s = (std::string)pres + NumToString(m_TimeStamp.tv_nsec / 1000);
+	s = (std::string)pres + NumToString(long(m_llNanoSec % 1000000000) / 1000);
 
 	return s;
 # undef TIME_SIZE
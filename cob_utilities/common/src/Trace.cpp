@@ -0,0 +1,248 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+#include <cob_utilities/Trace.h>
+#include <cob_utilities/Mutex.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+//-----------------------------------------------
+namespace
+{
+
+struct TraceEvent
+{
+	const char* pName;
+	int64_t llStartNs;
+	int64_t llEndNs;
+};
+
+/**
+ * Ring buffer of one thread.
+ * Only the owning thread writes, m_ulHead is published after the event so that
+ * a reader never sees half written events which are not overwritten again.
+ */
+struct TraceBuffer
+{
+	long lThreadId;
+	std::vector<TraceEvent> vEvents;
+	boost::atomic<unsigned long> ulHead;
+};
+
+Mutex g_BuffersMutex;
+std::vector<TraceBuffer*> g_vpBuffers;
+boost::atomic<size_t> g_uiEventsPerThread(Trace::c_uiDefaultEventsPerThread);
+
+// buffers are never freed, this keeps the spans of threads which have already ended
+__thread TraceBuffer* t_pBuffer = NULL;
+
+// startup phases of all threads, there are only a few of them
+struct TracePhaseEvent
+{
+	TraceEvent event;
+	long lThreadId;
+};
+Mutex g_PhasesMutex;
+std::vector<TracePhaseEvent> g_vPhases;
+
+// reference for the phase summary, taken when the library is loaded
+const int64_t g_llProcessStartNs = Trace::now();
+
+TraceBuffer* createBuffer()
+{
+	TraceBuffer* pBuffer = new TraceBuffer;
+	pBuffer->lThreadId = syscall(SYS_gettid);
+	pBuffer->vEvents.resize(g_uiEventsPerThread.load(boost::memory_order_relaxed));
+	pBuffer->ulHead = 0;
+
+	g_BuffersMutex.lock();
+	g_vpBuffers.push_back(pBuffer);
+	g_BuffersMutex.unlock();
+	return pBuffer;
+}
+
+/**
+ * Enables tracing if COB_TRACE_FILE is set and writes the file at exit.
+ */
+struct TraceFromEnvironment
+{
+	std::string sFileName;
+
+	TraceFromEnvironment()
+	{
+		const char* pFile = getenv("COB_TRACE_FILE");
+		if(pFile == NULL || pFile[0] == '\0')
+			return;
+
+		std::ostringstream ss;
+		ss << pFile << "." << getpid() << ".json";
+		sFileName = ss.str();
+		Trace::enable();
+	}
+
+	~TraceFromEnvironment()
+	{
+		if(!sFileName.empty())
+			Trace::dump(sFileName);
+	}
+};
+
+}
+
+boost::atomic<bool> Trace::s_bEnabled(false);
+
+// after the globals above, which are used by its destructor
+static TraceFromEnvironment s_TraceFromEnvironment;
+
+//-----------------------------------------------
+void Trace::enable(size_t uiEventsPerThread)
+{
+	if(uiEventsPerThread > 0)
+		g_uiEventsPerThread = uiEventsPerThread;
+	s_bEnabled = true;
+}
+
+//-----------------------------------------------
+void Trace::disable()
+{
+	s_bEnabled = false;
+}
+
+//-----------------------------------------------
+int64_t Trace::now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+//-----------------------------------------------
+void Trace::record(const char* pName, int64_t llStartNs, int64_t llEndNs)
+{
+	if(t_pBuffer == NULL)
+		t_pBuffer = createBuffer();
+
+	TraceBuffer* pBuffer = t_pBuffer;
+	unsigned long ulHead = pBuffer->ulHead.load(boost::memory_order_relaxed);
+	TraceEvent& event = pBuffer->vEvents[ulHead % pBuffer->vEvents.size()];
+	event.pName = pName;
+	event.llStartNs = llStartNs;
+	event.llEndNs = llEndNs;
+	pBuffer->ulHead.store(ulHead + 1, boost::memory_order_release);
+}
+
+//-----------------------------------------------
+void Trace::recordPhase(const char* pName, int64_t llStartNs, int64_t llEndNs)
+{
+	TracePhaseEvent phase;
+	phase.event.pName = pName;
+	phase.event.llStartNs = llStartNs;
+	phase.event.llEndNs = llEndNs;
+	phase.lThreadId = syscall(SYS_gettid);
+
+	g_PhasesMutex.lock();
+	g_vPhases.push_back(phase);
+	g_PhasesMutex.unlock();
+}
+
+//-----------------------------------------------
+std::string Trace::getPhaseSummary()
+{
+	g_PhasesMutex.lock();
+	std::vector<TracePhaseEvent> vPhases = g_vPhases;
+	g_PhasesMutex.unlock();
+
+	std::ostringstream ss;
+	ss.setf(std::ios::fixed);
+	ss.precision(1);
+	for(size_t i = 0; i < vPhases.size(); i++)
+	{
+		const TraceEvent& event = vPhases[i].event;
+		ss << (i > 0 ? "\n" : "") << "+" << (event.llStartNs - g_llProcessStartNs) * 1e-6 << " ms " << event.pName <<
+			": " << (event.llEndNs - event.llStartNs) * 1e-6 << " ms";
+	}
+	return ss.str();
+}
+
+//-----------------------------------------------
+bool Trace::dump(const std::string& sFileName)
+{
+	FILE* pFile = fopen(sFileName.c_str(), "w");
+	if(pFile == NULL)
+	{
+		std::cout << "Trace::dump(): could not open " << sFileName << std::endl;
+		return false;
+	}
+
+	int iPid = getpid();
+	bool bFirst = true;
+	std::vector<TraceEvent> vCopy;
+
+	fprintf(pFile, "{\"traceEvents\":[\n");
+
+	g_BuffersMutex.lock();
+	for(size_t i = 0; i < g_vpBuffers.size(); i++)
+	{
+		TraceBuffer* pBuffer = g_vpBuffers[i];
+		unsigned long ulSize = pBuffer->vEvents.size();
+
+		unsigned long ulHead = pBuffer->ulHead.load(boost::memory_order_acquire);
+		unsigned long ulBegin = (ulHead > ulSize) ? ulHead - ulSize : 0;
+		vCopy.resize(ulHead - ulBegin);
+		for(unsigned long j = ulBegin; j < ulHead; j++)
+			vCopy[j - ulBegin] = pBuffer->vEvents[j % ulSize];
+
+		// events the owner has overwritten while copying are no longer consistent
+		unsigned long ulHeadAfter = pBuffer->ulHead.load(boost::memory_order_acquire);
+		unsigned long ulValid = (ulHeadAfter >= ulSize) ? ulHeadAfter - ulSize + 1 : 0;
+
+		for(unsigned long j = std::max(ulBegin, ulValid); j < ulHead; j++)
+		{
+			const TraceEvent& event = vCopy[j - ulBegin];
+			fprintf(pFile, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%ld}",
+				bFirst ? "" : ",\n", event.pName, event.llStartNs * 1e-3,
+				(event.llEndNs - event.llStartNs) * 1e-3, iPid, pBuffer->lThreadId);
+			bFirst = false;
+		}
+	}
+	g_BuffersMutex.unlock();
+
+	g_PhasesMutex.lock();
+	for(size_t i = 0; i < g_vPhases.size(); i++)
+	{
+		const TraceEvent& event = g_vPhases[i].event;
+		fprintf(pFile, "%s{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%ld}",
+			bFirst ? "" : ",\n", event.pName, event.llStartNs * 1e-3,
+			(event.llEndNs - event.llStartNs) * 1e-3, iPid, g_vPhases[i].lThreadId);
+		bFirst = false;
+	}
+	g_PhasesMutex.unlock();
+
+	fprintf(pFile, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	bool bOk = (ferror(pFile) == 0);
+	fclose(pFile);
+	return bOk;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ 
+
+/*
+ * Compares the scalar and the array versions of the MathSup angle functions.
+ *
+ * usage: mathsup_benchmark [angles] [iterations]
+ *
+ * The angles are random in [-10pi, 10pi]. The default of 8 angles corresponds to
+ * the steering and drive joints of the base, which are processed once per control cycle.
+ */
+
+#include <cob_utilities/MathSup.h>
+
+#include <stdlib.h>
+#include <sys/time.h>
+#include <iostream>
+#include <vector>
+
+static double getTime()
+{
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+// normalizePi as implemented before the branchless version
+static void normalizePiReference(double& angle)
+{
+	angle -= floor(angle/(2 * MathSup::PI)) * 2 * MathSup::PI;
+	if ( angle > MathSup::PI ) angle -= 2 * MathSup::PI;
+}
+
+int main(int argc, char** argv)
+{
+	int num = 8;
+	int iterations = 1000000;
+	if(argc>1)
+		num = atoi(argv[1]);
+	if(argc>2)
+		iterations = atoi(argv[2]);
+	if(num<1 || iterations<1)
+	{
+		std::cout << "usage: mathsup_benchmark [angles] [iterations]" << std::endl;
+		return 1;
+	}
+
+	// every iteration processes the next block of num angles, so the results cannot be hoisted out of the loop
+	const int blocks = 256;
+	std::vector<double> a(num*blocks), b(num*blocks), ref(num*blocks), out(num*blocks);
+	for(size_t i=0; i<a.size(); i++)
+	{
+		a[i] = (rand() / (double)RAND_MAX - 0.5) * 20 * MathSup::PI;
+		b[i] = (rand() / (double)RAND_MAX - 0.5) * 20 * MathSup::PI;
+	}
+
+	// check the results before timing them
+	for(size_t i=0; i<a.size(); i++)
+	{
+		ref[i] = a[i] - b[i];
+		normalizePiReference(ref[i]);
+	}
+	MathSup::calcDeltaAng(&a[0], &b[0], &out[0], a.size());
+	for(size_t i=0; i<a.size(); i++)
+	{
+		// ]-pi,pi] may round to the other end of the interval
+		if(fabs(ref[i] - out[i]) > 1e-12 && fabs(fabs(ref[i] - out[i]) - MathSup::TWO_PI) > 1e-12)
+		{
+			std::cout << "ERROR: results differ for " << a[i] << " - " << b[i] << ": " << ref[i] << " != " << out[i] << std::endl;
+			return 1;
+		}
+	}
+
+	double start = getTime();
+	for(int it=0; it<iterations; it++)
+	{
+		const int offset = (it % blocks) * num;
+		for(int i=offset; i<offset+num; i++)
+		{
+			ref[i] = a[i] - b[i];
+			normalizePiReference(ref[i]);
+		}
+	}
+	const double t_ref = getTime()-start;
+
+	start = getTime();
+	for(int it=0; it<iterations; it++)
+	{
+		const int offset = (it % blocks) * num;
+		for(int i=offset; i<offset+num; i++)
+			out[i] = MathSup::calcDeltaAng(a[i], b[i]);
+	}
+	const double t_scalar = getTime()-start;
+
+	start = getTime();
+	for(int it=0; it<iterations; it++)
+	{
+		const int offset = (it % blocks) * num;
+		MathSup::calcDeltaAng(&a[offset], &b[offset], &out[offset], num);
+	}
+	const double t_array = getTime()-start;
+
+	double checksum = 0;
+	for(size_t i=0; i<out.size(); i++)
+		checksum += ref[i] + out[i];
+
+	const double n = double(num)*iterations;
+	std::cout << "angles: " << n << " (checksum " << checksum << ")" << std::endl;
+	std::cout << "reference: " << 1e9*t_ref/n << " ns/angle" << std::endl;
+	std::cout << "scalar:    " << 1e9*t_scalar/n << " ns/angle" << std::endl;
+	std::cout << "array:     " << 1e9*t_array/n << " ns/angle" << std::endl;
+	return 0;
+}
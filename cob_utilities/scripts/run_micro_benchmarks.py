@@ -0,0 +1,97 @@
+#!/usr/bin/env python
+#
+# Copyright 2017 Fraunhofer Institute for Manufacturing Engineering and Automation (IPA)
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Runs the *_micro_benchmark executables of all driver packages and merges their results.
+
+usage: run_micro_benchmarks.py [--output=file.json] [--key=value ...] [executable ...]
+
+Without executables, all *_micro_benchmark executables in lib/<package>/ of the CMAKE_PREFIX_PATH
+are run. Options other than --output are passed to every executable, e.g. --filter, --min_time or
+the data directories like --ini_directory, see MicroBenchmark.h. The merged result has the JSON
+layout of Google Benchmark, every benchmark gets the name of its executable.
+"""
+
+import glob
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+def find_executables():
+    executables = []
+    for prefix in os.environ.get('CMAKE_PREFIX_PATH', '').split(os.pathsep):
+        if prefix:
+            executables += sorted(glob.glob(os.path.join(prefix, 'lib', '*', '*_micro_benchmark')))
+    return [e for e in executables if os.access(e, os.X_OK)]
+
+def run_executable(executable, options):
+    fd, path = tempfile.mkstemp(suffix='.json')
+    os.close(fd)
+    try:
+        # the console output goes to stderr, stdout may carry the merged result
+        if subprocess.call([executable] + options + ['--out=' + path], stdout=sys.stderr) != 0:
+            sys.stderr.write('%s failed\n' % executable)
+            return None
+        with open(path) as f:
+            return json.load(f)
+    finally:
+        os.remove(path)
+
+def main(argv):
+    output = None
+    options = []
+    executables = []
+    for arg in argv:
+        if arg.startswith('--output='):
+            output = arg[len('--output='):]
+        elif arg.startswith('--'):
+            options.append(arg)
+        else:
+            executables.append(arg)
+    if not executables:
+        executables = find_executables()
+    if not executables:
+        sys.stderr.write('no *_micro_benchmark executables found\n')
+        return 1
+
+    merged = {'context': None, 'benchmarks': []}
+    failed = False
+    for executable in executables:
+        result = run_executable(executable, options)
+        if result is None:
+            failed = True
+            continue
+        name = os.path.basename(executable)
+        if merged['context'] is None:
+            merged['context'] = result['context']
+            merged['context']['executables'] = []
+        merged['context']['executables'].append(name)
+        for benchmark in result['benchmarks']:
+            benchmark['executable'] = name
+            merged['benchmarks'].append(benchmark)
+
+    if merged['context'] is not None:
+        if output:
+            with open(output, 'w') as f:
+                json.dump(merged, f, indent=2)
+        else:
+            json.dump(merged, sys.stdout, indent=2)
+            sys.stdout.write('\n')
+    return 1 if failed else 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -24,6 +24,10 @@
 #include <std_msgs/Bool.h>
 #include <std_msgs/Float64.h>
 
+#include <boost/bind.hpp>
+
+#include <cob_utilities/RobotStateBlackboard.h>
+
 #include <cob_voltage_control_common.cpp>
 #include <cob_phidgets/AnalogSensor.h>
 #include <cob_phidgets/DigitalSensor.h>
@@ -33,6 +37,41 @@ class cob_voltage_control_ros
     private:
         int EM_stop_status_;
 
+        // position of a uri in the last message containing it, checked before searching the whole message
+        struct UriCache
+        {
+            std::string uri;
+            size_t index;
+
+            UriCache(const std::string &name) : uri(name), index(0) {}
+
+            int find(const std::vector<std::string> &uris)
+            {
+                if(index < uris.size() && uris[index] == uri)
+                    return index;
+                for(size_t i = 0; i < uris.size(); i++)
+                {
+                    if(uris[i] == uri)
+                    {
+                        index = i;
+                        return i;
+                    }
+                }
+                return -1;
+            }
+        };
+
+        UriCache voltage_uri_;
+        UriCache current_uri_;
+        UriCache em_rear_uri_;
+        UriCache em_front_uri_;
+
+        bool got_analog_;
+        bool got_digital_;
+
+        // power and EM-Stop state for the other drivers, written before the topics are published
+        RobotStateBlackboard blackboard_;
+
     public:
         ros::NodeHandle n_;
 
@@ -62,6 +101,9 @@ class cob_voltage_control_ros
         };
 
         cob_voltage_control_ros()
+            : voltage_uri_("voltage"), current_uri_("current"),
+              em_rear_uri_("em_stop_laser_rear"), em_front_uri_("em_stop_laser_front"),
+              got_analog_(false), got_digital_(false)
         {
             topicPub_power_state_ = n_.advertise<cob_msgs::PowerState>("power_state", 1);
             topicPub_em_stop_state_ = n_.advertise<cob_msgs::EmergencyStopState>("em_stop_state", 1);
@@ -79,11 +121,18 @@ class cob_voltage_control_ros
             n_.param("em_stop_dio_port", component_config_.num_em_stop_port, 0);
             n_.param("scanner_stop_dio_port", component_config_.num_scanner_em_port, 1);
 
+            std::string blackboard_name;
+            n_.param<std::string>("blackboard", blackboard_name, "cob_robot_state");
+            if(!blackboard_name.empty() && !blackboard_.open(blackboard_name))
+                ROS_WARN("Could not open the robot state blackboard '%s', states are only published", blackboard_name.c_str());
+
             last_rear_em_state = false;
             last_front_em_state = false;
 
             EM_stop_status_ = ST_EM_ACTIVE;
             component_data_.out_pub_em_stop_state_.scanner_stop = false;
+            component_data_.in_phidget_voltage = 0;
+            component_data_.in_phidget_current = 0;
         }
 
         void configure()
@@ -91,27 +140,60 @@ class cob_voltage_control_ros
             component_implementation_.configure();
         }
 
+        // states are published when they change, this republishes them for late subscribers
         void update()
         {
-            component_implementation_.update(component_data_, component_config_);
+            if(got_analog_)
+                publishPowerState();
+            if(got_digital_)
+                topicPub_em_stop_state_.publish(component_data_.out_pub_em_stop_state_);
+        }
+
+        void publishPowerState()
+        {
             topicPub_Voltage_.publish(component_data_.out_pub_voltage_);
             topicPub_Current_.publish(component_data_.out_pub_current_);
             topicPub_power_state_.publish(component_data_.out_pub_power_state_);
-            topicPub_em_stop_state_.publish(component_data_.out_pub_em_stop_state_);
         }
 
         void analogPhidgetSignalsCallback(const cob_phidgets::AnalogSensorConstPtr &msg)
         {
-            for(int i = 0; i < msg->uri.size(); i++)
+            if(msg->uri.size() != msg->value.size())
+                return;
+
+            bool found = false;
+            bool changed = false;
+            int i = voltage_uri_.find(msg->uri);
+            if(i >= 0)
             {
-                if( msg->uri[i] == "voltage")
-                {
-                   component_data_.in_phidget_voltage = msg->value[i];
-                }
-                if( msg->uri[i] == "current")
+                found = true;
+                changed |= (msg->value[i] != component_data_.in_phidget_voltage);
+                component_data_.in_phidget_voltage = msg->value[i];
+            }
+            i = current_uri_.find(msg->uri);
+            if(i >= 0)
+            {
+                found = true;
+                changed |= (msg->value[i] != component_data_.in_phidget_current);
+                component_data_.in_phidget_current = msg->value[i];
+            }
+
+            if(found && (changed || !got_analog_))
+            {
+                component_implementation_.update(component_data_, component_config_);
+                got_analog_ = true;
+                if(blackboard_.isOpen())
                 {
-                    component_data_.in_phidget_current = msg->value[i];
+                    const cob_msgs::PowerState &power = component_data_.out_pub_power_state_;
+                    RobotStateBlackboard::PowerData data;
+                    data.dVoltage = power.voltage;
+                    data.dCurrent = power.current;
+                    data.dRelativeCapacity = power.relative_remaining_capacity;
+                    data.bCharging = power.charging;
+                    data.dStampS = RobotStateBlackboard::getMonotonicTime();
+                    blackboard_.writePower(data);
                 }
+                publishPowerState();
             }
         }
 
@@ -124,20 +206,27 @@ class cob_voltage_control_ros
             bool EM_signal = false;
             bool got_message = false;
 
-            for(int i = 0; i < msg->uri.size(); i++)
+            if(msg->uri.size() != msg->state.size())
+                return;
+
+            //a message may contain only one of the signals, the other one keeps its last state
+            front_em_active = last_front_em_state;
+            rear_em_active = last_rear_em_state;
+            int i = em_rear_uri_.find(msg->uri);
+            if(i >= 0)
             {
-                if( msg->uri[i] == "em_stop_laser_rear")
-                {
-                    rear_em_active = !((bool)msg->state[i]);
-                    got_message = true;
-                }
-                else if( msg->uri[i] == "em_stop_laser_front")
-                {
-                    front_em_active = !((bool)msg->state[i]);
-                    got_message = true;
-                }
+                rear_em_active = !((bool)msg->state[i]);
+                got_message = true;
             }
-            if(got_message)
+            i = em_front_uri_.find(msg->uri);
+            if(i >= 0)
+            {
+                front_em_active = !((bool)msg->state[i]);
+                got_message = true;
+            }
+            //a confirmed stop is released with the next message, so that state is always evaluated
+            bool changed = !got_digital_ || front_em_active != last_front_em_state || rear_em_active != last_rear_em_state;
+            if(got_message && (changed || EM_stop_status_ == ST_EM_CONFIRMED))
             {
                 if( (front_em_active && rear_em_active) && (!last_front_em_state && !last_rear_em_state))
                 {
@@ -202,6 +291,19 @@ class cob_voltage_control_ros
 
                 last_front_em_state = front_em_active;
                 last_rear_em_state = rear_em_active;
+                got_digital_ = true;
+                if(blackboard_.isOpen())
+                {
+                    const cob_msgs::EmergencyStopState &em = component_data_.out_pub_em_stop_state_;
+                    RobotStateBlackboard::EmergencyStopData data;
+                    data.iState = em.emergency_state;
+                    data.bButtonStop = em.emergency_button_stop;
+                    data.bScannerStop = em.scanner_stop;
+                    data.bOnline = true;
+                    data.dStampS = RobotStateBlackboard::getMonotonicTime();
+                    blackboard_.writeEmergencyStop(data);
+                }
+                topicPub_em_stop_state_.publish(component_data_.out_pub_em_stop_state_);
             }
         }
 };
@@ -213,13 +315,12 @@ int main(int argc, char** argv)
     cob_voltage_control_ros node;
     node.configure();
 
-    ros::Rate loop_rate(20); // Hz // if cycle time == 0 do a spin() here without calling node.update()
+    // states are published on change, the timer only republishes them
+    double republish_rate;
+    node.n_.param("republish_rate", republish_rate, 1.0);
+    ros::Timer republish_timer = node.n_.createTimer(ros::Duration(1.0 / republish_rate),
+                                                     boost::bind(&cob_voltage_control_ros::update, &node));
 
-    while(node.n_.ok())
-    {
-        node.update();
-        loop_rate.sleep();
-        ros::spinOnce();
-    }
+    ros::spin();
     return 0;
 }